@@ -29,6 +29,10 @@ class AddressResolution {
   int num_resolvers;
   u_int32_t num_resolved_addresses, num_resolved_fails;
   pthread_t *resolveThreadLoop;
+  AsyncResolver *async_resolver;
+  pthread_t asyncResolveThreadLoop;
+  FifoStringsQueue *symbolicToResolve; /* Names handed over by the async loop to the blocking resolver */
+  pthread_t symbolicResolveThreadLoop;
   Mutex m;
 
  public:
@@ -36,6 +40,8 @@ class AddressResolution {
   ~AddressResolution();
 
   void startResolveAddressLoop();
+  void asyncResolveLoop();
+  void symbolicResolveLoop();
   void resolveHostName(char *numeric_ip, char *rsp = NULL, u_int rsp_len = 0);
   bool resolveHost(char *host, char *rsp, u_int rsp_len, bool v4);
 
@@ -46,6 +52,7 @@ class AddressResolution {
   int16_t findAddress(int family, void *addr, u_int8_t *network_mask_bits = NULL);
   void setLocalNetwork(char *net)             { localNetworks.addAddresses(net);           };
   inline void dump()                          { localNetworks.dump(); }
+  void lua(lua_State *vm);
 };
 
 #endif /* _ADDRESS_RESOLUTION_H_ */
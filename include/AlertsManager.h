@@ -26,12 +26,78 @@
 
 class Flow;
 
+/* Entity alert waiting to be written. Strings are owned by the record. */
+typedef struct {
+  time_t tstart, tend;
+  int granularity;
+  AlertType alert_type;
+  char *subtype;
+  AlertLevel alert_severity;
+  AlertEntity alert_entity;
+  char *alert_entity_value, *alert_json;
+  u_int32_t counter; /* Number of equal (not engaged) alerts merged into this record */
+} QueuedAlert;
+
+/* Flow alert waiting to be written. Strings are owned by the record. */
+typedef struct {
+  time_t tstamp;
+  AlertType alert_type;
+  AlertLevel alert_severity;
+  FlowStatus status;
+  char *alert_json;
+  u_int16_t vlan_id;
+  u_int8_t protocol;
+  u_int16_t ndpi_master_protocol, ndpi_app_protocol;
+  char *cli_ip, *srv_ip;
+  char *cli_country, *srv_country;
+  char *cli_os, *srv_os;
+  u_int32_t cli_asn, srv_asn;
+  u_int16_t cli_port, srv_port;
+  bool cli_is_localhost, srv_is_localhost;
+  bool cli_is_blacklisted, srv_is_blacklisted;
+  bool replace_alert;
+  u_int16_t score;
+  u_int64_t first_seen;
+  u_int64_t cli2srv_bytes, srv2cli_bytes;
+  u_int64_t cli2srv_packets, srv2cli_packets;
+} QueuedFlowAlert;
+
+/*
+  Alerts are stored write-behind: callers only queue them, whereas a
+  writer thread stores them in batches, each one in a single transaction
+  and with statements prepared once. Equal (not engaged) alerts queued in
+  the same batch are aggregated before touching the database.
+ */
 class AlertsManager : public StoreManager {
  private:
   char queue_name[CONST_MAX_LEN_REDIS_KEY];
   bool store_opened, store_initialized;
   int openStore();
 
+  /* Write-behind queue (queue_lock) */
+  Mutex queue_lock;
+  vector<QueuedAlert*> *queued_alerts;
+  vector<QueuedFlowAlert*> *queued_flow_alerts;
+  bool make_room_alerts, make_room_flow_alerts;
+  Condvar writer_cond;
+  pthread_t writer_thread;
+  bool writer_created;
+  volatile bool writer_shutdown;
+
+  /* Statements used by the writer thread, prepared once (m) */
+  sqlite3_stmt *alert_update_stmt, *alert_insert_stmt;
+  sqlite3_stmt *flow_alert_select_stmt, *flow_alert_replace_select_stmt;
+  sqlite3_stmt *flow_alert_update_stmt, *flow_alert_insert_stmt;
+
+  int prepareStatements();
+  void finalizeStatements();
+  bool enqueueAlert(QueuedAlert *a, QueuedFlowAlert *fa, bool check_maximum, bool on_flows);
+  u_int32_t writeQueuedAlerts();
+  int writeAlert(QueuedAlert *a);
+  int writeFlowAlert(QueuedFlowAlert *fa);
+  static void freeQueuedAlert(QueuedAlert *a);
+  static void freeQueuedFlowAlert(QueuedFlowAlert *fa);
+
   /* methods used for alerts that have a timespan */
   void markForMakeRoom(bool on_flows);
 
@@ -60,14 +126,20 @@ class AlertsManager : public StoreManager {
   AlertsManager(int interface_id, const char *db_filename);
   ~AlertsManager();
 
+  /*
+    Both methods queue the alert and return immediately, as alerts are written by writerLoop().
+    They return 0 when the alert is queued, 1 when it is dropped as the queue is full, or a negative error.
+   */
   int storeAlert(time_t tstart, time_t tend, int granularity, 
       AlertType alert_type, const char *subtype,
       AlertLevel alert_severity, AlertEntity alert_entity, 
       const char *alert_entity_value,
-      const char *alert_json, bool *new_alert, u_int64_t *rowid,
+      const char *alert_json,
       bool ignore_disabled = false, bool check_maximum = true);
 
-  int storeFlowAlert(lua_State *L, int index, u_int64_t *rowid);
+  int storeFlowAlert(lua_State *L, int index);
+
+  void writerLoop();
 
   static void buildSqliteAllowedNetworksFilters(lua_State *vm);
   static int parseEntityValueIp(const char *alert_entity_value, struct in6_addr *ip_raw);
@@ -0,0 +1,101 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _ASYNC_RESOLVER_H_
+#define _ASYNC_RESOLVER_H_
+
+#include "ntop_includes.h"
+
+/*
+  Non-blocking reverse DNS resolver.
+
+  PTR queries are sent over a single UDP socket to one name server and
+  matched to their responses by query id, so that thousands of queries can
+  be outstanding at once without tying up a thread each. Queries not
+  answered in time are retransmitted and, after the last retry, cached as
+  negative for a short time. Results go to the Redis DNS cache like those
+  of the blocking resolver.
+
+  The resolver is not thread safe: it is driven by a single thread calling
+  resolve() and poll().
+ */
+class AsyncResolver {
+ private:
+  typedef struct {
+    bool in_use;
+    u_int16_t query_id;
+    u_int8_t num_retries;
+    struct timeval sent;
+    char numeric_ip[64];
+  } PendingQuery;
+
+  int sock;
+  struct sockaddr_storage server;
+  socklen_t server_len;
+
+  PendingQuery *queries;
+  u_int32_t max_outstanding, num_outstanding;
+  u_int16_t *query_by_id;          /* Query id -> slot + 1, 0 for unused ids */
+  vector<u_int32_t> free_slots;
+  u_int32_t rand_state;
+
+  /* Rate limiting (token bucket refilled at max_qps) */
+  u_int32_t max_qps;
+  float tokens;
+  struct timeval last_refill;
+
+  u_int64_t num_queries, num_retransmissions, num_resolved, num_negative,
+    num_timeouts, num_send_errors, num_invalid_responses, num_invalid_names, num_cache_hits, num_rate_limited;
+
+  static bool parseServer(const char *server, struct sockaddr_storage *addr, socklen_t *addr_len);
+  static bool getSystemServer(struct sockaddr_storage *addr, socklen_t *addr_len);
+  static int buildPtrName(const char *numeric_ip, char *name, u_int name_len);
+  static int encodeQuery(u_int16_t query_id, const char *ptr_name, u_char *buf, u_int buf_len);
+  static int decodeName(const u_char *msg, int msg_len, int offset, char *name, u_int name_len);
+  static bool isValidHostname(const char *name);
+
+  u_int16_t newQueryId();
+  void refillTokens(const struct timeval *now);
+  bool consumeToken(const struct timeval *now);
+  bool sendQuery(u_int32_t slot, const struct timeval *now);
+  void completeQuery(u_int32_t slot, const char *hostname, u_int negative_expire_secs);
+  void handleResponse(const u_char *msg, int msg_len);
+  void checkTimeouts(const struct timeval *now);
+
+ public:
+  /* server is "ip", "ip:port" or "[ipv6]:port"; NULL to use the first nameserver of /etc/resolv.conf */
+  AsyncResolver(const char *server, u_int32_t _max_outstanding, u_int32_t _max_qps);
+  ~AsyncResolver();
+
+  inline bool isOpen()       const { return(sock >= 0); };
+  /* True when a new query can be sent without exceeding the window or the rate */
+  bool canResolve();
+  /* Starts the resolution of a numeric IP, unless already cached. Returns false for non-numeric addresses. */
+  bool resolve(const char *numeric_ip);
+  /* Reads the responses received within timeout_ms and handles timeouts */
+  void poll(u_int32_t timeout_ms);
+
+  inline u_int32_t getNumOutstanding() const { return(num_outstanding); };
+  void lua(lua_State *vm);
+};
+
+#endif /* _ASYNC_RESOLVER_H_ */
@@ -29,7 +29,7 @@
 class AutonomousSystem : public GenericHashEntry, public GenericTrafficElement, public SerializableElement {
  private:
   u_int32_t asn;
-  char *asname;
+  const char *asname; /* Shared, see Geolocation::getAS() */
   u_int32_t round_trip_time;
 
   inline void incSentStats(time_t t, u_int64_t num_pkts, u_int64_t num_bytes)  {
@@ -50,7 +50,7 @@ class AutonomousSystem : public GenericHashEntry, public GenericTrafficElement,
   inline u_int16_t getNumHosts()               { return getUses();            }
   inline u_int32_t key()                       { return(asn);                 }
   inline u_int32_t get_asn()                   { return(asn);                 }
-  inline char *get_asname()                    { return(asname);              }
+  inline const char *get_asname()              { return(asname);              }
 
   bool equal(u_int32_t asn);
 
@@ -0,0 +1,101 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _BINARY_SERIALIZER_H_
+#define _BINARY_SERIALIZER_H_
+
+#include "ntop_includes.h"
+
+/*
+  Compact binary encoding of the cached elements (see SerializableElement).
+
+  A serialization starts with a two-byte header (BINARY_SERIALIZATION_MAGIC,
+  version) that cannot be mistaken for the beginning of a JSON object, and
+  continues with a list of sections:
+
+    <tag: varint> <payload length: varint> <payload>
+
+  Integers are unsigned LEB128 varints, so that the counters, mostly small,
+  take one or two bytes. Readers skip unknown sections and read the missing
+  trailing fields of a section as zero: fields can be appended to a section,
+  and sections added, without changing the version.
+ */
+class BinarySerializer {
+ private:
+  u_int8_t *buf;
+  u_int32_t len, size;
+  bool failed; /* Out of memory: the serialization is incomplete */
+
+  bool grow(u_int32_t needed);
+
+ public:
+  BinarySerializer(u_int32_t initial_size = BINARY_SERIALIZATION_INITIAL_LEN);
+  ~BinarySerializer();
+
+  void putHeader();
+  inline void putU8(u_int8_t v) { if((len < size) || grow(1)) buf[len++] = v; };
+  void putVarint(u_int64_t v);
+  void putBytes(const void *data, u_int32_t data_len);
+  void putString(const char *s);
+
+  /* Sections are not nested: the value returned by beginSection() is passed to endSection() */
+  u_int32_t beginSection(u_int8_t tag);
+  void endSection(u_int32_t begin);
+
+  inline const u_int8_t* getData() const { return(buf);    };
+  inline u_int32_t getLength()     const { return(len);    };
+  inline bool hasFailed()          const { return(failed); };
+  /* Empties the buffer, keeping its memory for the next serialization */
+  inline void reset()                    { if(buf) len = 0, failed = false; };
+  /* Hands the data over to the caller, that must free() it */
+  u_int8_t* detach();
+};
+
+/* Bounds-checked reader of the BinarySerializer encoding */
+class BinaryDeserializer {
+ private:
+  const u_int8_t *buf;
+  u_int32_t len, offset;
+  bool failed; /* Truncated or corrupted data */
+
+ public:
+  BinaryDeserializer(const u_int8_t *_buf = NULL, u_int32_t _len = 0);
+
+  static bool isBinary(const char *data, u_int32_t data_len);
+  /* False when the header is invalid or written by a newer version */
+  bool readHeader();
+  /* Returns the next section, false at the end of the data or when it is truncated */
+  bool nextSection(u_int8_t *tag, BinaryDeserializer *section);
+
+  u_int8_t getU8();
+  u_int64_t getVarint();
+  const u_int8_t* getBytes(u_int32_t n);
+  /* Reads a string of up to s_len-1 characters, truncating longer ones */
+  bool getString(char *s, u_int32_t s_len);
+
+  inline bool isEmpty()   const { return(offset >= len); };
+  inline bool hasFailed() const { return(failed);        };
+  /* For readers finding values out of range */
+  inline void setFailed()       { failed = true;         };
+};
+
+#endif /* _BINARY_SERIALIZER_H_ */
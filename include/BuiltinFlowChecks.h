@@ -0,0 +1,76 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _BUILTIN_FLOW_CHECKS_H_
+#define _BUILTIN_FLOW_CHECKS_H_
+
+#include "ntop_includes.h"
+
+/*
+  Native implementations of the built-in flow user scripts. Each check
+  mirrors the hooks, filters and scores of the Lua script with the same key
+  under scripts/plugins/alerts.
+ */
+
+#define FLOW_CHECK_HOOK(c)     (1 << (c))
+#define FLOW_CHECK_ALL_HOOKS   (FLOW_CHECK_HOOK(flow_lua_call_protocol_detected) \
+				| FLOW_CHECK_HOOK(flow_lua_call_periodic_update) \
+				| FLOW_CHECK_HOOK(flow_lua_call_idle))
+
+/* security/blacklisted */
+class BlacklistedFlowCheck : public FlowCheck {
+ public:
+  BlacklistedFlowCheck() : FlowCheck("blacklisted", script_category_security,
+				     FLOW_CHECK_HOOK(flow_lua_call_protocol_detected)) {};
+  void protocolDetected(Flow *f, FlowChecksExecutor *e);
+};
+
+/* network/remote_to_remote */
+class RemoteToRemoteFlowCheck : public FlowCheck {
+ public:
+  RemoteToRemoteFlowCheck() : FlowCheck("remote_to_remote", script_category_network,
+					FLOW_CHECK_HOOK(flow_lua_call_protocol_detected)) {};
+  void protocolDetected(Flow *f, FlowChecksExecutor *e);
+};
+
+/* security/web_mining */
+class WebMiningFlowCheck : public FlowCheck {
+ public:
+  WebMiningFlowCheck() : FlowCheck("web_mining", script_category_security,
+				   FLOW_CHECK_HOOK(flow_lua_call_protocol_detected)) {};
+  void protocolDetected(Flow *f, FlowChecksExecutor *e);
+};
+
+/* network/udp_unidirectional */
+class UDPUnidirectionalFlowCheck : public FlowCheck {
+ private:
+  void checkFlow(Flow *f, FlowChecksExecutor *e);
+
+ public:
+  UDPUnidirectionalFlowCheck() : FlowCheck("udp_unidirectional", script_category_network,
+					   FLOW_CHECK_ALL_HOOKS, IPPROTO_UDP) {};
+  void protocolDetected(Flow *f, FlowChecksExecutor *e) { checkFlow(f, e); };
+  void periodicUpdate(Flow *f, FlowChecksExecutor *e)   { checkFlow(f, e); };
+  void flowEnd(Flow *f, FlowChecksExecutor *e)          { checkFlow(f, e); };
+};
+
+#endif /* _BUILTIN_FLOW_CHECKS_H_ */
@@ -59,6 +59,67 @@ public:
   void reset() {
     memset(hll.registers, 0, hll.size); /* A lock might help here... */
   }
+
+  /* Registers are written raw, or only the non-zero ones when most are zero */
+  void serializeBinary(BinarySerializer *s) const {
+    u_int32_t num = 0;
+
+    for(u_int32_t i = 0; hll.registers && (i < hll.size); i++)
+      if(hll.registers[i]) num++;
+
+    s->putU8(hll.bits);
+    s->putVarint(num);
+
+    if(num == 0)
+      return;
+    else if(2 * num < hll.size) {
+      for(u_int32_t i = 0; i < hll.size; i++)
+	if(hll.registers[i]) s->putVarint(i), s->putU8(hll.registers[i]);
+    } else
+      s->putBytes(hll.registers, hll.size);
+  }
+
+  /*
+    Registers written with a different (valid) precision are skipped.
+    Precisions out of range, register counts or indexes exceeding the
+    number of registers mark the data as corrupted.
+  */
+  void deserializeBinary(BinaryDeserializer *d) {
+    u_int8_t bits = d->getU8();
+    u_int64_t num = d->getVarint();
+    u_int32_t size;
+    bool same;
+
+    if(num == 0)
+      return;
+
+    if((bits < CARDINALITY_MIN_BITS) || (bits > CARDINALITY_MAX_BITS)
+       || (num > (u_int64_t)(size = (1u << bits)))) {
+      d->setFailed();
+      return;
+    }
+
+    same = (bits == hll.bits) && (size == hll.size) && hll.registers;
+
+    if(2 * num < size) {
+      for(u_int64_t i = 0; (i < num) && !d->hasFailed(); i++) {
+	u_int64_t idx = d->getVarint();
+	u_int8_t v = d->getU8();
+
+	if(idx >= size)
+	  d->setFailed();
+	else if(same)
+	  hll.registers[idx] = v;
+      }
+
+      /* Do not keep half of a corrupted set */
+      if(same && d->hasFailed()) reset();
+    } else {
+      const u_int8_t *registers = d->getBytes(size);
+
+      if(same && registers) memcpy(hll.registers, registers, size);
+    }
+  }
 };
 
 #endif /* _CARDINALITY_H_ */
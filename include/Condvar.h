@@ -32,6 +32,7 @@ class Condvar {
   pthread_mutex_t mutex;
   pthread_cond_t  condvar;
   bool predicate;
+  std::atomic<bool> waiting; /* Set while a consumer is (about to be) parked, see prepareWait() */
 
   int signal_waiters(bool signal_all);
   
@@ -45,6 +46,26 @@ class Condvar {
 
   inline int signal()    { return(signal_waiters(false)); };
   inline int signalAll() { return(signal_waiters(true));  };
+
+  /*
+    Single consumer parking. The consumer calls prepareWait(), checks again
+    for pending work and only then waits, calling cancelWait() when done.
+    Producers publish their work and call signalIfWaiting(), which costs an
+    atomic load unless the consumer is parked. Only the first producer
+    finding the consumer parked pays for the wakeup.
+   */
+  inline void prepareWait() {
+    waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  };
+  inline void cancelWait() { waiting.store(false, std::memory_order_relaxed); };
+  inline int signalIfWaiting() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiting.load(std::memory_order_relaxed) && waiting.exchange(false))
+      return(signal());
+
+    return(0);
+  };
 };
 
 
@@ -29,7 +29,7 @@ class Country : public GenericHashEntry, public GenericTrafficElement, public Se
   /* Note: country name can be more then 2 chars, see
    * https://www.iso.org/iso-3166-country-codes.html
    */
-  char *country_name;
+  const char *country_name; /* Shared, see Geolocation::internString() */
   NetworkStats dirstats;
 
   inline void incStats(time_t t, u_int64_t num_pkts, u_int64_t num_bytes) {
@@ -44,7 +44,7 @@ class Country : public GenericHashEntry, public GenericTrafficElement, public Se
 
   inline u_int16_t getNumHosts()               { return getUses();            }
   inline u_int32_t key()                       { return Utils::stringHash(country_name); }
-  inline char* get_country_name()              { return country_name; }
+  inline const char* get_country_name()        { return country_name; }
 
   bool equal(const char *country);
   inline bool equal(Country *country)          { return equal(country->get_country_name()); }
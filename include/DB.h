@@ -27,9 +27,11 @@
 class DB {
  private:
   struct timeval lastUpdateTime;
-  float exportRate;
-  u_int64_t exportedFlows, lastExportedFlows;
-  /* Multiple threads can inc in case of view interfaces */
+  float exportRate, dropRate;
+  /* Multiple threads can inc in case of view interfaces or parallel writers */
+  std::atomic<u_int64_t> exportedFlows;
+  u_int64_t lastExportedFlows;
+  u_int32_t lastDroppedFlows;
   std::atomic<u_int32_t> droppedFlows;
   std::atomic<u_int32_t> queueDroppedFlows;
   u_int64_t checkpointExportedFlows;
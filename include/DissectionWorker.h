@@ -0,0 +1,88 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _DISSECTION_WORKER_H_
+#define _DISSECTION_WORKER_H_
+
+#include "ntop_includes.h"
+
+/*
+  A packet dissection worker owns a shard interface (that is, a private
+  flow hash table, see PcapInterface) and a single-producer single-consumer
+  ring of packet copies. The capture thread selects the worker with a
+  symmetric hash of the packet 5-tuple so that both directions of a flow
+  are always dissected by the same thread.
+ */
+class DissectionWorker {
+ private:
+  NetworkInterface *shard;
+  char *name;
+  pthread_t dissectLoop;
+  bool dissectLoopCreated;
+  volatile bool terminating;
+
+  /*
+    Packets are copied back to back as variable-length records (pcap header
+    followed by caplen bytes, padded to 8 bytes) so frames are never cut to
+    a fixed slot size. A record not fitting the end of the ring is preceded
+    by a wrap marker and written at its beginning.
+   */
+  u_int8_t *ring;
+  u_int32_t ring_size;  /* Bytes, power of two */
+  u_int32_t max_caplen; /* Longer packets are truncated */
+  volatile u_int32_t head; /* Bytes written by the capture thread (wraps) */
+  volatile u_int32_t tail; /* Bytes read by the dissection thread (wraps) */
+  Condvar packets_available;
+
+  u_int64_t num_enqueued, num_failed_enqueues, num_dissected;
+
+  inline struct pcap_pkthdr* recordHeader(u_int32_t pos) const { return((struct pcap_pkthdr*)&ring[pos & (ring_size - 1)]); };
+  static inline u_int32_t recordLen(u_int32_t caplen) { return((sizeof(struct pcap_pkthdr) + caplen + 7) & ~7); };
+
+ public:
+  DissectionWorker(NetworkInterface *_shard, u_int32_t queue_len, u_int32_t snaplen);
+  ~DissectionWorker();
+
+  /* Computes a direction-symmetric hash of the packet 5-tuple. Non-IP packets hash to 0. */
+  static u_int32_t packetHash(int datalink_type, const struct pcap_pkthdr *h, const u_char *packet);
+  /* The packetHash() of the packets exchanged by the two endpoints (ports in host byte order) */
+  static u_int32_t tupleHash(const IpAddress *a, u_int16_t a_port,
+			     const IpAddress *b, u_int16_t b_port, u_int8_t l4_proto);
+  /* Parses the packet 5-tuple (ports in host byte order, 0 for fragments and portless protocols). False for non-IP packets. */
+  static bool packetTuple(int datalink_type, const struct pcap_pkthdr *h, const u_char *packet,
+			  IpAddress *src_ip, IpAddress *dst_ip,
+			  u_int16_t *src_port, u_int16_t *dst_port, u_int8_t *l4_proto);
+
+  void startDissection();
+  void stopDissection();
+  void dissectPackets();
+
+  /* Copies the packet into the ring. Called by the capture thread only. */
+  bool enqueue(const struct pcap_pkthdr *h, const u_char *packet);
+
+  inline NetworkInterface* getShard()           const { return(shard);               };
+  inline u_int64_t get_num_failed_enqueues()    const { return(num_failed_enqueues); };
+  inline u_int64_t getQueueDepth()              const { return(num_enqueued - num_dissected); };
+
+  void lua(lua_State *vm) const;
+};
+
+#endif /* _DISSECTION_WORKER_H_ */
@@ -40,6 +40,8 @@ class DnsStats {
   struct dns_stats sent_stats, rcvd_stats;
 
   void deserializeStats(json_object *o, struct dns_stats *stats);
+  void serializeStatsBinary(BinarySerializer *s, const struct dns_stats *stats) const;
+  void deserializeStatsBinary(BinaryDeserializer *d, struct dns_stats *stats);
   json_object* getStatsJSONObject(struct dns_stats *stats);
   void luaStats(lua_State *vm, struct dns_stats *stats, const char *label, bool verbose);
 
@@ -51,6 +53,8 @@ class DnsStats {
 
   char* serialize();
   void deserialize(json_object *o);
+  void serializeBinary(BinarySerializer *s) const;
+  void deserializeBinary(BinaryDeserializer *d);
   json_object* getJSONObject();
   void lua(lua_State *vm, bool verbose);
   bool hasAnomalies(time_t when);
@@ -24,19 +24,61 @@
 
 #include "ntop_includes.h"
 
+class ElasticSearch;
+
+/* Body of a bulk request. Flows are appended by dumpFlow(), then the buffer is posted and reused */
+typedef struct {
+  char *data;
+  u_int32_t len, num_flows;
+  time_t first_flow;
+} ESBulkBuffer;
+
+/* Thread posting bulk requests over its own (kept alive) HTTP connection */
+typedef struct {
+  ElasticSearch *es;
+  u_int8_t id;
+  pthread_t thread;
+  bool thread_created;
+  CURL *curl;
+  struct curl_slist *headers, *gzip_headers;
+  SPSCQueue<ESBulkBuffer*> *ready;     /* Buffers to post, enqueued by dumpFlow() */
+  SPSCQueue<ESBulkBuffer*> *available; /* Posted buffers, dequeued by dumpFlow() */
+#ifdef HAVE_ZLIB
+  z_stream zs;
+  bool zs_inited;
+  char *gzip_buf;
+  u_int32_t gzip_buf_len;
+#endif
+  char *response;                      /* Body of the last _bulk response */
+  u_int32_t response_len;
+  bool response_truncated;
+  u_int64_t num_bulks, num_failed_bulks, num_failed_docs, tot_bulk_msec, bulk_bytes, sent_bytes;
+  u_int32_t max_bulk_msec, last_bulk_msec;
+} ESBulkWriter;
+
 class ElasticSearch : public DB {
  private:
-  pthread_t esThreadLoop;
-  u_int num_queued_elems;
-  struct string_list *head, *tail;
-  Mutex listMutex;
+  ESBulkBuffer buffers[ES_NUM_BULK_BUFFERS];
+  std::atomic<ESBulkBuffer*> current; /* Buffer being filled: whoever swaps it out owns it */
+  ESBulkWriter *writers[ES_MAX_NUM_WRITERS];
+  u_int8_t num_writers, next_writer;
+  std::atomic<u_int64_t> num_queued_flows;
+  std::atomic<bool> template_pushed;
+  Mutex enqueue_lock; /* Only used by views, as all the viewed interfaces dump on the view db */
   bool reportDrops;
+  char bulk_action[96];    /* Action line preceding the flows, naming the index of the current second */
+  u_int32_t bulk_action_len;
+  time_t bulk_action_time;
 
-  char *es_template_push_url, *es_version_query_url;
+  char *es_template_push_url, *es_version_query_url, *es_bulk_base_url;
   char es_version[2];
   const char * const get_es_version();
   const char * const get_es_template();
 
+  ESBulkBuffer* getAvailableBuffer();
+  void enqueueBuffer(ESBulkBuffer *b);
+  bool postBulk(ESBulkWriter *w, ESBulkBuffer *b);
+
  public:
   ElasticSearch(NetworkInterface *_iface);
   ~ElasticSearch();
@@ -46,10 +88,12 @@ class ElasticSearch : public DB {
     return ver && strcmp(ver, "6") >= 0;
   };
   void pushEStemplate();
-  void indexESdata();
+  void* writerLoop(ESBulkWriter *w);
 
   virtual bool dumpFlow(time_t when, Flow *f, char *json);
   virtual void startLoop();
+  virtual void shutdown();
+  virtual void lua(lua_State* vm, bool since_last_checkpoint) const;
 };
 
 
@@ -32,7 +32,7 @@ typedef struct {
   u_int64_t last, next;
 } TCPSeqNum;
 
-class Flow : public GenericHashEntry {
+class Flow : public GenericHashEntry, public PoolAllocated {
  private:
   Host *cli_host, *srv_host;
   IpAddress *cli_ip_addr, *srv_ip_addr;
@@ -323,8 +323,11 @@ class Flow : public GenericHashEntry {
   };
   inline const char* getServerCipherClass()  const { return(isTLS() ? cipher_weakness2str(protos.tls.ja3.server_unsafe_cipher) : NULL); }
   char* serialize(bool use_labels = false);
+  /* Serializes the flow into w, whose buffer is returned (NULL on failure) */
+  char* serialize(JSONStreamWriter *w, bool use_labels);
   void flow2alertJson(ndpi_serializer *serializer, time_t now);
-  json_object* flow2json();
+  void flow2json(JSONStreamWriter *w, bool use_labels);
+  json_object* flow2json(); /* Built by flow2json(JSONStreamWriter*) */
   json_object* flow2es(json_object *flow_object);
   inline u_int8_t getTcpFlags()        const { return(src2dst_tcp_flags | dst2src_tcp_flags);  };
   inline u_int8_t getTcpFlagsCli2Srv() const { return(src2dst_tcp_flags);                      };
@@ -370,6 +373,9 @@ class Flow : public GenericHashEntry {
 
   void updateSeqNum(time_t when, u_int32_t sN, u_int32_t aN);
   void setDetectedProtocol(ndpi_protocol proto_id);
+  /* Protocol and counters of the flow, kept by the tables snapshot (see TablesSnapshot) */
+  void serializeBinaryState(BinarySerializer *s);
+  bool restoreBinaryState(BinaryDeserializer *d);
   void processPacket(const u_char *ip_packet, u_int16_t ip_len, u_int64_t packet_time,
 		     u_int8_t *payload, u_int16_t payload_len);
   void setMatchedPacketPayload(u_int8_t *payload, u_int16_t payload_len);
@@ -486,6 +492,7 @@ class Flow : public GenericHashEntry {
   u_int64_t get_current_packets_srv2cli() const;
 
   bool is_hash_entry_state_idle_transition_ready() const;
+  time_t get_idle_deadline() const;
   void hosts_periodic_stats_update(NetworkInterface *iface, Host *cli_host, Host *srv_host, PartializableFlowTrafficStats *partial, bool first_partial, const struct timeval *tv) const;
   void periodic_stats_update(const struct timeval *tv);
   void  set_hash_entry_id(u_int assigned_hash_entry_id);
@@ -507,7 +514,7 @@ class Flow : public GenericHashEntry {
    *
    * @return Whether the call has been executed successfully or if there were issues during the execution
    */
-  FlowLuaCallExecStatus performLuaCall(FlowLuaCall flow_lua_call, FlowAlertCheckLuaEngine *acle);
+  FlowLuaCallExecStatus performLuaCall(FlowLuaCall flow_lua_call, FlowAlertCheckLuaEngine *acle, FlowChecksExecutor *checks = NULL);
 
   void lua(lua_State* vm, AddressTree * ptree, DetailsLevel details_level, bool asListElement);
   void lua_get_min_info(lua_State* vm);
@@ -42,6 +42,8 @@ class FlowAlertCheckLuaEngine : public AlertCheckLuaEngine {
   void incSkippedPcalls(FlowLuaCall flow_lua_call);
   void incPendingPcalls(FlowLuaCall flow_lua_call);
   void incSuccessfulPcalls(FlowLuaCall flow_lua_call);
+  /* Binds the native checks to the engine and calls setupNativeChecks() in flow.lua */
+  void setupNativeChecks(FlowChecksExecutor *checks);
   virtual void reset_stats();
 };
 
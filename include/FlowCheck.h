@@ -0,0 +1,71 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _FLOW_CHECK_H_
+#define _FLOW_CHECK_H_
+
+#include "ntop_includes.h"
+
+class FlowChecksExecutor;
+
+/*
+  Base class of the flow checks implemented natively. A check takes the key
+  of the flow user script it replaces, so that it is enabled and configured
+  through the same user script configuration, and is executed on the flow
+  without entering the Lua VM.
+ */
+class FlowCheck {
+ private:
+  const char *key;                    /* Key of the flow user script implemented by this check */
+  ScriptCategory category;
+  u_int8_t hooks;                     /* Bitmap of the implemented FlowLuaCall */
+  u_int8_t l4_proto;                  /* 0 for any L4 protocol */
+  u_int16_t periodic_update_divisor;  /* Same as periodic_update_divisor of user scripts */
+  bool enabled;
+
+  u_int64_t num_calls, num_triggered;
+  ticks tot_ticks, max_ticks;
+
+ public:
+  FlowCheck(const char *_key, ScriptCategory _category, u_int8_t _hooks,
+	    u_int8_t _l4_proto = 0, u_int16_t _periodic_update_seconds = 120);
+  virtual ~FlowCheck() {};
+
+  /* Hooks, see scripts/plugins/examples/example/user_scripts/flow/example.lua */
+  virtual void protocolDetected(Flow *f, FlowChecksExecutor *e) {};
+  virtual void periodicUpdate(Flow *f, FlowChecksExecutor *e)   {};
+  virtual void flowEnd(Flow *f, FlowChecksExecutor *e)          {};
+
+  /* Returns true if the check has to be executed on the flow for the given call */
+  bool wantsCall(Flow *f, FlowLuaCall flow_lua_call, u_int32_t periodic_update_ctr) const;
+
+  inline const char* getKey()           const { return(key);      };
+  inline ScriptCategory getCategory()   const { return(category); };
+  inline bool isEnabled()               const { return(enabled);  };
+  inline void setEnabled(bool _enabled)       { enabled = _enabled; };
+
+  inline void incTriggered()                  { num_triggered++; };
+  inline void updateStats(ticks t)            { num_calls++, tot_ticks += t; if(t > max_ticks) max_ticks = t; };
+  void lua(lua_State *vm, ticks tps) const;
+};
+
+#endif /* _FLOW_CHECK_H_ */
@@ -0,0 +1,69 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _FLOW_CHECKS_EXECUTOR_H_
+#define _FLOW_CHECKS_EXECUTOR_H_
+
+#include "ntop_includes.h"
+
+/*
+  Runs the native flow checks of a flow hooks worker. Checks are executed
+  right before the flow Lua hook, which then only runs the user scripts
+  without a native implementation. The predominant status set by the
+  checks is handed over to flow.lua (flow.getNativeChecksStatus()) so that
+  alerts are still triggered and dispatched by the Lua code.
+ */
+class FlowChecksExecutor {
+ private:
+  FlowCheck *checks[MAX_NUM_FLOW_CHECKS];
+  u_int8_t num_checks;
+  ticks tps;
+
+  /* Predominant status set during the last execute() */
+  FlowStatus alerted_status;
+  u_int16_t alerted_status_score;
+  const FlowCheck *alerted_check;
+  char alerted_status_info[FLOW_CHECK_INFO_LEN];
+
+  void registerCheck(FlowCheck *check);
+
+ public:
+  FlowChecksExecutor();
+  ~FlowChecksExecutor();
+
+  void execute(Flow *f, FlowLuaCall flow_lua_call, u_int32_t periodic_update_ctr);
+
+  /* Called by the checks: sets the flow status and scores as flow.triggerStatus() does in flow.lua */
+  void triggerStatus(Flow *f, FlowCheck *check, FlowStatus status,
+		     u_int16_t flow_score, u_int16_t cli_score, u_int16_t srv_score,
+		     const char *status_info = NULL);
+
+  /*
+    Enables the checks whose key is listed in the table at the top of the stack
+    and returns (pushes) the table of the keys that are handled natively
+   */
+  void luaEnableChecks(lua_State *vm);
+  void luaAlertedStatus(lua_State *vm) const;
+  void lua(lua_State *vm) const;
+};
+
+#endif /* _FLOW_CHECKS_EXECUTOR_H_ */
@@ -23,11 +23,51 @@
 #define _FLOW_HASH_H_
 
 #include "ntop_includes.h"
- 
+
+/*
+  Slot of the open-addressing flow index. The fingerprint (key, VLAN and
+  L4 protocol) is compared before dereferencing the flow, so a lookup
+  usually touches a single cache line (four slots per line on 64 bit).
+
+  The index sits next to the GenericHash bucket chains rather than replacing
+  them: walkers, idle purging and lookups from threads other than the packet
+  one still need the locked chains. It costs 16 bytes per slot, with twice
+  as many slots as max flows (rounded to a power of two).
+ */
+typedef struct {
+  u_int32_t key;
+  u_int16_t vlan_id;
+  u_int8_t  protocol;
+  Flow *flow;
+} FlowHashSlot;
+
 class FlowHash : public GenericHash {
+ private:
+  FlowHashSlot *slots;  /**< Linear-probing index used by the inline (packet processing) lookups */
+  u_int32_t slots_mask;
+  u_int8_t slots_shift;
+  u_int64_t num_index_lookups, num_index_probes;
+  u_int32_t max_index_probes;
+
+  /* Fibonacci hashing: spreads the additive flow key over the index */
+  inline u_int32_t indexHome(u_int32_t key) const { return((u_int32_t)(key * 2654435769U) >> slots_shift); };
+  void indexInsert(Flow *f);
+  void indexRemove(Flow *f);
+
+ protected:
+  virtual void onEntryAdded(GenericHashEntry *h);
+  virtual void onEntryDetached(GenericHashEntry *h);
+
  public:
   FlowHash(NetworkInterface *iface, u_int _num_hashes, u_int _max_hash_size);
+  virtual ~FlowHash();
 
+  /**
+   * @brief Find a flow by its tuple.
+   * @details Inline calls are only performed by the thread that adds and purges
+   *          flows, so they use the open-addressing index without locking. Other
+   *          calls walk the (locked) hash buckets.
+   */
   Flow* find(IpAddress *src_ip, IpAddress *dst_ip,
 	     u_int16_t src_port, u_int16_t dst_port,
 	     u_int16_t vlanId, u_int8_t protocol,
@@ -42,6 +82,12 @@ class FlowHash : public GenericHash {
    * @return Pointer of entry that matches with the key parameter, NULL if there isn't entry with the key parameter or if the hash is empty.
    */
   Flow* findByKeyAndHashId(u_int32_t key, u_int hash_id);
+
+  virtual void cleanup();
+
+  inline u_int64_t getNumIndexLookups() const { return(num_index_lookups); };
+  inline u_int64_t getNumIndexProbes()  const { return(num_index_probes);  };
+  inline u_int32_t getMaxIndexProbes()  const { return(max_index_probes);  };
 };
 
 #endif /* _FLOW_HASH_H_ */
@@ -0,0 +1,101 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _FLOW_HOOKS_WORKER_H_
+#define _FLOW_HOOKS_WORKER_H_
+
+#include "ntop_includes.h"
+
+/*
+  Executes the flow user script hooks of an interface on a dedicated thread,
+  with a private Lua engine. An interface runs one or more workers
+  (--flow-hook-threads); flows are assigned to a worker by flow key so that
+  the hooks of a flow are always executed in order by the same thread.
+  Flows of the same host can be handled by different workers: the host
+  score and alert counters updated by the hooks are synchronized.
+ */
+class FlowHooksWorker {
+ private:
+  NetworkInterface *iface;
+  u_int8_t worker_id;
+  char *name;
+  pthread_t hooksLoop;
+  bool hooksLoopCreated;
+
+  /* Queues for the execution of flow user scripts.
+     See scripts/plugins/examples/example/user_scripts/flow/example.lua for the callbacks
+   */
+  SPSCQueue<Flow *> *hookProtocolDetected, *hookPeriodicUpdate, *hookFlowEnd;
+  Condvar hooks_condition;              /* Condition variable used to wait when no flows have been enqueued for hooks exec. */
+  FlowAlertCheckLuaEngine *hooksEngine; /* Lua engine used to execute flow user script hooks */
+  volatile bool hooks_engine_reload;    /* Boolean indicating whether the hooksEngine should be reloaded */
+  FlowChecksExecutor flow_checks;       /* Native checks, executed along with the Lua hooks */
+
+  /*
+    Enqueue time of the flows of a hook queue. Entries are written by the packet thread
+    before the flow is published in the queue and read by the hooks thread in FIFO order.
+   */
+  struct hook_queue_times {
+    u_int64_t *enqueue_usec;
+    u_int32_t mask;
+    u_int64_t num_in, num_out;
+  } protocol_detected_times, periodic_update_times, flow_end_times;
+
+  u_int64_t num_executed_hooks, tot_hooks_usec;  /* Hook execution time */
+  u_int32_t max_hook_usec;
+  u_int64_t tot_queue_latency_usec;               /* Enqueue-to-dequeue time */
+  u_int32_t max_queue_latency_usec;
+
+  static void initQueueTimes(struct hook_queue_times *t, u_int32_t queue_len);
+  static u_int64_t nowUsec();
+
+  /*
+    Dequeues flows from `q` up to `budget` and executes `flow_lua_callback` on each of them.
+    The number of flows dequeued is returned.
+   */
+  u_int64_t dequeueFlows(SPSCQueue<Flow *> *q, struct hook_queue_times *t, FlowLuaCall flow_lua_call, u_int budget);
+
+ public:
+  FlowHooksWorker(NetworkInterface *_iface, u_int8_t _worker_id);
+  ~FlowHooksWorker();
+
+  /* Called by the packet processing thread */
+  bool enqueue(Flow *f);
+
+  /*
+    Dequeues enqueued flows to execute user script callbacks.
+    Budgets indicate how many flows should be dequeued (if available) to perform protocol detected, active,
+    and idle callbacks.
+   */
+  u_int64_t dequeueFlowsForHooks(u_int protocol_detected_budget, u_int active_budget, u_int idle_budget);
+  void hookFlowLoop();
+
+  void startHooks();
+  void stopHooks();
+
+  inline void reloadEngine() { hooks_engine_reload = true; };
+  /* Returns up to max_num queues of the worker */
+  u_int getQueues(const SPSCQueue<Flow *> **queues, u_int max_num) const;
+  void lua(lua_State *vm) const;
+  inline void luaFlowChecks(lua_State *vm) const { flow_checks.lua(vm); };
+};
+
+#endif /* _FLOW_HOOKS_WORKER_H_ */
@@ -35,7 +35,7 @@ class FlowTrafficStats : public PartializableFlowTrafficStats {
   virtual ~FlowTrafficStats();
 
   virtual void incStats(bool cli2srv_direction, u_int num_pkts, u_int pkt_len, u_int payload_len);
-  virtual void setStats(bool cli2srv_direction, u_int num_pkts, u_int pkt_len, u_int payload_len);
+  virtual void setStats(bool cli2srv_direction, u_int num_pkts, u_int64_t pkt_len, u_int64_t payload_len);
 
   const ndpi_analyze_struct* get_analize_struct(bool cli2srv_direction) const;
   
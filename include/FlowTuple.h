@@ -0,0 +1,50 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _FLOW_TUPLE_H_
+#define _FLOW_TUPLE_H_
+
+#include "ntop_includes.h"
+
+/*
+  The 5-tuple of a flow whose packets are looked up in the captured traffic
+  (see TimelineExtract). The hash is only used to find candidate packets:
+  different flows can share it, so packets are matched on the full tuple.
+ */
+class FlowTuple {
+ private:
+  IpAddress cli_ip, srv_ip;
+  u_int16_t cli_port, srv_port; /* Host byte order */
+  u_int8_t l4_proto;
+
+  inline bool hasPorts() const { return((l4_proto == IPPROTO_TCP) || (l4_proto == IPPROTO_UDP) || (l4_proto == 132 /* SCTP */)); };
+
+ public:
+  FlowTuple() { cli_port = srv_port = 0, l4_proto = 0; };
+
+  void set(const char *_cli_ip, u_int16_t _cli_port, const char *_srv_ip, u_int16_t _srv_port, u_int8_t _l4_proto);
+  /* The DissectionWorker::packetHash() of the packets of the flow */
+  u_int32_t hash() const;
+  /* Whether the packet belongs to the flow, in either direction */
+  bool match(int datalink_type, const struct pcap_pkthdr *h, const u_char *packet) const;
+};
+
+#endif /* _FLOW_TUPLE_H_ */
@@ -41,7 +41,8 @@ class GenericHash {
  protected:
   GenericHashEntry **table; /**< Entry table. It is used for maintain an update history */
   char *name;
-  u_int32_t num_hashes; /**< Number of hash */
+  u_int32_t num_hashes; /**< Number of hash buckets (power of two) */
+  u_int32_t hash_mask; /**< num_hashes - 1, used to select the bucket of a key */
   u_int32_t current_size; /**< Current size of hash (including idle or ready-to-purge elements) */
   u_int32_t max_hash_size; /**< Max size of hash */
   u_int32_t upper_num_visited_entries; /**< Max number of entries to purge per run */
@@ -59,6 +60,79 @@ class GenericHash {
   vector<GenericHashEntry*> *idle_entries_in_use;   /**< Vector used by the offline thread in charge to hold idle entries but still in use */
   vector<GenericHashEntry*> *idle_entries;          /**< Vector used by the offline thread in charge of deleting hash table entries */
   vector<GenericHashEntry*> *idle_entries_shadow;   /**< Vector prepared by the purgeIdle and periodically swapped to idle_entries */
+  vector<MemoryPool*> memory_pools;                 /**< Pools the entries (and their members) are allocated from, for stats only */
+
+  TimingWheel *idle_wheel;                          /**< Next visit of the entries (--idle-timing-wheel), NULL when buckets are scanned */
+  Mutex idle_wheel_lock;                            /**< Protects idle_wheel. Taken after the bucket locks */
+  vector<GenericHashEntry*> idle_wheel_expired;     /**< Entries popped from idle_wheel, used by purgeIdle() only */
+  u_int64_t num_idle_wheel_rearms;
+  u_int64_t idle_lag_histogram[IDLE_LAG_HISTOGRAM_SLOTS]; /**< Seconds elapsed between the idle deadline and the actual idle transition */
+  u_int64_t idle_lag_samples;
+  u_int32_t idle_lag_max;
+
+  /**
+   * @brief Called right after an entry has been linked into its bucket.
+   * @details Subclasses keeping auxiliary lookup indexes override it.
+   *
+   * @param h The added entry.
+   */
+  virtual void onEntryAdded(GenericHashEntry *h)    { };
+
+  /**
+   * @brief Called right after an entry has been unlinked from its bucket by purgeIdle().
+   *
+   * @param h The detached entry.
+   */
+  virtual void onEntryDetached(GenericHashEntry *h) { };
+
+  /**
+   * @brief Return the bucket of a key.
+   * @details Keys are expected to be well mixed as only their low bits are used.
+   *
+   * @param key The entry key.
+   * @return The bucket index.
+   */
+  inline u_int32_t bucketId(u_int32_t key) const { return(key & hash_mask); };
+
+  /**
+   * @brief Adds to the lua table on top of the stack the histogram of the bucket chain lengths.
+   *
+   * @param vm A lua VM
+   */
+  void luaChainLengths(lua_State *vm);
+
+  /**
+   * @brief Adds to the lua table on top of the stack the idle expiration stats.
+   *
+   * @param vm A lua VM
+   */
+  void luaIdleExpiration(lua_State *vm);
+
+  /**
+   * @brief Account the delay between the idle deadline of an entry and its actual detach.
+   *
+   * @param h The entry being detached.
+   * @param now The reference time of the idle checks.
+   */
+  void updateIdleLag(GenericHashEntry *h, time_t now);
+
+  /**
+   * @brief Return when idle_wheel should visit an entry next: its idle deadline, or a retry delay when already past it.
+   *
+   * @param h The entry.
+   * @param now The reference time of the idle checks.
+   */
+  time_t nextWheelVisit(GenericHashEntry *h, time_t now) const;
+
+  /**
+   * @brief Detach the entries expired on idle_wheel that are ready to be idled, and re-arm the others at their idle deadline.
+   * @details Periodic updates and housekeeping are left to the bucket walk of purgeIdle(). Must be called by purgeIdle() only.
+   *
+   * @param idle_now The reference time of the idle checks.
+   * @param purge_idle Whether idle entries can be detached.
+   * @return The number of detached entries.
+   */
+  u_int purgeWheelExpired(time_t idle_now, bool purge_idle);
   
  public:
 
@@ -139,11 +213,20 @@ class GenericHash {
    */
   u_int purgeIdle(const struct timeval * tv, bool force_idle);
 
+  /**
+   * @brief Reschedule the idle deadline of an entry, e.g., when it can expire earlier than planned.
+   * @details No-op unless the idle timing wheel is enabled. Entries are otherwise re-armed lazily
+   * when their previous deadline expires, so there is no need to call this on every activity.
+   *
+   * @param h The entry, which must belong to this hash.
+   */
+  void rearmIdle(GenericHashEntry *h);
+
   /**
    * @brief Purge all hash entries.
    *
    */
-  void cleanup();
+  virtual void cleanup();
 
   /**
    * @brief Return the network interface instance associated with the hash.
@@ -161,6 +244,13 @@ class GenericHash {
    */
   inline const char* getName() const { return name; };
 
+  /**
+   * @brief Return the max number of entries of the hash.
+   *
+   * @return The max hash size.
+   */
+  inline u_int32_t getMaxHashSize() const { return(max_hash_size); };
+
   /**
    * @brief Check whether the hash has empty space
    *
@@ -168,15 +258,24 @@ class GenericHash {
    */
   bool hasEmptyRoom();
 
+  /**
+   * @brief Associate a memory pool to the hash so that its stats are reported by lua().
+   * @details The pool is not owned by the hash.
+   *
+   * @param pool The memory pool.
+   */
+  inline void addMemoryPool(MemoryPool *pool) { if(pool) memory_pools.push_back(pool); };
+
   /**
    * @brief Populates a lua table with hash table stats, including
    * the state transitions
    *
    * @param vm A lua VM
+   * @param chain_lengths Also report the chain lengths histogram (walks all the buckets)
    *
    * @return Current size of hash.
    */
-  void lua(lua_State* vm);
+  void lua(lua_State* vm, bool chain_lengths = false);
 
 };
 
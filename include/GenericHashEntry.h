@@ -84,6 +84,7 @@ class GenericHashEntry {
   GenericHashEntry *hash_next; /**< Pointer of next hash entry.*/
   HashEntryState hash_entry_state;
   GenericHash *hash_table;
+  TimingWheelLink wheel_link; /**< Link of the idle timing wheel of the hash table (if enabled) */
 
   /**
    * @brief Set one of the states of the hash entry in its lifecycle.
@@ -149,6 +150,11 @@ class GenericHashEntry {
 
   inline GenericHash* get_hash_table() { return(hash_table); };
 
+  /**
+   * @brief Return the link used by the idle timing wheel of the hash table.
+   */
+  inline TimingWheelLink* get_wheel_link() { return(&wheel_link); };
+
   /**
    * @brief Set and id to uniquely identify this
    * hash entry into the hash table (class GenericHash)
@@ -219,6 +225,15 @@ class GenericHashEntry {
    * 
    */
   virtual bool is_active_entry_now_idle(u_int max_idleness) const;
+
+  /**
+   * @brief Return the earliest time at which is_hash_entry_state_idle_transition_ready()
+   * can become true, assuming no further activity. Used to schedule the idle timing wheel.
+   *
+   */
+  virtual time_t get_idle_deadline() const {
+    return(last_seen + MAX_HASH_ENTRY_IDLE + 1);
+  }
   
   /**
    * @brief Function in charge of updating periodic entry stats (e.g., its throughput or L7 traffic)
@@ -30,7 +30,10 @@ class Geolocation {
   MMDB_s geo_ip_asn_mmdb, geo_ip_city_mmdb;
   bool loadGeoDB(const char * const base_path, const char * const db_name, MMDB_s * const mmdb) const;
   bool mmdbs_ok;
+  u_int8_t getPrefixLen(IpAddress *addr, const MMDB_s * const mmdb, const MMDB_lookup_result_s * const result) const;
+  bool getString(MMDB_entry_s *entry, const char * const *path, char *buf, u_int buf_len) const;
 #endif
+  GeolocationCache cache;
 
 #define TEST_GEOLOCATION 1
 #ifdef TEST_GEOLOCATION
@@ -47,9 +50,11 @@ class Geolocation {
       return(false);
 #endif
   };
-  void getAS(IpAddress *addr, u_int32_t *asn, char **asname);
-  void getInfo(IpAddress *addr, char **continent_code, char **country_code, char **city, float *latitude, float *longitude);
-  static void freeInfo(char **continent_code, char **country_code, char **city);
+  /* Returned strings are shared and must not be freed */
+  void getAS(IpAddress *addr, u_int32_t *asn, const char **asname);
+  void getInfo(IpAddress *addr, const char **continent_code, const char **country_code, const char **city, float *latitude, float *longitude);
+  inline const char* internString(const char *str) { return(cache.internString(str)); };
+  inline void luaCacheStats(lua_State *vm)          { cache.lua(vm); };
 };
 
 #endif /* _GEOLOCATION_H_ */
@@ -0,0 +1,99 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _GEOLOCATION_CACHE_H_
+#define _GEOLOCATION_CACHE_H_
+
+#include "ntop_includes.h"
+
+/*
+  Cache of the geolocation and autonomous system information of the
+  networks returned by the MMDB lookups.
+
+  MMDB networks never overlap, so they are kept as address ranges sorted by
+  their first address: an address is found with a single map search, and
+  the hosts of a network share one entry and one lookup. Strings are
+  interned, and stay valid until the cache is destroyed, so callers can keep
+  the returned pointers and must not free them.
+ */
+class GeolocationCache {
+ public:
+  typedef struct {
+    u_int32_t asn;
+    const char *asname;
+  } ASInfo;
+
+  typedef struct {
+    const char *continent_code, *country_code, *city;
+    float latitude, longitude;
+  } GeoInfo;
+
+ private:
+  typedef struct geo_cache_key {
+    u_int8_t version;
+    u_int64_t hi, lo;
+
+    bool operator<(const struct geo_cache_key &k) const {
+      if(version != k.version) return(version < k.version);
+      if(hi != k.hi)           return(hi < k.hi);
+      return(lo < k.lo);
+    };
+    bool operator<=(const struct geo_cache_key &k) const { return(!(k < *this)); };
+  } GeoCacheKey;
+
+  template <typename T> struct Range {
+    GeoCacheKey last;
+    T info;
+  };
+
+  RwLock lock;
+  std::map<GeoCacheKey, Range<ASInfo> > as_ranges;
+  std::map<GeoCacheKey, Range<GeoInfo> > geo_ranges;
+  std::set<std::string> strings;
+  u_int32_t max_ranges;
+  u_int64_t interned_bytes;
+
+  std::atomic<u_int64_t> as_hits, as_misses, geo_hits, geo_misses, num_flushes;
+  std::atomic<u_int64_t> as_copy_bytes, geo_copy_bytes; /* Memory each lookup used to duplicate */
+
+  static bool getKey(IpAddress *addr, GeoCacheKey *key);
+  static void getRange(IpAddress *addr, u_int8_t prefix_len, GeoCacheKey *first, GeoCacheKey *last);
+  static inline u_int32_t copyBytes(const char *s) { return(s ? (strlen(s) + 1 + 16 /* malloc overhead */) : 0); };
+
+  template <typename T> bool find(std::map<GeoCacheKey, Range<T> > &ranges, IpAddress *addr, T *info);
+  template <typename T> void add(std::map<GeoCacheKey, Range<T> > &ranges, IpAddress *addr, u_int8_t prefix_len, const T *info);
+  const char* intern(const char *str); /* Must be called with lock held for writing */
+
+ public:
+  GeolocationCache(u_int32_t _max_ranges);
+
+  bool findAS(IpAddress *addr, ASInfo *info);
+  bool findGeo(IpAddress *addr, GeoInfo *info);
+  /* Caches the information of the prefix_len bits network of addr. Strings in info are replaced with interned copies. */
+  void addAS(IpAddress *addr, u_int8_t prefix_len, ASInfo *info);
+  void addGeo(IpAddress *addr, u_int8_t prefix_len, GeoInfo *info);
+  const char* internString(const char *str);
+
+  void lua(lua_State *vm);
+};
+
+#endif /* _GEOLOCATION_CACHE_H_ */
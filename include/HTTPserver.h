@@ -37,7 +37,9 @@ class HTTPserver {
   char *wispr_captive_data;
   bool check_ssl_cert(char *ssl_cert_path, size_t ssl_cert_path_len);
   char ports[256], acl_management[64], ssl_cert_path[MAX_PATH], access_log_path[MAX_PATH];
-  char plugins_httpdocs_rewrite[MAX_PATH];
+  char plugins_httpdocs_rewrite[MAX_PATH], num_threads[8];
+  LuaVMPool *vm_pool;
+  PrometheusExporter *metrics_exporter;
   const char *http_binding_addr1, *http_binding_addr2;
   const char *https_binding_addr1, *https_binding_addr2;
   const char *http_options[32];
@@ -65,13 +67,24 @@ class HTTPserver {
   inline char*     get_scripts_dir() { return(scripts_dir);      };
   inline bool      is_ssl_enabled()  { return(ssl_enabled);      };
   inline bool      is_gui_access_restricted() { return(gui_access_restricted); };
-  inline void      start_accepting_requests() { can_accept_requests = true; };
+  void start_accepting_requests();
   bool accepts_requests();
 
   inline const char* getWisprCaptiveData() { return(wispr_captive_data ? wispr_captive_data : ""); }
   inline const char* getCaptiveRedirectAddress() { return(captive_redirect_addr ? captive_redirect_addr : ""); }
   void setCaptiveRedirectAddress(const char*addr);
 
+  /* Lua engines for the HTTP threads, see LuaVMPool */
+  LuaEngine* leaseLuaEngine();
+  void releaseLuaEngine(LuaEngine *l, const char *endpoint,
+			const struct timeval *begin, const struct timeval *end);
+  inline void reloadLuaEngines() { if(vm_pool) vm_pool->reloadVMs(); };
+  void luaEngines(lua_State *vm);
+
+  /* Native /metrics endpoint, see PrometheusExporter */
+  int serveMetrics(struct mg_connection *conn, const char * const username);
+  void luaMetricsExporter(lua_State *vm);
+
 #ifdef HAVE_NEDGE
   void startCaptiveServer();
   void stopCaptiveServer();
@@ -104,6 +104,8 @@ class HTTPstats {
   void incStats(bool as_client, const FlowHTTPStats *fts);
   char* serialize();
   void deserialize(json_object *o);
+  void serializeBinary(BinarySerializer *s) const;
+  void deserializeBinary(BinaryDeserializer *bd);
   json_object* getJSONObject();
 
   void lua(lua_State *vm);
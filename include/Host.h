@@ -24,11 +24,11 @@
 
 #include "ntop_includes.h"
 
-class Host : public GenericHashEntry, public AlertableEntity {
+class Host : public GenericHashEntry, public AlertableEntity, public PoolAllocated {
  protected:
   IpAddress ip;
   Mac *mac;
-  char *asname;
+  const char *asname;
   struct {
     Fingerprint ja3;
     Fingerprint hassh;
@@ -221,7 +221,7 @@ class Host : public GenericHashEntry, public AlertableEntity {
   inline void incNumDroppedFlows()             { stats->incNumDroppedFlows();        }
 
   inline u_int32_t get_asn()             const { return(asn);              }
-  inline char*     get_asname()          const { return(asname);           }
+  inline const char* get_asname()        const { return(asname);           }
   inline AutonomousSystem* get_as()      const { return(as);               }
   inline bool isPrivateHost()            const { return(ip.isPrivateAddress()); }
   bool isLocalInterfaceAddress();
@@ -230,7 +230,9 @@ class Host : public GenericHashEntry, public AlertableEntity {
   char* get_hostkey(char *buf, u_int buf_len, bool force_vlan=false);
   char* get_tskey(char *buf, size_t bufsize);
 
+  u_int32_t getMaxIdle() const;
   bool is_hash_entry_state_idle_transition_ready() const;
+  time_t get_idle_deadline() const { return(last_seen + getMaxIdle() + 1); };
   void periodic_stats_update(const struct timeval *tv);
   virtual void custom_periodic_stats_update(const struct timeval *tv) { ; }
   
@@ -79,11 +79,12 @@ class HostStats: public GenericTrafficElement {
   virtual void computeAnomalyIndex(time_t when) {};
 
   inline Host* getHost() const { return(host); }
-  inline void incNumAlertedFlows(bool as_client)   { if(as_client) alerted_flows_as_client++; else alerted_flows_as_server++; };
-  inline void incNumUnreachableFlows(bool as_server) { if(as_server) unreachable_flows_as_server++; else unreachable_flows_as_client++; }
-  inline void incNumHostUnreachableFlows(bool as_server) { if(as_server) host_unreachable_flows_as_server++; else host_unreachable_flows_as_client++; };
-  inline void incNumFlowAlerts()                     { num_flow_alerts++; };
-  inline void incTotalAlerts(AlertType alert_type)   { total_alerts++;    };
+  /* Alert counters are also increased by the flow hooks workers, which may run concurrently for flows of the same host */
+  inline void incNumAlertedFlows(bool as_client)   { __sync_fetch_and_add(as_client ? &alerted_flows_as_client : &alerted_flows_as_server, 1); };
+  inline void incNumUnreachableFlows(bool as_server) { __sync_fetch_and_add(as_server ? &unreachable_flows_as_server : &unreachable_flows_as_client, 1); };
+  inline void incNumHostUnreachableFlows(bool as_server) { __sync_fetch_and_add(as_server ? &host_unreachable_flows_as_server : &host_unreachable_flows_as_client, 1); };
+  inline void incNumFlowAlerts()                     { __sync_fetch_and_add(&num_flow_alerts, 1); };
+  inline void incTotalAlerts(AlertType alert_type)   { __sync_fetch_and_add(&total_alerts, 1);    };
 
   inline u_int32_t getTotalAlertedNumFlowsAsClient() const { return(alerted_flows_as_client);  };
   inline u_int32_t getTotalAlertedNumFlowsAsServer() const { return(alerted_flows_as_server);  };
@@ -104,6 +105,11 @@ class HostStats: public GenericTrafficElement {
   inline u_int32_t getTotalNumFlowsAsServer() const { return(total_num_flows_as_server);  };
   inline u_int32_t getTotalActivityTime()     const { return(total_activity_time);        };
   virtual void deserialize(json_object *obj)        {}
+  virtual void serializeBinary(BinarySerializer *s) {}
+  /* Restores a section of a binary serialization: false when the section is unknown or corrupted */
+  virtual bool deserializeBinary(u_int8_t tag, BinaryDeserializer *d) { return(false); }
+  /* Adds the traffic counters to those of s, e.g. on top of a restored state */
+  void sum(HostStats *s) const;
   virtual void incNumFlows(bool as_client) { if(as_client) total_num_flows_as_client++; else total_num_flows_as_server++; } ;
   virtual bool hasAnomalies(time_t when) { return false; };
   virtual void luaAnomalies(lua_State* vm, time_t when) {};
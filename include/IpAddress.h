@@ -64,6 +64,7 @@ class IpAddress {
   int compare(const IpAddress * const ip)        const;
   IpAddress* clone();
   inline u_int32_t key()                        const { return(ip_key);         };
+  u_int32_t sortKey() const;
   inline void set(u_int32_t _ipv4)                    { addr.ipVersion = 4, addr.ipType.ipv4 = _ipv4; compute_key(); }
   inline void set(struct ndpi_in6_addr *_ipv6)        { addr.ipVersion = 6, memcpy(&addr.ipType.ipv6, _ipv6, sizeof(struct ndpi_in6_addr));
 							addr.privateIP = false; compute_key(); }
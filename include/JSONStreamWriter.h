@@ -0,0 +1,102 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _JSON_STREAM_WRITER_H_
+#define _JSON_STREAM_WRITER_H_
+
+#include "ntop_includes.h"
+
+#define JSON_STREAM_WRITER_MAX_DEPTH 8
+
+/*
+  Writes JSON straight into a growable buffer, which is reused across
+  documents. The output is byte-identical to json_object_to_json_string()
+  of the equivalent json-c object (JSON_C_TO_STRING_SPACED format), so it
+  can replace json-c trees on hot paths without affecting the consumers.
+  Keys must be unique within an object, as nothing is buffered.
+
+  After resetObject() the same calls build a json-c object instead, so that
+  a field list written once serves both the streaming and the json-c users.
+ */
+class JSONStreamWriter {
+ private:
+  char *buf;
+  u_int32_t len, size;
+  bool failed; /* Out of memory or too deep nesting */
+  u_int8_t depth;
+  bool has_items[JSON_STREAM_WRITER_MAX_DEPTH];
+  char label_buf[16];
+  time_t cached_tstamp;
+  char cached_tstamp_str[32];
+  bool to_object;                                         /* Build a json-c object rather than text */
+  json_object *root, *objects[JSON_STREAM_WRITER_MAX_DEPTH];
+
+  bool grow(u_int32_t needed);
+  inline bool reserve(u_int32_t needed) { return((len + needed < size) || grow(needed)); };
+  inline void append(const char *s, u_int32_t n) {
+    if(reserve(n)) memcpy(&buf[len], s, n), len += n, buf[len] = '\0';
+  };
+  inline void appendChar(char c) { if(reserve(1)) buf[len++] = c, buf[len] = '\0'; };
+  void appendEscaped(const char *s);
+  void appendInt64(int64_t v);
+  void appendDouble(double v);
+  void key(const char *k);
+  void item();
+  void attach(const char *k, json_object *v);
+  void openContainer(const char *k, json_object *c);
+
+ public:
+  JSONStreamWriter(u_int32_t initial_size = 2048);
+  ~JSONStreamWriter();
+
+  /* Starts a new document, keeping the buffer */
+  void reset();
+  /* Starts a new document built as a json-c object, see getObject() */
+  void resetObject();
+
+  void openObject(const char *k = NULL);
+  void closeObject();
+  void openArray(const char *k);
+  void closeArray();
+
+  void addString(const char *k, const char *v);
+  void addInt(const char *k, int32_t v);
+  void addInt64(const char *k, int64_t v);
+  void addDouble(const char *k, double v);
+  void addBool(const char *k, bool v);
+  /* Appends an already encoded JSON value */
+  void addRaw(const char *k, const char *json);
+  /* Array items */
+  void addDouble(double v);
+
+  /* Flow field label: the nProbe template name, or its numeric id (see Utils::jsonLabel) */
+  const char* label(int id, const char *label_str, bool as_string);
+  /* ISO 8601 UTC timestamp with the format used for ElasticSearch, cached per second */
+  const char* timestamp(time_t t);
+
+  /* NULL if the buffer could not grow. Valid until the next reset() */
+  inline char* get() const        { return((failed || to_object) ? NULL : buf); };
+  /* Document built after resetObject(), owned by the caller. NULL on failure */
+  json_object* getObject();
+  inline u_int32_t length() const { return(len);               };
+};
+
+#endif /* _JSON_STREAM_WRITER_H_ */
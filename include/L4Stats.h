@@ -13,6 +13,8 @@ class L4Stats {
   void luaAnomalies(lua_State* vm);
   void serialize(json_object *obj);
   void deserialize(json_object *obj);
+  void serializeBinary(BinarySerializer *s) const;
+  void deserializeBinary(BinaryDeserializer *d);
   void incStats(time_t when, u_int8_t l4_proto,
         u_int64_t rcvd_packets, u_int64_t rcvd_bytes,
         u_int64_t sent_packets, u_int64_t sent_bytes);
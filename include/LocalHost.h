@@ -30,6 +30,7 @@ class LocalHost : public Host, public SerializableElement {
   bool systemHost;
   time_t initialization_time;
   LocalHostStats *initial_ts_point;
+  volatile bool hydration_pending; /* Cached state not merged yet, see LocalHostHydrator */
   
   /* LocalHost data: update LocalHost::deleteHostData when adding new fields */
   OperatingSystem os;
@@ -38,6 +39,10 @@ class LocalHost : public Host, public SerializableElement {
   /* END Host data: */
 
   void initialize();
+  void deserializeLocalHost(json_object *obj);
+  bool deserializeBinaryState(BinaryDeserializer *d, HostStats *s);
+  void restoreMac(const u_int8_t *mac_buf);
+  void resolveName();
   void freeLocalHostData();
   virtual void deleteHostData();
 
@@ -80,6 +85,18 @@ class LocalHost : public Host, public SerializableElement {
   virtual void deserialize(json_object *obj);
   virtual void serialize(json_object *obj, DetailsLevel details_level) { return Host::serialize(obj, details_level); };
   virtual char* getSerializationKey(char *buf, uint bufsize);
+  virtual bool serializeBinary(BinarySerializer *s);
+  virtual bool deserializeBinary(BinaryDeserializer *d);
+
+  /* Restores the cached state of the host and resolves its name, asynchronously
+     when possible. Must be called once the host has been added to the hash table. */
+  void hydrate();
+  /* Called by the LocalHostHydrator thread (or inline when it cannot be used) */
+  SerializedState* loadCachedState();
+  void saveCachedState();
+  /* Merges the restored state (NULL if not cached) with the traffic seen so far */
+  void applyCachedState(SerializedState *state);
+  inline bool isHydrationPending() const { return(hydration_pending); };
 
   virtual void lua(lua_State* vm, AddressTree * ptree, bool host_details,
 		   bool verbose, bool returnHost, bool asListElement);
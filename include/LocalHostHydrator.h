@@ -0,0 +1,90 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _LOCAL_HOST_HYDRATOR_H_
+#define _LOCAL_HOST_HYDRATOR_H_
+
+#include "ntop_includes.h"
+
+class LocalHost;
+
+typedef struct {
+  LocalHost *host;
+  LocalHostHydrationType type;
+  SerializedState *state;      /* Restored state (restore jobs only), NULL if not cached */
+  struct timeval enqueue_time;
+} LocalHostHydrationJob;
+
+/*
+  Performs the local hosts cache operations (Redis GET/SET/DEL and JSON
+  parsing) of an interface on a dedicated thread, so that packet processing
+  never waits for Redis.
+
+  Jobs are enqueued by the thread owning the interface hosts, which holds a
+  reference to the host until the job is done. The state of restored hosts
+  is handed back through a second queue, and merged with the traffic seen in
+  the meantime by the owning thread (see applyCompletions).
+ */
+class LocalHostHydrator {
+ private:
+  NetworkInterface *iface;
+  char *name;
+  pthread_t hydrateLoop;
+  bool hydrateLoopCreated;
+
+  SPSCQueue<LocalHostHydrationJob *> *requests;    /* Owning thread -> hydrator */
+  SPSCQueue<LocalHostHydrationJob *> *completions; /* Hydrator -> owning thread, restore jobs only */
+  u_int32_t num_pending_restores;                  /* Restores not yet applied, bounded by the completions size */
+
+  /* Written by the owning thread */
+  u_int64_t num_restores, num_hydrated, num_restored, num_inline;
+  u_int64_t tot_hydration_usec, tot_apply_usec;
+  u_int32_t max_hydration_usec;
+
+  /* Written by the hydrator thread */
+  u_int64_t num_serialized, num_deleted, num_redis_jobs, tot_redis_usec;
+  u_int32_t max_redis_usec;
+
+  void runJob(LocalHostHydrationJob *job);
+  void releaseJob(LocalHostHydrationJob *job);
+
+ public:
+  LocalHostHydrator(NetworkInterface *_iface);
+  ~LocalHostHydrator();
+
+  /*
+    Called by the thread owning the hosts. Returns false when the job cannot be
+    queued (hydrator not running or queue full): the caller must then perform it inline.
+   */
+  bool enqueue(LocalHost *h, LocalHostHydrationType type);
+  /* Merges a batch of restored states. Called by the thread owning the hosts. */
+  u_int32_t applyCompletions();
+
+  /* Runs a batch of jobs, waiting for at most 1s if there are none */
+  u_int32_t hydrateHosts();
+  void hydrateHostsLoop();
+  void startHydration();
+  void stopHydration();
+
+  void lua(lua_State *vm) const;
+};
+
+#endif /* _LOCAL_HOST_HYDRATOR_H_ */
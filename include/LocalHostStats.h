@@ -60,6 +60,8 @@ class LocalHostStats: public HostStats {
   virtual void updateStats(const struct timeval *tv);
   virtual void getJSONObject(json_object *my_object, DetailsLevel details_level);
   virtual void deserialize(json_object *obj);
+  virtual void serializeBinary(BinarySerializer *s);
+  virtual bool deserializeBinary(u_int8_t tag, BinaryDeserializer *d);
   virtual void lua(lua_State* vm, bool mask_host, DetailsLevel details_level);
 
   virtual void luaDNS(lua_State *vm, bool verbose) const  { if(dns) dns->lua(vm,verbose); }
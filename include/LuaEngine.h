@@ -43,8 +43,11 @@ class LuaEngine {
  protected:
   lua_State *L; /**< The LuaEngine state.*/
   char *loaded_script_path;
+  bool http_ready;              /**< Libraries and classes already loaded by prepareHttp() */
+  struct timeval script_begin;  /**< When handle_script_request() started running the script */
   
   void lua_register_classes(lua_State *L, bool http_mode);
+  void releaseContextResources(struct ntopngLuaContext *ctx);
 
  public:
   /**
@@ -65,6 +68,7 @@ class LuaEngine {
   void setHost(Host* h);
   void setNetwork(NetworkStats* ns);
   void setFlow(Flow*f);
+  void setFlowChecks(FlowChecksExecutor *checks);
 
   /* Set the deadline into the Lua context from an existing vm */
   void setThreadedActivityData(lua_State* from);
@@ -93,6 +97,26 @@ class LuaEngine {
 			    char *script_path, bool *attack_attempt, const char *user, const char *group,
 			    const char *session_csrf, bool localuser);
 
+  /**
+   * @brief Pre-loads libraries and classes for HTTP requests.
+   * @details The global environment is then snapshotted so that resetHttp() can
+   * bring the state back to this point once a request is over.
+   *
+   * @return True on success, false otherwise.
+   */
+  bool prepareHttp();
+
+  /**
+   * @brief Makes a prepared engine ready for the next HTTP request.
+   * @details Globals, standard library tables and loaded modules are restored to the
+   * prepareHttp() snapshot and the ntopng context is cleared.
+   *
+   * @return True on success, false if the engine cannot be reused.
+   */
+  bool resetHttp();
+
+  inline const struct timeval* getScriptBegin() const { return(&script_begin); }
+
   bool setParamsTable(lua_State* vm,
 		      const struct mg_request_info *request_info,
 		      const char* table_name,
@@ -0,0 +1,80 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _LUA_VM_POOL_H_
+#define _LUA_VM_POOL_H_
+
+#include "ntop_includes.h"
+
+/*
+  Pool of pre-initialized Lua engines leased by the HTTP server threads.
+
+  Engines are prepared once (libraries, ntopng classes and a snapshot of
+  the global environment) and reset to that snapshot after every request,
+  so that requests only pay for running their script. Modules required by
+  a script are dropped on reset, as they may capture request data (user,
+  interface, preferences) when loaded.
+
+  The pool also accounts, per endpoint, the time spent preparing the request
+  (environment, session, parameters) and the time spent running the script.
+ */
+class LuaVMPool {
+ private:
+  typedef struct {
+    u_int64_t num_requests, tot_setup_usec, tot_exec_usec;
+    u_int32_t max_setup_usec, max_exec_usec;
+  } EndpointStats;
+
+  typedef struct {
+    u_int32_t generation, num_uses;
+  } EngineInfo;
+
+  Mutex m;
+  vector<LuaEngine*> idle;                /* Engines ready to be leased */
+  std::map<LuaEngine*, EngineInfo> engines; /* Engines owned by the pool, idle or leased */
+  u_int32_t max_idle, generation;
+  u_int64_t num_leases, num_warm_leases, num_created, num_discarded, num_reloads;
+  std::map<std::string, EndpointStats> endpoints;
+
+  LuaEngine* newEngine();
+  void updateEndpointStats(const char *endpoint, const struct timeval *begin,
+			   const struct timeval *script_begin, const struct timeval *end);
+
+ public:
+  LuaVMPool(u_int32_t _max_idle);
+  ~LuaVMPool();
+
+  /* Fills the pool up to its size. Called before the HTTP server accepts requests. */
+  void prewarm();
+  /* Discards all the engines so that new ones are prepared with the current scripts */
+  void reloadVMs();
+
+  /* Returns a ready engine, or NULL when no engine can be allocated */
+  LuaEngine* lease();
+  /* Gives back a leased engine and accounts its request timings */
+  void release(LuaEngine *l, const char *endpoint,
+	       const struct timeval *begin, const struct timeval *end);
+
+  void lua(lua_State *vm);
+};
+
+#endif /* _LUA_VM_POOL_H_ */
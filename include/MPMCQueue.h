@@ -0,0 +1,164 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _MPMC_QUEUE_H_
+#define _MPMC_QUEUE_H_
+
+#include "ntop_includes.h"
+
+/*
+  Lockless fixed-size Multi-Producer Multi-Consumer queue.
+
+  Every cell carries a sequence number telling whether it can be written
+  (sequence == position) or read (sequence == position + 1) by the thread
+  that has reserved that position. Positions are reserved with a CAS on
+  the enqueue/dequeue counters, so threads never block each other.
+*/
+
+template <typename T> class MPMCQueue {
+ private:
+  typedef struct {
+    std::atomic<u_int64_t> sequence;
+    T item;
+  } queue_cell_t;
+
+  queue_cell_t *cells;
+  u_int32_t queue_size, queue_mask;
+  char pad0[64];                       /* Keep the counters on separate cache lines */
+  std::atomic<u_int64_t> enqueue_pos;
+  char pad1[64];
+  std::atomic<u_int64_t> dequeue_pos;
+
+ public:
+  /**
+   * Constructor
+   * @param size The queue size (rounded up to the next power of 2)
+   */
+  MPMCQueue(u_int32_t size) {
+    queue_size = Utils::pow2(size), queue_mask = queue_size - 1;
+
+    if((cells = new (std::nothrow) queue_cell_t[queue_size]) != NULL) {
+      for(u_int32_t i = 0; i < queue_size; i++)
+	cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    enqueue_pos.store(0, std::memory_order_relaxed);
+    dequeue_pos.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Destructor. Items still queued are not released.
+   */
+  ~MPMCQueue() { if(cells) delete[] cells; }
+
+  /**
+   * Push an item
+   * @param item The item to add to the queue
+   * Return true on success, false if there is no room
+   */
+  inline bool enqueue(T item) {
+    u_int64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    queue_cell_t *cell;
+
+    if(!cells) return(false);
+
+    while(true) {
+      int64_t diff;
+
+      cell = &cells[pos & queue_mask];
+      diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)pos;
+
+      if(diff == 0) {
+	if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+	  break;
+      } else if(diff < 0)
+	return(false); /* Full */
+      else
+	pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+    cell->item = item;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    return(true);
+  }
+
+  /**
+   * Pop an item
+   * @param item Receives the item
+   * Return true on success, false if the queue is empty
+   */
+  inline bool dequeue(T *item) {
+    u_int64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    queue_cell_t *cell;
+
+    if(!cells) return(false);
+
+    while(true) {
+      int64_t diff;
+
+      cell = &cells[pos & queue_mask];
+      diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)(pos + 1);
+
+      if(diff == 0) {
+	if(dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+	  break;
+      } else if(diff < 0)
+	return(false); /* Empty */
+      else
+	pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+
+    *item = cell->item;
+    cell->sequence.store(pos + queue_size, std::memory_order_release);
+
+    return(true);
+  }
+
+  /**
+   * Pop up to max_items items
+   * @param items Array receiving the items
+   * @param max_items Size of the items array
+   * Return the number of items dequeued
+   */
+  inline u_int32_t dequeueBulk(T *items, u_int32_t max_items) {
+    u_int32_t num = 0;
+
+    while((num < max_items) && dequeue(&items[num]))
+      num++;
+
+    return(num);
+  }
+
+  /**
+   * Return the (approximate) number of queued items
+   */
+  inline u_int32_t getLength() const {
+    u_int64_t e = enqueue_pos.load(std::memory_order_relaxed), d = dequeue_pos.load(std::memory_order_relaxed);
+
+    return((e > d) ? (u_int32_t)(e - d) : 0);
+  }
+
+  inline u_int32_t getSize() const { return(queue_size); }
+};
+
+#endif /* _MPMC_QUEUE_H_ */
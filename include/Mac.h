@@ -24,7 +24,7 @@
 
 #include "ntop_includes.h"
 
-class Mac : public GenericHashEntry, public SerializableElement {
+class Mac : public GenericHashEntry, public SerializableElement, public PoolAllocated {
  private:
   Mutex m;
   u_int8_t mac[6];
@@ -147,6 +147,9 @@ class Mac : public GenericHashEntry, public SerializableElement {
 
   void deserialize(json_object *obj);
   void serialize(json_object *obj, DetailsLevel details_level);
+  /* Device data and counters, kept by the tables snapshot (see TablesSnapshot) */
+  void serializeBinaryState(BinarySerializer *s);
+  bool restoreBinaryState(BinaryDeserializer *d);
   char* getSerializationKey(char *buf, uint bufsize);
 
   inline u_int64_t  getNumSentArp()  { return(stats->getNumSentArp());      }
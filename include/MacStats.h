@@ -37,6 +37,8 @@ class MacStats: public GenericTrafficElement {
   void lua(lua_State* vm, bool show_details);
   inline void deserialize(json_object *obj)         { GenericTrafficElement::deserialize(obj, iface); }
   inline void getJSONObject(json_object *my_object) { GenericTrafficElement::getJSONObject(my_object, iface); }
+  inline void serializeBinary(BinarySerializer *s) const { sent.serializeBinary(s), rcvd.serializeBinary(s); }
+  inline void deserializeBinary(BinaryDeserializer *d)   { sent.deserializeBinary(d), rcvd.deserializeBinary(d); }
 
   inline u_int64_t  getNumSentArp()   { return (u_int64_t)arp_stats.sent.requests.get() + arp_stats.sent.replies.get(); }
   inline u_int64_t  getNumRcvdArp()   { return (u_int64_t)arp_stats.rcvd.requests.get() + arp_stats.rcvd.replies.get(); }
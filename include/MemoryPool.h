@@ -0,0 +1,130 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _MEMORY_POOL_H_
+#define _MEMORY_POOL_H_
+
+#include "ntop_includes.h"
+
+/*
+  Slab allocator of fixed-size blocks.
+
+  Blocks are carved out of slabs that are never returned to the system
+  until the pool is destroyed. Free blocks are kept on a lock-free stack
+  shared by the allocating (capture) and the releasing (purge) threads.
+  Stack links are block indexes tagged with a modification counter, so a
+  block popped and pushed back meanwhile (ABA) cannot corrupt the stack.
+  The slab lock is only taken to carve a batch of never-used blocks.
+
+  Every block starts with a header pointing to its pool, so that blocks can
+  be released without knowing where they come from. Requests larger than the
+  pool block size fall back to malloc().
+
+  Every block in use holds a reference to the pool, so the pool outlives
+  the objects allocated from it: its owner calls destroy() instead of
+  deleting it, and the pool is deleted with its last block.
+ */
+class MemoryPool {
+ private:
+  char *name;
+  size_t block_size;           /* Object size, excluding the header */
+  u_int32_t blocks_per_slab;   /* Power of two */
+  u_int8_t slab_shift;
+
+  Mutex slab_lock;
+  u_int8_t **slabs[MEMORY_POOL_MAX_SLABS >> 8]; /* Two levels, 256 slabs per chunk */
+  u_int32_t num_slabs;         /* Written under slab_lock */
+  u_int32_t num_carved;        /* Blocks taken out of the slabs (slab_lock) */
+
+  std::atomic<u_int64_t> free_head;   /* Tag (high 32 bits) and index + 1 of the first free block */
+  std::atomic<u_int64_t> refs;        /* Blocks in use, plus one for the owner */
+  std::atomic<u_int64_t> num_allocations, num_fallbacks;
+
+  ~MemoryPool();
+
+  inline u_int8_t* blockAddress(u_int32_t idx) const {
+    u_int32_t slab = idx >> slab_shift;
+
+    return(&slabs[slab >> 8][slab & 0xFF][(idx & (blocks_per_slab - 1)) * (MEMORY_POOL_HEADER_LEN + block_size)]);
+  };
+  bool addSlab();
+  void* carveBlocks();
+  void* getBlock();
+  void  pushBlocks(u_int32_t first_idx, void *last);
+  void  putBlock(void *block);
+
+ public:
+  MemoryPool(const char *_name, size_t _block_size, u_int32_t _blocks_per_slab);
+  /* Drops the owner reference: the pool is deleted once no block is in use */
+  void destroy();
+
+  /* Allocates size bytes from pool, or from malloc() when pool is NULL or the block does not fit */
+  static void* allocate(MemoryPool *pool, size_t size);
+  /* Releases memory returned by allocate() */
+  static void  release(void *ptr);
+
+  /*
+    Members of pooled objects, not deriving from PoolAllocated: constructed
+    in place in a block of pool, NULL on allocation failure, and destroyed
+    with dispose()
+   */
+  template <typename T> static T* create(MemoryPool *pool) {
+    void *ptr = allocate(pool, sizeof(T));
+
+    return(ptr ? new (ptr) T() : NULL);
+  };
+  template <typename T> static T* create(MemoryPool *pool, const T &obj) {
+    void *ptr = allocate(pool, sizeof(T));
+
+    return(ptr ? new (ptr) T(obj) : NULL);
+  };
+  template <typename T> static void dispose(T *obj) {
+    if(obj) {
+      obj->~T();
+      release(obj);
+    }
+  };
+
+  inline const char* getName() const { return(name); };
+  void lua(lua_State *vm);
+};
+
+/*
+  Base class of the hash entries (Flow, Host, Mac) allocated from a
+  MemoryPool with new (pool) T(...) or new (pool, std::nothrow) T(...).
+  Plain new and delete keep working, so the base can be added to existing
+  classes. Other classes are pooled with MemoryPool::create() instead, so
+  that their layout and allocations are left unchanged.
+ */
+class PoolAllocated {
+ public:
+  static void* operator new(size_t size);
+  static void* operator new(size_t size, const std::nothrow_t&) throw();
+  static void* operator new(size_t size, MemoryPool *pool);
+  static void* operator new(size_t size, MemoryPool *pool, const std::nothrow_t&) throw();
+
+  static void operator delete(void *ptr);
+  static void operator delete(void *ptr, const std::nothrow_t&);
+  static void operator delete(void *ptr, MemoryPool *pool);
+  static void operator delete(void *ptr, MemoryPool *pool, const std::nothrow_t&);
+};
+
+#endif /* _MEMORY_POOL_H_ */
@@ -24,17 +24,39 @@
 
 #include "ntop_includes.h"
 
+class MySQLDB;
+
+/* Row of a multi-row INSERT, allocated by dumpFlow() and freed by the writer */
+typedef struct {
+  bool ipv6;
+  char values[1]; /* VALUES tuple, allocated along with the row */
+} MySQLRow;
+
+/* A MySQL connection inserting batches of rows, on a dedicated thread */
+typedef struct {
+  MySQLDB *db;
+  u_int8_t id;
+  MYSQL conn;
+  bool connected;
+  pthread_t thread;
+  bool thread_created;
+  SPSCQueue<MySQLRow*> *rows;
+  u_int64_t num_batches;
+} MySQLWriter;
+
 class MySQLDB : public DB {
  protected:
   MYSQL mysql;
-  MYSQL mysql_alt;
-  bool db_operational, mysql_alt_connected;
+  bool db_operational;
   FILE *log_fd;
-  u_int32_t mysqlEnqueuedFlows;
   Mutex m;
+  Mutex enqueue_lock; /* Only used by views, as all the viewed interfaces dump on the view db */
+
+  MySQLWriter *writers[MYSQL_MAX_NUM_WRITERS];
+  u_int8_t num_writers;
+  u_int32_t batch_size;
 
   static volatile bool db_created;
-  pthread_t queryThreadLoop;
 
   bool connectToDB(MYSQL *conn, bool select_db);
   void open_log();
@@ -42,6 +64,7 @@ class MySQLDB : public DB {
   int exec_sql_query(MYSQL *conn, const char *sql, bool doReconnect = true,
 		     bool ignoreErrors = false, bool doLock = true);
   void try_exec_sql_query(MYSQL *conn, char *sql);
+  bool execBatch(MySQLWriter *w, char *sql, u_int32_t num_rows);
   virtual bool createDBSchema(bool set_db_created = true);
   bool createNprobeDBView();
 
@@ -49,8 +72,9 @@ class MySQLDB : public DB {
   MySQLDB(NetworkInterface *_iface);
   virtual ~MySQLDB();
 
-  virtual void* queryLoop();
+  virtual void* writerLoop(MySQLWriter *w);
   virtual bool dumpFlow(time_t when, Flow *f, char *json);
+  virtual void lua(lua_State* vm, bool since_last_checkpoint) const;
 
   void disconnectFromDB(MYSQL *conn);
   static volatile bool isDbCreated() { return db_created; };
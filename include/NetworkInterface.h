@@ -30,7 +30,11 @@
 
 class Flow;
 class FlowHash;
+class FlowHooksWorker;
+class LocalHostHydrator;
+class PacketRecorder;
 class Host;
+class LocalHost;
 class HostHash;
 class Mac;
 class MacHash;
@@ -43,7 +47,7 @@ class CountriesHash;
 class DB;
 class Paginator;
 class NetworkInterfaceTsPoint;
-class ViewInterface;
+class PartializableFlowTrafficStats;
 
 #ifdef NTOPNG_PRO
 class L7Policer;
@@ -86,11 +90,6 @@ class NetworkInterface : public AlertableEntity {
   Condvar dump_condition; /* Condition variable used to wait when no flows have been enqueued for dump */
   
 
-  /* Queues for the execution of flow user scripts.
-     See scripts/plugins/examples/example/user_scripts/flow/example.lua for the callbacks
-   */
-  SPSCQueue<Flow *> *hookProtocolDetected, *hookPeriodicUpdate, *hookFlowEnd;
-
   /*
     Flag to indicate whether a flow JSON should be dumped along with the flow. Flow JSON contain
     additional fields not placed inside database columns.
@@ -101,6 +100,7 @@ class NetworkInterface : public AlertableEntity {
     JSON. If this flag is false, flow fields are keyed with nProbe integer flow keys.
    */
   bool flows_dump_json_use_labels;
+  JSONStreamWriter *flows_dump_json_writer; /* Reused by the flow dump thread for all the flows */
 
   /* Queue containing the ip@vlan strings of the hosts to restore. */
   FifoStringsQueue *hosts_to_restore;
@@ -114,7 +114,7 @@ class NetworkInterface : public AlertableEntity {
   Mutex external_alerts_lock;
 
   bool is_view;                  /* Whether this is a view interface */
-  ViewInterface *viewed_by;      /* Whether this interface is 'viewed' by a ViewInterface */
+  NetworkInterface *viewed_by;   /* Whether this interface is 'viewed' by a ViewInterface (or is a shard of a PcapInterface) */
   u_int8_t viewed_interface_id;  /* When this is a 'viewed' interface, this id represents a unique interface identifier inside the view */
 
   /* Disaggregations */
@@ -140,10 +140,10 @@ class NetworkInterface : public AlertableEntity {
   Mutex active_captures_lock;
   u_int8_t num_live_captures;
   struct ntopngLuaContext *live_captures[MAX_NUM_PCAP_CAPTURES];
-  static bool matchLiveCapture(struct ntopngLuaContext * const luactx,
-			       const struct pcap_pkthdr * const h,
-			       const u_char * const packet,
-			       Flow * const f);
+  bool matchLiveCapture(struct ntopngLuaContext * const luactx,
+			const struct pcap_pkthdr * const h,
+			const u_char * const packet,
+			Flow * const f);
   void deliverLiveCapture(const struct pcap_pkthdr * const h, const u_char * const packet, Flow * const f);
 
   string ip_addresses;
@@ -171,15 +171,18 @@ class NetworkInterface : public AlertableEntity {
   LocalTrafficStats localStats;
   int pcap_datalink_type; /**< Datalink type of pcap. */
   pthread_t pollLoop,
-    flowDumpLoop /* Thread for the database dump of flows */,
-    hookLoop /* Thread for the execution of flow user script hooks */;
-  FlowAlertCheckLuaEngine *hooksEngine;   /* Lua engine used to execute flow user script hooks */
-  volatile bool hooks_engine_reload;      /* Boolean indicating whether the hooksEngine should be reloaded */
-  time_t        hooks_engine_next_reload; /* The minimunm time for the next reload of the hooksEngine */
-  Condvar       hooks_condition;          /* Condition variable used to wait when no flows have been enqueued for hooks exec. */
-  bool pollLoopCreated, flowDumpLoopCreated, hookLoopCreated;
+    flowDumpLoop /* Thread for the database dump of flows */;
+  FlowHooksWorker *hook_workers[MAX_NUM_FLOW_HOOK_THREADS]; /* Threads for the execution of flow user script hooks */
+  u_int8_t      num_hook_workers;
+  LocalHostHydrator *host_hydrator; /* Thread for the local hosts cache operations */
+  PacketRecorder *recorder;          /* Continuous packet recorder (--packet-recorder) */
+  time_t        hooks_engine_next_reload; /* The minimunm time for the next reload of the hooks engines */
+  bool pollLoopCreated, flowDumpLoopCreated;
   bool has_too_many_hosts, has_too_many_flows, mtuWarningShown;
   bool flow_dump_disabled;
+  bool restoring_snapshot; /* Set while the tables snapshot is loaded, see TablesSnapshot */
+  Mutex snapshot_lock;     /* Serializes the snapshot saves (periodic scripts and shutdown) */
+  bool final_snapshot_saved;
   u_int32_t ifSpeed, numL2Devices, numHosts, numLocalHosts, scalingFactor;
   /* Those will hold counters at checkpoints */
   u_int64_t checkpointPktCount, checkpointBytesCount, checkpointPktDropCount;
@@ -214,6 +217,10 @@ class NetworkInterface : public AlertableEntity {
 
   /* Hosts */
   HostHash *hosts_hash; /**< Hash used to store hosts information. */
+
+  /* Slab pools of the hash entries and of their fixed-size members */
+  MemoryPool *flows_pool, *hosts_pool, *macs_pool;
+  MemoryPool *ip_addresses_pool, *icmp_info_pool, *interarrival_pool;
   bool purge_idle_flows_hosts, inline_interface;
   DB *db;
   StatsManager  *statsManager;
@@ -261,7 +268,7 @@ class NetworkInterface : public AlertableEntity {
 		const AddressTree * const cidr_filter,
 		u_int8_t ipver_filter, int proto_filter,
 		TrafficType traffic_type_filter,
-		char *sortColumn);
+		char *sortColumn, u_int32_t max_sorted_entries, bool a2zSortOrder);
   int sortASes(struct flowHostRetriever *retriever,
 	       char *sortColumn);
   int sortCountries(struct flowHostRetriever *retriever,
@@ -282,7 +289,7 @@ class NetworkInterface : public AlertableEntity {
 		AddressTree *allowed_hosts,
 		Host *host,
 		Paginator *p,
-		const char *sortColumn);
+		const char *sortColumn, u_int32_t max_sorted_entries);
 
   bool isNumber(const char *str);
   bool checkIdle();
@@ -301,11 +308,6 @@ class NetworkInterface : public AlertableEntity {
     ethStats.incProtoStats(proto, num_pkts, num_bytes);
   };
 
-  /*
-    Dequeues flows from `q` up to `budget` and executes `flow_lua_callback` on each of them.
-    The number of flows dequeued is returned.
-   */
-  u_int64_t dequeueFlows(SPSCQueue<Flow *> *q, FlowLuaCall flow_lua_call, u_int budget);
   /*
     The lua engine for the execution of user script flow hooks is reused. This function
     periodically check and possibly decides to reload the engine.
@@ -378,6 +380,9 @@ class NetworkInterface : public AlertableEntity {
   virtual const char* get_type()    const      { return(customIftype ? customIftype : CONST_INTERFACE_TYPE_UNKNOWN); }
   virtual InterfaceType getIfType() const      { return(interface_type_UNKNOWN); }
   inline FlowHash *get_flows_hash()            { return flows_hash;     }
+  inline MemoryPool* getIpAddressesPool()      { return(ip_addresses_pool); }
+  inline MemoryPool* getICMPinfoPool()         { return(icmp_info_pool);    }
+  inline MemoryPool* getInterarrivalPool()     { return(interarrival_pool); }
   inline TcpFlowStats* getTcpFlowStats()       { return(&tcpFlowStats); }
   virtual bool is_ndpi_enabled() const         { return(true);          }
   inline u_int  getNumnDPIProtocols()          { return(ndpi_get_num_supported_protocols(get_ndpi_struct())); };
@@ -417,22 +422,41 @@ class NetworkInterface : public AlertableEntity {
     Enqueue flows for the execution of periodic scripts
    */
   bool hookEnqueue(time_t t, Flow *f);
+  /* Called by the thread owning the hosts: false means that the job must be run inline */
+  bool enqueueHostHydration(LocalHost *h, LocalHostHydrationType type);
   /*
     Enqueue flows to be processed by the view interfaces.
     Viewed interface enqueue flows using this method so that the view
     can periodicall dequeue them and update its statistics;
    */
   bool viewEnqueue(time_t t, Flow *f);
+  /* Implemented by the interfaces viewing other interfaces, see setViewed() */
+  virtual bool viewEnqueue(time_t t, Flow *f, u_int8_t viewed_interface_id) { return(false); };
+  /* Accounts the traffic of a flow of a viewed interface to the hosts of this interface */
+  bool viewedFlowHostsUpdate(Flow *f, const struct timeval *tv, PartializableFlowTrafficStats *partials);
+  /* Whether the flows walked by this interface belong to viewed interfaces */
+  virtual bool hasViewedFlows() const { return(isView()); };
 #ifdef NTOPNG_PRO
   void flushFlowDump();
 #endif
   void checkPointHostTalker(lua_State* vm, char *host_ip, u_int16_t vlan_id);
   int dumpLocalHosts2redis(bool disable_purge);
+  /* Warm-restart snapshot of the flow, host and MAC tables (see TablesSnapshot) */
+  bool saveTablesSnapshot(bool final = false /* At shutdown: no later snapshot is saved */);
+  bool restoreTablesSnapshot();
+  inline bool isRestoringSnapshot() const { return(restoring_snapshot); };
+  inline PacketRecorder* getPacketRecorder() const { return(recorder); };
+  Host* restoreHost(Mac *mac, u_int16_t vlan_id, IpAddress *ip);
+  Flow* restoreFlow(u_int16_t vlan_id, u_int8_t l4_proto,
+		    Mac *cli_mac, IpAddress *cli_ip, u_int16_t cli_port,
+		    Mac *srv_mac, IpAddress *srv_ip, u_int16_t srv_port,
+		    time_t first_seen, time_t last_seen);
   inline void incRetransmittedPkts(u_int32_t num)   { tcpPacketStats.incRetr(num);      };
   inline void incOOOPkts(u_int32_t num)             { tcpPacketStats.incOOO(num);       };
   inline void incLostPkts(u_int32_t num)            { tcpPacketStats.incLost(num);      };
   inline void incKeepAlivePkts(u_int32_t num)       { tcpPacketStats.incKeepAlive(num); };
   virtual void checkPointCounters(bool drops_only);
+  bool initSubInterface(NetworkInterface *sub_iface);
   bool registerSubInterface(NetworkInterface *sub_iface, u_int64_t criteria);
   u_int32_t checkDroppedAlerts();
 
@@ -560,9 +584,14 @@ class NetworkInterface : public AlertableEntity {
   void updateFlowPeriodicity(Flow *f);
   void updateServiceMap(Flow *f);  
 #endif
-  void lua_hash_tables_stats(lua_State* vm);
+  /* Fill gh with up to max_num hash tables of the interface, returning their number */
+  u_int getHashTables(GenericHash **gh, u_int max_num) const;
+  /* Fill queues with up to max_num flow queues (dump and hooks) of the interface, returning their number */
+  u_int getFlowQueues(const SPSCQueue<Flow *> **queues, u_int max_num) const;
+  void lua_hash_tables_stats(lua_State* vm, bool chain_lengths);
   void lua_periodic_activities_stats(lua_State* vm);
   virtual void lua_queues_stats(lua_State* vm);
+  void lua_flow_checks_stats(lua_State* vm);
   void getnDPIProtocols(lua_State *vm, ndpi_protocol_category_t filter, bool skip_critical);
 
   int getActiveHostsList(lua_State* vm,
@@ -680,6 +709,7 @@ class NetworkInterface : public AlertableEntity {
   void addAllAvailableInterfaces();
   inline bool idle() { return(is_idle); }
   inline u_int16_t getMTU()         { return(ifMTU);                               }
+  inline void setMTU(u_int16_t mtu) { ifMTU = mtu;                                 }
   virtual u_int getPacketOverhead() { return 24 /* 8 Preamble + 4 CRC + 12 IFG */; }
   inline void setIdleState(bool new_state)         { is_idle = new_state;  };
   inline StatsManager  *getStatsManager()          { return statsManager;  };
@@ -696,6 +726,7 @@ class NetworkInterface : public AlertableEntity {
 
   bool registerLiveCapture(struct ntopngLuaContext * const luactx, int *id);
   bool deregisterLiveCapture(struct ntopngLuaContext * const luactx);
+  void sendLiveCapture(struct ntopngLuaContext * const luactx);
   void dumpLiveCaptures(lua_State* vm);
   bool stopLiveCapture(int capture_id);
 #ifdef NTOPNG_PRO
@@ -780,7 +811,7 @@ class NetworkInterface : public AlertableEntity {
   virtual bool areTrafficDirectionsSupported() { return(false); };
 
   inline bool isView()                const { return is_view;             };
-  inline ViewInterface*    viewedBy() const { return viewed_by;           };
+  inline NetworkInterface* viewedBy() const { return viewed_by;           };
   inline u_int8_t       getViewedId() const { return viewed_interface_id; };
   inline bool isViewed()              const { return viewedBy() != NULL;  };
   /*
@@ -788,7 +819,7 @@ class NetworkInterface : public AlertableEntity {
     The view passes to this method both its pointer and the viewed interface id,
     that is, a numeric identifier for the viewed interface inside the view interface.
    */
-  inline void setViewed(ViewInterface *view_iface, u_int8_t _viewed_interface_id) {
+  inline void setViewed(NetworkInterface *view_iface, u_int8_t _viewed_interface_id) {
     viewed_by = view_iface;
     viewed_interface_id = _viewed_interface_id;
   };
@@ -890,7 +921,7 @@ class NetworkInterface : public AlertableEntity {
   inline bool hasAlerts()                                 { return(has_stored_alerts || (getNumEngagedAlerts() > 0)); }
   inline void refreshHasAlerts()                          { has_stored_alerts = alertsManager ? alertsManager->hasAlerts() : false; }
   inline void incNumDroppedAlerts(u_int32_t num_dropped)  { num_dropped_alerts += num_dropped; }
-  inline void incNumWrittenAlerts()			  { num_written_alerts++; }
+  inline void incNumWrittenAlerts(u_int32_t num = 1)	  { num_written_alerts += num; }
   inline void incNumAlertsQueries()			  { num_alerts_queries++; }
   inline u_int64_t getNumDroppedAlerts()		  { return(num_dropped_alerts); }
   inline u_int64_t getNumWrittenAlerts()		  { return(num_written_alerts); }
@@ -910,19 +941,12 @@ class NetworkInterface : public AlertableEntity {
   inline u_int32_t getNumEngagedAlerts()    const         { return num_alerts_engaged; };
   void releaseAllEngagedAlerts();
 
-  virtual void hookFlowLoop(); /* Body of the loop that dequeues flows for the execution of user script hooks */
   virtual void dumpFlowLoop(); /* Body of the loop that dequeues flows for the database dump */
   void incNumQueueDroppedFlows(u_int32_t num);
   /*
     Dequeues enqueued flows to dump them to database
    */
   u_int64_t dequeueFlowsForDump(u_int idle_flows_budget, u_int active_flows_budget);
-  /*
-    Dequeues enqueued flows to execute user script callbacks.
-    Budgets indicate how many flows should be dequeued (if available) to perform protocol detected, active,
-    and idle callbacks.
-   */
-  virtual u_int64_t dequeueFlowsForHooks(u_int protocol_detected_budget, u_int active_budget, u_int idle_budget);
 };
 
 #endif /* _NETWORK_INTERFACE_H_ */
@@ -235,6 +235,8 @@ class Ntop {
     return address->resolveHost(host, rsp, rsp_len, v4);
   }
 
+  inline void lua_resolver_stats(lua_State *vm) { address->lua(vm); }
+
   /**
    * @brief Get the geolocation instance.
    *
@@ -377,6 +379,7 @@ class Ntop {
   void checkSystemScripts(ScriptPeriodicity p, lua_State *vm);
   void checkSNMPDeviceAlerts(ScriptPeriodicity p, lua_State *vm);
   void lua_periodic_activities_stats(NetworkInterface *iface, lua_State* vm);
+  inline PeriodicActivities* getPeriodicActivities() { return(pa); };
   void getUsers(lua_State* vm);
   bool isUserAdministrator(lua_State* vm);
   void getAllowedInterface(lua_State* vm);
@@ -468,7 +471,11 @@ class Ntop {
   inline FifoSerializerQueue* getInternalAlertsQueue()    { return(internal_alerts_queue);  }
   void lua_alert_queues_stats(lua_State* vm);
   bool  recipient_enqueue(u_int16_t recipient_id, RecipientNotificationPriority prio, const char * const notification);
-  char* recipient_dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio);
+  u_int32_t recipients_enqueue(const u_int16_t *recipient_ids, u_int32_t num_recipients,
+			       RecipientNotificationPriority prio, const char * const notification);
+  RecipientNotification* recipient_dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio);
+  u_int32_t recipient_dequeue_bulk(u_int16_t recipient_id, RecipientNotificationPriority prio,
+				   RecipientNotification **notifications, u_int32_t max_notifications);
   void recipient_stats(u_int16_t recipient_id, lua_State* vm);
   void recipient_delete(u_int16_t recipient_id);
   void recipient_register(u_int16_t recipient_id);
@@ -0,0 +1,117 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _PACKET_RECORDER_H_
+#define _PACKET_RECORDER_H_
+
+#include "ntop_includes.h"
+
+/*
+  Index of a segment being recorded. It is built by the capture thread and
+  handed over to the writer, that saves it next to the segment once complete.
+ */
+class PacketRecorderSegment {
+ public:
+  u_int32_t id;
+  u_int32_t first_ts, last_ts;
+  u_int64_t pcap_len;  /* Including the pcap file header */
+  u_int32_t ring_end;  /* Ring position of the end of the segment */
+  vector<recorder_time_entry> time_index;
+  vector<recorder_flow_entry> flow_index;
+
+  PacketRecorderSegment(u_int32_t _id);
+  /* Adds the packet recorded at pcap_len */
+  void addPacket(u_int32_t sec, u_int32_t flow_hash, u_int32_t len);
+};
+
+/*
+  Continuous packet recorder of an interface (--packet-recorder).
+
+  The capture thread copies the packets into a large preallocated PcapRing
+  and indexes them, whereas a writer thread saves the ring content with
+  batched writes into pcap segments of PACKET_RECORDER_SEGMENT_LEN bytes
+  under <pcap dir>/<ifid>/recorder. When a segment is complete the writer
+  saves its sidecar index (<id>.idx), with the file offset of the first
+  packet of every second and the offsets of the packets by flow hash, and
+  deletes the oldest segments exceeding the configured store size.
+
+  Packets are read back with a PacketRecorderReader.
+ */
+class PacketRecorder {
+ private:
+  NetworkInterface *iface;
+  char dir[MAX_PATH];
+  u_int64_t max_bytes;
+  PcapRing *ring;
+  SPSCQueue<PacketRecorderSegment*> *completed_segments;
+  pthread_t writerLoop;
+  bool writerLoopCreated;
+  volatile bool terminating;
+
+  /* Capture thread */
+  PacketRecorderSegment *cur_segment;
+  u_int32_t next_segment_id;
+  u_int64_t num_recorded, num_dropped;
+
+  /* Writer thread */
+  int fd;
+  volatile u_int32_t writing_segment_id;
+  volatile u_int64_t written_len; /* Of the segment being written, read by the extractions */
+  u_int64_t num_written_bytes, tot_write_usec, num_write_errors;
+
+  /* Completed segments, oldest first */
+  Mutex catalog_lock;
+  vector<recorder_segment_info> catalog;
+  u_int64_t catalog_bytes;
+
+  bool openSegment();
+  void completeSegment(PacketRecorderSegment *s);
+  bool writeIndex(PacketRecorderSegment *s);
+  bool readIndexHeader(u_int32_t id, recorder_segment_info *info);
+  bool rebuildIndex(u_int32_t id);
+  void loadCatalog();
+  void purgeOldSegments();
+
+ public:
+  PacketRecorder(NetworkInterface *_iface, u_int64_t _max_bytes);
+  ~PacketRecorder();
+
+  void startRecording();
+  /* Called once the capture thread has been stopped */
+  void stopRecording();
+
+  /* Called by the capture thread only. flow_hash is the DissectionWorker::packetHash() of the packet. */
+  void recordPacket(const struct pcap_pkthdr *h, const u_char *packet, u_int32_t flow_hash);
+  void writePackets();
+
+  inline NetworkInterface* getInterface() const { return(iface); };
+  char* getSegmentPath(u_int32_t id, const char *suffix, char *buf, u_int buf_len) const;
+  /*
+    Returns the completed segments with packets between from and to, and the segment being
+    written with the number of bytes written so far (open_segment_len is 0 when there is none)
+   */
+  void getSegments(time_t from, time_t to, vector<recorder_segment_info> *segments,
+		   u_int32_t *open_segment_id, u_int64_t *open_segment_len);
+
+  void lua(lua_State *vm);
+};
+
+#endif /* _PACKET_RECORDER_H_ */
@@ -0,0 +1,79 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _PACKET_RECORDER_READER_H_
+#define _PACKET_RECORDER_READER_H_
+
+#include "ntop_includes.h"
+
+/*
+  Reads back the packets of a PacketRecorder between two times, optionally
+  matching a BPF filter and/or a flow.
+
+  The time index of the completed segments gives the range of each segment
+  to be read. When a flow is requested only the packets listed under its
+  hash by the flow index are read; the segment still being written has no
+  index yet and is scanned sequentially. Either way, packets are matched
+  on the flow tuple, as other flows can share its hash.
+ */
+class PacketRecorderReader {
+ private:
+  PacketRecorder *recorder;
+  int datalink;
+  time_t from, to;
+  struct bpf_program fcode;
+  bool has_filter;
+  FlowTuple flow;
+  u_int32_t flow_hash;
+  bool match_flow;
+
+  vector<recorder_segment_info> segments;
+  u_int32_t open_segment_id;
+  u_int64_t open_segment_len;
+  u_int32_t next_segment; /* segments.size() for the open segment */
+
+  int fd;
+  bool scanning;                  /* No index: every packet of the segment is read */
+  u_int64_t offset, end_offset;   /* Sequential reads */
+  vector<u_int32_t> offsets;      /* Flow reads */
+  u_int32_t next_offset;
+
+  u_int8_t *buf;
+  u_int64_t buf_offset;
+  u_int32_t buf_len;
+
+  bool openNextSegment();
+  void closeSegment();
+  bool loadIndex(u_int32_t id);
+  const u_int8_t* read(u_int64_t pos, u_int32_t len, u_int32_t read_len);
+
+ public:
+  PacketRecorderReader(PacketRecorder *_recorder, time_t _from, time_t _to,
+		       const char *bpf_filter, const FlowTuple *_flow /* NULL for any flow */);
+  ~PacketRecorderReader();
+
+  /* false when the filter is invalid */
+  inline bool isValid() const { return(buf != NULL); };
+  /* Returns the next matching packet, valid until the next call, or false when done */
+  bool next(struct pcap_pkthdr *h, const u_char **packet);
+};
+
+#endif /* _PACKET_RECORDER_READER_H_ */
@@ -49,6 +49,8 @@ class PacketStats {
   void incStats(u_int num_pkts, u_int pkt_len);
   char* serialize();
   void deserialize(json_object *o);
+  void serializeBinary(BinarySerializer *s) const;
+  void deserializeBinary(BinaryDeserializer *d);
   json_object* getJSONObject();
   void lua(lua_State* vm, const char *label);
   inline void sum(PacketStats *s) const {
@@ -46,7 +46,7 @@ class ParsedeBPF {
   bool update(const ParsedeBPF * const pe);
   bool isServerInfo() const;
   void print();
-  void getJSONObject(json_object *my_object, bool client) const;
+  void getJSON(JSONStreamWriter *w, bool client) const;
   void lua(lua_State *vm, bool client) const;
 };
 
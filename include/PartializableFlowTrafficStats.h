@@ -62,7 +62,7 @@ class PartializableFlowTrafficStats {
   void incDNSResp(u_int16_t resp_code);
 
   virtual void incStats(bool cli2srv_direction, u_int num_pkts, u_int pkt_len, u_int payload_len);
-  virtual void setStats(bool cli2srv_direction, u_int num_pkts, u_int pkt_len, u_int payload_len);
+  virtual void setStats(bool cli2srv_direction, u_int num_pkts, u_int64_t pkt_len, u_int64_t payload_len);
 
   void get_partial(PartializableFlowTrafficStats *dst, PartializableFlowTrafficStats *fts) const;
   inline const FlowHTTPStats *get_flow_http_stats() const { return &protos.http; };
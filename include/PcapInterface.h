@@ -32,8 +32,22 @@ class PcapInterface : public NetworkInterface {
   FILE *pcap_list;
 
   pcap_stat last_pcap_stat;
+  u_int8_t num_dissection_workers;
+  DissectionWorker *dissection_workers[MAX_NUM_DISSECTION_THREADS];
+  SPSCQueue<Flow *> *shard_flows[MAX_NUM_DISSECTION_THREADS]; /* Flows enqueued by the shards for the hosts update */
+
   u_int32_t getNumDroppedPackets();
   void cleanupPcapDumpDir();
+  void startDissectionWorkers();
+  void stopDissectionWorkers();
+  void dequeueShardFlows();
+  void countMacs(const struct pcap_pkthdr *h, const u_char *packet);
+
+  virtual void sumStats(TcpFlowStats *_tcpFlowStats, EthStats *_ethStats,
+			LocalTrafficStats *_localStats, nDPIStats *_ndpiStats,
+			PacketStats *_pktStats, TcpPacketStats *_tcpPacketStats,
+			ProtoStats *_discardedProbingStats, DSCPStats *_dscpStats,
+			SyslogStats *_syslogStats) const;
 
   virtual void incEthStats(bool ingressPacket, u_int16_t proto, u_int32_t num_pkts,
 			   u_int32_t num_bytes, u_int pkt_overhead) {
@@ -62,6 +76,34 @@ class PcapInterface : public NetworkInterface {
   inline void sendTermination()     { if(pcap_handle) pcap_breakloop(pcap_handle); };
   bool reproducePcapOriginalSpeed() const;
   virtual void updateDirectionStats();
+  virtual void shutdown();
+
+  /* Packet dissection workers (--dissection-threads) */
+  inline bool hasDissectionWorkers() const { return(num_dissection_workers > 0); };
+  void dispatchPacket(const struct pcap_pkthdr *h, const u_char *packet);
+  virtual bool viewEnqueue(time_t t, Flow *f, u_int8_t viewed_interface_id);
+  virtual bool hasViewedFlows() const { return(num_dissection_workers > 0); };
+  virtual void purgeIdle(time_t when, bool force_idle = false);
+  virtual void dumpFlowLoop();
+
+  virtual u_int64_t getNumPackets();
+  virtual u_int64_t getNumBytes();
+  virtual u_int64_t getNumNewFlows();
+  virtual u_int     getNumFlows();
+  virtual u_int32_t getNumDroppedFlowScriptsCalls();
+  virtual u_int32_t getFlowsHashSize();
+  virtual bool walker(u_int32_t *begin_slot,
+		      bool walk_all,
+		      WalkerType wtype,
+		      bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched),
+		      void *user_data);
+  virtual Flow* findFlowByKeyAndHashId(u_int32_t key, u_int hash_id, AddressTree *allowed_hosts);
+  virtual Flow* findFlowByTuple(u_int16_t vlan_id,
+				IpAddress *src_ip,  IpAddress *dst_ip,
+				u_int16_t src_port, u_int16_t dst_port,
+				u_int8_t l4_proto,
+				AddressTree *allowed_hosts) const;
+  virtual void lua_queues_stats(lua_State* vm);
 };
 
 #endif /* _PCAP_INTERFACE_H_ */
@@ -0,0 +1,73 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _PCAP_RING_H_
+#define _PCAP_RING_H_
+
+#include "ntop_includes.h"
+
+/*
+  Single-producer single-consumer byte ring of packets in the pcap file
+  format (record header followed by the packet).
+
+  The capture thread appends packets, whereas the consumer (the HTTP thread
+  of a live capture, the writer of the PacketRecorder) takes whatever is
+  buffered in a single batch. A slow consumer can only fill the ring:
+  packets that do not fit are dropped and accounted, without ever blocking
+  the capture thread.
+ */
+class PcapRing {
+ private:
+  u_int8_t *buf;
+  u_int32_t size;          /* Power of 2 */
+  volatile u_int32_t head; /* Bytes appended by the producer, wraps around */
+  volatile u_int32_t tail; /* Bytes taken by the consumer, wraps around */
+  u_int64_t num_enqueued, num_dropped; /* Producer */
+
+  void copy(u_int32_t pos, const void *data, u_int32_t len);
+
+ public:
+  PcapRing(u_int32_t _size);
+  ~PcapRing();
+
+  /* Called by the producer only */
+  bool enqueue(const struct pcap_pkthdr *h, const u_char *packet);
+  /* Position of the next byte appended, wraps around as the consumer positions do */
+  inline u_int32_t getHead()                const { return(head);           };
+
+  /*
+    Called by the consumer only. peek() returns the number of buffered bytes,
+    in up to two chunks (the second one when the data wraps around the end of
+    the ring); consume() releases them once used.
+   */
+  u_int32_t peek(const u_int8_t **chunk1, u_int32_t *chunk1_len,
+		 const u_int8_t **chunk2, u_int32_t *chunk2_len);
+  void consume(u_int32_t len);
+  inline u_int32_t getTail()                const { return(tail);           };
+  /* Sends the buffered packets. Returns the number of bytes sent, -1 when the client is gone */
+  int send(struct mg_connection *conn);
+
+  inline bool isEmpty()                     const { return(head == tail);   };
+  inline u_int64_t get_num_enqueued()       const { return(num_enqueued);   };
+  inline u_int64_t get_num_dropped()        const { return(num_dropped);    };
+};
+
+#endif /* _PCAP_RING_H_ */
@@ -40,6 +40,8 @@ class PeriodicActivities {
   void sendShutdownSignal();
 
   void lua(NetworkInterface *iface, lua_State *vm);
+  inline u_int16_t getNumActivities()          const { return(num_activities); };
+  inline ThreadedActivity* getActivity(u_int16_t i) const { return((i < CONST_MAX_NUM_THREADED_ACTIVITIES) ? activities[i] : NULL); };
   void reloadVMs();
 };
 
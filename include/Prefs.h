@@ -64,7 +64,7 @@ class Prefs {
   u_int32_t other_rrd_raw_days, other_rrd_1min_days, other_rrd_1h_days, other_rrd_1d_days;
   u_int32_t housekeeping_frequency;
   bool disable_alerts, enable_top_talkers, enable_idle_local_hosts_cache,
-    enable_active_local_hosts_cache;
+    enable_active_local_hosts_cache, local_hosts_cache_json, enable_tables_snapshot;
   bool enable_flow_device_port_rrd_creation;
   bool enable_tiny_flows_export;
   bool enable_captive_portal, enable_informative_captive_portal, mac_based_captive_portal;
@@ -101,6 +101,10 @@ class Prefs {
   char *local_networks;
   bool local_networks_set, shutdown_when_done, simulate_vlans, ignore_vlans, ignore_macs;
   u_int32_t num_simulated_ips;
+  u_int8_t num_dissection_threads, num_flow_hook_threads;
+  bool idle_timing_wheel;
+  char *dns_server;
+  u_int32_t packet_recorder_max_gb;
   char *data_dir, *install_dir, *docs_dir, *scripts_dir,
 	  *callbacks_dir, *prefs_dir, *pcap_dir;
   char *categorization_key;
@@ -127,6 +131,9 @@ class Prefs {
   char *es_type, *es_index, *es_url, *es_user, *es_pwd, *es_host;
   char *mysql_host, *mysql_dbname, *mysql_tablename, *mysql_user, *mysql_pw;
   int mysql_port;
+  u_int32_t mysql_batch_size;
+  u_int8_t num_mysql_writers;
+  u_int8_t num_es_writers;
   char *ls_host,*ls_port,*ls_proto;
   bool has_cmdl_trace_lvl; /**< Indicate whether a verbose level 
 			      has been provided on the command line.*/
@@ -150,6 +157,19 @@ class Prefs {
   };
   bool getDefaultBoolPrefsValue(const char *pref_key, const bool default_value);
   void refreshBehaviourAnalysis();
+
+  /*
+    Preferences fetched with a single MGET at the beginning of reloadPrefsFromRedis(),
+    so that the reload does not pay one Redis round trip per preference. Values are
+    only consulted by the reloading thread; missing keys are stored as NULL.
+  */
+  Mutex prefetch_lock;
+  std::map<std::string, char*> prefetched_prefs;
+  pthread_t prefetch_thread;
+  bool prefs_prefetched;
+  void prefetchPrefsFromRedis();
+  void releasePrefetchedPrefs();
+  int getPrefValue(const char *pref_key, char *rsp, u_int rsp_len);
   
  public:
   Prefs(Ntop *_ntop);
@@ -192,6 +212,11 @@ class Prefs {
   inline void set_user(const char *u)                   { if(user) free(user); user = strdup(u); user_set = true; };
   inline bool is_user_set()                             { return user_set; };
   inline u_int32_t get_num_simulated_ips()        const { return(num_simulated_ips);      };
+  inline u_int8_t  get_num_dissection_threads()   const { return(num_dissection_threads); };
+  inline u_int8_t  get_num_flow_hook_threads()    const { return(num_flow_hook_threads);  };
+  inline bool      use_idle_timing_wheel()        const { return(idle_timing_wheel);      };
+  inline const char* get_dns_server()             const { return(dns_server);             };
+  inline u_int32_t get_packet_recorder_max_gb()   const { return(packet_recorder_max_gb); };
   inline u_int8_t get_num_user_specified_interfaces()   { return(num_interfaces);         };
   inline bool  do_read_flows_from_nprobe_mysql()        { return(read_flows_from_mysql);  };
   inline bool  do_dump_flows_on_es()                    { return(dump_flows_on_es);       };
@@ -299,6 +324,9 @@ class Prefs {
   inline bool use_promiscuous()         { return(use_promiscuous_mode);  };
   inline char* get_mysql_host()         { return(mysql_host);            };
   inline int get_mysql_port()           { return(mysql_port);            };
+  inline u_int32_t get_mysql_batch_size()  const { return(mysql_batch_size);  };
+  inline u_int8_t get_num_mysql_writers()  const { return(num_mysql_writers); };
+  inline u_int8_t get_num_es_writers()     const { return(num_es_writers);    };
   inline char* get_mysql_dbname()       { return(mysql_dbname);          };
   inline char* get_mysql_tablename()    { return(mysql_tablename);       };
   inline char* get_mysql_user()         { return(mysql_user);            };
@@ -331,6 +359,8 @@ class Prefs {
   inline bool  are_top_talkers_enabled()                { return(enable_top_talkers);     };
   inline bool  is_idle_local_host_cache_enabled()       { return(enable_idle_local_hosts_cache);    };
   inline bool  is_active_local_host_cache_enabled()     { return(enable_active_local_hosts_cache);  };
+  inline bool  is_local_host_cache_json()               { return(local_hosts_cache_json);           };
+  inline bool  is_tables_snapshot_enabled()             { return(enable_tables_snapshot);           };
 
   inline bool is_tiny_flows_export_enabled()             { return(enable_tiny_flows_export);            };
   inline bool is_flow_device_port_rrd_creation_enabled() { return(enable_flow_device_port_rrd_creation);};
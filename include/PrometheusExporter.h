@@ -0,0 +1,85 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _PROMETHEUS_EXPORTER_H_
+#define _PROMETHEUS_EXPORTER_H_
+
+#include "ntop_includes.h"
+
+/*
+  Renders the /metrics endpoint in the Prometheus text exposition format
+  straight from the C++ counters (interfaces, hash tables, queues, nDPI
+  protocols and periodic activities), without going through a Lua VM.
+
+  Rendering is serialized: the text buffer and the gzip buffer are reused
+  across scrapes and only grow. The buffer being sent is detached from the
+  exporter while the response is written, so a slow client does not block
+  the other scrapes. The nDPI stats of each interface are merged into
+  temporary objects on every scrape.
+ */
+class PrometheusExporter {
+ private:
+  Mutex m;
+  char *buf;                    /* Text buffer, reused across scrapes */
+  u_int32_t buf_len, buf_size;
+  bool out_of_memory;           /* Set when the buffer could not grow during the current scrape */
+  const char *allowed_ifname;   /* Interface the scraping user is restricted to, empty for all */
+#ifdef HAVE_ZLIB
+  z_stream zs;
+  bool zs_inited;
+  char *gzip_buf;               /* Compressed body, reused across scrapes */
+  u_int32_t gzip_buf_size;
+#endif
+
+  u_int64_t num_scrapes, num_gzip_scrapes, num_failures;
+  u_int64_t tot_render_usec, tot_bytes, tot_sent_bytes;
+  u_int32_t max_render_usec, last_bytes, last_sent_bytes;
+
+  bool reserve(u_int32_t len);
+  void append(const char *fmt, ...);
+  void appendLabelValue(const char *value);
+  void appendFamily(const char *name, const char *type, const char *help);
+  void appendInterfaceLabels(NetworkInterface *iface);
+  bool isInterfaceAllowed(NetworkInterface *iface) const;
+
+  void renderInterfaces();
+  void renderHashTables();
+  void renderQueues();
+  void renderNdpi();
+  void renderPeriodicActivities();
+  bool render();
+  u_int32_t compress();
+
+ public:
+  PrometheusExporter();
+  ~PrometheusExporter();
+
+  /*
+    Sends the metrics of the interfaces matching allowed_ifname (all when empty) as
+    the response to the request, gzip-compressed when accepted by the client
+  */
+  int serve(struct mg_connection *conn, const char * const allowed_ifname);
+
+  void lua(lua_State *vm);
+};
+
+#endif /* _PROMETHEUS_EXPORTER_H_ */
@@ -0,0 +1,55 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _RECIPIENT_NOTIFICATION_H_
+#define _RECIPIENT_NOTIFICATION_H_
+
+#include "ntop_includes.h"
+
+/*
+  An immutable notification shared by all the recipient queues it is
+  enqueued to. The creator and every queue holding the notification own a
+  reference; the last release frees it.
+*/
+class RecipientNotification {
+ private:
+  std::atomic<u_int32_t> num_refs;
+  struct timeval creation_time;
+  u_int32_t len;
+  char *data;
+
+  RecipientNotification();
+  ~RecipientNotification();
+
+ public:
+  /* Returns a notification holding one reference, or NULL on allocation failure */
+  static RecipientNotification* create(const char * const notification);
+
+  inline void incRef() { num_refs.fetch_add(1, std::memory_order_relaxed); };
+  inline void decRef() { if(num_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this; };
+
+  inline const char* get()                      const { return(data);           };
+  inline u_int32_t getLength()                  const { return(len);            };
+  inline const struct timeval* getCreationTime() const { return(&creation_time); };
+};
+
+#endif /* _RECIPIENT_NOTIFICATION_H_ */
@@ -1,6 +1,6 @@
 /*
  *
- * (C) 2014-20 - ntop.org
+ * (C) 2013-20 - ntop.org
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -27,13 +27,26 @@
 
 class RecipientQueues {
  private:
-  FifoStringsQueue *queues_by_prio[RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES];
+  /* Lockless queues of notification references, allocated upon first enqueue */
+  std::atomic<MPMCQueue<RecipientNotification*>*> queues_by_prio[RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES];
   /* Counters for the number of drops occurred when enqueuing */
-  u_int64_t drops_by_prio[RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES];
+  std::atomic<u_int64_t> drops_by_prio[RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES];
   /* Counters for the number of enqueues */
-  time_t uses_by_prio[RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES];
+  std::atomic<u_int64_t> uses_by_prio[RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES];
+  /* Counters for the number of dequeues and the time notifications have spent in the queue */
+  std::atomic<u_int64_t> dequeues_by_prio[RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES];
+  std::atomic<u_int64_t> tot_latency_usec;
+  std::atomic<u_int32_t> max_latency_usec;
   /* Timestamp of the last dequeue, regardless of queue priority */
-  time_t last_use;
+  std::atomic<time_t> last_use;
+  /* Deleted recipients keep their queues (enqueues may be in progress) but refuse new notifications */
+  std::atomic<bool> enabled;
+  /* Enqueues in progress: disabling waits for them before draining the queues */
+  std::atomic<u_int32_t> num_enqueuers;
+
+  MPMCQueue<RecipientNotification*>* getQueue(RecipientNotificationPriority prio);
+  void updateLatency(const RecipientNotification *n, const struct timeval *now);
+  void resetStats();
 
  public:
   RecipientQueues();
@@ -43,26 +56,43 @@ class RecipientQueues {
   * @brief Dequeues a notification from a `recipient_id` queue, given a certain priority
   * @param prio The priority of the notification
   *
-  * @return A pointer to a notification string, or NULL if there was no notification in the queue. The pointer MUST be `free`d after use
+  * @return A pointer to a notification, or NULL if there was no notification in the queue. The notification MUST be released with decRef() after use
+  */
+  RecipientNotification* dequeue(RecipientNotificationPriority prio);
+
+  /**
+  * @brief Dequeues up to `max_notifications` notifications, given a certain priority
+  * @param prio The priority of the notifications
+  * @param notifications Array receiving the notifications, which MUST be released with decRef() after use
+  * @param max_notifications Size of the `notifications` array
+  *
+  * @return The number of notifications dequeued
   */
-  char *dequeue(RecipientNotificationPriority prio);
+  u_int32_t dequeueBulk(RecipientNotificationPriority prio, RecipientNotification **notifications, u_int32_t max_notifications);
+
   /**
-  * @brief Enqueues a notification to a `recipient_id` queue, depending on the priority
-  * @param recipient_id An integer recipient identifier
+  * @brief Enqueues a reference to a notification, depending on the priority
   * @param prio The priority of the notification
-  * @param notification A string containing the notification
+  * @param notification The notification, whose reference counter is increased on success
   *
   * @return True if the enqueue succeeded, false otherwise
   */
-  bool enqueue(RecipientNotificationPriority prio, const char * const notification);
+  bool enqueue(RecipientNotificationPriority prio, RecipientNotification *notification);
+
   /**
-   * @brief Returns queue status (drops and uses)
+   * @brief Enables or disables the queues. Disabling drops all the queued notifications,
+   *        including those of enqueues in progress. Enabling starts from empty queues and zeroed stats.
+   */
+  void setEnabled(bool _enabled);
+  inline bool isEnabled() const { return(enabled.load(std::memory_order_acquire)); };
+
+  /**
+   * @brief Returns queue status (drops, uses, fill level and latency)
    * @param vm A Lua VM instance
    *
    * @return
    */
   void lua(lua_State* vm);
-
 };
 
 #endif /* _RECIPIENT_QUEUES_ */
@@ -27,9 +27,11 @@
 
 class Recipients {
  private:
-  /* Per-recipient queues */
-  RecipientQueues* recipient_queues[MAX_NUM_RECIPIENTS];
+  /* Per-recipient queues, never freed while ntopng is running (see delete_recipient) */
+  std::atomic<RecipientQueues*> recipient_queues[MAX_NUM_RECIPIENTS];
+  /* Serializes registrations and deletions only, enqueues and dequeues are lockless */
   Mutex m;
+
  public:
   Recipients();
   ~Recipients();
@@ -39,9 +41,32 @@ class Recipients {
   * @param recipient_id An integer recipient identifier
   * @param prio The priority of the notification
   *
-  * @return A pointer to a notification string, or NULL if there was no notification in the queue. The pointer MUST be `free`d after use
+  * @return A pointer to a notification, or NULL if there was no notification in the queue. The notification MUST be released with decRef() after use
   */
-  char *dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio);
+  RecipientNotification* dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio);
+
+  /**
+  * @brief Dequeues up to `max_notifications` notifications from a `recipient_id` queue, given a certain priority
+  * @param recipient_id An integer recipient identifier
+  * @param prio The priority of the notifications
+  * @param notifications Array receiving the notifications, which MUST be released with decRef() after use
+  * @param max_notifications Size of the `notifications` array
+  *
+  * @return The number of notifications dequeued
+  */
+  u_int32_t dequeueBulk(u_int16_t recipient_id, RecipientNotificationPriority prio,
+			RecipientNotification **notifications, u_int32_t max_notifications);
+
+  /**
+  * @brief Enqueues a reference to a notification to a `recipient_id` queue, depending on the priority
+  * @param recipient_id An integer recipient identifier
+  * @param prio The priority of the notification
+  * @param notification The notification
+  *
+  * @return True if the enqueue succeeded, false otherwise
+  */
+  bool enqueue(u_int16_t recipient_id, RecipientNotificationPriority prio, RecipientNotification *notification);
+
   /**
   * @brief Enqueues a notification to a `recipient_id` queue, depending on the priority
   * @param recipient_id An integer recipient identifier
@@ -51,6 +76,19 @@ class Recipients {
   * @return True if the enqueue succeeded, false otherwise
   */
   bool enqueue(u_int16_t recipient_id, RecipientNotificationPriority prio, const char * const notification);
+
+  /**
+  * @brief Enqueues a notification to several recipients. The notification is stored once and shared by the queues.
+  * @param recipient_ids An array of recipient identifiers
+  * @param num_recipients The number of elements of `recipient_ids`
+  * @param prio The priority of the notification
+  * @param notification A string containing the notification
+  *
+  * @return The number of recipients the notification has been enqueued to
+  */
+  u_int32_t enqueue(const u_int16_t *recipient_ids, u_int32_t num_recipients,
+		    RecipientNotificationPriority prio, const char * const notification);
+
   /**
   * @brief Registers a recipient identified with `recipient_id` so its notification can be enqueued/dequeued
   * @param recipient_id An integer recipient identifier
@@ -26,63 +26,95 @@
 
 class Host;
 
+/* A connection of the pool, along with the latency of the commands it has run */
+struct RedisConnection {
+  redisContext *redis;
+  Mutex l;
+  u_int8_t id;
+  bool connected;                /* Protected by l */
+  u_int64_t num_commands[redis_cmd_max], tot_usec[redis_cmd_max];
+  u_int32_t max_usec[redis_cmd_max];
+  u_int32_t latency_histogram[redis_cmd_max][REDIS_LATENCY_HISTOGRAM_SLOTS];
+};
+
+/*
+  Commands are sent over a pool of connections: each thread is bound to a
+  connection upon its first command. The string cache is shared by all the
+  connections and protected by its own lock.
+ */
 class Redis {
  private:
-  redisContext *redis;
-  Mutex *l;
+  RedisConnection *pool;
+  u_int8_t pool_size;
+  pthread_key_t conn_key;        /* Thread -> connection slot + 1 */
+  std::atomic<u_int32_t> next_conn_slot;
+  Mutex *l;                      /* Protects stringCache and cache_version */
+  u_int64_t cache_version;       /* Bumped when cached keys are removed, see get() */
   char *redis_host, *redis_password, *redis_version;
 #ifdef __linux__
   bool is_socket_connection;
 #endif
+  /* Updated by threads bound to different connections */
   struct {
-    u_int32_t num_expire, num_get, num_ttl, num_del,
+    std::atomic<u_int32_t> num_expire, num_get, num_ttl, num_del,
       num_hget, num_hset, num_hdel, num_set,
       num_keys, num_hkeys, num_llen, num_other,
       num_hgetall, num_trim, num_lpush_rpush,
       num_lpop_rpop, num_strlen, num_saved_lookups,
       num_get_address, num_set_resolved_address;
-    u_int32_t num_reconnections;
+    std::atomic<u_int32_t> num_reconnections;
   } stats;
   u_int32_t num_redis_version;
   u_int16_t redis_port;
   u_int8_t redis_db_id;
   pthread_t esThreadLoop;
   pthread_t lsThreadLoop;
-  bool operational;
+  std::atomic<u_int8_t> num_connected;
   bool initializationCompleted;
   std::map<std::string, StringCache> stringCache;
   FifoStringsQueue *localToResolve, *remoteToResolve;
   u_int numCached;
 
   char* getRedisVersion();
-  void reconnectRedis(bool giveup_on_failure);
+  void reconnectRedis(RedisConnection *c, bool giveup_on_failure);
+  RedisConnection* getConnection(bool trace_errors = true);
+  void releaseConnection(RedisConnection *c, bool trace_errors = true);
+  void updateLatency(RedisConnection *c, RedisCommandType t, const struct timeval *begin);
+  redisReply* command(RedisConnection *c, RedisCommandType t, const char *format, ...);
+  redisReply* commandArgv(RedisConnection *c, RedisCommandType t, int argc, const char **argv, const size_t *argvlen);
+  bool appendCommand(RedisConnection *c, const char *format, ...);
+  u_int readPipelineReplies(RedisConnection *c, const struct timeval *begin, u_int num_replies, redisReply **replies);
   int msg_push(const char * const cmd, const char * const queue_name, const char * const msg, u_int queue_trim_size,
 	       bool trace_errors = true, bool head_trim = true);
   int lrpop(const char *queue_name, char *buf, u_int buf_len, bool lpop);
-  void addToCache(const char * const key, const char * const value, u_int expire_secs);
+  void addToCache(const char * const key, const char * const value, u_int expire_secs, bool replace = true);
   bool isCacheable(const char * const key);
   bool expireCache(char *key, u_int expire_sec);
 
-  void checkDumpable(const char * const key);
+  bool checkDumpable(const char * const key);
   int _set(bool use_nx, const char * const key, const char * const value, u_int expire_secs);
   
  public:
   Redis(const char *redis_host = (char*)"127.0.0.1",
 	const char *redis_password = NULL,
 	u_int16_t redis_port = 6379, u_int8_t _redis_db_id = 0,
-	bool giveup_on_failure = false);
+	bool giveup_on_failure = false, u_int8_t _pool_size = CONST_REDIS_POOL_SIZE);
   ~Redis();
 
   inline char* getVersion()        { return(redis_version);     }
   inline u_int32_t getNumVersion() { return(num_redis_version); }
   inline bool haveRedisDump()      { return((num_redis_version >= 0x020600) ? true : false); }
   void setDefaults();
-  inline bool isOperational() { return(operational); };
+  /* At least one connection of the pool is up */
+  inline bool isOperational() { return(num_connected > 0); };
   inline void setInitializationComplete() { initializationCompleted = true; };
   int info(char *rsp, u_int rsp_len);
   u_int dbsize();
   int expire(char *key, u_int expire_sec);
   int get(char *key, char *rsp, u_int rsp_len, bool cache_it = false);
+  /* Binary-safe, not cached, GET/SET: the value is returned malloc'd and NUL-terminated */
+  int getBinary(const char * const key, char **value, u_int32_t *value_len, u_int32_t max_len);
+  int setBinary(const char * const key, const char * const value, u_int32_t value_len, u_int expire_secs = 0);
   int hashGet(const char * const key, const char * const member, char * const rsp, u_int rsp_len);
   int hashDel(const char * const key, const char * const field);
   int hashSet(const char * const key, const char * const field, const char * const value);
@@ -90,6 +122,11 @@ class Redis {
   inline int set(const char * const key, const char * const value, u_int expire_secs=0) { return(_set(false, key, value, expire_secs)); }
   /* setnx = set if not existing */
   inline int setnx(const char * const key, const char * const value, u_int expire_secs=0) { return(_set(true, key, value, expire_secs)); }
+  /* Batch APIs: a single round-trip per call */
+  int mget(u_int num_keys, const char * const *keys, char **values);
+  /* When values_len is set, values are binary and are not cached */
+  int mset(u_int num_keys, const char * const *keys, const char * const *values, u_int expire_secs = 0,
+	   const u_int32_t *values_len = NULL);
   int keys(const char *pattern, char ***keys_p);
   int hashKeys(const char *pattern, char ***keys_p);
   int hashGetAll(const char *key, char ***keys_p, char ***values_p);
@@ -98,7 +135,7 @@ class Redis {
   int popHostToResolve(char *hostname, u_int hostname_len);
 
   int getAddress(char *numeric_ip, char *rsp, u_int rsp_len, bool queue_if_not_found);
-  int setResolvedAddress(char *numeric_ip, char *symbolic_ip);
+  int setResolvedAddress(char *numeric_ip, char *symbolic_ip, u_int expire_secs = DNS_CACHE_DURATION);
 
   int sadd(const char *set_name, char *item);
   int srem(const char *set_name, char *item);
@@ -24,7 +24,12 @@
 
 #include "ntop_includes.h"
 
-/* Lockless fixed-size Single-Producer Single-Consumer queue */
+/*
+  Lockless fixed-size Single-Producer Single-Consumer queue.
+
+  The producer never issues a syscall unless the consumer is parked in
+  wait(): see Condvar::prepareWait() and Condvar::signalIfWaiting().
+*/
 
 #define QUEUE_WATERMARK      8 /* pow of 2 */
 #define QUEUE_WATERMARK_MASK (QUEUE_WATERMARK - 1)
@@ -34,13 +39,18 @@ template <typename T> class SPSCQueue {
   char *name;
   u_int64_t num_failed_enqueues; /* Counts the number of times the enqueue has failed (queue full) */
   u_int64_t shadow_head;
-  volatile u_int64_t head;
-  volatile u_int64_t tail;
+  std::atomic<u_int64_t> head; /* Published by the producer (release), read by the consumer (acquire) */
+  std::atomic<u_int64_t> tail; /* Published by the consumer (release), read by the producer (acquire) */
   u_int64_t shadow_tail;
   Condvar c;
   std::vector<T> queue;
   u_int32_t queue_size;
 
+  inline void publishHead() {
+    head.store(shadow_head, std::memory_order_release);
+    c.signalIfWaiting();
+  }
+
  public:
   /**
    * Constructor
@@ -48,7 +58,7 @@ template <typename T> class SPSCQueue {
    */
   SPSCQueue(u_int32_t size, const char * const _name) {
     queue_size = Utils::pow2(size);
-    queue.reserve(queue_size);
+    queue.resize(queue_size);
     tail = shadow_tail = queue_size-1;
     head = shadow_head = 0;
     num_failed_enqueues = 0;
@@ -65,7 +75,7 @@ template <typename T> class SPSCQueue {
    */
   inline bool isNotEmpty() {
     u_int32_t next_tail = (shadow_tail + 1) & (queue_size-1);
-    return next_tail != head;
+    return next_tail != head.load(std::memory_order_acquire);
   }
 
   /**
@@ -73,7 +83,7 @@ template <typename T> class SPSCQueue {
    */
   inline bool isFull() {
     u_int32_t next_head = (shadow_head + 1) & (queue_size-1);
-    return tail == next_head;
+    return tail.load(std::memory_order_acquire) == next_head;
   }
 
   /**
@@ -84,12 +94,12 @@ template <typename T> class SPSCQueue {
     u_int32_t next_tail;
     
     next_tail = (shadow_tail + 1) & (queue_size-1);
-    if (next_tail != head) {
+    if (next_tail != head.load(std::memory_order_acquire)) {
       T item = queue[next_tail];
       shadow_tail = next_tail;
 
       if ((shadow_tail & QUEUE_WATERMARK_MASK) == 0)
-        tail = shadow_tail;
+        tail.store(shadow_tail, std::memory_order_release);
 
       return item;
     }
@@ -97,8 +107,51 @@ template <typename T> class SPSCQueue {
     return static_cast<T>(NULL);
   }
 
+  /**
+   * Pop up to max_items items from the tail
+   * @param items Array receiving the items
+   * @param max_items Size of the items array
+   * Return the number of items dequeued
+   */
+  inline u_int32_t dequeueBulk(T *items, u_int32_t max_items) {
+    u_int64_t cur_head = head.load(std::memory_order_acquire);
+    u_int32_t num = 0;
+
+    while(num < max_items) {
+      u_int32_t next_tail = (shadow_tail + 1) & (queue_size-1);
+
+      if(next_tail == cur_head)
+	break;
+
+      items[num++] = queue[next_tail];
+      shadow_tail = next_tail;
+    }
+
+    if(num > 0)
+      tail.store(shadow_tail, std::memory_order_release);
+
+    return num;
+  }
+
+  /**
+   * Wait until the producer signals new items, for at most 1s
+   * Return false on error
+   */
   inline bool wait() {
-    return((c.wait() < 0) ? false : true);
+    struct timespec expire;
+    int rc = 0;
+
+    c.prepareWait();
+
+    /* Check again, as the producer skips the signal until it sees the waiter */
+    if(!isNotEmpty()) {
+      expire.tv_sec = time(NULL) + 1, expire.tv_nsec = 0;
+      rc = c.timedWait(&expire);
+    }
+
+    c.cancelWait();
+
+    return(((rc == 0) || (rc == ETIMEDOUT)) ? true : false);
   }
 
   /**
@@ -112,14 +165,13 @@ template <typename T> class SPSCQueue {
 
     next_head = (shadow_head + 1) & (queue_size-1);
 
-    if (tail != next_head) {
+    if (tail.load(std::memory_order_acquire) != next_head) {
       queue[shadow_head] = item;
 
       shadow_head = next_head;
-      c.signal();
-      
+
       if (flush || (shadow_head & QUEUE_WATERMARK_MASK) == 0)
-        head = shadow_head;
+        publishHead();
 
       return true; /* success */
     }
@@ -128,11 +180,48 @@ template <typename T> class SPSCQueue {
     return false; /* no room */
   }
 
+  /**
+   * Push up to num_items items to the head, making them immediately available to the consumer
+   * @param items The items to add to the queue
+   * @param num_items Number of items
+   * Return the number of items enqueued, items not fitting in the queue are accounted as failed
+   */
+  inline u_int32_t enqueueBulk(const T *items, u_int32_t num_items) {
+    u_int64_t cur_tail = tail.load(std::memory_order_acquire);
+    u_int32_t num = 0;
+
+    while(num < num_items) {
+      u_int32_t next_head = (shadow_head + 1) & (queue_size-1);
+
+      if(next_head == cur_tail)
+	break;
+
+      queue[shadow_head] = items[num++];
+      shadow_head = next_head;
+    }
+
+    if(num > 0)
+      publishHead();
+
+    num_failed_enqueues += num_items - num;
+    return num;
+  }
+
+  /**
+   * Return the number of items in the queue, as seen by the consumer
+   * (approximate as the tail is published with a watermark)
+   */
+  inline u_int32_t getLength() const {
+    return (head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire) - 1) & (queue_size-1);
+  }
+
   /**
    * Return the number of failed enqueue attempts
    */
   inline u_int64_t get_num_failed_enqueues() const { return num_failed_enqueues; };
 
+  inline const char* getName() const { return(name ? name : ""); };
+
   /**
    * Writes queue stats in a table of the vm passed as parameter
    */
@@ -140,6 +229,7 @@ template <typename T> class SPSCQueue {
     if(vm) {
       lua_newtable(vm);
       lua_push_uint64_table_entry(vm, "num_failed_enqueues", num_failed_enqueues);
+      lua_push_uint64_table_entry(vm, "length", getLength());
       lua_pushstring(vm, name ? name : "");
       lua_insert(vm, -2);
       lua_settable(vm, -3);
@@ -21,17 +21,38 @@
 
 #ifndef _SERIALIZABLE_ELEMENT_H_
 
+/* A serialization read from Redis: JSON is parsed when read, binary is decoded when restored */
+class SerializedState {
+ public:
+  json_object *json;
+  u_int8_t *binary;
+  u_int32_t binary_len;
+
+  SerializedState()  { json = NULL, binary = NULL, binary_len = 0; };
+  ~SerializedState() { if(json) json_object_put(json); if(binary) free(binary); };
+};
+
 class SerializableElement {
+ private:
+  char* getSerializedValue(u_int32_t *value_len);
+
  protected:
-  static json_object* deserializeJson(const char *key);
+  /* Reads the serialization of key, binary or JSON: NULL when missing or corrupted */
+  static SerializedState* readSerialization(const char *key);
+  bool deserializeState(SerializedState *state);
 
   /* Virtual */
   virtual char* getSerializationKey(char *buf, uint bufsize) = 0;
   virtual void deserialize(json_object *obj) = 0;
   virtual void serialize(json_object *obj, DetailsLevel details_level) = 0;
+  /* Binary serialization (see BinarySerializer), used unless JSON is forced: elements returning false are serialized in JSON */
+  virtual bool serializeBinary(BinarySerializer *s)     { return(false); };
+  virtual bool deserializeBinary(BinaryDeserializer *d) { return(false); };
 
  public:
   bool serializeToRedis();
+  /* Same as serializeToRedis() but the key and value are returned (malloc'd) to be written in batch */
+  bool getRedisSerialization(char **key, char **value, u_int32_t *value_len);
   bool deserializeFromRedis();
   bool deleteRedisSerialization();
 };
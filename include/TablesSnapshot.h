@@ -0,0 +1,76 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _TABLES_SNAPSHOT_H_
+#define _TABLES_SNAPSHOT_H_
+
+#include "ntop_includes.h"
+
+/*
+  Warm-restart snapshot of the MAC, host and flow tables of an interface.
+
+  The snapshot is written at shutdown and periodically (interface.snapshotTables())
+  into <working dir>/<ifid>/tables.snapshot, and loaded at startup, before the
+  packet processing starts. The file is a BinarySerializer encoding:
+
+    <header> <info: ifid, epoch, format> <mac records> <host records> <flow records>
+
+  Each record holds the key of the entry followed by its state. As sections
+  are not nested, the state of local hosts (the sections of the local hosts
+  cache encoding) is serialized apart and embedded as a string of bytes;
+  remote hosts only keep their key. Records are serialized one at a time
+  and copied into a memory-mapped file, written under a temporary name and
+  renamed once complete.
+ */
+class TablesSnapshot {
+ private:
+  NetworkInterface *iface;
+  char path[MAX_PATH], tmp_path[MAX_PATH];
+  BinarySerializer record, host_state;
+  int fd;
+  u_int8_t *map;
+  u_int64_t map_len, offset;
+  u_int32_t num_macs, num_hosts, num_flows;
+  bool failed;
+
+  bool mapFile(u_int64_t len);
+  void unmapFile();
+  void appendRecord();
+  bool restoreMac(BinaryDeserializer *d);
+  bool restoreHost(BinaryDeserializer *d);
+  bool restoreFlow(BinaryDeserializer *d);
+
+ public:
+  TablesSnapshot(NetworkInterface *_iface);
+  ~TablesSnapshot();
+
+  /* Called with the packet processing stopped, or from a periodic script */
+  bool save();
+  /* Must be called before the packet processing starts */
+  bool restore();
+
+  /* Called by the table walkers */
+  void addMac(Mac *m);
+  void addHost(Host *h);
+  void addFlow(Flow *f);
+};
+
+#endif /* _TABLES_SNAPSHOT_H_ */
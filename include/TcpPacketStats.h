@@ -38,6 +38,8 @@ class TcpPacketStats {
 
   char* serialize();
   void deserialize(json_object *o);
+  void serializeBinary(BinarySerializer *s) const;
+  void deserializeBinary(BinaryDeserializer *d);
   json_object* getJSONObject();
   inline bool seqIssues() const { return(pktRetr || pktOOO || pktLost || pktKeepAlive); }
   void lua(lua_State* vm, const char *label);
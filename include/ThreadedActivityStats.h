@@ -74,6 +74,10 @@ class ThreadedActivityStats {
   inline time_t getInProgressSince() const { return(in_progress_since); }
   inline time_t getLastStartTime()   const { return(last_start_time);   }
   inline time_t getDeadline()        const { return(deadline);          }
+  inline u_long getLastDurationMs()  const { return(last_duration_ms);  }
+  inline u_long getMaxDurationMs()   const { return(max_duration_ms);   }
+  inline u_long getNumNotExecuted()  const { return(num_not_executed);  }
+  inline u_long getNumSlow()         const { return(num_is_slow);       }
 
   inline bool hasAlertsDrops() const {
     return ta_stats.alerts.has_drops;
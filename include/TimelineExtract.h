@@ -42,6 +42,8 @@ class TimelineExtract {
     time_t from;
     time_t to;
     char *bpf_filter;
+    FlowTuple flow;
+    bool match_flow;
     u_int64_t max_bytes;
     const char * timeline_path;
   } extraction;
@@ -50,6 +52,9 @@ class TimelineExtract {
   pfring *openTimeline(const char * const timeline_path, time_t from, time_t to, const char * const bpf_filter);
   pfring *openTimelineFromInterface(NetworkInterface *iface, time_t from, time_t to, const char * const bpf_filter);
 #endif
+  /* Extraction from the PacketRecorder of the interface, to dumper or conn */
+  bool extractRecorded(NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow,
+		       u_int64_t max_bytes, PacketDumper *dumper, struct mg_connection *conn);
 
  public:
   TimelineExtract();
@@ -59,15 +64,20 @@ class TimelineExtract {
   inline time_t getFrom() { return extraction.from; };
   inline time_t getTo() { return extraction.to; };
   inline const char *getFilter() { return extraction.bpf_filter; };
+  inline const FlowTuple *getFlow() { return extraction.match_flow ? &extraction.flow : NULL; };
   inline const char *getTimelinePath() { return extraction.timeline_path; };
   inline const u_int64_t getMaxBytes() { return extraction.max_bytes; };
   inline bool isRunning() { return running; };
   void stop();
+  /*
+    Packets are extracted from the packet recorder of the interface, if any, unless a timeline_path is given.
+    flow only extracts the packets of a flow, NULL for any flow.
+   */
   /* sync */
-  bool extractToDisk(u_int32_t id, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, u_int64_t max_bytes, const char * const timeline_path);
-  bool extractLive(struct mg_connection *conn, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const char * const timeline_path);
+  bool extractToDisk(u_int32_t id, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow, u_int64_t max_bytes, const char * const timeline_path);
+  bool extractLive(struct mg_connection *conn, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow, const char * const timeline_path);
   /* async */
-  void runExtractionJob(u_int32_t id, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, u_int64_t max_bytes, const char * const timeline_path);
+  void runExtractionJob(u_int32_t id, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow, u_int64_t max_bytes, const char * const timeline_path);
   void stopExtractionJob(u_int32_t id);
   void cleanupJob();
   void getStatus(lua_State* vm);
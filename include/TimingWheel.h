@@ -0,0 +1,86 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _TIMING_WHEEL_H_
+#define _TIMING_WHEEL_H_
+
+#include "ntop_includes.h"
+
+class GenericHashEntry;
+
+#define TIMING_WHEEL_L0_BITS    8
+#define TIMING_WHEEL_LN_BITS    6
+#define TIMING_WHEEL_L0_SLOTS   (1 << TIMING_WHEEL_L0_BITS)
+#define TIMING_WHEEL_LN_SLOTS   (1 << TIMING_WHEEL_LN_BITS)
+#define TIMING_WHEEL_NUM_LEVELS 3
+#define TIMING_WHEEL_NUM_SLOTS  (TIMING_WHEEL_L0_SLOTS + (TIMING_WHEEL_NUM_LEVELS - 1) * TIMING_WHEEL_LN_SLOTS)
+/* Deadlines further than this in the future are clamped (about 12 days) */
+#define TIMING_WHEEL_SPAN       (1 << (TIMING_WHEEL_L0_BITS + (TIMING_WHEEL_NUM_LEVELS - 1) * TIMING_WHEEL_LN_BITS))
+
+/* Intrusive wheel link, embedded in every hash entry */
+typedef struct {
+  GenericHashEntry *prev, *next;
+  time_t deadline;
+  int16_t slot; /* -1 when not armed */
+} TimingWheelLink;
+
+/*
+  Hierarchical timing wheel with a 1 second tick, used to expire idle hash
+  entries without scanning the hash buckets.
+
+  Level 0 has one slot per second for the next 256 seconds, whereas levels
+  1 and 2 cover 256 and 16384 seconds per slot respectively. Entries of the
+  upper levels are cascaded down when level 0 wraps around, so that
+  advance() only touches the slots that have expired.
+
+  The wheel is not thread safe: its owner is in charge of locking.
+ */
+class TimingWheel {
+ private:
+  GenericHashEntry *slots[TIMING_WHEEL_NUM_SLOTS];
+  time_t clock;         /* Next tick to be processed, 0 until the wheel is first used */
+  u_int32_t num_armed;
+  u_int64_t num_arms, num_expired, num_cascaded;
+
+  int16_t slotOf(time_t deadline) const;
+  void link(GenericHashEntry *h, int16_t slot);
+  void unlink(GenericHashEntry *h);
+  void cascade(u_int level, u_int idx);
+  void popSlot(u_int slot, vector<GenericHashEntry*> *expired);
+
+ public:
+  TimingWheel();
+
+  /* (Re)schedules the entry to expire at deadline */
+  void arm(GenericHashEntry *h, time_t deadline);
+  /* Removes the entry from the wheel, if armed */
+  void remove(GenericHashEntry *h);
+  /* Moves the wheel to now, appending to expired all the entries whose deadline is <= now. Popped entries are no longer armed. */
+  void advance(time_t now, vector<GenericHashEntry*> *expired);
+  /* Unlinks all the entries */
+  void reset();
+
+  inline u_int32_t getNumArmed() const { return(num_armed); };
+  void lua(lua_State *vm) const;
+};
+
+#endif /* _TIMING_WHEEL_H_ */
@@ -48,6 +48,8 @@ class TrafficStats {
 
   char* serialize();
   void deserialize(json_object *o);
+  void serializeBinary(BinarySerializer *s) const;
+  void deserializeBinary(BinaryDeserializer *d);
   json_object* getJSONObject();
 };
 
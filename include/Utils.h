@@ -122,11 +122,19 @@ public:
   static bool isPrintableChar(u_char c);
   static char* formatMac(const u_int8_t * const mac, char *buf, u_int buf_len);
   static void  parseMac(u_int8_t *mac, const char *symMac);
+  static void initHashSeed();
+  static u_int32_t keyedHash(u_int64_t v);
+  static u_int32_t keyedHash(u_int64_t v1, u_int64_t v2);
+  static u_int32_t flowHash(u_int32_t a_key, u_int16_t a_port,
+			    u_int32_t b_key, u_int16_t b_port,
+			    u_int16_t vlan_id, u_int16_t protocol, u_int32_t extra_key);
   static u_int32_t macHash(const u_int8_t * const mac);
+  static bool isEmptyMac(const u_int8_t * const mac);
   static bool isSpecialMac(u_int8_t *mac);
   static int numberOfSetBits(u_int32_t i);
   static void initRedis(Redis **r, const char *redis_host, const char *redis_password,
-			u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure);
+			u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure,
+			u_int8_t pool_size = CONST_REDIS_POOL_SIZE);
   static json_object *cloneJSONSimple(json_object *src);
 
   /* ScriptPeriodicity */
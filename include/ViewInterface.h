@@ -48,7 +48,7 @@ class ViewInterface : public NetworkInterface {
 	      void *user_data);
   void viewed_flows_walker(Flow *f, const struct timeval *tv);
   /* Enqueues a flow to a queue reserved for viewed interface identified by viewed_interface_id */
-  bool viewEnqueue(time_t t, Flow *f, u_int8_t viewed_interface_id);
+  virtual bool viewEnqueue(time_t t, Flow *f, u_int8_t viewed_interface_id);
   /* Dequeues enqueued flows sequentially for each of the viewed interfaces belonging to this view.
      The total number of elements dequeued is returned. */
   u_int64_t viewDequeue(u_int budget);
@@ -0,0 +1,93 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef _ZMQ_FIELD_INDEX_H_
+#define _ZMQ_FIELD_INDEX_H_
+
+#include "ntop_includes.h"
+
+/*
+  Resolves the keys of collected flows to (PEN, field id) without building
+  temporary strings.
+
+  Labels (e.g. IN_BYTES) are looked up through a minimal perfect hash
+  (hash and displace): a first hash selects a bucket, whose displacement
+  selects the only slot the label can be in, so a lookup costs a hash of
+  the key and a single comparison. Numeric keys (e.g. 57590 or 35632.123)
+  are parsed in place.
+
+  For no-PEN field ids, a dense array tells which parser handles the field,
+  so that unhandled fields skip the parsers and ntop fields exported
+  without PEN skip the no-PEN parser.
+ */
+class ZMQFieldIndex {
+ private:
+  typedef struct {
+    char *label;
+    u_int32_t label_len;
+    u_int64_t hash;
+    u_int32_t pen, field;
+  } LabelEntry;
+
+  vector<LabelEntry> labels;
+  u_int32_t *slots;          /* Perfect hash slot -> label index + 1, 0 if empty */
+  u_int16_t *displacements;  /* Per bucket */
+  u_int32_t num_slots, num_buckets;
+  bool dirty;                /* Labels added since the last compile(): lookups fall back to a scan */
+  u_int8_t *dispatch;        /* ZMQFieldDispatch, indexed by no-PEN field id */
+
+  static u_int64_t hashLabel(const char *label, u_int32_t len);
+  static inline u_int32_t bucketOf(u_int64_t hash, u_int32_t n) { return((u_int32_t)(hash >> 32) % n); };
+  static u_int32_t slotOf(u_int64_t hash, u_int16_t displacement, u_int32_t n);
+  int findLabel(const char *label, u_int32_t len, u_int64_t hash) const;
+
+ public:
+  ZMQFieldIndex();
+  ~ZMQFieldIndex();
+
+  /* Adds or updates a label. Call compile() once done adding labels. */
+  void addLabel(const char *label, u_int32_t field, u_int32_t pen);
+  /* Rebuilds the perfect hash of the labels */
+  bool compile();
+
+  /* Declares a field handled by the no-PEN (pen 0) or the ntop (NTOP_PEN) parser */
+  void setHandled(u_int32_t field, u_int32_t pen);
+  /* Declares the fields of all the labels added so far as handled */
+  void setLabelsHandled();
+
+  /* Same as the former ZMQParserInterface::getKeyId: false if the key is neither numeric nor a known label */
+  bool resolve(const char *key, u_int32_t key_len, u_int32_t * const pen, u_int32_t * const field) const;
+
+  inline ZMQFieldDispatch getDispatch(u_int32_t pen, u_int32_t field) const {
+    if(pen == NTOP_PEN) return(zmq_field_ntop_pen);
+    if(pen != 0)        return(zmq_field_unhandled);
+
+    /* Ids out of the table are tried with both parsers */
+    if(!dispatch || (field >= ZMQ_FIELD_DISPATCH_SIZE)) return(zmq_field_pen_zero);
+
+    return((ZMQFieldDispatch)dispatch[field]);
+  };
+
+  inline u_int32_t getNumLabels() const { return(labels.size()); };
+};
+
+#endif /* _ZMQ_FIELD_INDEX_H_ */
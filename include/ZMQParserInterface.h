@@ -26,9 +26,8 @@
 
 class ZMQParserInterface : public ParserInterface {
  private:
-  typedef std::pair<u_int32_t, u_int32_t> pen_value_t;
-  typedef std::map<string, pen_value_t > labels_map_t;
-  labels_map_t labels_map;
+  ZMQFieldIndex field_index;
+  u_int64_t tlv_num_flows, tlv_parse_usec; /* TLV ingestion rate, e.g. when replaying flows with tools/json2tlv */
   bool once;
   u_int32_t flow_max_idle;
   u_int64_t zmq_initial_bytes, zmq_initial_pkts,
@@ -42,7 +41,10 @@ class ZMQParserInterface : public ParserInterface {
 #endif
 
   bool preprocessFlow(ParsedFlow *flow);
-  bool getKeyId(char *sym, u_int32_t sym_len, u_int32_t * const pen, u_int32_t * const field) const;
+  inline bool getKeyId(const char *sym, u_int32_t sym_len, u_int32_t * const pen, u_int32_t * const field) const {
+    return(field_index.resolve(sym, sym_len, pen, field));
+  };
+  bool parseField(ParsedFlow * const flow, u_int32_t pen, u_int32_t field, ParsedValue *value) const;
   void addMapping(const char *sym, u_int32_t num, u_int32_t pen = 0);
   bool parsePENZeroField(ParsedFlow * const flow, u_int32_t field, ParsedValue *value) const;
   bool parsePENNtopField(ParsedFlow * const flow, u_int32_t field, ParsedValue *value) const;
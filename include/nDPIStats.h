@@ -76,8 +76,16 @@ class nDPIStats {
   char* serialize(NetworkInterface *iface);
   json_object* getJSONObject(NetworkInterface *iface);
   void deserialize(NetworkInterface *iface, json_object *o);
+  void serializeBinary(NetworkInterface *iface, BinarySerializer *s) const;
+  void deserializeBinary(NetworkInterface *iface, BinaryDeserializer *d);
+  void serializeCategoriesBinary(BinarySerializer *s) const;
+  void deserializeCategoriesBinary(BinaryDeserializer *d);
   void sum(nDPIStats *s) const;
 
+  inline const ProtoCounter* getProtoCounter(u_int16_t proto_id) const {
+    return((proto_id < MAX_NDPI_PROTOS) ? counters[proto_id] : NULL);
+  }
+
   inline u_int64_t getProtoBytes(u_int16_t proto_id) { 
     if((proto_id < MAX_NDPI_PROTOS) && counters[proto_id]) {
       TrafficCounter *tc = &counters[proto_id]->bytes;
@@ -113,6 +113,7 @@
 #define ZMQ_COMPATIBILITY_MSG_VERSION 1
 #define ZMQ_MSG_VERSION           2
 #define ZMQ_MSG_VERSION_TLV       3
+#define ZMQ_FIELD_DISPATCH_SIZE   (NTOP_BASE_ID + 2048) /* Field ids with a precomputed parser, see ZMQFieldIndex */
 #define LOGIN_URL                 "/lua/login.lua"
 #define LOGOUT_URL                "/lua/logout.lua"
 #define CAPTIVE_PORTAL_URL        "/lua/captive_portal.lua"
@@ -189,6 +190,8 @@
 #define CONST_DEFAULT_TOP_TALKERS_ENABLED        false
 #define PURGE_FRACTION           60 /* check 1/60 of hashes per iteration */
 #define MIN_NUM_VISITED_ENTRIES  1024
+#define IDLE_WHEEL_RETRY_DELAY   5   /* sec - re-check delay of expired wheel entries not yet ready to be idled */
+#define IDLE_LAG_HISTOGRAM_SLOTS 121 /* 1 sec bins of the idle expiration lag, the last one collects the overflow */
 #define MAX_NUM_QUEUED_ADDRS    500 /* Maximum number of queued address for resolution */
 #define MAX_NUM_QUEUED_CONTACTS 25000
 #define NTOP_COPYRIGHT          "(C) 1998-20 ntop.org"
@@ -218,6 +221,7 @@
 
 #define TRAFFIC_FILTERING_CACHE_DURATION  43200 /* 12 h */
 #define DNS_CACHE_DURATION                 3600  /*  1 h */
+#define DNS_NEGATIVE_CACHE_DURATION         300  /*  5 min, for timeouts and server failures */
 #define LOCAL_HOSTS_CACHE_DURATION         3600  /*  1 h */
 #define HOST_LABEL_NAMES_KEY    "ntopng.cache.host_labels.%s"
 #define IFACE_DHCP_RANGE_KEY    "ntopng.prefs.ifid_%u.dhcp_ranges"
@@ -277,6 +281,7 @@
 #define CONST_INTERFACE_TYPE_SYSLOG    "syslog"
 #define CONST_INTERFACE_TYPE_VLAN      "Dynamic VLAN"
 #define CONST_INTERFACE_TYPE_FLOW      "Dynamic Flow Collection"
+#define CONST_INTERFACE_TYPE_SHARD     "Dissection Shard"
 #define CONST_INTERFACE_TYPE_VIEW      "view"
 #define CONST_INTERFACE_TYPE_PF_RING   "PF_RING"
 #define CONST_INTERFACE_TYPE_NETFILTER "netfilter"
@@ -289,6 +294,8 @@
 #define CONST_DEMO_MODE_DURATION       600 /* 10 min */
 #define CONST_MAX_DUMP_DURATION        300 /* 5 min */
 #define CONST_MAX_NUM_PACKETS_PER_LIVE 100000 /* live captures via HTTP */
+#define CONST_LIVE_CAPTURE_RING_LEN    (4 * 1024 * 1024) /* bytes buffered per live capture */
+#define CONST_LIVE_CAPTURE_SEND_USEC   10000 /* sender wait when nothing is buffered */
 #define CONST_MAX_DUMP                 500000000
 
 #define CONST_MAX_NUM_LIVE_EXTRACTIONS 2
@@ -443,6 +450,7 @@
 #define MAX_SYSLOG_POLLS_BEFORE_PURGE  MAX_ZMQ_POLLS_BEFORE_PURGE
 #define CONST_MAX_NUM_FIND_HITS       10
 #define CONST_MAX_NUM_HITS         32768 /* Decrease it for small installations */
+#define RETRIEVER_TOP_K_BUFFER_FACTOR  4 /* Flows/hosts paged listings buffer this many times the requested entries before pruning */
 
 /* Controls for periodic_stats_update (avoid executing it too often, or when not necessary) */
 #define PERIODIC_STATS_UPDATE_MIN_REFRESH_BYTES   10 * (2 << 19 /* MB */)
@@ -471,6 +479,9 @@
 #define CONST_MAX_REDIS_CONN_RETRIES 16
 #define CONST_MAX_LEN_REDIS_KEY      256
 #define CONST_MAX_LEN_REDIS_VALUE    2*65526
+#define CONST_REDIS_POOL_SIZE        8  /* Connections of the main Redis instance, threads are bound to one of them */
+#define REDIS_LATENCY_HISTOGRAM_SLOTS 21 /* Powers of two of usec: up to ~1 sec */
+#define REDIS_PIPELINE_BATCH         256 /* Max keys written per pipelined batch */
 
 #define NTOPNG_NDPI_OS_PROTO_ID      (NDPI_LAST_IMPLEMENTED_PROTOCOL+NDPI_MAX_NUM_CUSTOM_PROTOCOLS-2)
 #define CONST_DEFAULT_HOME_NET       "192.168.1.0/24"
@@ -482,6 +493,8 @@
 #define CONST_DEFAULT_PACKETS_DROP_PERCENTAGE_ALERT       5
 #define CONST_DEFAULT_IS_ACTIVE_LOCAL_HOSTS_CACHE_ENABLED 0
 #define CONST_DEFAULT_ACTIVE_LOCAL_HOSTS_CACHE_INTERVAL   3600 /* Every hour by default */
+#define CONST_DEFAULT_IS_LOCAL_HOSTS_CACHE_JSON           0 /* Binary serialization by default */
+#define CONST_DEFAULT_IS_TABLES_SNAPSHOT_ENABLED          0
 #define CONST_DEFAULT_DOCS_DIR       "httpdocs"
 #define CONST_DEFAULT_SCRIPTS_DIR    "scripts"
 #define CONST_DEFAULT_CALLBACKS_DIR  "scripts/callbacks"
@@ -526,6 +539,7 @@
 #define CONST_FLOW_ALERT_EVENT_QUEUE       "ntopng.cache.ifid_%d.flow_alerts_events_queue"
 #define SQLITE_ALERTS_QUEUE_SIZE           8192
 #define ALERTS_NOTIFICATIONS_QUEUE_SIZE    8192
+#define RECIPIENT_BULK_DEQUEUE_BATCH       64 /* Notifications dequeued at once by ntop.recipient_dequeue_bulk() */
 #define MAX_NUM_RECIPIENTS                 64 /* keep in sync with Recipients.lua recipients.MAX_NUM_RECIPIENTS */
 #define INTERNAL_ALERTS_QUEUE_SIZE         1024
 #define CONST_REMOTE_TO_REMOTE_MAX_QUEUE   32
@@ -602,6 +616,8 @@
 #define CONST_RUNTIME_IDLE_LOCAL_HOSTS_CACHE_ENABLED   NTOPNG_PREFS_PREFIX".is_local_host_cache_enabled"
 #define CONST_RUNTIME_ACTIVE_LOCAL_HOSTS_CACHE_ENABLED NTOPNG_PREFS_PREFIX".is_active_local_host_cache_enabled"
 #define CONST_RUNTIME_ACTIVE_LOCAL_HOSTS_CACHE_INTERVAL NTOPNG_PREFS_PREFIX".active_local_host_cache_interval"
+#define CONST_RUNTIME_LOCAL_HOSTS_CACHE_JSON           NTOPNG_PREFS_PREFIX".is_local_host_cache_json"
+#define CONST_RUNTIME_TABLES_SNAPSHOT_ENABLED          NTOPNG_PREFS_PREFIX".is_tables_snapshot_enabled"
 #define CONST_RUNTIME_PREFS_LOG_TO_FILE                NTOPNG_PREFS_PREFIX".log_to_file"
 #define CONST_RUNTIME_PREFS_HOUSEKEEPING_FREQUENCY     NTOPNG_PREFS_PREFIX".housekeeping_frequency"
 #define CONST_RUNTIME_PREFS_FLOW_DEVICE_PORT_RRD_CREATION     NTOPNG_PREFS_PREFIX".flow_device_port_rrd_creation" /* 0 / 1 */
@@ -641,6 +657,13 @@
 #define CONST_MAX_ALERT_MSG_QUEUE_LEN 8192
 #define CONST_MAX_ES_MSG_QUEUE_LEN    8192
 #define CONST_MAX_MYSQL_QUEUE_LEN     8192
+#define MYSQL_DEFAULT_BATCH_SIZE      256     /* --mysql-batch-size */
+#define MYSQL_MAX_BATCH_SIZE          4096
+#define MYSQL_MAX_NUM_WRITERS         8       /* --mysql-writers */
+#define MYSQL_BATCH_FLUSH_SEC         1       /* Max time a flow waits in a batch */
+#define MYSQL_MAX_BATCH_QUERY_LEN     1048576 /* Keep below the server max_allowed_packet */
+#define MYSQL_WRITER_DEQUEUE_BATCH    64
+#define MYSQL_WRITER_RETRY_SEC        1       /* Reconnection attempts while batches are retained */
 #define CONST_MAX_NUM_READ_ALERTS     32
 #define CONST_MAX_ACTIVITY_DURATION    86400 /* sec */
 #define CONST_TREND_TIME_GRANULARITY   1 /* sec */
@@ -649,6 +672,11 @@
 #define CONST_DEFAULT_ALL_NETS         "0.0.0.0/0,::/0"
 
 #define CONST_NUM_RESOLVERS            2
+#define DNS_RESOLVER_MAX_OUTSTANDING   4096 /* PTR queries in flight (< 65536) */
+#define DNS_RESOLVER_MAX_QPS           500
+#define DNS_RESOLVER_TIMEOUT_MSEC      2000
+#define DNS_RESOLVER_MAX_RETRIES       2
+#define DNS_RESOLVER_POLL_MSEC         100
 
 #define PAGE_NOT_FOUND     "<html><head><title>ntop</title></head><body><center><img src=/img/warning.png> Page &quot;%s&quot; was not found</body></html>"
 #define PAGE_ERROR         "<html><head><title>ntop</title></head><body><img src=/img/warning.png> Script &quot;%s&quot; returned an error:\n<p><H3>%s</H3></body></html>"
@@ -840,6 +868,8 @@
 
 #define ALERTS_MANAGER_MAX_ENTITY_ALERTS     1024
 #define ALERTS_MANAGER_MAX_FLOW_ALERTS       16384
+#define ALERTS_MANAGER_MAX_QUEUED_ALERTS     32768 /* Alerts waiting for the writer thread, further alerts are dropped */
+#define ALERTS_MANAGER_WRITE_BATCH           512   /* Max number of alerts written in a single transaction */
 #define ALERTS_MANAGER_FLOWS_TABLE_NAME      "flows_alerts"
 #define ALERTS_MANAGER_TABLE_NAME            "alerts"
 #define ALERTS_MANAGER_STORE_NAME            "alerts_v20.db"
@@ -930,12 +960,19 @@
 #define NTOP_ES_TEMPLATE              "ntopng_template_elk.json"
 #define NTOP_ES6_TEMPLATE             "ntopng_template_elk6.json"
 #define NTOP_ES7_TEMPLATE             "ntopng_template_elk7.json"
-#define ES_MAX_QUEUE_LEN              32768
-#define ES_BULK_BUFFER_SIZE           1*1024*1024
+#define ES_BULK_BUFFER_SIZE           (1*1024*1024)
 #define ES_BULK_MAX_DELAY             5
+#define ES_NUM_BULK_BUFFERS           32      /* Preallocated bulk buffers, shared by all the writers */
+#define ES_DEFAULT_NUM_WRITERS        2       /* --es-writers */
+#define ES_MAX_NUM_WRITERS            8
+#define ES_BULK_POST_TIMEOUT          30
+#define ES_BULK_RESPONSE_LEN          (1*1024*1024) /* Per-document statuses of a _bulk request */
 
 /* Logstash */
 #define LS_MAX_QUEUE_LEN              32768
+
+#define GEOLOCATION_CACHE_MAX_NETWORKS 131072 /* Per database */
+
 /* Unknown values for host groups */
 #define UNKNOWN_CONTINENT     ""
 #define UNKNOWN_COUNTRY       ""
@@ -974,6 +1011,10 @@
 #define HTTP_MAX_CONTENT_TYPE_LENGTH    63
 #define HTTP_MAX_HEADER_LINES           20
 #define HTTP_MAX_POST_DATA_LEN          65536
+#define HTTP_NUM_THREADS                5
+#define LUA_VM_POOL_MAX_USES            1000 /* Requests served by a pooled Lua engine before it is recreated */
+#define LUA_VM_POOL_MAX_ENDPOINTS       1024 /* Endpoints with per-request timings */
+#define PROMETHEUS_BUFFER_SIZE          (64*1024) /* Initial size of the /metrics text buffer, grown as needed */
 #define HTTP_CONTENT_TYPE_HEADER        "Content-Type: "
 #define CONST_HELLO_HOST                "hello"
 
@@ -1034,11 +1075,15 @@ extern struct ntopngLuaContext* getUserdata(struct lua_State *vm);
 #define MAX_US_PROTOCOL_DETECTED_QUEUE_LEN 131072
 #define MAX_US_FLOW_END_QUEUE_LEN          131072
 #define MAX_US_PERIODIC_UPDATE_QUEUE_LEN   16384  /* Smaller, lower-priority */
+#define FLOW_HOOKS_DEQUEUE_BATCH           32     /* Flows dequeued at once by the hooks thread */
+#define MAX_NUM_FLOW_HOOK_THREADS          8      /* --flow-hook-threads */
 
 /*
   user-script lua engine lifetime 
  */
 #define HOOKS_ENGINE_LIFETIME              600    /* Seconds */
+#define MAX_NUM_FLOW_CHECKS                16     /* Native (C++) flow checks */
+#define FLOW_CHECK_INFO_LEN                128    /* JSON status info of a native flow check */
 
 /*
   Queue length for view interfaces
@@ -1046,6 +1091,56 @@ extern struct ntopngLuaContext* getUserdata(struct lua_State *vm);
 
 #define MAX_VIEW_INTERFACE_QUEUE_LEN       131072
 
+/*
+  Packet dissection threads (--dissection-threads)
+ */
+#define MAX_NUM_DISSECTION_THREADS         16
+#define DISSECTION_WORKER_QUEUE_LEN        8192 /* Full-sized packets buffered per worker */
+#define DISSECTION_WORKER_WRAP_MARKER      0xFFFFFFFF /* caplen of the record preceding a ring wrap */
+#define DISSECTION_SHARD_SLOT_BITS         24 /* Partial flow walks keep the shard index above these bits of the slot */
+#define DISSECTION_SHARD_FLOWS_BUDGET      512 /* Shard flows merged by the capture thread per shard and call */
+#define MEMORY_POOL_SLAB_LEN               256 /* Blocks allocated at once by a MemoryPool */
+#define MEMORY_POOL_MAX_SLABS              65536 /* Further allocations fall back to malloc() */
+#define MEMORY_POOL_CARVE_BATCH            32  /* Never-used blocks moved to the free stack at once */
+#define MEMORY_POOL_HEADER_LEN             16  /* Keeps the objects 16-byte aligned */
+
+/*
+  Local hosts cache hydration (see LocalHostHydrator)
+ */
+#define LOCAL_HOST_HYDRATION_QUEUE_LEN     8192
+#define LOCAL_HOST_HYDRATION_BATCH         32     /* Jobs dequeued, or applied, at once */
+
+/*
+  Binary serialization of the cached elements (see BinarySerializer)
+ */
+#define BINARY_SERIALIZATION_MAGIC         0xB5   /* Never the first byte of a JSON serialization */
+#define BINARY_SERIALIZATION_VERSION       1
+#define BINARY_SERIALIZATION_INITIAL_LEN   1024
+#define CARDINALITY_MIN_BITS               4      /* Precisions accepted by ndpi_hll_init() */
+#define CARDINALITY_MAX_BITS               20
+
+/*
+  Native packet recorder (--packet-recorder, see PacketRecorder)
+ */
+#define PACKET_RECORDER_DIR                "recorder"
+#define PACKET_RECORDER_RING_LEN           (256 * 1024 * 1024) /* Packets buffered for the writer */
+#define PACKET_RECORDER_SEGMENT_LEN        (1024 * 1024 * 1024) /* Size of the pcap segments */
+#define PACKET_RECORDER_WRITE_LEN          (8 * 1024 * 1024) /* Max bytes written at once */
+#define PACKET_RECORDER_WRITER_USEC        10000 /* Writer wait when nothing is buffered */
+#define PACKET_RECORDER_READ_LEN           (4 * 1024 * 1024) /* Read buffer of the extractions */
+#define PACKET_RECORDER_FLOW_READ_LEN      (64 * 1024) /* Read size of the flow extractions */
+#define PACKET_RECORDER_MAX_CAPLEN         262144 /* Larger records are corrupted */
+#define PACKET_RECORDER_INDEX_MAGIC        0x58444952 /* "RIDX" */
+#define PACKET_RECORDER_INDEX_VERSION      1
+
+/*
+  Warm-restart snapshot of the flow, host and MAC tables (see TablesSnapshot)
+ */
+#define TABLES_SNAPSHOT_FILE               "tables.snapshot"
+#define TABLES_SNAPSHOT_INITIAL_LEN        (16 * 1024 * 1024) /* The file is grown by doubling it */
+#define TABLES_SNAPSHOT_MAX_AGE            3600  /* sec, older snapshots are not restored */
+#define TABLES_SNAPSHOT_FORMAT             2     /* Snapshots of a different format are not restored */
+
 #ifdef NTOPNG_EMBEDDED_EDITION
 #define DEFAULT_THREAD_POOL_SIZE     1
 #define MAX_THREAD_POOL_SIZE         1
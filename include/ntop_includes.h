@@ -72,6 +72,7 @@
 #include <dirent.h>
 #include <pwd.h>
 #include <sys/select.h>
+#include <sys/mman.h>
 #endif
 
 #ifdef __linux__
@@ -196,6 +197,8 @@ using namespace std;
 #include "patricia.h"
 #include "ntop_defines.h"
 #include "Mutex.h"
+#include "MemoryPool.h"
+#include "BinarySerializer.h"
 #include "RwLock.h"
 #include "Bitmask.h"
 #include "Bloom.h"
@@ -221,6 +224,7 @@ using namespace std;
 #include "Trace.h"
 #include "ProtoStats.h"
 #include "Utils.h"
+#include "JSONStreamWriter.h"
 #include "Bitmap.h"
 #include "NtopGlobals.h"
 #include "nDPIStats.h"
@@ -281,6 +285,7 @@ using namespace std;
 #include "PacketDumperGeneric.h"
 #include "PacketDumper.h"
 #include "PacketDumperTuntap.h"
+#include "FlowTuple.h"
 #include "TimelineExtract.h"
 #include "TcpFlowStats.h"
 #include "StoreManager.h"
@@ -291,6 +296,7 @@ using namespace std;
 #include "MySQLDB.h"
 #endif
 #include "InterfaceStatsHash.h"
+#include "TimingWheel.h"
 #include "GenericHash.h"
 #include "GenericHashEntry.h"
 #if defined(NTOPNG_PRO) && defined(HAVE_NINDEX)
@@ -306,6 +312,7 @@ using namespace std;
 #include "AlertsQueue.h"
 #include "LuaEngine.h"
 #include "SPSCQueue.h"
+#include "MPMCQueue.h"
 #include "LuaReusableEngine.h"
 #include "AlertCheckLuaEngine.h"
 #include "FlowAlertCheckLuaEngine.h"
@@ -314,6 +321,7 @@ using namespace std;
 #include "FifoStringsQueue.h"
 #include "FifoSerializerQueue.h"
 #include "RRDTimeseriesExporter.h"
+#include "RecipientNotification.h"
 #include "RecipientQueues.h"
 #include "Recipients.h"
 #ifdef NTOPNG_PRO
@@ -323,6 +331,16 @@ using namespace std;
 #include "PeriodicityMap.h"
 #endif
 #include "NetworkInterface.h"
+#include "DissectionWorker.h"
+#include "PcapRing.h"
+#include "PacketRecorder.h"
+#include "PacketRecorderReader.h"
+#include "FlowCheck.h"
+#include "BuiltinFlowChecks.h"
+#include "FlowChecksExecutor.h"
+#include "FlowHooksWorker.h"
+#include "LocalHostHydrator.h"
+#include "TablesSnapshot.h"
 #ifndef HAVE_NEDGE
 #include "PcapInterface.h"
 #endif
@@ -361,6 +379,7 @@ using namespace std;
 #endif
 #ifndef HAVE_NEDGE
 #include "ParserInterface.h"
+#include "ZMQFieldIndex.h"
 #include "ZMQParserInterface.h"
 #include "ZMQCollectorInterface.h"
 #include "SyslogParserInterface.h"
@@ -370,6 +389,7 @@ using namespace std;
 #include "ExportInterface.h"
 #endif
 
+#include "GeolocationCache.h"
 #include "Geolocation.h"
 #include "Vlan.h"
 #include "AutonomousSystem.h"
@@ -397,7 +417,10 @@ using namespace std;
 #include "ThreadPool.h"
 #include "PeriodicActivities.h"
 #include "MacManufacturers.h"
+#include "AsyncResolver.h"
 #include "AddressResolution.h"
+#include "LuaVMPool.h"
+#include "PrometheusExporter.h"
 #include "HTTPserver.h"
 #include "Paginator.h"
 #include "Ntop.h"
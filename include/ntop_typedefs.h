@@ -348,6 +348,12 @@ struct string_list {
 typedef u_int8_t FlowStatus;
 #define status_normal 0
 
+/* Statuses set by the native flow checks. Keep in sync with scripts/lua/modules/flow_keys.lua */
+#define status_blacklisted         1
+#define status_remote_to_remote    16
+#define status_udp_unidirectional  26
+#define status_web_mining_detected 27
+
 typedef enum {
   flow_lua_call_protocol_detected = 0,
   flow_lua_call_periodic_update = 1,
@@ -610,6 +616,8 @@ class NetworkStats;
 class Host;
 class Flow;
 class FlowAlertCheckLuaEngine;
+class FlowChecksExecutor;
+class PcapRing;
 class ThreadedActivity;
 class ThreadedActivityStats;
 
@@ -631,6 +639,7 @@ struct ntopngLuaContext {
   Host *host;
   NetworkStats *network;
   Flow *flow;
+  FlowChecksExecutor *flow_checks; /* Native flow checks executed along with the flow hooks */
   bool localuser;
 
   /* Capabilities bitmap */
@@ -651,6 +660,7 @@ struct ntopngLuaContext {
     void *matching_host;
     bool bpfFilterSet;
     struct bpf_program fcode;
+    PcapRing *ring; /* Filled by the capture thread, sent by the HTTP thread */
     
     /* Status */
     bool pcaphdr_sent;
@@ -750,6 +760,33 @@ struct pcap_disk_pkthdr {
   u_int32_t len;               /* length this packet (off wire) */
 };
 
+/*
+  Sidecar index of a segment of the PacketRecorder (<id>.idx): the header is
+  followed by the time entries and by the flow entries, sorted by flow hash
+ */
+typedef struct recorder_index_header {
+  u_int32_t magic, version;
+  u_int32_t first_ts, last_ts;
+  u_int64_t pcap_len;
+  u_int32_t num_time_entries, num_flow_entries;
+} recorder_index_header;
+
+typedef struct recorder_time_entry {
+  u_int32_t sec;    /* Time of the first packet recorded in this second */
+  u_int32_t offset; /* Offset of the packet in the pcap segment */
+} recorder_time_entry;
+
+typedef struct recorder_flow_entry {
+  u_int32_t flow_hash; /* DissectionWorker::packetHash() of the packet */
+  u_int32_t offset;
+} recorder_flow_entry;
+
+typedef struct recorder_segment_info {
+  u_int32_t id;
+  u_int32_t first_ts, last_ts;
+  u_int64_t pcap_len;
+} recorder_segment_info;
+
 typedef struct dhcp_range {
   IpAddress first_ip;
   IpAddress last_ip;
@@ -793,6 +830,55 @@ typedef enum mud_recording {
   mud_recording_disabled = 3,
 } MudRecording;
 
+/* Redis commands, grouped for the latency stats. Keep in sync with redis_cmd_names in Redis.cpp */
+typedef enum {
+  redis_cmd_get = 0,
+  redis_cmd_set,
+  redis_cmd_del,
+  redis_cmd_expire,   /* EXPIRE, TTL */
+  redis_cmd_hash,
+  redis_cmd_keys,
+  redis_cmd_list,
+  redis_cmd_pipeline, /* Batch of pipelined commands */
+  redis_cmd_other,
+  redis_cmd_max
+} RedisCommandType;
+
+/* How a collected flow field id is parsed, see ZMQFieldIndex */
+typedef enum {
+  zmq_field_unhandled = 0, /* Neither parsed as a no-PEN nor as an ntop field */
+  zmq_field_pen_zero,      /* Parsed as a no-PEN field, falling back to the ntop parser */
+  zmq_field_ntop_pen       /* Parsed as an ntop field */
+} ZMQFieldDispatch;
+
+/* Local hosts cache operations performed by the LocalHostHydrator */
+typedef enum {
+  local_host_hydration_restore = 0, /* Fetch the cached state (and name) of a new host */
+  local_host_hydration_serialize,   /* Cache the state of an idle host */
+  local_host_hydration_delete       /* Delete the cached state of an idle host */
+} LocalHostHydrationType;
+
+/* Sections of the binary serialization of a local host (see BinarySerializer): never renumber */
+typedef enum {
+  binary_section_host = 1,         /* First seen, last stats reset, OS and MAC */
+  binary_section_traffic,          /* Sent/rcvd traffic, dropped flows, activity time, UDP */
+  binary_section_l4,               /* TCP/UDP/ICMP/other IP traffic */
+  binary_section_packets,          /* Packet size and TCP flags distribution */
+  binary_section_tcp_packets,      /* Retransmissions, out of order, lost, keep-alive */
+  binary_section_flows,            /* Flows, alerted and unreachable flows */
+  binary_section_dns,
+  binary_section_http,
+  binary_section_ndpi,             /* Sparse nDPI protocols */
+  binary_section_ndpi_categories,  /* Sparse nDPI categories */
+  binary_section_contacts,         /* HyperLogLog registers of the contacted peers and ports */
+
+  /* Records of the tables snapshot (see TablesSnapshot) */
+  binary_section_snapshot_info = 32,
+  binary_section_snapshot_mac,
+  binary_section_snapshot_host,
+  binary_section_snapshot_flow
+} BinarySectionType;
+
 /* Wrapper for pcap_if_t and pfring_if_t */
 typedef struct _ntop_if_t {
   /* pcap fields */
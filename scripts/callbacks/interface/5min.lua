@@ -26,3 +26,11 @@ if not hasHighResolutionTs() then
   ts_dump.run_5min_dump(_ifname, ifstats, config, when, verbose)
 -- else: perform the ts_dump.run_5min_dump in minute.lua
 end
+
+-- ########################################################
+
+-- checkpoint of the flow, host and MAC tables, restored at startup
+-- in order to protect from failures (e.g., power losses)
+if ntop.getPrefs().is_tables_snapshot_enabled then
+  interface.snapshotTables()
+end
@@ -194,6 +194,44 @@ end
 
 -- #################################################################
 
+-- Called by the flow hooks worker after setup(): the enabled scripts which are
+-- also implemented in C are executed natively and removed from the Lua hooks
+function setupNativeChecks()
+   if not available_modules then
+      return
+   end
+
+   local enabled_scripts = {}
+
+   for script_key in pairs(available_modules.modules) do
+      enabled_scripts[script_key] = true
+   end
+
+   local native_scripts = flow.setNativeChecks(enabled_scripts) or {}
+
+   for _, hooks in pairs(available_modules.l4_hooks) do
+      for hook_name, modules in pairs(hooks) do
+	 local lua_modules = {}
+
+	 for _, mod in ipairs(modules) do
+	    if not native_scripts[mod.mod_key] then
+	       lua_modules[#lua_modules + 1] = mod
+	    end
+	 end
+
+	 hooks[hook_name] = lua_modules
+      end
+   end
+
+   if do_trace then
+      for script_key in pairs(native_scripts) do
+	 trace_f(string.format("flow.lua: %s is executed natively", script_key))
+      end
+   end
+end
+
+-- #################################################################
+
 -- The function below is called once (#pragma once) right before
 -- the lua virtual machine is destroyed
 function teardown()
@@ -274,6 +312,23 @@ end
 
 -- #################################################################
 
+-- @brief Sets the status predominant among those set by the native checks,
+-- executed right before the Lua hooks, as the current alerted status
+local function setNativeAlertedStatus(native_status)
+   local status_type = flow_consts.getStatusType(native_status.status_key)
+
+   if not status_type then
+      return
+   end
+
+   alerted_status = status_type
+   alert_type_params = json.decode(native_status.status_info or "") or {}
+   alerted_status_score = native_status.score
+   alerted_user_script = available_modules.modules[native_status.script_key]
+end
+
+-- #################################################################
+
 -- Function for the actual module execution. Iterates over available (and enabled)
 -- modules, calling them one after one.
 -- @param l4_proto the L4 protocol of the flow
@@ -302,12 +357,22 @@ local function call_modules(l4_proto, master_id, app_id, mod_fn, update_ctr)
       hooks = hooks[mod_fn]
    end
 
-   if not hooks then
+   local native_status = flow.getNativeChecksStatus()
+
+   if native_status then
+      setNativeAlertedStatus(native_status)
+   end
+
+   if not hooks or (#hooks == 0) then
       if do_trace then
 	 trace_f(string.format("No flow.lua modules, skipping %s(%d) for %s", mod_fn, l4_proto, shortFlowLabel(flow.getInfo())))
       end
 
-      return true
+      if not alerted_status then
+	 return true
+      end
+
+      hooks = {}
    end
 
    if do_trace then
@@ -0,0 +1,167 @@
+--
+-- (C) 2020 - ntop.org
+--
+-- /metrics?engine=lua: the metrics of PrometheusExporter, rendered from the
+-- Lua bindings. /metrics is served natively, this script is kept to compare
+-- the two paths.
+--
+
+local dirs = ntop.getDirs()
+package.path = dirs.installdir .. "/scripts/lua/modules/?.lua;" .. package.path
+
+require "lua_utils"
+
+sendHTTPContentTypeHeader('text/plain; version=0.0.4')
+
+-- ################################################
+
+local iface_metrics = {
+   { "ntopng_interface_packets_total",        "counter", "Packets received by the interface",      function(s) return s.stats.packets end },
+   { "ntopng_interface_bytes_total",          "counter", "Bytes received by the interface",        function(s) return s.stats.bytes end },
+   { "ntopng_interface_packet_drops_total",   "counter", "Packets dropped by the interface",       function(s) return s.stats.drops end },
+   { "ntopng_interface_new_flows_total",      "counter", "Flows created on the interface",         function(s) return s.stats.new_flows end },
+   { "ntopng_interface_flows",                "gauge",   "Active flows",                           function(s) return s.stats.flows end },
+   { "ntopng_interface_hosts",                "gauge",   "Active hosts",                           function(s) return s.stats.hosts end },
+   { "ntopng_interface_local_hosts",          "gauge",   "Active local hosts",                     function(s) return s.stats.local_hosts end },
+   { "ntopng_interface_macs",                 "gauge",   "Active MAC addresses",                   function(s) return s.stats.current_macs end },
+   { "ntopng_interface_alerted_flows",        "gauge",   "Active flows with an alert",             function(s) return s.num_alerted_flows end },
+   { "ntopng_interface_engaged_alerts",       "gauge",   "Alerts currently engaged",               function(s) return s.num_alerts_engaged end },
+   { "ntopng_interface_dropped_alerts_total", "counter", "Alerts dropped as the queues were full", function(s) return s.num_dropped_alerts end },
+}
+
+local out = {}
+
+-- ################################################
+
+local function label_value(v)
+   return '"' .. tostring(v or ""):gsub('\\', '\\\\'):gsub('"', '\\"'):gsub('\n', '\\n') .. '"'
+end
+
+local function family(name, type, help)
+   out[#out + 1] = string.format("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type)
+end
+
+local function sample(name, iface, labels, value)
+   out[#out + 1] = string.format("%s{ifid=\"%d\",ifname=%s%s} %u\n", name, iface.id, label_value(iface.name), labels or "", value or 0)
+end
+
+-- ################################################
+
+-- Interfaces the user is allowed to see, with the system interface for unrestricted users
+local ifaces = {}
+local allowed_ifname = ntop.getCache("ntopng.user." .. (_SESSION["user"] or "") .. ".allowed_ifname")
+
+for id, name in pairsByKeys(interface.getIfNames(), asc) do
+   interface.select(name)
+   ifaces[#ifaces + 1] = { id = tonumber(id), name = name, stats = interface.getStats(),
+			   hash_tables = interface.getHashTablesStats(), queues = interface.getQueuesStats(),
+			   activities = interface.getPeriodicActivitiesStats() }
+end
+
+local system_iface = nil
+
+if isEmptyString(allowed_ifname) then
+   interface.select(getSystemInterfaceId())
+   system_iface = { id = tonumber(getSystemInterfaceId()), name = getSystemInterfaceName(),
+		    activities = interface.getPeriodicActivitiesStats() }
+end
+
+-- ################################################
+
+for _, m in ipairs(iface_metrics) do
+   family(m[1], m[2], m[3])
+
+   for _, iface in ipairs(ifaces) do
+      sample(m[1], iface, nil, m[4](iface.stats))
+   end
+end
+
+-- ################################################
+
+local hash_metrics = {
+   { "ntopng_hash_table_entries",      "Entries of the hash table",         function(s) return s.hash_entry_states.hash_entry_state_active end },
+   { "ntopng_hash_table_idle_entries", "Idle entries waiting to be purged", function(s) return s.hash_entry_states.hash_entry_state_idle end },
+   { "ntopng_hash_table_max_entries",  "Max entries of the hash table",     function(s) return s.max_hash_size end },
+}
+
+for _, m in ipairs(hash_metrics) do
+   family(m[1], "gauge", m[2])
+
+   for _, iface in ipairs(ifaces) do
+      for name, s in pairsByKeys(iface.hash_tables or {}, asc) do
+	 sample(m[1], iface, ",hash=" .. label_value(name), m[3](s))
+      end
+   end
+end
+
+-- ################################################
+
+local queue_metrics = {
+   { "ntopng_queue_length",                "gauge",   "Items waiting in the queue",               "length" },
+   { "ntopng_queue_failed_enqueues_total", "counter", "Items not enqueued as the queue was full", "num_failed_enqueues" },
+}
+
+for _, m in ipairs(queue_metrics) do
+   family(m[1], m[2], m[3])
+
+   for _, iface in ipairs(ifaces) do
+      for name, s in pairsByKeys(iface.queues or {}, asc) do
+	 -- Flow queues only, other entries are aggregated stats of their owners
+	 if type(s) == "table" and s.length then
+	    sample(m[1], iface, ",queue=" .. label_value(name), s[m[4]])
+	 end
+      end
+   end
+end
+
+-- ################################################
+
+local ndpi_metrics = {
+   { "ntopng_ndpi_bytes_total",   "Bytes per application protocol",   "bytes" },
+   { "ntopng_ndpi_packets_total", "Packets per application protocol", "packets" },
+   { "ntopng_ndpi_flows_total",   "Flows per application protocol",   nil },
+}
+
+for _, m in ipairs(ndpi_metrics) do
+   family(m[1], "counter", m[2])
+
+   for _, iface in ipairs(ifaces) do
+      for proto, s in pairsByKeys(iface.stats.ndpi or {}, asc) do
+	 local labels = ",proto=" .. label_value(proto)
+
+	 if m[3] then
+	    sample(m[1], iface, labels .. ",direction=\"sent\"", s[m[3] .. ".sent"])
+	    sample(m[1], iface, labels .. ",direction=\"rcvd\"", s[m[3] .. ".rcvd"])
+	 else
+	    sample(m[1], iface, labels, s.num_flows)
+	 end
+      end
+   end
+end
+
+-- ################################################
+
+local activity_metrics = {
+   { "ntopng_periodic_activity_last_duration_ms",   "gauge",   "Duration of the last run",                                function(s) return s.duration.last_duration_ms end },
+   { "ntopng_periodic_activity_max_duration_ms",    "gauge",   "Max duration of a run",                                   function(s) return s.duration.max_duration_ms end },
+   { "ntopng_periodic_activity_not_executed_total", "counter", "Runs skipped as the previous one was still in progress", function(s) return s.num_not_executed end },
+   { "ntopng_periodic_activity_slow_total",         "counter", "Runs exceeding their periodicity",                        function(s) return s.num_is_slow end },
+}
+
+local activity_ifaces = { table.unpack(ifaces) }
+
+if system_iface then
+   activity_ifaces[#activity_ifaces + 1] = system_iface
+end
+
+for _, m in ipairs(activity_metrics) do
+   family(m[1], m[2], m[3])
+
+   for _, iface in ipairs(activity_ifaces) do
+      for script, s in pairsByKeys(iface.activities or {}, asc) do
+	 sample(m[1], iface, ",script=" .. label_value(script), m[4](s))
+      end
+   end
+end
+
+print(table.concat(out))
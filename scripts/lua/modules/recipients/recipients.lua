@@ -614,9 +614,8 @@ function recipients.dispatch_notification(notification, current_script)
 	 local json_notification = json.encode(notification)
 	 local is_high_priority = is_notification_high_priority(notification)
 
-	 for _, recipient_id in pairs(recipients) do
-	    ntop.recipient_enqueue(recipient_id, is_high_priority, json_notification)
-	 end
+	 -- The notification is stored once and shared among the recipient queues
+	 ntop.recipients_enqueue(recipients, is_high_priority, json_notification)
       end
    else
 --      traceError(TRACE_ERROR, TRACE_CONSOLE, "Internal error. Empty notification")
@@ -30,7 +30,10 @@ unittest:appendTest("REST API: flows",
       local flow = jcontent.data[1]
       unittest:assertEqual(flow.column_vlan, 0, string.format("Unexpected vlan [%s]", url))
       unittest:assertEqual(flow.column_bytes, "196 Bytes", string.format("Unexpected number of bytes [%s]", url))
-      unittest:assertEqual(flow.key, 3249079264, string.format("Unexpected flow key [%s]", url))
+      -- Flow keys are computed with a hash keyed at startup: check the key leads to the same flow
+      local f = interface.findFlowByKeyAndHashId(tonumber(flow.key), tonumber(flow.hash_id))
+      unittest:assertEqual(f ~= nil, true, string.format("Unexpected flow key [%s]", url))
+      unittest:assertEqual(f["bytes"], 196, string.format("Unexpected flow for key [%s]", url))
    end
 )
 
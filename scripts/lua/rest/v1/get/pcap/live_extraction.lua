@@ -20,6 +20,7 @@ local ifid = tonumber(_GET["ifid"])
 local filter = _GET["bpf_filter"]
 local time_from = tonumber(_GET["epoch_begin"])
 local time_to = tonumber(_GET["epoch_end"])
+local l4_proto = tonumber(_GET["l4_proto"])
 
 local rc = rest_utils.consts.success.ok
 
@@ -52,8 +53,18 @@ if recording_utils.getCurrentTrafficRecordingProvider(ifid) ~= "ntopng" then
    timeline_path = recording_utils.getCurrentTrafficRecordingProviderTimelinePath(ifid)
 end
 
+-- Optional flow: only served by the packet recorder index (--packet-recorder)
+local flow
+if l4_proto ~= nil and not isEmptyString(_GET["cli_ip"]) and not isEmptyString(_GET["srv_ip"]) then
+   flow = {
+      l4_proto = l4_proto,
+      cli_ip = _GET["cli_ip"], cli_port = tonumber(_GET["cli_port"]) or 0,
+      srv_ip = _GET["srv_ip"], srv_port = tonumber(_GET["srv_port"]) or 0,
+   }
+end
+
 local fname = time_from.."-"..time_to..".pcap"
 sendHTTPContentTypeHeader('application/vnd.tcpdump.pcap', 'attachment; filename="'..fname..'"')
 
-ntop.runLiveExtraction(ifid, time_from, time_to, filter, timeline_path)
+ntop.runLiveExtraction(ifid, time_from, time_to, filter, timeline_path, flow)
 
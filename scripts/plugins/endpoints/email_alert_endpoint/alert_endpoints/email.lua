@@ -127,15 +127,7 @@ function email.dequeueRecipientAlerts(recipient, budget, high_priority)
   while budget_used <= budget and more_available do
     -- Dequeue MAX_ALERTS_PER_EMAIL notifications
 
-    local notifications = {}
-    for i = 1, MAX_ALERTS_PER_EMAIL do
-       local notification = ntop.recipient_dequeue(recipient.recipient_id, high_priority)
-       if notification then 
-	  notifications[#notifications + 1] = notification
-       else
-	  break
-       end
-    end
+    local notifications = ntop.recipient_dequeue_bulk(recipient.recipient_id, high_priority, MAX_ALERTS_PER_EMAIL)
 
     if not notifications or #notifications == 0 then
       more_available = false
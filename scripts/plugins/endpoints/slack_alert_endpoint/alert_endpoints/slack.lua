@@ -84,15 +84,7 @@ end
 -- On success, it clears the queue.
 -- On error, it leaves the queue unchagned to retry on next round.
 function slack.dequeueRecipientAlerts(recipient, budget, high_priority)
-   local notifications = {}
-   for i = 1, budget do
-      local notification = ntop.recipient_dequeue(recipient.recipient_id, high_priority)
-      if notification then 
-	 notifications[#notifications + 1] = notification
-      else
-	 break
-      end
-   end
+   local notifications = ntop.recipient_dequeue_bulk(recipient.recipient_id, high_priority, budget)
 
   if not notifications or #notifications == 0 then
     return {success = true, more_available = false}
@@ -114,9 +114,48 @@ end
 
 -- ##############################################
 
+-- The alerts writer thread drains its queue in batches: when the queue is
+-- full, wait a bit for it before giving up on the alert
+local STORE_MAX_RETRIES = 10
+local STORE_RETRY_MSEC = 100
+
+-- Pushes an alert to the SQLite writer queue. Returns true if the alert was
+-- queued, false if it was dropped (already accounted in the interface
+-- dropped alerts), nil on error
+local function storeAlert(alert, max_retries)
+   local retries = 0
+
+   while true do
+      local res
+
+      if(alert.is_flow_alert) then
+	 res = interface.storeFlowAlert(alert)
+      else
+	 res = interface.storeAlert(
+	    alert.alert_tstamp, alert.alert_tstamp_end, alert.alert_granularity,
+	    alert.alert_type, alert.alert_subtype, alert.alert_severity,
+	    alert.alert_entity, alert.alert_entity_val,
+	    alert.alert_json)
+      end
+
+      if(res == nil) then
+	 return nil
+      elseif(res.queued or (retries >= max_retries)) then
+	 return res.queued
+      end
+
+      retries = retries + 1
+      ntop.msleep(STORE_RETRY_MSEC)
+   end
+end
+
+-- ##############################################
+
 function sqlite.dequeueRecipientAlerts(recipient, budget, high_priority)
   local more_available = true
   local budget_used = 0
+  local writer_full = false
+  local num_dropped = 0
 
   -- Check for alerts pushed by the datapath to an internal queue (from C)
   -- and store them (push them to the SQLite and Notification queues).
@@ -142,17 +181,8 @@ function sqlite.dequeueRecipientAlerts(recipient, budget, high_priority)
   -- Now also check for alerts pushed by user scripts from Lua
   -- Dequeue alerts up to budget
   -- Note: in this case budget is the number of sqlite alerts to insert into the queue
-  while budget_used <= budget and more_available do
-     local notifications = {}
-
-     for i=1, budget do
-       local notification = ntop.recipient_dequeue(recipient.recipient_id, high_priority)
-       if notification then 
-	  notifications[#notifications + 1] = notification
-       else
-	  break
-       end
-     end
+  while budget_used <= budget and more_available and not writer_full do
+     local notifications = ntop.recipient_dequeue_bulk(recipient.recipient_id, high_priority, budget)
 
      if not notifications or #notifications == 0 then
       more_available = false
@@ -162,31 +192,30 @@ function sqlite.dequeueRecipientAlerts(recipient, budget, high_priority)
     for _, json_message in ipairs(notifications) do
        local alert = json.decode(json_message)
 
-       if alert.action ~= "engage" then
+       if alert and alert.action ~= "engage" then
 	  -- Do not store alerts engaged - they're are handled only in-memory
+	  interface.select(string.format("%d", alert.ifid))
 
-	  if(alert) then
-	     interface.select(string.format("%d", alert.ifid))
-
-	     if(alert.is_flow_alert) then
-		interface.storeFlowAlert(alert)
-	     else
-		interface.storeAlert(
-		   alert.alert_tstamp, alert.alert_tstamp_end, alert.alert_granularity,
-		   alert.alert_type, alert.alert_subtype, alert.alert_severity,
-		   alert.alert_entity, alert.alert_entity_val,
-		   alert.alert_json)
-	     end
+	  -- Once the writer has not caught up, do not stall on the rest of the batch
+	  local queued = storeAlert(alert, ternary(writer_full, 0, STORE_MAX_RETRIES))
+
+	  if(queued == false) then
+	     writer_full = true
+	     num_dropped = num_dropped + 1
 	  end
        end
     end
 
-    -- TODO: send
-
     -- Remove the processed messages from the queue
     budget_used = budget_used + #notifications
   end
 
+  if(num_dropped > 0) then
+     -- Leave the remaining notifications in the recipient queue for the next round
+     traceError(TRACE_WARNING, TRACE_CONSOLE,
+		string.format("SQLite alerts writer queue full: %d alerts dropped", num_dropped))
+  end
+
   return {success = true, more_available = more_available}
 end
 
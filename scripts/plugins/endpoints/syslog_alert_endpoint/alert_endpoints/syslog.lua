@@ -73,15 +73,7 @@ end
 
 -- Dequeue alerts from a recipient queue for sending notifications
 function syslog.dequeueRecipientAlerts(recipient, budget, high_priority)   
-    local notifications = {}
-    for i = 1, budget do
-       local notification = ntop.recipient_dequeue(recipient.recipient_id, high_priority)
-       if notification then 
-	  notifications[#notifications + 1] = notification
-       else
-	  break
-       end
-    end
+    local notifications = ntop.recipient_dequeue_bulk(recipient.recipient_id, high_priority, budget)
 
    if not notifications or #notifications == 0 then
       return {success = true, more_available = false}
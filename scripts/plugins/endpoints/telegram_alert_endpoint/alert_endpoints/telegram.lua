@@ -128,15 +128,7 @@ function telegram.dequeueRecipientAlerts(recipient, budget, high_priority)
     end
 
     -- Dequeue max_alerts_per_request notifications
-    local notifications = {}
-    for i=1, max_alerts_per_request do
-       local notification = ntop.recipient_dequeue(recipient.recipient_id, high_priority)
-       if notification then 
-	  notifications[#notifications + 1] = notification
-       else
-	  break
-       end
-    end
+    local notifications = ntop.recipient_dequeue_bulk(recipient.recipient_id, high_priority, max_alerts_per_request)
 
     if not notifications or #notifications == 0 then
       more_available = false
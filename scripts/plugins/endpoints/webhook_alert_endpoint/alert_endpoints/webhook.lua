@@ -101,15 +101,7 @@ function webhook.dequeueRecipientAlerts(recipient, budget, high_priority)
     end
 
     -- Dequeue MAX_ALERTS_PER_REQUEST notifications
-    local notifications = {}
-    for i = 1, MAX_ALERTS_PER_REQUEST do
-       local notification = ntop.recipient_dequeue(recipient.recipient_id, high_priority)
-       if notification then 
-	  notifications[#notifications + 1] = notification
-       else
-	  break
-       end
-    end
+    local notifications = ntop.recipient_dequeue_bulk(recipient.recipient_id, high_priority, MAX_ALERTS_PER_REQUEST)
 
     if not notifications or #notifications == 0 then
       more_available = false
@@ -25,6 +25,7 @@
 
 AddressResolution::AddressResolution() {
   num_resolved_addresses = num_resolved_fails = 0;
+  async_resolver = NULL, symbolicToResolve = NULL;
   num_resolvers =
 #ifdef NTOPNG_EMBEDDED_EDITION
       1
@@ -56,10 +57,22 @@ AddressResolution::~AddressResolution() {
       if(resolveThreadLoop[i])
         pthread_join(resolveThreadLoop[i], NULL);
     }
+
+    if(async_resolver)
+      pthread_join(asyncResolveThreadLoop, NULL);
+
+    if(symbolicToResolve)
+      pthread_join(symbolicResolveThreadLoop, NULL);
   }
 
   free(resolveThreadLoop);
 
+  if(async_resolver)
+    delete async_resolver;
+
+  if(symbolicToResolve)
+    delete symbolicToResolve;
+
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Address resolution stats [%u resolved][%u failures]",
 			       num_resolved_addresses, num_resolved_fails);
 }
@@ -201,10 +214,100 @@ static void* resolveLoop(void* ptr) {
 
 /* **************************************************** */
 
+static void* asyncResolveLoopFctn(void* ptr) {
+  Utils::setThreadName("asyncResolveLoop");
+
+  ((AddressResolution*)ptr)->asyncResolveLoop();
+  return(NULL);
+}
+
+/* **************************************************** */
+
+static void* symbolicResolveLoopFctn(void* ptr) {
+  Utils::setThreadName("symbolicResolveLoop");
+
+  ((AddressResolution*)ptr)->symbolicResolveLoop();
+  return(NULL);
+}
+
+/* **************************************************** */
+
+/*
+  Keeps up to DNS_RESOLVER_MAX_OUTSTANDING PTR queries in flight on a
+  single thread. Symbolic names need the blocking calls: they are handed
+  over to symbolicResolveLoop() so they never stall the PTR queries.
+ */
+void AddressResolution::asyncResolveLoop() {
+  Redis *r = ntop->getRedis();
+
+  while(!ntop->getGlobals()->isShutdown()) {
+    char numeric_ip[64], *at;
+
+    while(async_resolver->canResolve()
+	  && (r->popHostToResolve(numeric_ip, sizeof(numeric_ip)) == 0)) {
+      if((at = strchr(numeric_ip, '@')) != NULL) at[0] = '\0';
+
+      /* When the queue is full the name is dropped (and accounted by the queue) */
+      if((numeric_ip[0] != '\0') && !async_resolver->resolve(numeric_ip))
+	symbolicToResolve->enqueue(numeric_ip);
+    }
+
+    async_resolver->poll(DNS_RESOLVER_POLL_MSEC);
+  }
+}
+
+/* **************************************************** */
+
+void AddressResolution::symbolicResolveLoop() {
+  while(!ntop->getGlobals()->isShutdown()) {
+    char *name = symbolicToResolve->dequeue();
+
+    if(name) {
+      resolveHostName(name);
+      free(name);
+    } else
+      _usleep(DNS_RESOLVER_POLL_MSEC * 1000);
+  }
+}
+
+/* **************************************************** */
+
 void AddressResolution::startResolveAddressLoop() {
   if(ntop->getPrefs()->is_dns_resolution_enabled()) {
+    async_resolver = new (std::nothrow) AsyncResolver(ntop->getPrefs()->get_dns_server(),
+						      DNS_RESOLVER_MAX_OUTSTANDING, DNS_RESOLVER_MAX_QPS);
+
+    if(async_resolver && async_resolver->isOpen()
+       && ((symbolicToResolve = new (std::nothrow) FifoStringsQueue(MAX_NUM_QUEUED_ADDRS)) != NULL)) {
+      pthread_create(&asyncResolveThreadLoop, NULL, asyncResolveLoopFctn, (void*)this);
+      pthread_create(&symbolicResolveThreadLoop, NULL, symbolicResolveLoopFctn, (void*)this);
+      return;
+    }
+
+    /* Fallback to the blocking resolvers */
+    if(async_resolver) {
+      delete async_resolver;
+      async_resolver = NULL;
+    }
 
     for(int i = 0; i < num_resolvers; i++)
       pthread_create(&resolveThreadLoop[i], NULL, resolveLoop, (void*)this);
   }
 }
+
+/* **************************************************** */
+
+void AddressResolution::lua(lua_State *vm) {
+  lua_newtable(vm);
+
+  m.lock(__FILE__, __LINE__);
+  lua_push_uint64_table_entry(vm, "num_resolved", num_resolved_addresses);
+  lua_push_uint64_table_entry(vm, "num_failures", num_resolved_fails);
+  m.unlock(__FILE__, __LINE__);
+
+  if(async_resolver)
+    async_resolver->lua(vm);
+
+  if(symbolicToResolve)
+    symbolicToResolve->lua(vm, "symbolic_queue");
+}
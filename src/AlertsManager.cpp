@@ -23,9 +23,29 @@
 
 static const char *hex_chars = "0123456789ABCDEF";
 
+/* **************************************************** */
+
+static void* writerLoopFctn(void* ptr) {
+  AlertsManager *am = (AlertsManager*)ptr;
+
+  am->writerLoop();
+  return(NULL);
+}
+
+/* **************************************************** */
+
 AlertsManager::AlertsManager(int interface_id, const char *filename) : StoreManager(interface_id) {
   char filePath[MAX_PATH], fileFullPath[MAX_PATH], fileName[MAX_PATH];
 
+  store_opened = store_initialized = false;
+  queued_alerts = new (std::nothrow) vector<QueuedAlert*>();
+  queued_flow_alerts = new (std::nothrow) vector<QueuedFlowAlert*>();
+  make_room_alerts = make_room_flow_alerts = false;
+  writer_created = false, writer_shutdown = false;
+  alert_update_stmt = alert_insert_stmt = NULL;
+  flow_alert_select_stmt = flow_alert_replace_select_stmt = NULL;
+  flow_alert_update_stmt = flow_alert_insert_stmt = NULL;
+
   snprintf(filePath, sizeof(filePath), "%s/%d/alerts/",
            ntop->get_working_dir(), ifid);
 
@@ -100,11 +120,48 @@ AlertsManager::AlertsManager(int interface_id, const char *filename) : StoreMana
 				 fileFullPath);
 
   snprintf(queue_name, sizeof(queue_name), ALERTS_MANAGER_QUEUE_NAME, ifid);
+
+  if(store_opened && queued_alerts && queued_flow_alerts
+     && (prepareStatements() == 0)
+     && (pthread_create(&writer_thread, NULL, writerLoopFctn, (void*)this) == 0)) {
+    writer_created = true;
+
+#ifdef __linux__
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "alerts ifid %d", ifid);
+    pthread_setname_np(writer_thread, buf);
+#endif
+  }
 }
 
 /* **************************************************** */
 
-AlertsManager::~AlertsManager() { }
+AlertsManager::~AlertsManager() {
+  if(writer_created) {
+    /* The writer flushes the queues before terminating */
+    queue_lock.lock(__FILE__, __LINE__);
+    writer_shutdown = true;
+    queue_lock.unlock(__FILE__, __LINE__);
+
+    writer_cond.signal();
+    pthread_join(writer_thread, NULL);
+  }
+
+  finalizeStatements();
+
+  if(queued_alerts) {
+    for(vector<QueuedAlert*>::iterator it = queued_alerts->begin(); it != queued_alerts->end(); ++it)
+      freeQueuedAlert(*it);
+    delete queued_alerts;
+  }
+
+  if(queued_flow_alerts) {
+    for(vector<QueuedFlowAlert*>::iterator it = queued_flow_alerts->begin(); it != queued_flow_alerts->end(); ++it)
+      freeQueuedFlowAlert(*it);
+    delete queued_flow_alerts;
+  }
+}
 
 /* **************************************************** */
 
@@ -418,116 +475,37 @@ void AlertsManager::cache(int ifid, AlertType alert_type, const char *subtype, i
 /* NOTE: do not call this from C, use alert queues in LUA */
 int AlertsManager::storeAlert(time_t tstart, time_t tend, int granularity, AlertType alert_type, const char *subtype,
 			      AlertLevel alert_severity, AlertEntity alert_entity, const char *alert_entity_value,
-			      const char *alert_json, bool *new_alert, u_int64_t *rowid,
-			      bool ignore_disabled, bool check_maximum) {
-  int rc = 0;
-  u_int64_t cur_rowid = (u_int64_t)-1;
-
-  if(ignore_disabled || !ntop->getPrefs()->are_alerts_disabled()) {
-    char query[STORE_MANAGER_MAX_QUERY];
-    struct in6_addr ip_raw;
-    sqlite3_stmt *stmt = NULL, *stmt2 = NULL;
-
-    if(!store_initialized || !store_opened)
-      return -1;
-    else if(check_maximum)
-      markForMakeRoom(false);
+			      const char *alert_json, bool ignore_disabled, bool check_maximum) {
+  QueuedAlert *a;
 
-    m.lock(__FILE__, __LINE__);
-
-    iface->setHasAlerts(true);
-
-    /* If alert tstart and tend coincide, that is, if the alert wasn't engaged, we try and aggregated it to
-       solve issues such as https://github.com/ntop/ntopng/issues/3430 */
-    if(tstart == tend) {
-      if(isCached(getNetworkInterface()->get_id(),
-		  alert_type, subtype, granularity,
-		  alert_entity, alert_entity_value, alert_severity, &cur_rowid)) {
-
-	snprintf(query, sizeof(query),
-		 "UPDATE %s "
-		 "SET alert_counter = alert_counter + 1, alert_tstamp_end = ? "
-		 "WHERE rowid = ? ",
-		 ALERTS_MANAGER_TABLE_NAME);
-
-	if(sqlite3_prepare_v2(db, query, -1, &stmt2, 0)
-	   || sqlite3_bind_int64(stmt2, 1, static_cast<long int>(tend))
-	   || sqlite3_bind_int64(stmt2, 2, static_cast<long int>(cur_rowid))) {
-	  ntop->getTrace()->traceEvent(TRACE_ERROR, "SQL Error: step");
-	  rc = -2;
-	  goto out;
-	}
-
-	if((rc = exec_statement(stmt2)) == SQLITE_DONE) {
-	  int num_updates = sqlite3_changes(db);
-
-	  // ntop->getTrace()->traceEvent(TRACE_ERROR, "Changes %u", num_updates);
-
-	  /* Ensure the number of UPDATEd rows is greater than zero. A zero value means
-	     the row is no longer in the database (alert deleted) but it is still in cache, so
-	     a new insert need to be performed. The new insert will also refresh the cache.
-	  */
-	  if(num_updates > 0) {
-	    /* Done updating... */
-	    *rowid = cur_rowid;
-	    iface->incNumWrittenAlerts();
-	    rc = 0;
-	    goto out;
-	  }
-	}
-      }
-    }
+  if(!ignore_disabled && ntop->getPrefs()->are_alerts_disabled())
+    return 0;
 
-    /* If here, the alert was engaged or not already found in the DB */
-    snprintf(query, sizeof(query),
-	     "INSERT INTO %s "
-	     "(alert_granularity, alert_tstamp, alert_tstamp_end, alert_type, alert_severity, alert_entity, alert_entity_val, alert_json, alert_subtype, ip) "
-	     "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?); ",
-	     ALERTS_MANAGER_TABLE_NAME);
-
-    parseEntityValueIp(alert_entity_value, &ip_raw);
-
-    if(sqlite3_prepare_v2(db, query, -1,  &stmt, 0)
-       || sqlite3_bind_int(stmt,   1,  granularity)
-       || sqlite3_bind_int64(stmt, 2,  static_cast<long int>(tstart))
-       || sqlite3_bind_int64(stmt, 3,  static_cast<long int>(tend))
-       || sqlite3_bind_int(stmt,   4,  static_cast<int>(alert_type))
-       || sqlite3_bind_int(stmt,   5,  static_cast<int>(alert_severity))
-       || sqlite3_bind_int(stmt,   6,  static_cast<int>(alert_entity))
-       || sqlite3_bind_text(stmt,  7,  alert_entity_value, -1, SQLITE_STATIC)
-       || sqlite3_bind_text(stmt,  8,  alert_json, -1, SQLITE_STATIC)
-       || sqlite3_bind_text(stmt,  9,  subtype, -1, SQLITE_STATIC)
-       || sqlite3_bind_blob(stmt, 10,  ip_raw.s6_addr, sizeof(ip_raw.s6_addr), SQLITE_STATIC)) {
-      ntop->getTrace()->traceEvent(TRACE_ERROR, "SQL Error: %s", sqlite3_errmsg(db));
-      rc = -3;
-      goto out;
-    }
+  if(!store_initialized || !store_opened)
+    return -1;
 
-    if((rc = exec_statement(stmt)) != SQLITE_DONE) {
-      rc = -4;
-      goto out;
-    }
+  if((a = (QueuedAlert*)calloc(1, sizeof(QueuedAlert))) == NULL)
+    return -2;
 
-    /* Success */
-    *rowid = sqlite3_last_insert_rowid(db);
-    cache(getNetworkInterface()->get_id(),
-	  alert_type, subtype, granularity,
-	  alert_entity, alert_entity_value, alert_severity, *rowid);
-    iface->incNumWrittenAlerts();
-    rc = 0;
+  a->tstart = tstart, a->tend = tend, a->granularity = granularity;
+  a->alert_type = alert_type, a->alert_severity = alert_severity, a->alert_entity = alert_entity;
+  a->subtype = strdup(subtype ? subtype : "");
+  a->alert_entity_value = strdup(alert_entity_value ? alert_entity_value : "");
+  a->alert_json = strdup(alert_json ? alert_json : "");
+  a->counter = 1;
 
-  out:
-    if(stmt)  sqlite3_finalize(stmt);
-    if(stmt2) sqlite3_finalize(stmt2);
-    m.unlock(__FILE__, __LINE__);
+  if(!a->subtype || !a->alert_entity_value || !a->alert_json) {
+    freeQueuedAlert(a);
+    return -2;
   }
 
-  return(rc);
+  /* Dropped alerts are accounted by the interface */
+  return(enqueueAlert(a, NULL, check_maximum, false) ? 0 : 1);
 }
 
 /* **************************************************** */
 
-int AlertsManager::storeFlowAlert(lua_State *L, int index, u_int64_t *rowid) {
+int AlertsManager::storeFlowAlert(lua_State *L, int index) {
   time_t tstamp = 0;
   AlertType alert_type = 0;
   AlertLevel alert_severity = alert_level_none;
@@ -548,15 +526,7 @@ int AlertsManager::storeFlowAlert(lua_State *L, int index, u_int64_t *rowid) {
   u_int64_t first_seen = 0;
   u_int64_t cli2srv_bytes = 0, srv2cli_bytes = 0;
   u_int64_t cli2srv_packets = 0, srv2cli_packets = 0;
-  char query[STORE_MANAGER_MAX_QUERY];
-  sqlite3_stmt *stmt = NULL, *stmt2 = NULL, *stmt3 = NULL;
-  int64_t rc = 0;
-  u_int64_t cur_rowid = (u_int64_t)-1, cur_counter;
-  u_int64_t cur_cli2srv_bytes, cur_srv2cli_bytes, cur_cli2srv_packets, cur_srv2cli_packets = 0;
-  struct in6_addr cli_ip_raw, srv_ip_raw;
-  int family = AF_INET;
-
-  *rowid = 0;
+  QueuedFlowAlert *fa;
 
   if(ntop->getPrefs()->are_alerts_disabled())
     return 0;
@@ -564,8 +534,6 @@ int AlertsManager::storeFlowAlert(lua_State *L, int index, u_int64_t *rowid) {
   if(!store_initialized || !store_opened)
     return -1;
 
-  markForMakeRoom(true);
-
   /* Read alert fields from Lua */
 
   lua_pushnil(L);
@@ -578,10 +546,8 @@ int AlertsManager::storeFlowAlert(lua_State *L, int index, u_int64_t *rowid) {
       case LUA_TSTRING:
         if(!strcmp(key, "alert_json"))
           alert_json = lua_tostring(L, -1);
-        else if(!strcmp(key, "cli_addr")) {
+        else if(!strcmp(key, "cli_addr"))
           cli_ip = lua_tostring(L, -1);
-	  family = (strchr(cli_ip, ':') != NULL) ? AF_INET6 : AF_INET;
-	}
         else if(!strcmp(key, "srv_addr"))
           srv_ip = lua_tostring(L, -1);
         else if(!strcmp(key, "cli_country"))
@@ -659,30 +625,273 @@ int AlertsManager::storeFlowAlert(lua_State *L, int index, u_int64_t *rowid) {
     return -2;
   }
 
-  /* Store to DB */
+  /* The strings belong to the Lua state: copy them as the alert is written later on */
+  if((fa = (QueuedFlowAlert*)calloc(1, sizeof(QueuedFlowAlert))) == NULL)
+    return -3;
+
+  fa->tstamp = tstamp, fa->alert_type = alert_type, fa->alert_severity = alert_severity, fa->status = status;
+  fa->vlan_id = vlan_id, fa->protocol = protocol;
+  fa->ndpi_master_protocol = ndpi_master_protocol, fa->ndpi_app_protocol = ndpi_app_protocol;
+  fa->cli_asn = cli_asn, fa->srv_asn = srv_asn;
+  fa->cli_port = cli_port, fa->srv_port = srv_port;
+  fa->cli_is_localhost = cli_is_localhost, fa->srv_is_localhost = srv_is_localhost;
+  fa->cli_is_blacklisted = cli_is_blacklisted, fa->srv_is_blacklisted = srv_is_blacklisted;
+  fa->replace_alert = replace_alert, fa->score = score, fa->first_seen = first_seen;
+  fa->cli2srv_bytes = cli2srv_bytes, fa->srv2cli_bytes = srv2cli_bytes;
+  fa->cli2srv_packets = cli2srv_packets, fa->srv2cli_packets = srv2cli_packets;
+
+  fa->alert_json = strdup(alert_json), fa->cli_ip = strdup(cli_ip), fa->srv_ip = strdup(srv_ip);
+  fa->cli_country = strdup(cli_country), fa->srv_country = strdup(srv_country);
+  fa->cli_os = strdup(cli_os), fa->srv_os = strdup(srv_os);
+
+  if(!fa->alert_json || !fa->cli_ip || !fa->srv_ip
+     || !fa->cli_country || !fa->srv_country || !fa->cli_os || !fa->srv_os) {
+    freeQueuedFlowAlert(fa);
+    return -3;
+  }
 
-  m.lock(__FILE__, __LINE__);
+  ntop->getTrace()->traceEvent(TRACE_INFO, "%s", alert_json);
+
+  return(enqueueAlert(NULL, fa, true, true) ? 0 : 1);
+}
+
+/* **************************************************** */
+
+void AlertsManager::freeQueuedAlert(QueuedAlert *a) {
+  if(a->subtype)            free(a->subtype);
+  if(a->alert_entity_value) free(a->alert_entity_value);
+  if(a->alert_json)         free(a->alert_json);
+  free(a);
+}
+
+/* **************************************************** */
+
+void AlertsManager::freeQueuedFlowAlert(QueuedFlowAlert *fa) {
+  if(fa->alert_json)  free(fa->alert_json);
+  if(fa->cli_ip)      free(fa->cli_ip);
+  if(fa->srv_ip)      free(fa->srv_ip);
+  if(fa->cli_country) free(fa->cli_country);
+  if(fa->srv_country) free(fa->srv_country);
+  if(fa->cli_os)      free(fa->cli_os);
+  if(fa->srv_os)      free(fa->srv_os);
+  free(fa);
+}
+
+/* **************************************************** */
+
+/*
+  Hands an alert over to the writer thread, which takes ownership of it.
+  When the writer cannot keep up, the alert is dropped and false is returned.
+*/
+bool AlertsManager::enqueueAlert(QueuedAlert *a, QueuedFlowAlert *fa, bool check_maximum, bool on_flows) {
+  bool queued = false;
+
+  queue_lock.lock(__FILE__, __LINE__);
+
+  if(writer_created && !writer_shutdown
+     && (queued_alerts->size() + queued_flow_alerts->size() < ALERTS_MANAGER_MAX_QUEUED_ALERTS)) {
+    try {
+      if(a) queued_alerts->push_back(a); else queued_flow_alerts->push_back(fa);
+      queued = true;
+    } catch(std::bad_alloc& ba) {
+      /* Dropped below */
+    }
+  }
+
+  if(queued && check_maximum) {
+    if(on_flows) make_room_flow_alerts = true; else make_room_alerts = true;
+  }
+
+  queue_lock.unlock(__FILE__, __LINE__);
+
+  if(!queued) {
+    if(a)  freeQueuedAlert(a);
+    if(fa) freeQueuedFlowAlert(fa);
+    iface->incNumDroppedAlerts(1);
+    return(false);
+  }
+
+  iface->setHasAlerts(true);
+  writer_cond.signalIfWaiting();
+
+  return(true);
+}
+
+/* **************************************************** */
+
+int AlertsManager::prepareStatements() {
+  char query[STORE_MANAGER_MAX_QUERY];
+  const char *flow_select = "SELECT rowid, alert_counter, cli2srv_bytes, srv2cli_bytes, cli2srv_packets, srv2cli_packets "
+    "FROM %s "
+    "WHERE vlan_id = ? AND proto = ? AND l7_master_proto = ? AND l7_proto = ? "
+    "AND cli_addr = ? AND srv_addr = ? AND cli_port = ? AND srv_port = ? "
+    "%s "
+    "LIMIT 1; ";
 
-  /* Check if this alert already exists ...*/
   snprintf(query, sizeof(query),
-	   "SELECT rowid, alert_counter, cli2srv_bytes, srv2cli_bytes, cli2srv_packets, srv2cli_packets "
-	   "FROM %s "
-	   "WHERE vlan_id = ? AND proto = ? AND l7_master_proto = ? AND l7_proto = ? "
-	   "AND cli_addr = ? AND srv_addr = ? AND cli_port = ? AND srv_port = ? "
-	   "%s "
-	   "LIMIT 1; ",
-	   ALERTS_MANAGER_FLOWS_TABLE_NAME,
-	   replace_alert ? "AND first_seen = ?" : "AND alert_tstamp >= ? AND alert_type = ? AND alert_severity = ? AND flow_status = ?");
-
-  if(sqlite3_prepare_v2(db, query, -1, &stmt, 0)
-     || sqlite3_bind_int(stmt,    1, vlan_id)
-     || sqlite3_bind_int(stmt,    2, protocol)
-     || sqlite3_bind_int(stmt,    3, ndpi_master_protocol)
-     || sqlite3_bind_int(stmt,    4, ndpi_app_protocol)
-     || sqlite3_bind_text(stmt,   5, cli_ip, -1, SQLITE_STATIC)
-     || sqlite3_bind_text(stmt,   6, srv_ip, -1, SQLITE_STATIC)
-     || sqlite3_bind_int(stmt,    7, cli_port)
-     || sqlite3_bind_int(stmt,    8, srv_port)) {
+	   "UPDATE %s "
+	   "SET alert_counter = alert_counter + ?, alert_tstamp_end = ? "
+	   "WHERE rowid = ? ",
+	   ALERTS_MANAGER_TABLE_NAME);
+  if(sqlite3_prepare_v2(db, query, -1, &alert_update_stmt, 0)) goto error;
+
+  snprintf(query, sizeof(query),
+	   "INSERT INTO %s "
+	   "(alert_granularity, alert_tstamp, alert_tstamp_end, alert_type, alert_severity, alert_entity, alert_entity_val, alert_json, alert_subtype, ip, alert_counter) "
+	   "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?); ",
+	   ALERTS_MANAGER_TABLE_NAME);
+  if(sqlite3_prepare_v2(db, query, -1, &alert_insert_stmt, 0)) goto error;
+
+  /* Similar flows */
+  snprintf(query, sizeof(query), flow_select, ALERTS_MANAGER_FLOWS_TABLE_NAME,
+	   "AND alert_tstamp >= ? AND alert_type = ? AND alert_severity = ? AND flow_status = ?");
+  if(sqlite3_prepare_v2(db, query, -1, &flow_alert_select_stmt, 0)) goto error;
+
+  /* Exact flow */
+  snprintf(query, sizeof(query), flow_select, ALERTS_MANAGER_FLOWS_TABLE_NAME, "AND first_seen = ?");
+  if(sqlite3_prepare_v2(db, query, -1, &flow_alert_replace_select_stmt, 0)) goto error;
+
+  snprintf(query, sizeof(query),
+	   "UPDATE %s "
+	   "SET alert_counter = ?, alert_tstamp_end = ?, cli2srv_bytes = ?, srv2cli_bytes = ?, cli2srv_packets = ?, srv2cli_packets = ?, "
+	   "score = ?, alert_type = ?, alert_severity = ?, flow_status = ?, alert_json = ? "
+	   "WHERE rowid = ? ",
+	   ALERTS_MANAGER_FLOWS_TABLE_NAME);
+  if(sqlite3_prepare_v2(db, query, -1, &flow_alert_update_stmt, 0)) goto error;
+
+  snprintf(query, sizeof(query),
+	   "INSERT INTO %s "
+	   "(alert_tstamp, alert_type, alert_severity, alert_json, "
+	   "vlan_id, proto, l7_master_proto, l7_proto, "
+	   "cli_country, srv_country, cli_os, srv_os, cli_asn, srv_asn, "
+	   "cli_addr, srv_addr, cli_port, srv_port, "
+	   "cli2srv_bytes, srv2cli_bytes, "
+	   "cli2srv_packets, srv2cli_packets, "
+	   "cli_blacklisted, srv_blacklisted, "
+	   "cli_localhost, srv_localhost, "
+	   "cli_ip, srv_ip, "
+	   "score, first_seen, flow_status) "
+	   "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?); ",
+	   ALERTS_MANAGER_FLOWS_TABLE_NAME);
+  if(sqlite3_prepare_v2(db, query, -1, &flow_alert_insert_stmt, 0)) goto error;
+
+  return 0;
+
+ error:
+  ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to prepare the statement for %s [%s]", query, sqlite3_errmsg(db));
+  finalizeStatements();
+  return -1;
+}
+
+/* **************************************************** */
+
+void AlertsManager::finalizeStatements() {
+  sqlite3_stmt **stmts[] = { &alert_update_stmt, &alert_insert_stmt,
+			     &flow_alert_select_stmt, &flow_alert_replace_select_stmt,
+			     &flow_alert_update_stmt, &flow_alert_insert_stmt };
+
+  for(u_int i = 0; i < sizeof(stmts) / sizeof(stmts[0]); i++) {
+    if(*stmts[i]) {
+      sqlite3_finalize(*stmts[i]);
+      *stmts[i] = NULL;
+    }
+  }
+}
+
+/* **************************************************** */
+
+/* Must be called with m held */
+int AlertsManager::writeAlert(QueuedAlert *a) {
+  int rc;
+  u_int64_t cur_rowid = (u_int64_t)-1, rowid;
+  struct in6_addr ip_raw;
+
+  /* If alert tstart and tend coincide, that is, if the alert wasn't engaged, we try and aggregated it to
+     solve issues such as https://github.com/ntop/ntopng/issues/3430. Records merged by
+     writeQueuedAlerts() are not engaged as well, although their tend has moved on. */
+  if(((a->tstart == a->tend) || (a->counter > 1))
+     && isCached(ifid, a->alert_type, a->subtype, a->granularity,
+		 a->alert_entity, a->alert_entity_value, a->alert_severity, &cur_rowid)) {
+    if(sqlite3_bind_int64(alert_update_stmt, 1, a->counter)
+       || sqlite3_bind_int64(alert_update_stmt, 2, static_cast<long int>(a->tend))
+       || sqlite3_bind_int64(alert_update_stmt, 3, static_cast<long int>(cur_rowid))) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "SQL Error: step");
+      rc = -2;
+      goto out;
+    }
+
+    rc = exec_statement(alert_update_stmt);
+
+    /* Ensure the number of UPDATEd rows is greater than zero. A zero value means
+       the row is no longer in the database (alert deleted) but it is still in cache, so
+       a new insert need to be performed. The new insert will also refresh the cache.
+    */
+    if((rc == SQLITE_DONE) && (sqlite3_changes(db) > 0)) {
+      /* Done updating... */
+      iface->incNumWrittenAlerts(a->counter);
+      rc = 0;
+      goto out;
+    }
+  }
+
+  /* If here, the alert was engaged or not already found in the DB */
+  parseEntityValueIp(a->alert_entity_value, &ip_raw);
+
+  if(sqlite3_bind_int(alert_insert_stmt,   1,  a->granularity)
+     || sqlite3_bind_int64(alert_insert_stmt, 2,  static_cast<long int>(a->tstart))
+     || sqlite3_bind_int64(alert_insert_stmt, 3,  static_cast<long int>(a->tend))
+     || sqlite3_bind_int(alert_insert_stmt,   4,  static_cast<int>(a->alert_type))
+     || sqlite3_bind_int(alert_insert_stmt,   5,  static_cast<int>(a->alert_severity))
+     || sqlite3_bind_int(alert_insert_stmt,   6,  static_cast<int>(a->alert_entity))
+     || sqlite3_bind_text(alert_insert_stmt,  7,  a->alert_entity_value, -1, SQLITE_STATIC)
+     || sqlite3_bind_text(alert_insert_stmt,  8,  a->alert_json, -1, SQLITE_STATIC)
+     || sqlite3_bind_text(alert_insert_stmt,  9,  a->subtype, -1, SQLITE_STATIC)
+     || sqlite3_bind_blob(alert_insert_stmt, 10,  ip_raw.s6_addr, sizeof(ip_raw.s6_addr), SQLITE_STATIC)
+     || sqlite3_bind_int64(alert_insert_stmt, 11, a->counter)) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "SQL Error: %s", sqlite3_errmsg(db));
+    rc = -3;
+    goto out;
+  }
+
+  if((rc = exec_statement(alert_insert_stmt)) != SQLITE_DONE) {
+    rc = -4;
+    goto out;
+  }
+
+  /* Success */
+  rowid = sqlite3_last_insert_rowid(db);
+  cache(ifid, a->alert_type, a->subtype, a->granularity,
+	a->alert_entity, a->alert_entity_value, a->alert_severity, rowid);
+  iface->incNumWrittenAlerts(a->counter);
+  rc = 0;
+
+ out:
+  sqlite3_reset(alert_update_stmt), sqlite3_clear_bindings(alert_update_stmt);
+  sqlite3_reset(alert_insert_stmt), sqlite3_clear_bindings(alert_insert_stmt);
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+/* Must be called with m held */
+int AlertsManager::writeFlowAlert(QueuedFlowAlert *fa) {
+  sqlite3_stmt *stmt = fa->replace_alert ? flow_alert_replace_select_stmt : flow_alert_select_stmt;
+  int rc;
+  u_int64_t cur_rowid = (u_int64_t)-1, cur_counter = 0;
+  u_int64_t cur_cli2srv_bytes = 0, cur_srv2cli_bytes = 0, cur_cli2srv_packets = 0, cur_srv2cli_packets = 0;
+  struct in6_addr cli_ip_raw, srv_ip_raw;
+  int family = (strchr(fa->cli_ip, ':') != NULL) ? AF_INET6 : AF_INET;
+
+  /* Check if this alert already exists ...*/
+  if(sqlite3_bind_int(stmt,    1, fa->vlan_id)
+     || sqlite3_bind_int(stmt,    2, fa->protocol)
+     || sqlite3_bind_int(stmt,    3, fa->ndpi_master_protocol)
+     || sqlite3_bind_int(stmt,    4, fa->ndpi_app_protocol)
+     || sqlite3_bind_text(stmt,   5, fa->cli_ip, -1, SQLITE_STATIC)
+     || sqlite3_bind_text(stmt,   6, fa->srv_ip, -1, SQLITE_STATIC)
+     || sqlite3_bind_int(stmt,    7, fa->cli_port)
+     || sqlite3_bind_int(stmt,    8, fa->srv_port)) {
     ntop->getTrace()->traceEvent(TRACE_ERROR, "SQL Error: %s", sqlite3_errmsg(db));
     rc = -3;
     goto out;
@@ -690,29 +899,25 @@ int AlertsManager::storeFlowAlert(lua_State *L, int index, u_int64_t *rowid) {
 
   iface->incNumAlertsQueries();
 
-  if(replace_alert) {
+  if(fa->replace_alert) {
     /* Match the exact flow */
-    if(sqlite3_bind_int(stmt,    9, first_seen)) {
+    if(sqlite3_bind_int(stmt,    9, fa->first_seen)) {
       ntop->getTrace()->traceEvent(TRACE_ERROR, "SQL Error: %s", sqlite3_errmsg(db));
       rc = -4;
       goto out;
     }
   } else {
     /* Match similar flows */
-    if(sqlite3_bind_int64(stmt,  9, static_cast<long int>(tstamp) - ALERTS_MANAGER_MAX_AGGR_SECS)
-       || sqlite3_bind_int(stmt,    10, static_cast<int>(alert_type))
-       || sqlite3_bind_int(stmt,    11, static_cast<int>(alert_severity))
-       || sqlite3_bind_int(stmt,    12, (int)status)) {
+    if(sqlite3_bind_int64(stmt,  9, static_cast<long int>(fa->tstamp) - ALERTS_MANAGER_MAX_AGGR_SECS)
+       || sqlite3_bind_int(stmt,    10, static_cast<int>(fa->alert_type))
+       || sqlite3_bind_int(stmt,    11, static_cast<int>(fa->alert_severity))
+       || sqlite3_bind_int(stmt,    12, (int)fa->status)) {
       ntop->getTrace()->traceEvent(TRACE_ERROR, "SQL Error: %s", sqlite3_errmsg(db));
       rc = -5;
       goto out;
     }
   }
 
-#if 0
-  ntop->getTrace()->traceEvent(TRACE_NORMAL, "%s", sqlite3_expanded_sql(stmt));
-#endif
-
   /* Try and read the rowid (if the record exists) */
   if((rc = exec_statement(stmt)) == SQLITE_ROW) {
     cur_rowid = sqlite3_column_int(stmt, 0);
@@ -721,135 +926,221 @@ int AlertsManager::storeFlowAlert(lua_State *L, int index, u_int64_t *rowid) {
     cur_srv2cli_bytes = sqlite3_column_int(stmt, 3);
     cur_cli2srv_packets = sqlite3_column_int(stmt, 4);
     cur_srv2cli_packets = sqlite3_column_int(stmt, 5);
-    // ntop->getTrace()->traceEvent(TRACE_NORMAL, "%s [rowid: %u][cur_counter: %u]\n", sqlite3_column_text(stmt, 0), cur_rowid, cur_counter);
   }
 
   if(cur_rowid != (u_int64_t)-1) { /* Already existing record found, update it */
-    snprintf(query, sizeof(query),
-	     "UPDATE %s "
-	     "SET alert_counter = ?, alert_tstamp_end = ?, cli2srv_bytes = ?, srv2cli_bytes = ?, cli2srv_packets = ?, srv2cli_packets = ?, "
-	     "score = ?, alert_type = ?, alert_severity = ?, flow_status = ?, alert_json = ? "
-	     "WHERE rowid = ? ",
-	     ALERTS_MANAGER_FLOWS_TABLE_NAME);
-
-    if(sqlite3_prepare_v2(db, query, -1, &stmt2, 0)
-       || sqlite3_bind_int64(stmt2, 1, static_cast<long int>(replace_alert ? cur_counter : (cur_counter + 1)))
-       || sqlite3_bind_int64(stmt2, 2, static_cast<long int>(tstamp))
-       || sqlite3_bind_int64(stmt2, 3, replace_alert ? cur_cli2srv_bytes : (cur_cli2srv_bytes + cli2srv_bytes))
-       || sqlite3_bind_int64(stmt2, 4, replace_alert ? cur_srv2cli_bytes : (cur_srv2cli_bytes + srv2cli_bytes))
-       || sqlite3_bind_int64(stmt2, 5, replace_alert ? cur_cli2srv_packets : (cur_cli2srv_packets + cli2srv_packets))
-       || sqlite3_bind_int64(stmt2, 6, replace_alert ? cur_srv2cli_packets : (cur_srv2cli_packets + srv2cli_packets))
-       || sqlite3_bind_int(stmt2,   7, score)
-       || sqlite3_bind_int(stmt2,   8, alert_type)
-       || sqlite3_bind_int(stmt2,   9, alert_severity)
-       || sqlite3_bind_int(stmt2,  10, status)
-       || sqlite3_bind_text(stmt2, 11, alert_json, -1, SQLITE_STATIC)
-       || sqlite3_bind_int64(stmt2,12, static_cast<long int>(cur_rowid))) {
+    if(sqlite3_bind_int64(flow_alert_update_stmt, 1, static_cast<long int>(fa->replace_alert ? cur_counter : (cur_counter + 1)))
+       || sqlite3_bind_int64(flow_alert_update_stmt, 2, static_cast<long int>(fa->tstamp))
+       || sqlite3_bind_int64(flow_alert_update_stmt, 3, fa->replace_alert ? cur_cli2srv_bytes : (cur_cli2srv_bytes + fa->cli2srv_bytes))
+       || sqlite3_bind_int64(flow_alert_update_stmt, 4, fa->replace_alert ? cur_srv2cli_bytes : (cur_srv2cli_bytes + fa->srv2cli_bytes))
+       || sqlite3_bind_int64(flow_alert_update_stmt, 5, fa->replace_alert ? cur_cli2srv_packets : (cur_cli2srv_packets + fa->cli2srv_packets))
+       || sqlite3_bind_int64(flow_alert_update_stmt, 6, fa->replace_alert ? cur_srv2cli_packets : (cur_srv2cli_packets + fa->srv2cli_packets))
+       || sqlite3_bind_int(flow_alert_update_stmt,   7, fa->score)
+       || sqlite3_bind_int(flow_alert_update_stmt,   8, fa->alert_type)
+       || sqlite3_bind_int(flow_alert_update_stmt,   9, fa->alert_severity)
+       || sqlite3_bind_int(flow_alert_update_stmt,  10, fa->status)
+       || sqlite3_bind_text(flow_alert_update_stmt, 11, fa->alert_json, -1, SQLITE_STATIC)
+       || sqlite3_bind_int64(flow_alert_update_stmt,12, static_cast<long int>(cur_rowid))) {
       ntop->getTrace()->traceEvent(TRACE_INFO, "SQL Error: step");
       rc = -6;
       goto out;
     }
 
-    if((rc = exec_statement(stmt2)) != SQLITE_DONE) {
+    if((rc = exec_statement(flow_alert_update_stmt)) != SQLITE_DONE) {
       rc = -7;
       goto out;
     }
-
   } else { /* no exising record found */
     /* This alert is being engaged */
-    snprintf(query, sizeof(query),
-	     "INSERT INTO %s "
-	     "(alert_tstamp, alert_type, alert_severity, alert_json, "
-	     "vlan_id, proto, l7_master_proto, l7_proto, "
-	     "cli_country, srv_country, cli_os, srv_os, cli_asn, srv_asn, "
-	     "cli_addr, srv_addr, cli_port, srv_port, "
-	     "cli2srv_bytes, srv2cli_bytes, "
-	     "cli2srv_packets, srv2cli_packets, "
-	     "cli_blacklisted, srv_blacklisted, "
-	     "cli_localhost, srv_localhost, "
-	     "cli_ip, srv_ip, "
-	     "score, first_seen, flow_status) "
-	     "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?); ",
-	     ALERTS_MANAGER_FLOWS_TABLE_NAME);
-
-    if(sqlite3_prepare_v2(db, query, -1, &stmt3, 0)) {
-      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to prepare the statement for %s", query);
-      rc = -8;
-      goto out;
-    }
-
     memset(&cli_ip_raw, 0, sizeof(cli_ip_raw));
     memset(&srv_ip_raw, 0, sizeof(srv_ip_raw));
 
     /* NOTE: IPv4 addresses are mapped into the IPv6 address space */
-    if(cli_ip && cli_ip[0])
-      inet_pton(family, cli_ip, (family == AF_INET6) ? (void*)&cli_ip_raw : ((char*)&cli_ip_raw)+12);
-
-    if(srv_ip && srv_ip[0])
-      inet_pton(family, srv_ip, (family == AF_INET6) ? (void*)&srv_ip_raw : ((char*)&srv_ip_raw)+12);
-
-    if(sqlite3_bind_int64(stmt3,     1, static_cast<long int>(tstamp))
-       || sqlite3_bind_int(stmt3,    2, (int)(alert_type))
-       || sqlite3_bind_int(stmt3,    3, (int)(alert_severity))
-       || sqlite3_bind_text(stmt3,   4, alert_json, -1, SQLITE_STATIC)
-       || sqlite3_bind_int(stmt3,    5, vlan_id)
-       || sqlite3_bind_int(stmt3,    6, protocol)
-       || sqlite3_bind_int(stmt3,    7, ndpi_master_protocol)
-       || sqlite3_bind_int(stmt3,    8, ndpi_app_protocol)
-       || sqlite3_bind_text(stmt3,   9, cli_country, -1, SQLITE_STATIC)
-       || sqlite3_bind_text(stmt3,  10, srv_country, -1, SQLITE_STATIC)
-       || sqlite3_bind_text(stmt3,  11, cli_os, -1, SQLITE_STATIC)
-       || sqlite3_bind_text(stmt3,  12, srv_os, -1, SQLITE_STATIC)
-       || sqlite3_bind_int(stmt3,   13, cli_asn)
-       || sqlite3_bind_int(stmt3,   14, srv_asn)
-       || sqlite3_bind_text(stmt3,  15, cli_ip, -1, SQLITE_STATIC)
-       || sqlite3_bind_text(stmt3,  16, srv_ip, -1, SQLITE_STATIC)
-       || sqlite3_bind_int(stmt3,   17, cli_port)
-       || sqlite3_bind_int(stmt3,   18, srv_port)
-       || sqlite3_bind_int64(stmt3, 19, cli2srv_bytes)
-       || sqlite3_bind_int64(stmt3, 20, srv2cli_bytes)
-       || sqlite3_bind_int64(stmt3, 21, cli2srv_packets)
-       || sqlite3_bind_int64(stmt3, 22, srv2cli_packets)
-       || sqlite3_bind_int(stmt3,   23, cli_is_blacklisted ? 1 : 0)
-       || sqlite3_bind_int(stmt3,   24, srv_is_blacklisted ? 1 : 0)
-       || sqlite3_bind_int(stmt3,   25, cli_is_localhost ? 1 : 0)
-       || sqlite3_bind_int(stmt3,   26, srv_is_localhost ? 1 : 0)
-       || sqlite3_bind_blob(stmt3,  27, cli_ip_raw.s6_addr, sizeof(cli_ip_raw.s6_addr), SQLITE_STATIC)
-       || sqlite3_bind_blob(stmt3,  28, srv_ip_raw.s6_addr, sizeof(srv_ip_raw.s6_addr), SQLITE_STATIC)
-       || sqlite3_bind_int(stmt3,   29, (int) score)
-       || sqlite3_bind_int64(stmt3, 30, static_cast<long int>(first_seen))
-       || sqlite3_bind_int(stmt3,   31, (int) status)) {
-      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to bind to arguments to %s", query);
+    if(fa->cli_ip[0])
+      inet_pton(family, fa->cli_ip, (family == AF_INET6) ? (void*)&cli_ip_raw : ((char*)&cli_ip_raw)+12);
+
+    if(fa->srv_ip[0])
+      inet_pton(family, fa->srv_ip, (family == AF_INET6) ? (void*)&srv_ip_raw : ((char*)&srv_ip_raw)+12);
+
+    if(sqlite3_bind_int64(flow_alert_insert_stmt,     1, static_cast<long int>(fa->tstamp))
+       || sqlite3_bind_int(flow_alert_insert_stmt,    2, (int)(fa->alert_type))
+       || sqlite3_bind_int(flow_alert_insert_stmt,    3, (int)(fa->alert_severity))
+       || sqlite3_bind_text(flow_alert_insert_stmt,   4, fa->alert_json, -1, SQLITE_STATIC)
+       || sqlite3_bind_int(flow_alert_insert_stmt,    5, fa->vlan_id)
+       || sqlite3_bind_int(flow_alert_insert_stmt,    6, fa->protocol)
+       || sqlite3_bind_int(flow_alert_insert_stmt,    7, fa->ndpi_master_protocol)
+       || sqlite3_bind_int(flow_alert_insert_stmt,    8, fa->ndpi_app_protocol)
+       || sqlite3_bind_text(flow_alert_insert_stmt,   9, fa->cli_country, -1, SQLITE_STATIC)
+       || sqlite3_bind_text(flow_alert_insert_stmt,  10, fa->srv_country, -1, SQLITE_STATIC)
+       || sqlite3_bind_text(flow_alert_insert_stmt,  11, fa->cli_os, -1, SQLITE_STATIC)
+       || sqlite3_bind_text(flow_alert_insert_stmt,  12, fa->srv_os, -1, SQLITE_STATIC)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   13, fa->cli_asn)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   14, fa->srv_asn)
+       || sqlite3_bind_text(flow_alert_insert_stmt,  15, fa->cli_ip, -1, SQLITE_STATIC)
+       || sqlite3_bind_text(flow_alert_insert_stmt,  16, fa->srv_ip, -1, SQLITE_STATIC)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   17, fa->cli_port)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   18, fa->srv_port)
+       || sqlite3_bind_int64(flow_alert_insert_stmt, 19, fa->cli2srv_bytes)
+       || sqlite3_bind_int64(flow_alert_insert_stmt, 20, fa->srv2cli_bytes)
+       || sqlite3_bind_int64(flow_alert_insert_stmt, 21, fa->cli2srv_packets)
+       || sqlite3_bind_int64(flow_alert_insert_stmt, 22, fa->srv2cli_packets)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   23, fa->cli_is_blacklisted ? 1 : 0)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   24, fa->srv_is_blacklisted ? 1 : 0)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   25, fa->cli_is_localhost ? 1 : 0)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   26, fa->srv_is_localhost ? 1 : 0)
+       || sqlite3_bind_blob(flow_alert_insert_stmt,  27, cli_ip_raw.s6_addr, sizeof(cli_ip_raw.s6_addr), SQLITE_STATIC)
+       || sqlite3_bind_blob(flow_alert_insert_stmt,  28, srv_ip_raw.s6_addr, sizeof(srv_ip_raw.s6_addr), SQLITE_STATIC)
+       || sqlite3_bind_int(flow_alert_insert_stmt,   29, (int) fa->score)
+       || sqlite3_bind_int64(flow_alert_insert_stmt, 30, static_cast<long int>(fa->first_seen))
+       || sqlite3_bind_int(flow_alert_insert_stmt,   31, (int) fa->status)) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to bind to arguments to the flow alerts INSERT");
       rc = -9;
       goto out;
     }
 
-    if((rc = exec_statement(stmt3)) != SQLITE_DONE) {
+    if((rc = exec_statement(flow_alert_insert_stmt)) != SQLITE_DONE) {
       rc = -1;
       goto out;
     }
-
-    cur_rowid = sqlite3_last_insert_rowid(db);
   }
 
   /* Success */
   iface->incNumWrittenAlerts();
   rc = 0;
-out:
 
-  if(stmt) sqlite3_finalize(stmt);
-  if(stmt2) sqlite3_finalize(stmt2);
-  if(stmt3) sqlite3_finalize(stmt3);
+ out:
+  sqlite3_reset(stmt), sqlite3_clear_bindings(stmt);
+  sqlite3_reset(flow_alert_update_stmt), sqlite3_clear_bindings(flow_alert_update_stmt);
+  sqlite3_reset(flow_alert_insert_stmt), sqlite3_clear_bindings(flow_alert_insert_stmt);
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+/*
+  Writes a batch of queued alerts in a single transaction. Returns the
+  number of alerts dequeued, zero when the queues are empty.
+*/
+u_int32_t AlertsManager::writeQueuedAlerts() {
+  vector<QueuedAlert*> alerts;
+  vector<QueuedFlowAlert*> flow_alerts;
+  std::map<std::string, QueuedAlert*> aggregated;
+  bool make_room = false, make_room_flows = false;
+  u_int32_t num_alerts, num_flow_alerts;
+  char begin_query[] = "BEGIN TRANSACTION;", commit_query[] = "COMMIT;";
+
+  queue_lock.lock(__FILE__, __LINE__);
+
+  num_alerts = min_val(queued_alerts->size(), ALERTS_MANAGER_WRITE_BATCH);
+  num_flow_alerts = min_val(queued_flow_alerts->size(), ALERTS_MANAGER_WRITE_BATCH);
+
+  try {
+    alerts.assign(queued_alerts->begin(), queued_alerts->begin() + num_alerts);
+    flow_alerts.assign(queued_flow_alerts->begin(), queued_flow_alerts->begin() + num_flow_alerts);
+  } catch(std::bad_alloc& ba) {
+    queue_lock.unlock(__FILE__, __LINE__);
+    return(0); /* Retry later */
+  }
+
+  queued_alerts->erase(queued_alerts->begin(), queued_alerts->begin() + num_alerts);
+  queued_flow_alerts->erase(queued_flow_alerts->begin(), queued_flow_alerts->begin() + num_flow_alerts);
+
+  make_room = make_room_alerts, make_room_flows = make_room_flow_alerts;
+  make_room_alerts = make_room_flow_alerts = false;
+
+  queue_lock.unlock(__FILE__, __LINE__);
+
+  if(num_alerts + num_flow_alerts == 0)
+    return(0);
+
+  /* Once per batch rather than once per alert */
+  if(make_room)       markForMakeRoom(false);
+  if(make_room_flows) markForMakeRoom(true);
+
+  /* Equal not engaged alerts of the batch are merged into a single record */
+  for(vector<QueuedAlert*>::iterator it = alerts.begin(); it != alerts.end(); ++it) {
+    QueuedAlert *a = *it;
+    char *k;
+
+    if((a->tstart != a->tend)
+       || ((k = getAlertCacheKey(ifid, a->alert_type, a->subtype, a->granularity,
+				 a->alert_entity, a->alert_entity_value, a->alert_severity)) == NULL))
+      continue;
+
+    try {
+      std::map<std::string, QueuedAlert*>::iterator agg = aggregated.find(k);
+
+      if(agg == aggregated.end())
+	aggregated[k] = a;
+      else {
+	QueuedAlert *first = agg->second;
+
+	first->counter += a->counter;
+	if(a->tend > first->tend) first->tend = a->tend;
+	freeQueuedAlert(a);
+	*it = NULL;
+      }
+    } catch(std::bad_alloc& ba) {
+      /* Not aggregated, written as a separate alert */
+    }
+
+    free(k);
+  }
+
+  m.lock(__FILE__, __LINE__);
+
+  exec_query(begin_query, NULL, NULL);
+
+  for(vector<QueuedAlert*>::iterator it = alerts.begin(); it != alerts.end(); ++it) {
+    if(*it) {
+      writeAlert(*it);
+      freeQueuedAlert(*it);
+    }
+  }
+
+  for(vector<QueuedFlowAlert*>::iterator it = flow_alerts.begin(); it != flow_alerts.end(); ++it) {
+    writeFlowAlert(*it);
+    freeQueuedFlowAlert(*it);
+  }
+
+  if(exec_query(commit_query, NULL, NULL))
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to commit alerts: %s", sqlite3_errmsg(db));
+
   m.unlock(__FILE__, __LINE__);
 
-  if((rc == 0) && (cur_rowid != (u_int64_t)-1))
-    *rowid = cur_rowid;
+  return(num_alerts + num_flow_alerts);
+}
 
-  iface->setHasAlerts(true);
+/* **************************************************** */
 
-  ntop->getTrace()->traceEvent(TRACE_INFO, "%s", alert_json);
+void AlertsManager::writerLoop() {
+  while(!writer_shutdown) {
+    if(writeQueuedAlerts() == 0) {
+      /* Nothing to write. Wait for at most 1s to check for shutdowns */
+      struct timespec writer_wait_expire;
+      bool empty;
 
-  return rc;
+      writer_wait_expire.tv_sec = time(NULL) + 1,
+	writer_wait_expire.tv_nsec = 0;
+
+      /* Producers only signal when we are parked: check the queues again once announced */
+      writer_cond.prepareWait();
+
+      queue_lock.lock(__FILE__, __LINE__);
+      empty = queued_alerts->empty() && queued_flow_alerts->empty();
+      queue_lock.unlock(__FILE__, __LINE__);
+
+      if(empty && !writer_shutdown)
+	writer_cond.timedWait(&writer_wait_expire);
+
+      writer_cond.cancelWait();
+    }
+  }
+
+  /* Do not lose the alerts queued before the shutdown */
+  while(writeQueuedAlerts() > 0)
+    ;
 }
 
 /* ******************************************* */
@@ -0,0 +1,615 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+#define DNS_HEADER_LEN     12
+#define DNS_TYPE_PTR       12
+#define DNS_CLASS_IN        1
+#define DNS_RCODE_NXDOMAIN  3
+#define DNS_MAX_MSG_LEN   512
+
+/* **************************************************** */
+
+AsyncResolver::AsyncResolver(const char *_server, u_int32_t _max_outstanding, u_int32_t _max_qps) {
+  char buf[64];
+  struct timeval now;
+
+  sock = -1, server_len = 0;
+  max_outstanding = min_val(max_val(_max_outstanding, 1), 65535), num_outstanding = 0;
+  max_qps = max_val(_max_qps, 1), tokens = (float)max_qps;
+  num_queries = num_retransmissions = num_resolved = num_negative = 0;
+  num_timeouts = num_send_errors = num_invalid_responses = num_invalid_names = num_cache_hits = num_rate_limited = 0;
+
+  gettimeofday(&now, NULL);
+  last_refill = now;
+  rand_state = (u_int32_t)(now.tv_sec ^ now.tv_usec ^ (getpid() << 16)) | 1;
+
+  queries = (PendingQuery*)calloc(max_outstanding, sizeof(PendingQuery));
+  query_by_id = (u_int16_t*)calloc(65536, sizeof(u_int16_t));
+
+  if((queries == NULL) || (query_by_id == NULL))
+    return;
+
+  try {
+    free_slots.reserve(max_outstanding);
+
+    for(u_int32_t i = max_outstanding; i > 0; i--)
+      free_slots.push_back(i - 1);
+  } catch(std::bad_alloc& ba) {
+    return;
+  }
+
+  if(_server ? !parseServer(_server, &server, &server_len) : !getSystemServer(&server, &server_len)) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to find the name server to use for asynchronous resolution %s%s",
+				 _server ? "from " : "", _server ? _server : "");
+    return;
+  }
+
+  if((sock = socket(server.ss_family, SOCK_DGRAM, 0)) < 0) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to create resolver socket [%s]", strerror(errno));
+    return;
+  }
+
+  /* Connecting the socket filters out datagrams not coming from the name server */
+  if((fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) < 0)
+     || (connect(sock, (struct sockaddr*)&server, server_len) < 0)) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to connect resolver socket [%s]", strerror(errno));
+    closesocket(sock);
+    sock = -1;
+    return;
+  }
+
+  if(getnameinfo((struct sockaddr*)&server, server_len, buf, sizeof(buf), NULL, 0, NI_NUMERICHOST) != 0)
+    buf[0] = '\0';
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Asynchronous address resolution via %s [max outstanding: %u][max qps: %u]",
+			       buf, max_outstanding, max_qps);
+}
+
+/* **************************************************** */
+
+AsyncResolver::~AsyncResolver() {
+  if(sock >= 0) {
+    closesocket(sock);
+
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Asynchronous resolution stats [%llu queries][%llu retransmissions]"
+				 "[%llu resolved][%llu negative][%llu timeouts][%llu cache hits]",
+				 (unsigned long long)num_queries, (unsigned long long)num_retransmissions,
+				 (unsigned long long)num_resolved, (unsigned long long)num_negative,
+				 (unsigned long long)num_timeouts, (unsigned long long)num_cache_hits);
+  }
+
+  if(queries)     free(queries);
+  if(query_by_id) free(query_by_id);
+}
+
+/* **************************************************** */
+
+/* Format: ip, ip:port or [ipv6]:port */
+bool AsyncResolver::parseServer(const char *server, struct sockaddr_storage *addr, socklen_t *addr_len) {
+  char host[64], *port = NULL;
+  struct sockaddr_in *in4 = (struct sockaddr_in*)addr;
+  struct sockaddr_in6 *in6 = (struct sockaddr_in6*)addr;
+  u_int16_t port_num = 53;
+
+  snprintf(host, sizeof(host), "%s", server);
+
+  if(host[0] == '[') {
+    char *end = strchr(host, ']');
+
+    if(end == NULL) return(false);
+    *end = '\0';
+    if(end[1] == ':') port = &end[2];
+    memmove(host, &host[1], strlen(&host[1]) + 1);
+  } else if((port = strchr(host, ':')) != NULL) {
+    if(strchr(&port[1], ':') != NULL)
+      port = NULL; /* Plain IPv6 address */
+    else
+      *port++ = '\0';
+  }
+
+  if(port) {
+    int p = atoi(port);
+
+    if((p <= 0) || (p > 65535)) return(false);
+    port_num = (u_int16_t)p;
+  }
+
+  memset(addr, 0, sizeof(*addr));
+
+  if(inet_pton(AF_INET, host, &in4->sin_addr) == 1) {
+    in4->sin_family = AF_INET, in4->sin_port = htons(port_num);
+    *addr_len = sizeof(struct sockaddr_in);
+  } else if(inet_pton(AF_INET6, host, &in6->sin6_addr) == 1) {
+    in6->sin6_family = AF_INET6, in6->sin6_port = htons(port_num);
+    *addr_len = sizeof(struct sockaddr_in6);
+  } else
+    return(false);
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool AsyncResolver::getSystemServer(struct sockaddr_storage *addr, socklen_t *addr_len) {
+  FILE *fd = fopen("/etc/resolv.conf", "r");
+  char line[256], server[64];
+  bool found = false;
+
+  if(fd == NULL)
+    return(false);
+
+  while(!found && fgets(line, sizeof(line), fd)) {
+    char *scope;
+
+    if(sscanf(line, " nameserver %63s", server) != 1)
+      continue;
+
+    /* Link-local IPv6 servers (fe80::1%eth0) are not supported */
+    if((scope = strchr(server, '%')) != NULL)
+      continue;
+
+    found = parseServer(server, addr, addr_len);
+  }
+
+  fclose(fd);
+  return(found);
+}
+
+/* **************************************************** */
+
+int AsyncResolver::buildPtrName(const char *numeric_ip, char *name, u_int name_len) {
+  struct in_addr a4;
+  struct in6_addr a6;
+
+  if(inet_pton(AF_INET, numeric_ip, &a4) == 1) {
+    u_int8_t *b = (u_int8_t*)&a4.s_addr;
+
+    return(snprintf(name, name_len, "%u.%u.%u.%u.in-addr.arpa", b[3], b[2], b[1], b[0]));
+  } else if(inet_pton(AF_INET6, numeric_ip, &a6) == 1) {
+    static const char hex[] = "0123456789abcdef";
+    u_int len = 0;
+
+    if(name_len < 64 + sizeof("ip6.arpa"))
+      return(-1);
+
+    for(int i = 15; i >= 0; i--) {
+      name[len++] = hex[a6.s6_addr[i] & 0x0F], name[len++] = '.';
+      name[len++] = hex[a6.s6_addr[i] >> 4],   name[len++] = '.';
+    }
+
+    return(len + snprintf(&name[len], name_len - len, "ip6.arpa"));
+  }
+
+  return(-1);
+}
+
+/* **************************************************** */
+
+int AsyncResolver::encodeQuery(u_int16_t query_id, const char *ptr_name, u_char *buf, u_int buf_len) {
+  u_int len = DNS_HEADER_LEN;
+  const char *label = ptr_name;
+
+  if(buf_len < DNS_HEADER_LEN + strlen(ptr_name) + 2 + 4)
+    return(-1);
+
+  memset(buf, 0, DNS_HEADER_LEN);
+  buf[0] = query_id >> 8, buf[1] = query_id & 0xFF;
+  buf[2] = 0x01; /* Recursion desired */
+  buf[5] = 1;    /* One question */
+
+  while(*label) {
+    const char *dot = strchr(label, '.');
+    u_int label_len = dot ? (u_int)(dot - label) : (u_int)strlen(label);
+
+    if((label_len == 0) || (label_len > 63))
+      return(-1);
+
+    buf[len++] = label_len;
+    memcpy(&buf[len], label, label_len), len += label_len;
+    label += label_len + (dot ? 1 : 0);
+  }
+
+  buf[len++] = 0;
+  buf[len++] = 0, buf[len++] = DNS_TYPE_PTR;
+  buf[len++] = 0, buf[len++] = DNS_CLASS_IN;
+
+  return(len);
+}
+
+/* **************************************************** */
+
+/* Decodes the (possibly compressed) name at offset. Returns the offset past the name, -1 on malformed names. */
+int AsyncResolver::decodeName(const u_char *msg, int msg_len, int offset, char *name, u_int name_len) {
+  int next = -1;
+  u_int len = 0, num_jumps = 0;
+
+  while(true) {
+    u_int8_t label_len;
+
+    if(offset >= msg_len) return(-1);
+    label_len = msg[offset];
+
+    if(label_len == 0) {
+      if(next < 0) next = offset + 1;
+      break;
+    } else if((label_len & 0xC0) == 0xC0) {
+      if((offset + 1 >= msg_len) || (++num_jumps > 16 /* Loop */)) return(-1);
+      if(next < 0) next = offset + 2;
+      offset = ((label_len & 0x3F) << 8) | msg[offset + 1];
+    } else if(label_len & 0xC0)
+      return(-1);
+    else {
+      if((offset + 1 + label_len > msg_len) || (len + label_len + 2 > name_len)) return(-1);
+      if(len > 0) name[len++] = '.';
+      memcpy(&name[len], &msg[offset + 1], label_len), len += label_len;
+      offset += 1 + label_len;
+    }
+  }
+
+  if(name_len > 0) name[len] = '\0';
+  return(next);
+}
+
+/* **************************************************** */
+
+/*
+  PTR names end up in the GUI and in the exports: only letter-digit-hyphen
+  labels (RFC 1123) of at most 63 bytes each, 253 bytes in total, are accepted.
+ */
+bool AsyncResolver::isValidHostname(const char *name) {
+  u_int len = 0, label_len = 0;
+
+  for(const char *c = name; ; c++, len++) {
+    if((*c == '.') || (*c == '\0')) {
+      if((label_len == 0) || (c[-1] == '-'))
+	return(false); /* Empty label or trailing hyphen */
+
+      if(*c == '\0')
+	break;
+
+      label_len = 0;
+    } else if(((*c >= 'a') && (*c <= 'z')) || ((*c >= 'A') && (*c <= 'Z'))
+	      || ((*c >= '0') && (*c <= '9')) || ((*c == '-') && (label_len > 0))) {
+      if(++label_len > 63)
+	return(false);
+    } else
+      return(false);
+  }
+
+  return(len <= 253);
+}
+
+/* **************************************************** */
+
+u_int16_t AsyncResolver::newQueryId() {
+  u_int16_t id;
+
+  /* Unpredictable ids make off-path response spoofing harder */
+  do {
+    rand_state ^= rand_state << 13, rand_state ^= rand_state >> 17, rand_state ^= rand_state << 5;
+    id = (u_int16_t)(rand_state >> 8);
+  } while(query_by_id[id] != 0);
+
+  return(id);
+}
+
+/* **************************************************** */
+
+void AsyncResolver::refillTokens(const struct timeval *now) {
+  float elapsed = (now->tv_sec - last_refill.tv_sec) + (now->tv_usec - last_refill.tv_usec) / 1000000.0f;
+
+  if(elapsed > 0) {
+    tokens = min_val(tokens + elapsed * max_qps, (float)max_qps);
+    last_refill = *now;
+  }
+}
+
+/* **************************************************** */
+
+bool AsyncResolver::consumeToken(const struct timeval *now) {
+  refillTokens(now);
+
+  if(tokens < 1)
+    return(false);
+
+  tokens -= 1;
+  return(true);
+}
+
+/* **************************************************** */
+
+bool AsyncResolver::canResolve() {
+  struct timeval now;
+
+  if((sock < 0) || free_slots.empty())
+    return(false);
+
+  gettimeofday(&now, NULL);
+  refillTokens(&now);
+
+  if(tokens < 1) {
+    num_rate_limited++;
+    return(false);
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool AsyncResolver::sendQuery(u_int32_t slot, const struct timeval *now) {
+  PendingQuery *q = &queries[slot];
+  char ptr_name[128];
+  u_char buf[DNS_MAX_MSG_LEN];
+  int len;
+
+  if((buildPtrName(q->numeric_ip, ptr_name, sizeof(ptr_name)) < 0)
+     || ((len = encodeQuery(q->query_id, ptr_name, buf, sizeof(buf))) < 0)
+     || (send(sock, (const char*)buf, len, 0) != len)) {
+    num_send_errors++;
+    return(false);
+  }
+
+  q->sent = *now;
+  num_queries++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool AsyncResolver::resolve(const char *numeric_ip) {
+  char rsp[128], ip[64];
+  struct in6_addr a6;
+  struct timeval now;
+  PendingQuery *q;
+  u_int32_t slot;
+
+  snprintf(ip, sizeof(ip), "%s", numeric_ip);
+
+  if((inet_pton(AF_INET, ip, &a6) != 1) && (inet_pton(AF_INET6, ip, &a6) != 1))
+    return(false);
+
+  /* Resolved meanwhile, or queued more than once */
+  if(ntop->getRedis()->getAddress(ip, rsp, sizeof(rsp), false) == 0) {
+    num_cache_hits++;
+    return(true);
+  }
+
+  gettimeofday(&now, NULL);
+
+  /*
+    Addresses that cannot be queried now are dropped: they are queued
+    again the next time their name is looked up
+  */
+  if((sock < 0) || free_slots.empty() || !consumeToken(&now))
+    return(true);
+
+  slot = free_slots.back();
+  q = &queries[slot];
+  memset(q, 0, sizeof(*q));
+  snprintf(q->numeric_ip, sizeof(q->numeric_ip), "%s", ip);
+  q->query_id = newQueryId();
+
+  /*
+    The query is tracked even when it could not be sent: the send failure
+    counts as an attempt, and the query is retransmitted (or cached as
+    negative) by checkTimeouts()
+  */
+  if(!sendQuery(slot, &now))
+    q->sent = now;
+
+  free_slots.pop_back();
+  q->in_use = true, query_by_id[q->query_id] = slot + 1;
+  num_outstanding++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+/* hostname is NULL when the address could not be resolved */
+void AsyncResolver::completeQuery(u_int32_t slot, const char *hostname, u_int negative_expire_secs) {
+  PendingQuery *q = &queries[slot];
+  Redis *r = ntop->getRedis();
+
+  if(hostname) {
+    r->setResolvedAddress(q->numeric_ip, (char*)hostname);
+    num_resolved++;
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Resolved %s to %s", q->numeric_ip, hostname);
+  } else {
+    /* So we avoid to continuously resolve the same address */
+    r->setResolvedAddress(q->numeric_ip, q->numeric_ip, negative_expire_secs);
+    num_negative++;
+  }
+
+  query_by_id[q->query_id] = 0;
+  q->in_use = false;
+  free_slots.push_back(slot);
+  num_outstanding--;
+}
+
+/* **************************************************** */
+
+void AsyncResolver::handleResponse(const u_char *msg, int msg_len) {
+  u_int16_t query_id, qdcount, ancount, qtype, qclass;
+  u_int8_t rcode;
+  char qname[256], expected[128], hostname[256];
+  bool found = false, invalid_name = false;
+  PendingQuery *q;
+  u_int32_t slot;
+  int offset;
+
+  if(msg_len < DNS_HEADER_LEN) {
+    num_invalid_responses++;
+    return;
+  }
+
+  query_id = (msg[0] << 8) | msg[1];
+
+  if(query_by_id[query_id] == 0) {
+    /* Late response to a query already retransmitted or expired */
+    num_invalid_responses++;
+    return;
+  }
+
+  slot = query_by_id[query_id] - 1, q = &queries[slot];
+  rcode = msg[3] & 0x0F;
+  qdcount = (msg[4] << 8) | msg[5], ancount = (msg[6] << 8) | msg[7];
+
+  /* Must be a standard query response echoing our question */
+  if(!(msg[2] & 0x80) || (((msg[2] >> 3) & 0x0F) != 0) || (qdcount != 1)
+     || ((offset = decodeName(msg, msg_len, DNS_HEADER_LEN, qname, sizeof(qname))) < 0)
+     || (offset + 4 > msg_len)
+     || (buildPtrName(q->numeric_ip, expected, sizeof(expected)) < 0)
+     || strcasecmp(qname, expected)) {
+    num_invalid_responses++;
+    return;
+  }
+
+  qtype = (msg[offset] << 8) | msg[offset + 1], qclass = (msg[offset + 2] << 8) | msg[offset + 3];
+  offset += 4;
+
+  if((qtype != DNS_TYPE_PTR) || (qclass != DNS_CLASS_IN)) {
+    num_invalid_responses++;
+    return;
+  }
+
+  if(rcode == 0) {
+    for(u_int16_t i = 0; (i < ancount) && !found; i++) {
+      u_int16_t type, rdlen;
+
+      if(((offset = decodeName(msg, msg_len, offset, qname, sizeof(qname))) < 0)
+	 || (offset + 10 > msg_len))
+	break;
+
+      type = (msg[offset] << 8) | msg[offset + 1];
+      rdlen = (msg[offset + 8] << 8) | msg[offset + 9];
+      offset += 10;
+
+      if(offset + rdlen > msg_len)
+	break;
+
+      if((type == DNS_TYPE_PTR)
+	 && (decodeName(msg, offset + rdlen, offset, hostname, sizeof(hostname)) > 0)
+	 && (hostname[0] != '\0')) {
+	if(isValidHostname(hostname))
+	  found = true;
+	else
+	  invalid_name = true;
+      }
+
+      offset += rdlen;
+    }
+
+    if(!found && invalid_name) {
+      /* Cached as unresolved, as a server sending such names is unlikely to fix them soon */
+      ntop->getTrace()->traceEvent(TRACE_INFO, "Invalid PTR name for %s", q->numeric_ip);
+      num_invalid_names++;
+    }
+
+    completeQuery(slot, found ? hostname : NULL, DNS_CACHE_DURATION);
+  } else if(rcode == DNS_RCODE_NXDOMAIN)
+    completeQuery(slot, NULL, DNS_CACHE_DURATION);
+  else {
+    /* Server failure or refusal: try again sooner */
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Resolution of %s failed [rcode: %u]", q->numeric_ip, rcode);
+    completeQuery(slot, NULL, DNS_NEGATIVE_CACHE_DURATION);
+  }
+}
+
+/* **************************************************** */
+
+void AsyncResolver::checkTimeouts(const struct timeval *now) {
+  for(u_int32_t slot = 0; (slot < max_outstanding) && (num_outstanding > 0); slot++) {
+    PendingQuery *q = &queries[slot];
+
+    if(!q->in_use || (Utils::msTimevalDiff(now, &q->sent) < DNS_RESOLVER_TIMEOUT_MSEC))
+      continue;
+
+    if(q->num_retries < DNS_RESOLVER_MAX_RETRIES) {
+      if(!consumeToken(now))
+	break; /* Retry later on */
+
+      /* A new id, so that a late response to the previous attempt is ignored */
+      query_by_id[q->query_id] = 0;
+      q->query_id = newQueryId(), q->num_retries++;
+      query_by_id[q->query_id] = slot + 1;
+
+      if(sendQuery(slot, now))
+	num_retransmissions++;
+      else
+	q->sent = *now; /* Send failure: count it as an attempt */
+    } else {
+      num_timeouts++;
+      completeQuery(slot, NULL, DNS_NEGATIVE_CACHE_DURATION);
+    }
+  }
+}
+
+/* **************************************************** */
+
+void AsyncResolver::poll(u_int32_t timeout_ms) {
+  struct pollfd pfd;
+  struct timeval now;
+
+  if(sock < 0)
+    return;
+
+  pfd.fd = sock, pfd.events = POLLIN, pfd.revents = 0;
+
+  if(::poll(&pfd, 1, timeout_ms) > 0) {
+    u_char buf[DNS_MAX_MSG_LEN * 8]; /* Room for EDNS replies */
+    int len;
+
+    while((len = recv(sock, (char*)buf, sizeof(buf), 0)) > 0)
+      handleResponse(buf, len);
+  }
+
+  gettimeofday(&now, NULL);
+  checkTimeouts(&now);
+}
+
+/* **************************************************** */
+
+void AsyncResolver::lua(lua_State *vm) {
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "num_queries", num_queries);
+  lua_push_uint64_table_entry(vm, "num_retransmissions", num_retransmissions);
+  lua_push_uint64_table_entry(vm, "num_resolved", num_resolved);
+  lua_push_uint64_table_entry(vm, "num_negative", num_negative);
+  lua_push_uint64_table_entry(vm, "num_timeouts", num_timeouts);
+  lua_push_uint64_table_entry(vm, "num_send_errors", num_send_errors);
+  lua_push_uint64_table_entry(vm, "num_invalid_responses", num_invalid_responses);
+  lua_push_uint64_table_entry(vm, "num_invalid_names", num_invalid_names);
+  lua_push_uint64_table_entry(vm, "num_cache_hits", num_cache_hits);
+  lua_push_uint64_table_entry(vm, "num_rate_limited", num_rate_limited);
+  lua_push_uint64_table_entry(vm, "num_outstanding", num_outstanding);
+  lua_push_uint64_table_entry(vm, "max_outstanding", max_outstanding);
+  lua_push_uint64_table_entry(vm, "max_qps", max_qps);
+
+  lua_pushstring(vm, "async");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
@@ -48,7 +48,6 @@ void AutonomousSystem::set_hash_entry_state_idle() {
 /* *************************************** */
 
 AutonomousSystem::~AutonomousSystem() {
-  if(asname) free(asname);
   /* TODO: decide if it is useful to dump AS stats to redis */
 
 #ifdef AS_DEBUG
@@ -35,9 +35,7 @@ AutonomousSystem* AutonomousSystemHash::get(IpAddress *ipa, bool is_inline_call)
   u_int32_t asn, hash;
 
   ntop->getGeolocation()->getAS(ipa, &asn, NULL /* Don't care about AS name here */);
-  hash = asn;
-  
-  hash %= num_hashes;
+  hash = bucketId(asn);
 
   if(table[hash] == NULL) {
     return(NULL);
@@ -0,0 +1,281 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+BinarySerializer::BinarySerializer(u_int32_t initial_size) {
+  size = max_val(initial_size, 16), len = 0;
+
+  if((buf = (u_int8_t*)malloc(size)) == NULL)
+    size = 0, failed = true;
+  else
+    failed = false;
+}
+
+/* **************************************************** */
+
+BinarySerializer::~BinarySerializer() {
+  if(buf) free(buf);
+}
+
+/* **************************************************** */
+
+bool BinarySerializer::grow(u_int32_t needed) {
+  u_int32_t new_size = size ? size : 16;
+  u_int8_t *new_buf;
+
+  if(failed) return(false);
+
+  while(new_size - len < needed) {
+    if(new_size > HOST_MAX_SERIALIZED_LEN) {
+      failed = true;
+      return(false);
+    }
+
+    new_size *= 2;
+  }
+
+  if((new_buf = (u_int8_t*)realloc(buf, new_size)) == NULL) {
+    failed = true;
+    return(false);
+  }
+
+  buf = new_buf, size = new_size;
+  return(true);
+}
+
+/* **************************************************** */
+
+void BinarySerializer::putHeader() {
+  putU8(BINARY_SERIALIZATION_MAGIC);
+  putU8(BINARY_SERIALIZATION_VERSION);
+}
+
+/* **************************************************** */
+
+void BinarySerializer::putVarint(u_int64_t v) {
+  /* A varint takes at most 10 bytes */
+  if((size - len < 10) && !grow(10))
+    return;
+
+  while(v >= 0x80) {
+    buf[len++] = (u_int8_t)(v | 0x80);
+    v >>= 7;
+  }
+
+  buf[len++] = (u_int8_t)v;
+}
+
+/* **************************************************** */
+
+void BinarySerializer::putBytes(const void *data, u_int32_t data_len) {
+  if((size - len < data_len) && !grow(data_len))
+    return;
+
+  memcpy(&buf[len], data, data_len);
+  len += data_len;
+}
+
+/* **************************************************** */
+
+void BinarySerializer::putString(const char *s) {
+  u_int32_t s_len = s ? strlen(s) : 0;
+
+  putVarint(s_len);
+  putBytes(s, s_len);
+}
+
+/* **************************************************** */
+
+u_int32_t BinarySerializer::beginSection(u_int8_t tag) {
+  putVarint(tag);
+  putU8(0); /* Length placeholder, enough for payloads shorter than 128 bytes */
+
+  return(len);
+}
+
+/* **************************************************** */
+
+void BinarySerializer::endSection(u_int32_t begin) {
+  u_int32_t payload_len, num_len_bytes = 1;
+  u_int64_t v;
+
+  if(failed || (begin > len)) return;
+
+  payload_len = len - begin;
+
+  for(v = payload_len; v >= 0x80; v >>= 7)
+    num_len_bytes++;
+
+  if(num_len_bytes > 1) {
+    /* Make room for the longer length */
+    if((size - len < num_len_bytes - 1) && !grow(num_len_bytes - 1))
+      return;
+
+    memmove(&buf[begin + num_len_bytes - 1], &buf[begin], payload_len);
+    len += num_len_bytes - 1;
+  }
+
+  v = payload_len;
+  for(u_int32_t i = 0; i < num_len_bytes; i++, v >>= 7)
+    buf[begin - 1 + i] = (u_int8_t)((v & 0x7F) | ((i < num_len_bytes - 1) ? 0x80 : 0));
+}
+
+/* **************************************************** */
+
+u_int8_t* BinarySerializer::detach() {
+  u_int8_t *data = buf;
+
+  buf = NULL, len = size = 0;
+  failed = true; /* Nothing can be appended anymore */
+
+  return(data);
+}
+
+/* **************************************************** */
+
+BinaryDeserializer::BinaryDeserializer(const u_int8_t *_buf, u_int32_t _len) {
+  buf = _buf, len = _buf ? _len : 0, offset = 0;
+  failed = false;
+}
+
+/* **************************************************** */
+
+bool BinaryDeserializer::isBinary(const char *data, u_int32_t data_len) {
+  return(data && (data_len >= 2) && ((u_int8_t)data[0] == BINARY_SERIALIZATION_MAGIC));
+}
+
+/* **************************************************** */
+
+bool BinaryDeserializer::readHeader() {
+  if(!isBinary((const char*)buf, len)) {
+    failed = true;
+    return(false);
+  }
+
+  offset = 2;
+
+  if(buf[1] > BINARY_SERIALIZATION_VERSION) {
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Unsupported binary serialization version %u", buf[1]);
+    failed = true;
+    return(false);
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool BinaryDeserializer::nextSection(u_int8_t *tag, BinaryDeserializer *section) {
+  u_int64_t t, section_len;
+
+  if(failed || isEmpty())
+    return(false);
+
+  t = getVarint(), section_len = getVarint();
+
+  if(failed || (section_len > len - offset)) {
+    failed = true;
+    return(false);
+  }
+
+  /* Tags are 8 bit: larger ones, from future versions, are reported as 0 and thus skipped */
+  *tag = (t <= 0xFF) ? (u_int8_t)t : 0;
+  *section = BinaryDeserializer(&buf[offset], (u_int32_t)section_len);
+  offset += (u_int32_t)section_len;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+u_int8_t BinaryDeserializer::getU8() {
+  return(isEmpty() ? 0 : buf[offset++]);
+}
+
+/* **************************************************** */
+
+u_int64_t BinaryDeserializer::getVarint() {
+  u_int64_t v = 0;
+
+  /* Missing trailing fields are read as zero */
+  if(isEmpty()) return(0);
+
+  for(u_int shift = 0; shift < 64; shift += 7) {
+    u_int8_t b;
+
+    if(isEmpty()) break;
+
+    b = buf[offset++];
+    v |= ((u_int64_t)(b & 0x7F)) << shift;
+
+    if((b & 0x80) == 0)
+      return(v);
+  }
+
+  /* Truncated or too long */
+  failed = true;
+  return(0);
+}
+
+/* **************************************************** */
+
+const u_int8_t* BinaryDeserializer::getBytes(u_int32_t n) {
+  const u_int8_t *b;
+
+  if(failed || (n > len - offset)) {
+    failed = true;
+    return(NULL);
+  }
+
+  b = &buf[offset];
+  offset += n;
+
+  return(b);
+}
+
+/* **************************************************** */
+
+bool BinaryDeserializer::getString(char *s, u_int32_t s_len) {
+  u_int64_t n = getVarint();
+  const u_int8_t *b;
+
+  if(s_len == 0) return(false);
+
+  s[0] = '\0';
+
+  if(failed || (n > len - offset)) {
+    failed = true;
+    return(false);
+  }
+
+  if((b = getBytes((u_int32_t)n)) == NULL)
+    return(false);
+
+  n = min_val(n, (u_int64_t)(s_len - 1));
+  memcpy(s, b, n);
+  s[n] = '\0';
+
+  return(true);
+}
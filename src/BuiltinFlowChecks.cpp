@@ -0,0 +1,93 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+void BlacklistedFlowCheck::protocolDetected(Flow *f, FlowChecksExecutor *e) {
+  bool cli_blacklisted, srv_blacklisted;
+  char info[FLOW_CHECK_INFO_LEN];
+
+  if(!f->isBlacklistedFlow())
+    return;
+
+  cli_blacklisted = f->isBlacklistedClient(), srv_blacklisted = f->isBlacklistedServer();
+
+  /* Same fields as flow.getBlacklistedInfo() */
+  snprintf(info, sizeof(info), "{%s%s%s}",
+	   cli_blacklisted ? "\"blacklisted.cli\":true" : "",
+	   srv_blacklisted ? (cli_blacklisted ? ",\"blacklisted.srv\":true" : "\"blacklisted.srv\":true") : "",
+	   (f->get_protocol_category() == CUSTOM_CATEGORY_MALWARE)
+	   ? ((cli_blacklisted || srv_blacklisted) ? ",\"blacklisted.cat\":true" : "\"blacklisted.cat\":true") : "");
+
+  e->triggerStatus(f, this, status_blacklisted, 100 /* flow score */,
+		   srv_blacklisted ? SCORE_MAX_SCRIPT_VALUE : 5 /* cli score */,
+		   srv_blacklisted ? 5 : 10 /* srv score */, info);
+}
+
+/* **************************************************** */
+
+void RemoteToRemoteFlowCheck::protocolDetected(Flow *f, FlowChecksExecutor *e) {
+  Host *cli_host = f->get_cli_host(), *srv_host = f->get_srv_host();
+  const IpAddress *cli_ip = f->get_cli_ip_addr(), *srv_ip = f->get_srv_ip_addr();
+
+  if(cli_host && srv_host && !cli_host->isLocalHost() && !srv_host->isLocalHost()
+     && cli_ip && srv_ip && !cli_ip->isBroadMulticastAddress() && !srv_ip->isBroadMulticastAddress())
+    e->triggerStatus(f, this, status_remote_to_remote, 10 /* flow score */, 10 /* cli score */, 10 /* srv score */);
+}
+
+/* **************************************************** */
+
+void WebMiningFlowCheck::protocolDetected(Flow *f, FlowChecksExecutor *e) {
+  if(f->get_protocol_category() == NDPI_PROTOCOL_CATEGORY_MINING)
+    e->triggerStatus(f, this, status_web_mining_detected, 50 /* flow score */, 50 /* cli score */, 10 /* srv score */);
+}
+
+/* **************************************************** */
+
+void UDPUnidirectionalFlowCheck::checkFlow(Flow *f, FlowChecksExecutor *e) {
+  const IpAddress *cli_ip = f->get_cli_ip_addr(), *srv_ip = f->get_srv_ip_addr();
+
+  if((f->get_packets_srv2cli() > 0) || (f->get_packets_cli2srv() == 0))
+    return;
+
+  /* Now check if the recipient isn't a broadcast/multicast address */
+  if((cli_ip && cli_ip->isEmpty()) || !srv_ip || srv_ip->isBroadMulticastAddress())
+    return;
+
+  switch(f->get_detected_protocol().app_protocol) {
+  case NDPI_PROTOCOL_MDNS:
+  case NDPI_PROTOCOL_SYSLOG:
+  case NDPI_PROTOCOL_DHCP:
+  case NDPI_PROTOCOL_RTP:
+  case NDPI_PROTOCOL_DHCPV6:
+  case NDPI_PROTOCOL_NETFLOW:
+  case NDPI_PROTOCOL_SFLOW:
+    /* Unidirectional by design */
+    return;
+  default:
+    break;
+  }
+
+  e->triggerStatus(f, this, status_udp_unidirectional, 5 /* flow score */, 5 /* cli score */, 1 /* srv score */);
+}
@@ -33,6 +33,7 @@ void Condvar::init() {
   pthread_mutex_init(&mutex, NULL);
   pthread_cond_init(&condvar, NULL);
   predicate = false;
+  waiting = false;
 }
 
 /* ************************************ */
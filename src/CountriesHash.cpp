@@ -32,9 +32,7 @@ CountriesHash::CountriesHash(NetworkInterface *_iface, u_int _num_hashes,
 /* ************************************ */
 
 Country* CountriesHash::get(const char *country_name, bool is_inline_call) {
-  u_int32_t hash = Utils::stringHash(country_name);
-
-  hash %= num_hashes;
+  u_int32_t hash = bucketId(Utils::stringHash(country_name));
 
   if(table[hash] == NULL) {
     return(NULL);
@@ -24,7 +24,8 @@
 /* *************************************** */
 
 Country::Country(NetworkInterface *_iface, const char *country) : GenericHashEntry(_iface), dirstats(_iface, 0) {
-  country_name = strdup(country);
+  if((country_name = ntop->getGeolocation()->internString(country)) == NULL)
+    country_name = UNKNOWN_COUNTRY;
 
 #ifdef COUNTRY_DEBUG
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Created Country %s", country_name);
@@ -46,8 +47,6 @@ Country::~Country() {
 #ifdef COUNTRY_DEBUG
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Deleted Country %s", country_name);
 #endif
-
-  free(country_name);
 }
 
 /* *************************************** */
@@ -78,7 +77,8 @@ void Country::lua(lua_State* vm, DetailsLevel details_level, bool asListElement)
 /* *************************************** */
 
 bool Country::equal(const char *country) {
-  return(strcmp(country_name, country) == 0);
+  /* Names are interned: comparing pointers is usually enough */
+  return((country_name == country) || (strcmp(country_name, country) == 0));
 }
 
 /* *************************************** */
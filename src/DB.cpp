@@ -29,8 +29,9 @@ DB::DB(NetworkInterface *_iface) {
 
   lastUpdateTime.tv_sec = 0, lastUpdateTime.tv_usec = 0;
   droppedFlows = queueDroppedFlows = exportedFlows = lastExportedFlows = 0;
+  lastDroppedFlows = 0;
   checkpointDroppedFlows = checkpointQueueDroppedFlows = checkpointExportedFlows = 0;
-  exportRate = 0;
+  exportRate = dropRate = 0;
 }
 
 /* ******************************************* */
@@ -48,6 +49,8 @@ void DB::lua(lua_State *vm, bool since_last_checkpoint) const {
 			   getNumDroppedFlows() - (since_last_checkpoint ? (checkpointDroppedFlows + checkpointQueueDroppedFlows) : 0));
   lua_push_float_table_entry(vm, "flow_export_rate",
 			   exportRate >= 0 ? exportRate : 0);
+  lua_push_float_table_entry(vm, "flow_export_drop_rate",
+			   dropRate >= 0 ? dropRate : 0);
 }
 
 /* ******************************************* */
@@ -69,10 +72,15 @@ void DB::updateStats(const struct timeval *tv) {
     float tdiffMsec = Utils::msTimevalDiff(tv, &lastUpdateTime);
     if(tdiffMsec >= 1000) { /* al least one second */
       u_int64_t diffFlows = exportedFlows - lastExportedFlows;
-      lastExportedFlows = exportedFlows;
+      u_int32_t dropped = getNumDroppedFlows();
 
+      lastExportedFlows = exportedFlows;
       exportRate = ((float)(diffFlows * 1000)) / tdiffMsec;
       if (exportRate < 0) exportRate = 0;
+
+      dropRate = ((float)((dropped - lastDroppedFlows) * 1000)) / tdiffMsec;
+      lastDroppedFlows = dropped;
+      if (dropRate < 0) dropRate = 0;
     }
   }
 
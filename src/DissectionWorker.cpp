@@ -0,0 +1,406 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+DissectionWorker::DissectionWorker(NetworkInterface *_shard, u_int32_t queue_len, u_int32_t snaplen) {
+  char buf[64];
+
+  shard = _shard;
+  dissectLoopCreated = terminating = false;
+  head = tail = 0;
+  num_enqueued = num_failed_enqueues = num_dissected = 0;
+
+  /* Room for queue_len full-sized packets, the ring is shared by shorter ones */
+  ring_size = Utils::pow2(queue_len * recordLen(snaplen));
+
+  /*
+    Records are 8-byte aligned so that the pcap header can be accessed directly.
+    Packets longer than the snaplen (e.g. offloaded frames) are kept up to a
+    quarter of the ring, so the ring always fits at least a couple of them.
+   */
+  max_caplen = ring_size / 4 - sizeof(struct pcap_pkthdr);
+
+  if((ring = (u_int8_t*)malloc(ring_size)) == NULL)
+    throw std::bad_alloc();
+
+  snprintf(buf, sizeof(buf), "dissection_%s", shard->get_name());
+  name = strdup(buf);
+}
+
+/* **************************************************** */
+
+DissectionWorker::~DissectionWorker() {
+  stopDissection();
+
+  if(ring) free(ring);
+  if(name) free(name);
+}
+
+/* **************************************************** */
+
+static inline u_int32_t fmix32(u_int32_t h) {
+  /* MurmurHash3 finalizer */
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+
+  return(h);
+}
+
+/* **************************************************** */
+
+/* Skips the link layer header: returns false when the datalink is not supported */
+static bool skipLinkLayer(int datalink_type, const struct pcap_pkthdr *h, const u_char *packet,
+			  u_int16_t *eth_type, u_int32_t *offset) {
+  u_int32_t caplen = h->caplen;
+
+  switch(datalink_type) {
+  case DLT_EN10MB:
+    if(caplen < 14) return(false);
+    *eth_type = (packet[12] << 8) + packet[13], *offset = 14;
+
+    /* Skip (possibly stacked) VLAN tags */
+    while(((*eth_type == 0x8100 /* 802.1Q */) || (*eth_type == 0x88A8 /* 802.1ad */))
+	  && (caplen >= *offset + 4)) {
+      *eth_type = (packet[*offset + 2] << 8) + packet[*offset + 3];
+      *offset += 4;
+    }
+    break;
+
+#ifdef DLT_RAW
+  case DLT_RAW:
+#endif
+#ifdef DLT_IPV4
+  case DLT_IPV4:
+#endif
+#ifdef DLT_IPV6
+  case DLT_IPV6:
+#endif
+    if(caplen < 1) return(false);
+    *eth_type = ((packet[0] >> 4) == 6) ? ETHERTYPE_IPV6 : ETHERTYPE_IP, *offset = 0;
+    break;
+
+  default:
+    return(false);
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
+u_int32_t DissectionWorker::packetHash(int datalink_type, const struct pcap_pkthdr *h, const u_char *packet) {
+  u_int32_t caplen = h->caplen, offset, addr_hash = 0, port_hash = 0;
+  u_int16_t eth_type;
+  u_int8_t l4_proto;
+  bool has_ports = false;
+
+  if(!skipLinkLayer(datalink_type, h, packet, &eth_type, &offset))
+    return(0);
+
+  if(eth_type == ETHERTYPE_IP) {
+    u_int32_t src, dst, ip_len;
+    u_int16_t frag_off;
+
+    if(caplen < offset + 20) return(0);
+
+    ip_len = (packet[offset] & 0x0F) * 4;
+    l4_proto = packet[offset + 9];
+    frag_off = (packet[offset + 6] << 8) + packet[offset + 7];
+    memcpy(&src, &packet[offset + 12], sizeof(src));
+    memcpy(&dst, &packet[offset + 16], sizeof(dst));
+
+    /* XOR keeps the hash identical for both directions of the flow */
+    addr_hash = src ^ dst;
+
+    /* Fragments carry no ports past the first one: hash them on the addresses only */
+    if(((frag_off & 0x3FFF) == 0) && (ip_len >= 20))
+      offset += ip_len, has_ports = true;
+  } else if(eth_type == ETHERTYPE_IPV6) {
+    u_int32_t words[8];
+
+    if(caplen < offset + 40) return(0);
+
+    l4_proto = packet[offset + 6];
+    memcpy(words, &packet[offset + 8], sizeof(words));
+
+    for(u_int i = 0; i < 4; i++)
+      addr_hash ^= words[i] ^ words[i + 4];
+
+    offset += 40, has_ports = true;
+  } else
+    return(0);
+
+  if(has_ports
+     && ((l4_proto == IPPROTO_TCP) || (l4_proto == IPPROTO_UDP) || (l4_proto == 132 /* SCTP */))
+     && (caplen >= offset + 4)) {
+    u_int16_t sport = (packet[offset] << 8) + packet[offset + 1];
+    u_int16_t dport = (packet[offset + 2] << 8) + packet[offset + 3];
+
+    port_hash = sport ^ dport;
+  }
+
+  return(fmix32(addr_hash ^ (port_hash * 0x9E3779B1) ^ l4_proto));
+}
+
+/* **************************************************** */
+
+bool DissectionWorker::packetTuple(int datalink_type, const struct pcap_pkthdr *h, const u_char *packet,
+				   IpAddress *src_ip, IpAddress *dst_ip,
+				   u_int16_t *src_port, u_int16_t *dst_port, u_int8_t *l4_proto) {
+  u_int32_t caplen = h->caplen, offset;
+  u_int16_t eth_type;
+  bool has_ports = false;
+
+  if(!skipLinkLayer(datalink_type, h, packet, &eth_type, &offset))
+    return(false);
+
+  if(eth_type == ETHERTYPE_IP) {
+    u_int32_t src, dst, ip_len;
+    u_int16_t frag_off;
+
+    if(caplen < offset + 20) return(false);
+
+    ip_len = (packet[offset] & 0x0F) * 4;
+    *l4_proto = packet[offset + 9];
+    frag_off = (packet[offset + 6] << 8) + packet[offset + 7];
+    memcpy(&src, &packet[offset + 12], sizeof(src));
+    memcpy(&dst, &packet[offset + 16], sizeof(dst));
+    src_ip->set(src), dst_ip->set(dst);
+
+    if(((frag_off & 0x3FFF) == 0) && (ip_len >= 20))
+      offset += ip_len, has_ports = true;
+  } else if(eth_type == ETHERTYPE_IPV6) {
+    struct ndpi_in6_addr src, dst;
+
+    if(caplen < offset + 40) return(false);
+
+    *l4_proto = packet[offset + 6];
+    memcpy(&src, &packet[offset + 8], sizeof(src));
+    memcpy(&dst, &packet[offset + 24], sizeof(dst));
+    src_ip->set(&src), dst_ip->set(&dst);
+
+    offset += 40, has_ports = true;
+  } else
+    return(false);
+
+  *src_port = *dst_port = 0;
+
+  if(has_ports
+     && ((*l4_proto == IPPROTO_TCP) || (*l4_proto == IPPROTO_UDP) || (*l4_proto == 132 /* SCTP */))
+     && (caplen >= offset + 4)) {
+    *src_port = (packet[offset] << 8) + packet[offset + 1];
+    *dst_port = (packet[offset + 2] << 8) + packet[offset + 3];
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
+u_int32_t DissectionWorker::tupleHash(const IpAddress *a, u_int16_t a_port,
+				      const IpAddress *b, u_int16_t b_port, u_int8_t l4_proto) {
+  u_int32_t addr_hash = 0, port_hash = 0;
+
+  /* Same as packetHash(), with the addresses in network byte order and the ports in host byte order */
+  if(a->isIPv4() && b->isIPv4())
+    addr_hash = a->get_ipv4() ^ b->get_ipv4();
+  else if(a->get_ipv6() && b->get_ipv6()) {
+    u_int32_t words[8];
+
+    memcpy(&words[0], a->get_ipv6(), 16);
+    memcpy(&words[4], b->get_ipv6(), 16);
+
+    for(u_int i = 0; i < 4; i++)
+      addr_hash ^= words[i] ^ words[i + 4];
+  } else
+    return(0);
+
+  if((l4_proto == IPPROTO_TCP) || (l4_proto == IPPROTO_UDP) || (l4_proto == 132 /* SCTP */))
+    port_hash = a_port ^ b_port;
+
+  return(fmix32(addr_hash ^ (port_hash * 0x9E3779B1) ^ l4_proto));
+}
+
+/* **************************************************** */
+
+bool DissectionWorker::enqueue(const struct pcap_pkthdr *h, const u_char *packet) {
+  u_int32_t caplen = min_val(h->caplen, max_caplen);
+  u_int32_t rec_len = recordLen(caplen);
+  u_int32_t to_end = ring_size - (head & (ring_size - 1));
+  u_int32_t needed = (rec_len <= to_end) ? rec_len : (to_end + rec_len);
+  u_int32_t pos = head;
+  struct pcap_pkthdr *hdr;
+
+  if(ring_size - (head - tail) < needed) {
+    num_failed_enqueues++;
+    return(false); /* Ring full: the packet is accounted as dropped */
+  }
+
+  if(rec_len > to_end) {
+    /* Skip the end of the ring. Too short tails are skipped implicitly by the reader */
+    if(to_end >= sizeof(struct pcap_pkthdr))
+      recordHeader(pos)->caplen = DISSECTION_WORKER_WRAP_MARKER;
+
+    pos += to_end;
+  }
+
+  hdr = recordHeader(pos);
+  memcpy(hdr, h, sizeof(struct pcap_pkthdr));
+  hdr->caplen = caplen;
+  memcpy((u_char*)&hdr[1], packet, caplen);
+
+  /* Make sure the packet copy is visible before publishing the record */
+  __sync_synchronize();
+  head = pos + rec_len;
+  num_enqueued++;
+
+  /* Wake up the dissection thread, only if it is waiting */
+  packets_available.signalIfWaiting();
+
+  return(true);
+}
+
+/* **************************************************** */
+
+void DissectionWorker::dissectPackets() {
+  time_t last_purge = 0;
+
+  while(!terminating && !ntop->getGlobals()->isShutdown()) {
+    time_t now;
+
+    if(tail != head) {
+      u_int32_t to_end = ring_size - (tail & (ring_size - 1));
+      struct pcap_pkthdr *hdr;
+      u_int16_t p;
+      Host *srcHost = NULL, *dstHost = NULL;
+      Flow *flow = NULL;
+
+      __sync_synchronize();
+
+      hdr = recordHeader(tail);
+
+      if((to_end < sizeof(struct pcap_pkthdr)) || (hdr->caplen == DISSECTION_WORKER_WRAP_MARKER)) {
+	/* The next record starts at the beginning of the ring */
+	tail += to_end;
+	continue;
+      }
+
+      shard->dissectPacket(DUMMY_BRIDGE_INTERFACE_ID,
+			   true /* ingress: libpcap does not report the packet direction */,
+			   NULL, hdr, (const u_char*)&hdr[1], &p, &srcHost, &dstHost, &flow);
+
+      /* Read the length before releasing the record to the capture thread */
+      tail += recordLen(hdr->caplen);
+      num_dissected++;
+      continue;
+    }
+
+    now = time(NULL);
+
+    /*
+      No packets: purge idle entries from this thread, as the shard hash tables
+      are not locked when accessed by the dissection path
+    */
+    if(now != last_purge) {
+      shard->purgeIdle(now);
+      last_purge = now;
+    }
+
+#ifndef WIN32
+    struct timespec wait_expire;
+
+    /* Wait for at most 1s, so idle entries keep being purged and termination is noticed */
+    wait_expire.tv_sec = now + 1, wait_expire.tv_nsec = 0;
+
+    /* The capture thread only signals when we are parked: check the ring again once announced */
+    packets_available.prepareWait();
+
+    if(tail == head)
+      packets_available.timedWait(&wait_expire);
+
+    packets_available.cancelWait();
+#else
+    _usleep(100);
+#endif
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Terminated packet dissection for %s",
+			       shard->get_description());
+}
+
+/* **************************************************** */
+
+static void* dissectionLoop(void* ptr) {
+  DissectionWorker *w = (DissectionWorker*)ptr;
+
+  w->dissectPackets();
+  return(NULL);
+}
+
+/* **************************************************** */
+
+void DissectionWorker::startDissection() {
+  if(dissectLoopCreated) return;
+
+  pthread_create(&dissectLoop, NULL, dissectionLoop, (void*)this);
+  dissectLoopCreated = true;
+
+#ifdef __linux__
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "dissect ifid %u", shard->get_id());
+  pthread_setname_np(dissectLoop, buf);
+#endif
+}
+
+/* **************************************************** */
+
+void DissectionWorker::stopDissection() {
+  if(dissectLoopCreated) {
+    void *res;
+
+    terminating = true;
+    packets_available.signalIfWaiting();
+    pthread_join(dissectLoop, &res);
+    dissectLoopCreated = false;
+  }
+}
+
+/* **************************************************** */
+
+void DissectionWorker::lua(lua_State *vm) const {
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "num_failed_enqueues", num_failed_enqueues);
+  lua_push_uint64_table_entry(vm, "num_enqueued", num_enqueued);
+  lua_push_uint64_table_entry(vm, "num_dissected", num_dissected);
+  lua_push_uint64_table_entry(vm, "queue_depth", getQueueDepth());
+  lua_push_uint64_table_entry(vm, "queue_size_bytes", ring_size);
+  lua_push_uint64_table_entry(vm, "queue_fill_bytes", head - tail);
+  lua_pushstring(vm, name ? name : "");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
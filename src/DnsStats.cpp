@@ -178,6 +178,50 @@ void DnsStats::deserialize(json_object *o) {
 
 /* ******************************************* */
 
+void DnsStats::serializeStatsBinary(BinarySerializer *s, const struct dns_stats *stats) const {
+  const struct queries_breakdown *b = &stats->breakdown;
+  u_int32_t fields[] = { b->num_a, b->num_ns, b->num_cname, b->num_soa, b->num_ptr,
+			 b->num_mx, b->num_txt, b->num_aaaa, b->num_any, b->num_other };
+
+  s->putVarint(stats->num_queries.get());
+  s->putVarint(stats->num_replies_ok.get());
+  s->putVarint(stats->num_replies_error.get());
+
+  for(u_int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    s->putVarint(fields[i]);
+}
+
+/* ******************************************* */
+
+void DnsStats::deserializeStatsBinary(BinaryDeserializer *d, struct dns_stats *stats) {
+  struct queries_breakdown *b = &stats->breakdown;
+  u_int32_t *fields[] = { &b->num_a, &b->num_ns, &b->num_cname, &b->num_soa, &b->num_ptr,
+			  &b->num_mx, &b->num_txt, &b->num_aaaa, &b->num_any, &b->num_other };
+
+  stats->num_queries.setInitialValue((u_int32_t)d->getVarint());
+  stats->num_replies_ok.setInitialValue((u_int32_t)d->getVarint());
+  stats->num_replies_error.setInitialValue((u_int32_t)d->getVarint());
+
+  for(u_int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    *fields[i] = (u_int32_t)d->getVarint();
+}
+
+/* ******************************************* */
+
+void DnsStats::serializeBinary(BinarySerializer *s) const {
+  serializeStatsBinary(s, &sent_stats);
+  serializeStatsBinary(s, &rcvd_stats);
+}
+
+/* ******************************************* */
+
+void DnsStats::deserializeBinary(BinaryDeserializer *d) {
+  deserializeStatsBinary(d, &sent_stats);
+  deserializeStatsBinary(d, &rcvd_stats);
+}
+
+/* ******************************************* */
+
 json_object* DnsStats::getStatsJSONObject(struct dns_stats *stats) {
   json_object *my_object = json_object_new_object();
   json_object *my_stats = json_object_new_object();
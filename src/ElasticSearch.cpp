@@ -23,51 +23,336 @@
 
 #ifndef HAVE_NEDGE
 
+/* Only what is needed to tell which documents failed is returned by _bulk */
+#define ES_BULK_FILTER_PATH "?filter_path=errors,items.*.status,items.*.error.type,items.*.error.reason"
+
 /* **************************************************** */
 
-static void* esLoop(void* ptr) {
-  Utils::setThreadName("ESLoop");
-  ElasticSearch *es = (ElasticSearch *) ptr;
-  es->pushEStemplate();  // sends ES ntopng template
-  es->indexESdata();
-  return(NULL);
+static void* writerLoop(void* ptr) {
+  ESBulkWriter *w = (ESBulkWriter*)ptr;
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "ESWriter%u", w->id);
+  Utils::setThreadName(buf);
+
+  return(w->es->writerLoop(w));
+}
+
+/* **************************************************** */
+
+static size_t discardResponse(void *ptr, size_t size, size_t nmemb, void *userdata) {
+  return(size * nmemb);
+}
+
+/* **************************************************** */
+
+static size_t storeResponse(void *ptr, size_t size, size_t nmemb, void *userdata) {
+  ESBulkWriter *w = (ESBulkWriter*)userdata;
+  size_t len = size * nmemb, room = ES_BULK_RESPONSE_LEN - 1 - w->response_len;
+
+  if(len > room)
+    len = room, w->response_truncated = true;
+
+  memcpy(&w->response[w->response_len], ptr, len);
+  w->response_len += len;
+  w->response[w->response_len] = '\0';
+
+  return(size * nmemb);
+}
+
+/* **************************************************** */
+
+/*
+  Returns the number of documents of a _bulk request that have not been indexed,
+  copying the reason of the first failure to error. Documents whose status is
+  not in the (truncated) response are accounted as failed.
+ */
+static u_int32_t countBulkFailures(const char *response, u_int32_t num_docs, char *error, u_int error_len) {
+  const char *p;
+  u_int32_t num_items = 0, num_failed = 0;
+
+  error[0] = '\0';
+
+  if(strstr(response, "\"errors\":false"))
+    return(0);
+
+  if((p = strstr(response, "\"items\"")) == NULL)
+    return(num_docs);
+
+  while((p = strstr(p, "\"status\":")) != NULL) {
+    int status = atoi(&p[9]);
+
+    num_items++;
+
+    if((status < 200) || (status > 299)) {
+      num_failed++;
+
+      if(error[0] == '\0') {
+	const char *reason = strstr(p, "\"reason\":\"");
+
+	snprintf(error, error_len, "status %d", status);
+
+	if(reason) {
+	  const char *end;
+
+	  reason += 10;
+	  end = strchr(reason, '"');
+	  snprintf(error, error_len, "status %d: %.*s", status,
+		   (int)(end ? (end - reason) : strlen(reason)), reason);
+	}
+      }
+    }
+
+    p += 9;
+  }
+
+  if(num_items < num_docs)
+    num_failed += num_docs - num_items;
+
+  return(num_failed);
 }
 
 /* **************************************** */
 
 ElasticSearch::ElasticSearch(NetworkInterface *_iface) : DB(_iface) {
+  const char *es_url = ntop->getPrefs()->get_es_url();
+  size_t url_len = es_url ? strlen(es_url) : 0;
+  char auth[128];
+
   snprintf(es_version, sizeof(es_version), "%c", '0');
-  num_queued_elems = 0;
-  head = NULL;
-  tail = NULL;
   reportDrops = false;
+  current = NULL, num_queued_flows = 0, template_pushed = false;
+  bulk_action[0] = '\0', bulk_action_len = 0, bulk_action_time = 0;
+  num_writers = next_writer = 0;
+  memset(buffers, 0, sizeof(buffers));
+  memset(writers, 0, sizeof(writers));
 
   if(!(es_template_push_url = (char*)malloc(MAX_PATH))
-     || !(es_version_query_url = (char*)malloc(MAX_PATH)))
+     || !(es_version_query_url = (char*)malloc(MAX_PATH))
+     || !(es_bulk_base_url = (char*)malloc(MAX_PATH)))
     throw "Not enough memory";
 
   es_template_push_url[0] = '\0', es_version_query_url[0] = '\0';
   snprintf(es_template_push_url, MAX_PATH, "%s/_template/ntopng_template", ntop->getPrefs()->get_es_host());
   snprintf(es_version_query_url, MAX_PATH, "%s/", ntop->getPrefs()->get_es_host());
+
+  /* http://localhost:9200/_bulk -> http://localhost:9200/ as the index is added to the bulk URL */
+  if((url_len >= 5) && !strcmp(&es_url[url_len - 5], "_bulk"))
+    url_len -= 5;
+  snprintf(es_bulk_base_url, MAX_PATH, "%.*s%s", (int)url_len, es_url ? es_url : "",
+	   (url_len > 0) && (es_url[url_len - 1] == '/') ? "" : "/");
+
+  for(u_int i = 0; i < ES_NUM_BULK_BUFFERS; i++) {
+    if((buffers[i].data = (char*)malloc(ES_BULK_BUFFER_SIZE)) == NULL)
+      throw "Not enough memory";
+  }
+
+  snprintf(auth, sizeof(auth), "%s:%s",
+	   ntop->getPrefs()->get_es_user() ? ntop->getPrefs()->get_es_user() : "",
+	   ntop->getPrefs()->get_es_pwd()  ? ntop->getPrefs()->get_es_pwd()  : "");
+
+  for(u_int8_t i = 0; i < ntop->getPrefs()->get_num_es_writers(); i++) {
+    ESBulkWriter *w;
+    char name[32];
+
+    if((w = (ESBulkWriter*)calloc(1, sizeof(ESBulkWriter))) == NULL)
+      break;
+
+    w->es = this, w->id = i;
+
+    /* Room for all the buffers, which move from a writer to another */
+    snprintf(name, sizeof(name), "esReadyBuffers_%u", i);
+    w->ready = new (std::nothrow) SPSCQueue<ESBulkBuffer*>(2 * ES_NUM_BULK_BUFFERS, name);
+    snprintf(name, sizeof(name), "esAvailableBuffers_%u", i);
+    w->available = new (std::nothrow) SPSCQueue<ESBulkBuffer*>(2 * ES_NUM_BULK_BUFFERS, name);
+
+    if(!w->ready || !w->available || !(w->curl = curl_easy_init())) {
+      if(w->ready)     delete w->ready;
+      if(w->available) delete w->available;
+      free(w);
+      break;
+    }
+
+    if(auth[1] != '\0' /* Not just ":" */) {
+      curl_easy_setopt(w->curl, CURLOPT_USERPWD, auth);
+      curl_easy_setopt(w->curl, CURLOPT_HTTPAUTH, (long)CURLAUTH_BASIC);
+    }
+
+    if(!strncmp(es_bulk_base_url, "https", 5)) {
+      curl_easy_setopt(w->curl, CURLOPT_SSL_VERIFYPEER, 0L);
+      curl_easy_setopt(w->curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+
+    curl_easy_setopt(w->curl, CURLOPT_POST, 1L);
+
+    /* Without room for the response, documents failures can't be told apart */
+    if((w->response = (char*)malloc(ES_BULK_RESPONSE_LEN)) != NULL) {
+      curl_easy_setopt(w->curl, CURLOPT_WRITEFUNCTION, storeResponse);
+      curl_easy_setopt(w->curl, CURLOPT_WRITEDATA, w);
+    } else
+      curl_easy_setopt(w->curl, CURLOPT_WRITEFUNCTION, discardResponse);
+
+    curl_easy_setopt(w->curl, CURLOPT_TIMEOUT, ES_BULK_POST_TIMEOUT);
+    curl_easy_setopt(w->curl, CURLOPT_NOSIGNAL, 1L);
+
+    w->headers = curl_slist_append(w->headers, "Content-Type: application/json");
+    w->headers = curl_slist_append(w->headers, "Expect:"); /* Disable 100-continue */
+    w->gzip_headers = curl_slist_append(w->gzip_headers, "Content-Type: application/json");
+    w->gzip_headers = curl_slist_append(w->gzip_headers, "Content-Encoding: gzip");
+    w->gzip_headers = curl_slist_append(w->gzip_headers, "Expect:");
+
+#ifdef HAVE_ZLIB
+    /* Fastest level: bulk bodies are highly redundant and we can't afford to fall behind */
+    if(deflateInit2(&w->zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16 /* gzip wrapper */,
+		    8, Z_DEFAULT_STRATEGY) == Z_OK) {
+      w->zs_inited = true;
+      w->gzip_buf_len = deflateBound(&w->zs, ES_BULK_BUFFER_SIZE);
+
+      if((w->gzip_buf = (char*)malloc(w->gzip_buf_len)) == NULL)
+	ntop->getTrace()->traceEvent(TRACE_WARNING, "[ES] Not enough memory: bulk requests won't be compressed");
+    }
+#endif
+
+    writers[num_writers++] = w;
+  }
+
+  /* Spread the buffers across the writers, which hand them back once posted */
+  for(u_int i = 0; (num_writers > 0) && (i < ES_NUM_BULK_BUFFERS); i++)
+    writers[i % num_writers]->available->enqueue(&buffers[i], true);
+
+  if(num_writers == 0)
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "[ES] Unable to create bulk writers: flows won't be exported");
 }
 
 /* **************************************** */
 
 ElasticSearch::~ElasticSearch() {
+  shutdown();
+
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    ESBulkWriter *w = writers[i];
+
+    curl_slist_free_all(w->headers);
+    curl_slist_free_all(w->gzip_headers);
+    curl_easy_cleanup(w->curl);
+#ifdef HAVE_ZLIB
+    if(w->zs_inited) deflateEnd(&w->zs);
+    if(w->gzip_buf)  free(w->gzip_buf);
+#endif
+    if(w->response)  free(w->response);
+    delete w->ready;
+    delete w->available;
+    free(w);
+  }
+
+  for(u_int i = 0; i < ES_NUM_BULK_BUFFERS; i++)
+    if(buffers[i].data) free(buffers[i].data);
+
   if(es_template_push_url) free(es_template_push_url);
   if(es_version_query_url) free(es_version_query_url);
+  if(es_bulk_base_url)     free(es_bulk_base_url);
+}
+
+/* **************************************** */
+
+/* Called by the flow dump thread only */
+ESBulkBuffer* ElasticSearch::getAvailableBuffer() {
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    ESBulkBuffer *b = writers[(next_writer + i) % num_writers]->available->dequeue();
+
+    if(b) {
+      b->len = 0, b->num_flows = 0;
+      return(b);
+    }
+  }
+
+  return(NULL);
 }
 
 /* **************************************** */
 
-bool ElasticSearch::dumpFlow(time_t when, Flow *f, char *msg) {
-  struct string_list *e;
-  bool rc = true;
+/* Called by the flow dump thread only. Buffers go to the least busy writer. */
+void ElasticSearch::enqueueBuffer(ESBulkBuffer *b) {
+  u_int8_t selected = next_writer % num_writers;
+
+  for(u_int8_t i = 1; i < num_writers; i++) {
+    u_int8_t id = (next_writer + i) % num_writers;
+
+    if(writers[id]->ready->getLength() < writers[selected]->ready->getLength())
+      selected = id;
+  }
+
+  next_writer = (selected + 1) % num_writers;
+
+  /* Queues have room for all the buffers: this can't fail */
+  writers[selected]->ready->enqueue(b, true);
+}
+
+/* **************************************** */
+
+/*
+  Flows are appended to the buffer being filled, which is swapped out of
+  current while in use. Writers can swap it out too, to post buffers that
+  are not filled in ES_BULK_MAX_DELAY seconds: as both sides put it back
+  with a compare-and-swap, the buffer is always owned by a single thread.
+
+  Every flow is preceded by an action line naming its index, so that a
+  buffer spanning the index rotation (e.g. midnight) fills both indexes.
+ */
+bool ElasticSearch::dumpFlow(time_t when, Flow *f, char *json) {
+  ESBulkBuffer *b, *expected = NULL;
+  u_int32_t json_len, action_len;
+  time_t now;
+
+  if(!json || (num_writers == 0))
+    return(false);
+
+  json_len = strlen(json);
+
+  if(sizeof(bulk_action) + json_len + 1 >= ES_BULK_BUFFER_SIZE)
+    return(false);
+
+  now = time(NULL);
+
+  if(iface->isView()) enqueue_lock.lock(__FILE__, __LINE__);
+
+  /* The index name only changes with the time, cache it for the current second */
+  if(now != bulk_action_time) {
+    char index_name[64];
+    struct tm tm_info;
+
+    strftime(index_name, sizeof(index_name), ntop->getPrefs()->get_es_index(), gmtime_r(&now, &tm_info));
+    bulk_action_len = snprintf(bulk_action, sizeof(bulk_action), "{\"index\":{\"_index\":\"%s\"}}\n", index_name);
+    bulk_action_len = min_val(bulk_action_len, sizeof(bulk_action) - 1);
+    bulk_action_time = now;
+  }
+
+  action_len = bulk_action_len;
+
+  b = current.exchange(NULL);
+
+  if(b && (b->num_flows > 0)
+     && ((b->len + action_len + json_len + 1 >= ES_BULK_BUFFER_SIZE)
+	 || (now >= b->first_flow + ES_BULK_MAX_DELAY))) {
+    enqueueBuffer(b);
+    b = NULL;
+  }
+
+  while(!b && !(b = getAvailableBuffer())
+	&& iface->read_from_pcap_dump() && isRunning()) {
+    /*
+      Don't drop flows read from pcap files, interrupting
+      the datapath is not an issue in this case
+    */
+    _usleep(1000);
+  }
+
+  if(!b) {
+    if(iface->isView()) enqueue_lock.unlock(__FILE__, __LINE__);
 
-  if(num_queued_elems >= ES_MAX_QUEUE_LEN) {
     if(!reportDrops) {
-      ntop->getTrace()->traceEvent(TRACE_WARNING, "[ES] Export queue too long [%d]: expect drops",
-				   num_queued_elems);
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "[ES] All the %u bulk buffers are in use: expect drops",
+				   ES_NUM_BULK_BUFFERS);
       reportDrops = true;
     }
 
@@ -78,114 +363,212 @@ bool ElasticSearch::dumpFlow(time_t when, Flow *f, char *msg) {
     return(false);
   }
 
-  listMutex.lock(__FILE__, __LINE__);
+  if(b->num_flows == 0)
+    b->first_flow = now;
 
-  e = (struct string_list*)calloc(1, sizeof(struct string_list));
-  if(e != NULL) {
-    e->str = strdup(msg), e->next = head;
+  memcpy(&b->data[b->len], bulk_action, action_len), b->len += action_len;
+  memcpy(&b->data[b->len], json, json_len), b->len += json_len;
+  b->data[b->len++] = '\n';
+  b->num_flows++, num_queued_flows++;
 
-    if(e->str) {
-      if(head)
-        head->prev = e;
-      head = e;
-      if(tail == NULL)
-	tail = e;
-      num_queued_elems++;
+  /* A writer may have put back a buffer in the meantime: post ours then */
+  if(!current.compare_exchange_strong(expected, b))
+    enqueueBuffer(b);
 
-      rc = true;
-    } else {
-      /* Out of memory */
-      free(e);
-      rc = false;
-    }
+  if(iface->isView()) enqueue_lock.unlock(__FILE__, __LINE__);
+
+  return(true);
+}
+
+/* **************************************** */
+
+/*
+  The index in the URL is only the default one, as each document names its
+  own index. Documents rejected by ElasticSearch are accounted as dropped.
+ */
+bool ElasticSearch::postBulk(ESBulkWriter *w, ESBulkBuffer *b) {
+  char url[MAX_PATH], index_name[64], error[128];
+  const char *body = b->data;
+  u_int32_t body_len = b->len, msec, num_failed;
+  struct curl_slist *headers = w->headers;
+  struct timeval begin, end;
+  struct tm tm_info;
+  long http_code = 0;
+  CURLcode res;
+
+  if(b->num_flows == 0)
+    return(true);
+
+  strftime(index_name, sizeof(index_name), ntop->getPrefs()->get_es_index(),
+	   gmtime_r(&b->first_flow, &tm_info));
+
+  if(es_version[0] >= '7')
+    snprintf(url, sizeof(url), "%s%s/_bulk%s", es_bulk_base_url, index_name, ES_BULK_FILTER_PATH);
+  else
+    snprintf(url, sizeof(url), "%s%s/%s/_bulk%s", es_bulk_base_url, index_name,
+	     atleast_version_6() ? (char*)"_doc" /* types no longer supported in 6 */ : ntop->getPrefs()->get_es_type(),
+	     ES_BULK_FILTER_PATH);
+
+#ifdef HAVE_ZLIB
+  if(w->gzip_buf && (deflateReset(&w->zs) == Z_OK)) {
+    w->zs.next_in = (Bytef*)b->data, w->zs.avail_in = b->len;
+    w->zs.next_out = (Bytef*)w->gzip_buf, w->zs.avail_out = w->gzip_buf_len;
+
+    if(deflate(&w->zs, Z_FINISH) == Z_STREAM_END)
+      body = w->gzip_buf, body_len = w->gzip_buf_len - w->zs.avail_out, headers = w->gzip_headers;
+  }
+#endif
+
+  curl_easy_setopt(w->curl, CURLOPT_URL, url);
+  curl_easy_setopt(w->curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(w->curl, CURLOPT_POSTFIELDS, body);
+  curl_easy_setopt(w->curl, CURLOPT_POSTFIELDSIZE, (long)body_len);
+
+  if(w->response)
+    w->response[0] = '\0', w->response_len = 0, w->response_truncated = false;
+
+  gettimeofday(&begin, NULL);
+  res = curl_easy_perform(w->curl);
+  gettimeofday(&end, NULL);
+
+  if(res == CURLE_OK)
+    curl_easy_getinfo(w->curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+  msec = (u_int32_t)(Utils::usecTimevalDiff(&end, &begin) / 1000);
+  w->num_bulks++, w->tot_bulk_msec += msec, w->last_bulk_msec = msec;
+  if(msec > w->max_bulk_msec) w->max_bulk_msec = msec;
+  w->bulk_bytes += b->len, w->sent_bytes += body_len;
+  num_queued_flows -= b->num_flows;
+
+  if((http_code < 200) || (http_code > 299)) {
+    /* Post failure */
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "[ES] POST request for %u flows (%u bytes) failed [%s][http return code: %ld]",
+				 b->num_flows, b->len,
+				 (res == CURLE_OK) ? "" : curl_easy_strerror(res), http_code);
+    w->num_failed_bulks++;
+    incNumDroppedFlows(b->num_flows);
+    return(false);
   }
 
-  listMutex.unlock(__FILE__, __LINE__);
+  /* A successful request can still carry failed documents */
+  num_failed = w->response ? countBulkFailures(w->response, b->num_flows, error, sizeof(error)) : 0;
 
-  return(rc);
+  if(num_failed > 0) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "[ES] %u/%u flows not indexed [%s]%s",
+				 num_failed, b->num_flows, error,
+				 w->response_truncated ? "[truncated response]" : "");
+    w->num_failed_docs += num_failed;
+    incNumDroppedFlows(num_failed);
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_INFO, "[ES] Sent %u flow(s) [%u/%u bytes][%u msec]",
+			       b->num_flows, body_len, b->len, msec);
+  incNumExportedFlows(b->num_flows - num_failed);
+
+  return(true);
 }
 
 /* **************************************** */
 
-void ElasticSearch::startLoop() {
-  if(ntop->getPrefs()->do_dump_flows_on_es())
-    pthread_create(&esThreadLoop, NULL, esLoop, (void*)this);
-}
+void* ElasticSearch::writerLoop(ESBulkWriter *w) {
+  /* The template must be in place before any index is created */
+  if(w->id == 0) {
+    pushEStemplate();  // sends ES ntopng template
+    template_pushed = true;
+  } else {
+    while(!template_pushed && isRunning())
+      _usleep(100000);
+  }
 
+  while(isRunning() || w->ready->isNotEmpty()) {
+    ESBulkBuffer *b = w->ready->dequeue();
 
-/* **************************************** */
+    if(!b && ((b = current.exchange(NULL)) != NULL)) {
+      /* Nothing else to post: check if the buffer being filled has been waiting for too long */
+      ESBulkBuffer *expected = NULL;
+
+      if(((b->num_flows == 0) || (time(NULL) < b->first_flow + ES_BULK_MAX_DELAY))
+	 && current.compare_exchange_strong(expected, b))
+	b = NULL; /* Not yet, put it back */
+    }
+
+    if(b) {
+      if(!postBulk(w, b) && isRunning())
+	sleep(1);
+
+      w->available->enqueue(b, true);
+    } else
+      w->ready->wait();
+  }
+
+  return(NULL);
+}
 
-void ElasticSearch::indexESdata() {
-  const u_int min_buffered_flows = 8;
-  time_t last_dump = time(0);
-  char *postbuf = (char*) malloc(ES_BULK_BUFFER_SIZE);
+/* **************************************** */
 
-  if(!postbuf) {
-    ntop->getTrace()->traceEvent(TRACE_ERROR, "Cannot allocate ES bulk buffer");
+void ElasticSearch::startLoop() {
+  if(!ntop->getPrefs()->do_dump_flows_on_es())
     return;
+
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    if(pthread_create(&writers[i]->thread, NULL, ::writerLoop, (void*)writers[i]) == 0)
+      writers[i]->thread_created = true;
   }
+}
 
-  while(!ntop->getGlobals()->isShutdown() && isRunning()) {
-    time_t now = time(0);
-
-    if((num_queued_elems >= min_buffered_flows)
-       || ((num_queued_elems > 0) && (now >= last_dump + ES_BULK_MAX_DELAY))) {
-      u_int len, num_flows;
-      char index_name[64], header[256];
-      struct tm* tm_info;
-      struct timeval tv;
-      time_t t;
-      HTTPTranferStats stats;
-
-      gettimeofday(&tv, NULL);
-      t = tv.tv_sec;
-      tm_info = gmtime(&t);
-
-      strftime(index_name, sizeof(index_name), ntop->getPrefs()->get_es_index(), tm_info);
-
-      snprintf(header, sizeof(header),
-	       "{\"index\": {\"_type\": \"%s\", \"_index\": \"%s\"}}",
-	       atleast_version_6() ? (char*)"_doc" /* types no longer supported in 6 */ : ntop->getPrefs()->get_es_type(),
-	       index_name);
-      len = 0, num_flows = 0;
-
-      listMutex.lock(__FILE__, __LINE__);
-      for(u_int i=0; (i < num_queued_elems) && (len <= ES_BULK_BUFFER_SIZE); i++) {
-        struct string_list *prev;
-        prev = tail->prev;
-        len += snprintf(&postbuf[len], ES_BULK_BUFFER_SIZE-len, "%s\n%s\n", header, tail->str), num_flows++;
-        free(tail->str);
-        free(tail);
-        tail = prev, num_queued_elems--;
-
-        if(num_queued_elems == 0)
-	  head = NULL;
-      } /* for */
-
-      listMutex.unlock(__FILE__, __LINE__);
-      postbuf[len] = '\0';
-
-      ntop->getTrace()->traceEvent(TRACE_INFO, "ES: Buffered request with %d flows (%d bytes)", num_flows, len);
-
-      if(!Utils::postHTTPJsonData(ntop->getPrefs()->get_es_user(),
-				  ntop->getPrefs()->get_es_pwd(),
-				  ntop->getPrefs()->get_es_url(),
-				  postbuf, 0, &stats)) {
-	/* Post failure */
-	ntop->getTrace()->traceEvent(TRACE_ERROR, "ES: POST request for %d flows (%d bytes) failed", num_flows, len);
-	incNumDroppedFlows(num_flows);
-	sleep(1);
-      } else {
-	ntop->getTrace()->traceEvent(TRACE_INFO, "Sent %u flow(s) to ES", num_flows);
-	incNumExportedFlows(num_flows);
+/* **************************************** */
+
+/* Called once the flow dump thread has terminated */
+void ElasticSearch::shutdown() {
+  if(running) {
+    ESBulkBuffer *b = current.exchange(NULL);
+    void *res;
+
+    /* Post the flows of the buffer being filled too */
+    if(b && (b->num_flows > 0) && (num_writers > 0))
+      enqueueBuffer(b);
+
+    DB::shutdown();
+
+    for(u_int8_t i = 0; i < num_writers; i++) {
+      if(writers[i]->thread_created) {
+	pthread_join(writers[i]->thread, &res);
+	writers[i]->thread_created = false;
       }
+    }
+  }
+}
 
-      last_dump = now;
-    } else
-      sleep(1);
-  } /* while */
+/* **************************************** */
+
+void ElasticSearch::lua(lua_State *vm, bool since_last_checkpoint) const {
+  u_int64_t num_bulks = 0, num_failed_bulks = 0, num_failed_docs = 0, tot_bulk_msec = 0, bulk_bytes = 0, sent_bytes = 0;
+  u_int32_t max_bulk_msec = 0, num_ready = 0, num_available = 0;
+
+  DB::lua(vm, since_last_checkpoint);
+
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    ESBulkWriter *w = writers[i];
+
+    num_bulks += w->num_bulks, num_failed_bulks += w->num_failed_bulks, num_failed_docs += w->num_failed_docs;
+    tot_bulk_msec += w->tot_bulk_msec, max_bulk_msec = max_val(max_bulk_msec, w->max_bulk_msec);
+    bulk_bytes += w->bulk_bytes, sent_bytes += w->sent_bytes;
+    num_ready += w->ready->getLength(), num_available += w->available->getLength();
+  }
 
-  free(postbuf);
+  lua_push_uint64_table_entry(vm, "flow_export_queued", num_queued_flows);
+  lua_push_uint64_table_entry(vm, "flow_export_batches", num_bulks);
+  lua_push_uint64_table_entry(vm, "es_num_writers", num_writers);
+  lua_push_uint64_table_entry(vm, "es_bulk_buffers", ES_NUM_BULK_BUFFERS);
+  lua_push_uint64_table_entry(vm, "es_bulk_buffers_ready", num_ready);
+  lua_push_float_table_entry(vm, "es_queue_fill_pct",
+			     (num_available < ES_NUM_BULK_BUFFERS) ? ((ES_NUM_BULK_BUFFERS - num_available) * 100.) / ES_NUM_BULK_BUFFERS : 0);
+  lua_push_uint64_table_entry(vm, "es_bulk_failures", num_failed_bulks);
+  lua_push_uint64_table_entry(vm, "es_failed_documents", num_failed_docs);
+  lua_push_float_table_entry(vm, "es_bulk_avg_msec", num_bulks ? ((float)tot_bulk_msec) / num_bulks : 0);
+  lua_push_uint64_table_entry(vm, "es_bulk_max_msec", max_bulk_msec);
+  lua_push_uint64_table_entry(vm, "es_bulk_bytes", bulk_bytes);
+  lua_push_uint64_table_entry(vm, "es_sent_bytes", sent_bytes);
 }
 
 /* **************************************** */
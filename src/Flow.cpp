@@ -63,7 +63,7 @@ Flow::Flow(NetworkInterface *_iface,
   marker = MARKER_NO_ACTION;
 #endif
 
-  icmp_info = _icmp_info ? new (std::nothrow) ICMPinfo(*_icmp_info) : NULL;
+  icmp_info = _icmp_info ? MemoryPool::create(iface->getICMPinfoPool(), *_icmp_info) : NULL;
   custom_flow_info = NULL;
   ndpiFlow = NULL, cli_id = srv_id = NULL;
   cli_ebpf = srv_ebpf = NULL;
@@ -105,7 +105,7 @@ Flow::Flow(NetworkInterface *_iface,
     cli_host->incCliContactedHosts(_srv_ip);
     cli_host->incCliContactedPorts(_srv_port);
   } else { /* Client host has not been allocated, let's keep the info in an IpAddress */
-    if((cli_ip_addr = new (std::nothrow) IpAddress(*_cli_ip)))
+    if((cli_ip_addr = MemoryPool::create(iface->getIpAddressesPool(), *_cli_ip)))
       cli_ip_addr->reloadBlacklist(iface->get_ndpi_struct());
   }
 
@@ -119,7 +119,7 @@ Flow::Flow(NetworkInterface *_iface,
     srv_host->incSrvHostContacts(_cli_ip);
     srv_host->incSrvPortsContacts(_cli_port);
   } else { /* Server host has not been allocated, let's keep the info in an IpAddress */
-    if((srv_ip_addr = new (std::nothrow) IpAddress(*_srv_ip)))
+    if((srv_ip_addr = MemoryPool::create(iface->getIpAddressesPool(), *_srv_ip)))
       srv_ip_addr->reloadBlacklist(iface->get_ndpi_struct());
   }
 
@@ -156,8 +156,8 @@ Flow::Flow(NetworkInterface *_iface,
   memset(&clientNwLatency, 0, sizeof(clientNwLatency)), memset(&serverNwLatency, 0, sizeof(serverNwLatency));
 
   if(iface->isPacketInterface() && !iface->isSampledTraffic()) {
-    cli2srvPktTime = new (std::nothrow) InterarrivalStats();
-    srv2cliPktTime = new (std::nothrow) InterarrivalStats();
+    cli2srvPktTime = MemoryPool::create<InterarrivalStats>(iface->getInterarrivalPool());
+    srv2cliPktTime = MemoryPool::create<InterarrivalStats>(iface->getInterarrivalPool());
     entropy.c2s = ndpi_alloc_data_analysis(256);
     entropy.s2c = ndpi_alloc_data_analysis(256);
   } else {
@@ -272,7 +272,7 @@ Flow::~Flow() {
   }
 
   if(!cli_host && cli_ip_addr) /* Dynamically allocated only when cli_host was NULL in Flow constructor (viewed interfaces) */
-    delete cli_ip_addr;
+    MemoryPool::dispose(cli_ip_addr);
 
   if(srv_u) {
     srv_u->decUses(); /* Decrease the number of uses */
@@ -287,7 +287,7 @@ Flow::~Flow() {
   }
 
   if(!srv_host && srv_ip_addr) /* Dynamically allocated only when srv_host was NULL in Flow constructor (viewed interfaces) */
-    delete srv_ip_addr;
+    MemoryPool::dispose(srv_ip_addr);
 
   /*
     Perform other operations to decrease counters increased by flow user script hooks (we're in the same thread)
@@ -320,8 +320,8 @@ Flow::~Flow() {
   if(cli_ebpf) delete cli_ebpf;
   if(srv_ebpf) delete srv_ebpf;
 
-  if(cli2srvPktTime) delete cli2srvPktTime;
-  if(srv2cliPktTime) delete srv2cliPktTime;
+  MemoryPool::dispose(cli2srvPktTime);
+  MemoryPool::dispose(srv2cliPktTime);
 
   if(entropy.c2s) ndpi_free_data_analysis(entropy.c2s);
   if(entropy.s2c) ndpi_free_data_analysis(entropy.s2c);
@@ -365,7 +365,7 @@ Flow::~Flow() {
     free(packet_payload_match.payload);
 
   freeDPIMemory();
-  if(icmp_info) delete(icmp_info);
+  MemoryPool::dispose(icmp_info);
   if(external_alert) free(external_alert);
   if(alert_status_info) free(alert_status_info);
   if(alert_status_info_shadow) free(alert_status_info_shadow);
@@ -2383,13 +2383,9 @@ bool Flow::hasRisks() const {
 /* *************************************** */
 
 u_int32_t Flow::key() {
-  u_int32_t k = cli_port + srv_port + vlanId + protocol;
-
-  if(get_cli_ip_addr()) k += get_cli_ip_addr()->key();
-  if(get_srv_ip_addr()) k += get_srv_ip_addr()->key();
-  if(icmp_info) k += icmp_info->key();
-
-  return(k);
+  return(Utils::flowHash(get_cli_ip_addr() ? get_cli_ip_addr()->key() : 0, cli_port,
+			 get_srv_ip_addr() ? get_srv_ip_addr()->key() : 0, srv_port,
+			 vlanId, protocol, icmp_info ? icmp_info->key() : 0));
 }
 
 /* *************************************** */
@@ -2398,12 +2394,9 @@ u_int32_t Flow::key(Host *_cli, u_int16_t _cli_port,
 		    Host *_srv, u_int16_t _srv_port,
 		    u_int16_t _vlan_id,
 		    u_int16_t _protocol) {
-  u_int32_t k = _cli_port + _srv_port + _vlan_id + _protocol;
-
-  if(_cli) k += _cli -> key();
-  if(_srv) k += _srv -> key();
-
-  return(k);
+  return(Utils::flowHash(_cli ? _cli->key() : 0, _cli_port,
+			 _srv ? _srv->key() : 0, _srv_port,
+			 _vlan_id, _protocol, 0));
 }
 
 /* *************************************** */
@@ -2474,6 +2467,33 @@ bool Flow::is_hash_entry_state_idle_transition_ready() const {
 
 /* *************************************** */
 
+/* Mirrors is_hash_entry_state_idle_transition_ready() */
+time_t Flow::get_idle_deadline() const {
+  time_t deadline = last_seen + iface->getFlowMaxIdle() + 1;
+
+#ifdef HAVE_NEDGE
+  if(iface->getIfType() == interface_type_NETFILTER)
+    return(last_seen + 1); /* Idleness is decided by netfilter: check at every round */
+#endif
+
+  if((iface->getIfType() != interface_type_ZMQ) && (protocol == IPPROTO_TCP)) {
+    u_int8_t tcp_flags = src2dst_tcp_flags | dst2src_tcp_flags;
+
+    if(tcp_flags & TH_FIN
+       || tcp_flags & TH_RST
+       || ((iface->isPacketInterface() || tcp_flags)
+	   && !isThreeWayHandshakeOK())) {
+      time_t early_deadline = max_val(last_seen + MAX_TCP_FLOW_IDLE, doNotExpireBefore) + 1;
+
+      deadline = min_val(deadline, early_deadline);
+    }
+  }
+
+  return(deadline);
+}
+
+/* *************************************** */
+
 void Flow::sumStats(nDPIStats *ndpi_stats, FlowStats *status_stats) {
   ndpi_protocol detected_protocol = get_detected_protocol();
 
@@ -2496,254 +2516,239 @@ void Flow::sumStats(nDPIStats *ndpi_stats, FlowStats *status_stats) {
 /* *************************************** */
 
 char* Flow::serialize(bool use_labels) {
-  json_object *my_object;
-  char *rsp = NULL;
+  JSONStreamWriter w;
+  char *rsp = serialize(&w, use_labels);
 
-  ntop->getPrefs()->set_json_symbolic_labels_format(use_labels);
+  return(rsp ? strdup(rsp) : NULL);
+}
 
-  my_object = flow2json();
+/* *************************************** */
 
-  if(my_object != NULL) {
-    /* JSON string */
-    rsp = strdup(json_object_to_json_string(my_object));
+char* Flow::serialize(JSONStreamWriter *w, bool use_labels) {
+  char *rsp;
 
-    ntop->getTrace()->traceEvent(TRACE_DEBUG, "Emitting Flow: %s", rsp);
+  w->reset();
+  flow2json(w, use_labels);
+  rsp = w->get();
+
+#if DEBUG_FLOW_JSON
+  {
+    json_object *my_object;
 
-    /* Free memory */
-    json_object_put(my_object);
+    ntop->getPrefs()->set_json_symbolic_labels_format(use_labels);
+
+    if((my_object = flow2json()) != NULL) {
+      const char *ref = json_object_to_json_string(my_object);
+
+      if(!rsp || strcmp(rsp, ref))
+	ntop->getTrace()->traceEvent(TRACE_WARNING, "Flow JSON mismatch\n%s\n%s", ref, rsp ? rsp : "");
+
+      json_object_put(my_object);
+    }
   }
+#endif
+
+  if(rsp)
+    ntop->getTrace()->traceEvent(TRACE_DEBUG, "Emitting Flow: %s", rsp);
 
   return(rsp);
 }
 
 /* *************************************** */
 
-json_object* Flow::flow2json() {
-  json_object *my_object;
-  char buf[64], jsonbuf[64], *c;
-  time_t t;
+/*
+  The fields of the dumped flows. The writer either streams them or, for
+  flow2json(), builds the equivalent json-c object.
+ */
+void Flow::flow2json(JSONStreamWriter *w, bool use_labels) {
+  char buf[64], *c;
   const IpAddress *cli_ip = get_cli_ip_addr(), *srv_ip = get_srv_ip_addr();
+  bool extended_json = ntop->getPrefs()->do_dump_extended_json();
 
-  if((my_object = json_object_new_object()) == NULL) return(NULL);
+  w->openObject();
 
   if(ntop->getPrefs()->do_dump_flows_on_es()
      || ntop->getPrefs()->do_dump_flows_on_ls()
      ) {
-    struct tm* tm_info;
-
-    t = last_seen;
-    tm_info = gmtime(&t);
-
-    /*
-      strftime in the VS2013 library and earlier are not C99-conformant,
-      as they do not accept that format-specifier: MSDN VS2013 strftime page
-
-      https://msdn.microsoft.com/en-us/library/fe06s4ak.aspx
-    */
-    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S.0Z", tm_info);
+    const char *tstamp = w->timestamp(last_seen);
 
     if(ntop->getPrefs()->do_dump_flows_on_ls()) {
       /*  Add current timestamp differently for Logstash, in case of delay
        *  Note: Logstash generates it's own @timestamp field on input
        */
-      json_object_object_add(my_object,"ntop_timestamp",json_object_new_string(buf));
+      w->addString("ntop_timestamp", tstamp);
     }
 
     if(ntop->getPrefs()->do_dump_flows_on_es()) {
-      json_object_object_add(my_object, "@timestamp", json_object_new_string(buf));
-      json_object_object_add(my_object, "type", json_object_new_string(ntop->getPrefs()->get_es_type()));
+      w->addString("@timestamp", tstamp);
+      w->addString("type", ntop->getPrefs()->get_es_type());
     }
-    /* json_object_object_add(my_object, "@version", json_object_new_int(1)); */
 
     // MAC addresses are set only when dumping to ES to optimize space consumption
     if(cli_host && cli_host->getMac() && !cli_host->getMac()->isNull())
-      json_object_object_add(my_object, Utils::jsonLabel(IN_SRC_MAC, "IN_SRC_MAC", jsonbuf, sizeof(jsonbuf)),
-			     json_object_new_string(Utils::formatMac(cli_host ? cli_host->get_mac() : NULL, buf, sizeof(buf))));
+      w->addString(w->label(IN_SRC_MAC, "IN_SRC_MAC", use_labels),
+		   Utils::formatMac(cli_host ? cli_host->get_mac() : NULL, buf, sizeof(buf)));
 
     if(srv_host && srv_host->getMac() && !srv_host->getMac()->isNull())
-      json_object_object_add(my_object, Utils::jsonLabel(OUT_DST_MAC, "OUT_DST_MAC", jsonbuf, sizeof(jsonbuf)),
-			     json_object_new_string(Utils::formatMac(srv_host ? srv_host->get_mac() : NULL, buf, sizeof(buf))));
+      w->addString(w->label(OUT_DST_MAC, "OUT_DST_MAC", use_labels),
+		   Utils::formatMac(srv_host ? srv_host->get_mac() : NULL, buf, sizeof(buf)));
   }
 
   if(cli_ip) {
-    if(cli_ip->isIPv4()) {
-      json_object_object_add(my_object, Utils::jsonLabel(IPV4_SRC_ADDR, "IPV4_SRC_ADDR", jsonbuf, sizeof(jsonbuf)),
-			     json_object_new_string(cli_ip->print(buf, sizeof(buf))));
-    } else if(cli_ip->isIPv6()) {
-      json_object_object_add(my_object, Utils::jsonLabel(IPV6_SRC_ADDR, "IPV6_SRC_ADDR", jsonbuf, sizeof(jsonbuf)),
-			     json_object_new_string(cli_ip->print(buf, sizeof(buf))));
-    }
+    if(cli_ip->isIPv4())
+      w->addString(w->label(IPV4_SRC_ADDR, "IPV4_SRC_ADDR", use_labels), cli_ip->print(buf, sizeof(buf)));
+    else if(cli_ip->isIPv6())
+      w->addString(w->label(IPV6_SRC_ADDR, "IPV6_SRC_ADDR", use_labels), cli_ip->print(buf, sizeof(buf)));
   }
 
   if(srv_ip) {
-    if(srv_ip->isIPv4()) {
-      json_object_object_add(my_object, Utils::jsonLabel(IPV4_DST_ADDR, "IPV4_DST_ADDR", jsonbuf, sizeof(jsonbuf)),
-			     json_object_new_string(srv_ip->print(buf, sizeof(buf))));
-    } else if(srv_ip->isIPv6()) {
-      json_object_object_add(my_object, Utils::jsonLabel(IPV6_DST_ADDR, "IPV6_DST_ADDR", jsonbuf, sizeof(jsonbuf)),
-			     json_object_new_string(srv_ip->print(buf, sizeof(buf))));
-    }
+    if(srv_ip->isIPv4())
+      w->addString(w->label(IPV4_DST_ADDR, "IPV4_DST_ADDR", use_labels), srv_ip->print(buf, sizeof(buf)));
+    else if(srv_ip->isIPv6())
+      w->addString(w->label(IPV6_DST_ADDR, "IPV6_DST_ADDR", use_labels), srv_ip->print(buf, sizeof(buf)));
   }
 
-  json_object_object_add(my_object, Utils::jsonLabel(SRC_TOS, "SRC_TOS", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int(getTOS(true)));
-  json_object_object_add(my_object, Utils::jsonLabel(DST_TOS, "DST_TOS", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int(getTOS(false)));
+  w->addInt(w->label(SRC_TOS, "SRC_TOS", use_labels), getTOS(true));
+  w->addInt(w->label(DST_TOS, "DST_TOS", use_labels), getTOS(false));
 
-  json_object_object_add(my_object, Utils::jsonLabel(L4_SRC_PORT, "L4_SRC_PORT", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int(get_cli_port()));
-  json_object_object_add(my_object, Utils::jsonLabel(L4_DST_PORT, "L4_DST_PORT", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int(get_srv_port()));
+  w->addInt(w->label(L4_SRC_PORT, "L4_SRC_PORT", use_labels), get_cli_port());
+  w->addInt(w->label(L4_DST_PORT, "L4_DST_PORT", use_labels), get_srv_port());
 
-  json_object_object_add(my_object, Utils::jsonLabel(PROTOCOL, "PROTOCOL", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int(protocol));
+  w->addInt(w->label(PROTOCOL, "PROTOCOL", use_labels), protocol);
 
   if(((get_packets_cli2srv() + get_packets_srv2cli()) > NDPI_MIN_NUM_PACKETS)
      || (ndpiDetectedProtocol.app_protocol != NDPI_PROTOCOL_UNKNOWN)) {
-    json_object_object_add(my_object, Utils::jsonLabel(L7_PROTO, "L7_PROTO", jsonbuf, sizeof(jsonbuf)),
-			   json_object_new_int(ndpiDetectedProtocol.app_protocol));
-    json_object_object_add(my_object, Utils::jsonLabel(L7_PROTO_NAME, "L7_PROTO_NAME", jsonbuf, sizeof(jsonbuf)),
-			   json_object_new_string(get_detected_protocol_name(buf, sizeof(buf))));
+    w->addInt(w->label(L7_PROTO, "L7_PROTO", use_labels), ndpiDetectedProtocol.app_protocol);
+    w->addString(w->label(L7_PROTO_NAME, "L7_PROTO_NAME", use_labels), get_detected_protocol_name(buf, sizeof(buf)));
   }
 
   if(protocol == IPPROTO_TCP)
-    json_object_object_add(my_object, Utils::jsonLabel(TCP_FLAGS, "TCP_FLAGS", jsonbuf, sizeof(jsonbuf)),
-			   json_object_new_int(src2dst_tcp_flags | dst2src_tcp_flags));
+    w->addInt(w->label(TCP_FLAGS, "TCP_FLAGS", use_labels), src2dst_tcp_flags | dst2src_tcp_flags);
 
-  json_object_object_add(my_object, Utils::jsonLabel(IN_PKTS, "IN_PKTS", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int64(get_partial_packets_cli2srv()));
-  json_object_object_add(my_object, Utils::jsonLabel(IN_BYTES, "IN_BYTES", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int64(get_partial_bytes_cli2srv()));
+  w->addInt64(w->label(IN_PKTS, "IN_PKTS", use_labels), get_partial_packets_cli2srv());
+  w->addInt64(w->label(IN_BYTES, "IN_BYTES", use_labels), get_partial_bytes_cli2srv());
 
-  json_object_object_add(my_object, Utils::jsonLabel(OUT_PKTS, "OUT_PKTS", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int64(get_partial_packets_srv2cli()));
-  json_object_object_add(my_object, Utils::jsonLabel(OUT_BYTES, "OUT_BYTES", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int64(get_partial_bytes_srv2cli()));
+  w->addInt64(w->label(OUT_PKTS, "OUT_PKTS", use_labels), get_partial_packets_srv2cli());
+  w->addInt64(w->label(OUT_BYTES, "OUT_BYTES", use_labels), get_partial_bytes_srv2cli());
 
-  json_object_object_add(my_object, Utils::jsonLabel(FIRST_SWITCHED, "FIRST_SWITCHED", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int((u_int32_t)get_partial_first_seen()));
-  json_object_object_add(my_object, Utils::jsonLabel(LAST_SWITCHED, "LAST_SWITCHED", jsonbuf, sizeof(jsonbuf)),
-			 json_object_new_int((u_int32_t)get_partial_last_seen()));
+  w->addInt(w->label(FIRST_SWITCHED, "FIRST_SWITCHED", use_labels), (u_int32_t)get_partial_first_seen());
+  w->addInt(w->label(LAST_SWITCHED, "LAST_SWITCHED", use_labels), (u_int32_t)get_partial_last_seen());
 
   if(json_info && json_object_object_length(json_info) > 0)
-    json_object_object_add(my_object, "json", json_object_get(json_info));
+    w->addRaw("json", json_object_to_json_string(json_info));
 
-  if(vlanId > 0) json_object_object_add(my_object,
-					Utils::jsonLabel(SRC_VLAN, "SRC_VLAN", jsonbuf, sizeof(jsonbuf)),
-					json_object_new_int(vlanId));
+  if(vlanId > 0)
+    w->addInt(w->label(SRC_VLAN, "SRC_VLAN", use_labels), vlanId);
 
   if(protocol == IPPROTO_TCP) {
-    json_object_object_add(my_object, Utils::jsonLabel(CLIENT_NW_LATENCY_MS, "CLIENT_NW_LATENCY_MS", jsonbuf, sizeof(jsonbuf)),
-			   json_object_new_double(toMs(&clientNwLatency)));
-    json_object_object_add(my_object, Utils::jsonLabel(SERVER_NW_LATENCY_MS, "SERVER_NW_LATENCY_MS", jsonbuf, sizeof(jsonbuf)),
-			   json_object_new_double(toMs(&serverNwLatency)));
+    w->addDouble(w->label(CLIENT_NW_LATENCY_MS, "CLIENT_NW_LATENCY_MS", use_labels), toMs(&clientNwLatency));
+    w->addDouble(w->label(SERVER_NW_LATENCY_MS, "SERVER_NW_LATENCY_MS", use_labels), toMs(&serverNwLatency));
   }
 
   c = cli_host ? cli_host->get_country(buf, sizeof(buf)) : NULL;
   if(c) {
-    json_object *location = json_object_new_array();
-
-    json_object_object_add(my_object, "SRC_IP_COUNTRY", json_object_new_string(c));
-    if(location && cli_host) {
-      float latitude, longitude;
-
-      cli_host->get_geocoordinates(&latitude, &longitude);
-      json_object_array_add(location, json_object_new_double(longitude));
-      json_object_array_add(location, json_object_new_double(latitude));
-      json_object_object_add(my_object, "SRC_IP_LOCATION", location);
-    }
+    float latitude, longitude;
+
+    w->addString("SRC_IP_COUNTRY", c);
+    cli_host->get_geocoordinates(&latitude, &longitude);
+    w->openArray("SRC_IP_LOCATION");
+    w->addDouble(longitude);
+    w->addDouble(latitude);
+    w->closeArray();
   }
 
   c = srv_host ? srv_host->get_country(buf, sizeof(buf)) : NULL;
   if(c) {
-    json_object *location = json_object_new_array();
-
-    json_object_object_add(my_object, "DST_IP_COUNTRY", json_object_new_string(c));
-    if(location && srv_host) {
-      float latitude, longitude;
-
-      srv_host->get_geocoordinates(&latitude, &longitude);
-      json_object_array_add(location, json_object_new_double(longitude));
-      json_object_array_add(location, json_object_new_double(latitude));
-      json_object_object_add(my_object, "DST_IP_LOCATION", location);
-    }
+    float latitude, longitude;
+
+    w->addString("DST_IP_COUNTRY", c);
+    srv_host->get_geocoordinates(&latitude, &longitude);
+    w->openArray("DST_IP_LOCATION");
+    w->addDouble(longitude);
+    w->addDouble(latitude);
+    w->closeArray();
   }
 
 #ifdef NTOPNG_PRO
 #ifndef HAVE_NEDGE
-  // Traffic profile information, if any
+  // Traffic profile information, if any. The extended JSON profile takes its place.
   if(trafficProfile && trafficProfile->getName())
-    json_object_object_add(my_object, "PROFILE", json_object_new_string(trafficProfile->getName()));
+    w->addString("PROFILE", extended_json ? get_profile_name() : trafficProfile->getName());
 #endif
 #endif
   if(ntop->getPrefs() && ntop->getPrefs()->get_instance_name())
-    json_object_object_add(my_object, "NTOPNG_INSTANCE_NAME",
-			   json_object_new_string(ntop->getPrefs()->get_instance_name()));
+    w->addString("NTOPNG_INSTANCE_NAME", ntop->getPrefs()->get_instance_name());
   if(iface && iface->get_name())
-    json_object_object_add(my_object, "INTERFACE", json_object_new_string(iface->get_name()));
+    w->addString("INTERFACE", iface->get_name());
 
   if(isDNS() && protos.dns.last_query)
-    json_object_object_add(my_object, "DNS_QUERY", json_object_new_string(protos.dns.last_query));
+    w->addString("DNS_QUERY", protos.dns.last_query);
 
   if(isHTTP()) {
     if(host_server_name && host_server_name[0] != '\0')
-      json_object_object_add(my_object, "HTTP_HOST", json_object_new_string(host_server_name));
+      w->addString("HTTP_HOST", host_server_name);
     if(protos.http.last_url && protos.http.last_url[0] != '0')
-      json_object_object_add(my_object, "HTTP_URL", json_object_new_string(protos.http.last_url));
+      w->addString("HTTP_URL", protos.http.last_url);
     if(protos.http.last_method != NDPI_HTTP_METHOD_UNKNOWN)
-      json_object_object_add(my_object, "HTTP_METHOD", json_object_new_string(ndpi_http_method2str(protos.http.last_method)));
+      w->addString("HTTP_METHOD", ndpi_http_method2str(protos.http.last_method));
     if(protos.http.last_return_code > 0)
-      json_object_object_add(my_object, "HTTP_RET_CODE", json_object_new_int((u_int32_t)protos.http.last_return_code));
+      w->addInt("HTTP_RET_CODE", (u_int32_t)protos.http.last_return_code);
   }
 
   if(bt_hash)
-    json_object_object_add(my_object, "BITTORRENT_HASH", json_object_new_string(bt_hash));
+    w->addString("BITTORRENT_HASH", bt_hash);
 
   if(isTLS() && protos.tls.client_requested_server_name)
-    json_object_object_add(my_object, "TLS_SERVER_NAME",
-			   json_object_new_string(protos.tls.client_requested_server_name));
+    w->addString("TLS_SERVER_NAME", protos.tls.client_requested_server_name);
 
 #ifdef HAVE_NEDGE
   if(iface && iface->is_bridge_interface())
-    json_object_object_add(my_object, "verdict.pass",
-			   json_object_new_boolean(isPassVerdict() ? (json_bool)1 : (json_bool)0));
+    w->addBool("verdict.pass", isPassVerdict());
 #endif
 
-  if(cli_ebpf) cli_ebpf->getJSONObject(my_object, true);
-  if(srv_ebpf) srv_ebpf->getJSONObject(my_object, false);
+  if(cli_ebpf) cli_ebpf->getJSON(w, true);
+  if(srv_ebpf) srv_ebpf->getJSON(w, false);
 
-  if(ntop->getPrefs()->do_dump_extended_json()) {
+  if(extended_json) {
     const char *info;
 
     /* Add items usually dumped on nIndex (useful for debugging) */
 
-    json_object_object_add(my_object, "FLOW_TIME", json_object_new_int(last_seen));
+    w->addInt("FLOW_TIME", last_seen);
 
     if(cli_ip) {
-      if (cli_ip->isIPv4()) {
-        json_object_object_add(my_object,
-          Utils::jsonLabel(IP_PROTOCOL_VERSION, "IP_PROTOCOL_VERSION", jsonbuf, sizeof(jsonbuf)),
-          json_object_new_int(4));
-      } else if(cli_ip->isIPv6()) {
-        json_object_object_add(my_object,
-          Utils::jsonLabel(IP_PROTOCOL_VERSION, "IP_PROTOCOL_VERSION", jsonbuf, sizeof(jsonbuf)),
-          json_object_new_int(6));
-      }
+      if(cli_ip->isIPv4())
+	w->addInt(w->label(IP_PROTOCOL_VERSION, "IP_PROTOCOL_VERSION", use_labels), 4);
+      else if(cli_ip->isIPv6())
+	w->addInt(w->label(IP_PROTOCOL_VERSION, "IP_PROTOCOL_VERSION", use_labels), 6);
     }
 
     info = getFlowInfo();
-    if (info)
-      json_object_object_add(my_object, "INFO", json_object_new_string(info));
+    if(info)
+      w->addString("INFO", info);
 
 #if defined(NTOPNG_PRO) && !defined(HAVE_NEDGE)
-    json_object_object_add(my_object, "PROFILE", json_object_new_string(get_profile_name()));
+    if(!(trafficProfile && trafficProfile->getName())) /* Otherwise already added above */
+      w->addString("PROFILE", get_profile_name());
 #endif
 
-    json_object_object_add(my_object, "INTERFACE_ID", json_object_new_int(iface->get_id()));
-    json_object_object_add(my_object, "STATUS", json_object_new_int((u_int8_t)getAlertedStatus()));
+    w->addInt("INTERFACE_ID", iface->get_id());
+    w->addInt("STATUS", (u_int8_t)getAlertedStatus());
   }
 
-  return(my_object);
+  w->closeObject();
+}
+
+/* *************************************** */
+
+/* The json-c document has the same fields of flow2json(JSONStreamWriter*), which builds it */
+json_object* Flow::flow2json() {
+  JSONStreamWriter w(64);
+
+  w.resetObject();
+  flow2json(&w, ntop->getPrefs()->json_labels_as_strings());
+
+  return(w.getObject());
 }
 
 /* *************************************** */
@@ -2939,6 +2944,102 @@ bool Flow::update_partial_traffic_stats_db_dump() {
 
 /* *************************************** */
 
+/* Custom protocols are written by name: their ids depend on the protocols file (see nDPIStats) */
+static void flow_put_ndpi_proto(NetworkInterface *iface, BinarySerializer *s, u_int16_t proto_id) {
+  s->putVarint(proto_id);
+
+  if(proto_id >= NDPI_MAX_SUPPORTED_PROTOCOLS)
+    s->putString(iface->get_ndpi_proto_name(proto_id));
+}
+
+/* *************************************** */
+
+static u_int16_t flow_get_ndpi_proto(NetworkInterface *iface, BinaryDeserializer *d, u_int64_t num_builtin) {
+  u_int64_t proto_id = d->getVarint();
+
+  if(proto_id >= num_builtin) {
+    char name[64];
+    int id;
+
+    d->getString(name, sizeof(name));
+    id = iface->get_ndpi_proto_id(name);
+
+    return((id > 0) ? id : NDPI_PROTOCOL_UNKNOWN /* No longer defined */);
+  } else if(num_builtin != NDPI_MAX_SUPPORTED_PROTOCOLS)
+    return(NDPI_PROTOCOL_UNKNOWN); /* Written by another nDPI version: ids differ */
+
+  return((u_int16_t)proto_id);
+}
+
+/* *************************************** */
+
+void Flow::serializeBinaryState(BinarySerializer *s) {
+  s->putVarint(NDPI_MAX_SUPPORTED_PROTOCOLS);
+  flow_put_ndpi_proto(iface, s, ndpiDetectedProtocol.master_protocol);
+  flow_put_ndpi_proto(iface, s, ndpiDetectedProtocol.app_protocol);
+  s->putVarint(ndpiDetectedProtocol.category);
+  s->putVarint(stats.get_cli2srv_packets()), s->putVarint(stats.get_cli2srv_bytes());
+  s->putVarint(stats.get_cli2srv_goodput_bytes());
+  s->putVarint(stats.get_srv2cli_packets()), s->putVarint(stats.get_srv2cli_bytes());
+  s->putVarint(stats.get_srv2cli_goodput_bytes());
+  s->putU8(src2dst_tcp_flags), s->putU8(dst2src_tcp_flags);
+  s->putU8((twh_ok ? 0x1 : 0) | (twh_over ? 0x2 : 0));
+  s->putString(host_server_name);
+}
+
+/* *************************************** */
+
+/* Called on a flow just created, before it is seen by the packet processing */
+bool Flow::restoreBinaryState(BinaryDeserializer *d) {
+  ndpi_protocol proto = ndpiUnknownProtocol;
+  u_int64_t cli2srv[3], srv2cli[3], num_builtin;
+  u_int num_protocols = iface->getNumnDPIProtocols();
+  u_int8_t twh;
+  char name[256];
+
+  num_builtin = d->getVarint();
+  proto.master_protocol = flow_get_ndpi_proto(iface, d, num_builtin);
+  proto.app_protocol = flow_get_ndpi_proto(iface, d, num_builtin);
+  proto.category = (ndpi_protocol_category_t)d->getVarint();
+  for(int i = 0; i < 3; i++) cli2srv[i] = d->getVarint();
+  for(int i = 0; i < 3; i++) srv2cli[i] = d->getVarint();
+  src2dst_tcp_flags = d->getU8(), dst2src_tcp_flags = d->getU8();
+  twh = d->getU8();
+  d->getString(name, sizeof(name));
+
+  if(d->hasFailed())
+    return(false);
+
+  if(proto.master_protocol >= num_protocols) proto.master_protocol = NDPI_PROTOCOL_UNKNOWN;
+  if(proto.app_protocol >= num_protocols)    proto.app_protocol = NDPI_PROTOCOL_UNKNOWN;
+
+  ndpiDetectedProtocol = proto;
+  /* Packet length samples are not kept: only set the totals */
+  stats.PartializableFlowTrafficStats::setStats(true,  cli2srv[0], cli2srv[1], cli2srv[2]);
+  stats.PartializableFlowTrafficStats::setStats(false, srv2cli[0], srv2cli[1], srv2cli[2]);
+  twh_ok = (twh & 0x1) ? true : false, twh_over = (twh & 0x2) ? true : false;
+  if(name[0] && !host_server_name) host_server_name = strdup(name);
+
+  /*
+    The dissection cannot resume in the middle of a flow: the restored protocol is final.
+    Host and interface protocol counters already include the flow, so processDetectedProtocol()
+    is not called. The protocol detected hooks (and their alerts) already ran before the
+    restart: the flow goes straight to the active state.
+  */
+  freeDPIMemory();
+  stats.setDetectedProtocol(&ndpiDetectedProtocol);
+  detection_completed = extra_dissection_completed = true;
+  set_hash_entry_state_flow_protocoldetected();
+  set_hash_entry_state_active();
+
+  /* The traffic dumped before the restart is not dumped again */
+  update_partial_traffic_stats_db_dump();
+
+  return(true);
+}
+
+/* *************************************** */
+
 void Flow::updatePacketStats(InterarrivalStats *stats,
 			     const struct timeval *when, bool update_iat) {
   if(stats)
@@ -3184,12 +3285,18 @@ void Flow::updateTcpFlags(const struct bpf_timeval *when,
   if((flags & TH_FIN) && (((src2dst_tcp_flags | dst2src_tcp_flags) & TH_FIN) != TH_FIN))
     iface->getTcpFlowStats()->incFin();
 
+  /* The first FIN/RST makes the flow expire earlier: reschedule its idle deadline */
+  bool closing = (flags & (TH_FIN|TH_RST)) && !((src2dst_tcp_flags | dst2src_tcp_flags) & (TH_FIN|TH_RST));
+
   /* The update below must be after the above check */
   if(src2dst_direction)
     src2dst_tcp_flags |= flags;
   else
     dst2src_tcp_flags |= flags;
 
+  if(closing && get_hash_table())
+    get_hash_table()->rearmIdle(this);
+
   if(cumulative_flags) {
     if(!twh_over) {
       if((src2dst_tcp_flags & (TH_SYN|TH_ACK)) == (TH_SYN|TH_ACK)
@@ -4992,7 +5099,7 @@ void Flow::lua_get_geoloc(lua_State *vm, bool client, bool coords, bool country_
 
 /* ***************************************************** */
 
-FlowLuaCallExecStatus Flow::performLuaCall(FlowLuaCall flow_lua_call, FlowAlertCheckLuaEngine *acle) {
+FlowLuaCallExecStatus Flow::performLuaCall(FlowLuaCall flow_lua_call, FlowAlertCheckLuaEngine *acle, FlowChecksExecutor *checks) {
   const char *lua_call_fn_name = NULL;
 
   if(flow_lua_call != flow_lua_call_idle
@@ -5037,6 +5144,10 @@ FlowLuaCallExecStatus Flow::performLuaCall(FlowLuaCall flow_lua_call, FlowAlertC
     return flow_lua_call_exec_status_not_executed_unknown_call;
   }
 
+  /* Run the native checks first: flow.lua only runs the remaining scripts and collects their status */
+  if(checks)
+    checks->execute(this, flow_lua_call, periodic_update_ctr);
+
   int num_args = 3;
 
   /* Call the function */
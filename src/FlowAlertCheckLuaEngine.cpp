@@ -85,6 +85,19 @@ void FlowAlertCheckLuaEngine::incSuccessfulPcalls(FlowLuaCall flow_lua_call) {
 
 /* ****************************************** */
 
+void FlowAlertCheckLuaEngine::setupNativeChecks(FlowChecksExecutor *checks) {
+  setFlowChecks(checks);
+
+  lua_getglobal(L, "setupNativeChecks"); /* Called function */
+
+  if(lua_isfunction(L, -1))
+    pcall(0 /* no arguments */, 0);
+  else
+    lua_pop(L, 1);
+}
+
+/* ****************************************** */
+
 void FlowAlertCheckLuaEngine::lua_stats_detail(lua_State *vm) const {
   lua_push_uint64_table_entry(vm, "num_skipped_idle", num_skipped_idle);
   lua_push_uint64_table_entry(vm, "num_skipped_periodic_update", num_skipped_periodic_update);
@@ -0,0 +1,84 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+FlowCheck::FlowCheck(const char *_key, ScriptCategory _category, u_int8_t _hooks,
+		     u_int8_t _l4_proto, u_int16_t _periodic_update_seconds) {
+  key = _key, category = _category, hooks = _hooks, l4_proto = _l4_proto;
+  periodic_update_divisor = max_val(_periodic_update_seconds / 30, 1);
+  enabled = false;
+  num_calls = num_triggered = 0, tot_ticks = max_ticks = 0;
+}
+
+/* **************************************************** */
+
+bool FlowCheck::wantsCall(Flow *f, FlowLuaCall flow_lua_call, u_int32_t periodic_update_ctr) const {
+  if(!enabled || !(hooks & (1 << flow_lua_call)))
+    return(false);
+
+  if(l4_proto && (f->get_protocol() != l4_proto))
+    return(false);
+
+  if((flow_lua_call == flow_lua_call_periodic_update)
+     && ((periodic_update_ctr % periodic_update_divisor) != 0))
+    return(false);
+
+  return(true);
+}
+
+/* **************************************************** */
+
+/*
+  Stats are merged into an existing entry (if any) so that
+  the checks of all the hook workers are reported together
+ */
+void FlowCheck::lua(lua_State *vm, ticks tps) const {
+  u_int64_t calls = num_calls, triggered = num_triggered;
+  float tot_usec = tps ? ((float)tot_ticks * 1000000) / tps : 0;
+  float max_usec = tps ? ((float)max_ticks * 1000000) / tps : 0;
+
+  lua_getfield(vm, -1, key);
+
+  if(lua_istable(vm, -1)) {
+    lua_getfield(vm, -1, "num_calls");        calls     += lua_tointeger(vm, -1); lua_pop(vm, 1);
+    lua_getfield(vm, -1, "num_triggered");    triggered += lua_tointeger(vm, -1); lua_pop(vm, 1);
+    lua_getfield(vm, -1, "tot_usec");         tot_usec  += lua_tonumber(vm, -1);  lua_pop(vm, 1);
+    lua_getfield(vm, -1, "max_usec");         max_usec   = max_val(max_usec, (float)lua_tonumber(vm, -1)); lua_pop(vm, 1);
+  }
+
+  lua_pop(vm, 1);
+
+  lua_newtable(vm);
+  lua_push_bool_table_entry(vm, "enabled", enabled);
+  lua_push_uint64_table_entry(vm, "num_calls", calls);
+  lua_push_uint64_table_entry(vm, "num_triggered", triggered);
+  lua_push_float_table_entry(vm, "tot_usec", tot_usec);
+  lua_push_float_table_entry(vm, "max_usec", max_usec);
+  lua_push_float_table_entry(vm, "avg_usec", calls ? tot_usec / calls : 0);
+
+  lua_pushstring(vm, key);
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
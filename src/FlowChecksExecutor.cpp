@@ -0,0 +1,159 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+FlowChecksExecutor::FlowChecksExecutor() {
+  num_checks = 0;
+  tps = Utils::gettickspersec();
+  alerted_status = status_normal, alerted_status_score = 0, alerted_check = NULL;
+  alerted_status_info[0] = '\0';
+
+  registerCheck(new (std::nothrow) BlacklistedFlowCheck());
+  registerCheck(new (std::nothrow) RemoteToRemoteFlowCheck());
+  registerCheck(new (std::nothrow) WebMiningFlowCheck());
+  registerCheck(new (std::nothrow) UDPUnidirectionalFlowCheck());
+}
+
+/* **************************************************** */
+
+FlowChecksExecutor::~FlowChecksExecutor() {
+  for(u_int8_t i = 0; i < num_checks; i++)
+    delete checks[i];
+}
+
+/* **************************************************** */
+
+void FlowChecksExecutor::registerCheck(FlowCheck *check) {
+  if(!check)
+    return;
+
+  if(num_checks >= MAX_NUM_FLOW_CHECKS) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Too many flow checks, skipping %s", check->getKey());
+    delete check;
+    return;
+  }
+
+  checks[num_checks++] = check;
+}
+
+/* **************************************************** */
+
+void FlowChecksExecutor::execute(Flow *f, FlowLuaCall flow_lua_call, u_int32_t periodic_update_ctr) {
+  alerted_status = status_normal, alerted_status_score = 0, alerted_check = NULL;
+  alerted_status_info[0] = '\0';
+
+  for(u_int8_t i = 0; i < num_checks; i++) {
+    FlowCheck *check = checks[i];
+    ticks begin;
+
+    if(!check->wantsCall(f, flow_lua_call, periodic_update_ctr))
+      continue;
+
+    begin = Utils::getticks();
+
+    switch(flow_lua_call) {
+    case flow_lua_call_protocol_detected:
+      check->protocolDetected(f, this);
+      break;
+    case flow_lua_call_periodic_update:
+      check->periodicUpdate(f, this);
+      break;
+    case flow_lua_call_idle:
+      check->flowEnd(f, this);
+      break;
+    default:
+      break;
+    }
+
+    check->updateStats(Utils::getticks() - begin);
+  }
+}
+
+/* **************************************************** */
+
+void FlowChecksExecutor::triggerStatus(Flow *f, FlowCheck *check, FlowStatus status,
+				       u_int16_t flow_score, u_int16_t cli_score, u_int16_t srv_score,
+				       const char *status_info) {
+  flow_score = min_val(flow_score, SCORE_MAX_SCRIPT_VALUE);
+  cli_score  = min_val(cli_score,  SCORE_MAX_SCRIPT_VALUE);
+  srv_score  = min_val(srv_score,  SCORE_MAX_SCRIPT_VALUE);
+
+  check->incTriggered();
+
+  /* Same logic of flow.triggerStatus(): keep the status with the highest score */
+  if((alerted_check == NULL)
+     || (flow_score > alerted_status_score)
+     || ((flow_score == alerted_status_score) && (status < alerted_status))) {
+    alerted_status = status, alerted_status_score = flow_score, alerted_check = check;
+    snprintf(alerted_status_info, sizeof(alerted_status_info), "%s", status_info ? status_info : "{}");
+  }
+
+  f->setStatus(status, flow_score, cli_score, srv_score, check->getKey(), check->getCategory());
+}
+
+/* **************************************************** */
+
+void FlowChecksExecutor::luaEnableChecks(lua_State *vm) {
+  bool is_table = lua_istable(vm, -1);
+
+  lua_newtable(vm);
+
+  for(u_int8_t i = 0; i < num_checks; i++) {
+    bool enabled = false;
+
+    if(is_table) {
+      lua_getfield(vm, -2, checks[i]->getKey());
+      enabled = lua_toboolean(vm, -1) ? true : false;
+      lua_pop(vm, 1);
+    }
+
+    checks[i]->setEnabled(enabled);
+
+    if(enabled)
+      lua_push_bool_table_entry(vm, checks[i]->getKey(), true);
+  }
+}
+
+/* **************************************************** */
+
+void FlowChecksExecutor::luaAlertedStatus(lua_State *vm) const {
+  if(alerted_check == NULL) {
+    lua_pushnil(vm);
+    return;
+  }
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "status_key", alerted_status);
+  lua_push_uint64_table_entry(vm, "score", alerted_status_score);
+  lua_push_str_table_entry(vm, "script_key", alerted_check->getKey());
+  lua_push_str_table_entry(vm, "status_info", alerted_status_info);
+}
+
+/* **************************************************** */
+
+void FlowChecksExecutor::lua(lua_State *vm) const {
+  for(u_int8_t i = 0; i < num_checks; i++)
+    checks[i]->lua(vm, tps);
+}
@@ -25,12 +25,99 @@
 
 FlowHash::FlowHash(NetworkInterface *_iface, u_int _num_hashes, u_int _max_hash_size) 
   : GenericHash(_iface, _num_hashes, _max_hash_size, "FlowHash") {
-  ;
+  /* Keep the index load factor below 50% as max_hash_size bounds the active entries */
+  u_int32_t num_slots = Utils::pow2(max_val(max_hash_size * 2, 1024));
+
+  num_index_lookups = num_index_probes = 0, max_index_probes = 0;
+
+  if((slots = (FlowHashSlot*)calloc(num_slots, sizeof(FlowHashSlot))) != NULL) {
+    slots_mask = num_slots - 1;
+
+    for(slots_shift = 32; num_slots > 1; num_slots >>= 1)
+      slots_shift--;
+  } else {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Not enough memory for the flow index: using hash buckets only");
+    slots_mask = 0, slots_shift = 0;
+  }
 };
 
 /* ************************************ */
 
-static u_int16_t max_num_loops = 0;
+FlowHash::~FlowHash() {
+  if(slots) free(slots);
+}
+
+/* ************************************ */
+
+void FlowHash::cleanup() {
+  GenericHash::cleanup();
+
+  if(slots) memset(slots, 0, (slots_mask + 1) * sizeof(FlowHashSlot));
+}
+
+/* ************************************ */
+
+void FlowHash::indexInsert(Flow *f) {
+  u_int32_t key = f->key(), i = indexHome(key);
+
+  for(u_int32_t n = 0; n <= slots_mask; n++) {
+    if(slots[i].flow == NULL) {
+      slots[i].key = key, slots[i].vlan_id = f->get_vlan_id(), slots[i].protocol = f->get_protocol();
+      slots[i].flow = f;
+      return;
+    }
+
+    i = (i + 1) & slots_mask;
+  }
+
+  /* Should never happen as the index is sized twice the max hash size */
+  ntop->getTrace()->traceEvent(TRACE_ERROR, "Flow index full: using hash buckets only");
+  free(slots);
+  slots = NULL;
+}
+
+/* ************************************ */
+
+void FlowHash::indexRemove(Flow *f) {
+  u_int32_t i = indexHome(f->key()), j;
+
+  while(slots[i].flow != f) {
+    if(slots[i].flow == NULL)
+      return; /* Not indexed */
+
+    i = (i + 1) & slots_mask;
+  }
+
+  /*
+    Backward-shift deletion: move back the following entries of the probe
+    sequence so that no tombstones are needed and lookups stay short
+  */
+  for(j = (i + 1) & slots_mask; slots[j].flow != NULL; j = (j + 1) & slots_mask) {
+    u_int32_t home = indexHome(slots[j].key);
+
+    /* Move the entry only if its home slot is not cyclically in (i, j] */
+    if((i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j))) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+
+  slots[i].flow = NULL;
+}
+
+/* ************************************ */
+
+void FlowHash::onEntryAdded(GenericHashEntry *h) {
+  if(slots) indexInsert((Flow*)h);
+}
+
+/* ************************************ */
+
+void FlowHash::onEntryDetached(GenericHashEntry *h) {
+  if(slots) indexRemove((Flow*)h);
+}
+
+/* ************************************ */
 
 Flow* FlowHash::find(IpAddress *src_ip, IpAddress *dst_ip,
 		     u_int16_t src_port, u_int16_t dst_port, 
@@ -38,13 +125,35 @@ Flow* FlowHash::find(IpAddress *src_ip, IpAddress *dst_ip,
 		     const ICMPinfo * const icmp_info,
 		     bool *src2dst_direction,
 		     bool is_inline_call) {
-  u_int32_t hash = ((src_ip->key() + dst_ip->key()
-		     + (icmp_info ? icmp_info->key() : 0)
-		     + src_port + dst_port + vlanId + protocol) % num_hashes);
-  Flow *head = (Flow*)table[hash];
-  u_int16_t num_loops = 0;
+  u_int32_t key = Utils::flowHash(src_ip->key(), src_port, dst_ip->key(), dst_port,
+				  vlanId, protocol, icmp_info ? icmp_info->key() : 0);
+  u_int32_t hash;
+  Flow *head;
+
+  if(is_inline_call && slots) {
+    u_int32_t i = indexHome(key), num_probes = 1;
+
+    /* The index is only modified by this thread (add and purgeIdle): no locking needed */
+    while((head = slots[i].flow) != NULL) {
+      if((slots[i].key == key)
+	 && (slots[i].vlan_id == vlanId)
+	 && (slots[i].protocol == protocol)
+	 && !head->idle()
+	 && head->equal(src_ip, dst_ip, src_port, dst_port, vlanId, protocol, icmp_info, src2dst_direction))
+	break;
+
+      i = (i + 1) & slots_mask, num_probes++;
+    }
+
+    num_index_lookups++, num_index_probes += num_probes;
+    if(num_probes > max_index_probes) max_index_probes = num_probes;
+
+    return(head);
+  }
+
+  hash = bucketId(key);
 
-  if(!head)
+  if((head = (Flow*)table[hash]) == NULL)
     return(NULL);
 
   if(!is_inline_call)
@@ -54,20 +163,10 @@ Flow* FlowHash::find(IpAddress *src_ip, IpAddress *dst_ip,
 
   while(head) {
     if(!head->idle()
-       && head->equal(src_ip, dst_ip, src_port, dst_port, vlanId, protocol, icmp_info, src2dst_direction)) {
-      if(num_loops > max_num_loops) {
-	ntop->getTrace()->traceEvent(TRACE_INFO, "DEBUG: [Num loops: %u][hashId: %u]", num_loops, hash);
-	max_num_loops = num_loops;
-      }
-
+       && head->equal(src_ip, dst_ip, src_port, dst_port, vlanId, protocol, icmp_info, src2dst_direction))
       break;
-    } else
-      head = (Flow*)head->next(), num_loops++;
-  }
-
-  if(num_loops > max_num_loops) {
-    ntop->getTrace()->traceEvent(TRACE_INFO, "DEBUG: [Num loops: %u][hashId: %u]", num_loops, hash);
-    max_num_loops = num_loops;
+    else
+      head = (Flow*)head->next();
   }
 
   if(!is_inline_call)
@@ -79,7 +178,7 @@ Flow* FlowHash::find(IpAddress *src_ip, IpAddress *dst_ip,
 /* ************************************ */
 
 Flow* FlowHash::findByKeyAndHashId(u_int32_t key, u_int hash_id) {
-  u_int32_t hash = key % num_hashes;
+  u_int32_t hash = bucketId(key);
   Flow *head = (Flow*)table[hash];
 
   if(head == NULL) return(NULL);
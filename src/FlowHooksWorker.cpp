@@ -0,0 +1,411 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+FlowHooksWorker::FlowHooksWorker(NetworkInterface *_iface, u_int8_t _worker_id) {
+  char buf[64], suffix[8];
+
+  iface = _iface, worker_id = _worker_id;
+  hooksLoopCreated = false;
+  hooksEngine = NULL, hooks_engine_reload = false;
+  num_executed_hooks = tot_hooks_usec = 0, max_hook_usec = 0;
+  tot_queue_latency_usec = 0, max_queue_latency_usec = 0;
+
+  /* The first worker keeps the historical queue names */
+  if(worker_id == 0)
+    suffix[0] = '\0';
+  else
+    snprintf(suffix, sizeof(suffix), "_%u", worker_id);
+
+  snprintf(buf, sizeof(buf), "hookProtocolDetected%s", suffix);
+  hookProtocolDetected = new (std::nothrow) SPSCQueue<Flow *>(MAX_US_PROTOCOL_DETECTED_QUEUE_LEN, buf);
+  snprintf(buf, sizeof(buf), "hookPeriodicUpdate%s", suffix);
+  hookPeriodicUpdate   = new (std::nothrow) SPSCQueue<Flow *>(MAX_US_PERIODIC_UPDATE_QUEUE_LEN, buf);
+  snprintf(buf, sizeof(buf), "hookFlowEnd%s", suffix);
+  hookFlowEnd          = new (std::nothrow) SPSCQueue<Flow *>(MAX_US_FLOW_END_QUEUE_LEN, buf);
+
+  initQueueTimes(&protocol_detected_times, MAX_US_PROTOCOL_DETECTED_QUEUE_LEN);
+  initQueueTimes(&periodic_update_times,   MAX_US_PERIODIC_UPDATE_QUEUE_LEN);
+  initQueueTimes(&flow_end_times,          MAX_US_FLOW_END_QUEUE_LEN);
+
+  snprintf(buf, sizeof(buf), "flowHooksWorker_%u", worker_id);
+  name = strdup(buf);
+}
+
+/* **************************************************** */
+
+FlowHooksWorker::~FlowHooksWorker() {
+  stopHooks();
+
+  if(hooksEngine)          delete hooksEngine;
+  if(hookProtocolDetected) delete hookProtocolDetected;
+  if(hookPeriodicUpdate)   delete hookPeriodicUpdate;
+  if(hookFlowEnd)          delete hookFlowEnd;
+  if(name)                 free(name);
+
+  if(protocol_detected_times.enqueue_usec) free(protocol_detected_times.enqueue_usec);
+  if(periodic_update_times.enqueue_usec)   free(periodic_update_times.enqueue_usec);
+  if(flow_end_times.enqueue_usec)          free(flow_end_times.enqueue_usec);
+}
+
+/* **************************************************** */
+
+/*
+  Twice the size of the SPSCQueue (which rounds its length up to a power of 2). The
+  slot of flow N is written again for flow N + 2 * queue_size, which the producer only
+  stamps after having seen the queue release flow N + queue_size, i.e. after the hooks
+  thread has read the time of flow N.
+ */
+void FlowHooksWorker::initQueueTimes(struct hook_queue_times *t, u_int32_t queue_len) {
+  u_int32_t size = 2 * Utils::pow2(queue_len);
+
+  t->enqueue_usec = (u_int64_t*)calloc(size, sizeof(u_int64_t));
+  t->mask = size - 1;
+  t->num_in = t->num_out = 0;
+}
+
+/* **************************************************** */
+
+u_int64_t FlowHooksWorker::nowUsec() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return((u_int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+/* **************************************************** */
+
+bool FlowHooksWorker::enqueue(Flow *f) {
+  SPSCQueue<Flow *> *selected_queue = NULL;
+  struct hook_queue_times *times = NULL;
+
+  /*
+    Choose the right queue to perform the enqueue
+   */
+
+  switch(f->get_state()) {
+  case hash_entry_state_flow_protocoldetected:
+    selected_queue = hookProtocolDetected, times = &protocol_detected_times;
+    break;
+  case hash_entry_state_active:
+    selected_queue = hookPeriodicUpdate, times = &periodic_update_times;
+    break;
+  case hash_entry_state_idle:
+    selected_queue = hookFlowEnd, times = &flow_end_times;
+    break;
+  default:
+    break;
+  }
+
+  if(!selected_queue)
+    return(false);
+
+  /* Stamp the slot of the next flow before publishing it (see initQueueTimes) */
+  if(times->enqueue_usec)
+    times->enqueue_usec[times->num_in & times->mask] = nowUsec();
+
+  /* Perform the actual enqueue */
+  if(selected_queue->enqueue(f, true)) {
+    times->num_in++;
+
+    /*
+      If enqueue was successful, increase the flow reference counter.
+      Reference counter will be deleted when doing the dequeue.
+    */
+    f->incUses();
+
+    /*
+      Wake up the hooks thread, only if it is waiting
+    */
+    hooks_condition.signalIfWaiting();
+
+    return(true);
+  }
+
+  return(false);
+}
+
+/* **************************************************** */
+
+u_int64_t FlowHooksWorker::dequeueFlows(SPSCQueue<Flow *> *q, struct hook_queue_times *t, FlowLuaCall flow_lua_call, u_int budget) {
+  u_int64_t num_done = 0;
+  Flow *flows[FLOW_HOOKS_DEQUEUE_BATCH];
+  u_int32_t num_dequeued;
+
+  do {
+    u_int32_t max_items = FLOW_HOOKS_DEQUEUE_BATCH;
+
+    if(budget > 0 /* Budget requested */)
+      max_items = min_val(max_items, budget - num_done);
+
+    num_dequeued = q->dequeueBulk(flows, max_items);
+
+    for(u_int32_t i = 0; i < num_dequeued; i++) {
+      Flow *f = flows[i];
+
+      /* Time spent by the flow in the queue, including the hooks of the flows before it in the batch */
+      if(t->enqueue_usec) {
+	u_int64_t now = nowUsec(), enqueued = t->enqueue_usec[t->num_out & t->mask];
+	u_int32_t latency = (now > enqueued) ? (u_int32_t)(now - enqueued) : 0;
+
+	tot_queue_latency_usec += latency;
+	if(latency > max_queue_latency_usec) max_queue_latency_usec = latency;
+      }
+
+      t->num_out++;
+
+      /*
+	Execute the callback (if the engine is available
+      */
+      if(hooksEngine) {
+	struct timeval begin, end;
+	u_int32_t usec;
+
+	gettimeofday(&begin, NULL);
+	f->performLuaCall(flow_lua_call, hooksEngine, &flow_checks);
+	gettimeofday(&end, NULL);
+
+	usec = Utils::usecTimevalDiff(&end, &begin);
+	num_executed_hooks++, tot_hooks_usec += usec;
+	if(usec > max_hook_usec) max_hook_usec = usec;
+      }
+
+#if DEBUG_FLOW_HOOKS
+      ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dequeued idle flow");
+#endif
+
+      /*
+	Now that the job is done, the reference counter to the flow can be decreased.
+      */
+      f->decUses();
+    }
+
+    num_done += num_dequeued;
+  } while((num_dequeued > 0)
+	  && ((budget == 0) || (num_done < budget)) /* Budget not exceeded */);
+
+  return num_done;
+}
+
+/* **************************************************** */
+
+u_int64_t FlowHooksWorker::dequeueFlowsForHooks(u_int protocol_detected_budget, u_int active_budget, u_int idle_budget) {
+  u_int64_t num_done = 0;
+
+  /*
+    Check if it is time to reload the engine.
+    First, we free the memory (if necessary) and then we allocate it.
+   */
+  if(hooks_engine_reload) {
+    if(hooksEngine) {
+      delete hooksEngine;
+      hooksEngine = NULL;
+    }
+
+    hooks_engine_reload = false;
+  }
+
+  if(!hooksEngine) {
+    hooksEngine = new (nothrow) FlowAlertCheckLuaEngine(iface);
+
+    /* Let flow.lua hand over the scripts implemented natively to the checks of this worker */
+    if(hooksEngine)
+      hooksEngine->setupNativeChecks(&flow_checks);
+  }
+
+  /*
+    Start with highest-priority, flow hooks for idle flows. Failing to execute a hook for an idle flow is critical as there
+    will not be any chance to execute it again in the future.
+
+    Then, do mid-priority flow hooks for protocol-detected flows. Executing these hooks is crucial as well, as the flow only stays
+    in this state for a very short time and there won't be chances to execute these scripts again.
+
+    Finally, do low-priority periodic update hooks. These hooks can be retried multiple times so their priority is low.
+   */
+
+  num_done += dequeueFlows(hookFlowEnd, &flow_end_times, flow_lua_call_idle, idle_budget);
+  num_done += dequeueFlows(hookProtocolDetected, &protocol_detected_times, flow_lua_call_protocol_detected, protocol_detected_budget);
+  num_done += dequeueFlows(hookPeriodicUpdate, &periodic_update_times, flow_lua_call_periodic_update, active_budget);
+
+#ifndef WIN32
+  if(num_done == 0) {
+    /*
+      No flow was dequeued. Let's wait for at most 1s. Cannot wait indefinitely
+      as we must ensure purgeQueuedIdleFlows() gets executed, and also to exit when it's
+      time to shutdown.
+    */
+    struct timespec hooks_wait_expire;
+
+    hooks_wait_expire.tv_sec = time(NULL) + 1,
+      hooks_wait_expire.tv_nsec = 0;
+
+    /* Producers only signal when we are parked: check the queues again once announced */
+    hooks_condition.prepareWait();
+
+    if(!hookFlowEnd->isNotEmpty()
+       && !hookProtocolDetected->isNotEmpty()
+       && !hookPeriodicUpdate->isNotEmpty())
+      hooks_condition.timedWait(&hooks_wait_expire);
+
+    hooks_condition.cancelWait();
+  }
+#endif
+
+  /* Purging of idle flows is done here as it involves decreasing certain hosts counters (such as host scores)
+     that are increased by flow user script hooks. It is done by the first worker only, as the flow hash
+     table supports a single purger.
+  */
+  if(worker_id == 0)
+    num_done += iface->purgeQueuedIdleFlows();
+
+#if DEBUG_FLOW_HOOKS
+  if(num_done > 0)
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dequeued flows [%u]", num_done);
+#endif
+
+  return num_done;
+}
+
+/* **************************************************** */
+
+void FlowHooksWorker::hookFlowLoop() {
+  ntop->getTrace()->traceEvent(TRACE_NORMAL,
+			       "Started flow user script hooks loop on interface %s [id: %u][worker: %u]...",
+			       iface->get_description(), iface->get_id(), worker_id);
+
+  /* Wait until it starts up */
+  while(!iface->isRunning()) _usleep(10000);
+
+  /* Now operational */
+  while(iface->isRunning()) {
+    /*
+      Dequeue flows for dump.
+
+      To guarantee some sort of fairness and prioritization, different numbers are used for each
+      of the three queues. Higher numbers are used for queues with higher-priority.
+     */
+    u_int64_t n = dequeueFlowsForHooks(16 /* protocol_detected_budget */, 4 /* active_budget */, 32 /* idle_budget */);
+
+    if(n == 0) {
+      /*
+	If windows, sleep if nothing was done during the previous cycle.
+	On non-windows, there's nothing do to as signal/waits are implemented to throttle the speed
+      */
+#ifdef WIN32
+      _usleep(10000);
+#endif
+    }
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Flow user script hooks thread completed for %s [worker: %u]",
+			       iface->get_name(), worker_id);
+}
+
+/* **************************************************** */
+
+static void* hooksLoopFctn(void* ptr) {
+  FlowHooksWorker *w = (FlowHooksWorker*)ptr;
+
+  w->hookFlowLoop();
+  return(NULL);
+}
+
+/* **************************************************** */
+
+void FlowHooksWorker::startHooks() {
+  if(hooksLoopCreated || !hookProtocolDetected || !hookPeriodicUpdate || !hookFlowEnd)
+    return;
+
+  pthread_create(&hooksLoop, NULL, hooksLoopFctn, (void*)this);
+  hooksLoopCreated = true;
+
+#ifdef __linux__
+  char buf[16];
+
+  if(worker_id == 0)
+    snprintf(buf, sizeof(buf), "hooks ifid %u", iface->get_id());
+  else
+    snprintf(buf, sizeof(buf), "hooks%u ifid %u", worker_id, iface->get_id());
+
+  pthread_setname_np(hooksLoop, buf);
+#endif
+}
+
+/* **************************************************** */
+
+/* The loop terminates when the interface is no longer running */
+void FlowHooksWorker::stopHooks() {
+  if(hooksLoopCreated) {
+    void *res;
+
+    pthread_join(hooksLoop, &res);
+    hooksLoopCreated = false;
+  }
+}
+
+/* **************************************************** */
+
+u_int FlowHooksWorker::getQueues(const SPSCQueue<Flow *> **queues, u_int max_num) const {
+  SPSCQueue<Flow *> *all[] = { hookProtocolDetected, hookPeriodicUpdate, hookFlowEnd };
+  u_int num = 0;
+
+  for(u_int i = 0; (i < sizeof(all) / sizeof(all[0])) && (num < max_num); i++) {
+    if(all[i])
+      queues[num++] = all[i];
+  }
+
+  return(num);
+}
+
+/* **************************************************** */
+
+void FlowHooksWorker::lua(lua_State *vm) const {
+  SPSCQueue<Flow *> *queues[] = { hookProtocolDetected, hookPeriodicUpdate, hookFlowEnd };
+  u_int64_t num_failed_enqueues = 0, queue_length = 0;
+  u_int64_t num_dequeued_flows = protocol_detected_times.num_out + periodic_update_times.num_out + flow_end_times.num_out;
+
+  for(u_int i = 0; i < sizeof(queues) / sizeof(queues[0]); i++) {
+    if(queues[i]) {
+      queues[i]->lua(vm);
+      num_failed_enqueues += queues[i]->get_num_failed_enqueues();
+      queue_length += queues[i]->getLength();
+    }
+  }
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "num_failed_enqueues", num_failed_enqueues);
+  lua_push_uint64_table_entry(vm, "queue_length", queue_length);
+  lua_push_uint64_table_entry(vm, "num_executed_hooks", num_executed_hooks);
+  lua_push_float_table_entry(vm, "avg_hook_usec",
+			     num_executed_hooks ? ((float)tot_hooks_usec) / num_executed_hooks : 0);
+  lua_push_uint64_table_entry(vm, "max_hook_usec", max_hook_usec);
+  lua_push_uint64_table_entry(vm, "num_dequeued_flows", num_dequeued_flows);
+  lua_push_float_table_entry(vm, "avg_queue_latency_usec",
+			     num_dequeued_flows ? ((float)tot_queue_latency_usec) / num_dequeued_flows : 0);
+  lua_push_uint64_table_entry(vm, "max_queue_latency_usec", max_queue_latency_usec);
+  lua_pushstring(vm, name ? name : "");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
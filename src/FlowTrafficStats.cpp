@@ -59,7 +59,7 @@ void FlowTrafficStats::incStats(bool cli2srv_direction, u_int num_pkts, u_int pk
 
 /* *************************************** */
 
-void FlowTrafficStats::setStats(bool cli2srv_direction, u_int num_pkts, u_int pkt_len, u_int payload_len) {
+void FlowTrafficStats::setStats(bool cli2srv_direction, u_int num_pkts, u_int64_t pkt_len, u_int64_t payload_len) {
   PartializableFlowTrafficStats::setStats(cli2srv_direction, num_pkts, pkt_len, payload_len);
 
   if(cli2srv_direction) {
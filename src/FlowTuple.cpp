@@ -0,0 +1,56 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+void FlowTuple::set(const char *_cli_ip, u_int16_t _cli_port, const char *_srv_ip, u_int16_t _srv_port, u_int8_t _l4_proto) {
+  if(_cli_ip) cli_ip.set(_cli_ip);
+  if(_srv_ip) srv_ip.set(_srv_ip);
+  cli_port = _cli_port, srv_port = _srv_port, l4_proto = _l4_proto;
+}
+
+/* **************************************************** */
+
+u_int32_t FlowTuple::hash() const {
+  return(DissectionWorker::tupleHash(&cli_ip, cli_port, &srv_ip, srv_port, l4_proto));
+}
+
+/* **************************************************** */
+
+bool FlowTuple::match(int datalink_type, const struct pcap_pkthdr *h, const u_char *packet) const {
+  IpAddress src_ip, dst_ip;
+  u_int16_t src_port, dst_port;
+  u_int8_t proto;
+
+  if(!DissectionWorker::packetTuple(datalink_type, h, packet, &src_ip, &dst_ip, &src_port, &dst_port, &proto)
+     || (proto != l4_proto))
+    return(false);
+
+  /* Ports are only compared for the protocols carrying them, as in DissectionWorker::tupleHash */
+  if(src_ip.equal(&cli_ip) && dst_ip.equal(&srv_ip))
+    return(!hasPorts() || ((src_port == cli_port) && (dst_port == srv_port)));
+  else if(src_ip.equal(&srv_ip) && dst_ip.equal(&cli_ip))
+    return(!hasPorts() || ((src_port == srv_port) && (dst_port == cli_port)));
+
+  return(false);
+}
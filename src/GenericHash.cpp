@@ -25,7 +25,9 @@
 
 GenericHash::GenericHash(NetworkInterface *_iface, u_int _num_hashes,
 			 u_int _max_hash_size, const char *_name) {
-  num_hashes = _num_hashes;
+  /* Power of two so that buckets are selected by masking the key */
+  num_hashes = Utils::pow2(max_val(_num_hashes, 1));
+  hash_mask = num_hashes - 1;
   current_size = 0;
   /* Allow the total number of entries (that is, active and those idle but still not yet purged)
      to be 30% more than the maximum hash table size specified. This prevents memory from growing
@@ -50,7 +52,16 @@ GenericHash::GenericHash(NetworkInterface *_iface, u_int _num_hashes,
 
   idle_entries_in_use = new vector<GenericHashEntry*>;
 
-  last_purged_hash = _num_hashes - 1;
+  last_purged_hash = num_hashes - 1;
+
+  if(ntop->getPrefs() && ntop->getPrefs()->use_idle_timing_wheel())
+    idle_wheel = new (std::nothrow) TimingWheel();
+  else
+    idle_wheel = NULL;
+
+  num_idle_wheel_rearms = 0;
+  memset(idle_lag_histogram, 0, sizeof(idle_lag_histogram));
+  idle_lag_samples = 0, idle_lag_max = 0;
 }
 
 /* ************************************ */
@@ -62,6 +73,7 @@ GenericHash::~GenericHash() {
 
   for(u_int i = 0; i < num_hashes; i++) delete(locks[i]);
   delete[] locks;
+  if(idle_wheel) delete idle_wheel;
   free(name);
 }
 
@@ -70,6 +82,12 @@ GenericHash::~GenericHash() {
 void GenericHash::cleanup() {
   vector<GenericHashEntry*> **ghvs[] = { &idle_entries, &idle_entries_shadow, &idle_entries_in_use };
 
+  if(idle_wheel) {
+    idle_wheel_lock.lock(__FILE__, __LINE__);
+    idle_wheel->reset();
+    idle_wheel_lock.unlock(__FILE__, __LINE__);
+  }
+
   for(u_int i = 0; i < sizeof(ghvs) / sizeof(ghvs[0]); i++) {
     if(*ghvs[i]) {
       if(!(*ghvs[i])->empty()) {
@@ -105,7 +123,7 @@ void GenericHash::cleanup() {
 
 bool GenericHash::add(GenericHashEntry *h, bool do_lock) {
   if(hasEmptyRoom()) {
-    u_int32_t hash = (h->key() % num_hashes);
+    u_int32_t hash = bucketId(h->key());
 
     if(do_lock)
       locks[hash]->wrlock(__FILE__, __LINE__);
@@ -115,6 +133,13 @@ bool GenericHash::add(GenericHashEntry *h, bool do_lock) {
     h->set_next(table[hash]);
     table[hash] = h;
     current_size++;
+    onEntryAdded(h);
+
+    if(idle_wheel) {
+      idle_wheel_lock.lock(__FILE__, __LINE__);
+      idle_wheel->arm(h, nextWheelVisit(h, max_val(iface->getTimeLastPktRcvd(), h->get_last_seen())));
+      idle_wheel_lock.unlock(__FILE__, __LINE__);
+    }
 
     if(do_lock)
       locks[hash]->unlock(__FILE__, __LINE__);
@@ -274,6 +299,13 @@ bool GenericHash::walk(u_int32_t *begin_slot,
 u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle) {
   u_int i, num_detached = 0, buckets_checked = 0;
   time_t now = time(NULL);
+  /* Time used by the idle checks of the entries */
+  time_t idle_now = iface->getTimeLastPktRcvd();
+  /*
+    When the wheel is in use, idle entries are detached when they expire on it: the
+    bucket walk below only runs the periodic updates and housekeeping
+   */
+  bool wheel_expiration = (idle_wheel != NULL) && !force_idle;
   /* Visit all entries when force_idle is true */
   u_int visit_fraction = (!force_idle) ? purge_step : num_hashes;
   size_t idle_entries_shadow_old_size;
@@ -360,10 +392,20 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle) {
 	  if(
 	     force_idle
 	     || (
-		 iface->is_purge_idle_interface()
+		 !wheel_expiration
+		 && iface->is_purge_idle_interface()
 		 && head->is_hash_entry_state_idle_transition_ready())
 	     ) {
 	  detach_idle_hash_entry:
+	    if(!force_idle)
+	      updateIdleLag(head, idle_now);
+
+	    if(idle_wheel) {
+	      idle_wheel_lock.lock(__FILE__, __LINE__);
+	      idle_wheel->remove(head);
+	      idle_wheel_lock.unlock(__FILE__, __LINE__);
+	    }
+
 	    idle_entries_shadow->push_back(head); /* Found entry to purge */
 
 	    if(!prev)
@@ -371,6 +413,7 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle) {
 	    else
 	      prev->set_next(next);
 
+	    onEntryDetached(head);
 	    num_detached++, current_size--;
 	    head = next;
 	    continue;
@@ -395,6 +438,9 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle) {
 			       name, current_size, visit_fraction, num_hashes, j, buckets_checked);
 #endif
 
+  if(wheel_expiration)
+    num_detached += purgeWheelExpired(idle_now, iface->is_purge_idle_interface());
+
   /* Actual idling can be performed when the hash table is no longer locked. */
   if(idle_entries_shadow->size() > idle_entries_shadow_old_size) {
     it = idle_entries_shadow->begin();
@@ -420,6 +466,110 @@ u_int GenericHash::purgeIdle(const struct timeval * tv, bool force_idle) {
 
 /* ************************************ */
 
+time_t GenericHash::nextWheelVisit(GenericHashEntry *h, time_t now) const {
+  time_t idle_deadline = h->get_idle_deadline();
+
+  if(idle_deadline <= now)
+    /* Not ready to be idled although expired (e.g., in use): check it again later */
+    idle_deadline = now + IDLE_WHEEL_RETRY_DELAY;
+
+  return(idle_deadline);
+}
+
+/* ************************************ */
+
+u_int GenericHash::purgeWheelExpired(time_t idle_now, bool purge_idle) {
+  u_int num_detached = 0;
+
+  idle_wheel_expired.clear();
+
+  idle_wheel_lock.lock(__FILE__, __LINE__);
+  idle_wheel->advance(idle_now, &idle_wheel_expired);
+  idle_wheel_lock.unlock(__FILE__, __LINE__);
+
+  for(vector<GenericHashEntry*>::const_iterator it = idle_wheel_expired.begin(); it != idle_wheel_expired.end(); ++it) {
+    GenericHashEntry *h = *it;
+    u_int32_t hash = bucketId(h->key());
+    time_t deadline;
+
+    if(!locks[hash]->trywrlock(__FILE__, __LINE__)) {
+      /* Busy, will retry on the next tick */
+      deadline = idle_now + 1;
+    } else {
+      if(purge_idle
+	 && (h->get_state() == hash_entry_state_active)
+	 && h->is_hash_entry_state_idle_transition_ready()) {
+	GenericHashEntry *head = table[hash], *prev = NULL;
+
+	while(head && (head != h))
+	  prev = head, head = head->next();
+
+	if(head) {
+	  updateIdleLag(h, idle_now);
+	  idle_entries_shadow->push_back(h); /* Found entry to purge */
+
+	  if(!prev)
+	    table[hash] = h->next();
+	  else
+	    prev->set_next(h->next());
+
+	  onEntryDetached(h);
+	  num_detached++, current_size--;
+	} else
+	  ntop->getTrace()->traceEvent(TRACE_ERROR, "Internal error: expired entry not found [%s]", name);
+
+	locks[hash]->unlock(__FILE__, __LINE__);
+	continue;
+      }
+
+      /* Seen since it was armed: its idle deadline has moved on */
+      deadline = nextWheelVisit(h, idle_now);
+
+      locks[hash]->unlock(__FILE__, __LINE__);
+    }
+
+    idle_wheel_lock.lock(__FILE__, __LINE__);
+    idle_wheel->arm(h, deadline);
+    num_idle_wheel_rearms++;
+    idle_wheel_lock.unlock(__FILE__, __LINE__);
+  }
+
+#ifdef WALK_DEBUG
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "[%s @ %s] purgeWheelExpired() [expired: %u][num_detached: %u]",
+			       name, iface->get_name(), idle_wheel_expired.size(), num_detached);
+#endif
+
+  return(num_detached);
+}
+
+/* ************************************ */
+
+void GenericHash::rearmIdle(GenericHashEntry *h) {
+  if(!idle_wheel)
+    return;
+
+  idle_wheel_lock.lock(__FILE__, __LINE__);
+
+  /* Entries not armed are being visited by purgeIdle(), that will re-arm them if needed */
+  if((h->get_wheel_link()->slot >= 0) && (h->get_idle_deadline() < h->get_wheel_link()->deadline))
+    idle_wheel->arm(h, h->get_idle_deadline());
+
+  idle_wheel_lock.unlock(__FILE__, __LINE__);
+}
+
+/* ************************************ */
+
+void GenericHash::updateIdleLag(GenericHashEntry *h, time_t now) {
+  time_t deadline = h->get_idle_deadline();
+  u_int32_t lag = (now > deadline) ? (u_int32_t)(now - deadline) : 0;
+
+  idle_lag_histogram[min_val(lag, IDLE_LAG_HISTOGRAM_SLOTS - 1)]++;
+  idle_lag_samples++;
+  if(lag > idle_lag_max) idle_lag_max = lag;
+}
+
+/* ************************************ */
+
 u_int32_t GenericHash::getNumIdleEntries() const {
   return(ndpi_max(0, entry_state_transition_counters.num_idle_transitions - entry_state_transition_counters.num_purged));
 };
@@ -438,7 +588,96 @@ bool GenericHash::hasEmptyRoom() {
 
 /* ************************************ */
 
-void GenericHash::lua(lua_State *vm) {
+void GenericHash::luaChainLengths(lua_State *vm) {
+  /* Histogram bins: 0, 1, 2, 3, 4, 5-8, 9-16, 17+ entries per bucket */
+  const char *labels[] = { "0", "1", "2", "3", "4", "5-8", "9-16", "17+" };
+  u_int64_t bins[sizeof(labels) / sizeof(labels[0])] = { 0 };
+  u_int32_t max_len = 0;
+
+  for(u_int hash_id = 0; hash_id < num_hashes; hash_id++) {
+    u_int32_t len = 0;
+    u_int bin;
+
+    if(table[hash_id] != NULL) {
+      locks[hash_id]->rdlock(__FILE__, __LINE__);
+
+      for(GenericHashEntry *head = table[hash_id]; head; head = head->next())
+	len++;
+
+      locks[hash_id]->unlock(__FILE__, __LINE__);
+    }
+
+    if(len <= 4)       bin = len;
+    else if(len <= 8)  bin = 5;
+    else if(len <= 16) bin = 6;
+    else               bin = 7;
+
+    bins[bin]++;
+    if(len > max_len) max_len = len;
+  }
+
+  lua_newtable(vm);
+
+  lua_push_uint64_table_entry(vm, "num_buckets", num_hashes);
+  lua_push_uint64_table_entry(vm, "max_chain_length", max_len);
+
+  lua_newtable(vm);
+  for(u_int i = 0; i < sizeof(labels) / sizeof(labels[0]); i++)
+    lua_push_uint64_table_entry(vm, labels[i], bins[i]);
+
+  lua_pushstring(vm, "histogram");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+
+  lua_pushstring(vm, "chain_lengths");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* ************************************ */
+
+void GenericHash::luaIdleExpiration(lua_State *vm) {
+  const u_int8_t percentiles[] = { 50, 90, 99 };
+  const char *labels[] = { "lag_p50_sec", "lag_p90_sec", "lag_p99_sec" };
+  u_int64_t samples = idle_lag_samples;
+
+  lua_newtable(vm);
+
+  lua_push_bool_table_entry(vm, "timing_wheel_enabled", idle_wheel ? true : false);
+  lua_push_uint64_table_entry(vm, "num_samples", samples);
+  lua_push_uint64_table_entry(vm, "lag_max_sec", idle_lag_max);
+
+  /* Percentiles are computed on 1 sec bins, the last bin also includes larger lags */
+  for(u_int p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++) {
+    u_int64_t target = (samples * percentiles[p] + 99) / 100, cumulative = 0;
+    u_int32_t bin = 0;
+
+    if(samples > 0) {
+      for(bin = 0; bin < IDLE_LAG_HISTOGRAM_SLOTS - 1; bin++) {
+	cumulative += idle_lag_histogram[bin];
+	if(cumulative >= target) break;
+      }
+    }
+
+    lua_push_uint64_table_entry(vm, labels[p], bin);
+  }
+
+  if(idle_wheel) {
+    lua_push_uint64_table_entry(vm, "num_rearms", num_idle_wheel_rearms);
+
+    idle_wheel_lock.lock(__FILE__, __LINE__);
+    idle_wheel->lua(vm);
+    idle_wheel_lock.unlock(__FILE__, __LINE__);
+  }
+
+  lua_pushstring(vm, "idle_expiration");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* ************************************ */
+
+void GenericHash::lua(lua_State *vm, bool chain_lengths) {
   int64_t num_idle;
 
   lua_newtable(vm);
@@ -471,6 +710,21 @@ void GenericHash::lua(lua_State *vm) {
   lua_insert(vm, -2);
   lua_settable(vm, -3);
 
+  /* Computed on demand only, as it locks and visits every bucket */
+  if(chain_lengths) luaChainLengths(vm);
+  luaIdleExpiration(vm);
+
+  if(!memory_pools.empty()) {
+    lua_newtable(vm);
+
+    for(vector<MemoryPool*>::iterator it = memory_pools.begin(); it != memory_pools.end(); ++it)
+      (*it)->lua(vm);
+
+    lua_pushstring(vm, "memory_pools");
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
   lua_pushstring(vm, name ? name : "");
   lua_insert(vm, -2);
   lua_settable(vm, -3);
@@ -27,6 +27,7 @@ GenericHashEntry::GenericHashEntry(NetworkInterface *_iface) {
   hash_next = NULL, iface = _iface, first_seen = last_seen = 0;
   num_uses = 0;
   hash_table = NULL;
+  memset(&wheel_link, 0, sizeof(wheel_link)), wheel_link.slot = -1;
 
   hash_entry_state = hash_entry_state_active; /* Default for all but Flow */
 
@@ -30,7 +30,7 @@
 
 /* *************************************** */
 
-Geolocation::Geolocation() {
+Geolocation::Geolocation() : cache(GEOLOCATION_CACHE_MAX_NETWORKS) {
   mmdbs_ok = false;
 
 #ifdef HAVE_MAXMINDDB
@@ -159,48 +159,87 @@ Geolocation::~Geolocation() {
 
 /* *************************************** */
 
-void Geolocation::getAS(IpAddress *addr, u_int32_t *asn, char **asname) {
+#ifdef HAVE_MAXMINDDB
+/* Returns the prefix length of the network of the lookup result, in terms of the address family of addr */
+u_int8_t Geolocation::getPrefixLen(IpAddress *addr, const MMDB_s * const mmdb, const MMDB_lookup_result_s * const result) const {
+  /* IPv4 addresses are looked up in the ::a.b.c.d subtree of IPv6 databases */
+  if(addr->isIPv4() && (mmdb->metadata.ip_version == 6))
+    return((result->netmask > 96) ? (result->netmask - 96) : 0);
+
+  return(result->netmask);
+}
+
+/* *************************************** */
+
+/* MMDB strings are not terminated with a null character */
+bool Geolocation::getString(MMDB_entry_s *entry, const char * const *path, char *buf, u_int buf_len) const {
+  MMDB_entry_data_s entry_data;
+
+  if((MMDB_aget_value(entry, &entry_data, path) == MMDB_SUCCESS)
+     && entry_data.has_data && (entry_data.type == MMDB_DATA_TYPE_UTF8_STRING)) {
+    u_int len = min_val(entry_data.data_size, buf_len - 1);
+
+    memcpy(buf, entry_data.utf8_string, len);
+    buf[len] = '\0';
+    return(true);
+  }
+
+  return(false);
+}
+#endif
+
+/* *************************************** */
+
+void Geolocation::getAS(IpAddress *addr, u_int32_t *asn, const char **asname) {
+  GeolocationCache::ASInfo info;
+
   if(asn)    *asn = 0;
   if(asname) *asname = NULL;
 
 #ifdef HAVE_MAXMINDDB
   sockaddr *sa = NULL;
   ssize_t sa_len;
-  int mmdb_error, status;
+  int mmdb_error;
   MMDB_lookup_result_s result;
   MMDB_entry_data_s entry_data;
 
+  if(!mmdbs_ok || !addr) return;
 
-  if(!mmdbs_ok) return;
+  /* Hosts of the same network share the lookup */
+  if(!cache.findAS(addr, &info)) {
+    if(!addr->get_sockaddr(&sa, &sa_len))
+      return;
 
-  if(addr && addr->get_sockaddr(&sa, &sa_len)) {
     result = MMDB_lookup_sockaddr(&geo_ip_asn_mmdb, sa, &mmdb_error);
+    free(sa);
 
-    if(mmdb_error == MMDB_SUCCESS) {
-      if(result.found_entry) {
-	/* Get the ASN */
-	if(asn && (status = MMDB_get_value(&result.entry, &entry_data, "autonomous_system_number", NULL)) == MMDB_SUCCESS) {
-	  if(entry_data.has_data && entry_data.type == MMDB_DATA_TYPE_UINT32)
-	    *asn = entry_data.uint32;
-	}
+    if(mmdb_error != MMDB_SUCCESS) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Lookup failed [%s]", MMDB_strerror(mmdb_error));
+      return;
+    }
 
-	/* Get the AS Organization, that is an utf8 string that is NOT terminated with a null character. */
-	if(asname && (status = MMDB_get_value(&result.entry, &entry_data, "autonomous_system_organization", NULL)) == MMDB_SUCCESS) {
-	  if(entry_data.has_data && entry_data.type == MMDB_DATA_TYPE_UTF8_STRING) {
-	    char *org;
+    info.asn = 0, info.asname = NULL;
 
-	    if((org = (char*)calloc(1, entry_data.data_size + 1))) {
-	      memcpy(org, entry_data.utf8_string, entry_data.data_size);
-	      *asname = org;
-	    }
-	  }
-	}
-      }
-    } else
-      ntop->getTrace()->traceEvent(TRACE_ERROR, "Lookup failed [%s]", MMDB_strerror(mmdb_error));
+    if(result.found_entry) {
+      const char * const org_path[] = { "autonomous_system_organization", NULL };
+      char org[256];
 
-    free(sa);
+      /* Get the ASN */
+      if((MMDB_get_value(&result.entry, &entry_data, "autonomous_system_number", NULL) == MMDB_SUCCESS)
+	 && entry_data.has_data && (entry_data.type == MMDB_DATA_TYPE_UINT32))
+	info.asn = entry_data.uint32;
+
+      /* Get the AS Organization */
+      if(getString(&result.entry, org_path, org, sizeof(org)))
+	info.asname = org;
+    }
+
+    /* Also addresses not found are cached, with the network they belong to */
+    cache.addAS(addr, getPrefixLen(addr, &geo_ip_asn_mmdb, &result), &info);
   }
+
+  if(asn)    *asn = info.asn;
+  if(asname) *asname = info.asname;
 #endif
 
   return;
@@ -208,101 +247,78 @@ void Geolocation::getAS(IpAddress *addr, u_int32_t *asn, char **asname) {
 
 /* *************************************** */
 
-void Geolocation::getInfo(IpAddress *addr, char **continent_code, char **country_code,
-			  char **city, float *latitude, float *longitude) {
+void Geolocation::getInfo(IpAddress *addr, const char **continent_code, const char **country_code,
+			  const char **city, float *latitude, float *longitude) {
+  GeolocationCache::GeoInfo info;
+
   if((!addr) || (addr->getVersion() == 0))
     return;
 
-  if(continent_code) *continent_code = strdup((char*)UNKNOWN_CONTINENT);
-  if(country_code)   *country_code = strdup((char*)UNKNOWN_COUNTRY);
-  if(city)           *city = strdup((char*)UNKNOWN_CITY);
-  if(latitude)       *latitude = 0;
-  if(longitude)      *longitude = 0;
+  info.continent_code = UNKNOWN_CONTINENT;
+  info.country_code = UNKNOWN_COUNTRY;
+  info.city = UNKNOWN_CITY;
+  info.latitude = info.longitude = 0;
 
 #ifdef HAVE_MAXMINDDB
-  sockaddr *sa = NULL;
-  ssize_t sa_len;
-  char *cdata;
+  if(mmdbs_ok && !cache.findGeo(addr, &info)) {
+    sockaddr *sa = NULL;
+    ssize_t sa_len;
 
-  if(!mmdbs_ok) return;
+    if(addr->get_sockaddr(&sa, &sa_len)) {
+      int mmdb_error;
+      MMDB_lookup_result_s result;
+      MMDB_entry_data_s entry_data;
 
-  if(addr && addr->get_sockaddr(&sa, &sa_len)) {
-    int mmdb_error, status;
-    MMDB_lookup_result_s result;
-    MMDB_entry_data_s entry_data;
+      result = MMDB_lookup_sockaddr(&geo_ip_city_mmdb, sa, &mmdb_error);
 
-    result = MMDB_lookup_sockaddr(&geo_ip_city_mmdb, sa, &mmdb_error);
+      if(mmdb_error == MMDB_SUCCESS) {
+	char continent_buf[16], country_buf[16], city_buf[128];
 
-    if(mmdb_error == MMDB_SUCCESS) {
-      if(result.found_entry) {
-	/* Get the continent code */
-	if(continent_code && (status = MMDB_get_value(&result.entry, &entry_data, "continent", "code", NULL)) == MMDB_SUCCESS) {
-	  if(entry_data.has_data && entry_data.type == MMDB_DATA_TYPE_UTF8_STRING) {
-	    if((cdata = (char*)calloc(1, entry_data.data_size + 1))) {
-	      memcpy(cdata, entry_data.utf8_string, entry_data.data_size);
-	      free(*continent_code);
-	      *continent_code = cdata;
-	    }
-	  }
-	}
+	if(result.found_entry) {
+	  const char * const continent_path[] = { "continent", "code", NULL };
+	  const char * const country_path[]   = { "country", "iso_code", NULL };
+	  /* Seems that there are only localized versions of the city name */
+	  const char * const city_path[]      = { "city", "names", "en", NULL };
 
-	/* Get the country code */
-	if(country_code && (status = MMDB_get_value(&result.entry, &entry_data, "country", "iso_code", NULL)) == MMDB_SUCCESS) {
-	  if(entry_data.has_data && entry_data.type == MMDB_DATA_TYPE_UTF8_STRING) {
-	    if((cdata = (char*)calloc(1, entry_data.data_size + 1))) {
-	      memcpy(cdata, entry_data.utf8_string, entry_data.data_size);
-	      free(*country_code);
-	      *country_code = cdata;
-	    }
-	  }
-	}
+	  if(getString(&result.entry, continent_path, continent_buf, sizeof(continent_buf)))
+	    info.continent_code = continent_buf;
 
-	/* Get the city (seems that there are only localized versions of the city name) */
-	if(city && (status = MMDB_get_value(&result.entry, &entry_data, "city", "names", "en", NULL)) == MMDB_SUCCESS) {
-	  if(entry_data.has_data && entry_data.type == MMDB_DATA_TYPE_UTF8_STRING) {
-	    if((cdata = (char*)calloc(1, entry_data.data_size + 1))) {
-	      memcpy(cdata, entry_data.utf8_string, entry_data.data_size);
-	      free(*city);
-	      *city = cdata;
-	    }
-	  }
-	}
+	  if(getString(&result.entry, country_path, country_buf, sizeof(country_buf)))
+	    info.country_code = country_buf;
 
-	/* Get the latitude */
-	if(latitude && (status = MMDB_get_value(&result.entry, &entry_data, "location", "latitude", NULL)) == MMDB_SUCCESS) {
-	  if(entry_data.has_data && entry_data.type == MMDB_DATA_TYPE_DOUBLE)
-	    *latitude = (float)entry_data.double_value;
-	}
+	  if(getString(&result.entry, city_path, city_buf, sizeof(city_buf)))
+	    info.city = city_buf;
+
+	  if((MMDB_get_value(&result.entry, &entry_data, "location", "latitude", NULL) == MMDB_SUCCESS)
+	     && entry_data.has_data && (entry_data.type == MMDB_DATA_TYPE_DOUBLE))
+	    info.latitude = (float)entry_data.double_value;
 
-	/* Get the longitude */
-	if(longitude && (status = MMDB_get_value(&result.entry, &entry_data, "location", "longitude", NULL)) == MMDB_SUCCESS) {
-	  if(entry_data.has_data && entry_data.type == MMDB_DATA_TYPE_DOUBLE)
-	    *longitude = (float)entry_data.double_value;
+	  if((MMDB_get_value(&result.entry, &entry_data, "location", "longitude", NULL) == MMDB_SUCCESS)
+	     && entry_data.has_data && (entry_data.type == MMDB_DATA_TYPE_DOUBLE))
+	    info.longitude = (float)entry_data.double_value;
 	}
+
+	cache.addGeo(addr, getPrefixLen(addr, &geo_ip_city_mmdb, &result), &info);
       }
-    }
 
-    free(sa);
-  } else {
-    char buf[64];
+      free(sa);
+    } else {
+      char buf[64];
 
-    ntop->getTrace()->traceEvent(TRACE_ERROR, "Invalid address lookup [addr addr: 0x%X][addr: %s][version: %u]",
-				 addr ? addr : 0,
-				 addr ? addr->print(buf, sizeof(buf)) : "",
-				 addr ? addr->getVersion() : 0);
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Invalid address lookup [addr addr: 0x%X][addr: %s][version: %u]",
+				   addr ? addr : 0,
+				   addr ? addr->print(buf, sizeof(buf)) : "",
+				   addr ? addr->getVersion() : 0);
+    }
   }
 #endif
 
-  return;
-}
-
-
-/* *************************************** */
-
-void Geolocation::freeInfo(char **continent_code, char **country_code, char **city) {
-  if(continent_code) { free(*continent_code); *continent_code = NULL; }
-  if(country_code)   { free(*country_code);   *country_code = NULL;   }
-  if(city)           { free(*city);           *city = NULL;           }
+  /* Interning failures leave NULL strings behind */
+  if(continent_code) *continent_code = info.continent_code ? info.continent_code : UNKNOWN_CONTINENT;
+  if(country_code)   *country_code = info.country_code ? info.country_code : UNKNOWN_COUNTRY;
+  if(city)           *city = info.city ? info.city : UNKNOWN_CITY;
+  if(latitude)       *latitude = info.latitude;
+  if(longitude)      *longitude = info.longitude;
 }
 
 /* *************************************** */
@@ -0,0 +1,236 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+GeolocationCache::GeolocationCache(u_int32_t _max_ranges) {
+  max_ranges = _max_ranges, interned_bytes = 0;
+  as_hits = as_misses = geo_hits = geo_misses = num_flushes = 0;
+  as_copy_bytes = geo_copy_bytes = 0;
+}
+
+/* **************************************************** */
+
+bool GeolocationCache::getKey(IpAddress *addr, GeoCacheKey *key) {
+  memset(key, 0, sizeof(*key));
+
+  if(addr->isIPv4()) {
+    key->version = 4, key->lo = ntohl(addr->get_ipv4());
+  } else if(addr->get_ipv6()) {
+    const u_int8_t *b = (const u_int8_t*)addr->get_ipv6();
+
+    key->version = 6;
+    for(u_int i = 0; i < 8; i++)
+      key->hi = (key->hi << 8) | b[i], key->lo = (key->lo << 8) | b[8 + i];
+  } else
+    return(false);
+
+  return(true);
+}
+
+/* **************************************************** */
+
+void GeolocationCache::getRange(IpAddress *addr, u_int8_t prefix_len, GeoCacheKey *first, GeoCacheKey *last) {
+  u_int8_t host_bits;
+  u_int64_t hi_mask, lo_mask;
+
+  getKey(addr, first);
+
+  if(first->version == 4)
+    host_bits = 32 - min_val(prefix_len, 32);
+  else
+    host_bits = 128 - min_val(prefix_len, 128);
+
+  /* Host part of the address, split between the two halves */
+  lo_mask = (host_bits >= 64) ? ~(u_int64_t)0 : (((u_int64_t)1 << host_bits) - 1);
+  hi_mask = (host_bits <= 64) ? 0 : ((host_bits >= 128) ? ~(u_int64_t)0 : (((u_int64_t)1 << (host_bits - 64)) - 1));
+
+  first->hi &= ~hi_mask, first->lo &= ~lo_mask;
+  *last = *first;
+  last->hi |= hi_mask, last->lo |= lo_mask;
+}
+
+/* **************************************************** */
+
+template <typename T> bool GeolocationCache::find(std::map<GeoCacheKey, Range<T> > &ranges, IpAddress *addr, T *info) {
+  typename std::map<GeoCacheKey, Range<T> >::iterator it;
+  GeoCacheKey key;
+  bool found = false;
+
+  if(!getKey(addr, &key))
+    return(false);
+
+  lock.rdlock(__FILE__, __LINE__);
+
+  /* The candidate is the last range starting at or before the address */
+  if((it = ranges.upper_bound(key)) != ranges.begin()) {
+    --it;
+
+    if(key <= it->second.last)
+      *info = it->second.info, found = true;
+  }
+
+  lock.unlock(__FILE__, __LINE__);
+
+  return(found);
+}
+
+/* **************************************************** */
+
+/* Must be called with lock held for writing */
+const char* GeolocationCache::intern(const char *str) {
+  std::pair<std::set<std::string>::iterator, bool> rc;
+
+  if(str == NULL)
+    return(NULL);
+
+  try {
+    rc = strings.insert(std::string(str));
+  } catch(std::bad_alloc& ba) {
+    return(NULL);
+  }
+
+  if(rc.second)
+    interned_bytes += sizeof(std::string) + rc.first->capacity() + 1 + 32 /* Tree node */;
+
+  return(rc.first->c_str());
+}
+
+/* **************************************************** */
+
+const char* GeolocationCache::internString(const char *str) {
+  const char *rc;
+
+  lock.wrlock(__FILE__, __LINE__);
+  rc = intern(str);
+  lock.unlock(__FILE__, __LINE__);
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+template <typename T> void GeolocationCache::add(std::map<GeoCacheKey, Range<T> > &ranges, IpAddress *addr, u_int8_t prefix_len, const T *info) {
+  GeoCacheKey first;
+  Range<T> range;
+
+  getRange(addr, prefix_len, &first, &range.last);
+  range.info = *info;
+
+  /* Bound the memory: start over when full, interned strings are kept */
+  if(ranges.size() >= max_ranges)
+    ranges.clear(), num_flushes++;
+
+  try {
+    ranges[first] = range;
+  } catch(std::bad_alloc& ba) {
+    ;
+  }
+}
+
+/* **************************************************** */
+
+bool GeolocationCache::findAS(IpAddress *addr, ASInfo *info) {
+  bool rc = find(as_ranges, addr, info);
+
+  if(rc)
+    as_hits++, as_copy_bytes += copyBytes(info->asname);
+  else
+    as_misses++;
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+bool GeolocationCache::findGeo(IpAddress *addr, GeoInfo *info) {
+  bool rc = find(geo_ranges, addr, info);
+
+  if(rc)
+    geo_hits++, geo_copy_bytes += copyBytes(info->continent_code) + copyBytes(info->country_code) + copyBytes(info->city);
+  else
+    geo_misses++;
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+void GeolocationCache::addAS(IpAddress *addr, u_int8_t prefix_len, ASInfo *info) {
+  lock.wrlock(__FILE__, __LINE__);
+  info->asname = intern(info->asname);
+  add(as_ranges, addr, prefix_len, info);
+  lock.unlock(__FILE__, __LINE__);
+
+  as_copy_bytes += copyBytes(info->asname);
+}
+
+/* **************************************************** */
+
+void GeolocationCache::addGeo(IpAddress *addr, u_int8_t prefix_len, GeoInfo *info) {
+  lock.wrlock(__FILE__, __LINE__);
+  info->continent_code = intern(info->continent_code);
+  info->country_code = intern(info->country_code);
+  info->city = intern(info->city);
+  add(geo_ranges, addr, prefix_len, info);
+  lock.unlock(__FILE__, __LINE__);
+
+  geo_copy_bytes += copyBytes(info->continent_code) + copyBytes(info->country_code) + copyBytes(info->city);
+}
+
+/* **************************************************** */
+
+void GeolocationCache::lua(lua_State *vm) {
+  u_int64_t as_lookups = as_hits + as_misses, geo_lookups = geo_hits + geo_misses;
+  u_int64_t num_as_ranges, num_geo_ranges, num_strings, strings_bytes;
+  double per_host_bytes, saved;
+
+  lock.rdlock(__FILE__, __LINE__);
+  num_as_ranges = as_ranges.size(), num_geo_ranges = geo_ranges.size();
+  num_strings = strings.size(), strings_bytes = interned_bytes;
+  lock.unlock(__FILE__, __LINE__);
+
+  /*
+    Every host used to hold private copies of its strings: one AS and one
+    geolocation lookup per host, against a single interned copy
+  */
+  per_host_bytes = (as_lookups ? ((double)as_copy_bytes / as_lookups) : 0)
+    + (geo_lookups ? ((double)geo_copy_bytes / geo_lookups) : 0);
+  saved = per_host_bytes * 1000000 - strings_bytes;
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "as.hits", as_hits);
+  lua_push_uint64_table_entry(vm, "as.misses", as_misses);
+  lua_push_float_table_entry(vm, "as.hit_rate", as_lookups ? ((float)as_hits * 100) / as_lookups : 0);
+  lua_push_uint64_table_entry(vm, "as.num_networks", num_as_ranges);
+  lua_push_uint64_table_entry(vm, "geo.hits", geo_hits);
+  lua_push_uint64_table_entry(vm, "geo.misses", geo_misses);
+  lua_push_float_table_entry(vm, "geo.hit_rate", geo_lookups ? ((float)geo_hits * 100) / geo_lookups : 0);
+  lua_push_uint64_table_entry(vm, "geo.num_networks", num_geo_ranges);
+  lua_push_uint64_table_entry(vm, "num_flushes", num_flushes);
+  lua_push_uint64_table_entry(vm, "num_interned_strings", num_strings);
+  lua_push_uint64_table_entry(vm, "interned_bytes", strings_bytes);
+  lua_push_uint64_table_entry(vm, "bytes_per_host_without_interning", (u_int64_t)per_host_bytes);
+  lua_push_uint64_table_entry(vm, "bytes_saved_per_million_hosts", (saved > 0) ? (u_int64_t)saved : 0);
+}
@@ -1150,6 +1150,13 @@ static int handle_lua_request(struct mg_connection *conn) {
       redirect_to_login(conn, request_info, (referer[0] == '\0') ? NULL : referer);
       if(original_uri) request_info->uri  = original_uri;
       return(0);
+    } else if((strcmp(request_info->uri, "/metrics") == 0)
+	      && !(request_info->query_string && strstr(request_info->query_string, "engine=lua"))) {
+      /* Rendered natively; ?engine=lua still runs the script, e.g. to compare the outputs */
+      int rc = httpserver->serveMetrics(conn, username);
+
+      if(original_uri) request_info->uri  = original_uri;
+      return(rc);
     } else {
       if(strcmp(request_info->uri, "/metrics") == 0)
 	snprintf(path, sizeof(path), "%s/lua/metrics.lua",
@@ -1171,13 +1178,14 @@ static int handle_lua_request(struct mg_connection *conn) {
     }
 
     if(found) {
+      struct timeval begin, end;
       LuaEngine *l;
 
       ntop->getTrace()->traceEvent(TRACE_INFO, "[HTTP] %s [%s]", request_info->uri, path);
 
-      try {
-	l = new LuaEngine(NULL);
-      } catch(std::bad_alloc& ba) {
+      gettimeofday(&begin, NULL);
+
+      if((l = httpserver->leaseLuaEngine()) == NULL) {
 	ntop->getTrace()->traceEvent(TRACE_ERROR, "[HTTP] Unable to start Lua interpreter.");
 	if(original_uri) request_info->uri  = original_uri;
 	return(send_error(conn, 500 /* Internal server error */,
@@ -1187,7 +1195,8 @@ static int handle_lua_request(struct mg_connection *conn) {
       bool attack_attempt;
 
       // NOTE: username is stored into the engine context, so we must guarantee
-      // that LuaEngine is destroyed after username goes out of context! Indeeed we delete LuaEngine below.
+      // that LuaEngine is released after username goes out of context! Indeeed we release LuaEngine below,
+      // which also clears the context of pooled engines.
       l->handle_script_request(conn, request_info, path, &attack_attempt, username, group, csrf, localuser);
 
       if(attack_attempt) {
@@ -1198,7 +1207,9 @@ static int handle_lua_request(struct mg_connection *conn) {
 				     request_info->uri);
       }
 
-      delete l;
+      gettimeofday(&end, NULL);
+      httpserver->releaseLuaEngine(l, request_info->uri, &begin, &end);
+
       if(original_uri) request_info->uri  = original_uri;
       return(1); /* Handled */
     }
@@ -1385,6 +1396,10 @@ HTTPserver::HTTPserver(const char *_docs_dir, const char *_scripts_dir) {
   can_accept_requests = false;
   httpd_v4 = NULL;
 
+  /* One prepared Lua engine per HTTP thread */
+  vm_pool = new (std::nothrow) LuaVMPool(HTTP_NUM_THREADS);
+  metrics_exporter = new (std::nothrow) PrometheusExporter();
+
   cur_http_options = 0;
 
   /* Build the URL rewrite pattern, required to handle the additional
@@ -1401,7 +1416,8 @@ HTTPserver::HTTPserver(const char *_docs_dir, const char *_scripts_dir) {
   addHTTPOption("url_rewrite_patterns", plugins_httpdocs_rewrite);
   addHTTPOption("access_control_list", acl_management);
   /* (char*)"extra_mime_types", (char*)"" */ /* see mongoose.c */
-  addHTTPOption("num_threads", "5");
+  snprintf(num_threads, sizeof(num_threads), "%u", HTTP_NUM_THREADS);
+  addHTTPOption("num_threads", num_threads);
 
   /* Randomize data */
   gettimeofday(&tv, NULL);
@@ -1549,6 +1565,8 @@ HTTPserver::~HTTPserver() {
   if(httpd_captive_v4) mg_stop(httpd_captive_v4);
 #endif
 
+  if(vm_pool)            delete vm_pool;
+  if(metrics_exporter)   delete metrics_exporter;
   if(wispr_captive_data) free(wispr_captive_data);
   if(captive_redirect_addr) free(captive_redirect_addr);
   free(docs_dir), free(scripts_dir);
@@ -1646,3 +1664,70 @@ void HTTPserver::addHTTPOption(const char *k, const char*v) {
 bool HTTPserver::accepts_requests() {
   return(can_accept_requests && !ntop->getGlobals()->isShutdown());
 };
+
+/* ****************************************** */
+
+void HTTPserver::start_accepting_requests() {
+  /* Engines are prepared now that startup.lua has completed */
+  if(vm_pool) vm_pool->prewarm();
+
+  can_accept_requests = true;
+}
+
+/* ****************************************** */
+
+LuaEngine* HTTPserver::leaseLuaEngine() {
+  if(vm_pool)
+    return(vm_pool->lease());
+
+  try {
+    return(new LuaEngine(NULL));
+  } catch(std::bad_alloc& ba) {
+    return(NULL);
+  }
+}
+
+/* ****************************************** */
+
+void HTTPserver::releaseLuaEngine(LuaEngine *l, const char *endpoint,
+				  const struct timeval *begin, const struct timeval *end) {
+  if(vm_pool)
+    vm_pool->release(l, endpoint, begin, end);
+  else
+    delete l;
+}
+
+/* ****************************************** */
+
+void HTTPserver::luaEngines(lua_State *vm) {
+  if(vm_pool)
+    vm_pool->lua(vm);
+  else
+    lua_pushnil(vm);
+}
+
+/* ****************************************** */
+
+int HTTPserver::serveMetrics(struct mg_connection *conn, const char * const username) {
+  if(metrics_exporter) {
+    char allowed_ifname[MAX_INTERFACE_NAME_LEN];
+
+    /* Users bound to an interface only see the metrics of that interface */
+    if(!ntop->getUserAllowedIfname(username, allowed_ifname, sizeof(allowed_ifname)))
+      allowed_ifname[0] = '\0';
+
+    return(metrics_exporter->serve(conn, allowed_ifname));
+  }
+
+  return(send_error(conn, 500 /* Internal server error */,
+		    "Internal server error", "%s", "Metrics exporter not available"));
+}
+
+/* ****************************************** */
+
+void HTTPserver::luaMetricsExporter(lua_State *vm) {
+  if(metrics_exporter)
+    metrics_exporter->lua(vm);
+  else
+    lua_pushnil(vm);
+}
@@ -407,6 +407,51 @@ void HTTPstats::deserialize(json_object *my_object) {
 
 /* ******************************************* */
 
+void HTTPstats::serializeBinary(BinarySerializer *s) const {
+  for(u_int8_t d = AS_SENDER; d <= AS_RECEIVER; d++) {
+    const struct http_query_stats    *q  = &query[d];
+    const struct http_response_stats *r  = &response[d];
+    const struct http_query_rates    *dq = &query_rate[d];
+    const struct http_response_rates *dr = &response_rate[d];
+
+    s->putVarint(q->num_get), s->putVarint(q->num_post), s->putVarint(q->num_head),
+      s->putVarint(q->num_put), s->putVarint(q->num_other);
+    s->putVarint(r->num_1xx), s->putVarint(r->num_2xx), s->putVarint(r->num_3xx),
+      s->putVarint(r->num_4xx), s->putVarint(r->num_5xx);
+    s->putVarint(dq->rate_get), s->putVarint(dq->rate_post), s->putVarint(dq->rate_head),
+      s->putVarint(dq->rate_put), s->putVarint(dq->rate_other);
+    s->putVarint(dr->rate_1xx), s->putVarint(dr->rate_2xx), s->putVarint(dr->rate_3xx),
+      s->putVarint(dr->rate_4xx), s->putVarint(dr->rate_5xx);
+  }
+}
+
+/* ******************************************* */
+
+void HTTPstats::deserializeBinary(BinaryDeserializer *bd) {
+  for(u_int8_t d = AS_SENDER; d <= AS_RECEIVER; d++) {
+    struct http_query_stats    *q  = &query[d];
+    struct http_response_stats *r  = &response[d];
+    struct http_query_rates    *dq = &query_rate[d];
+    struct http_response_rates *dr = &response_rate[d];
+
+    q->num_get = bd->getVarint(), q->num_post = bd->getVarint(), q->num_head = bd->getVarint(),
+      q->num_put = bd->getVarint(), q->num_other = bd->getVarint();
+    r->num_1xx = bd->getVarint(), r->num_2xx = bd->getVarint(), r->num_3xx = bd->getVarint(),
+      r->num_4xx = bd->getVarint(), r->num_5xx = bd->getVarint();
+    dq->rate_get = bd->getVarint(), dq->rate_post = bd->getVarint(), dq->rate_head = bd->getVarint(),
+      dq->rate_put = bd->getVarint(), dq->rate_other = bd->getVarint();
+    dr->rate_1xx = bd->getVarint(), dr->rate_2xx = bd->getVarint(), dr->rate_3xx = bd->getVarint(),
+      dr->rate_4xx = bd->getVarint(), dr->rate_5xx = bd->getVarint();
+  }
+
+  /* As in deserialize(): rates restart from the restored counters */
+  memcpy(&last_query_sample,    &query,    sizeof(query));
+  memcpy(&last_response_sample, &response, sizeof(response));
+  gettimeofday(&last_update_time, NULL);
+}
+
+/* ******************************************* */
+
 void HTTPstats::JSONObjectAddRates(json_object *my_object, bool as_sender) {
   u_int16_t rate_get = 0, rate_post = 0, rate_head = 0, rate_put = 0, rate_other = 0;
   u_int16_t rate_1xx = 0, rate_2xx  = 0, rate_3xx  = 0, rate_4xx = 0, rate_5xx   = 0;
@@ -179,17 +179,19 @@ void Host::initialize(Mac *_mac, u_int16_t _vlanId, bool init_all) {
   PROFILING_SUB_SECTION_EXIT(iface, 17);
 
   if(init_all && ip.getVersion() /* IP is set */) {
-    char country_name[64];
-    
+    const char *country_name = NULL;
+
     if((as = iface->getAS(&ip, true /* Create if missing */, true /* Inline call */)) != NULL) {
       as->incUses();
       asn = as->get_asn();
       asname = as->get_asname();
     }
 
-    get_country(country_name, sizeof(country_name));
+    /* Shared string, as the one of the AS */
+    ntop->getGeolocation()->getInfo(&ip, NULL, &country_name, NULL, NULL, NULL);
 
-    if((country = iface->getCountry(country_name, true /* Create if missing */, true /* Inline call */ )) != NULL)
+    if((country = iface->getCountry(country_name ? country_name : UNKNOWN_COUNTRY,
+				    true /* Create if missing */, true /* Inline call */ )) != NULL)
       country->incUses();
   }
 
@@ -454,7 +456,7 @@ void Host::lua_get_min_info(lua_State *vm) const {
 /* ***************************************************** */
 
 void Host::lua_get_geoloc(lua_State *vm) {
-  char *continent = NULL, *country_name = NULL, *city = NULL;
+  const char *continent = NULL, *country_name = NULL, *city = NULL;
   float latitude = 0, longitude = 0;
 
   ntop->getGeolocation()->getInfo(&ip, &continent, &country_name, &city, &latitude, &longitude);
@@ -463,7 +465,6 @@ void Host::lua_get_geoloc(lua_State *vm) {
   lua_push_float_table_entry(vm, "latitude", latitude);
   lua_push_float_table_entry(vm, "longitude", longitude);
   lua_push_str_table_entry(vm,   "city", city ? city : (char*)"");
-  ntop->getGeolocation()->freeInfo(&continent, &country_name, &city);
 }
 
 /* ***************************************************** */
@@ -608,7 +609,7 @@ void Host::lua(lua_State* vm, AddressTree *ptree,
   lua_push_uint64_table_entry(vm, "vlan", vlan_id);
   lua_push_bool_table_entry(vm, "hiddenFromTop", isHiddenFromTop());
 
-  lua_push_uint64_table_entry(vm, "ipkey", ip.key());
+  lua_push_uint64_table_entry(vm, "ipkey", ip.sortKey());
   lua_push_str_table_entry(vm, "tskey", get_tskey(buf_id, sizeof(buf_id)));
 
   lua_push_str_table_entry(vm, "name", get_visual_name(buf, sizeof(buf)));
@@ -835,9 +836,7 @@ const char * Host::getOSDetail(char * const buf, ssize_t buf_len) {
 
 /* ***************************************** */
 
-bool Host::is_hash_entry_state_idle_transition_ready() const {
-  u_int32_t max_idle;
-
+u_int32_t Host::getMaxIdle() const {
   /*
     Idle transition should only be allowed if host has NO alerts engaged.
     This is to always keep in-memory hosts with ongoing issues.
@@ -856,12 +855,16 @@ bool Host::is_hash_entry_state_idle_transition_ready() const {
   */
 
   if(getNumEngagedAlerts() > 0)
-    max_idle = ntop->getPrefs()->get_alerted_host_max_idle();
+    return(ntop->getPrefs()->get_alerted_host_max_idle());
   else
-    max_idle = ntop->getPrefs()->get_host_max_idle(isLocalHost());
+    return(ntop->getPrefs()->get_host_max_idle(isLocalHost()));
+}
 
+/* *************************************** */
+
+bool Host::is_hash_entry_state_idle_transition_ready() const {
   bool res = (getUses() == 0)
-    && is_active_entry_now_idle(max_idle);
+    && is_active_entry_now_idle(getMaxIdle());
 
 #if DEBUG_HOST_IDLE_TRANSITION
   char buf[64];
@@ -1022,6 +1025,10 @@ void Host::incNumFlows(time_t t, bool as_client) {
     num_active_flows_as_server++;
   }
 
+  /* Flows restored from a snapshot are already accounted in the restored counters (local hosts only) */
+  if(iface->isRestoringSnapshot() && isLocalHost())
+    return;
+
   counter->inc(t, this);
   stats->incNumFlows(as_client);
 }
@@ -1247,47 +1254,38 @@ void Host::setResolvedName(const char * const resolved_name) {
 /* *************************************** */
 
 char* Host::get_country(char *buf, u_int buf_len) {
-  char *continent = NULL, *country_name = NULL, *city = NULL;
-  float latitude = 0, longitude = 0;
+  const char *country_name = NULL;
 
-  ntop->getGeolocation()->getInfo(&ip, &continent, &country_name, &city, &latitude, &longitude);
+  ntop->getGeolocation()->getInfo(&ip, NULL, &country_name, NULL, NULL, NULL);
 
   if(country_name)
     snprintf(buf, buf_len, "%s", country_name);
   else
     buf[0] = '\0';
 
-  ntop->getGeolocation()->freeInfo(&continent, &country_name, &city);
-
   return(buf);
 }
 
 /* *************************************** */
 
 char* Host::get_city(char *buf, u_int buf_len) {
-  char *continent = NULL, *country_name = NULL, *city = NULL;
-  float latitude = 0, longitude = 0;
+  const char *city = NULL;
 
-  ntop->getGeolocation()->getInfo(&ip, &continent, &country_name, &city, &latitude, &longitude);
+  ntop->getGeolocation()->getInfo(&ip, NULL, NULL, &city, NULL, NULL);
 
   if(city) {
     snprintf(buf, buf_len, "%s", city);
   } else
     buf[0] = '\0';
 
-  ntop->getGeolocation()->freeInfo(&continent, &country_name, &city);
-
   return(buf);
 }
 
 /* *************************************** */
 
 void Host::get_geocoordinates(float *latitude, float *longitude) {
-  char *continent = NULL, *country_name = NULL, *city = NULL;
-
   *latitude = 0, *longitude = 0;
-  ntop->getGeolocation()->getInfo(&ip, &continent, &country_name, &city, latitude, longitude);
-  ntop->getGeolocation()->freeInfo(&continent, &country_name, &city);
+  ntop->getGeolocation()->getInfo(&ip, NULL, NULL, NULL, latitude, longitude);
 }
 
 /* *************************************** */
@@ -31,7 +31,7 @@ HostHash::HostHash(NetworkInterface *_iface, u_int _num_hashes, u_int _max_hash_
 /* ************************************ */
 
 Host* HostHash::get(u_int16_t vlanId, IpAddress *key, bool is_inline_call) {
-  u_int32_t hash = (key->key() % num_hashes);
+  u_int32_t hash = bucketId(key->key());
 
   if(table[hash] == NULL) {
     return(NULL);
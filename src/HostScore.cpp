@@ -48,7 +48,8 @@ u_int32_t HostScore::sum(bool as_client) const {
   NOTE: The actual increment performed can be less than `score`, if incrementing by `score` would have
   caused an overflow.
 
-  HostScore::incValue must be called from the same thread of HostScore::decValue to prevent races.
+  The mutex serializes the updates performed by the flow hooks workers, which can run concurrently
+  for flows sharing the same host.
 */
 u_int16_t HostScore::incValue(u_int16_t score, ScoreCategory score_category, bool as_client) {
   u_int16_t *dst = as_client ? cli_score : srv_score;
@@ -82,7 +83,8 @@ u_int16_t HostScore::incValue(u_int16_t score, ScoreCategory score_category, boo
   according to parameter `as_client`. The actual decrement performed is returned by the function.
   NOTE: The actual decrement is either `score` or zero if `score_category` is unknown.
 
-  HostScore::decValue must be called from the same thread of HostScore::incValue to prevent races.
+  The mutex serializes the updates performed by the flow hooks workers, which can run concurrently
+  for flows sharing the same host.
 */
 u_int16_t HostScore::decValue(u_int16_t score, ScoreCategory score_category, bool as_client) {
   u_int16_t *dst = as_client ? cli_score : srv_score;
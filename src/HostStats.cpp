@@ -62,6 +62,24 @@ HostStats::~HostStats() {
 
 /* *************************************** */
 
+void HostStats::sum(HostStats *s) const {
+  time_t now = time(NULL);
+
+  s->sent.incStats(now, sent.getNumPkts(), sent.getNumBytes());
+  s->rcvd.incStats(now, rcvd.getNumPkts(), rcvd.getNumBytes());
+  if(ndpiStats && s->ndpiStats) ndpiStats->sum(s->ndpiStats);
+
+  s->total_num_flows_as_client += total_num_flows_as_client, s->total_num_flows_as_server += total_num_flows_as_server;
+  s->alerted_flows_as_client += alerted_flows_as_client, s->alerted_flows_as_server += alerted_flows_as_server;
+  s->unreachable_flows_as_client += unreachable_flows_as_client, s->unreachable_flows_as_server += unreachable_flows_as_server;
+  s->host_unreachable_flows_as_client += host_unreachable_flows_as_client,
+    s->host_unreachable_flows_as_server += host_unreachable_flows_as_server;
+  s->total_num_dropped_flows += total_num_dropped_flows;
+  s->udp_sent_unicast += udp_sent_unicast, s->udp_sent_non_unicast += udp_sent_non_unicast;
+}
+
+/* *************************************** */
+
 /* NOTE: this function is used by Lua to create the minute-by-minute host top talkers,
    both for remote and local hosts. Top talkerts are created by doing a checkpoint
    of the current value. */
@@ -187,17 +187,8 @@ bool IpAddress::isLocalInterfaceAddress() {
   bool systemHost;
 
   if(addr.ipVersion == 4) {
-    ip_key = ntohl(addr.ipType.ipv4);
-
     systemHost = ntop->isLocalInterfaceAddress(AF_INET, &addr.ipType.ipv4);
   } else if(addr.ipVersion == 6) {
-    u_int32_t key = 0;
-
-    for(u_int32_t i=0; i<4; i++)
-      key += addr.ipType.ipv6.u6_addr.u6_addr32[i];
-
-    ip_key = key;
-
     systemHost = ntop->isLocalInterfaceAddress(AF_INET6, &addr.ipType.ipv6);
   } else
     systemHost = false;
@@ -207,16 +198,35 @@ bool IpAddress::isLocalInterfaceAddress() {
 
 /* ******************************************* */
 
+/*
+  Unlike key(), which is randomized at startup, this is stable and, for
+  IPv4, follows the numeric order of the addresses. Used to sort by IP.
+*/
+u_int32_t IpAddress::sortKey() const {
+  u_int32_t k = 0;
+
+  if(addr.ipVersion == 4)
+    k = ntohl(addr.ipType.ipv4);
+  else if(addr.ipVersion == 6) {
+    for(u_int32_t i=0; i<4; i++)
+      k += addr.ipType.ipv6.u6_addr.u6_addr32[i];
+  }
+
+  return(k);
+}
+
+/* ******************************************* */
+
 void IpAddress::compute_key() {
   checkIP();
 
   if(addr.ipVersion == 4) {
-    ip_key = ntohl(addr.ipType.ipv4);
+    ip_key = Utils::keyedHash((u_int64_t)ntohl(addr.ipType.ipv4));
   } else if(addr.ipVersion == 6) {
-    ip_key = 0;
+    u_int64_t v[2];
 
-    for(u_int32_t i=0; i<4; i++)
-      ip_key += addr.ipType.ipv6.u6_addr.u6_addr32[i];
+    memcpy(v, &addr.ipType.ipv6, sizeof(v));
+    ip_key = Utils::keyedHash(v[0], v[1]);
   }
 }
 
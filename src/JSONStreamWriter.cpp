@@ -0,0 +1,438 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+static const char *json_hex_chars = "0123456789abcdef";
+
+/* **************************************************** */
+
+JSONStreamWriter::JSONStreamWriter(u_int32_t initial_size) {
+  size = max_val(initial_size, 64);
+
+  if((buf = (char*)malloc(size)) == NULL)
+    size = 0;
+
+  cached_tstamp = 0, cached_tstamp_str[0] = '\0';
+  to_object = false, root = NULL;
+  reset();
+}
+
+/* **************************************************** */
+
+JSONStreamWriter::~JSONStreamWriter() {
+  if(buf)  free(buf);
+  if(root) json_object_put(root);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::reset() {
+  if(root) {
+    json_object_put(root);
+    root = NULL;
+  }
+
+  to_object = false;
+  len = 0, depth = 0, failed = (buf == NULL);
+  if(buf) buf[0] = '\0';
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::resetObject() {
+  reset();
+  to_object = true, failed = false;
+}
+
+/* **************************************************** */
+
+json_object* JSONStreamWriter::getObject() {
+  json_object *o = root;
+
+  if(!to_object)
+    return(NULL);
+
+  root = NULL;
+
+  if(failed && o) {
+    json_object_put(o);
+    o = NULL;
+  }
+
+  return(o);
+}
+
+/* **************************************************** */
+
+/* Adds a value to the current object (or array) of the json-c document */
+void JSONStreamWriter::attach(const char *k, json_object *v) {
+  json_object *parent;
+
+  if(depth == 0) {
+    if(root) json_object_put(root);
+    root = v;
+    return;
+  }
+
+  parent = objects[depth - 1];
+
+  if(json_object_is_type(parent, json_type_array))
+    json_object_array_add(parent, v);
+  else
+    json_object_object_add(parent, k, v);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::openContainer(const char *k, json_object *c) {
+  if(!c) {
+    failed = true;
+    return;
+  }
+
+  attach(k, c);
+  objects[depth] = c;
+  has_items[depth++] = false;
+}
+
+/* **************************************************** */
+
+bool JSONStreamWriter::grow(u_int32_t needed) {
+  u_int32_t new_size;
+  char *new_buf;
+
+  if(failed)
+    return(false);
+
+  new_size = max_val(size, 64);
+  while(len + needed >= new_size)
+    new_size *= 2;
+
+  if((new_buf = (char*)realloc(buf, new_size)) == NULL) {
+    failed = true;
+    return(false);
+  }
+
+  buf = new_buf, size = new_size;
+  return(true);
+}
+
+/* **************************************************** */
+
+/* Same escaping as json-c json_escape_str(), including the forward slash */
+void JSONStreamWriter::appendEscaped(const char *s) {
+  const char *start = s;
+  unsigned char c;
+
+  for(; (c = (unsigned char)*s) != '\0'; s++) {
+    char esc[6];
+    u_int8_t esc_len = 2;
+
+    switch(c) {
+    case '\b': esc[1] = 'b';  break;
+    case '\n': esc[1] = 'n';  break;
+    case '\r': esc[1] = 'r';  break;
+    case '\t': esc[1] = 't';  break;
+    case '\f': esc[1] = 'f';  break;
+    case '"':  esc[1] = '"';  break;
+    case '\\': esc[1] = '\\'; break;
+    case '/':  esc[1] = '/';  break;
+    default:
+      if(c >= ' ')
+	continue;
+
+      esc[1] = 'u', esc[2] = '0', esc[3] = '0';
+      esc[4] = json_hex_chars[c >> 4], esc[5] = json_hex_chars[c & 0xf];
+      esc_len = 6;
+    }
+
+    esc[0] = '\\';
+
+    if(s > start) append(start, s - start);
+    append(esc, esc_len);
+    start = s + 1;
+  }
+
+  if(s > start) append(start, s - start);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::appendInt64(int64_t v) {
+  char digits[24], *p = &digits[sizeof(digits)];
+  u_int64_t u = (v < 0) ? (u_int64_t)0 - (u_int64_t)v : (u_int64_t)v;
+
+  do {
+    *--p = '0' + (u % 10);
+    u /= 10;
+  } while(u > 0);
+
+  if(v < 0) *--p = '-';
+
+  append(p, &digits[sizeof(digits)] - p);
+}
+
+/* **************************************************** */
+
+/* Same format as json-c json_object_double_to_json_string() */
+void JSONStreamWriter::appendDouble(double v) {
+  char tmp[128];
+  int n;
+
+  if(isnan(v))
+    n = snprintf(tmp, sizeof(tmp), "NaN");
+  else if(isinf(v))
+    n = snprintf(tmp, sizeof(tmp), (v > 0) ? "Infinity" : "-Infinity");
+  else {
+    char *p;
+
+    n = snprintf(tmp, sizeof(tmp), "%.17g", v);
+
+    if((n < 0) || (n >= (int)sizeof(tmp) - 2))
+      return;
+
+    if((p = strchr(tmp, ',')) != NULL)
+      *p = '.'; /* Locales using the decimal comma */
+
+    /* Make it look like a float */
+    if((isdigit((unsigned char)tmp[0]) || ((n > 1) && (tmp[0] == '-') && isdigit((unsigned char)tmp[1])))
+       && !p && !strchr(tmp, '.') && !strchr(tmp, 'e'))
+      tmp[n++] = '.', tmp[n++] = '0', tmp[n] = '\0';
+  }
+
+  if(n > 0)
+    append(tmp, n);
+}
+
+/* **************************************************** */
+
+/* Separator preceding a member or an array item */
+void JSONStreamWriter::item() {
+  if(depth > 0) {
+    if(has_items[depth - 1])
+      appendChar(',');
+    else
+      has_items[depth - 1] = true;
+
+    appendChar(' ');
+  }
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::key(const char *k) {
+  item();
+  appendChar('"');
+  appendEscaped(k);
+  append("\": ", 3);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::openObject(const char *k) {
+  if(depth >= JSON_STREAM_WRITER_MAX_DEPTH) {
+    failed = true;
+    return;
+  }
+
+  if(to_object) {
+    openContainer(k, json_object_new_object());
+    return;
+  }
+
+  if(k) key(k); else item();
+  appendChar('{');
+  has_items[depth++] = false;
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::closeObject() {
+  if(depth > 0) {
+    if(!to_object) append(" }", 2);
+    depth--;
+  }
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::openArray(const char *k) {
+  if(depth >= JSON_STREAM_WRITER_MAX_DEPTH) {
+    failed = true;
+    return;
+  }
+
+  if(to_object) {
+    openContainer(k, json_object_new_array());
+    return;
+  }
+
+  key(k);
+  appendChar('[');
+  has_items[depth++] = false;
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::closeArray() {
+  if(depth > 0) {
+    if(!to_object) append(" ]", 2);
+    depth--;
+  }
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::addString(const char *k, const char *v) {
+  if(to_object) {
+    attach(k, v ? json_object_new_string(v) : NULL);
+    return;
+  }
+
+  key(k);
+
+  if(v) {
+    appendChar('"');
+    appendEscaped(v);
+    appendChar('"');
+  } else
+    append("null", 4);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::addInt(const char *k, int32_t v) {
+  if(to_object) {
+    attach(k, json_object_new_int(v));
+    return;
+  }
+
+  key(k);
+  appendInt64(v);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::addInt64(const char *k, int64_t v) {
+  if(to_object) {
+    attach(k, json_object_new_int64(v));
+    return;
+  }
+
+  key(k);
+  appendInt64(v);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::addDouble(const char *k, double v) {
+  if(to_object) {
+    attach(k, json_object_new_double(v));
+    return;
+  }
+
+  key(k);
+  appendDouble(v);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::addDouble(double v) {
+  if(to_object) {
+    attach(NULL, json_object_new_double(v));
+    return;
+  }
+
+  item();
+  appendDouble(v);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::addBool(const char *k, bool v) {
+  if(to_object) {
+    attach(k, json_object_new_boolean(v ? (json_bool)1 : (json_bool)0));
+    return;
+  }
+
+  key(k);
+
+  if(v)
+    append("true", 4);
+  else
+    append("false", 5);
+}
+
+/* **************************************************** */
+
+void JSONStreamWriter::addRaw(const char *k, const char *json) {
+  if(to_object) {
+    attach(k, json ? json_tokener_parse(json) : NULL);
+    return;
+  }
+
+  key(k);
+
+  if(json)
+    append(json, strlen(json));
+  else
+    append("null", 4);
+}
+
+/* **************************************************** */
+
+const char* JSONStreamWriter::label(int id, const char *label_str, bool as_string) {
+  char *p = &label_buf[sizeof(label_buf) - 1];
+  u_int32_t u = (id < 0) ? (u_int32_t)0 - (u_int32_t)id : (u_int32_t)id;
+
+  if(as_string)
+    return(label_str);
+
+  *p = '\0';
+  do {
+    *--p = '0' + (u % 10);
+    u /= 10;
+  } while(u > 0);
+
+  if(id < 0) *--p = '-';
+
+  return(p);
+}
+
+/* **************************************************** */
+
+const char* JSONStreamWriter::timestamp(time_t t) {
+  if((t != cached_tstamp) || (cached_tstamp_str[0] == '\0')) {
+    struct tm tm_info;
+
+    /*
+      strftime in the VS2013 library and earlier are not C99-conformant,
+      as they do not accept that format-specifier: MSDN VS2013 strftime page
+
+      https://msdn.microsoft.com/en-us/library/fe06s4ak.aspx
+    */
+    strftime(cached_tstamp_str, sizeof(cached_tstamp_str), "%Y-%m-%dT%H:%M:%S.0Z", gmtime_r(&t, &tm_info));
+    cached_tstamp = t;
+  }
+
+  return(cached_tstamp_str);
+}
@@ -88,6 +88,24 @@ void L4Stats::deserialize(json_object *o) {
 
 /* **************************************************** */
 
+void L4Stats::serializeBinary(BinarySerializer *s) const {
+  tcp_sent.serializeBinary(s), tcp_rcvd.serializeBinary(s);
+  udp_sent.serializeBinary(s), udp_rcvd.serializeBinary(s);
+  icmp_sent.serializeBinary(s), icmp_rcvd.serializeBinary(s);
+  other_ip_sent.serializeBinary(s), other_ip_rcvd.serializeBinary(s);
+}
+
+/* **************************************************** */
+
+void L4Stats::deserializeBinary(BinaryDeserializer *d) {
+  tcp_sent.deserializeBinary(d), tcp_rcvd.deserializeBinary(d);
+  udp_sent.deserializeBinary(d), udp_rcvd.deserializeBinary(d);
+  icmp_sent.deserializeBinary(d), icmp_rcvd.deserializeBinary(d);
+  other_ip_sent.deserializeBinary(d), other_ip_rcvd.deserializeBinary(d);
+}
+
+/* **************************************************** */
+
 void L4Stats::incStats(time_t when, u_int8_t l4_proto,
           u_int64_t rcvd_packets, u_int64_t rcvd_bytes,
           u_int64_t sent_packets, u_int64_t sent_bytes) {
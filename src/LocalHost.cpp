@@ -51,31 +51,23 @@ LocalHost::~LocalHost() {
 /* *************************************** */
 
 void LocalHost::set_hash_entry_state_idle() {
-  /* Serialization is performed, inline, as soon as the LocalHost becomes idle, and
+  /* Serialization is requested as soon as the LocalHost becomes idle, and
      not when it is deleted. This guarantees that, if the same host becomes active again,
-     its counters will be consistent even if its other instance has still to be deleted. */
-  if(data_delete_requested)
-    deleteRedisSerialization();
-  else if((ntop->getPrefs()->is_idle_local_host_cache_enabled()
+     its counters will be consistent even if its other instance has still to be deleted.
+     The hydrator runs the jobs of an interface in order, so the new instance is restored
+     after this one has been saved. */
+  if(hydration_pending)
+    ; /* Forced idle before the cached state was merged: leave the cached state as it is */
+  else if(data_delete_requested) {
+    if(!iface->enqueueHostHydration(this, local_host_hydration_delete))
+      deleteRedisSerialization();
+  } else if((ntop->getPrefs()->is_idle_local_host_cache_enabled()
       || ntop->getPrefs()->is_active_local_host_cache_enabled())
      && (!ip.isEmpty())) {
-    Mac *mac = getMac();
     checkStatsReset();
-    serializeToRedis();
-
-    /* For LBD hosts in the DHCP range, also save the IP -> MAC
-     * association. This allows us to both search the host by IP and to
-     * bring up the host in memory with the correct stats. */
-    if(mac && serializeByMac()) {
-      char key[CONST_MAX_LEN_REDIS_KEY];
-      char buf[64], mac_buf[32];
 
-      snprintf(key, sizeof(key), IP_MAC_ASSOCIATION, iface->get_id(), ip.print(buf, sizeof(buf)), vlan_id);
-      mac->print(mac_buf, sizeof(mac_buf));
-
-      /* IP@VLAN -> MAC */
-      ntop->getRedis()->set(key, mac_buf, ntop->getPrefs()->get_local_host_cache_duration());
-    }
+    if(!iface->enqueueHostHydration(this, local_host_hydration_serialize))
+      saveCachedState();
   }
 
   iface->decNumHosts(true /* A local host */);
@@ -89,7 +81,7 @@ void LocalHost::set_hash_entry_state_idle() {
 
 /* NOTE: Host::initialize will be called from the Host initializator */
 void LocalHost::initialize() {
-  char buf[64], host[96], rsp[256];
+  char buf[64], host[96];
   
   stats = allocateStats();
   updateHostPool(true /* inline with packet processing */, true /* first inc */);
@@ -102,24 +94,14 @@ void LocalHost::initialize() {
 
   systemHost = ip.isLocalInterfaceAddress();
 
-  PROFILING_SUB_SECTION_ENTER(iface, "LocalHost::initialize: local_host_cache", 16);
-  if(ntop->getPrefs()->is_idle_local_host_cache_enabled()) {
-    if(!deserializeFromRedis())
-      deleteRedisSerialization();
-  }
-  PROFILING_SUB_SECTION_EXIT(iface, 16);
-
-  /* Clone the initial point. It will be written to the timeseries DB to
-   * address the first point problem (https://github.com/ntop/ntopng/issues/2184). */
-  initial_ts_point = new LocalHostStats(*(LocalHostStats *)stats);
+  /* The cached state is restored by hydrate(), once the host is in the hash table */
+  initial_ts_point = NULL;
+  hydration_pending = false;
   initialization_time = time(NULL);
 
   char *strIP = ip.print(buf, sizeof(buf));
   snprintf(host, sizeof(host), "%s@%u", strIP, vlan_id);
 
-  if(ntop->getPrefs()->is_dns_resolution_enabled())
-    ntop->getRedis()->getAddress(strIP, rsp, sizeof(rsp), true);
-
   PROFILING_SUB_SECTION_ENTER(iface, "LocalHost::initialize: updateHostTrafficPolicy", 18);
   updateHostTrafficPolicy(host);
   PROFILING_SUB_SECTION_EXIT(iface, 18);
@@ -137,6 +119,118 @@ void LocalHost::initialize() {
 
 /* *************************************** */
 
+void LocalHost::hydrate() {
+  SerializedState *state;
+
+  if(ntop->getPrefs()->is_idle_local_host_cache_enabled()
+     || ntop->getPrefs()->is_dns_resolution_enabled()) {
+    hydration_pending = true;
+
+    /* Counters start empty, and are merged with the cached ones by applyCachedState() */
+    if(iface->enqueueHostHydration(this, local_host_hydration_restore))
+      return;
+  }
+
+  PROFILING_SUB_SECTION_ENTER(iface, "LocalHost::hydrate: local_host_cache", 16);
+  state = loadCachedState();
+  PROFILING_SUB_SECTION_EXIT(iface, 16);
+
+  applyCachedState(state);
+  if(state) delete state;
+}
+
+/* *************************************** */
+
+/* NOTE: returned state must be deleted by the caller */
+SerializedState* LocalHost::loadCachedState() {
+  SerializedState *state = NULL;
+
+  if(ntop->getPrefs()->is_idle_local_host_cache_enabled()) {
+    char key[CONST_MAX_LEN_REDIS_KEY];
+
+    if((state = SerializableElement::readSerialization(getSerializationKey(key, sizeof(key)))) == NULL)
+      deleteRedisSerialization();
+  }
+
+  if(ntop->getPrefs()->is_dns_resolution_enabled())
+    resolveName();
+
+  return(state);
+}
+
+/* *************************************** */
+
+void LocalHost::applyCachedState(SerializedState *state) {
+  LocalHostStats *restored;
+
+  if(state && ((restored = new (std::nothrow) LocalHostStats(this)) != NULL)) {
+    bool restored_ok = true;
+
+    if(state->json) {
+      restored->deserialize(state->json);
+      deserializeLocalHost(state->json);
+    } else {
+      BinaryDeserializer d(state->binary, state->binary_len);
+
+      restored_ok = d.readHeader() && deserializeBinaryState(&d, restored);
+    }
+
+    if(restored_ok) {
+      /* The current stats can be read by other threads: swap them as done on reset */
+      stats->sum(restored);
+
+      if(stats_shadow) delete stats_shadow;
+      stats_shadow = stats, stats = restored;
+    } else {
+      char buf[64];
+
+      ntop->getTrace()->traceEvent(TRACE_INFO, "Discarding corrupted cached state of %s",
+				   ip.print(buf, sizeof(buf)));
+      delete restored;
+    }
+  }
+
+  /* Clone the initial point. It will be written to the timeseries DB to
+   * address the first point problem (https://github.com/ntop/ntopng/issues/2184). */
+  if(!initial_ts_point)
+    initial_ts_point = new LocalHostStats(*(LocalHostStats *)stats);
+
+  hydration_pending = false;
+}
+
+/* *************************************** */
+
+void LocalHost::saveCachedState() {
+  Mac *mac = getMac();
+
+  serializeToRedis();
+
+  /* For LBD hosts in the DHCP range, also save the IP -> MAC
+   * association. This allows us to both search the host by IP and to
+   * bring up the host in memory with the correct stats. */
+  if(mac && serializeByMac()) {
+    char key[CONST_MAX_LEN_REDIS_KEY];
+    char buf[64], mac_buf[32];
+
+    snprintf(key, sizeof(key), IP_MAC_ASSOCIATION, iface->get_id(), ip.print(buf, sizeof(buf)), vlan_id);
+    mac->print(mac_buf, sizeof(mac_buf));
+
+    /* IP@VLAN -> MAC */
+    ntop->getRedis()->set(key, mac_buf, ntop->getPrefs()->get_local_host_cache_duration());
+  }
+}
+
+/* *************************************** */
+
+/* Looks up the name in the cache, queueing the IP for resolution when missing */
+void LocalHost::resolveName() {
+  char buf[64], rsp[256];
+
+  ntop->getRedis()->getAddress(ip.print(buf, sizeof(buf)), rsp, sizeof(rsp), true);
+}
+
+/* *************************************** */
+
 char* LocalHost::getSerializationKey(char *redis_key, uint bufsize) {
   Mac *mac = getMac();
 
@@ -154,9 +248,28 @@ char* LocalHost::getSerializationKey(char *redis_key, uint bufsize) {
 /* *************************************** */
 
 void LocalHost::deserialize(json_object *o) {
-  json_object *obj;
-
   stats->deserialize(o);
+  deserializeLocalHost(o);
+  checkStatsReset();
+}
+
+/* *************************************** */
+
+/* Binds the host to its MAC when restoring it from a serialization */
+void LocalHost::restoreMac(const u_int8_t *mac_buf) {
+  if(! mac) {
+    if((mac = iface->getMac((u_int8_t*)mac_buf, true /* create if not exists */, true /* Inline call */)) != NULL)
+      mac->incUses();
+    else
+      ntop->getTrace()->traceEvent(TRACE_WARNING,
+				   "Internal error: NULL mac. Are you running out of memory or MAC hash is full?");
+  }
+}
+
+/* *************************************** */
+
+void LocalHost::deserializeLocalHost(json_object *o) {
+  json_object *obj;
 
   if(! mac) {
     u_int8_t mac_buf[6];
@@ -165,11 +278,7 @@ void LocalHost::deserialize(json_object *o) {
     if(json_object_object_get_ex(o, "mac_address", &obj)) Utils::parseMac(mac_buf, json_object_get_string(obj));
 
     // sticky hosts enabled, we must bring up the mac address
-    if((mac = iface->getMac(mac_buf, true /* create if not exists */, true /* Inline call */)) != NULL)
-      mac->incUses();
-    else
-      ntop->getTrace()->traceEvent(TRACE_WARNING,
-				   "Internal error: NULL mac. Are you running out of memory or MAC hash is full?");
+    restoreMac(mac_buf);
   }
 
   GenericHashEntry::deserialize(o);
@@ -183,8 +292,59 @@ void LocalHost::deserialize(json_object *o) {
   activityStats.reset();
   if(json_object_object_get_ex(o, "activityStats", &obj)) activityStats.deserialize(obj);
 #endif
+}
+
+/* *************************************** */
+
+bool LocalHost::serializeBinary(BinarySerializer *s) {
+  static const u_int8_t empty_mac[6] = { 0 };
+  Mac *m = mac;
+  u_int32_t begin;
+
+  begin = s->beginSection(binary_section_host);
+  s->putVarint(first_seen);
+  s->putVarint(last_stats_reset);
+  s->putBytes(m ? m->get_mac() : empty_mac, 6);
+  s->putVarint(getOS());
+  s->endSection(begin);
+
+  stats->serializeBinary(s);
+
+  return(true);
+}
+
+/* *************************************** */
+
+bool LocalHost::deserializeBinary(BinaryDeserializer *d) {
+  bool rc = deserializeBinaryState(d, stats);
 
   checkStatsReset();
+  return(rc);
+}
+
+/* *************************************** */
+
+/* Restores the host data, and the counters into s. Sections unknown to this version are skipped. */
+bool LocalHost::deserializeBinaryState(BinaryDeserializer *d, HostStats *s) {
+  BinaryDeserializer section;
+  u_int8_t tag;
+
+  while(d->nextSection(&tag, &section)) {
+    if(tag == binary_section_host) {
+      const u_int8_t *mac_buf;
+
+      first_seen = section.getVarint();
+      last_stats_reset = section.getVarint();
+      if((mac_buf = section.getBytes(6)) != NULL) restoreMac(mac_buf);
+      setOS((OperatingSystem)section.getVarint());
+    } else
+      s->deserializeBinary(tag, &section);
+
+    if(section.hasFailed())
+      return(false);
+  }
+
+  return(!d->hasFailed());
 }
 
 /* *************************************** */
@@ -291,6 +451,10 @@ void LocalHost::inlineSetOSDetail(const char *_os_detail) {
 void LocalHost::lua_get_timeseries(lua_State* vm) {
   char buf_id[64], *host_id;
 
+  /* Counters not restored yet: skip the host rather than writing a bogus point */
+  if(hydration_pending)
+    return;
+
   lua_newtable(vm);
 
   /* The timeseries point */
@@ -0,0 +1,303 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+LocalHostHydrator::LocalHostHydrator(NetworkInterface *_iface) {
+  iface = _iface;
+  hydrateLoopCreated = false;
+  num_pending_restores = 0;
+  num_restores = num_hydrated = num_restored = num_inline = 0;
+  tot_hydration_usec = tot_apply_usec = 0, max_hydration_usec = 0;
+  num_serialized = num_deleted = num_redis_jobs = tot_redis_usec = 0, max_redis_usec = 0;
+
+  requests    = new (std::nothrow) SPSCQueue<LocalHostHydrationJob *>(LOCAL_HOST_HYDRATION_QUEUE_LEN, "localHostHydrationRequests");
+  completions = new (std::nothrow) SPSCQueue<LocalHostHydrationJob *>(LOCAL_HOST_HYDRATION_QUEUE_LEN, "localHostHydrationCompletions");
+
+  name = strdup("localHostHydrator");
+}
+
+/* **************************************************** */
+
+LocalHostHydrator::~LocalHostHydrator() {
+  LocalHostHydrationJob *job;
+
+  stopHydration();
+
+  /* The thread owning the hosts is gone: states not merged yet are discarded */
+  if(completions) {
+    while((job = completions->dequeue()) != NULL)
+      releaseJob(job);
+
+    delete completions;
+  }
+
+  if(requests) delete requests;
+  if(name)     free(name);
+}
+
+/* **************************************************** */
+
+bool LocalHostHydrator::enqueue(LocalHost *h, LocalHostHydrationType type) {
+  LocalHostHydrationJob *job;
+  bool restore = (type == local_host_hydration_restore);
+
+  if(!hydrateLoopCreated
+     /* Restored states must always find room in the completions queue */
+     || (restore && (num_pending_restores >= (LOCAL_HOST_HYDRATION_QUEUE_LEN - 1)))
+     || ((job = new (std::nothrow) LocalHostHydrationJob) == NULL)) {
+    num_inline++;
+    return(false);
+  }
+
+  job->host = h, job->type = type, job->state = NULL;
+  gettimeofday(&job->enqueue_time, NULL);
+
+  /* The reference is released once the job is done */
+  h->incUses();
+
+  if(!requests->enqueue(job, true)) {
+    h->decUses();
+    delete job;
+    num_inline++;
+    return(false);
+  }
+
+  if(restore)
+    num_restores++, num_pending_restores++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+void LocalHostHydrator::releaseJob(LocalHostHydrationJob *job) {
+  if(job->type == local_host_hydration_restore)
+    num_pending_restores--;
+
+  if(job->state)
+    delete job->state;
+
+  job->host->decUses();
+  delete job;
+}
+
+/* **************************************************** */
+
+/* Executed by the hydrator thread: this is where Redis is waited for */
+void LocalHostHydrator::runJob(LocalHostHydrationJob *job) {
+  struct timeval begin, end;
+  u_int32_t usec;
+
+  gettimeofday(&begin, NULL);
+
+  switch(job->type) {
+  case local_host_hydration_restore:
+    job->state = job->host->loadCachedState();
+    break;
+  case local_host_hydration_serialize:
+    job->host->saveCachedState();
+    num_serialized++;
+    break;
+  case local_host_hydration_delete:
+    job->host->deleteRedisSerialization();
+    num_deleted++;
+    break;
+  }
+
+  gettimeofday(&end, NULL);
+
+  usec = Utils::usecTimevalDiff(&end, &begin);
+  num_redis_jobs++, tot_redis_usec += usec;
+  if(usec > max_redis_usec) max_redis_usec = usec;
+}
+
+/* **************************************************** */
+
+u_int32_t LocalHostHydrator::hydrateHosts() {
+  LocalHostHydrationJob *jobs[LOCAL_HOST_HYDRATION_BATCH];
+  u_int32_t num = requests->dequeueBulk(jobs, LOCAL_HOST_HYDRATION_BATCH);
+
+  for(u_int32_t i = 0; i < num; i++) {
+    LocalHostHydrationJob *job = jobs[i];
+
+    runJob(job);
+
+    if(job->type == local_host_hydration_restore) {
+      /* The state is merged by the thread owning the host, which also releases the reference */
+      if(!completions->enqueue(job, true)) {
+	/* Cannot happen as restores in flight are bounded by enqueue() */
+	ntop->getTrace()->traceEvent(TRACE_WARNING, "Internal error: %s completions queue full", name);
+	/* Leak the host reference rather than racing with the owning thread */
+	if(job->state) delete job->state;
+	delete job;
+      }
+    } else {
+      job->host->decUses();
+      delete job;
+    }
+  }
+
+  if(num == 0)
+    requests->wait();
+
+  return(num);
+}
+
+/* **************************************************** */
+
+u_int32_t LocalHostHydrator::applyCompletions() {
+  LocalHostHydrationJob *jobs[LOCAL_HOST_HYDRATION_BATCH];
+  struct timeval begin, end;
+  u_int32_t num;
+
+  if(!completions || !completions->isNotEmpty())
+    return(0);
+
+  gettimeofday(&begin, NULL);
+
+  num = completions->dequeueBulk(jobs, LOCAL_HOST_HYDRATION_BATCH);
+
+  for(u_int32_t i = 0; i < num; i++) {
+    LocalHostHydrationJob *job = jobs[i];
+    u_int32_t usec = Utils::usecTimevalDiff(&begin, &job->enqueue_time);
+
+    job->host->applyCachedState(job->state);
+    num_hydrated++;
+    if(job->state) num_restored++;
+
+    tot_hydration_usec += usec;
+    if(usec > max_hydration_usec) max_hydration_usec = usec;
+
+    releaseJob(job);
+  }
+
+  gettimeofday(&end, NULL);
+  tot_apply_usec += Utils::usecTimevalDiff(&end, &begin);
+
+  return(num);
+}
+
+/* **************************************************** */
+
+void LocalHostHydrator::hydrateHostsLoop() {
+  ntop->getTrace()->traceEvent(TRACE_NORMAL,
+			       "Started local hosts hydration loop on interface %s [id: %u]...",
+			       iface->get_description(), iface->get_id());
+
+  /* Wait until it starts up */
+  while(!iface->isRunning() && !ntop->getGlobals()->isShutdown()) _usleep(10000);
+
+  /* Now operational */
+  while(iface->isRunning())
+    hydrateHosts();
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Local hosts hydration thread completed for %s",
+			       iface->get_name());
+}
+
+/* **************************************************** */
+
+static void* hydrateLoopFctn(void* ptr) {
+  LocalHostHydrator *h = (LocalHostHydrator*)ptr;
+
+  h->hydrateHostsLoop();
+  return(NULL);
+}
+
+/* **************************************************** */
+
+void LocalHostHydrator::startHydration() {
+  if(hydrateLoopCreated || !requests || !completions)
+    return;
+
+  if(pthread_create(&hydrateLoop, NULL, hydrateLoopFctn, (void*)this) != 0) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to start the local hosts hydration of %s: hosts cache accessed inline",
+				 iface->get_description());
+    return;
+  }
+
+  hydrateLoopCreated = true;
+
+#ifdef __linux__
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "hydrate ifid %u", iface->get_id());
+  pthread_setname_np(hydrateLoop, buf);
+#endif
+}
+
+/* **************************************************** */
+
+/* The loop terminates when the interface is no longer running */
+void LocalHostHydrator::stopHydration() {
+  LocalHostHydrationJob *job;
+
+  if(hydrateLoopCreated) {
+    void *res;
+
+    pthread_join(hydrateLoop, &res);
+    hydrateLoopCreated = false;
+  }
+
+  if(!requests)
+    return;
+
+  /* Now the only consumer: save the idle hosts, skip the restores (see LocalHost::isHydrationPending) */
+  while((job = requests->dequeue()) != NULL) {
+    if(job->type != local_host_hydration_restore)
+      runJob(job);
+
+    releaseJob(job);
+  }
+}
+
+/* **************************************************** */
+
+void LocalHostHydrator::lua(lua_State *vm) const {
+  if(requests)    requests->lua(vm);
+  if(completions) completions->lua(vm);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "queue_length", requests ? requests->getLength() : 0);
+  lua_push_uint64_table_entry(vm, "num_failed_enqueues", requests ? requests->get_num_failed_enqueues() : 0);
+  lua_push_uint64_table_entry(vm, "num_inline", num_inline);
+  lua_push_uint64_table_entry(vm, "num_restores", num_restores);
+  lua_push_uint64_table_entry(vm, "num_pending_restores", num_pending_restores);
+  lua_push_uint64_table_entry(vm, "num_hydrated", num_hydrated);
+  lua_push_uint64_table_entry(vm, "num_restored", num_restored);
+  lua_push_uint64_table_entry(vm, "num_serialized", num_serialized);
+  lua_push_uint64_table_entry(vm, "num_deleted", num_deleted);
+  lua_push_float_table_entry(vm, "avg_hydration_usec",
+			     num_hydrated ? ((float)tot_hydration_usec) / num_hydrated : 0);
+  lua_push_uint64_table_entry(vm, "max_hydration_usec", max_hydration_usec);
+  lua_push_float_table_entry(vm, "avg_redis_usec",
+			     num_redis_jobs ? ((float)tot_redis_usec) / num_redis_jobs : 0);
+  lua_push_uint64_table_entry(vm, "max_redis_usec", max_redis_usec);
+  /* Time spent by the thread owning the hosts, per restored host */
+  lua_push_float_table_entry(vm, "avg_apply_usec",
+			     num_hydrated ? ((float)tot_apply_usec) / num_hydrated : 0);
+  lua_pushstring(vm, name ? name : "");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
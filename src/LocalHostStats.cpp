@@ -226,6 +226,141 @@ void LocalHostStats::deserialize(json_object *o) {
 
 /* *************************************** */
 
+void LocalHostStats::serializeBinary(BinarySerializer *s) {
+  u_int32_t begin;
+  Cardinality *contacts[] = { &num_contacted_hosts_as_client, &num_host_contacts_as_server,
+			      &num_contacted_services_as_client, &num_contacted_ports_as_client,
+			      &num_host_contacted_ports_as_server };
+
+  begin = s->beginSection(binary_section_traffic);
+  sent.serializeBinary(s), rcvd.serializeBinary(s);
+  s->putVarint(total_num_dropped_flows);
+  s->putVarint(total_activity_time);
+  s->putVarint(udp_sent_unicast), s->putVarint(udp_sent_non_unicast);
+  s->endSection(begin);
+
+  begin = s->beginSection(binary_section_l4);
+  l4stats.serializeBinary(s);
+  s->endSection(begin);
+
+  begin = s->beginSection(binary_section_packets);
+  sent_stats.serializeBinary(s), recv_stats.serializeBinary(s);
+  s->endSection(begin);
+
+  if(tcp_packet_stats_sent.seqIssues() || tcp_packet_stats_rcvd.seqIssues()) {
+    begin = s->beginSection(binary_section_tcp_packets);
+    tcp_packet_stats_sent.serializeBinary(s), tcp_packet_stats_rcvd.serializeBinary(s);
+    s->endSection(begin);
+  }
+
+  begin = s->beginSection(binary_section_flows);
+  s->putVarint(total_num_flows_as_client), s->putVarint(total_num_flows_as_server);
+  s->putVarint(alerted_flows_as_client), s->putVarint(alerted_flows_as_server);
+  s->putVarint(unreachable_flows_as_client), s->putVarint(unreachable_flows_as_server);
+  s->putVarint(host_unreachable_flows_as_client), s->putVarint(host_unreachable_flows_as_server);
+  s->endSection(begin);
+
+  if(dns) {
+    begin = s->beginSection(binary_section_dns);
+    dns->serializeBinary(s);
+    s->endSection(begin);
+  }
+
+  if(http) {
+    begin = s->beginSection(binary_section_http);
+    http->serializeBinary(s);
+    s->endSection(begin);
+  }
+
+  if(ndpiStats) {
+    begin = s->beginSection(binary_section_ndpi);
+    ndpiStats->serializeBinary(iface, s);
+    s->endSection(begin);
+
+    begin = s->beginSection(binary_section_ndpi_categories);
+    ndpiStats->serializeCategoriesBinary(s);
+    s->endSection(begin);
+  }
+
+  /* Not part of the JSON serialization: cheap enough to be kept across restarts in binary */
+  begin = s->beginSection(binary_section_contacts);
+  for(u_int i = 0; i < sizeof(contacts) / sizeof(contacts[0]); i++)
+    contacts[i]->serializeBinary(s);
+  s->endSection(begin);
+}
+
+/* *************************************** */
+
+bool LocalHostStats::deserializeBinary(u_int8_t tag, BinaryDeserializer *d) {
+  Cardinality *contacts[] = { &num_contacted_hosts_as_client, &num_host_contacts_as_server,
+			      &num_contacted_services_as_client, &num_contacted_ports_as_client,
+			      &num_host_contacted_ports_as_server };
+
+  switch(tag) {
+  case binary_section_traffic:
+    sent.deserializeBinary(d), rcvd.deserializeBinary(d);
+    total_num_dropped_flows = d->getVarint();
+    total_activity_time = d->getVarint();
+    udp_sent_unicast = d->getVarint(), udp_sent_non_unicast = d->getVarint();
+
+    /* Restores possibly checkpointed data */
+    checkpoints.sent_bytes = getNumBytesSent();
+    checkpoints.rcvd_bytes = getNumBytesRcvd();
+    break;
+
+  case binary_section_l4:
+    l4stats.deserializeBinary(d);
+    break;
+
+  case binary_section_packets:
+    sent_stats.deserializeBinary(d), recv_stats.deserializeBinary(d);
+    break;
+
+  case binary_section_tcp_packets:
+    tcp_packet_stats_sent.deserializeBinary(d), tcp_packet_stats_rcvd.deserializeBinary(d);
+    break;
+
+  case binary_section_flows:
+    total_num_flows_as_client = d->getVarint(), total_num_flows_as_server = d->getVarint();
+    alerted_flows_as_client = d->getVarint(), alerted_flows_as_server = d->getVarint();
+    unreachable_flows_as_client = d->getVarint(), unreachable_flows_as_server = d->getVarint();
+    host_unreachable_flows_as_client = d->getVarint(), host_unreachable_flows_as_server = d->getVarint();
+    break;
+
+  case binary_section_dns:
+    if(dns) dns->deserializeBinary(d);
+    break;
+
+  case binary_section_http:
+    if(http) http->deserializeBinary(d);
+    break;
+
+  case binary_section_ndpi:
+  case binary_section_ndpi_categories:
+    if(!ndpiStats) ndpiStats = new (std::nothrow) nDPIStats();
+
+    if(ndpiStats) {
+      if(tag == binary_section_ndpi)
+	ndpiStats->deserializeBinary(iface, d);
+      else
+	ndpiStats->deserializeCategoriesBinary(d);
+    }
+    break;
+
+  case binary_section_contacts:
+    for(u_int i = 0; i < sizeof(contacts) / sizeof(contacts[0]); i++)
+      contacts[i]->deserializeBinary(d);
+    break;
+
+  default:
+    return(false);
+  }
+
+  return(!d->hasFailed());
+}
+
+/* *************************************** */
+
 void LocalHostStats::lua_get_timeseries(lua_State* vm) {
   luaStats(vm, iface, true /* host details */, true /* verbose */, true /* tsLua */);
 
@@ -92,6 +92,8 @@ LuaEngine::LuaEngine(lua_State *vm) {
   void *ctx;
 
   loaded_script_path = NULL;
+  http_ready = false;
+  timerclear(&script_begin);
 
 #ifdef HAVE_NEDGE
   if(!ntop->getPro()->has_valid_license()) {
@@ -137,44 +139,54 @@ LuaEngine::~LuaEngine() {
     ctx = getLuaVMContext(L);
 
     if(ctx) {
-#ifndef HAVE_NEDGE
-      if(ctx->snmpBatch) delete ctx->snmpBatch;
+      releaseContextResources(ctx);
+      free(ctx);
+    }
 
-      for(u_int8_t slot_id=0; slot_id<MAX_NUM_ASYNC_SNMP_ENGINES; slot_id++) {
-	if(ctx->snmpAsyncEngine[slot_id] != NULL)
-	  delete ctx->snmpAsyncEngine[slot_id];
-      }
-#endif
+    lua_close(L);
+  }
 
-      if(ctx->pkt_capture.end_capture > 0) {
-	ctx->pkt_capture.end_capture = 0; /* Force stop */
-	pthread_join(ctx->pkt_capture.captureThreadLoop, NULL);
-      }
+  if(loaded_script_path) free(loaded_script_path);
+}
 
-      if((ctx->iface != NULL) && ctx->live_capture.pcaphdr_sent)
-	ctx->iface->deregisterLiveCapture(ctx);
+/* ******************************* */
 
-#ifndef WIN32
-      if(ctx->ping != NULL)
-	delete ctx->ping;
+/* Frees what the scripts have allocated into the context, not the context itself */
+void LuaEngine::releaseContextResources(struct ntopngLuaContext *ctx) {
+#ifndef HAVE_NEDGE
+  if(ctx->snmpBatch) delete ctx->snmpBatch;
+
+  for(u_int8_t slot_id=0; slot_id<MAX_NUM_ASYNC_SNMP_ENGINES; slot_id++) {
+    if(ctx->snmpAsyncEngine[slot_id] != NULL)
+      delete ctx->snmpAsyncEngine[slot_id];
+  }
 #endif
 
-      if(ctx->addr_tree != NULL)
-        delete ctx->addr_tree;
+  if(ctx->pkt_capture.end_capture > 0) {
+    ctx->pkt_capture.end_capture = 0; /* Force stop */
+    pthread_join(ctx->pkt_capture.captureThreadLoop, NULL);
+  }
 
-      if(ctx->sqlite_hosts_filter)
-	free(ctx->sqlite_hosts_filter);
+  /* Waits for the packet being delivered to the ring (if any), see deliverLiveCapture() */
+  if((ctx->iface != NULL) && ctx->live_capture.pcaphdr_sent)
+    ctx->iface->deregisterLiveCapture(ctx);
 
-      if(ctx->sqlite_flows_filter)
-	free(ctx->sqlite_flows_filter);
+  if(ctx->live_capture.ring)
+    delete ctx->live_capture.ring;
 
-      free(ctx);
-    }
+#ifndef WIN32
+  if(ctx->ping != NULL)
+    delete ctx->ping;
+#endif
 
-    lua_close(L);
-  }
+  if(ctx->addr_tree != NULL)
+    delete ctx->addr_tree;
 
-  if(loaded_script_path) free(loaded_script_path);
+  if(ctx->sqlite_hosts_filter)
+    free(ctx->sqlite_hosts_filter);
+
+  if(ctx->sqlite_flows_filter)
+    free(ctx->sqlite_flows_filter);
 }
 
 /* ****************************************** */
@@ -374,6 +386,94 @@ int LuaEngine::run_loaded_script() {
 
 /* ****************************************** */
 
+#define LUA_SANDBOX_RESET_KEY "ntopng.sandbox_reset"
+
+/*
+  Snapshots the globals, the tables they point to (e.g. string, ntop, package)
+  and package.loaded, and returns a function that restores them. Fields are
+  accessed with next/rawget/rawset to be immune to metatables set by scripts.
+*/
+static const char *lua_sandbox_snapshot =
+  "local next, type, rawget, rawset = next, type, rawget, rawset\n"
+  "local getmetatable, setmetatable = getmetatable, setmetatable\n"
+  "local G, loaded = _G, package.loaded\n"
+  "local function snapshot(t)\n"
+  "  local s = {}\n"
+  "  for k, v in next, t do s[k] = v end\n"
+  "  return s\n"
+  "end\n"
+  "local function restore(t, s)\n"
+  "  for k in next, t do if s[k] == nil then rawset(t, k, nil) end end\n"
+  "  for k, v in next, s do if rawget(t, k) ~= v then rawset(t, k, v) end end\n"
+  "end\n"
+  "local globals, G_mt, tables = snapshot(G), getmetatable(G), {}\n"
+  "for _, v in next, globals do\n"
+  "  if type(v) == 'table' and v ~= G then tables[v] = snapshot(v) end\n"
+  "end\n"
+  "tables[loaded] = snapshot(loaded)\n"
+  "return function()\n"
+  "  setmetatable(G, G_mt)\n"
+  "  restore(G, globals)\n"
+  "  for t, s in next, tables do restore(t, s) end\n"
+  "end\n";
+
+/* ****************************************** */
+
+bool LuaEngine::prepareHttp() {
+  if(!L) return(false);
+  if(http_ready) return(true);
+
+  luaL_openlibs(L); /* Load base libraries */
+  lua_register_classes(L, true); /* Load custom classes */
+
+  if((luaL_loadstring(L, lua_sandbox_snapshot) != 0)
+     || (lua_pcall(L, 0, 1, 0) != 0)) {
+    const char *err = lua_tostring(L, -1);
+
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to snapshot the Lua state [%s]", err ? err : "");
+    lua_settop(L, 0);
+    return(false);
+  }
+
+  lua_setfield(L, LUA_REGISTRYINDEX, LUA_SANDBOX_RESET_KEY);
+  http_ready = true;
+
+  return(true);
+}
+
+/* ****************************************** */
+
+bool LuaEngine::resetHttp() {
+  struct ntopngLuaContext *ctx;
+
+  if(!L || !http_ready) return(false);
+
+  lua_settop(L, 0);
+  lua_getfield(L, LUA_REGISTRYINDEX, LUA_SANDBOX_RESET_KEY);
+
+  if(lua_pcall(L, 0, 0, 0) != 0) {
+    const char *err = lua_tostring(L, -1);
+
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to reset the Lua state [%s]", err ? err : "");
+    return(false);
+  }
+
+  lua_gc(L, LUA_GCRESTART, 0); /* In case a script has stopped the collector */
+  lua_sethook(L, NULL, 0, 0);
+
+  /* The userdata global has just been restored, so the context is still the same */
+  if((ctx = getLuaVMContext(L)) != NULL) {
+    releaseContextResources(ctx);
+    memset(ctx, 0, sizeof(*ctx));
+  }
+
+  timerclear(&script_begin);
+
+  return(true);
+}
+
+/* ****************************************** */
+
 /* http://www.geekhideout.com/downloads/urlcode.c */
 
 #if 0
@@ -655,8 +755,10 @@ int LuaEngine::handle_script_request(struct mg_connection *conn,
 
   if(!L) return(-1);
 
-  luaL_openlibs(L); /* Load base libraries */
-  lua_register_classes(L, true); /* Load custom classes */
+  if(!http_ready) {
+    luaL_openlibs(L); /* Load base libraries */
+    lua_register_classes(L, true); /* Load custom classes */
+  }
 
   getLuaVMUservalue(L, conn) = conn;
 
@@ -913,6 +1015,8 @@ int LuaEngine::handle_script_request(struct mg_connection *conn,
   if(is_interface_allowed)
     getLuaVMUservalue(L, allowed_ifname) = iface->get_name();
 
+  gettimeofday(&script_begin, NULL);
+
 #ifdef NTOPNG_PRO
   if(ntop->getPro()->has_valid_license())
     rc = __ntop_lua_handlefile(L, script_path, true);
@@ -966,6 +1070,15 @@ void LuaEngine::setFlow(Flow* f) {
 
 /* ****************************************** */
 
+void LuaEngine::setFlowChecks(FlowChecksExecutor *checks) {
+  struct ntopngLuaContext *c = getLuaVMContext(L);
+
+  if(c)
+    c->flow_checks = checks;
+}
+
+/* ****************************************** */
+
 void LuaEngine::setThreadedActivityData(lua_State* from) {
   struct ntopngLuaContext *cur_ctx, *from_ctx;
   lua_State *cur_state = getState();
@@ -0,0 +1,288 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+LuaVMPool::LuaVMPool(u_int32_t _max_idle) {
+  max_idle = _max_idle, generation = 0;
+  num_leases = num_warm_leases = num_created = num_discarded = num_reloads = 0;
+}
+
+/* **************************************************** */
+
+LuaVMPool::~LuaVMPool() {
+  /* Leased engines are owned by the HTTP threads, stopped before the pool is deleted */
+  for(vector<LuaEngine*>::iterator it = idle.begin(); it != idle.end(); ++it)
+    delete *it;
+}
+
+/* **************************************************** */
+
+/* Returns a prepared engine, not yet known to the pool */
+LuaEngine* LuaVMPool::newEngine() {
+  LuaEngine *l;
+
+  try {
+    l = new LuaEngine(NULL);
+  } catch(std::bad_alloc& ba) {
+    return(NULL);
+  }
+
+  /* An engine that cannot be prepared still works, just like a non-pooled one */
+  l->prepareHttp();
+
+  return(l);
+}
+
+/* **************************************************** */
+
+void LuaVMPool::prewarm() {
+  u_int32_t num_prepared = 0;
+
+  while(true) {
+    u_int32_t cur_generation;
+    LuaEngine *l;
+    bool added = false;
+
+    m.lock(__FILE__, __LINE__);
+    cur_generation = generation;
+    if(idle.size() >= max_idle) {
+      m.unlock(__FILE__, __LINE__);
+      break;
+    }
+    m.unlock(__FILE__, __LINE__);
+
+    /* Engines are prepared without holding the lock */
+    if((l = newEngine()) == NULL)
+      break;
+
+    m.lock(__FILE__, __LINE__);
+    if((cur_generation == generation) && (idle.size() < max_idle)) {
+      try {
+	EngineInfo info = { generation, 0 };
+
+	idle.push_back(l);
+	engines[l] = info;
+	num_created++, num_prepared++, added = true;
+      } catch(std::bad_alloc& ba) {
+	if(!idle.empty() && (idle.back() == l)) idle.pop_back();
+      }
+    }
+    m.unlock(__FILE__, __LINE__);
+
+    if(!added) {
+      delete l;
+      break;
+    }
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_INFO, "Prepared %u Lua engines for HTTP requests", num_prepared);
+}
+
+/* **************************************************** */
+
+void LuaVMPool::reloadVMs() {
+  vector<LuaEngine*> to_delete;
+
+  m.lock(__FILE__, __LINE__);
+
+  /* Leased engines are discarded upon release as their generation is now stale */
+  generation++, num_reloads++;
+  to_delete.swap(idle);
+
+  for(vector<LuaEngine*>::iterator it = to_delete.begin(); it != to_delete.end(); ++it)
+    engines.erase(*it);
+
+  num_discarded += to_delete.size();
+  m.unlock(__FILE__, __LINE__);
+
+  for(vector<LuaEngine*>::iterator it = to_delete.begin(); it != to_delete.end(); ++it)
+    delete *it;
+
+  prewarm();
+}
+
+/* **************************************************** */
+
+LuaEngine* LuaVMPool::lease() {
+  LuaEngine *l = NULL;
+  u_int32_t cur_generation;
+
+  m.lock(__FILE__, __LINE__);
+  num_leases++;
+
+  if(!idle.empty()) {
+    l = idle.back();
+    idle.pop_back();
+    num_warm_leases++;
+  }
+
+  cur_generation = generation;
+  m.unlock(__FILE__, __LINE__);
+
+  if(l)
+    return(l);
+
+  /* Pool exhausted (e.g. more threads than engines or right after a reload) */
+  if((l = newEngine()) == NULL)
+    return(NULL);
+
+  m.lock(__FILE__, __LINE__);
+  try {
+    EngineInfo info = { cur_generation, 0 };
+
+    engines[l] = info;
+    num_created++;
+  } catch(std::bad_alloc& ba) {
+    /* Unknown to the pool: will be deleted upon release */
+  }
+  m.unlock(__FILE__, __LINE__);
+
+  return(l);
+}
+
+/* **************************************************** */
+
+void LuaVMPool::release(LuaEngine *l, const char *endpoint,
+			const struct timeval *begin, const struct timeval *end) {
+  std::map<LuaEngine*, EngineInfo>::iterator it;
+  u_int32_t engine_generation = 0;
+  bool reusable = false;
+
+  if(!l) return;
+
+  m.lock(__FILE__, __LINE__);
+  updateEndpointStats(endpoint, begin, l->getScriptBegin(), end);
+
+  if((it = engines.find(l)) != engines.end()) {
+    engine_generation = it->second.generation;
+
+    reusable = (engine_generation == generation)
+      && (++it->second.num_uses < LUA_VM_POOL_MAX_USES)
+      && (idle.size() < max_idle);
+  }
+  m.unlock(__FILE__, __LINE__);
+
+  /* The reset restores the snapshot, keep it out of the lock */
+  if(reusable)
+    reusable = l->resetHttp();
+
+  m.lock(__FILE__, __LINE__);
+
+  if(reusable) {
+    /* Check again as a reload may have happened in the meantime */
+    if((engine_generation == generation) && (idle.size() < max_idle)) {
+      try {
+	idle.push_back(l);
+      } catch(std::bad_alloc& ba) {
+	reusable = false;
+      }
+    } else
+      reusable = false;
+  }
+
+  if(!reusable)
+    engines.erase(l), num_discarded++;
+
+  m.unlock(__FILE__, __LINE__);
+
+  if(!reusable)
+    delete l;
+}
+
+/* **************************************************** */
+
+/* Must be called with the lock held */
+void LuaVMPool::updateEndpointStats(const char *endpoint, const struct timeval *begin,
+				    const struct timeval *script_begin, const struct timeval *end) {
+  std::map<std::string, EndpointStats>::iterator it;
+  u_int32_t setup_usec, exec_usec;
+
+  if(!endpoint || !begin || !end)
+    return;
+
+  if(timerisset(script_begin)) {
+    setup_usec = Utils::usecTimevalDiff(script_begin, begin);
+    exec_usec = Utils::usecTimevalDiff(end, script_begin);
+  } else /* The script has not run (e.g. redirect) */
+    setup_usec = Utils::usecTimevalDiff(end, begin), exec_usec = 0;
+
+  try {
+    if((it = endpoints.find(endpoint)) == endpoints.end()) {
+      EndpointStats s;
+
+      if(endpoints.size() >= LUA_VM_POOL_MAX_ENDPOINTS)
+	return;
+
+      memset(&s, 0, sizeof(s));
+      it = endpoints.insert(std::make_pair(std::string(endpoint), s)).first;
+    }
+  } catch(std::bad_alloc& ba) {
+    return;
+  }
+
+  it->second.num_requests++;
+  it->second.tot_setup_usec += setup_usec, it->second.tot_exec_usec += exec_usec;
+  if(setup_usec > it->second.max_setup_usec) it->second.max_setup_usec = setup_usec;
+  if(exec_usec > it->second.max_exec_usec)   it->second.max_exec_usec = exec_usec;
+}
+
+/* **************************************************** */
+
+void LuaVMPool::lua(lua_State *vm) {
+  m.lock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "max_idle", max_idle);
+  lua_push_uint64_table_entry(vm, "num_idle", idle.size());
+  lua_push_uint64_table_entry(vm, "num_leased", engines.size() - idle.size());
+  lua_push_uint64_table_entry(vm, "num_leases", num_leases);
+  lua_push_uint64_table_entry(vm, "num_warm_leases", num_warm_leases);
+  lua_push_uint64_table_entry(vm, "num_created", num_created);
+  lua_push_uint64_table_entry(vm, "num_discarded", num_discarded);
+  lua_push_uint64_table_entry(vm, "num_reloads", num_reloads);
+
+  lua_newtable(vm);
+
+  for(std::map<std::string, EndpointStats>::const_iterator it = endpoints.begin(); it != endpoints.end(); ++it) {
+    const EndpointStats *s = &it->second;
+
+    lua_newtable(vm);
+    lua_push_uint64_table_entry(vm, "num_requests", s->num_requests);
+    lua_push_float_table_entry(vm, "avg_setup_usec", s->num_requests ? ((float)s->tot_setup_usec) / s->num_requests : 0);
+    lua_push_float_table_entry(vm, "avg_exec_usec", s->num_requests ? ((float)s->tot_exec_usec) / s->num_requests : 0);
+    lua_push_uint64_table_entry(vm, "max_setup_usec", s->max_setup_usec);
+    lua_push_uint64_table_entry(vm, "max_exec_usec", s->max_exec_usec);
+
+    lua_pushstring(vm, it->first.c_str());
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
+  lua_pushstring(vm, "endpoints");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+
+  m.unlock(__FILE__, __LINE__);
+}
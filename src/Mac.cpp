@@ -237,6 +237,42 @@ void Mac::deserialize(json_object *o) {
 
 /* *************************************** */
 
+void Mac::serializeBinaryState(BinarySerializer *s) {
+  s->putVarint(first_seen);
+  s->putVarint(last_stats_reset);
+  s->putVarint(device_type);
+  s->putU8((source_mac ? 0x1 : 0) | (lockDeviceTypeChanges ? 0x2 : 0));
+  s->putString(model), s->putString(ssid), s->putString(fingerprint);
+  stats->serializeBinary(s);
+}
+
+/* *************************************** */
+
+bool Mac::restoreBinaryState(BinaryDeserializer *d) {
+  char buf[128];
+  DeviceType devtype;
+  u_int8_t flags;
+
+  first_seen = d->getVarint();
+  last_stats_reset = d->getVarint();
+  devtype = (DeviceType)d->getVarint();
+  flags = d->getU8();
+  if(d->getString(buf, sizeof(buf)) && buf[0]) inlineSetModel(buf);
+  if(d->getString(buf, sizeof(buf)) && buf[0]) inlineSetSSID(buf);
+  if(d->getString(buf, sizeof(buf)) && buf[0]) inlineSetFingerprint(buf);
+  stats->deserializeBinary(d);
+
+  /* After the model, that guesses a type */
+  device_type = devtype;
+  if(flags & 0x1) setSourceMac();
+  if(flags & 0x2) lockDeviceTypeChanges = true;
+
+  checkStatsReset();
+  return(!d->hasFailed());
+}
+
+/* *************************************** */
+
 bool Mac::statsResetRequested() {
   return(stats_reset_requested || (last_stats_reset < ntop->getLastStatsReset()));
 }
@@ -34,9 +34,7 @@ Mac* MacHash::get(const u_int8_t mac[6], bool is_inline_call) {
   if(mac == NULL)
     return(NULL);
   else {
-    u_int32_t hash = Utils::macHash((u_int8_t*)mac);
-
-    hash %= num_hashes;
+    u_int32_t hash = bucketId(Utils::macHash((u_int8_t*)mac));
 
     if(table[hash] == NULL) {
       return(NULL);
@@ -0,0 +1,284 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* Header preceding every block */
+typedef union {
+  struct {
+    MemoryPool *pool; /* Owner pool, NULL for malloc()'d blocks */
+    u_int32_t idx;    /* Index of the block in its pool */
+    u_int32_t next;   /* Free block: index + 1 of the next free block, 0 for none */
+  } h;
+  u_int8_t pad[MEMORY_POOL_HEADER_LEN];
+} pool_block_header_t;
+
+/* **************************************************** */
+
+MemoryPool::MemoryPool(const char *_name, size_t _block_size, u_int32_t _blocks_per_slab) {
+  name = strdup(_name ? _name : "");
+  block_size = (_block_size + 15) & ~((size_t)15);
+  blocks_per_slab = Utils::pow2(max_val(_blocks_per_slab, 1));
+
+  for(slab_shift = 0; (1U << slab_shift) < blocks_per_slab; slab_shift++)
+    ;
+
+  memset(slabs, 0, sizeof(slabs));
+  num_slabs = num_carved = 0;
+
+  free_head = 0;
+  refs = 1; /* Owner reference, dropped by destroy() */
+  num_allocations = num_fallbacks = 0;
+}
+
+/* **************************************************** */
+
+/* Only called when the owner and all the blocks have released the pool */
+MemoryPool::~MemoryPool() {
+  for(u_int32_t i = 0; i < num_slabs; i++)
+    free(slabs[i >> 8][i & 0xFF]);
+
+  for(u_int32_t i = 0; i < (MEMORY_POOL_MAX_SLABS >> 8); i++)
+    if(slabs[i]) free(slabs[i]);
+
+  if(name) free(name);
+}
+
+/* **************************************************** */
+
+void MemoryPool::destroy() {
+  u_int64_t in_use = refs.load() - 1;
+
+  if(in_use)
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Memory pool %s: %llu blocks still in use, deferring its release",
+				 name, (unsigned long long)in_use);
+
+  if(refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete this;
+}
+
+/* **************************************************** */
+
+/* Must be called with slab_lock held */
+bool MemoryPool::addSlab() {
+  u_int32_t chunk = num_slabs >> 8;
+  u_int8_t *slab;
+
+  if(num_slabs >= MEMORY_POOL_MAX_SLABS)
+    return(false);
+
+  if((slabs[chunk] == NULL)
+     && ((slabs[chunk] = (u_int8_t**)calloc(256, sizeof(u_int8_t*))) == NULL))
+    return(false);
+
+  if((slab = (u_int8_t*)malloc((MEMORY_POOL_HEADER_LEN + block_size) * blocks_per_slab)) == NULL)
+    return(false);
+
+  /* Published to the other threads by the free stack update of the blocks carved from it */
+  slabs[chunk][num_slabs & 0xFF] = slab;
+  num_slabs++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+/* Pushes the chain of free blocks going from first_idx to last on the free stack */
+void MemoryPool::pushBlocks(u_int32_t first_idx, void *last) {
+  u_int64_t head = free_head.load();
+
+  do {
+    __atomic_store_n(&((pool_block_header_t*)last)->h.next, (u_int32_t)head, __ATOMIC_RELAXED);
+  } while(!free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | (first_idx + 1)));
+}
+
+/* **************************************************** */
+
+/*
+  Takes a batch of never-used blocks out of the slabs: the first one is
+  returned, the others go to the free stack. Blocks are carved lazily, so
+  slab pages are only touched when used.
+*/
+void* MemoryPool::carveBlocks() {
+  u_int32_t first, num;
+
+  slab_lock.lock(__FILE__, __LINE__);
+
+  if((num_carved == num_slabs * blocks_per_slab) && !addSlab()) {
+    slab_lock.unlock(__FILE__, __LINE__);
+    return(NULL);
+  }
+
+  first = num_carved;
+  num = min_val(MEMORY_POOL_CARVE_BATCH, num_slabs * blocks_per_slab - num_carved);
+  num_carved += num;
+
+  slab_lock.unlock(__FILE__, __LINE__);
+
+  for(u_int32_t i = first; i < first + num; i++) {
+    pool_block_header_t *block = (pool_block_header_t*)blockAddress(i);
+
+    block->h.pool = this, block->h.idx = i;
+    block->h.next = (i + 1 < first + num) ? (i + 2) : 0;
+  }
+
+  if(num > 1)
+    pushBlocks(first + 1, blockAddress(first + num - 1));
+
+  return(blockAddress(first));
+}
+
+/* **************************************************** */
+
+void* MemoryPool::getBlock() {
+  u_int64_t head = free_head.load();
+
+  while((u_int32_t)head != 0) {
+    pool_block_header_t *block = (pool_block_header_t*)blockAddress((u_int32_t)head - 1);
+
+    /*
+      The block can be popped by another thread meanwhile, making next stale:
+      the tag then no longer matches and the exchange is retried
+    */
+    u_int32_t next = __atomic_load_n(&block->h.next, __ATOMIC_RELAXED);
+
+    if(free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | next))
+      return(block);
+  }
+
+  return(carveBlocks());
+}
+
+/* **************************************************** */
+
+void MemoryPool::putBlock(void *block) {
+  pushBlocks(((pool_block_header_t*)block)->h.idx, block);
+}
+
+/* **************************************************** */
+
+void* MemoryPool::allocate(MemoryPool *pool, size_t size) {
+  pool_block_header_t *block = NULL;
+
+  if(pool) {
+    if(size <= pool->block_size)
+      block = (pool_block_header_t*)pool->getBlock();
+
+    if(block) {
+      pool->refs.fetch_add(1, std::memory_order_relaxed);
+      pool->num_allocations.fetch_add(1, std::memory_order_relaxed);
+    } else
+      pool->num_fallbacks.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if(block == NULL) {
+    if((block = (pool_block_header_t*)malloc(sizeof(pool_block_header_t) + size)) == NULL)
+      return(NULL);
+
+    block->h.pool = NULL;
+  }
+
+  return(&block[1]);
+}
+
+/* **************************************************** */
+
+void MemoryPool::release(void *ptr) {
+  pool_block_header_t *block;
+  MemoryPool *pool;
+
+  if(ptr == NULL) return;
+
+  block = &((pool_block_header_t*)ptr)[-1];
+
+  if((pool = block->h.pool) != NULL) {
+    pool->putBlock(block);
+
+    /* Last block of a destroyed pool */
+    if(pool->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete pool;
+  } else
+    free(block);
+}
+
+/* **************************************************** */
+
+void MemoryPool::lua(lua_State *vm) {
+  u_int64_t allocations = num_allocations.load(std::memory_order_relaxed);
+  u_int64_t in_use = refs.load(std::memory_order_relaxed) - 1 /* Owner */;
+  u_int32_t slabs_in_use;
+
+  slab_lock.lock(__FILE__, __LINE__);
+  slabs_in_use = num_slabs;
+  slab_lock.unlock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "num_allocations", allocations);
+  lua_push_uint64_table_entry(vm, "num_releases", (allocations > in_use) ? (allocations - in_use) : 0);
+  lua_push_uint64_table_entry(vm, "num_fallbacks", num_fallbacks.load(std::memory_order_relaxed));
+  lua_push_uint64_table_entry(vm, "block_size", block_size);
+  lua_push_uint64_table_entry(vm, "num_slabs", slabs_in_use);
+  lua_push_uint64_table_entry(vm, "num_blocks", (u_int64_t)slabs_in_use * blocks_per_slab);
+  lua_push_uint64_table_entry(vm, "num_blocks_in_use", in_use);
+  lua_push_uint64_table_entry(vm, "memory_bytes",
+			      (u_int64_t)slabs_in_use * blocks_per_slab * (sizeof(pool_block_header_t) + block_size));
+
+  lua_pushstring(vm, name ? name : "");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* **************************************************** */
+
+void* PoolAllocated::operator new(size_t size) {
+  void *ptr = MemoryPool::allocate(NULL, size);
+
+  if(ptr == NULL) throw std::bad_alloc();
+  return(ptr);
+}
+
+/* **************************************************** */
+
+void* PoolAllocated::operator new(size_t size, const std::nothrow_t&) throw() {
+  return(MemoryPool::allocate(NULL, size));
+}
+
+/* **************************************************** */
+
+void* PoolAllocated::operator new(size_t size, MemoryPool *pool) {
+  void *ptr = MemoryPool::allocate(pool, size);
+
+  if(ptr == NULL) throw std::bad_alloc();
+  return(ptr);
+}
+
+/* **************************************************** */
+
+void* PoolAllocated::operator new(size_t size, MemoryPool *pool, const std::nothrow_t&) throw() {
+  return(MemoryPool::allocate(pool, size));
+}
+
+/* **************************************************** */
+
+void PoolAllocated::operator delete(void *ptr)                       { MemoryPool::release(ptr); }
+void PoolAllocated::operator delete(void *ptr, const std::nothrow_t&) { MemoryPool::release(ptr); }
+void PoolAllocated::operator delete(void *ptr, MemoryPool *pool)      { MemoryPool::release(ptr); }
+void PoolAllocated::operator delete(void *ptr, MemoryPool *pool, const std::nothrow_t&) { MemoryPool::release(ptr); }
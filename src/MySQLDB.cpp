@@ -25,36 +25,146 @@
 
 /* **************************************************** */
 
-static void* queryLoop(void* ptr) {
-  Utils::setThreadName("MySQLQueryLoop");
-  return(((MySQLDB*)ptr)->queryLoop());
+static void* writerLoop(void* ptr) {
+  MySQLWriter *w = (MySQLWriter*)ptr;
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "MySQLWriter%u", w->id);
+  Utils::setThreadName(buf);
+
+  return(w->db->writerLoop(w));
 }
 
 /* **************************************************** */
 
-void* MySQLDB::queryLoop() {
-  Redis *r = ntop->getRedis();
-  char sql[CONST_MAX_SQL_QUERY_LEN];
-  bool queue_not_empty = false;
+/*
+  Rows are appended to a per-family (IPv4/IPv6) multi-row INSERT which is
+  executed when it reaches batch_size rows, when it would exceed
+  MYSQL_MAX_BATCH_QUERY_LEN or when its oldest row is MYSQL_BATCH_FLUSH_SEC old.
+
+  A batch that cannot be executed as the connection is down is retained and
+  retried every MYSQL_WRITER_RETRY_SEC: meanwhile the writer stops dequeuing, so
+  the backlog is bounded by the retained batches plus the writer queue, and
+  dumpFlow() drops (and counts) the flows that do not fit it.
+ */
+void* MySQLDB::writerLoop(MySQLWriter *w) {
+  MySQLRow *rows[MYSQL_WRITER_DEQUEUE_BATCH], *row;
+  u_int32_t num_rows = 0, next_row = 0;
+  char *batch[2] = { NULL, NULL };
+  u_int32_t header_len[2], batch_len[2], batch_rows[2] = { 0, 0 };
+  time_t batch_start[2] = { 0, 0 };
+  bool retained[2] = { false, false };
 
   while(!ntop->getGlobals()->isShutdown()
 	&& !MySQLDB::isDbCreated() /* wait until the db has been created */) {
     sleep(1);
   }
 
-  if(ntop->getGlobals()->isShutdown() || !mysql_alt_connected)
+  if(ntop->getGlobals()->isShutdown())
     return(NULL);
 
-  while(isRunning() || queue_not_empty) {
-    int rc = r->lpop(CONST_SQL_QUEUE, sql, sizeof(sql));
+  for(int v = 0; v < 2; v++) {
+    if((batch[v] = (char*)malloc(MYSQL_MAX_BATCH_QUERY_LEN)) == NULL) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Not enough memory for MySQL writer %u", w->id);
+      if(batch[0]) free(batch[0]);
+      return(NULL);
+    }
 
-    if(rc == 0) {
-      queue_not_empty = true;
-      try_exec_sql_query(&mysql_alt, sql);
-    } else {
-      queue_not_empty = false;
-      _usleep(10000);
+    header_len[v] = batch_len[v] = snprintf(batch[v], MYSQL_MAX_BATCH_QUERY_LEN,
+					    "INSERT INTO `%sv%c` " MYSQL_INSERT_FIELDS " VALUES ",
+					    ntop->getPrefs()->get_mysql_tablename(), v ? '6' : '4');
+  }
+
+  while(isRunning() || w->rows->isNotEmpty() || (next_row < num_rows)
+	|| retained[0] || retained[1]) {
+    time_t now = time(NULL);
+
+    if(retained[0] || retained[1]) {
+      for(int v = 0; v < 2; v++) {
+	if(retained[v] && execBatch(w, batch[v], batch_rows[v])) {
+	  ntop->getTrace()->traceEvent(TRACE_NORMAL, "MySQL writer %u: %u retained flows inserted",
+				       w->id, batch_rows[v]);
+	  batch_len[v] = header_len[v], batch_rows[v] = 0, retained[v] = false;
+	}
+      }
+
+      if(retained[0] || retained[1]) {
+	if(!isRunning())
+	  break; /* Shutting down with the db unreachable, what is left is dropped below */
+
+	sleep(MYSQL_WRITER_RETRY_SEC);
+	continue;
+      }
+    }
+
+    if(next_row == num_rows)
+      num_rows = w->rows->dequeueBulk(rows, MYSQL_WRITER_DEQUEUE_BATCH), next_row = 0;
+
+    for(; (next_row < num_rows) && !retained[0] && !retained[1]; next_row++) {
+      int v;
+      size_t len;
+
+      row = rows[next_row], v = row->ipv6 ? 1 : 0, len = strlen(row->values);
+
+      if(batch_rows[v] && (batch_len[v] + len + 2 >= MYSQL_MAX_BATCH_QUERY_LEN)) {
+	if(!execBatch(w, batch[v], batch_rows[v])) {
+	  retained[v] = true;
+	  break; /* The row is appended once the batch has been flushed */
+	}
+
+	batch_len[v] = header_len[v], batch_rows[v] = 0;
+      }
+
+      if(batch_len[v] + len + 2 < MYSQL_MAX_BATCH_QUERY_LEN) {
+	if(batch_rows[v] > 0)
+	  batch[v][batch_len[v]++] = ',';
+	else
+	  batch_start[v] = now;
+
+	memcpy(&batch[v][batch_len[v]], row->values, len + 1);
+	batch_len[v] += len, batch_rows[v]++;
+      } else
+	incNumDroppedFlows();
+
+      free(row);
+
+      if(batch_rows[v] >= batch_size) {
+	if(execBatch(w, batch[v], batch_rows[v]))
+	  batch_len[v] = header_len[v], batch_rows[v] = 0;
+	else
+	  retained[v] = true;
+      }
     }
+
+    for(int v = 0; v < 2; v++) {
+      if(batch_rows[v] && !retained[v] && (now - batch_start[v] >= MYSQL_BATCH_FLUSH_SEC)) {
+	if(execBatch(w, batch[v], batch_rows[v]))
+	  batch_len[v] = header_len[v], batch_rows[v] = 0;
+	else
+	  retained[v] = true;
+      }
+    }
+
+    if(num_rows == 0)
+      w->rows->wait();
+  }
+
+  /* Flush what is left */
+  for(int v = 0; v < 2; v++) {
+    if(batch_rows[v] && (retained[v] || !execBatch(w, batch[v], batch_rows[v])))
+      incNumDroppedFlows(batch_rows[v]);
+
+    free(batch[v]);
+  }
+
+  for(; next_row < num_rows; next_row++) {
+    free(rows[next_row]);
+    incNumDroppedFlows();
+  }
+
+  while((row = w->rows->dequeue()) != NULL) {
+    free(row);
+    incNumDroppedFlows();
   }
 
   return(NULL);
@@ -487,19 +597,53 @@ bool MySQLDB::createNprobeDBView() {
 /* ******************************************* */
 
 MySQLDB::MySQLDB(NetworkInterface *_iface) : DB(_iface) {
-  mysqlEnqueuedFlows = 0;
+  u_int32_t queue_len;
+
   log_fd = NULL;
   open_log();
 
   connectToDB(&mysql, false);
-  mysql_alt_connected = connectToDB(&mysql_alt, true);
+
+  batch_size = ntop->getPrefs()->get_mysql_batch_size();
+  queue_len = max_val(CONST_MAX_MYSQL_QUEUE_LEN, 4 * batch_size);
+  num_writers = 0;
+
+  for(u_int8_t i = 0; i < ntop->getPrefs()->get_num_mysql_writers(); i++) {
+    MySQLWriter *w = new (std::nothrow) MySQLWriter;
+    char name[32];
+
+    if(!w) break;
+
+    snprintf(name, sizeof(name), "mysqlWriter_%u", i);
+    w->db = this, w->id = i, w->thread_created = false, w->num_batches = 0;
+
+    if((w->rows = new (std::nothrow) SPSCQueue<MySQLRow*>(queue_len, name)) == NULL) {
+      delete w;
+      break;
+    }
+
+    w->connected = connectToDB(&w->conn, true);
+    writers[num_writers++] = w;
+  }
 }
 
 /* ******************************************* */
 
 MySQLDB::~MySQLDB() {
   shutdown();
-  disconnectFromDB(&mysql_alt);
+
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    MySQLWriter *w = writers[i];
+    MySQLRow *row;
+
+    while((row = w->rows->dequeue()) != NULL)
+      free(row);
+
+    disconnectFromDB(&w->conn);
+    delete w->rows;
+    delete w;
+  }
+
   disconnectFromDB(&mysql);
 
   if(log_fd) fclose(log_fd);
@@ -546,7 +690,10 @@ void MySQLDB::startLoop() {
     }
   }
 
-  pthread_create(&queryThreadLoop, NULL, ::queryLoop, (void*)this);
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    if(pthread_create(&writers[i]->thread, NULL, ::writerLoop, (void*)writers[i]) == 0)
+      writers[i]->thread_created = true;
+  }
 }
 
 /* ******************************************* */
@@ -556,7 +703,13 @@ void MySQLDB::shutdown() {
     void *res;
 
     DB::shutdown();
-    pthread_join(queryThreadLoop, &res);
+
+    for(u_int8_t i = 0; i < num_writers; i++) {
+      if(writers[i]->thread_created) {
+	pthread_join(writers[i]->thread, &res);
+	writers[i]->thread_created = false;
+      }
+    }
   }
 }
 
@@ -694,44 +847,41 @@ void MySQLDB::try_exec_sql_query(MYSQL *conn, char *sql) {
 
 /* ******************************************* */
 
-bool MySQLDB::dumpFlow(time_t when, Flow *f, char *json) {
-  char sql[CONST_MAX_SQL_QUERY_LEN];
+/*
+  Returns false, leaving the batch to the caller, when it could not be executed
+  as the connection is down. Batches failing for other reasons are dropped.
+ */
+bool MySQLDB::execBatch(MySQLWriter *w, char *sql, u_int32_t num_rows) {
+  int rc;
 
-  if((f->get_cli_ip_addr() == NULL) || (f->get_srv_ip_addr() == NULL) || !MySQLDB::db_created)
+  if(!w->connected && !(w->connected = connectToDB(&w->conn, true)))
     return(false);
 
-  if(f->get_cli_ip_addr()->isIPv4())
-    snprintf(sql, sizeof(sql), "INSERT INTO `%sv4` " MYSQL_INSERT_FIELDS " VALUES ",
-	     ntop->getPrefs()->get_mysql_tablename());
-  else
-    snprintf(sql, sizeof(sql), "INSERT INTO `%sv6` " MYSQL_INSERT_FIELDS " VALUES ",
-	     ntop->getPrefs()->get_mysql_tablename());
-
-  /* do the actual flow insertion as a tuple */
-  flow2InsertValues(f, json, &sql[strlen(sql)], sizeof(sql) - strlen(sql) - 1);
+  if((rc = exec_sql_query(&w->conn, sql, true /* Attempt to reconnect */, true /* Don't print errors */, false)) < 0) {
+    switch((rc == -2 /* Not operational */) ? CR_CONNECTION_ERROR : mysql_errno(&w->conn)) {
+    case CR_CONNECTION_ERROR:
+    case CR_CONN_HOST_ERROR:
+    case CR_SERVER_GONE_ERROR:
+    case CR_SERVER_LOST:
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "MySQL writer %u: connection lost, retaining %u flows",
+				   w->id, num_rows);
+      disconnectFromDB(&w->conn);
+      w->connected = false;
+      return(false);
 
-  if (iface->read_from_pcap_dump()) {
-    /* 
-     Inserting inline in case of PCAP file as interrupting the datapath
-     is not an issue and also avoids flows drops due to the redis queue 
-     maximum length
-    */
-    try_exec_sql_query(&mysql_alt, sql);
+    default:
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "MySQL error: %s [%u flows not inserted]",
+				   get_last_db_error(&w->conn), num_rows);
+      incNumDroppedFlows(num_rows);
 
-  } else {
-    if (ntop->getRedis()->llen(CONST_SQL_QUEUE) < CONST_MAX_MYSQL_QUEUE_LEN) {
-      /* 
-       We know that we should have locked before evaluating the condition
-       above as another thread, via the lpush below, can invalidate the condition.
-       However, we prefer to avoid an additional lock as the lpush guarantees
-       that no more than CONST_MAX_MYSQL_QUEUE_LEN will ever be in the queue.
-       The drawback is that the counter mysqlDroppedFlows
-       is not guaranteed to be 100% accurate but we can tolerate this.
-      */
-      ntop->getRedis()->lpush(CONST_SQL_QUEUE, sql, CONST_MAX_MYSQL_QUEUE_LEN);
-    } else {
-      incNumDroppedFlows();
+      /* Don't give up, manually re-connect */
+      disconnectFromDB(&w->conn);
+      w->connected = connectToDB(&w->conn, true);
+      break;
     }
+  } else {
+    incNumExportedFlows(num_rows);
+    w->num_batches++;
   }
 
   return(true);
@@ -739,6 +889,51 @@ bool MySQLDB::dumpFlow(time_t when, Flow *f, char *json) {
 
 /* ******************************************* */
 
+bool MySQLDB::dumpFlow(time_t when, Flow *f, char *json) {
+  char values[CONST_MAX_SQL_QUERY_LEN];
+  MySQLWriter *w;
+  MySQLRow *row;
+  bool enqueued;
+  int len;
+
+  if((f->get_cli_ip_addr() == NULL) || (f->get_srv_ip_addr() == NULL) || !MySQLDB::db_created || (num_writers == 0))
+    return(false);
+
+  len = flow2InsertValues(f, json, values, sizeof(values));
+
+  if((len < 0) || (len >= (int)sizeof(values)))
+    return(false); /* Truncated tuples would break the whole INSERT */
+
+  if((row = (MySQLRow*)malloc(sizeof(MySQLRow) + len)) == NULL)
+    return(false);
+
+  row->ipv6 = !f->get_cli_ip_addr()->isIPv4();
+  memcpy(row->values, values, len + 1);
+
+  /* Flows are spread across the writers, each having its own queue and connection */
+  w = writers[(num_writers > 1) ? (f->key() % num_writers) : 0];
+
+  if(iface->isView()) enqueue_lock.lock(__FILE__, __LINE__);
+
+  while(!(enqueued = w->rows->enqueue(row, true))
+	&& iface->read_from_pcap_dump() && isRunning()) {
+    /*
+      Don't drop flows read from pcap files, interrupting
+      the datapath is not an issue in this case
+    */
+    _usleep(1000);
+  }
+
+  if(iface->isView()) enqueue_lock.unlock(__FILE__, __LINE__);
+
+  if(!enqueued)
+    free(row);
+
+  return(enqueued);
+}
+
+/* ******************************************* */
+
 void MySQLDB::disconnectFromDB(MYSQL *conn) {
   mysql_close(conn);
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Disconnected from MySQL for interface %s...",
@@ -935,7 +1130,7 @@ int MySQLDB::exec_sql_query(MYSQL *conn, const char *sql,
     ntop->getTrace()->traceEvent(TRACE_INFO, "Successfully executed '%s'", sql);
     // we want to return the number of rows which is more informative
     // than a simple 0
-    if((result = mysql_store_result(&mysql)) == NULL)
+    if((result = mysql_store_result(conn)) == NULL)
       rc = 0;  // unable to retrieve the result but still the query succeeded
     else {
       rc = mysql_num_rows(result);
@@ -1021,4 +1216,22 @@ int MySQLDB::exec_sql_query(lua_State *vm, char *sql, bool limitRows, bool wait_
   return(0);
 }
 
+/* ******************************************* */
+
+void MySQLDB::lua(lua_State *vm, bool since_last_checkpoint) const {
+  u_int64_t num_batches = 0, num_queued = 0;
+
+  DB::lua(vm, since_last_checkpoint);
+
+  for(u_int8_t i = 0; i < num_writers; i++) {
+    num_batches += writers[i]->num_batches;
+    num_queued  += writers[i]->rows->getLength();
+  }
+
+  lua_push_uint64_table_entry(vm, "flow_export_queued", num_queued);
+  lua_push_uint64_table_entry(vm, "flow_export_batches", num_batches);
+  lua_push_uint64_table_entry(vm, "mysql_batch_size", batch_size);
+  lua_push_uint64_table_entry(vm, "mysql_num_writers", num_writers);
+}
+
 #endif
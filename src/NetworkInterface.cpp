@@ -50,8 +50,6 @@ NetworkInterface::NetworkInterface(const char *name,
 
   customIftype = custom_interface_type;
   influxdb_ts_exporter = rrd_ts_exporter = NULL;
-  hooksEngine = NULL;
-  hooks_engine_reload = false;
   hooks_engine_next_reload = 0;
   flows_dump_json = true; /* JSON dump enabled by default, possibly disabled in NetworkInterface::startFlowDumping */
   flows_dump_json_use_labels = false; /* Dump of JSON labels disabled by default, possibly enabled in NetworkInterface::startFlowDumping */
@@ -157,7 +155,7 @@ NetworkInterface::NetworkInterface(const char *name,
 
   if(id >= 0) {
     last_pkt_rcvd = last_pkt_rcvd_remote = 0, pollLoopCreated = false,
-      flowDumpLoopCreated = false, hookLoopCreated = false, bridge_interface = false;
+      flowDumpLoopCreated = false, bridge_interface = false;
     next_idle_flow_purge = next_idle_host_purge = next_idle_other_purge = 0;
     cpu_affinity = -1 /* no affinity */,
       has_vlan_packets = has_ebpf_events = false;
@@ -261,7 +259,7 @@ void NetworkInterface::init() {
     cpu_affinity = -1 /* no affinity */,
     inline_interface = false, running = false, interfaceStats = NULL,
     has_too_many_hosts = has_too_many_flows = false,
-    flow_dump_disabled = false,
+    flow_dump_disabled = false, restoring_snapshot = false, final_snapshot_saved = false,
     numL2Devices = 0, numHosts = 0, numLocalHosts = 0,
     arp_requests = arp_replies = 0,
     has_mac_addresses = false,
@@ -276,6 +274,8 @@ void NetworkInterface::init() {
   flows_hash = NULL, hosts_hash = NULL;
   macs_hash = NULL, ases_hash = NULL, vlans_hash = NULL;
   countries_hash = NULL;
+  flows_pool = hosts_pool = macs_pool = NULL;
+  ip_addresses_pool = icmp_info_pool = interarrival_pool = NULL;
 
   reload_hosts_bcast_domain = false;
   hosts_bcast_domain_last_update = 0;
@@ -330,13 +330,19 @@ void NetworkInterface::init() {
   next_compq_insert_idx = next_compq_remove_idx = 0;
 
   idleFlowsToDump = activeFlowsToDump = NULL;
+  flows_dump_json_writer = NULL;
 
   /*
-    Initialize user-script queues
+    Initialize user-script workers (and their queues)
   */
-  hookProtocolDetected = new (std::nothrow) SPSCQueue<Flow *>(MAX_US_PROTOCOL_DETECTED_QUEUE_LEN, "hookProtocolDetected");
-  hookPeriodicUpdate   = new (std::nothrow) SPSCQueue<Flow *>(MAX_US_PERIODIC_UPDATE_QUEUE_LEN, "hookPeriodicUpdate");
-  hookFlowEnd          = new (std::nothrow) SPSCQueue<Flow *>(MAX_US_FLOW_END_QUEUE_LEN, "hookFlowEnd");
+  num_hook_workers = 0;
+  for(u_int8_t i = 0; i < (ntop->getPrefs() ? ntop->getPrefs()->get_num_flow_hook_threads() : 1); i++) {
+    if((hook_workers[num_hook_workers] = new (std::nothrow) FlowHooksWorker(this, i)) != NULL)
+      num_hook_workers++;
+  }
+
+  host_hydrator = new (std::nothrow) LocalHostHydrator(this);
+  recorder = NULL;
 
   PROFILING_INIT();
 }
@@ -514,6 +520,17 @@ void NetworkInterface::deleteDataStructures() {
   if(vlans_hash)            { delete(vlans_hash); vlans_hash = NULL; }
   if(macs_hash)             { delete(macs_hash);  macs_hash = NULL;  }
 
+  /*
+    Entries still referenced elsewhere (e.g. flows queued for dumping) are
+    released into the pools later on: each pool is actually deleted with
+    its last block
+  */
+  MemoryPool **pools[] = { &flows_pool, &hosts_pool, &macs_pool,
+			   &ip_addresses_pool, &icmp_info_pool, &interarrival_pool };
+
+  for(u_int i = 0; i < sizeof(pools) / sizeof(pools[0]); i++)
+    if(*pools[i]) { (*pools[i])->destroy(); *pools[i] = NULL; }
+
   if(companionQueue) {
     for(u_int16_t i = 0; i < COMPANION_QUEUE_LEN; i++)
       if(companionQueue[i])
@@ -547,12 +564,18 @@ NetworkInterface::~NetworkInterface() {
     cleanup();
   }
 
+  /* Releases the hosts still referenced by the hydrator */
+  if(host_hydrator) delete host_hydrator;
+  if(recorder)      delete recorder;
+
   deleteDataStructures();
 
   if(idleFlowsToDump)   delete idleFlowsToDump;
   if(activeFlowsToDump) delete activeFlowsToDump;
+  if(flows_dump_json_writer) delete flows_dump_json_writer;
 
-  if(hooksEngine)       delete hooksEngine;
+  for(u_int8_t i = 0; i < num_hook_workers; i++)
+    delete hook_workers[i];
 
   if(db) {
     db->shutdown();
@@ -611,51 +634,19 @@ NetworkInterface::~NetworkInterface() {
 /* **************************************************** */
 
 bool NetworkInterface::hookEnqueue(time_t t, Flow *f) {
-  bool ret = false;
-  SPSCQueue<Flow *> *selected_queue = NULL;
+  if(num_hook_workers == 0)
+    return(false);
 
   /*
-    Choose the right queue to perform the enqueue
+    Always pick the same worker for a flow so that its hooks are executed in order
    */
+  return(hook_workers[(num_hook_workers > 1) ? (f->key() % num_hook_workers) : 0]->enqueue(f));
+}
 
-  switch(f->get_state()) {
-  case hash_entry_state_flow_protocoldetected:
-    selected_queue = hookProtocolDetected;
-    break;
-  case hash_entry_state_active:
-    selected_queue = hookPeriodicUpdate;
-    break;
-  case hash_entry_state_idle:
-    selected_queue = hookFlowEnd;
-    break;
-  default:
-    break;
-  }
-
-  /* Perform the actual enqueue */
-  if(selected_queue) {
-    if(selected_queue->enqueue(f, true)) {
-      /*
-	If enqueue was successful, increase the flow reference counter.
-	Reference counter will be deleted when doing the dequeue.
-       */
-      f->incUses();
-
-      /*
-	Signal the waiter on the condition variable
-       */
-      hooks_condition.signal();
-
-      ret = true;
-    } else {
-      /*
-	Enqueue failure.
-       */
-      ret = false;
-    }
-  }
+/* **************************************************** */
 
-  return ret;
+bool NetworkInterface::enqueueHostHydration(LocalHost *h, LocalHostHydrationType type) {
+  return(host_hydrator && host_hydrator->enqueue(h, type));
 }
 
 /* **************************************************** */
@@ -676,7 +667,7 @@ int NetworkInterface::dumpFlow(time_t when, Flow *f) {
 	Don't signal for view interfaces, they use sleep.
        */
 #ifndef WIN32
-      if(!isViewed()) dump_condition.signal();
+      if(!isViewed()) dump_condition.signalIfWaiting();
 #endif
 
 #if DEBUG_FLOW_DUMP
@@ -695,7 +686,7 @@ int NetworkInterface::dumpFlow(time_t when, Flow *f) {
 	Signal there's work to do.
        */
 #ifndef WIN32
-      if(!isViewed()) dump_condition.signal();
+      if(!isViewed()) dump_condition.signalIfWaiting();
 #endif
 
 #if DEBUG_FLOW_DUMP
@@ -722,11 +713,39 @@ void NetworkInterface::flushFlowDump() {
 
 /* **************************************************** */
 
+/* Serializations not yet written: they are written in batch, one round-trip per batch */
+struct local_hosts_2_redis_batch {
+  u_int32_t num;
+  char *keys[REDIS_PIPELINE_BATCH], *values[REDIS_PIPELINE_BATCH];
+  u_int32_t values_len[REDIS_PIPELINE_BATCH]; /* Values can be binary */
+};
+
+static void local_hosts_2_redis_flush(struct local_hosts_2_redis_batch *batch) {
+  if(batch->num == 0) return;
+
+  ntop->getRedis()->mset(batch->num, batch->keys, batch->values,
+			 ntop->getPrefs()->get_local_host_cache_duration(), batch->values_len);
+
+  for(u_int32_t i = 0; i < batch->num; i++)
+    free(batch->keys[i]), free(batch->values[i]);
+
+  batch->num = 0;
+}
+
+/* **************************************************** */
+
 static bool local_hosts_2_redis_walker(GenericHashEntry *h, void *user_data, bool *matched) {
   Host *host = (Host*)h;
+  struct local_hosts_2_redis_batch *batch = (struct local_hosts_2_redis_batch*)user_data;
 
   if(host && (host->isLocalHost() || host->isSystemHost())) {
-    ((LocalHost*)host)->serializeToRedis();
+    /* Hosts not restored yet would overwrite the cached state with partial counters */
+    if(!((LocalHost*)host)->isHydrationPending()
+       && ((LocalHost*)host)->getRedisSerialization(&batch->keys[batch->num], &batch->values[batch->num],
+						    &batch->values_len[batch->num])
+       && (++batch->num == REDIS_PIPELINE_BATCH))
+      local_hosts_2_redis_flush(batch);
+
     *matched = true;
   }
 
@@ -739,9 +758,14 @@ int NetworkInterface::dumpLocalHosts2redis(bool disable_purge) {
   int rc;
   u_int32_t begin_slot = 0;
   bool walk_all = true;
+  struct local_hosts_2_redis_batch batch;
+
+  batch.num = 0;
 
   rc = walker(&begin_slot, walk_all,  walker_hosts,
-	      local_hosts_2_redis_walker, NULL) ? 0 : -1;
+	      local_hosts_2_redis_walker, &batch) ? 0 : -1;
+
+  local_hosts_2_redis_flush(&batch);
 
 #ifdef NTOPNG_PRO
   if(getHostPools()) getHostPools()->dumpToRedis();
@@ -752,6 +776,87 @@ int NetworkInterface::dumpLocalHosts2redis(bool disable_purge) {
 
 /* **************************************************** */
 
+bool NetworkInterface::saveTablesSnapshot(bool final) {
+  TablesSnapshot snapshot(this);
+  bool rc = false;
+
+  if(!ntop->getPrefs()->is_tables_snapshot_enabled() || !flows_hash || isView() || isViewed())
+    return(false);
+
+  /* Saves write the same files, so a save waits for the one in progress */
+  snapshot_lock.lock(__FILE__, __LINE__);
+
+  /* The tables are emptied after the final snapshot: it must not be overwritten */
+  if(!final_snapshot_saved) {
+    rc = snapshot.save();
+    if(final) final_snapshot_saved = true;
+  }
+
+  snapshot_lock.unlock(__FILE__, __LINE__);
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+/* Must be called before the packet processing starts */
+bool NetworkInterface::restoreTablesSnapshot() {
+  TablesSnapshot snapshot(this);
+  bool rc;
+
+  if(!ntop->getPrefs()->is_tables_snapshot_enabled() || !flows_hash || isView() || isViewed())
+    return(false);
+
+  restoring_snapshot = true;
+  rc = snapshot.restore();
+  restoring_snapshot = false;
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+/* Creates a host of the snapshot, as done by findFlowHosts() but without reading the local hosts cache */
+Host* NetworkInterface::restoreHost(Mac *mac, u_int16_t vlan_id, IpAddress *ip) {
+  Host *h;
+  int16_t local_network_id;
+
+  if(!hosts_hash || !hosts_hash->hasEmptyRoom())
+    return(NULL);
+
+  if((h = hosts_hash->get(vlan_id, ip, true /* Inline call */)) != NULL)
+    return(h);
+
+  if(ip->isLocalHost(&local_network_id) || ip->isLocalInterfaceAddress())
+    h = new (hosts_pool, std::nothrow) LocalHost(this, mac, vlan_id, ip);
+  else
+    h = new (hosts_pool, std::nothrow) RemoteHost(this, mac, vlan_id, ip);
+
+  if(h && !hosts_hash->add(h, false /* Don't lock, we're inline with the purgeIdle */)) {
+    delete h;
+    h = NULL;
+  }
+
+  return(h);
+}
+
+/* **************************************************** */
+
+/* Returns NULL when the flow already exists */
+Flow* NetworkInterface::restoreFlow(u_int16_t vlan_id, u_int8_t l4_proto,
+				   Mac *cli_mac, IpAddress *cli_ip, u_int16_t cli_port,
+				   Mac *srv_mac, IpAddress *srv_ip, u_int16_t srv_port,
+				   time_t first_seen, time_t last_seen) {
+  bool src2dst_direction, new_flow = false;
+  Flow *f = getFlow(cli_mac, srv_mac, vlan_id, 0, 0, 0, NULL /* ICMP flows are not restored */,
+		    cli_ip, srv_ip, cli_port, srv_port, l4_proto,
+		    &src2dst_direction, first_seen, last_seen, 0, &new_flow, true /* create_if_missing */);
+
+  return(new_flow ? f : NULL);
+}
+
+/* **************************************************** */
+
 u_int32_t NetworkInterface::getHostsHashSize() {
   return(hosts_hash ? hosts_hash->getNumEntries() : 0);
 }
@@ -850,8 +955,8 @@ Flow* NetworkInterface::getFlow(Mac *srcMac, Mac *dstMac,
   if(vlan_id != 0)
     setSeenVlanTaggedPackets();
 
-  if((srcMac && Utils::macHash(srcMac->get_mac()) != 0)
-     || (dstMac && Utils::macHash(dstMac->get_mac()) != 0))
+  if((srcMac && !Utils::isEmptyMac(srcMac->get_mac()))
+     || (dstMac && !Utils::isEmptyMac(dstMac->get_mac())))
     setSeenMacAddresses();
 
   PROFILING_SECTION_ENTER("NetworkInterface::getFlow: flows_hash->find", 1);
@@ -875,11 +980,11 @@ Flow* NetworkInterface::getFlow(Mac *srcMac, Mac *dstMac,
 
     try {
       PROFILING_SECTION_ENTER("NetworkInterface::getFlow: new Flow", 2);
-      ret = new Flow(this, vlan_id, l4_proto,
-		     srcMac, src_ip, src_port,
-		     dstMac, dst_ip, dst_port,
-		     icmp_info,
-		     first_seen, last_seen);
+      ret = new (flows_pool) Flow(this, vlan_id, l4_proto,
+				  srcMac, src_ip, src_port,
+				  dstMac, dst_ip, dst_port,
+				  icmp_info,
+				  first_seen, last_seen);
       PROFILING_SECTION_EXIT(2);
     } catch(std::bad_alloc& ba) {
       static bool oom_warning_sent = false;
@@ -964,7 +1069,7 @@ Flow* NetworkInterface::getFlow(Mac *srcMac, Mac *dstMac,
 /* **************************************************** */
 
 /* NOTE: the interface is deleted when this method returns false */
-bool NetworkInterface::registerSubInterface(NetworkInterface *sub_iface, u_int64_t criteria) {
+bool NetworkInterface::initSubInterface(NetworkInterface *sub_iface) {
   /* registerInterface deletes the interface on failure */
   if(!ntop->registerInterface(sub_iface))
     return false;
@@ -979,8 +1084,6 @@ bool NetworkInterface::registerSubInterface(NetworkInterface *sub_iface, u_int64
 
   sub_iface->startPacketPolling(); /* Won't actually start a thread, just mark this interface as running */
 
-  flowHashing[criteria] = sub_iface; /* Add it to the hash */
-
   numSubInterfaces++;
   ntop->getRedis()->set(CONST_STR_RELOAD_LISTS, (const char * const)"1");
 
@@ -989,6 +1092,18 @@ bool NetworkInterface::registerSubInterface(NetworkInterface *sub_iface, u_int64
 
 /* **************************************************** */
 
+/* NOTE: the interface is deleted when this method returns false */
+bool NetworkInterface::registerSubInterface(NetworkInterface *sub_iface, u_int64_t criteria) {
+  if(!initSubInterface(sub_iface))
+    return false;
+
+  flowHashing[criteria] = sub_iface; /* Add it to the hash */
+
+  return true;
+}
+
+/* **************************************************** */
+
 NetworkInterface* NetworkInterface::getDynInterface(u_int64_t criteria, bool parser_interface) {
   NetworkInterface *sub_iface = NULL;
 #ifndef HAVE_NEDGE
@@ -1656,6 +1771,9 @@ void NetworkInterface::purgeIdle(time_t when, bool force_idle) {
 
   checkHostsToRestore();
 
+  /* Merge the local hosts state restored from the cache in the meantime */
+  if(host_hydrator) host_hydrator->applyCompletions();
+
 #if defined(NTOPNG_PRO) && !defined(HAVE_NEDGE)
   if(pMap) pMap->purgeIdle(when);
   if(sMap) sMap->purgeIdle(when);
@@ -1685,6 +1803,9 @@ bool NetworkInterface::dissectPacket(u_int32_t bridge_iface_idx,
   /* Note summy ethernet is always 0 unless sender_mac is set (Netfilter only) */
   memset(&dummy_ethernet, 0, sizeof(dummy_ethernet));
 
+  if(recorder)
+    recorder->recordPacket(h, packet, DissectionWorker::packetHash(pcap_datalink_type, h, packet));
+
   pollQueuedeCompanionEvents();
   bcast_domains->inlineReloadBroadcastDomains();
 
@@ -2361,38 +2482,6 @@ void NetworkInterface::pollQueuedeCompanionEvents() {
 
 /* **************************************************** */
 
-u_int64_t NetworkInterface::dequeueFlows(SPSCQueue<Flow *> *q, FlowLuaCall flow_lua_call, u_int budget) {
-  u_int64_t num_done = 0;
-
-  while(q->isNotEmpty()) {
-    Flow *f = q->dequeue();
-
-    /*
-      Execute the callback (if the engine is available
-     */
-    if(hooksEngine)
-      f->performLuaCall(flow_lua_call, hooksEngine);
-
-#if DEBUG_FLOW_HOOKS
-    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dequeued idle flow");
-#endif
-
-    /*
-      Now that the job is done, the reference counter to the flow can be decreased.
-     */
-    f->decUses();
-
-    num_done++;
-    if(budget > 0 /* Budget requested */
-       && num_done >= budget /* Budget exceeded */)
-      break;
-  }
-
-  return num_done;
-}
-
-/* **************************************************** */
-
 /*
   Called periodically to decide if it is time to reload the lua engine used to execute flow user script hooks
  */
@@ -2401,75 +2490,11 @@ void NetworkInterface::updateHooksEngineReload() {
 
   if(hooks_engine_next_reload == 0 /* Need to be set for the first time */
      || now > hooks_engine_next_reload /* Time to reload */) {
-    hooks_engine_reload = true;
-    hooks_engine_next_reload = now + HOOKS_ENGINE_LIFETIME;
-  }
-}
-
-/* **************************************************** */
-
-u_int64_t NetworkInterface::dequeueFlowsForHooks(u_int protocol_detected_budget, u_int active_budget, u_int idle_budget) {
-  u_int64_t num_done = 0;
+    for(u_int8_t i = 0; i < num_hook_workers; i++)
+      hook_workers[i]->reloadEngine();
 
-  /*
-    Check if it is time to reload the engine.
-    First, we free the memory (if necessary) and then we allocate it.
-   */
-  if(hooks_engine_reload) {
-    if(hooksEngine) {
-      delete hooksEngine;
-      hooksEngine = NULL;
-    }
-
-    hooks_engine_reload = false;
-  }
-
-  if(!hooksEngine)
-    hooksEngine = new (nothrow) FlowAlertCheckLuaEngine(this);
-
-  /*
-    Start with highest-priority, flow hooks for idle flows. Failing to execute a hook for an idle flow is critical as there
-    will not be any chance to execute it again in the future.
-
-    Then, do mid-priority flow hooks for protocol-detected flows. Executing these hooks is crucial as well, as the flow only stays
-    in this state for a very short time and there won't be chances to execute these scripts again.
-
-    Finally, do low-priority periodic update hooks. These hooks can be retried multiple times so their priority is low.
-   */
-  
-  num_done += dequeueFlows(hookFlowEnd, flow_lua_call_idle, idle_budget);
-  num_done += dequeueFlows(hookProtocolDetected, flow_lua_call_protocol_detected, protocol_detected_budget);
-  num_done += dequeueFlows(hookPeriodicUpdate, flow_lua_call_periodic_update, active_budget);
-
-#ifndef WIN32
-  if(num_done == 0) {
-    /*
-      No flow was dequeued. Let's wait for at most 1s. Cannot wait indefinitely
-      as we must ensure purgeQueuedIdleFlows() gets executed, and also to exit when it's
-      time to shutdown.
-    */
-    struct timespec hooks_wait_expire;
-
-    hooks_wait_expire.tv_sec = time(NULL) + 1,
-      hooks_wait_expire.tv_nsec = 0;
-
-    hooks_condition.timedWait(&hooks_wait_expire);
+    hooks_engine_next_reload = now + HOOKS_ENGINE_LIFETIME;
   }
-#endif
-
-  /* Purging of idle flows is done here as it involves decreasing certain hosts counters (such as host scores)
-     that are increased by flow user script hooks. Hence, by executing the purging here in this thread, we ensure
-     consistency of counters.
-  */
-  num_done += purgeQueuedIdleFlows();
-
-#if DEBUG_FLOW_HOOKS
-  if(num_done > 0)
-    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dequeued flows [%u]", num_done);
-#endif
-
-
-  return num_done;
 }
 
 /* **************************************************** */
@@ -2515,13 +2540,11 @@ u_int64_t NetworkInterface::dequeueFlowsForDump(u_int idle_flows_budget, u_int a
     char *json = NULL;
 
     /* Prepare the JSON - if requested */
-    if(flows_dump_json)
-      json = f->serialize(flows_dump_json_use_labels);
+    if(flows_dump_json && flows_dump_json_writer)
+      json = f->serialize(flows_dump_json_writer, flows_dump_json_use_labels);
 
     int rc = dumper->dumpFlow(f->get_last_seen(), f, json); /* Finally dump this flow */
 
-    if(json) free(json);
-
 #if DEBUG_FLOW_DUMP
     ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dumped idle flow");
 #endif
@@ -2542,13 +2565,11 @@ u_int64_t NetworkInterface::dequeueFlowsForDump(u_int idle_flows_budget, u_int a
     char *json = NULL;
 
     /* Prepare the JSON - if requested */
-    if(flows_dump_json)
-      json = f->serialize(flows_dump_json_use_labels);
+    if(flows_dump_json && flows_dump_json_writer)
+      json = f->serialize(flows_dump_json_writer, flows_dump_json_use_labels);
 
     int rc = dumper->dumpFlow(f->get_last_seen(), f, json); /* Finally dump this flow */
 
-    if(json) free(json);
-
 #if DEBUG_FLOW_DUMP
     ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dumped active flow");
 #endif
@@ -2579,45 +2600,17 @@ u_int64_t NetworkInterface::dequeueFlowsForDump(u_int idle_flows_budget, u_int a
     dump_wait_expire.tv_sec = time(NULL) + 1,
       dump_wait_expire.tv_nsec = 0;
 
-    dump_condition.timedWait(&dump_wait_expire);
-  }
-#endif
+    /* Producers only signal when we are parked: check the queues again once announced */
+    dump_condition.prepareWait();
 
-  return num_done;
-}
-
-/* **************************************************** */
-
-void NetworkInterface::hookFlowLoop() {
-  ntop->getTrace()->traceEvent(TRACE_NORMAL,
-			       "Started flow user script hooks loop on interface %s [id: %u]...",
-			       get_description(), get_id());
+    if(!idleFlowsToDump->isNotEmpty() && !activeFlowsToDump->isNotEmpty())
+      dump_condition.timedWait(&dump_wait_expire);
 
-  /* Wait until it starts up */
-  while(!isRunning()) _usleep(10000);
-
-  /* Now operational */
-  while(isRunning()) {
-    /*
-      Dequeue flows for dump.
-
-      To guarantee some sort of fairness and prioritization, different numbers are used for each
-      of the three queues. Higher numbers are used for queues with higher-priority.
-     */
-    u_int64_t n = dequeueFlowsForHooks(16 /* protocol_detected_budget */, 4 /* active_budget */, 32 /* idle_budget */);
-
-    if(n == 0) {
-      /*
-	If windows, sleep if nothing was done during the previous cycle.
-	On non-windows, there's nothing do to as signal/waits are implemented to throttle the speed
-      */
-#ifdef WIN32
-      _usleep(10000);
-#endif
-    }
+    dump_condition.cancelWait();
   }
+#endif
 
-  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Flow dump thread completed for %s", get_name());
+  return num_done;
 }
 
 /* **************************************************** */
@@ -2651,15 +2644,6 @@ void NetworkInterface::dumpFlowLoop() {
 
 /* **************************************************** */
 
-static void* hookLoop(void* ptr) {
-  NetworkInterface *_if = (NetworkInterface*)ptr;
-
-  _if->hookFlowLoop();
-  return(NULL);
-}
-
-/* **************************************************** */
-
 static void* flowDumper(void* ptr) {
   NetworkInterface *_if = (NetworkInterface*)ptr;
 
@@ -2691,6 +2675,7 @@ void NetworkInterface::startFlowDumping() {
       Use labels for JSON fields when exporting to ElasticSearch or LogStash.
      */
     flows_dump_json_use_labels = ntop->getPrefs()->do_dump_flows_on_es() || ntop->getPrefs()->do_dump_flows_on_ls();
+    flows_dump_json_writer = new (std::nothrow) JSONStreamWriter();
   }
 
   if(!isViewed()) { /* Do not spawn the dumper thread for viewed interfaces - it's the view interface that has the dumper thread */
@@ -2735,6 +2720,18 @@ void NetworkInterface::startPacketPolling() {
 			       "Started packet polling on interface %s [id: %u]...",
 			       get_description(), get_id());
 
+  /* Created here as shards and views do not poll packets */
+  if(!recorder && isPacketInterface() && !isView() && !read_from_pcap_dump()
+     && (ntop->getPrefs()->get_packet_recorder_max_gb() > 0)) {
+    try {
+      recorder = new PacketRecorder(this, (u_int64_t)ntop->getPrefs()->get_packet_recorder_max_gb() << 30);
+      recorder->startRecording();
+    } catch(std::bad_alloc& ba) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Not enough memory for the packet recorder of %s", get_name());
+      recorder = NULL;
+    }
+  }
+
   running = true;
 }
 
@@ -2748,7 +2745,17 @@ void NetworkInterface::shutdown() {
 
     if(pollLoopCreated)     pthread_join(pollLoop, &res);
     if(flowDumpLoopCreated) pthread_join(flowDumpLoop, &res);
-    if(hookLoopCreated)     pthread_join(hookLoop, &res);
+
+    /* No more packets: flush the recorded ones */
+    if(recorder) recorder->stopRecording();
+
+    for(u_int8_t i = 0; i < num_hook_workers; i++)
+      hook_workers[i]->stopHooks();
+
+    if(host_hydrator) host_hydrator->stopHydration();
+
+    /* Before the final purge, that marks all the entries as idle */
+    saveTablesSnapshot(true);
 
     /* purgeIdle one last time to make sure all entries will be marked as idle */
     purgeIdle(time(NULL), true);
@@ -2803,11 +2810,11 @@ void NetworkInterface::findFlowHosts(u_int16_t vlanId,
 
     if(_src_ip && (_src_ip->isLocalHost(&local_network_id) || _src_ip->isLocalInterfaceAddress())) {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new LocalHost", 4);
-      (*src) = new (std::nothrow) LocalHost(this, src_mac, vlanId, _src_ip);
+      (*src) = new (hosts_pool, std::nothrow) LocalHost(this, src_mac, vlanId, _src_ip);
       PROFILING_SECTION_EXIT(4);
     } else {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new RemoteHost", 5);
-      (*src) = new (std::nothrow) RemoteHost(this, src_mac, vlanId, _src_ip);
+      (*src) = new (hosts_pool, std::nothrow) RemoteHost(this, src_mac, vlanId, _src_ip);
       PROFILING_SECTION_EXIT(5);
     }
 
@@ -2825,6 +2832,9 @@ void NetworkInterface::findFlowHosts(u_int16_t vlanId,
       }
 
       has_too_many_hosts = false;
+
+      if((*src)->isLocalHost())
+	((LocalHost*)(*src))->hydrate();
     }
   }
 
@@ -2845,11 +2855,11 @@ void NetworkInterface::findFlowHosts(u_int16_t vlanId,
        && (_dst_ip->isLocalHost(&local_network_id)
 	   || _dst_ip->isLocalInterfaceAddress())) {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new LocalHost", 4);
-      (*dst) = new (std::nothrow) LocalHost(this, dst_mac, vlanId, _dst_ip);
+      (*dst) = new (hosts_pool, std::nothrow) LocalHost(this, dst_mac, vlanId, _dst_ip);
       PROFILING_SECTION_EXIT(4);
     } else {
       PROFILING_SECTION_ENTER("NetworkInterface::findFlowHosts: new RemoteHost", 5);
-      (*dst) = new (std::nothrow) RemoteHost(this, dst_mac, vlanId, _dst_ip);
+      (*dst) = new (hosts_pool, std::nothrow) RemoteHost(this, dst_mac, vlanId, _dst_ip);
       PROFILING_SECTION_EXIT(5);
     }
 
@@ -2867,6 +2877,9 @@ void NetworkInterface::findFlowHosts(u_int16_t vlanId,
       }
 
       has_too_many_hosts = false;
+
+      if((*dst)->isLocalHost())
+	((LocalHost*)(*dst))->hydrate();
     }
   }
 }
@@ -2886,6 +2899,70 @@ bool NetworkInterface::viewEnqueue(time_t t, Flow *f) {
 
 /* **************************************************** */
 
+/*
+  Called by the thread owning the hosts of this interface with the flows
+  enqueued by its viewed interfaces (see viewEnqueue). Returns true when
+  the flow traffic since the previous call has been returned into partials.
+ */
+bool NetworkInterface::viewedFlowHostsUpdate(Flow *f, const struct timeval *tv, PartializableFlowTrafficStats *partials) {
+  NetworkStats *network_stats;
+  bool first_partial; /* Whether this is the first time this interface is visiting this flow */
+  const IpAddress *cli_ip = f->get_cli_ip_addr(), *srv_ip = f->get_srv_ip_addr();
+  Host *cli_host = NULL, *srv_host = NULL;
+
+  /* NOTE: partials are calculated as a delta between the current and the past traffic.
+   * When the hash tables are full and hosts cannot be allocated during the
+   * first iteration of this method on the flow (when first_partial is true),
+   * such stats on the hosts will be lost.
+   */
+  if(!f->get_partial_traffic_stats_view(partials, &first_partial))
+    return(false);
+
+  if(!cli_ip || !srv_ip) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to get flow hosts. Out of memory? Expect issues.");
+    return(false);
+  }
+
+  /* Important: findFlowHosts can allocate new hosts. The first_partial condition
+   * is used to call `incNumFlows` and `incUses` on the hosts below, so it is essential that
+   * findFlowHosts is called only when first_partial is true. */
+  if(first_partial)
+    findFlowHosts(f->get_vlan_id(),
+		  NULL /* no src mac yet */, (IpAddress*)cli_ip, &cli_host,
+		  NULL /* no dst mac yet */, (IpAddress*)srv_ip, &srv_host);
+  else {
+    /* The unsafe pointers can be used here as this method is called synchronously
+     * with the purgeIdle of this interface. This also saves some
+     * unnecessary hash table lookup time. */
+    cli_host = f->unsafeGetClient();
+    srv_host = f->unsafeGetServer();
+  }
+
+  f->hosts_periodic_stats_update(this, cli_host, srv_host, partials, first_partial, tv);
+
+  if(cli_host) {
+    if(first_partial) {
+      cli_host->incNumFlows(f->get_last_seen(), true), cli_host->incUses();
+      network_stats = cli_host->getNetworkStats(cli_host->get_local_network_id());
+      if(network_stats) network_stats->incNumFlows(f->get_last_seen(), true);
+      if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setClientHost(cli_host);
+    }
+  }
+
+  if(srv_host) {
+    if(first_partial) {
+      srv_host->incUses(), srv_host->incNumFlows(f->get_last_seen(), false);
+      network_stats = srv_host->getNetworkStats(srv_host->get_local_network_id());
+      if(network_stats) network_stats->incNumFlows(f->get_last_seen(), false);
+      if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setServerHost(srv_host);
+    }
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
 bool NetworkInterface::checkPeriodicStatsUpdateTime(const struct timeval *tv) {
   float diff = Utils::msTimevalDiff(tv, &last_periodic_stats_update) / 1000;
 
@@ -3565,6 +3642,16 @@ struct flowHostRetriever {
   u_int32_t maxNumEntries, actNumEntries;
   struct flowHostRetrieveList *elems;
 
+  /*
+    Bounded selection: when topK is set, elems is a buffer of maxNumEntries (> topK) elements
+    that is pruned to the topK elements coming first in the requested order whenever full.
+    Pruned elements are released with releaseElem (if set) and counted in numPruned.
+   */
+  u_int32_t topK, numPruned;
+  bool a2zSortOrder;
+  int (*sortFunc)(const void *_a, const void *_b);
+  void (*releaseElem)(struct flowHostRetriever *r, struct flowHostRetrieveList *e);
+
   /* Used by getActiveFlowsStats */
   nDPIStats *ndpi_stats;
   FlowStats *stats;
@@ -3575,6 +3662,104 @@ struct flowHostRetriever {
 
 /* **************************************************** */
 
+/* Adapts the qsort() sorters below to std::nth_element() */
+struct retrieverElemLess {
+  int (*sortFunc)(const void *_a, const void *_b);
+  bool a2zSortOrder;
+
+  bool operator()(const struct flowHostRetrieveList &a, const struct flowHostRetrieveList &b) const {
+    int rc = sortFunc(&a, &b);
+
+    /* Elements to be returned first are moved to the head of the buffer */
+    return(a2zSortOrder ? (rc < 0) : (rc > 0));
+  }
+};
+
+/* **************************************************** */
+
+/*
+  Keeps the retriever->topK elements that come first in the requested order, releasing
+  the others. Runs in linear time, so a full hash walk costs O(n) instead of O(n log n)
+  and only needs a buffer proportional to the page being returned.
+ */
+static void retriever_prune(struct flowHostRetriever *r) {
+  struct flowHostRetrieveList *nth, *last;
+  retrieverElemLess less;
+
+  if((r->topK == 0) || (r->actNumEntries <= r->topK))
+    return;
+
+  less.sortFunc = r->sortFunc, less.a2zSortOrder = r->a2zSortOrder;
+  nth = &r->elems[r->topK], last = &r->elems[r->actNumEntries];
+
+  std::nth_element(r->elems, nth, last, less);
+
+  for(struct flowHostRetrieveList *e = nth; e < last; e++) {
+    if(r->releaseElem) r->releaseElem(r, e);
+    memset(e, 0, sizeof(*e));
+  }
+
+  r->numPruned += r->actNumEntries - r->topK;
+  r->actNumEntries = r->topK;
+}
+
+/* **************************************************** */
+
+/* Returns false when no further element can be added to the retriever */
+static bool retriever_has_room(struct flowHostRetriever *r) {
+  if(r->actNumEntries < r->maxNumEntries)
+    return(true);
+
+  retriever_prune(r);
+
+  return(r->actNumEntries < r->maxNumEntries);
+}
+
+/* **************************************************** */
+
+/*
+  Sorts the retrieved elements. When a bounded selection is in use, only the topK
+  elements are sorted, in ascending order as done by qsort() for the full list, so that
+  callers can keep on reading descending results from the tail of elems.
+ */
+static void retriever_sort(struct flowHostRetriever *r) {
+  retriever_prune(r);
+
+  qsort(r->elems, r->actNumEntries, sizeof(struct flowHostRetrieveList), r->sortFunc);
+}
+
+/* **************************************************** */
+
+/*
+  Sets up a bounded selection of the first max_sorted_entries elements (0 = all) when
+  it is worth it, that is, when the page is small with respect to the hash size.
+ */
+static void retriever_set_top_k(struct flowHostRetriever *r, u_int32_t max_sorted_entries, bool a2zSortOrder) {
+  r->topK = 0, r->numPruned = 0, r->a2zSortOrder = a2zSortOrder;
+
+  if((max_sorted_entries > 0)
+     && (((u_int64_t)max_sorted_entries) * RETRIEVER_TOP_K_BUFFER_FACTOR < r->maxNumEntries)) {
+    r->topK = max_sorted_entries;
+    r->maxNumEntries = max_sorted_entries * RETRIEVER_TOP_K_BUFFER_FACTOR;
+  }
+}
+
+/* **************************************************** */
+
+/* Releases the references taken by host_search_walker on a pruned element */
+static void host_retriever_release(struct flowHostRetriever *r, struct flowHostRetrieveList *e) {
+  if(e->hostValue)
+    e->hostValue->decUses(); /* See (***) */
+
+  if((r->sorter == column_name) || (r->sorter == column_country)) {
+    if(e->stringValue) free((char*)e->stringValue);
+  } else if(r->sorter == column_local_network) {
+    if(e->ipValue) delete e->ipValue;
+  }
+}
+
+/* **************************************************** */
+
 static bool flow_matches(Flow *f, struct flowHostRetriever *retriever) {
   int ndpi_proto, ndpi_cat;
   u_int16_t port;
@@ -3845,7 +4030,7 @@ static bool flow_search_walker(GenericHashEntry *h, void *user_data, bool *match
   const char *flow_info;
   const TcpInfo *tcp_info;
 
-  if(retriever->actNumEntries >= retriever->maxNumEntries)
+  if(!retriever_has_room(retriever))
     return(true); /* Limit reached - stop iterating */
 
   if(flow_matches(f, retriever)) {
@@ -3921,7 +4106,7 @@ static bool host_search_walker(GenericHashEntry *he, void *user_data, bool *matc
   struct flowHostRetriever *r = (struct flowHostRetriever*)user_data;
   Host *h = (Host*)he;
 
-  if(r->actNumEntries >= r->maxNumEntries)
+  if(!retriever_has_room(r))
     return(true); /* Limit reached */
 
   if(!h || h->idle() || !h->match(r->allowed_hosts))
@@ -4320,7 +4505,8 @@ int NetworkInterface::sortFlows(u_int32_t *begin_slot,
 				AddressTree *allowed_hosts,
 				Host *host,
 				Paginator *p,
-				const char *sortColumn) {
+				const char *sortColumn,
+				u_int32_t max_sorted_entries) {
   int (*sorter)(const void *_a, const void *_b);
 
   if(retriever == NULL)
@@ -4330,6 +4516,8 @@ int NetworkInterface::sortFlows(u_int32_t *begin_slot,
   retriever->host = host, retriever->location = location_all;
   retriever->ndpi_proto = -1;
   retriever->actNumEntries = 0, retriever->maxNumEntries = getFlowsHashSize(), retriever->allowed_hosts = allowed_hosts;
+  retriever->releaseElem = NULL;
+  retriever_set_top_k(retriever, max_sorted_entries, p ? p->a2zSortOrder() : true);
   retriever->elems = (struct flowHostRetrieveList*)calloc(sizeof(struct flowHostRetrieveList), retriever->maxNumEntries);
 
   if(retriever->elems == NULL) {
@@ -4337,9 +4525,9 @@ int NetworkInterface::sortFlows(u_int32_t *begin_slot,
     return(-1);
   }
 
-  if(!strcmp(sortColumn, "column_client")) retriever->sorter = column_client, sorter = (isViewed() || isView()) ? ipSorter : hostSorter;
+  if(!strcmp(sortColumn, "column_client")) retriever->sorter = column_client, sorter = (isViewed() || hasViewedFlows()) ? ipSorter : hostSorter;
   else if(!strcmp(sortColumn, "column_vlan")) retriever->sorter = column_vlan, sorter = numericSorter;
-  else if(!strcmp(sortColumn, "column_server")) retriever->sorter = column_server, sorter = (isViewed() || isView()) ? ipSorter : hostSorter;
+  else if(!strcmp(sortColumn, "column_server")) retriever->sorter = column_server, sorter = (isViewed() || hasViewedFlows()) ? ipSorter : hostSorter;
   else if(!strcmp(sortColumn, "column_proto_l4")) retriever->sorter = column_proto_l4, sorter = numericSorter;
   else if(!strcmp(sortColumn, "column_ndpi")) retriever->sorter = column_ndpi, sorter = numericSorter;
   else if(!strcmp(sortColumn, "column_duration")) retriever->sorter = column_duration, sorter = numericSorter;
@@ -4356,10 +4544,12 @@ int NetworkInterface::sortFlows(u_int32_t *begin_slot,
     retriever->sorter = column_bytes, sorter = numericSorter;
   }
 
+  retriever->sortFunc = sorter;
+
   // make sure the caller has disabled the purge!!
   walker(begin_slot, walk_all,  walker_flows, flow_search_walker, (void*)retriever);
 
-  qsort(retriever->elems, retriever->actNumEntries, sizeof(struct flowHostRetrieveList), sorter);
+  retriever_sort(retriever);
 
   return(retriever->actNumEntries);
 }
@@ -4429,12 +4619,14 @@ int NetworkInterface::getFlows(lua_State* vm,
   if(! p->getDetailsLevel(&highDetails))
     highDetails = p->detailedResults() ? details_high : (local_hosts || (p && p->maxHits() != CONST_MAX_NUM_HITS)) ? details_high : details_normal;
 
-  if(sortFlows(begin_slot, walk_all, &retriever, allowed_hosts, host, p, sortColumn) < 0) {
+  /* Only the flows of the requested page need to be sorted */
+  if(sortFlows(begin_slot, walk_all, &retriever, allowed_hosts, host, p, sortColumn,
+	       (u_int32_t)p->toSkip() + p->maxHits()) < 0) {
     return(-1);
   }
 
   lua_newtable(vm);
-  lua_push_uint64_table_entry(vm, "numFlows", retriever.actNumEntries);
+  lua_push_uint64_table_entry(vm, "numFlows", retriever.actNumEntries + retriever.numPruned);
   lua_push_uint64_table_entry(vm, "nextSlot", *begin_slot);
 
   lua_newtable(vm);
@@ -4471,7 +4663,7 @@ int NetworkInterface::getFlows(lua_State* vm,
 
   if(retriever.elems) free(retriever.elems);
 
-  return(retriever.actNumEntries);
+  return(retriever.actNumEntries + retriever.numPruned);
 }
 
 /* **************************************************** */
@@ -4490,7 +4682,7 @@ int NetworkInterface::getFlowsGroup(lua_State* vm,
     return(-1);
   }
 
-  if(sortFlows(&begin_slot, walk_all, &retriever, allowed_hosts, NULL, p, groupColumn) < 0) {
+  if(sortFlows(&begin_slot, walk_all, &retriever, allowed_hosts, NULL, p, groupColumn, 0 /* All flows are grouped */) < 0) {
     return(-1);
   }
 
@@ -4576,7 +4768,9 @@ int NetworkInterface::sortHosts(u_int32_t *begin_slot,
 				const AddressTree * const cidr_filter,
 				u_int8_t ipver_filter, int proto_filter,
 				TrafficType traffic_type_filter,
-				char *sortColumn) {
+				char *sortColumn,
+				u_int32_t max_sorted_entries,
+				bool a2zSortOrder) {
   u_int8_t macAddr[6];
   int (*sorter)(const void *_a, const void *_b);
 
@@ -4607,6 +4801,8 @@ int NetworkInterface::sortHosts(u_int32_t *begin_slot,
     retriever->ndpi_proto = proto_filter,
     retriever->traffic_type = traffic_type_filter,
     retriever->maxNumEntries = getHostsHashSize();
+  retriever->releaseElem = host_retriever_release;
+  retriever_set_top_k(retriever, max_sorted_entries, a2zSortOrder);
   retriever->elems = (struct flowHostRetrieveList*)calloc(sizeof(struct flowHostRetrieveList), retriever->maxNumEntries);
 
   if(retriever->elems == NULL) {
@@ -4651,10 +4847,12 @@ int NetworkInterface::sortHosts(u_int32_t *begin_slot,
     retriever->sorter = column_traffic, sorter = numericSorter;
   }
 
+  retriever->sortFunc = sorter;
+
   // make sure the caller has disabled the purge!!
   walker(begin_slot, walk_all, walker_hosts, host_search_walker, (void*)retriever);
 
-  qsort(retriever->elems, retriever->actNumEntries, sizeof(struct flowHostRetrieveList), sorter);
+  retriever_sort(retriever);
 
   return(retriever->actNumEntries);
 }
@@ -4833,6 +5031,7 @@ int NetworkInterface::getActiveHostsList(lua_State* vm,
 					 char *sortColumn, u_int32_t maxHits,
 					 u_int32_t toSkip, bool a2zSortOrder) {
   struct flowHostRetriever retriever;
+  u_int64_t max_sorted_entries = (u_int64_t)toSkip + maxHits; /* Only the hosts of the requested page need to be sorted */
 
 #if DEBUG
   if(!walk_all)
@@ -4849,7 +5048,9 @@ int NetworkInterface::getActiveHostsList(lua_State* vm,
 	       cidr_filter,
 	       ipver_filter, proto_filter,
 	       traffic_type_filter,
-	       sortColumn) < 0) {
+	       sortColumn,
+	       (max_sorted_entries < (u_int32_t)-1) ? (u_int32_t)max_sorted_entries : 0,
+	       a2zSortOrder) < 0) {
     return(-1);
   }
 
@@ -4860,7 +5061,7 @@ int NetworkInterface::getActiveHostsList(lua_State* vm,
 #endif
 
   lua_newtable(vm);
-  lua_push_uint64_table_entry(vm, "numHosts", retriever.actNumEntries);
+  lua_push_uint64_table_entry(vm, "numHosts", retriever.actNumEntries + retriever.numPruned);
   lua_push_uint64_table_entry(vm, "nextSlot", *begin_slot);
 
   lua_newtable(vm);
@@ -4914,7 +5115,7 @@ int NetworkInterface::getActiveHostsList(lua_State* vm,
   // finally free the elements regardless of the sorted kind
   if(retriever.elems) free(retriever.elems);
 
-  return(retriever.actNumEntries);
+  return(retriever.actNumEntries + retriever.numPruned);
 }
 
 /* **************************************************** */
@@ -5003,7 +5204,7 @@ int NetworkInterface::getActiveHostsGroup(lua_State* vm,
 	       NULL, /* no cidr filter */
 	       ipver_filter, -1 /* no protocol filter */,
 	       traffic_type_all /* no traffic type filter */,
-	       groupColumn) < 0 ) {
+	       groupColumn, 0 /* All hosts are grouped */, true) < 0 ) {
     return(-1);
   }
 
@@ -5565,19 +5766,46 @@ void NetworkInterface::lua(lua_State *vm) {
 
 /* *************************************** */
 
-void NetworkInterface::lua_hash_tables_stats(lua_State *vm) {
-  /* Hash tables stats */
-  GenericHash *gh[] = {
+u_int NetworkInterface::getHashTables(GenericHash **gh, u_int max_num) const {
+  GenericHash *all[] = {
     flows_hash, hosts_hash, macs_hash,
     vlans_hash, ases_hash, countries_hash
   };
+  u_int num = 0;
+
+  for(u_int i = 0; (i < sizeof(all) / sizeof(all[0])) && (num < max_num); i++) {
+    if(all[i])
+      gh[num++] = all[i];
+  }
+
+  return(num);
+}
+
+/* *************************************** */
+
+u_int NetworkInterface::getFlowQueues(const SPSCQueue<Flow *> **queues, u_int max_num) const {
+  u_int num = 0;
+
+  if(idleFlowsToDump   && (num < max_num)) queues[num++] = idleFlowsToDump;
+  if(activeFlowsToDump && (num < max_num)) queues[num++] = activeFlowsToDump;
+
+  for(u_int8_t i = 0; (i < num_hook_workers) && (num < max_num); i++)
+    num += hook_workers[i]->getQueues(&queues[num], max_num - num);
+
+  return(num);
+}
+
+/* *************************************** */
+
+void NetworkInterface::lua_hash_tables_stats(lua_State *vm, bool chain_lengths) {
+  /* Hash tables stats */
+  GenericHash *gh[8];
+  u_int num = getHashTables(gh, sizeof(gh) / sizeof(gh[0]));
 
   lua_newtable(vm);
 
-  for (u_int i = 0; i < sizeof(gh) / sizeof(gh[0]); i++) {
-    if(gh[i])
-      gh[i]->lua(vm);
-  }
+  for(u_int i = 0; i < num; i++)
+    gh[i]->lua(vm, chain_lengths);
 }
 
 /* *************************************** */
@@ -5594,9 +5822,20 @@ void NetworkInterface::lua_periodic_activities_stats(lua_State *vm) {
 void NetworkInterface::lua_queues_stats(lua_State *vm) {
   if(idleFlowsToDump)      idleFlowsToDump->lua(vm);
   if(activeFlowsToDump)    activeFlowsToDump->lua(vm);
-  if(hookProtocolDetected) hookProtocolDetected->lua(vm);
-  if(hookPeriodicUpdate)   hookPeriodicUpdate->lua(vm);
-  if(hookFlowEnd)          hookFlowEnd->lua(vm);
+
+  for(u_int8_t i = 0; i < num_hook_workers; i++)
+    hook_workers[i]->lua(vm);
+
+  if(host_hydrator) host_hydrator->lua(vm);
+  if(recorder)      recorder->lua(vm);
+}
+
+/* **************************************************** */
+
+void NetworkInterface::lua_flow_checks_stats(lua_State *vm) {
+  /* Checks run on every hook worker: stats are merged by check key */
+  for(u_int8_t i = 0; i < num_hook_workers; i++)
+    hook_workers[i]->luaFlowChecks(vm);
 }
 
 /* **************************************************** */
@@ -5637,7 +5876,7 @@ Mac* NetworkInterface::getMac(u_int8_t _mac[6], bool create_if_not_present, bool
       return(NULL);
 
     try {
-      if((ret = new Mac(this, _mac)) != NULL) {
+      if((ret = new (macs_pool) Mac(this, _mac)) != NULL) {
 	if(!macs_hash->add(ret,
 			   !isInlineCall /* Lock only if not inline, if inline there's no need to lock as also the purgeIdle is done inline*/)) {
           /* Note: this should never happen as we are checking hasEmptyRoom() */
@@ -6165,6 +6404,16 @@ void NetworkInterface::allocateStructures() {
 
       flows_hash     = new FlowHash(this, num_hashes, ntop->getPrefs()->get_max_num_flows());
 
+      /* Per-interface slabs for the flows and their fixed-size members */
+      flows_pool        = new MemoryPool("flows", sizeof(Flow), MEMORY_POOL_SLAB_LEN);
+      ip_addresses_pool = new MemoryPool("flow_ip_addresses", sizeof(IpAddress), 4 * MEMORY_POOL_SLAB_LEN);
+      icmp_info_pool    = new MemoryPool("flow_icmp_info", sizeof(ICMPinfo), MEMORY_POOL_SLAB_LEN);
+      interarrival_pool = new MemoryPool("flow_interarrival_stats", sizeof(InterarrivalStats), 4 * MEMORY_POOL_SLAB_LEN);
+      flows_hash->addMemoryPool(flows_pool);
+      flows_hash->addMemoryPool(ip_addresses_pool);
+      flows_hash->addMemoryPool(icmp_info_pool);
+      flows_hash->addMemoryPool(interarrival_pool);
+
       if(!flowsOnlyInterface() /* Do not allocate HTs when the interface should only have flows */
 	 && !isViewed() /* Do not allocate HTs when the interface is viewed, HTs are allocated in the corresponding ViewInterface */)
 	{
@@ -6175,6 +6424,11 @@ void NetworkInterface::allocateStructures() {
 	  countries_hash = new CountriesHash(this, ndpi_min(num_hashes, 1024), 32768);
 	  vlans_hash     = new VlanHash(this, 1024, 2048);
 	  macs_hash      = new MacHash(this, ndpi_min(num_hashes, 8192), 32768);
+
+	  hosts_pool     = new MemoryPool("hosts", max_val(sizeof(LocalHost), sizeof(RemoteHost)), MEMORY_POOL_SLAB_LEN);
+	  macs_pool      = new MemoryPool("macs", sizeof(Mac), MEMORY_POOL_SLAB_LEN);
+	  hosts_hash->addMemoryPool(hosts_pool);
+	  macs_hash->addMemoryPool(macs_pool);
       }
     }
 
@@ -6950,15 +7204,10 @@ bool NetworkInterface::initHookLoop() {
   if(isView()) /* Don't init the loop for view interfaces: the loop is run by every viewed interface independently */
     return true;
 
-  pthread_create(&hookLoop, NULL, ::hookLoop, (void*)this);
-  hookLoopCreated = true;
+  for(u_int8_t i = 0; i < num_hook_workers; i++)
+    hook_workers[i]->startHooks();
 
-#ifdef __linux__
-  char buf[16];
-    
-  snprintf(buf, sizeof(buf), "hooks ifid %u", get_id());
-  pthread_setname_np(hookLoop, buf);
-#endif
+  if(host_hydrator) host_hydrator->startHydration();
 
   return true;
 }
@@ -7078,82 +7327,119 @@ bool NetworkInterface::matchLiveCapture(struct ntopngLuaContext * const luactx,
 					const struct pcap_pkthdr * const h,
 					const u_char * const packet,
 					Flow * const f) {
-  if(!luactx->live_capture.matching_host /* No host filter set */
-     || (f && (luactx->live_capture.matching_host == f->get_cli_host()
-	       || luactx->live_capture.matching_host == f->get_srv_host()))) {
-    if(luactx->live_capture.bpfFilterSet) {
-      if(!bpf_filter(luactx->live_capture.fcode.bf_insns,
-		     (const u_char*)packet, h->caplen, h->caplen)) {
+  Host *matching_host = (Host*)luactx->live_capture.matching_host;
+
+  if(matching_host /* Host filter set */) {
+    if(f) {
+      if((matching_host != f->get_cli_host()) && (matching_host != f->get_srv_host()))
+	return(false);
+    } else {
+      /* No flow, e.g. packets delivered before being dissected (see PcapInterface::dispatchPacket) */
+      IpAddress src_ip, dst_ip;
+      u_int16_t src_port, dst_port;
+      u_int8_t l4_proto;
+
+      if(!DissectionWorker::packetTuple(get_datalink(), h, packet, &src_ip, &dst_ip, &src_port, &dst_port, &l4_proto)
+	 || (!matching_host->get_ip()->equal(&src_ip) && !matching_host->get_ip()->equal(&dst_ip)))
 	return(false);
-      }
     }
+  }
 
-    return(true);
+  if(luactx->live_capture.bpfFilterSet) {
+    if(!bpf_filter(luactx->live_capture.fcode.bf_insns,
+		   (const u_char*)packet, h->caplen, h->caplen)) {
+      return(false);
+    }
   }
 
-  return false;
+  return(true);
 }
 
 /* *************************************** */
 
+/*
+  Called by the packet processing only when there are live captures. The lock
+  keeps the context of a capture (its ring and BPF code) from being released
+  by deregisterLiveCapture() or stopLiveCapture() while the packet is delivered.
+ */
 void NetworkInterface::deliverLiveCapture(const struct pcap_pkthdr * const h,
 					  const u_char * const packet, Flow * const f) {
-  int res;
+  active_captures_lock.lock(__FILE__, __LINE__);
 
   for(u_int i=0, num_found = 0; (i<MAX_NUM_PCAP_CAPTURES)
 	&& (num_found < num_live_captures); i++) {
     if(live_captures[i] != NULL) {
       struct ntopngLuaContext *c = (struct ntopngLuaContext *)live_captures[i];
-      bool http_client_disconnected = false;
 
       num_found++;
 
-      if(c->live_capture.capture_until < h->ts.tv_sec || c->live_capture.stopped)
-	http_client_disconnected = true;
+      if(c->live_capture.stopped
+	 || (c->live_capture.ring == NULL)
+	 || ((c->live_capture.capture_max_pkts != 0)
+	     && (c->live_capture.num_captured_packets >= c->live_capture.capture_max_pkts)))
+	continue; /* The HTTP thread terminates the capture */
 
-      /* The header is always sent even when there is never a match with matchLiveCapture,
-         as otherwise some browsers may end up in hangning. Hanging has been
-         verified with Safari Version 12.0 (13606.2.11)
-	 but not with Chrome Version 68.0.3440.106 (Official Build) (64-bit) */
-      if(!http_client_disconnected
-	 && c->conn
-	 && !c->live_capture.pcaphdr_sent) {
-	struct pcap_file_header pcaphdr;
+      /*
+	Packets are only copied here: they are sent by the HTTP thread serving the
+	capture (see sendLiveCapture), so that a slow client does not slow down the capture
+      */
+      if(matchLiveCapture(c, h, packet, f)
+	 && c->live_capture.ring->enqueue(h, packet))
+	c->live_capture.num_captured_packets++;
+    }
+  }
 
-	Utils::init_pcap_header(&pcaphdr, this);
+  active_captures_lock.unlock(__FILE__, __LINE__);
+}
 
-	if((res = mg_write_async(c->conn, &pcaphdr, sizeof(pcaphdr))) < (int)sizeof(pcaphdr))
-	  http_client_disconnected = true;
+/* *************************************** */
 
-	c->live_capture.pcaphdr_sent = true;
-      }
+/*
+  Sends the packets of a live capture to the HTTP client, until the capture
+  is stopped, expires or the client disconnects. Called by the HTTP thread
+  serving the capture, after registerLiveCapture().
+ */
+void NetworkInterface::sendLiveCapture(struct ntopngLuaContext * const luactx) {
+  PcapRing *ring = luactx->live_capture.ring;
+  struct pcap_file_header pcaphdr;
+  bool completed = false;
 
-      if(!http_client_disconnected
-	 && c->conn
-	 && matchLiveCapture(c, h, packet, f)) {
-	struct pcap_disk_pkthdr pkthdr; /* Cannot use h as the format on disk differs */
-
-	pkthdr.ts.tv_sec = h->ts.tv_sec, pkthdr.ts.tv_usec = h->ts.tv_usec,
-	  pkthdr.caplen = h->caplen, pkthdr.len = h->len;
-
-	if(
-	   ((res = mg_write_async(c->conn, &pkthdr, sizeof(pkthdr))) < (int)sizeof(pkthdr))
-	   || ((res = mg_write_async(c->conn, packet, h->caplen)) < (int)h->caplen)
-	   )
-	  http_client_disconnected = true;
-	else {
-	  c->live_capture.num_captured_packets++;
-
-	  if((c->live_capture.capture_max_pkts != 0)
-	     && (c->live_capture.num_captured_packets == c->live_capture.capture_max_pkts))
-	    http_client_disconnected = true;
-	}
-      }
+  /* The header is always sent even when there is never a match with matchLiveCapture,
+     as otherwise some browsers may end up in hangning. Hanging has been
+     verified with Safari Version 12.0 (13606.2.11)
+     but not with Chrome Version 68.0.3440.106 (Official Build) (64-bit) */
+  Utils::init_pcap_header(&pcaphdr, this);
 
-      if(http_client_disconnected)
-	deregisterLiveCapture(c); /* (*) */
-    }
+  luactx->live_capture.pcaphdr_sent = true;
+
+  if(mg_write(luactx->conn, &pcaphdr, sizeof(pcaphdr)) < (int)sizeof(pcaphdr))
+    luactx->live_capture.stopped = true;
+
+  while(!luactx->live_capture.stopped) {
+    int rc;
+
+    /* Checked before sending, so that the packets buffered so far are sent as well */
+    if((luactx->live_capture.capture_until < (u_int32_t)time(NULL))
+       || ((luactx->live_capture.capture_max_pkts != 0)
+	   && (luactx->live_capture.num_captured_packets >= luactx->live_capture.capture_max_pkts))
+       || ntop->getGlobals()->isShutdown())
+      completed = true;
+
+    if((rc = ring->send(luactx->conn)) < 0)
+      break; /* Client disconnected */
+
+    if(completed)
+      break;
+
+    if(rc == 0)
+      _usleep(CONST_LIVE_CAPTURE_SEND_USEC);
   }
+
+  deregisterLiveCapture(luactx);
+
+  if(ring->get_num_dropped() > 0)
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Live capture on %s: %llu packets dropped (slow client)",
+				 get_name(), (unsigned long long)ring->get_num_dropped());
 }
 
 /* *************************************** */
@@ -7177,6 +7463,8 @@ void NetworkInterface::dumpLiveCaptures(lua_State* vm) {
 			       live_captures[i]->live_capture.capture_max_pkts);
       lua_push_uint64_table_entry(vm, "num_captured_packets",
 			       live_captures[i]->live_capture.num_captured_packets);
+      lua_push_uint64_table_entry(vm, "num_dropped_packets",
+			       live_captures[i]->live_capture.ring ? live_captures[i]->live_capture.ring->get_num_dropped() : 0);
 
       if(live_captures[i]->live_capture.matching_host != NULL) {
 	Host *h = (Host*)live_captures[i]->live_capture.matching_host;
@@ -8020,6 +8308,8 @@ void NetworkInterface::checkHostsToRestore() {
 
     if(!hosts_hash->add(h, false /* Don't lock, we're inline with the purgeIdle */))
       delete h;
+    else if(h->isLocalHost())
+      ((LocalHost*)h)->hydrate();
 
 next_host:
     /* Always free the string retrieved from the queue */
@@ -54,6 +54,7 @@ extern struct keyval string_to_replace[]; /* Lua.cpp */
 
 Ntop::Ntop(char *appName) {
   ntop = this;
+  Utils::initHashSeed();
   globals = new NtopGlobals();
   extract = new TimelineExtract();
   pa      = new PeriodicActivities();
@@ -251,6 +252,14 @@ Ntop::~Ntop() {
   if(purgeLoop_started)
     pthread_join(purgeLoop, NULL);
 
+  /* Viewed interfaces first, as their flows reference the hosts of the interface viewing them */
+  for(int i = 0; i < num_defined_interfaces; i++) {
+    if(iface[i] && iface[i]->isViewed()) {
+      delete iface[i];
+      iface[i] = NULL;
+    }
+  }
+
   for(int i = 0; i < num_defined_interfaces; i++) {
     if(iface[i]) {
       delete iface[i];
@@ -479,8 +488,11 @@ void Ntop::start() {
 
   system_interface->allocateStructures();
 
-  for(int i=0; i<num_defined_interfaces; i++)
+  for(int i=0; i<num_defined_interfaces; i++) {
     iface[i]->allocateStructures();
+    /* Warm restart: reload the tables before the packet processing starts */
+    iface[i]->restoreTablesSnapshot();
+  }
 
 #ifdef __linux__
   inotify_fd = inotify_init();
@@ -604,6 +616,7 @@ void Ntop::start() {
 
             ntop->getTrace()->traceEvent(TRACE_DEBUG, "Directory changed");
             reloadPeriodicScripts();
+            if(httpd) httpd->reloadLuaEngines();
           }
         }
       }
@@ -988,12 +1001,26 @@ bool Ntop::recipient_enqueue(u_int16_t recipient_id, RecipientNotificationPriori
 
 /* ******************************************* */
 
-char* Ntop::recipient_dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio) {
+u_int32_t Ntop::recipients_enqueue(const u_int16_t *recipient_ids, u_int32_t num_recipients,
+				  RecipientNotificationPriority prio, const char * const notification) {
+  return recipients.enqueue(recipient_ids, num_recipients, prio, notification);
+}
+
+/* ******************************************* */
+
+RecipientNotification* Ntop::recipient_dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio) {
   return recipients.dequeue(recipient_id, prio);
 }
 
 /* ******************************************* */
 
+u_int32_t Ntop::recipient_dequeue_bulk(u_int16_t recipient_id, RecipientNotificationPriority prio,
+				       RecipientNotification **notifications, u_int32_t max_notifications) {
+  return recipients.dequeueBulk(recipient_id, prio, notifications, max_notifications);
+}
+
+/* ******************************************* */
+
 void Ntop::recipient_stats(u_int16_t recipient_id, lua_State* vm) {
   recipients.lua(recipient_id, vm);
 }
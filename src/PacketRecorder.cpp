@@ -0,0 +1,586 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+PacketRecorderSegment::PacketRecorderSegment(u_int32_t _id) {
+  id = _id;
+  first_ts = last_ts = 0;
+  pcap_len = sizeof(struct pcap_file_header);
+  ring_end = 0;
+}
+
+/* **************************************************** */
+
+void PacketRecorderSegment::addPacket(u_int32_t sec, u_int32_t flow_hash, u_int32_t len) {
+  recorder_time_entry t;
+  recorder_flow_entry f;
+
+  try {
+    /* A time entry per second, pointing to the first packet of the second */
+    if(time_index.empty() || (sec > time_index.back().sec)) {
+      t.sec = sec, t.offset = (u_int32_t)pcap_len;
+      time_index.push_back(t);
+    }
+
+    f.flow_hash = flow_hash, f.offset = (u_int32_t)pcap_len;
+    flow_index.push_back(f);
+  } catch(std::bad_alloc& ba) {
+    /* The packet is recorded anyway, it can only be found by a sequential scan */
+  }
+
+  if(first_ts == 0) first_ts = sec;
+  if(sec > last_ts) last_ts = sec;
+  pcap_len += len;
+}
+
+/* **************************************************** */
+
+PacketRecorder::PacketRecorder(NetworkInterface *_iface, u_int64_t _max_bytes) {
+  char buf[64];
+
+  iface = _iface, max_bytes = _max_bytes;
+  writerLoopCreated = false, terminating = false;
+  cur_segment = NULL, next_segment_id = 1;
+  num_recorded = num_dropped = 0;
+  fd = -1, written_len = 0;
+  num_written_bytes = tot_write_usec = num_write_errors = 0;
+  catalog_bytes = 0;
+
+  snprintf(dir, sizeof(dir), "%s/%d/%s", ntop->getPrefs()->get_pcap_dir(), iface->get_id(), PACKET_RECORDER_DIR);
+  ntop->fixPath(dir);
+  Utils::mkdir_tree(dir);
+
+  snprintf(buf, sizeof(buf), "packetRecorder_%d", iface->get_id());
+  ring = new PcapRing(PACKET_RECORDER_RING_LEN);
+
+  try {
+    completed_segments = new SPSCQueue<PacketRecorderSegment*>(64, buf);
+  } catch(std::bad_alloc& ba) {
+    delete ring;
+    throw;
+  }
+
+  /* Segments of a previous run */
+  loadCatalog();
+  writing_segment_id = next_segment_id;
+}
+
+/* **************************************************** */
+
+PacketRecorder::~PacketRecorder() {
+  PacketRecorderSegment *s;
+
+  stopRecording();
+
+  if(fd != -1) close(fd);
+  if(cur_segment) delete cur_segment;
+
+  if(completed_segments) {
+    while((s = completed_segments->dequeue()) != NULL)
+      delete s;
+
+    delete completed_segments;
+  }
+
+  if(ring) delete ring;
+}
+
+/* **************************************************** */
+
+char* PacketRecorder::getSegmentPath(u_int32_t id, const char *suffix, char *buf, u_int buf_len) const {
+  snprintf(buf, buf_len, "%s/%u.%s", dir, id, suffix);
+  return(buf);
+}
+
+/* **************************************************** */
+
+void PacketRecorder::recordPacket(const struct pcap_pkthdr *h, const u_char *packet, u_int32_t flow_hash) {
+  u_int32_t len = sizeof(struct pcap_disk_pkthdr) + h->caplen;
+
+  if(cur_segment
+     && (cur_segment->pcap_len + len > PACKET_RECORDER_SEGMENT_LEN)
+     && (cur_segment->pcap_len > sizeof(struct pcap_file_header))) {
+    /* Segment complete: its end in the ring tells the writer where to rotate */
+    cur_segment->ring_end = ring->getHead();
+
+    if(completed_segments->enqueue(cur_segment, true))
+      cur_segment = NULL;
+    /* else the segment is extended until the writer catches up */
+  }
+
+  if(cur_segment == NULL) {
+    if((cur_segment = new (std::nothrow) PacketRecorderSegment(next_segment_id)) == NULL) {
+      num_dropped++;
+      return;
+    }
+
+    next_segment_id++;
+  }
+
+  if(!ring->enqueue(h, packet)) {
+    num_dropped++;
+    return;
+  }
+
+  cur_segment->addPacket(h->ts.tv_sec, flow_hash, len);
+  num_recorded++;
+}
+
+/* **************************************************** */
+
+bool PacketRecorder::openSegment() {
+  char path[MAX_PATH];
+  struct pcap_file_header pcaphdr;
+
+  getSegmentPath(writing_segment_id, "pcap", path, sizeof(path));
+
+  if((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to create %s: %s", path, strerror(errno));
+    return(false);
+  }
+
+  Utils::init_pcap_header(&pcaphdr, iface);
+
+  if(write(fd, &pcaphdr, sizeof(pcaphdr)) != sizeof(pcaphdr)) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to write %s: %s", path, strerror(errno));
+    close(fd);
+    fd = -1;
+    return(false);
+  }
+
+  catalog_lock.lock(__FILE__, __LINE__);
+  written_len = sizeof(pcaphdr);
+  catalog_lock.unlock(__FILE__, __LINE__);
+
+  return(true);
+}
+
+/* **************************************************** */
+
+static bool flow_entry_cmp(const recorder_flow_entry &a, const recorder_flow_entry &b) {
+  if(a.flow_hash != b.flow_hash)
+    return(a.flow_hash < b.flow_hash);
+
+  return(a.offset < b.offset);
+}
+
+/* **************************************************** */
+
+bool PacketRecorder::writeIndex(PacketRecorderSegment *s) {
+  char path[MAX_PATH], tmp_path[MAX_PATH + 4];
+  recorder_index_header hdr;
+  bool rc;
+  FILE *f;
+
+  /* Flow entries are looked up by binary search */
+  std::sort(s->flow_index.begin(), s->flow_index.end(), flow_entry_cmp);
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = PACKET_RECORDER_INDEX_MAGIC, hdr.version = PACKET_RECORDER_INDEX_VERSION;
+  hdr.first_ts = s->first_ts, hdr.last_ts = s->last_ts, hdr.pcap_len = s->pcap_len;
+  hdr.num_time_entries = s->time_index.size(), hdr.num_flow_entries = s->flow_index.size();
+
+  getSegmentPath(s->id, "idx", path, sizeof(path));
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  if((f = fopen(tmp_path, "wb")) == NULL) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to create %s: %s", tmp_path, strerror(errno));
+    return(false);
+  }
+
+  rc = (fwrite(&hdr, sizeof(hdr), 1, f) == 1)
+    && ((hdr.num_time_entries == 0)
+	|| (fwrite(&s->time_index[0], sizeof(recorder_time_entry), hdr.num_time_entries, f) == hdr.num_time_entries))
+    && ((hdr.num_flow_entries == 0)
+	|| (fwrite(&s->flow_index[0], sizeof(recorder_flow_entry), hdr.num_flow_entries, f) == hdr.num_flow_entries));
+
+  if(fclose(f) != 0) rc = false;
+
+  /* The index is renamed once complete, so that a crash leaves a pcap to be reindexed */
+  if(!rc || (rename(tmp_path, path) != 0)) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to write %s", path);
+    unlink(tmp_path);
+    return(false);
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
+void PacketRecorder::completeSegment(PacketRecorderSegment *s) {
+  recorder_segment_info info;
+
+  if(fd != -1) {
+    if(fdatasync(fd) != 0) num_write_errors++;
+#ifdef POSIX_FADV_DONTNEED
+    /* Recorded traffic is seldom read back: do not evict more useful pages */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(fd);
+    fd = -1;
+  }
+
+  writeIndex(s);
+
+  info.id = s->id, info.first_ts = s->first_ts, info.last_ts = s->last_ts, info.pcap_len = s->pcap_len;
+
+  catalog_lock.lock(__FILE__, __LINE__);
+
+  try {
+    catalog.push_back(info);
+    catalog_bytes += info.pcap_len;
+  } catch(std::bad_alloc& ba) {
+    /* The segment is found again at the next startup */
+  }
+
+  writing_segment_id = s->id + 1, written_len = 0;
+  catalog_lock.unlock(__FILE__, __LINE__);
+
+  delete s;
+
+  purgeOldSegments();
+}
+
+/* **************************************************** */
+
+void PacketRecorder::purgeOldSegments() {
+  char path[MAX_PATH];
+
+  catalog_lock.lock(__FILE__, __LINE__);
+
+  /* Keep at least the latest segment */
+  while((catalog_bytes > max_bytes) && (catalog.size() > 1)) {
+    recorder_segment_info oldest = catalog.front();
+
+    /* Extractions reading the segment keep it open until done */
+    unlink(getSegmentPath(oldest.id, "pcap", path, sizeof(path)));
+    unlink(getSegmentPath(oldest.id, "idx", path, sizeof(path)));
+
+    catalog.erase(catalog.begin());
+    catalog_bytes -= oldest.pcap_len;
+  }
+
+  catalog_lock.unlock(__FILE__, __LINE__);
+}
+
+/* **************************************************** */
+
+void PacketRecorder::writePackets() {
+  PacketRecorderSegment *s = NULL; /* Segment being written, once its end is known */
+  const u_int8_t *chunk1, *chunk2;
+  u_int32_t chunk1_len, chunk2_len, avail;
+  struct timeval begin, end;
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Started packet recorder on %s [%s][max %llu bytes]",
+			       iface->get_name(), dir, (unsigned long long)max_bytes);
+
+  while(true) {
+    /*
+      Peek before dequeuing: a segment completed after the peek ends past the
+      peeked bytes, whereas one completed before it is dequeued below. This way
+      the packets of the next segment are never written to the current one.
+    */
+    avail = ring->peek(&chunk1, &chunk1_len, &chunk2, &chunk2_len);
+
+    if(s == NULL)
+      s = completed_segments->dequeue();
+
+    /* Do not go past the end of the segment (positions wrap around), nor write too much at once */
+    if(s) {
+      int32_t segment_left = (int32_t)(s->ring_end - ring->getTail());
+      avail = (segment_left > 0) ? min_val(avail, (u_int32_t)segment_left) : 0;
+    }
+
+    avail = min_val(avail, PACKET_RECORDER_WRITE_LEN);
+
+    if(avail > 0) {
+      struct iovec iov[2];
+      int iovcnt = 1;
+      ssize_t rc;
+
+      iov[0].iov_base = (void*)chunk1, iov[0].iov_len = min_val(avail, chunk1_len);
+
+      if(avail > chunk1_len)
+	iov[1].iov_base = (void*)chunk2, iov[1].iov_len = avail - chunk1_len, iovcnt = 2;
+
+      if((fd == -1) && !openSegment()) {
+	/* Packets are lost, but the ring cannot be stalled */
+	num_write_errors++;
+      } else {
+	gettimeofday(&begin, NULL);
+	rc = pwritev(fd, iov, iovcnt, written_len);
+	gettimeofday(&end, NULL);
+
+	/* A short write leaves a hole: the record bounds of the segment are preserved */
+	if(rc != (ssize_t)avail)
+	  num_write_errors++;
+
+	tot_write_usec += Utils::usecTimevalDiff(&end, &begin);
+	num_written_bytes += avail;
+
+	catalog_lock.lock(__FILE__, __LINE__);
+	written_len += avail;
+	catalog_lock.unlock(__FILE__, __LINE__);
+      }
+
+      ring->consume(avail);
+    }
+
+    if(s && ((int32_t)(s->ring_end - ring->getTail()) <= 0)) {
+      completeSegment(s);
+      s = NULL;
+      continue;
+    }
+
+    if(avail == 0) {
+      if(terminating && ring->isEmpty() && (s == NULL))
+	break;
+
+      _usleep(PACKET_RECORDER_WRITER_USEC);
+    }
+  }
+
+  if(fd != -1) {
+    close(fd);
+    fd = -1;
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Packet recorder completed for %s", iface->get_name());
+}
+
+/* **************************************************** */
+
+static void* writerLoopFctn(void* ptr) {
+  PacketRecorder *r = (PacketRecorder*)ptr;
+
+  r->writePackets();
+  return(NULL);
+}
+
+/* **************************************************** */
+
+void PacketRecorder::startRecording() {
+  if(writerLoopCreated)
+    return;
+
+  pthread_create(&writerLoop, NULL, writerLoopFctn, (void*)this);
+  writerLoopCreated = true;
+
+#ifdef __linux__
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "recorder ifid %u", iface->get_id());
+  pthread_setname_np(writerLoop, buf);
+#endif
+}
+
+/* **************************************************** */
+
+void PacketRecorder::stopRecording() {
+  if(writerLoopCreated) {
+    void *res;
+
+    /* The segment in progress is completed with its index */
+    if(cur_segment && (cur_segment->pcap_len > sizeof(struct pcap_file_header))) {
+      cur_segment->ring_end = ring->getHead();
+
+      if(completed_segments->enqueue(cur_segment, true))
+	cur_segment = NULL;
+    }
+
+    terminating = true;
+    pthread_join(writerLoop, &res);
+    writerLoopCreated = false;
+  }
+}
+
+/* **************************************************** */
+
+bool PacketRecorder::readIndexHeader(u_int32_t id, recorder_segment_info *info) {
+  char path[MAX_PATH];
+  recorder_index_header hdr;
+  bool rc = false;
+  FILE *f;
+
+  if((f = fopen(getSegmentPath(id, "idx", path, sizeof(path)), "rb")) == NULL)
+    return(false);
+
+  if((fread(&hdr, sizeof(hdr), 1, f) == 1)
+     && (hdr.magic == PACKET_RECORDER_INDEX_MAGIC)
+     && (hdr.version == PACKET_RECORDER_INDEX_VERSION)) {
+    info->id = id, info->first_ts = hdr.first_ts, info->last_ts = hdr.last_ts, info->pcap_len = hdr.pcap_len;
+    rc = true;
+  }
+
+  fclose(f);
+  return(rc);
+}
+
+/* **************************************************** */
+
+/* Indexes a segment left without index (e.g. after a crash) */
+bool PacketRecorder::rebuildIndex(u_int32_t id) {
+  char path[MAX_PATH];
+  PacketRecorderSegment *s;
+  struct pcap_file_header pcaphdr;
+  struct pcap_disk_pkthdr pkthdr;
+  struct pcap_pkthdr h;
+  u_char *packet;
+  bool rc = false;
+  FILE *f;
+
+  if((f = fopen(getSegmentPath(id, "pcap", path, sizeof(path)), "rb")) == NULL)
+    return(false);
+
+  if(((s = new (std::nothrow) PacketRecorderSegment(id)) == NULL)
+     || ((packet = (u_char*)malloc(PACKET_RECORDER_MAX_CAPLEN)) == NULL)) {
+    if(s) delete s;
+    fclose(f);
+    return(false);
+  }
+
+  if(fread(&pcaphdr, sizeof(pcaphdr), 1, f) == 1) {
+    /* Records truncated by the crash are dropped */
+    while((fread(&pkthdr, sizeof(pkthdr), 1, f) == 1)
+	  && (pkthdr.caplen <= PACKET_RECORDER_MAX_CAPLEN)
+	  && (fread(packet, 1, pkthdr.caplen, f) == pkthdr.caplen)) {
+      h.ts.tv_sec = pkthdr.ts.tv_sec, h.ts.tv_usec = pkthdr.ts.tv_usec,
+	h.caplen = pkthdr.caplen, h.len = pkthdr.len;
+
+      s->addPacket(pkthdr.ts.tv_sec, DissectionWorker::packetHash(pcaphdr.linktype, &h, packet),
+		   sizeof(pkthdr) + pkthdr.caplen);
+    }
+
+    if((s->pcap_len > sizeof(pcaphdr)) && (truncate(path, s->pcap_len) == 0))
+      rc = writeIndex(s);
+  }
+
+  fclose(f);
+  free(packet);
+  delete s;
+
+  return(rc);
+}
+
+/* **************************************************** */
+
+static bool segment_info_cmp(const recorder_segment_info &a, const recorder_segment_info &b) {
+  return(a.id < b.id);
+}
+
+/* **************************************************** */
+
+void PacketRecorder::loadCatalog() {
+  vector<u_int32_t> ids;
+  struct dirent *entry;
+  DIR *d;
+
+  if((d = opendir(dir)) == NULL)
+    return;
+
+  while((entry = readdir(d)) != NULL) {
+    u_int32_t id;
+    char suffix[8];
+
+    if((sscanf(entry->d_name, "%u.%7s", &id, suffix) == 2) && !strcmp(suffix, "pcap"))
+      ids.push_back(id);
+  }
+
+  closedir(d);
+
+  for(vector<u_int32_t>::iterator it = ids.begin(); it != ids.end(); ++it) {
+    recorder_segment_info info;
+    char path[MAX_PATH];
+
+    if(!readIndexHeader(*it, &info)) {
+      ntop->getTrace()->traceEvent(TRACE_NORMAL, "Indexing recorded segment %s",
+				   getSegmentPath(*it, "pcap", path, sizeof(path)));
+
+      if(!rebuildIndex(*it) || !readIndexHeader(*it, &info)) {
+	unlink(getSegmentPath(*it, "pcap", path, sizeof(path)));
+	continue;
+      }
+    }
+
+    catalog.push_back(info);
+    catalog_bytes += info.pcap_len;
+
+    if(*it >= next_segment_id)
+      next_segment_id = *it + 1;
+  }
+
+  std::sort(catalog.begin(), catalog.end(), segment_info_cmp);
+  purgeOldSegments();
+
+  if(!catalog.empty())
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Loaded %u recorded segments of %s [%llu bytes]",
+				 (u_int32_t)catalog.size(), iface->get_name(), (unsigned long long)catalog_bytes);
+}
+
+/* **************************************************** */
+
+void PacketRecorder::getSegments(time_t from, time_t to, vector<recorder_segment_info> *segments,
+				 u_int32_t *open_segment_id, u_int64_t *open_segment_len) {
+  catalog_lock.lock(__FILE__, __LINE__);
+
+  for(vector<recorder_segment_info>::const_iterator it = catalog.begin(); it != catalog.end(); ++it) {
+    if((it->last_ts >= from) && (it->first_ts <= to))
+      segments->push_back(*it);
+  }
+
+  *open_segment_id = writing_segment_id;
+  *open_segment_len = written_len;
+
+  catalog_lock.unlock(__FILE__, __LINE__);
+}
+
+/* **************************************************** */
+
+void PacketRecorder::lua(lua_State *vm) {
+  u_int32_t num_segments;
+  u_int64_t store_bytes;
+
+  catalog_lock.lock(__FILE__, __LINE__);
+  num_segments = catalog.size(), store_bytes = catalog_bytes;
+  catalog_lock.unlock(__FILE__, __LINE__);
+
+  if(completed_segments) completed_segments->lua(vm);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "num_recorded", num_recorded);
+  lua_push_uint64_table_entry(vm, "num_dropped", num_dropped);
+  lua_push_uint64_table_entry(vm, "num_written_bytes", num_written_bytes);
+  lua_push_uint64_table_entry(vm, "num_write_errors", num_write_errors);
+  lua_push_float_table_entry(vm, "write_mbps",
+			     tot_write_usec ? ((float)num_written_bytes) / tot_write_usec : 0);
+  lua_push_uint64_table_entry(vm, "num_segments", num_segments);
+  lua_push_uint64_table_entry(vm, "store_bytes", store_bytes);
+  lua_push_uint64_table_entry(vm, "max_store_bytes", max_bytes);
+  lua_pushstring(vm, "packetRecorder");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
+
+/* **************************************************** */
@@ -0,0 +1,292 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+PacketRecorderReader::PacketRecorderReader(PacketRecorder *_recorder, time_t _from, time_t _to,
+					   const char *bpf_filter, const FlowTuple *_flow) {
+  recorder = _recorder, from = _from, to = _to;
+  flow_hash = 0, match_flow = (_flow != NULL);
+  if(match_flow) flow = *_flow, flow_hash = flow.hash();
+  datalink = recorder->getInterface()->get_datalink();
+  has_filter = false;
+  fd = -1, scanning = false;
+  offset = end_offset = 0, next_offset = 0;
+  buf = NULL, buf_offset = 0, buf_len = 0;
+  next_segment = 0;
+
+  if(bpf_filter && (bpf_filter[0] != '\0')) {
+    if(pcap_compile_nopcap(65535, datalink, &fcode, bpf_filter, 0, PCAP_NETMASK_UNKNOWN) == -1) {
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to compile extraction filter %s", bpf_filter);
+      return;
+    }
+
+    has_filter = true;
+  }
+
+  try {
+    recorder->getSegments(from, to, &segments, &open_segment_id, &open_segment_len);
+  } catch(std::bad_alloc& ba) {
+    return;
+  }
+
+  buf = (u_int8_t*)malloc(PACKET_RECORDER_READ_LEN);
+}
+
+/* **************************************************** */
+
+PacketRecorderReader::~PacketRecorderReader() {
+  closeSegment();
+
+  if(has_filter) pcap_freecode(&fcode);
+  if(buf) free(buf);
+}
+
+/* **************************************************** */
+
+void PacketRecorderReader::closeSegment() {
+  if(fd != -1) {
+    close(fd);
+    fd = -1;
+  }
+
+  offsets.clear();
+}
+
+/* **************************************************** */
+
+/* Sets the range of the segment to be read, and the packets of the flow */
+bool PacketRecorderReader::loadIndex(u_int32_t id) {
+  char path[MAX_PATH];
+  recorder_index_header hdr;
+  vector<recorder_time_entry> times;
+  recorder_flow_entry entries[1024];
+  u_int64_t flow_base;
+  u_int32_t lo, hi;
+  int idx_fd;
+  bool rc = false;
+
+  if((idx_fd = open(recorder->getSegmentPath(id, "idx", path, sizeof(path)), O_RDONLY)) == -1)
+    return(false);
+
+  if((pread(idx_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+     || (hdr.magic != PACKET_RECORDER_INDEX_MAGIC)
+     || (hdr.version != PACKET_RECORDER_INDEX_VERSION))
+    goto close_index;
+
+  try {
+    times.resize(hdr.num_time_entries);
+  } catch(std::bad_alloc& ba) {
+    goto close_index;
+  }
+
+  if((hdr.num_time_entries > 0)
+     && (pread(idx_fd, &times[0], hdr.num_time_entries * sizeof(recorder_time_entry), sizeof(hdr))
+	 != (ssize_t)(hdr.num_time_entries * sizeof(recorder_time_entry))))
+    goto close_index;
+
+  /* From the first packet of the first second in range, to the first packet past the range */
+  offset = end_offset = hdr.pcap_len;
+
+  for(vector<recorder_time_entry>::const_iterator it = times.begin(); it != times.end(); ++it) {
+    if((it->sec >= from) && (offset == hdr.pcap_len))
+      offset = it->offset;
+
+    if(it->sec > to) {
+      end_offset = it->offset;
+      break;
+    }
+  }
+
+  if(match_flow) {
+    /* Flow entries are sorted by hash and offset: look for the first entry of the flow */
+    flow_base = sizeof(hdr) + (u_int64_t)hdr.num_time_entries * sizeof(recorder_time_entry);
+    lo = 0, hi = hdr.num_flow_entries;
+
+    while(lo < hi) {
+      u_int32_t mid = lo + (hi - lo) / 2;
+
+      if(pread(idx_fd, entries, sizeof(entries[0]), flow_base + (u_int64_t)mid * sizeof(entries[0])) != sizeof(entries[0]))
+	goto close_index;
+
+      if(entries[0].flow_hash < flow_hash)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+    while(lo < hdr.num_flow_entries) {
+      u_int32_t num = min_val(hdr.num_flow_entries - lo, sizeof(entries) / sizeof(entries[0])), i;
+      ssize_t len = num * sizeof(entries[0]);
+
+      if(pread(idx_fd, entries, len, flow_base + (u_int64_t)lo * sizeof(entries[0])) != len)
+	goto close_index;
+
+      for(i = 0; (i < num) && (entries[i].flow_hash == flow_hash); i++) {
+	if((entries[i].offset >= offset) && (entries[i].offset < end_offset)) {
+	  try {
+	    offsets.push_back(entries[i].offset);
+	  } catch(std::bad_alloc& ba) {
+	    goto close_index;
+	  }
+	}
+      }
+
+      if(i < num) break;
+      lo += num;
+    }
+  }
+
+  rc = true;
+
+ close_index:
+  close(idx_fd);
+  return(rc);
+}
+
+/* **************************************************** */
+
+bool PacketRecorderReader::openNextSegment() {
+  char path[MAX_PATH];
+
+  while(next_segment <= segments.size()) {
+    bool open_segment = (next_segment == segments.size());
+    u_int32_t id = open_segment ? open_segment_id : segments[next_segment].id;
+
+    next_segment++;
+
+    if(open_segment) {
+      /* The open segment follows the latest one: skip it when the latter already ends after the range */
+      if((open_segment_len <= sizeof(struct pcap_file_header))
+	 || (!segments.empty() && (segments.back().id + 1 == open_segment_id) && (segments.back().last_ts > to)))
+	continue;
+    }
+
+    if((fd = open(recorder->getSegmentPath(id, "pcap", path, sizeof(path)), O_RDONLY)) == -1)
+      continue; /* Purged in the meantime */
+
+    buf_offset = buf_len = 0, next_offset = 0;
+
+    if(!open_segment && loadIndex(id))
+      scanning = false;
+    else {
+      /* Not indexed yet: only the bytes written so far are read */
+      offsets.clear();
+      scanning = true;
+      offset = sizeof(struct pcap_file_header);
+      end_offset = open_segment ? open_segment_len : segments[next_segment - 1].pcap_len;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    if(scanning || !match_flow)
+      posix_fadvise(fd, offset, end_offset - offset, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return(true);
+  }
+
+  return(false);
+}
+
+/* **************************************************** */
+
+/* Returns len bytes at pos, reading read_len bytes when not buffered */
+const u_int8_t* PacketRecorderReader::read(u_int64_t pos, u_int32_t len, u_int32_t read_len) {
+  ssize_t n;
+
+  if((pos >= buf_offset) && (pos + len <= buf_offset + buf_len))
+    return(&buf[pos - buf_offset]);
+
+  read_len = min_val(max_val(read_len, len), PACKET_RECORDER_READ_LEN);
+
+  if(((n = pread(fd, buf, read_len, pos)) < 0) || ((u_int32_t)n < len)) {
+    buf_len = 0;
+    return(NULL);
+  }
+
+  buf_offset = pos, buf_len = n;
+  return(buf);
+}
+
+/* **************************************************** */
+
+bool PacketRecorderReader::next(struct pcap_pkthdr *h, const u_char **packet) {
+  struct pcap_disk_pkthdr pkthdr;
+  const u_int8_t *data;
+  u_int32_t read_len;
+  u_int64_t pos;
+
+  if(buf == NULL)
+    return(false);
+
+  while(true) {
+    if((fd == -1) && !openNextSegment())
+      return(false);
+
+    if(match_flow && !scanning) {
+      if(next_offset >= offsets.size()) {
+	closeSegment();
+	continue;
+      }
+
+      pos = offsets[next_offset++], read_len = PACKET_RECORDER_FLOW_READ_LEN;
+    } else
+      pos = offset, read_len = PACKET_RECORDER_READ_LEN;
+
+    /* Records past the end, or not making sense, terminate the segment */
+    if((pos + sizeof(pkthdr) > end_offset)
+       || ((data = read(pos, sizeof(pkthdr), read_len)) == NULL)) {
+      closeSegment();
+      continue;
+    }
+
+    memcpy(&pkthdr, data, sizeof(pkthdr));
+
+    if((pkthdr.caplen > PACKET_RECORDER_MAX_CAPLEN)
+       || (pos + sizeof(pkthdr) + pkthdr.caplen > end_offset)
+       || ((data = read(pos + sizeof(pkthdr), pkthdr.caplen, read_len)) == NULL)) {
+      closeSegment();
+      continue;
+    }
+
+    offset = pos + sizeof(pkthdr) + pkthdr.caplen;
+
+    if((pkthdr.ts.tv_sec < from) || (pkthdr.ts.tv_sec > to))
+      continue;
+
+    h->ts.tv_sec = pkthdr.ts.tv_sec, h->ts.tv_usec = pkthdr.ts.tv_usec,
+      h->caplen = pkthdr.caplen, h->len = pkthdr.len;
+
+    /* Indexed packets only share the flow hash */
+    if(match_flow && !flow.match(datalink, h, data))
+      continue;
+
+    if(has_filter && !bpf_filter(fcode.bf_insns, (const u_char*)data, h->caplen, h->len))
+      continue;
+
+    *packet = data;
+    return(true);
+  }
+}
+
+/* **************************************************** */
@@ -120,6 +120,28 @@ void PacketStats::deserialize(json_object *o) {
 
 /* ******************************************* */
 
+void PacketStats::serializeBinary(BinarySerializer *s) const {
+  u_int64_t fields[] = { upTo64, upTo128, upTo256, upTo512, upTo1024, upTo1518,
+			 upTo2500, upTo6500, upTo9000, above9000,
+			 syn, synack, finack, rst };
+
+  for(u_int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    s->putVarint(fields[i]);
+}
+
+/* ******************************************* */
+
+void PacketStats::deserializeBinary(BinaryDeserializer *d) {
+  u_int64_t *fields[] = { &upTo64, &upTo128, &upTo256, &upTo512, &upTo1024, &upTo1518,
+			  &upTo2500, &upTo6500, &upTo9000, &above9000,
+			  &syn, &synack, &finack, &rst };
+
+  for(u_int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    *fields[i] = d->getVarint();
+}
+
+/* ******************************************* */
+
 json_object* PacketStats::getJSONObject() {
   json_object *my_object;
 
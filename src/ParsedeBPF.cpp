@@ -150,53 +150,54 @@ void ParsedeBPF::print() {
 
 /* *************************************** */
 
-void ParsedeBPF::getJSONObject(json_object *my_object, bool client) const {
+/* Fields of the flows dumped with Flow::flow2json(JSONStreamWriter*) */
+void ParsedeBPF::getJSON(JSONStreamWriter *w, bool client) const {
   const ProcessInfo * proc;
   const ContainerInfo * cont;
   const TcpInfo * tcp;
-  json_object *proc_object = json_object_new_object(),
-    *cont_object = json_object_new_object(),
-    *tcp_object = json_object_new_object();
-
-  if(proc_object && process_info_set && (proc = &process_info) && proc->pid > 0) {
-    json_object_object_add(proc_object, "PID", json_object_new_int64(proc->pid));
-    json_object_object_add(proc_object, "NAME", json_object_new_string(proc->process_name));
-    json_object_object_add(proc_object, "UID", json_object_new_int64(proc->uid));
-    json_object_object_add(proc_object, "GID", json_object_new_int64(proc->gid));
-    json_object_object_add(proc_object, "ACTUAL_MEMORY", json_object_new_int64(proc->actual_memory));
-    json_object_object_add(proc_object, "PEAK_MEMORY", json_object_new_int64(proc->peak_memory));
-    json_object_object_add(proc_object, "USER_NAME", json_object_new_string(proc->uid_name));
+
+  if(process_info_set && (proc = &process_info) && proc->pid > 0) {
+    w->openObject(client ? "CLIENT_PROCESS" : "SERVER_PROCESS");
+    w->addInt64("PID", proc->pid);
+    w->addString("NAME", proc->process_name);
+    w->addInt64("UID", proc->uid);
+    w->addInt64("GID", proc->gid);
+    w->addInt64("ACTUAL_MEMORY", proc->actual_memory);
+    w->addInt64("PEAK_MEMORY", proc->peak_memory);
+    w->addString("USER_NAME", proc->uid_name);
 
     if(proc->father_pid > 0) {
-      json_object_object_add(proc_object, "FATHER_PID", json_object_new_int64(proc->father_pid));
-      json_object_object_add(proc_object, "FATHER_NAME", json_object_new_string(proc->father_process_name));
-      json_object_object_add(proc_object, "FATHER_UID", json_object_new_int64(proc->father_uid));
-      json_object_object_add(proc_object, "FATHER_GID", json_object_new_int64(proc->father_gid));
-      json_object_object_add(proc_object, "FATHER_USER_NAME", json_object_new_string(proc->father_uid_name));
+      w->addInt64("FATHER_PID", proc->father_pid);
+      w->addString("FATHER_NAME", proc->father_process_name);
+      w->addInt64("FATHER_UID", proc->father_uid);
+      w->addInt64("FATHER_GID", proc->father_gid);
+      w->addString("FATHER_USER_NAME", proc->father_uid_name);
     }
 
-    json_object_object_add(my_object, client ? "CLIENT_PROCESS" : "SERVER_PROCESS", proc_object);
+    w->closeObject();
   }
 
-  if(cont_object && container_info_set && (cont = &container_info)) {
-    if(cont->id) json_object_object_add(cont_object, "ID", json_object_new_string(cont->id));
+  if(container_info_set && (cont = &container_info)) {
+    w->openObject(client ? "CLIENT_CONTAINER" : "SERVER_CONTAINER");
+
+    if(cont->id) w->addString("ID", cont->id);
 
     if(cont->data_type == container_info_data_type_k8s) {
-      if(cont->name)         json_object_object_add(cont_object, "K8S_NAME", json_object_new_string(cont->name));
-      if(cont->data.k8s.pod) json_object_object_add(cont_object, "K8S_POD", json_object_new_string(cont->data.k8s.pod));
-      if(cont->data.k8s.ns)  json_object_object_add(cont_object, "K8S_NS", json_object_new_string(cont->data.k8s.ns));
+      if(cont->name)         w->addString("K8S_NAME", cont->name);
+      if(cont->data.k8s.pod) w->addString("K8S_POD", cont->data.k8s.pod);
+      if(cont->data.k8s.ns)  w->addString("K8S_NS", cont->data.k8s.ns);
     } else if(cont->data_type == container_info_data_type_docker) {
-      if(cont->name) json_object_object_add(cont_object, "DOCKER_NAME", json_object_new_string(cont->name));
+      if(cont->name) w->addString("DOCKER_NAME", cont->name);
     }
 
-    json_object_object_add(my_object, client ? "CLIENT_CONTAINER" : "SERVER_CONTAINER", cont_object);
+    w->closeObject();
   }
 
-  if(tcp_object && tcp_info_set && (tcp = &tcp_info)) {
-    json_object_object_add(tcp_object, "RTT", json_object_new_double(tcp->rtt));
-    json_object_object_add(tcp_object, "RTT_VAR", json_object_new_double(tcp->rtt_var));
-
-    json_object_object_add(my_object, client ? "CLIENT_TCP_INFO" : "SERVER_TCP_INFO", tcp_object);
+  if(tcp_info_set && (tcp = &tcp_info)) {
+    w->openObject(client ? "CLIENT_TCP_INFO" : "SERVER_TCP_INFO");
+    w->addDouble("RTT", tcp->rtt);
+    w->addDouble("RTT_VAR", tcp->rtt_var);
+    w->closeObject();
   }
 }
 
@@ -154,7 +154,7 @@ void PartializableFlowTrafficStats::incStats(bool cli2srv_direction, u_int num_p
 
 /* *************************************** */
 
-void PartializableFlowTrafficStats::setStats(bool cli2srv_direction, u_int num_pkts, u_int pkt_len, u_int payload_len) {
+void PartializableFlowTrafficStats::setStats(bool cli2srv_direction, u_int num_pkts, u_int64_t pkt_len, u_int64_t payload_len) {
   if(cli2srv_direction)
     cli2srv_packets = num_pkts, cli2srv_bytes = pkt_len, cli2srv_goodput_bytes = payload_len;
   else
@@ -35,6 +35,9 @@ PcapInterface::PcapInterface(const char *name, u_int8_t ifIdx) : NetworkInterfac
 
   pcap_handle = NULL, pcap_list = NULL;
   memset(&last_pcap_stat, 0, sizeof(last_pcap_stat));
+  num_dissection_workers = 0;
+  memset(dissection_workers, 0, sizeof(dissection_workers));
+  memset(shard_flows, 0, sizeof(shard_flows));
   emulate_traffic_directions = false;
   read_pkts_from_pcap_dump = read_pkts_from_pcap_dump_done = false;
 
@@ -121,6 +124,15 @@ PcapInterface::PcapInterface(const char *name, u_int8_t ifIdx) : NetworkInterfac
 /* **************************************************** */
 
 PcapInterface::~PcapInterface() {
+  stopDissectionWorkers();
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    delete dissection_workers[i]; /* Shard interfaces are deleted with the other registered interfaces */
+
+  /* Shards are deleted before this interface (see Ntop::~Ntop), along with their queued flows */
+  for(u_int8_t i = 0; i < MAX_NUM_DISSECTION_THREADS; i++)
+    if(shard_flows[i]) delete shard_flows[i];
+
   if(pcap_handle) {
     pcap_close(pcap_handle);
     pcap_handle = NULL;
@@ -294,6 +306,12 @@ static void* packetPollLoop(void* ptr) {
 	  Host *srcHost = NULL, *dstHost = NULL;
 	  Flow *flow = NULL;
 
+	  if(iface->hasDissectionWorkers()) {
+	    /* Workers copy the whole captured frame: jumbo and offloaded frames are not cut to the MTU */
+	    iface->dispatchPacket(hdr, pkt);
+	    continue;
+	  }
+
 #ifdef WIN32
 	  /*
 	    For some unknown reason, on Windows winpcap
@@ -384,6 +402,10 @@ void PcapInterface::startPacketPolling() {
     purge_idle_flows_hosts = true;
   }
 
+  /* Viewed interfaces keep no hosts: they cannot merge the shard flows */
+  if(!read_pkts_from_pcap_dump && !isViewed() && (ntop->getPrefs()->get_num_dissection_threads() > 1))
+    startDissectionWorkers();
+
   pthread_create(&pollLoop, NULL, packetPollLoop, (void*)this);
   pollLoopCreated = true;
   NetworkInterface::startPacketPolling();
@@ -391,16 +413,452 @@ void PcapInterface::startPacketPolling() {
 
 /* **************************************************** */
 
+/*
+  Each dissection worker owns a shard, that is a sub-interface with private
+  flow hash tables that are only touched by the worker thread. Packets
+  are assigned to shards with a symmetric 5-tuple hash, so both directions of
+  a flow end up in the same shard. Interface counters are merged on read.
+
+  Hosts and MACs are not split across shards: shards are viewed by this
+  interface, as viewed interfaces are by a ViewInterface, so that hosts are
+  updated with the flow partials enqueued by the shards (see viewEnqueue),
+  whereas MACs are accounted by the capture thread (see countMacs).
+ */
+void PcapInterface::startDissectionWorkers() {
+  u_int8_t num_workers = ntop->getPrefs()->get_num_dissection_threads(), num_started = 0;
+
+  for(u_int8_t i = 0; i < num_workers; i++) {
+    NetworkInterface *shard;
+    char buf[MAX_INTERFACE_NAME_LEN];
+
+    snprintf(buf, sizeof(buf), "%s [Shard %u]", ifname, i);
+
+    if((shard = new (std::nothrow) NetworkInterface(buf, CONST_INTERFACE_TYPE_SHARD)) == NULL) {
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Failure allocating interface: not enough memory?");
+      break;
+    }
+
+    shard->set_datalink(get_datalink());
+    shard->setMTU(getMTU());
+
+    try {
+      shard_flows[i] = new SPSCQueue<Flow *>(MAX_VIEW_INTERFACE_QUEUE_LEN, "shard_flows");
+    } catch(std::bad_alloc& ba) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to allocate the flows queue for %s", buf);
+      delete shard;
+      break;
+    }
+
+    /* Must be set before allocating the shard structures: no host/MAC tables, no flow dump thread */
+    shard->setViewed(this, i);
+
+    /* NOTE: interface deleted by initSubInterface on failure */
+    if(!initSubInterface(shard)) {
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Failure registering dissection shard %s", buf);
+      break;
+    }
+
+    try {
+      dissection_workers[num_started] = new DissectionWorker(shard, DISSECTION_WORKER_QUEUE_LEN,
+							      ntop->getGlobals()->getSnaplen(ifname));
+    } catch(std::bad_alloc& ba) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to allocate the dissection queue for %s", buf);
+      break;
+    }
+
+    dissection_workers[num_started++]->startDissection();
+  }
+
+  if(num_started < 2) {
+    /* Not worth sharding: dissect packets on the capture thread */
+    for(u_int8_t i = 0; i < num_started; i++) {
+      delete dissection_workers[i]; /* Stops the worker */
+      dissection_workers[i] = NULL;
+    }
+  } else {
+    /* Publish the workers once all of them are running (read by the flow dump thread) */
+    __sync_synchronize();
+    num_dissection_workers = num_started;
+
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Dissecting packets of %s on %u threads",
+				 get_description(), num_dissection_workers);
+  }
+}
+
+/* **************************************************** */
+
+void PcapInterface::stopDissectionWorkers() {
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    dissection_workers[i]->stopDissection();
+}
+
+/* **************************************************** */
+
+void PcapInterface::shutdown() {
+  /* Stop the capture thread first so no more packets are dispatched to the workers */
+  NetworkInterface::shutdown();
+  stopDissectionWorkers();
+}
+
+/* **************************************************** */
+
+void PcapInterface::dispatchPacket(const struct pcap_pkthdr *h, const u_char *packet) {
+  u_int32_t hash = DissectionWorker::packetHash(get_datalink(), h, packet);
+
+  setTimeLastPktRcvd(h->ts.tv_sec);
+
+  if(recorder) recorder->recordPacket(h, packet, hash);
+
+  countMacs(h, packet);
+
+  /* Live captures are registered on this interface, not on the shards: deliver packets before dispatching them */
+  if(num_live_captures > 0)
+    deliverLiveCapture(h, packet, NULL);
+
+  /* Packets not fitting the worker ring are accounted as drops in getNumDroppedPackets */
+  dissection_workers[hash % num_dissection_workers]->enqueue(h, packet);
+
+  /* Merges the shard flows into the hosts, as done by dissectPacket for the hosts of its flows */
+  purgeIdle(h->ts.tv_sec);
+}
+
+/* **************************************************** */
+
+/*
+  Shards have no MAC table: MACs are accounted here, as in dissectPacket,
+  so that each MAC has a single entry whatever the shards of its flows.
+ */
+void PcapInterface::countMacs(const struct pcap_pkthdr *h, const u_char *packet) {
+  const struct ndpi_ethhdr *ethernet = (const struct ndpi_ethhdr*)packet;
+  u_int32_t len_on_wire = h->len * getScalingFactor(), offset = sizeof(struct ndpi_ethhdr);
+  u_int16_t eth_type;
+  Mac *srcMac, *dstMac;
+
+  if((get_datalink() != DLT_EN10MB)
+     || (h->caplen < sizeof(struct ndpi_ethhdr))
+     || ntop->getPrefs()->do_ignore_macs())
+    return;
+
+  if((srcMac = getMac((u_int8_t*)ethernet->h_source, true /* Create if missing */, true /* Inline call */))) {
+    srcMac->incSentStats(h->ts.tv_sec, 1, len_on_wire);
+    srcMac->setSeenIface(DUMMY_BRIDGE_INTERFACE_ID);
+  }
+
+  if((dstMac = getMac((u_int8_t*)ethernet->h_dest, true /* Create if missing */, true /* Inline call */)))
+    dstMac->incRcvdStats(h->ts.tv_sec, 1, len_on_wire);
+
+  /* Skip (possibly stacked) VLAN tags */
+  eth_type = ntohs(ethernet->h_proto);
+
+  while(((eth_type == 0x8100 /* 802.1Q */) || (eth_type == 0x88A8 /* 802.1ad */))
+	&& (h->caplen >= offset + 4)) {
+    eth_type = (packet[offset + 2] << 8) + packet[offset + 3];
+    offset += 4;
+  }
+
+  if((eth_type == ETHERTYPE_ARP)
+     && (h->caplen >= offset + sizeof(struct arp_header))
+     && srcMac && dstMac && (!srcMac->isNull() || !dstMac->isNull())) {
+    struct arp_header *arpp = (struct arp_header*)&packet[offset];
+    u_int16_t arp_opcode = ntohs(arpp->ar_op);
+
+    setSeenMacAddresses();
+    srcMac->setSourceMac();
+
+    if(arp_opcode == 0x1 /* ARP request */) {
+      arp_requests++;
+      srcMac->incSentArpRequests();
+      dstMac->incRcvdArpRequests();
+    } else if(arp_opcode == 0x2 /* ARP reply */) {
+      arp_replies++;
+      srcMac->incSentArpReplies();
+      dstMac->incRcvdArpReplies();
+
+      checkMacIPAssociation(true, arpp->arp_sha, arpp->arp_spa);
+      checkMacIPAssociation(true, arpp->arp_tha, arpp->arp_tpa);
+    }
+  }
+}
+
+/* **************************************************** */
+
+/* Called by the dissection worker of the shard, from the shard periodic flow updates */
+bool PcapInterface::viewEnqueue(time_t t, Flow *f, u_int8_t viewed_interface_id) {
+  if((viewed_interface_id >= MAX_NUM_DISSECTION_THREADS) || !shard_flows[viewed_interface_id])
+    return(false);
+
+  f->incUses(); /* Decreased once dequeued by dequeueShardFlows */
+
+  if(!shard_flows[viewed_interface_id]->enqueue(f, true)) {
+    f->decUses();
+    return(false);
+  }
+
+  return(true);
+}
+
+/* **************************************************** */
+
+/*
+  Updates the hosts of this interface with the flows enqueued by the shards.
+  Called by the capture thread, which is the only one adding and purging hosts.
+ */
+void PcapInterface::dequeueShardFlows() {
+  PartializableFlowTrafficStats partials;
+  struct timeval tv;
+
+  tv.tv_sec = 0;
+
+  for(u_int8_t s = 0; s < num_dissection_workers; s++) {
+    /* Limited budget so the capture thread is not stalled by a busy shard */
+    for(u_int n = 0; (n < DISSECTION_SHARD_FLOWS_BUDGET) && shard_flows[s]->isNotEmpty(); n++) {
+      Flow *f = shard_flows[s]->dequeue();
+
+      if(tv.tv_sec == 0) gettimeofday(&tv, NULL);
+
+      /* Interface counters are summed from the shards (see sumStats): only hosts are updated */
+      viewedFlowHostsUpdate(f, &tv, &partials);
+
+      f->decUses(); /* Decrease uses now that the job is done */
+    }
+  }
+}
+
+/* **************************************************** */
+
+void PcapInterface::purgeIdle(time_t when, bool force_idle) {
+  if(num_dissection_workers)
+    dequeueShardFlows();
+
+  NetworkInterface::purgeIdle(when, force_idle);
+}
+
+/* **************************************************** */
+
+/* With dissection workers, flows are dumped from the shard queues, as done by ViewInterface */
+void PcapInterface::dumpFlowLoop() {
+  /* Wait until it starts up: workers are started along with the packet polling */
+  while(!isRunning()) _usleep(10000);
+
+  if(!num_dissection_workers) {
+    NetworkInterface::dumpFlowLoop();
+    return;
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL,
+			       "Started flow dump loop on interface %s [id: %u] for %u shards...",
+			       get_description(), get_id(), num_dissection_workers);
+
+  while(isRunning()) {
+    u_int64_t n = 0;
+
+    /* Limited budgets, so that a shard does not starve the others */
+    for(u_int8_t s = 0; s < num_dissection_workers; s++)
+      n += dissection_workers[s]->getShard()->dequeueFlowsForDump(128 /* Limited budget for idle flows */,
+								    32 /* Limited budged for active flows */);
+
+    if(n == 0)
+      _usleep(100);
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_NORMAL, "Flow dump thread completed for %s", get_name());
+}
+
+/* **************************************************** */
+
 u_int32_t PcapInterface::getNumDroppedPackets() {
+  u_int32_t tot = 0;
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    tot += dissection_workers[i]->get_num_failed_enqueues();
+
 #ifndef WIN32
   /* It seems this leads to crashes on Windows */
   struct pcap_stat pcapStat;
 
-  if(pcap_handle && (pcap_stats(pcap_handle, &pcapStat) >= 0)) {
-    return(pcapStat.ps_drop);
-  } else
+  if(pcap_handle && (pcap_stats(pcap_handle, &pcapStat) >= 0))
+    tot += pcapStat.ps_drop;
 #endif
-    return 0;
+
+  return(tot);
+}
+
+/* **************************************************** */
+
+u_int64_t PcapInterface::getNumPackets() {
+  u_int64_t tot = 0;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::getNumPackets());
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    tot += dissection_workers[i]->getShard()->getNumPackets();
+
+  return(tot);
+}
+
+/* **************************************************** */
+
+u_int64_t PcapInterface::getNumBytes() {
+  u_int64_t tot = 0;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::getNumBytes());
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    tot += dissection_workers[i]->getShard()->getNumBytes();
+
+  return(tot);
+}
+
+/* **************************************************** */
+
+u_int64_t PcapInterface::getNumNewFlows() {
+  u_int64_t tot = 0;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::getNumNewFlows());
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    tot += dissection_workers[i]->getShard()->getNumNewFlows();
+
+  return(tot);
+}
+
+/* **************************************************** */
+
+u_int PcapInterface::getNumFlows() {
+  u_int tot = 0;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::getNumFlows());
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    tot += dissection_workers[i]->getShard()->getNumFlows();
+
+  return(tot);
+}
+
+/* **************************************************** */
+
+u_int32_t PcapInterface::getNumDroppedFlowScriptsCalls() {
+  u_int32_t tot = 0;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::getNumDroppedFlowScriptsCalls());
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    tot += dissection_workers[i]->getShard()->getNumDroppedFlowScriptsCalls();
+
+  return(tot);
+}
+
+/* **************************************************** */
+
+u_int32_t PcapInterface::getFlowsHashSize() {
+  u_int32_t tot = 0;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::getFlowsHashSize());
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    tot += dissection_workers[i]->getShard()->getFlowsHashSize();
+
+  return(tot);
+}
+
+/* **************************************************** */
+
+void PcapInterface::sumStats(TcpFlowStats *_tcpFlowStats, EthStats *_ethStats,
+			     LocalTrafficStats *_localStats, nDPIStats *_ndpiStats,
+			     PacketStats *_pktStats, TcpPacketStats *_tcpPacketStats,
+			     ProtoStats *_discardedProbingStats, DSCPStats *_dscpStats,
+			     SyslogStats *_syslogStats) const {
+  if(!num_dissection_workers)
+    NetworkInterface::sumStats(_tcpFlowStats, _ethStats, _localStats, _ndpiStats, _pktStats, _tcpPacketStats, _discardedProbingStats, _dscpStats, _syslogStats);
+  else {
+    for(u_int8_t i = 0; i < num_dissection_workers; i++)
+      dissection_workers[i]->getShard()->sumStats(_tcpFlowStats, _ethStats, _localStats, _ndpiStats, _pktStats, _tcpPacketStats, _discardedProbingStats, _dscpStats, _syslogStats);
+  }
+}
+
+/* **************************************************** */
+
+bool PcapInterface::walker(u_int32_t *begin_slot,
+			   bool walk_all,
+			   WalkerType wtype,
+			   bool (*walker)(GenericHashEntry *h, void *user_data, bool *matched),
+			   void *user_data) {
+  bool ret = false;
+
+  if(num_dissection_workers && (wtype == walker_flows)) {
+    /* The shard to resume from is kept in the upper bits of the slot */
+    u_int8_t s = (*begin_slot) >> DISSECTION_SHARD_SLOT_BITS;
+    u_int32_t slot = (*begin_slot) & ((1 << DISSECTION_SHARD_SLOT_BITS) - 1);
+
+    if(s >= num_dissection_workers)
+      s = 0, slot = 0;
+
+    for(; s < num_dissection_workers; s++, slot = 0) {
+      ret = dissection_workers[s]->getShard()->walker(&slot, walk_all, wtype, walker, user_data);
+
+      if(ret /* Stopped by the walker */
+	 || (slot != 0) /* Enough flows returned (walk_all == false), resume from here */) {
+	*begin_slot = (s << DISSECTION_SHARD_SLOT_BITS) | slot;
+	return(ret);
+      }
+    }
+
+    *begin_slot = 0; /* Start over */
+  } else
+    ret = NetworkInterface::walker(begin_slot, walk_all, wtype, walker, user_data);
+
+  return(ret);
+}
+
+/* **************************************************** */
+
+Flow* PcapInterface::findFlowByKeyAndHashId(u_int32_t key, u_int hash_id, AddressTree *allowed_hosts) {
+  Flow *f = NULL;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::findFlowByKeyAndHashId(key, hash_id, allowed_hosts));
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++) {
+    if((f = dissection_workers[i]->getShard()->findFlowByKeyAndHashId(key, hash_id, allowed_hosts)))
+      break;
+  }
+
+  return(f);
+}
+
+/* **************************************************** */
+
+Flow* PcapInterface::findFlowByTuple(u_int16_t vlan_id,
+				     IpAddress *src_ip,  IpAddress *dst_ip,
+				     u_int16_t src_port, u_int16_t dst_port,
+				     u_int8_t l4_proto,
+				     AddressTree *allowed_hosts) const {
+  Flow *f = NULL;
+
+  if(!num_dissection_workers)
+    return(NetworkInterface::findFlowByTuple(vlan_id, src_ip, dst_ip, src_port, dst_port, l4_proto, allowed_hosts));
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++) {
+    if((f = dissection_workers[i]->getShard()->findFlowByTuple(vlan_id, src_ip, dst_ip, src_port, dst_port, l4_proto, allowed_hosts)))
+      break;
+  }
+
+  return(f);
+}
+
+/* **************************************************** */
+
+void PcapInterface::lua_queues_stats(lua_State* vm) {
+  NetworkInterface::lua_queues_stats(vm);
+
+  for(u_int8_t i = 0; i < num_dissection_workers; i++)
+    dissection_workers[i]->lua(vm);
 }
 
 /* **************************************************** */
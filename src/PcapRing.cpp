@@ -0,0 +1,117 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+PcapRing::PcapRing(u_int32_t _size) {
+  size = Utils::pow2(_size);
+  head = tail = 0;
+  num_enqueued = num_dropped = 0;
+
+  if((buf = (u_int8_t*)malloc(size)) == NULL)
+    throw std::bad_alloc();
+}
+
+/* **************************************************** */
+
+PcapRing::~PcapRing() {
+  if(buf) free(buf);
+}
+
+/* **************************************************** */
+
+/* Copies data at pos, wrapping around the end of the buffer */
+void PcapRing::copy(u_int32_t pos, const void *data, u_int32_t len) {
+  u_int32_t idx = pos & (size - 1), first = min_val(len, size - idx);
+
+  memcpy(&buf[idx], data, first);
+
+  if(first < len)
+    memcpy(buf, &((const u_int8_t*)data)[first], len - first);
+}
+
+/* **************************************************** */
+
+bool PcapRing::enqueue(const struct pcap_pkthdr *h, const u_char *packet) {
+  struct pcap_disk_pkthdr pkthdr; /* Cannot use h as the format on disk differs */
+  u_int32_t len = sizeof(pkthdr) + h->caplen;
+
+  if(size - (head - tail) < len) {
+    num_dropped++;
+    return(false); /* Ring full: the packet is accounted as dropped */
+  }
+
+  pkthdr.ts.tv_sec = h->ts.tv_sec, pkthdr.ts.tv_usec = h->ts.tv_usec,
+    pkthdr.caplen = h->caplen, pkthdr.len = h->len;
+
+  copy(head, &pkthdr, sizeof(pkthdr));
+  copy(head + sizeof(pkthdr), packet, h->caplen);
+
+  /* Make sure the packet copy is visible before publishing it */
+  __sync_synchronize();
+  head += len;
+  num_enqueued++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+u_int32_t PcapRing::peek(const u_int8_t **chunk1, u_int32_t *chunk1_len,
+			 const u_int8_t **chunk2, u_int32_t *chunk2_len) {
+  u_int32_t avail = head - tail, idx = tail & (size - 1);
+
+  /* Read the data only after having read head */
+  __sync_synchronize();
+
+  *chunk1 = &buf[idx], *chunk1_len = min_val(avail, size - idx);
+  *chunk2 = buf, *chunk2_len = avail - *chunk1_len;
+
+  return(avail);
+}
+
+/* **************************************************** */
+
+void PcapRing::consume(u_int32_t len) {
+  /* Release the space only once used */
+  __sync_synchronize();
+  tail += len;
+}
+
+/* **************************************************** */
+
+int PcapRing::send(struct mg_connection *conn) {
+  const u_int8_t *chunk1, *chunk2;
+  u_int32_t chunk1_len, chunk2_len, avail;
+
+  if((avail = peek(&chunk1, &chunk1_len, &chunk2, &chunk2_len)) == 0)
+    return(0);
+
+  if((mg_write(conn, chunk1, chunk1_len) < (int)chunk1_len)
+     || ((chunk2_len > 0) && (mg_write(conn, chunk2, chunk2_len) < (int)chunk2_len)))
+    return(-1);
+
+  consume(avail);
+
+  return(avail);
+}
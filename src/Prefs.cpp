@@ -26,9 +26,15 @@
 Prefs::Prefs(Ntop *_ntop) {
   num_deferred_interfaces_to_register = 0, cli = NULL;
   ntop = _ntop, pcap_file_purge_hosts_flows = false,
+    prefs_prefetched = false,
     ignore_vlans = false, simulate_vlans = false, ignore_macs = false;
   local_networks = strdup(CONST_DEFAULT_HOME_NET "," CONST_DEFAULT_LOCAL_NETS);
   num_simulated_ips = 0, enable_behaviour_analysis = false;
+  num_dissection_threads = 0;
+  num_flow_hook_threads = 1;
+  idle_timing_wheel = false;
+  dns_server = NULL;
+  packet_recorder_max_gb = 0;
   local_networks_set = false, shutdown_when_done = false;
   enable_users_login = true, disable_localhost_login = false;
   enable_dns_resolution = sniff_dns_responses = true, use_promiscuous_mode = true;
@@ -43,7 +49,8 @@ Prefs::Prefs(Ntop *_ntop) {
   reproduce_at_original_speed = false;
   enable_ip_reassignment_alerts = false;
   enable_top_talkers = false, enable_idle_local_hosts_cache = false;
-  enable_active_local_hosts_cache = false,
+  enable_active_local_hosts_cache = false, local_hosts_cache_json = false,
+    enable_tables_snapshot = false,
     enable_tiny_flows_export = true,
     enable_captive_portal = false, mac_based_captive_portal = false,
     enable_arp_matrix_generation = false,
@@ -127,6 +134,8 @@ Prefs::Prefs(Ntop *_ntop) {
 
   mysql_host = mysql_dbname = mysql_tablename = mysql_user = mysql_pw = NULL;
   mysql_port = CONST_DEFAULT_MYSQL_PORT;
+  mysql_batch_size = MYSQL_DEFAULT_BATCH_SIZE, num_mysql_writers = 1;
+  num_es_writers = ES_DEFAULT_NUM_WRITERS;
   ls_host = NULL;
   ls_port = NULL;
   ls_proto = NULL;
@@ -189,6 +198,7 @@ Prefs::~Prefs() {
   free(redis_host);
   if(redis_password)  free(redis_password);
   if(cli)             free(cli);
+  if(dns_server)      free(dns_server);
   if(mysql_host)      free(mysql_host);
   if(mysql_dbname)    free(mysql_dbname);
   if(mysql_tablename) free(mysql_tablename);
@@ -326,6 +336,16 @@ void usage() {
 	 "[--users-file|-u] <path>            | Users configuration file path\n"
 	 "                                    | Default: %s\n"
 	 "[--original-speed]                  | Reproduce (-i) the pcap file at original speed\n"
+	 "[--dissection-threads <num>]        | Dissect packets captured from each pcap interface\n"
+	 "                                    | on <num> threads, sharding flows by 5-tuple\n"
+	 "[--flow-hook-threads <num>]         | Run flow user script hooks of each interface\n"
+	 "                                    | on <num> threads (default: 1)\n"
+	 "[--idle-timing-wheel]               | Expire idle flows and hosts with a timing wheel\n"
+	 "                                    | instead of scanning the hash tables\n"
+	 "[--dns-server <ip[:port]>]          | Name server used to resolve numeric IPs\n"
+	 "                                    | (default: first nameserver of /etc/resolv.conf)\n"
+	 "[--packet-recorder <GB>]            | Record the packets captured from each interface\n"
+	 "                                    | under the pcap dir, keeping the latest <GB>\n"
 #ifndef WIN32
 	 "[--pid|-G] <path>                   | Pid file path\n"
 #endif
@@ -355,6 +375,8 @@ void usage() {
 	 "                                    |   <mapping type>s have been removed starting at\n"
 	 "                                    |   ElasticSearch version 6. <mapping type> values whill therefore be\n"
 	 "                                    |   ignored when using versions greater than or equal to 6.\n"
+	 "                                    |   Flows are sent in gzip-compressed bulk requests,\n"
+	 "                                    |   see also --es-writers.\n"
 	 "                                    |\n"
 	 "                                    | logstash      Dump in LogStash engine\n"
 	 "                                    |   Format:\n"
@@ -379,8 +401,14 @@ void usage() {
 	 "                                    |   Example:\n"
 	 "                                    |     ./nprobe ... --mysql=\"localhost:ntopng:nf:root:root\"\n"
 	 "                                    |     ./ntopng ... --dump-flows=\"mysql-nprobe;localhost;ntopng;nf;root;root\"\n"
+	 "[--mysql-batch-size <num>]          | Insert up to <num> flows per MySQL INSERT\n"
+	 "                                    | (default: 256)\n"
+	 "[--mysql-writers <num>]             | Insert flows in MySQL over <num> parallel\n"
+	 "                                    | connections (default: 1)\n"
 #endif
 #endif
+	 "[--es-writers <num>]                | Post flows to ElasticSearch over <num> parallel\n"
+	 "                                    | connections (default: 2)\n"
 	 "[--export-flows|-I] <endpoint>      | Export flows with the specified endpoint\n"
 	 "                                    | See https://wp.me/p1LxdS-O5 for a -I use case.\n"
 	 "--hw-timestamp-mode <mode>          | Enable hw timestamping/stripping.\n"
@@ -500,10 +528,105 @@ char* Prefs::get_if_descr(int id) {
 
 /* ******************************************* */
 
+/* Preferences read by reloadPrefsFromRedis() */
+static const char *reload_prefs_keys[] = {
+  CONST_RUNTIME_IS_AUTOLOGOUT_ENABLED, CONST_PREFS_ENABLE_ACCESS_LOG, CONST_PREFS_ENABLE_SQL_LOG,
+  CONST_AUTH_SESSION_DURATION_PREFS, CONST_AUTH_SESSION_MIDNIGHT_EXP_PREFS,
+  CONST_RUNTIME_PREFS_HOUSEKEEPING_FREQUENCY, CONST_LOCAL_HOST_CACHE_DURATION_PREFS,
+  CONST_LOCAL_HOST_IDLE_PREFS, CONST_REMOTE_HOST_IDLE_PREFS, CONST_FLOW_MAX_IDLE_PREFS,
+  CONST_RUNTIME_ACTIVE_LOCAL_HOSTS_CACHE_INTERVAL, CONST_RUNTIME_PREFS_LOG_TO_FILE,
+  CONST_INTF_RRD_RAW_DAYS, CONST_INTF_RRD_1MIN_DAYS, CONST_INTF_RRD_1H_DAYS, CONST_INTF_RRD_1D_DAYS,
+  CONST_OTHER_RRD_RAW_DAYS, CONST_OTHER_RRD_1MIN_DAYS, CONST_OTHER_RRD_1H_DAYS, CONST_OTHER_RRD_1D_DAYS,
+  CONST_TOP_TALKERS_ENABLED, CONST_RUNTIME_IDLE_LOCAL_HOSTS_CACHE_ENABLED,
+  CONST_RUNTIME_ACTIVE_LOCAL_HOSTS_CACHE_ENABLED, CONST_RUNTIME_LOCAL_HOSTS_CACHE_JSON,
+  CONST_RUNTIME_TABLES_SNAPSHOT_ENABLED,
+  CONST_IS_TINY_FLOW_EXPORT_ENABLED,
+  CONST_MAX_NUM_ALERTS_PER_ENTITY, CONST_MAX_NUM_FLOW_ALERTS,
+  CONST_RUNTIME_PREFS_FLOW_DEVICE_PORT_RRD_CREATION, CONST_ALERT_DISABLED_PREFS,
+  CONST_ACTIVITIES_DEBUG_ENABLED, CONST_RUNTIME_PREFS_ALERT_IP_REASSIGNMENT,
+  CONST_DEFAULT_ARP_MATRIX_GENERATION, CONST_DEFAULT_OVERRIDE_DST_WITH_POST_NAT,
+  CONST_DEFAULT_OVERRIDE_SRC_WITH_POST_NAT, CONST_DEFAULT_USE_PORTS_TO_DETERMINE_SRC_AND_DST,
+  CONST_MAX_NUM_PACKETS_PER_TINY_FLOW, CONST_MAX_NUM_BYTES_PER_TINY_FLOW, CONST_MAX_EXTR_PCAP_BYTES,
+  CONST_EWMA_ALPHA_PERCENT, CONST_PREFS_CAPTIVE_PORTAL, CONST_PREFS_MAC_CAPTIVE_PORTAL,
+  CONST_PREFS_INFORM_CAPTIVE_PORTAL, CONST_PREFS_VLAN_TRUNK_MODE_ENABLED, CONST_PREFS_DEFAULT_L7_POLICY,
+  CONST_RUNTIME_MAX_UI_STRLEN, CONST_RUNTIME_PREFS_HOSTMASK, CONST_RUNTIME_PREFS_AUTO_ASSIGNED_POOL_ID,
+  CONST_RUNTIME_PREFS_TS_DRIVER, CONST_RUNTIME_PREFS_ENABLE_MAC_NDPI_STATS, CONST_SAFE_SEARCH_DNS,
+  CONST_GLOBAL_DNS, CONST_SECONDARY_DNS, CONST_PREFS_GLOBAL_DNS_FORGING_ENABLED,
+  CONST_PREFS_CLIENT_X509_AUTH, CONST_PREFS_BEHAVIOUR_ANALYSIS
+};
+
+/* ******************************************* */
+
+/* Must be called with prefetch_lock held */
+void Prefs::prefetchPrefsFromRedis() {
+  const u_int num_keys = sizeof(reload_prefs_keys) / sizeof(reload_prefs_keys[0]);
+  char *values[num_keys];
+
+  if(ntop->getRedis()->mget(num_keys, reload_prefs_keys, values) < 0)
+    return; /* Fallback to single GETs */
+
+  try {
+    for(u_int i = 0; i < num_keys; i++) {
+      std::map<std::string, char*>::iterator it = prefetched_prefs.find(reload_prefs_keys[i]);
+
+      if(it != prefetched_prefs.end()) {
+	/* Duplicate key */
+	if(values[i]) free(values[i]);
+      } else
+	prefetched_prefs[reload_prefs_keys[i]] = values[i];
+
+      values[i] = NULL;
+    }
+  } catch(std::bad_alloc& ba) {
+    for(u_int i = 0; i < num_keys; i++)
+      if(values[i]) free(values[i]);
+
+    releasePrefetchedPrefs();
+    return;
+  }
+
+  prefetch_thread = pthread_self(), prefs_prefetched = true;
+}
+
+/* ******************************************* */
+
+/* Must be called with prefetch_lock held */
+void Prefs::releasePrefetchedPrefs() {
+  prefs_prefetched = false;
+
+  for(std::map<std::string, char*>::iterator it = prefetched_prefs.begin(); it != prefetched_prefs.end(); ++it)
+    if(it->second) free(it->second);
+
+  prefetched_prefs.clear();
+}
+
+/* ******************************************* */
+
+/* Same semantic as Redis::get(): returns 0 when the key exists, -1 otherwise */
+int Prefs::getPrefValue(const char *pref_key, char *rsp, u_int rsp_len) {
+  if(prefs_prefetched && pthread_equal(prefetch_thread, pthread_self())) {
+    std::map<std::string, char*>::iterator it = prefetched_prefs.find(pref_key);
+
+    if(it != prefetched_prefs.end()) {
+      if(it->second == NULL) {
+	rsp[0] = '\0';
+	return(-1);
+      }
+
+      snprintf(rsp, rsp_len, "%s", it->second);
+      return(0);
+    }
+  }
+
+  return(ntop->getRedis()->get((char*)pref_key, rsp, rsp_len));
+}
+
+/* ******************************************* */
+
 void Prefs::getDefaultStringPrefsValue(const char *pref_key, char **buffer, const char *default_value) {
   char rsp[MAX_PATH];
 
-  if((ntop->getRedis()->get((char*)pref_key, rsp, sizeof(rsp)) == 0) && (rsp[0] != '\0'))
+  if((getPrefValue(pref_key, rsp, sizeof(rsp)) == 0) && (rsp[0] != '\0'))
     *buffer = strdup(rsp);
   else
     *buffer = strdup(default_value);
@@ -514,7 +637,7 @@ void Prefs::getDefaultStringPrefsValue(const char *pref_key, char **buffer, cons
 bool Prefs::getDefaultBoolPrefsValue(const char *pref_key, const bool default_value) {
   char rsp[8];
 
-  if(ntop->getRedis()->get((char*)pref_key, rsp, sizeof(rsp)) == 0 && rsp[0] != '\0')
+  if(getPrefValue(pref_key, rsp, sizeof(rsp)) == 0 && rsp[0] != '\0')
     return((rsp[0] == '1') ? true : false);
   else
     return(default_value);
@@ -525,7 +648,7 @@ bool Prefs::getDefaultBoolPrefsValue(const char *pref_key, const bool default_va
 int32_t Prefs::getDefaultPrefsValue(const char *pref_key, int32_t default_value) {
   char rsp[32];
 
-  if(ntop->getRedis()->get((char*)pref_key, rsp, sizeof(rsp)) == 0)
+  if(getPrefValue(pref_key, rsp, sizeof(rsp)) == 0)
     return(atoi(rsp));
   else {
     snprintf(rsp, sizeof(rsp), "%i", default_value);
@@ -554,6 +677,9 @@ void Prefs::reloadPrefsFromRedis() {
   ntop->getTrace()->traceEvent(TRACE_DEBUG, "A preference has changed, reloading...");
 #endif
 
+  prefetch_lock.lock(__FILE__, __LINE__);
+  prefetchPrefsFromRedis();
+
   enable_auto_logout_at_runtime = getDefaultPrefsValue(CONST_RUNTIME_IS_AUTOLOGOUT_ENABLED, CONST_DEFAULT_IS_AUTOLOGOUT_ENABLED);
 
   // alert preferences
@@ -588,6 +714,10 @@ void Prefs::reloadPrefsFromRedis() {
 							       CONST_DEFAULT_IS_IDLE_LOCAL_HOSTS_CACHE_ENABLED),
     enable_active_local_hosts_cache = getDefaultBoolPrefsValue(CONST_RUNTIME_ACTIVE_LOCAL_HOSTS_CACHE_ENABLED,
 							       CONST_DEFAULT_IS_ACTIVE_LOCAL_HOSTS_CACHE_ENABLED),
+    local_hosts_cache_json          = getDefaultBoolPrefsValue(CONST_RUNTIME_LOCAL_HOSTS_CACHE_JSON,
+							       CONST_DEFAULT_IS_LOCAL_HOSTS_CACHE_JSON),
+    enable_tables_snapshot          = getDefaultBoolPrefsValue(CONST_RUNTIME_TABLES_SNAPSHOT_ENABLED,
+							       CONST_DEFAULT_IS_TABLES_SNAPSHOT_ENABLED),
     enable_tiny_flows_export        = getDefaultBoolPrefsValue(CONST_IS_TINY_FLOW_EXPORT_ENABLED,
 							       CONST_DEFAULT_IS_TINY_FLOW_EXPORT_ENABLED),
 
@@ -663,6 +793,9 @@ void Prefs::reloadPrefsFromRedis() {
   refreshDeviceProtocolsPolicyPref();
   refreshDbDumpPrefs();
   refreshBehaviourAnalysis();
+
+  releasePrefetchedPrefs();
+  prefetch_lock.unlock(__FILE__, __LINE__);
   
 #ifdef PREFS_RELOAD_DEBUG
   ntop->getTrace()->traceEvent(TRACE_NORMAL, "Updated IPs "
@@ -781,6 +914,14 @@ static const struct option long_options[] = {
   { "zmq-encryption-key-priv",           required_argument, NULL, 220 },
   { "simulate-ips",                      required_argument, NULL, 221 },
   { "zmq-encryption-key",                required_argument, NULL, 222 },
+  { "dissection-threads",                required_argument, NULL, 223 },
+  { "flow-hook-threads",                 required_argument, NULL, 224 },
+  { "mysql-batch-size",                  required_argument, NULL, 225 },
+  { "mysql-writers",                     required_argument, NULL, 226 },
+  { "es-writers",                        required_argument, NULL, 227 },
+  { "idle-timing-wheel",                 no_argument,       NULL, 228 },
+  { "dns-server",                        required_argument, NULL, 229 },
+  { "packet-recorder",                   required_argument, NULL, 230 },
 #ifdef NTOPNG_PRO
   { "check-maintenance",                 no_argument,       NULL, 252 },
   { "check-license",                     no_argument,       NULL, 253 },
@@ -1467,6 +1608,39 @@ int Prefs::setOption(int optkey, char *optarg) {
     export_zmq_encryption_key = strdup(optarg);
     break;
 
+  case 223:
+    num_dissection_threads = min_val(max_val(atoi(optarg), 0), MAX_NUM_DISSECTION_THREADS);
+    break;
+
+  case 224:
+    num_flow_hook_threads = min_val(max_val(atoi(optarg), 1), MAX_NUM_FLOW_HOOK_THREADS);
+    break;
+
+  case 225:
+    mysql_batch_size = min_val(max_val(atoi(optarg), 1), MYSQL_MAX_BATCH_SIZE);
+    break;
+
+  case 226:
+    num_mysql_writers = min_val(max_val(atoi(optarg), 1), MYSQL_MAX_NUM_WRITERS);
+    break;
+
+  case 227:
+    num_es_writers = min_val(max_val(atoi(optarg), 1), ES_MAX_NUM_WRITERS);
+    break;
+
+  case 228:
+    idle_timing_wheel = true;
+    break;
+
+  case 229:
+    if(dns_server) free(dns_server);
+    dns_server = strdup(optarg);
+    break;
+
+  case 230:
+    packet_recorder_max_gb = max_val(atoi(optarg), 0);
+    break;
+
 #ifdef NTOPNG_PRO
   case 252:
     /* Disable tracing messages */
@@ -1757,6 +1931,8 @@ void Prefs::lua(lua_State* vm) {
 
   lua_push_bool_table_entry(vm, "are_top_talkers_enabled", enable_top_talkers);
   lua_push_bool_table_entry(vm, "is_active_local_hosts_cache_enabled", enable_active_local_hosts_cache);
+  lua_push_bool_table_entry(vm, "is_local_hosts_cache_json", local_hosts_cache_json);
+  lua_push_bool_table_entry(vm, "is_tables_snapshot_enabled", enable_tables_snapshot);
 
   lua_push_bool_table_entry(vm,"is_tiny_flows_export_enabled",             enable_tiny_flows_export);
   lua_push_uint64_table_entry(vm, "max_num_alerts_per_entity", max_num_alerts_per_entity);
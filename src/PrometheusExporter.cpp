@@ -0,0 +1,545 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+typedef u_int64_t (*iface_metric_getter)(NetworkInterface *iface);
+
+static u_int64_t ifacePackets(NetworkInterface *iface)        { return(iface->getNumPackets());            }
+static u_int64_t ifaceBytes(NetworkInterface *iface)          { return(iface->getNumBytes());              }
+static u_int64_t ifaceDrops(NetworkInterface *iface)          { return(iface->getNumPacketDrops());        }
+static u_int64_t ifaceNewFlows(NetworkInterface *iface)       { return(iface->getNumNewFlows());           }
+static u_int64_t ifaceFlows(NetworkInterface *iface)          { return(iface->getNumFlows());              }
+static u_int64_t ifaceHosts(NetworkInterface *iface)          { return(iface->getNumHosts());              }
+static u_int64_t ifaceLocalHosts(NetworkInterface *iface)     { return(iface->getNumLocalHosts());         }
+static u_int64_t ifaceMacs(NetworkInterface *iface)           { return(iface->getNumMacs());               }
+static u_int64_t ifaceAlertedFlows(NetworkInterface *iface)   { return(iface->getNumActiveAlertedFlows()); }
+static u_int64_t ifaceEngagedAlerts(NetworkInterface *iface)  { return(iface->getNumEngagedAlerts());      }
+static u_int64_t ifaceDroppedAlerts(NetworkInterface *iface)  { return(iface->getNumDroppedAlerts());      }
+
+static const struct {
+  const char *name, *type, *help;
+  iface_metric_getter get;
+} iface_metrics[] = {
+  { "ntopng_interface_packets_total",       "counter", "Packets received by the interface",       ifacePackets       },
+  { "ntopng_interface_bytes_total",         "counter", "Bytes received by the interface",         ifaceBytes         },
+  { "ntopng_interface_packet_drops_total",  "counter", "Packets dropped by the interface",        ifaceDrops         },
+  { "ntopng_interface_new_flows_total",     "counter", "Flows created on the interface",          ifaceNewFlows      },
+  { "ntopng_interface_flows",               "gauge",   "Active flows",                            ifaceFlows         },
+  { "ntopng_interface_hosts",               "gauge",   "Active hosts",                            ifaceHosts         },
+  { "ntopng_interface_local_hosts",         "gauge",   "Active local hosts",                      ifaceLocalHosts    },
+  { "ntopng_interface_macs",                "gauge",   "Active MAC addresses",                    ifaceMacs          },
+  { "ntopng_interface_alerted_flows",       "gauge",   "Active flows with an alert",              ifaceAlertedFlows  },
+  { "ntopng_interface_engaged_alerts",      "gauge",   "Alerts currently engaged",                ifaceEngagedAlerts },
+  { "ntopng_interface_dropped_alerts_total", "counter", "Alerts dropped as the queues were full",  ifaceDroppedAlerts },
+};
+
+/* **************************************************** */
+
+PrometheusExporter::PrometheusExporter() {
+  buf = NULL, buf_len = buf_size = 0, out_of_memory = false;
+  allowed_ifname = "";
+  num_scrapes = num_gzip_scrapes = num_failures = 0;
+  tot_render_usec = tot_bytes = tot_sent_bytes = 0;
+  max_render_usec = last_bytes = last_sent_bytes = 0;
+
+#ifdef HAVE_ZLIB
+  gzip_buf = NULL, gzip_buf_size = 0;
+  memset(&zs, 0, sizeof(zs));
+
+  /* Fastest level: scrapes are frequent and the text is highly redundant */
+  zs_inited = (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16 /* gzip wrapper */,
+			    8, Z_DEFAULT_STRATEGY) == Z_OK);
+#endif
+}
+
+/* **************************************************** */
+
+PrometheusExporter::~PrometheusExporter() {
+  if(buf) free(buf);
+
+#ifdef HAVE_ZLIB
+  if(zs_inited) deflateEnd(&zs);
+  if(gzip_buf)  free(gzip_buf);
+#endif
+}
+
+/* **************************************************** */
+
+/* Makes room for len more bytes (including the trailing zero) */
+bool PrometheusExporter::reserve(u_int32_t len) {
+  u_int32_t new_size;
+  char *new_buf;
+
+  if(buf_size - buf_len >= len)
+    return(true);
+
+  new_size = buf_size ? buf_size : PROMETHEUS_BUFFER_SIZE;
+  while(new_size - buf_len < len) new_size *= 2;
+
+  if((new_buf = (char*)realloc(buf, new_size)) == NULL) {
+    out_of_memory = true;
+    return(false);
+  }
+
+  buf = new_buf, buf_size = new_size;
+  return(true);
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::append(const char *fmt, ...) {
+  va_list va;
+  int len;
+
+  if(out_of_memory || !reserve(256))
+    return;
+
+  va_start(va, fmt);
+  len = vsnprintf(&buf[buf_len], buf_size - buf_len, fmt, va);
+  va_end(va);
+
+  if(len < 0)
+    return;
+
+  if((u_int32_t)len >= buf_size - buf_len) {
+    /* Truncated: grow and print again */
+    if(!reserve(len + 1))
+      return;
+
+    va_start(va, fmt);
+    vsnprintf(&buf[buf_len], buf_size - buf_len, fmt, va);
+    va_end(va);
+  }
+
+  buf_len += len;
+}
+
+/* **************************************************** */
+
+/* Appends a quoted label value, escaping backslashes, quotes and newlines */
+void PrometheusExporter::appendLabelValue(const char *value) {
+  u_int32_t len = value ? strlen(value) : 0;
+
+  if(out_of_memory || !reserve(2 * len + 3))
+    return;
+
+  buf[buf_len++] = '"';
+
+  for(u_int32_t i = 0; i < len; i++) {
+    switch(value[i]) {
+    case '\\': buf[buf_len++] = '\\', buf[buf_len++] = '\\'; break;
+    case '"':  buf[buf_len++] = '\\', buf[buf_len++] = '"';  break;
+    case '\n': buf[buf_len++] = '\\', buf[buf_len++] = 'n';  break;
+    default:   buf[buf_len++] = value[i];                    break;
+    }
+  }
+
+  buf[buf_len++] = '"';
+  buf[buf_len] = '\0';
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::appendFamily(const char *name, const char *type, const char *help) {
+  append("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::appendInterfaceLabels(NetworkInterface *iface) {
+  append("ifid=\"%d\",ifname=", iface->get_id());
+  appendLabelValue(iface->get_name());
+}
+
+/* **************************************************** */
+
+/* Same prefix match as Ntop::isInterfaceAllowed() */
+bool PrometheusExporter::isInterfaceAllowed(NetworkInterface *iface) const {
+  return((allowed_ifname[0] == '\0')
+	 || !strncmp(allowed_ifname, iface->get_name(), strlen(allowed_ifname)));
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::renderInterfaces() {
+  for(u_int m = 0; m < sizeof(iface_metrics) / sizeof(iface_metrics[0]); m++) {
+    appendFamily(iface_metrics[m].name, iface_metrics[m].type, iface_metrics[m].help);
+
+    for(int i = 0; i < ntop->get_num_interfaces(); i++) {
+      NetworkInterface *iface = ntop->getInterface(i);
+
+      if(!iface || !isInterfaceAllowed(iface)) continue;
+
+      append("%s{", iface_metrics[m].name);
+      appendInterfaceLabels(iface);
+      append("} %llu\n", (unsigned long long)iface_metrics[m].get(iface));
+    }
+  }
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::renderHashTables() {
+  const char *names[] = { "ntopng_hash_table_entries", "ntopng_hash_table_idle_entries", "ntopng_hash_table_max_entries" };
+  const char *helps[] = { "Entries of the hash table", "Idle entries waiting to be purged", "Max entries of the hash table" };
+
+  for(u_int m = 0; m < sizeof(names) / sizeof(names[0]); m++) {
+    appendFamily(names[m], "gauge", helps[m]);
+
+    for(int i = 0; i < ntop->get_num_interfaces(); i++) {
+      NetworkInterface *iface = ntop->getInterface(i);
+      GenericHash *gh[8];
+      u_int num;
+
+      if(!iface || !isInterfaceAllowed(iface)) continue;
+
+      num = iface->getHashTables(gh, sizeof(gh) / sizeof(gh[0]));
+
+      for(u_int h = 0; h < num; h++) {
+	u_int32_t value;
+
+	switch(m) {
+	case 0:  value = gh[h]->getNumEntries();   break;
+	case 1:  value = gh[h]->getNumIdleEntries(); break;
+	default: value = gh[h]->getMaxHashSize();  break;
+	}
+
+	append("%s{", names[m]);
+	appendInterfaceLabels(iface);
+	append(",hash=");
+	appendLabelValue(gh[h]->getName());
+	append("} %u\n", value);
+      }
+    }
+  }
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::renderQueues() {
+  const char *names[] = { "ntopng_queue_length", "ntopng_queue_failed_enqueues_total" };
+  const char *types[] = { "gauge", "counter" };
+  const char *helps[] = { "Items waiting in the queue", "Items not enqueued as the queue was full" };
+
+  for(u_int m = 0; m < sizeof(names) / sizeof(names[0]); m++) {
+    appendFamily(names[m], types[m], helps[m]);
+
+    for(int i = 0; i < ntop->get_num_interfaces(); i++) {
+      NetworkInterface *iface = ntop->getInterface(i);
+      const SPSCQueue<Flow *> *queues[2 + 3 * MAX_NUM_FLOW_HOOK_THREADS];
+      u_int num;
+
+      if(!iface || !isInterfaceAllowed(iface)) continue;
+
+      num = iface->getFlowQueues(queues, sizeof(queues) / sizeof(queues[0]));
+
+      for(u_int q = 0; q < num; q++) {
+	append("%s{", names[m]);
+	appendInterfaceLabels(iface);
+	append(",queue=");
+	appendLabelValue(queues[q]->getName());
+	append("} %llu\n", (unsigned long long)(m == 0 ? queues[q]->getLength() : queues[q]->get_num_failed_enqueues()));
+      }
+    }
+  }
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::renderNdpi() {
+  const char *names[] = { "ntopng_ndpi_bytes_total", "ntopng_ndpi_packets_total", "ntopng_ndpi_flows_total" };
+  const char *helps[] = { "Bytes per application protocol", "Packets per application protocol", "Flows per application protocol" };
+  const char *directions[] = { "sent", "rcvd" };
+  vector<nDPIStats*> stats;
+  u_int num_ifaces = ntop->get_num_interfaces();
+
+  /* Stats of sharded interfaces are merged once, then reused by every family */
+  try {
+    stats.resize(num_ifaces, NULL);
+  } catch(std::bad_alloc& ba) {
+    out_of_memory = true;
+    return;
+  }
+
+  for(u_int i = 0; i < num_ifaces; i++) {
+    NetworkInterface *iface = ntop->getInterface(i);
+    TcpFlowStats tcpFlowStats;
+    EthStats ethStats;
+    LocalTrafficStats localStats;
+    PacketStats pktStats;
+    TcpPacketStats tcpPacketStats;
+    ProtoStats discardedProbingStats;
+    DSCPStats dscpStats;
+    SyslogStats syslogStats;
+
+    if(!iface || !isInterfaceAllowed(iface)
+       || ((stats[i] = new (std::nothrow) nDPIStats()) == NULL))
+      continue;
+
+    iface->sumStats(&tcpFlowStats, &ethStats, &localStats, stats[i], &pktStats,
+		    &tcpPacketStats, &discardedProbingStats, &dscpStats, &syslogStats);
+  }
+
+  for(u_int m = 0; m < sizeof(names) / sizeof(names[0]); m++) {
+    appendFamily(names[m], "counter", helps[m]);
+
+    for(u_int i = 0; i < num_ifaces; i++) {
+      NetworkInterface *iface = ntop->getInterface(i);
+
+      if(!iface || !stats[i]) continue;
+
+      for(u_int16_t proto_id = 0; proto_id < MAX_NDPI_PROTOS; proto_id++) {
+	const ProtoCounter *c = stats[i]->getProtoCounter(proto_id);
+	const char *proto_name;
+
+	if(!c || ((c->bytes.sent + c->bytes.rcvd) == 0)
+	   || ((proto_name = iface->get_ndpi_proto_name(proto_id)) == NULL))
+	  continue;
+
+	if(m == 2) {
+	  append("%s{", names[m]);
+	  appendInterfaceLabels(iface);
+	  append(",proto=");
+	  appendLabelValue(proto_name);
+	  append("} %u\n", c->total_flows);
+	  continue;
+	}
+
+	for(u_int d = 0; d < 2; d++) {
+	  const TrafficCounter *tc = (m == 0) ? &c->bytes : &c->packets;
+
+	  append("%s{", names[m]);
+	  appendInterfaceLabels(iface);
+	  append(",proto=");
+	  appendLabelValue(proto_name);
+	  append(",direction=\"%s\"} %llu\n", directions[d], (unsigned long long)(d == 0 ? tc->sent : tc->rcvd));
+	}
+      }
+    }
+  }
+
+  for(u_int i = 0; i < num_ifaces; i++)
+    if(stats[i]) delete stats[i];
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::renderPeriodicActivities() {
+  const char *names[] = { "ntopng_periodic_activity_last_duration_ms", "ntopng_periodic_activity_max_duration_ms",
+			  "ntopng_periodic_activity_not_executed_total", "ntopng_periodic_activity_slow_total" };
+  const char *types[] = { "gauge", "gauge", "counter", "counter" };
+  const char *helps[] = { "Duration of the last run", "Max duration of a run",
+			  "Runs skipped as the previous one was still in progress", "Runs exceeding their periodicity" };
+  PeriodicActivities *pa = ntop->getPeriodicActivities();
+  int num_ifaces = ntop->get_num_interfaces();
+
+  if(!pa) return;
+
+  for(u_int m = 0; m < sizeof(names) / sizeof(names[0]); m++) {
+    appendFamily(names[m], types[m], helps[m]);
+
+    /* The last iteration covers the system interface */
+    for(int i = 0; i <= num_ifaces; i++) {
+      NetworkInterface *iface = (i < num_ifaces) ? ntop->getInterface(i) : ntop->getSystemInterface();
+
+      if(!iface || !isInterfaceAllowed(iface)) continue;
+
+      for(u_int16_t a = 0; a < pa->getNumActivities(); a++) {
+	ThreadedActivity *ta = pa->getActivity(a);
+	ThreadedActivityStats *s;
+	u_long value;
+
+	if(!ta || ((s = ta->getThreadedActivityStats(iface, false)) == NULL))
+	  continue;
+
+	switch(m) {
+	case 0:  value = s->getLastDurationMs(); break;
+	case 1:  value = s->getMaxDurationMs();  break;
+	case 2:  value = s->getNumNotExecuted(); break;
+	default: value = s->getNumSlow();        break;
+	}
+
+	append("%s{", names[m]);
+	appendInterfaceLabels(iface);
+	append(",script=");
+	appendLabelValue(ta->activityPath());
+	append("} %lu\n", value);
+      }
+    }
+  }
+}
+
+/* **************************************************** */
+
+/* Must be called with m held */
+bool PrometheusExporter::render() {
+  buf_len = 0, out_of_memory = false;
+
+  if(!reserve(1))
+    return(false);
+
+  buf[0] = '\0';
+
+  renderInterfaces();
+  renderHashTables();
+  renderQueues();
+  renderNdpi();
+  renderPeriodicActivities();
+
+  return(!out_of_memory);
+}
+
+/* **************************************************** */
+
+/* Must be called with m held. Returns the compressed length, or 0 when the text must be sent as is. */
+u_int32_t PrometheusExporter::compress() {
+#ifdef HAVE_ZLIB
+  u_int32_t bound;
+
+  if(!zs_inited || (deflateReset(&zs) != Z_OK))
+    return(0);
+
+  bound = deflateBound(&zs, buf_len);
+
+  if(bound > gzip_buf_size) {
+    char *new_buf = (char*)realloc(gzip_buf, bound);
+
+    if(new_buf == NULL)
+      return(0);
+
+    gzip_buf = new_buf, gzip_buf_size = bound;
+  }
+
+  zs.next_in = (Bytef*)buf, zs.avail_in = buf_len;
+  zs.next_out = (Bytef*)gzip_buf, zs.avail_out = gzip_buf_size;
+
+  if(deflate(&zs, Z_FINISH) == Z_STREAM_END)
+    return(gzip_buf_size - zs.avail_out);
+#endif
+
+  return(0);
+}
+
+/* **************************************************** */
+
+int PrometheusExporter::serve(struct mg_connection *conn, const char * const _allowed_ifname) {
+  const char *accept_encoding = mg_get_header(conn, "Accept-Encoding");
+  struct timeval begin, end;
+  char *body;
+  u_int32_t text_len, body_len, body_size, gzip_len = 0, usec;
+  bool rendered;
+
+  gettimeofday(&begin, NULL);
+
+  m.lock(__FILE__, __LINE__);
+
+  allowed_ifname = _allowed_ifname ? _allowed_ifname : "";
+  rendered = render();
+  allowed_ifname = ""; /* Points to the caller buffer */
+
+  if(!rendered) {
+    num_failures++;
+    m.unlock(__FILE__, __LINE__);
+    return(send_error(conn, 500 /* Internal server error */,
+		      "Internal server error", "%s", "Not enough memory to render the metrics"));
+  }
+
+  if(accept_encoding && strstr(accept_encoding, "gzip"))
+    gzip_len = compress();
+
+  text_len = buf_len;
+
+  /*
+    Detach the buffer to send, so that the lock is not held while the
+    client reads the response: a concurrent scrape allocates its own
+  */
+#ifdef HAVE_ZLIB
+  if(gzip_len > 0) {
+    body = gzip_buf, body_len = gzip_len, body_size = gzip_buf_size, num_gzip_scrapes++;
+    gzip_buf = NULL, gzip_buf_size = 0;
+  } else
+#endif
+  {
+    body = buf, body_len = buf_len, body_size = buf_size;
+    buf = NULL, buf_len = buf_size = 0;
+  }
+
+  gettimeofday(&end, NULL);
+  usec = Utils::usecTimevalDiff(&end, &begin);
+
+  num_scrapes++, tot_render_usec += usec;
+  if(usec > max_render_usec) max_render_usec = usec;
+  tot_bytes += text_len, last_bytes = text_len;
+  tot_sent_bytes += body_len, last_sent_bytes = body_len;
+
+  m.unlock(__FILE__, __LINE__);
+
+  mg_printf(conn,
+	    "HTTP/1.1 200 OK\r\n"
+	    "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+	    "%s"
+	    "Vary: Accept-Encoding\r\n"
+	    "Cache-Control: no-cache\r\n"
+	    "Content-Length: %u\r\n\r\n",
+	    (gzip_len > 0) ? "Content-Encoding: gzip\r\n" : "",
+	    body_len);
+  mg_write(conn, body, body_len);
+
+  /* Give the buffer back for the next scrape, unless a concurrent one has already replaced it */
+  m.lock(__FILE__, __LINE__);
+
+#ifdef HAVE_ZLIB
+  if(gzip_len > 0) {
+    if(gzip_buf == NULL)
+      gzip_buf = body, gzip_buf_size = body_size, body = NULL;
+  } else
+#endif
+  if(buf == NULL)
+    buf = body, buf_size = body_size, body = NULL;
+
+  m.unlock(__FILE__, __LINE__);
+
+  if(body) free(body);
+
+  return(1); /* Handled */
+}
+
+/* **************************************************** */
+
+void PrometheusExporter::lua(lua_State *vm) {
+  m.lock(__FILE__, __LINE__);
+
+  lua_newtable(vm);
+  lua_push_uint64_table_entry(vm, "num_scrapes", num_scrapes);
+  lua_push_uint64_table_entry(vm, "num_gzip_scrapes", num_gzip_scrapes);
+  lua_push_uint64_table_entry(vm, "num_failures", num_failures);
+  lua_push_float_table_entry(vm, "avg_render_usec", num_scrapes ? ((float)tot_render_usec) / num_scrapes : 0);
+  lua_push_uint64_table_entry(vm, "max_render_usec", max_render_usec);
+  lua_push_float_table_entry(vm, "avg_bytes", num_scrapes ? ((float)tot_bytes) / num_scrapes : 0);
+  lua_push_float_table_entry(vm, "avg_sent_bytes", num_scrapes ? ((float)tot_sent_bytes) / num_scrapes : 0);
+  lua_push_uint64_table_entry(vm, "last_bytes", last_bytes);
+  lua_push_uint64_table_entry(vm, "last_sent_bytes", last_sent_bytes);
+  lua_push_uint64_table_entry(vm, "buffer_size", buf_size);
+
+  m.unlock(__FILE__, __LINE__);
+}
@@ -0,0 +1,57 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* *************************************** */
+
+RecipientNotification::RecipientNotification() {
+  num_refs.store(1, std::memory_order_relaxed);
+  gettimeofday(&creation_time, NULL);
+  len = 0, data = NULL;
+}
+
+/* *************************************** */
+
+RecipientNotification::~RecipientNotification() {
+  if(data) free(data);
+}
+
+/* *************************************** */
+
+RecipientNotification* RecipientNotification::create(const char * const notification) {
+  RecipientNotification *n;
+
+  if(!notification || (n = new (std::nothrow) RecipientNotification()) == NULL)
+    return(NULL);
+
+  n->len = strlen(notification);
+
+  if((n->data = (char*)malloc(n->len + 1)) == NULL) {
+    delete n;
+    return(NULL);
+  }
+
+  memcpy(n->data, notification, n->len + 1);
+
+  return(n);
+}
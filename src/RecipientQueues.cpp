@@ -25,69 +25,205 @@
 
 RecipientQueues::RecipientQueues() {
   for(int i = 0; i < RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES; i++)
-    queues_by_prio[i] = NULL,
-      drops_by_prio[i] = 0,
+    queues_by_prio[i] = NULL;
+
+  resetStats();
+  num_enqueuers = 0;
+  enabled = true;
+}
+
+/* *************************************** */
+
+void RecipientQueues::resetStats() {
+  for(int i = 0; i < RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES; i++)
+    drops_by_prio[i] = 0,
       uses_by_prio[i] = 0,
-      last_use = 0;
+      dequeues_by_prio[i] = 0;
+
+  tot_latency_usec = 0, max_latency_usec = 0;
+  last_use = 0;
 }
 
 /* *************************************** */
 
 RecipientQueues::~RecipientQueues() {
-  for(int i = 0; i < RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES; i++)
-    delete queues_by_prio[i];
+  setEnabled(false); /* Releases the queued notifications */
+
+  for(int i = 0; i < RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES; i++) {
+    MPMCQueue<RecipientNotification*> *q = queues_by_prio[i].load();
+
+    if(q) delete q;
+  }
 }
 
 /* *************************************** */
 
-char* RecipientQueues::dequeue(RecipientNotificationPriority prio) {
-  char *res = NULL;
+MPMCQueue<RecipientNotification*>* RecipientQueues::getQueue(RecipientNotificationPriority prio) {
+  MPMCQueue<RecipientNotification*> *q = queues_by_prio[prio].load(std::memory_order_acquire), *expected = NULL;
 
-  if(prio >= RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES)
-    return NULL;
+  if(q)
+    return(q);
 
-  if(queues_by_prio[prio])
-    res = queues_by_prio[prio]->dequeue();
+  /*
+    Lazily allocate the queue. Concurrent enqueuers may race here: the
+    loser deletes its queue and uses the winner's one.
+  */
+  if((q = new (nothrow) MPMCQueue<RecipientNotification*>(ALERTS_NOTIFICATIONS_QUEUE_SIZE)) == NULL)
+    return(NULL);
+
+  if(!queues_by_prio[prio].compare_exchange_strong(expected, q, std::memory_order_acq_rel)) {
+    delete q;
+    q = expected;
+  }
+
+  return(q);
+}
+
+/* *************************************** */
+
+void RecipientQueues::updateLatency(const RecipientNotification *n, const struct timeval *now) {
+  u_int32_t usec = Utils::usecTimevalDiff(now, n->getCreationTime());
+  u_int32_t cur_max = max_latency_usec.load(std::memory_order_relaxed);
+
+  tot_latency_usec.fetch_add(usec, std::memory_order_relaxed);
+
+  while((usec > cur_max)
+	&& !max_latency_usec.compare_exchange_weak(cur_max, usec, std::memory_order_relaxed))
+    ;
+}
+
+/* *************************************** */
 
-  if(res)
-    last_use = time(NULL);
+RecipientNotification* RecipientQueues::dequeue(RecipientNotificationPriority prio) {
+  RecipientNotification *res = NULL;
+
+  if(dequeueBulk(prio, &res, 1) == 0)
+    return NULL;
 
   return res;
 }
 
 /* *************************************** */
 
-bool RecipientQueues::enqueue(RecipientNotificationPriority prio, const char * const notification) {
-  bool res = false;
+u_int32_t RecipientQueues::dequeueBulk(RecipientNotificationPriority prio,
+				       RecipientNotification **notifications, u_int32_t max_notifications) {
+  MPMCQueue<RecipientNotification*> *q;
+  struct timeval now;
+  u_int32_t num;
 
   if(prio >= RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES)
+    return 0;
+
+  if((q = queues_by_prio[prio].load(std::memory_order_acquire)) == NULL)
+    return 0;
+
+  if((num = q->dequeueBulk(notifications, max_notifications)) > 0) {
+    gettimeofday(&now, NULL);
+
+    for(u_int32_t i = 0; i < num; i++)
+      updateLatency(notifications[i], &now);
+
+    dequeues_by_prio[prio].fetch_add(num, std::memory_order_relaxed);
+    last_use.store(now.tv_sec, std::memory_order_relaxed);
+  }
+
+  return num;
+}
+
+/* *************************************** */
+
+bool RecipientQueues::enqueue(RecipientNotificationPriority prio, RecipientNotification *notification) {
+  MPMCQueue<RecipientNotification*> *q;
+  bool res = false;
+
+  if((prio >= RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES) || !notification)
+    return false;
+
+  /*
+    Announce the enqueue before checking the state (both sequentially
+    consistent): setEnabled(false) either waits for this enqueue or
+    is seen here
+  */
+  num_enqueuers.fetch_add(1);
+
+  if(!enabled.load()) {
+    num_enqueuers.fetch_sub(1);
     return false;
+  }
 
   /*
-    Lazily allocate the queue and then enqueue the notification
+    The queue holds a reference: take it before the notification becomes
+    visible to the consumers, which release it once done
    */
-  if(queues_by_prio[prio]
-     || (queues_by_prio[prio] = new (nothrow) FifoStringsQueue(ALERTS_NOTIFICATIONS_QUEUE_SIZE)))
-    res = queues_by_prio[prio]->enqueue((char*)notification);
+  if((q = getQueue(prio)) != NULL) {
+    notification->incRef();
+
+    if(!(res = q->enqueue(notification)))
+      notification->decRef();
+  }
+
+  num_enqueuers.fetch_sub(1);
 
   if(!res)
-    drops_by_prio[prio]++;
+    drops_by_prio[prio].fetch_add(1, std::memory_order_relaxed);
   else
-    uses_by_prio[prio]++;
+    uses_by_prio[prio].fetch_add(1, std::memory_order_relaxed);
 
   return res;
 }
 
 /* *************************************** */
 
+void RecipientQueues::setEnabled(bool _enabled) {
+  if(_enabled) {
+    /* Re-registered recipients start over */
+    setEnabled(false);
+    resetStats();
+    enabled.store(true);
+  } else {
+    enabled.store(false);
+
+    /* Wait for the enqueues that have seen the queues enabled */
+    while(num_enqueuers.load() > 0)
+      _usleep(10);
+
+    /* Drop what is queued */
+    for(int i = 0; i < RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES; i++) {
+      MPMCQueue<RecipientNotification*> *q = queues_by_prio[i].load(std::memory_order_acquire);
+      RecipientNotification *n;
+
+      if(q) {
+	while(q->dequeue(&n))
+	  n->decRef();
+      }
+    }
+  }
+}
+
+/* *************************************** */
+
 void RecipientQueues::lua(lua_State* vm) {
-  u_int64_t num_drops = 0, num_uses = 0;
-  for(int i = 0; i < RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES; i++)
+  u_int64_t num_drops = 0, num_uses = 0, num_dequeues = 0;
+  u_int32_t queue_length = 0;
+
+  for(int i = 0; i < RECIPIENT_NOTIFICATION_MAX_NUM_PRIORITIES; i++) {
+    MPMCQueue<RecipientNotification*> *q = queues_by_prio[i].load(std::memory_order_acquire);
+
     num_drops +=  drops_by_prio[i],
-      num_uses += uses_by_prio[i];
+      num_uses += uses_by_prio[i],
+      num_dequeues += dequeues_by_prio[i];
+
+    if(q) queue_length += q->getLength();
+  }
 
   lua_newtable(vm);
   lua_push_uint64_table_entry(vm, "last_use", last_use);
   lua_push_uint64_table_entry(vm, "num_drops", num_drops);
   lua_push_uint64_table_entry(vm, "num_uses", num_uses);
+  lua_push_uint64_table_entry(vm, "num_dequeues", num_dequeues);
+  lua_push_uint64_table_entry(vm, "num_high_priority_drops", drops_by_prio[recipient_notification_priority_high]);
+  lua_push_uint64_table_entry(vm, "num_low_priority_drops", drops_by_prio[recipient_notification_priority_low]);
+  lua_push_uint64_table_entry(vm, "queue_length", queue_length);
+  lua_push_float_table_entry(vm, "avg_latency_usec", num_dequeues ? ((float)tot_latency_usec) / num_dequeues : 0);
+  lua_push_uint64_table_entry(vm, "max_latency_usec", max_latency_usec);
 }
@@ -24,71 +24,120 @@
 /* *************************************** */
 
 Recipients::Recipients() {
-  memset(&recipient_queues, 0, sizeof(recipient_queues));
+  for(int i = 0; i < MAX_NUM_RECIPIENTS; i++)
+    recipient_queues[i] = NULL;
 }
 
 /* *************************************** */
 
 Recipients::~Recipients() {
   for(int i = 0; i < MAX_NUM_RECIPIENTS; i++) {
-    if(recipient_queues[i])
-      delete recipient_queues[i];
+    RecipientQueues *rq = recipient_queues[i].load();
+
+    if(rq)
+      delete rq;
   }
 }
 
 /* *************************************** */
 
-char* Recipients::dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio) {
-  char * res = NULL;
+RecipientNotification* Recipients::dequeue(u_int16_t recipient_id, RecipientNotificationPriority prio) {
+  RecipientNotification *res = NULL;
 
-  if(recipient_id >= MAX_NUM_RECIPIENTS)
+  if(dequeueBulk(recipient_id, prio, &res, 1) == 0)
     return NULL;
 
-  m.lock(__FILE__, __LINE__);
+  return res;
+}
 
-  if(recipient_queues[recipient_id]) {
-    /*
-      Dequeue the notification for a given priority
-    */
-    res = recipient_queues[recipient_id]->dequeue(prio);
-  }
+/* *************************************** */
 
-  m.unlock(__FILE__, __LINE__);
+u_int32_t Recipients::dequeueBulk(u_int16_t recipient_id, RecipientNotificationPriority prio,
+				  RecipientNotification **notifications, u_int32_t max_notifications) {
+  RecipientQueues *rq;
 
-  return res;
+  if(recipient_id >= MAX_NUM_RECIPIENTS)
+    return 0;
+
+  /*
+    Dequeue the notifications for a given priority
+  */
+  if((rq = recipient_queues[recipient_id].load(std::memory_order_acquire)) == NULL)
+    return 0;
+
+  return rq->dequeueBulk(prio, notifications, max_notifications);
 }
 
 /* *************************************** */
 
-bool Recipients::enqueue(u_int16_t recipient_id, RecipientNotificationPriority prio, const char * const notification) {
-  bool res = false;
+bool Recipients::enqueue(u_int16_t recipient_id, RecipientNotificationPriority prio, RecipientNotification *notification) {
+  RecipientQueues *rq;
 
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return false;
 
-  m.lock(__FILE__, __LINE__);
-
   /* 
      Perform the actual enqueue for the given priority
    */
-  if(recipient_queues[recipient_id])
-    res = recipient_queues[recipient_id]->enqueue(prio, notification);
+  if((rq = recipient_queues[recipient_id].load(std::memory_order_acquire)) == NULL)
+    return false;
 
-  m.unlock(__FILE__, __LINE__);
+  return rq->enqueue(prio, notification);
+}
+
+/* *************************************** */
+
+bool Recipients::enqueue(u_int16_t recipient_id, RecipientNotificationPriority prio, const char * const notification) {
+  RecipientNotification *n = RecipientNotification::create(notification);
+  bool res;
+
+  if(!n)
+    return false;
+
+  res = enqueue(recipient_id, prio, n);
+  n->decRef();
 
   return res;
 }
 
 /* *************************************** */
 
+u_int32_t Recipients::enqueue(const u_int16_t *recipient_ids, u_int32_t num_recipients,
+			      RecipientNotificationPriority prio, const char * const notification) {
+  RecipientNotification *n;
+  u_int32_t num_enqueued = 0;
+
+  if(num_recipients == 0)
+    return 0;
+
+  /* The notification is stored once and referenced by every recipient queue */
+  if((n = RecipientNotification::create(notification)) == NULL)
+    return 0;
+
+  for(u_int32_t i = 0; i < num_recipients; i++) {
+    if(enqueue(recipient_ids[i], prio, n))
+      num_enqueued++;
+  }
+
+  n->decRef();
+
+  return num_enqueued;
+}
+
+/* *************************************** */
+
 void Recipients::register_recipient(u_int16_t recipient_id) {  
+  RecipientQueues *rq;
+
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return;
 
   m.lock(__FILE__, __LINE__);
 
-  if(!recipient_queues[recipient_id])
-    recipient_queues[recipient_id] = new (nothrow) RecipientQueues();
+  if((rq = recipient_queues[recipient_id].load()) != NULL)
+    rq->setEnabled(true); /* Empty queues and zeroed stats, as a new recipient */
+  else if((rq = new (nothrow) RecipientQueues()) != NULL)
+    recipient_queues[recipient_id].store(rq, std::memory_order_release);
 
   m.unlock(__FILE__, __LINE__);
 }
@@ -96,15 +145,19 @@ void Recipients::register_recipient(u_int16_t recipient_id) {
 /* *************************************** */
 
 void Recipients::delete_recipient(u_int16_t recipient_id) {
+  RecipientQueues *rq;
+
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return;
 
   m.lock(__FILE__, __LINE__);
 
-  if(recipient_queues[recipient_id]) {
-    delete recipient_queues[recipient_id];
-    recipient_queues[recipient_id] = NULL;
-  }
+  /*
+    Queues are not freed as enqueues and dequeues run without locks: they are
+    disabled (and emptied) until the recipient id is registered again
+  */
+  if((rq = recipient_queues[recipient_id].load()) != NULL)
+    rq->setEnabled(false);
 
   m.unlock(__FILE__, __LINE__);
 }
@@ -112,13 +165,12 @@ void Recipients::delete_recipient(u_int16_t recipient_id) {
 /* *************************************** */
 
 void Recipients::lua(u_int16_t recipient_id, lua_State* vm) {
+  RecipientQueues *rq;
+
   if(recipient_id >= MAX_NUM_RECIPIENTS)
     return;
 
-  m.lock(__FILE__, __LINE__);
-
-  if(recipient_queues[recipient_id])
-    recipient_queues[recipient_id]->lua(vm);
-
-  m.unlock(__FILE__, __LINE__);
+  if(((rq = recipient_queues[recipient_id].load(std::memory_order_acquire)) != NULL)
+     && rq->isEnabled())
+    rq->lua(vm);
 }
@@ -29,38 +29,73 @@
 
 // #define CACHE_DEBUG 1
 
+/* Keep in sync with RedisCommandType */
+static const char *redis_cmd_names[] = { "get", "set", "del", "expire", "hash", "keys", "list", "pipeline", "other" };
+
 /* **************************************** */
 
 Redis::Redis(const char *_redis_host, const char *_redis_password, u_int16_t _redis_port,
-	     u_int8_t _redis_db_id, bool giveup_on_failure) {
+	     u_int8_t _redis_db_id, bool giveup_on_failure, u_int8_t _pool_size) {
   redis_host = _redis_host ? strdup(_redis_host) : NULL;
   redis_password = _redis_password ? strdup(_redis_password) : NULL;
   redis_port = _redis_port, redis_db_id = _redis_db_id;
+  redis_version = NULL;
 #ifdef __linux__
   is_socket_connection = false;
 #endif
 
-  memset(&stats, 0, sizeof(stats));
+  stats.num_expire = stats.num_get = stats.num_ttl = stats.num_del = 0;
+  stats.num_hget = stats.num_hset = stats.num_hdel = stats.num_set = 0;
+  stats.num_keys = stats.num_hkeys = stats.num_llen = stats.num_other = 0;
+  stats.num_hgetall = stats.num_trim = stats.num_lpush_rpush = 0;
+  stats.num_lpop_rpop = stats.num_strlen = stats.num_saved_lookups = 0;
+  stats.num_get_address = stats.num_set_resolved_address = 0;
+  stats.num_reconnections = 0;
 
-  redis = NULL, operational = false;
+  num_connected = 0, cache_version = 0;
   initializationCompleted = false;
   localToResolve = new FifoStringsQueue(MAX_NUM_QUEUED_ADDRS);
   remoteToResolve = new FifoStringsQueue(MAX_NUM_QUEUED_ADDRS);
-  reconnectRedis(giveup_on_failure);
   numCached = 0;
   l = new Mutex();
 
-  if(operational) getRedisVersion();
+  pool_size = max_val(_pool_size, 1), next_conn_slot = 0;
+  pool = new RedisConnection[pool_size];
+  pthread_key_create(&conn_key, NULL);
+
+  for(u_int8_t i = 0; i < pool_size; i++) {
+    RedisConnection *c = &pool[i];
+
+    c->redis = NULL, c->id = i, c->connected = false;
+    memset(c->num_commands, 0, sizeof(c->num_commands));
+    memset(c->tot_usec, 0, sizeof(c->tot_usec));
+    memset(c->max_usec, 0, sizeof(c->max_usec));
+    memset(c->latency_histogram, 0, sizeof(c->latency_histogram));
+  }
+
+  reconnectRedis(&pool[0], giveup_on_failure);
+
+  if(isOperational()) {
+    /* Connections that fail now are retried upon their first command */
+    for(u_int8_t i = 1; i < pool_size; i++)
+      reconnectRedis(&pool[i], true);
+
+    getRedisVersion();
+  }
 }
 
 /* **************************************** */
 
 Redis::~Redis() {
   flushCache();
-  redisFree(redis);
-  // flushCache();
+
+  for(u_int8_t i = 0; i < pool_size; i++)
+    if(pool[i].redis) redisFree(pool[i].redis);
+
+  delete[] pool;
+  pthread_key_delete(conn_key);
   delete l;
-  
+
   if(redis_host)     free(redis_host);
   if(redis_password) free(redis_password);
   if(redis_version)  free(redis_version);
@@ -70,40 +105,162 @@ Redis::~Redis() {
 
 /* **************************************** */
 
-void Redis::reconnectRedis(bool giveup_on_failure) {
+/*
+  Returns the connection bound to the calling thread, locked. Threads are
+  bound round-robin upon their first command, so that threads only contend
+  with the few others sharing their connection.
+*/
+RedisConnection* Redis::getConnection(bool trace_errors) {
+  uintptr_t slot = (uintptr_t)pthread_getspecific(conn_key);
+  RedisConnection *c;
+
+  if(slot == 0) {
+    slot = (next_conn_slot++ % pool_size) + 1;
+    pthread_setspecific(conn_key, (void*)slot);
+  }
+
+  c = &pool[slot - 1];
+  c->l.lock(__FILE__, __LINE__, trace_errors);
+
+  return(c);
+}
+
+/* **************************************** */
+
+void Redis::releaseConnection(RedisConnection *c, bool trace_errors) {
+  c->l.unlock(__FILE__, __LINE__, trace_errors);
+}
+
+/* **************************************** */
+
+/* Must be called with the connection locked */
+void Redis::updateLatency(RedisConnection *c, RedisCommandType t, const struct timeval *begin) {
+  struct timeval end;
+  u_int32_t usec, slot = 0;
+
+  gettimeofday(&end, NULL);
+  usec = Utils::usecTimevalDiff(&end, begin);
+
+  /* Slot i counts the commands that took less than 2^i usec */
+  while((slot < REDIS_LATENCY_HISTOGRAM_SLOTS - 1) && (usec >= (1u << slot)))
+    slot++;
+
+  c->num_commands[t]++, c->tot_usec[t] += usec;
+  if(usec > c->max_usec[t]) c->max_usec[t] = usec;
+  c->latency_histogram[t][slot]++;
+}
+
+/* **************************************** */
+
+/* Must be called with the connection locked. Upon failure NULL is returned and the connection is restored. */
+redisReply* Redis::command(RedisConnection *c, RedisCommandType t, const char *format, ...) {
+  struct timeval begin;
+  redisReply *reply = NULL;
+  va_list ap;
+
+  if(c->redis) {
+    gettimeofday(&begin, NULL);
+    va_start(ap, format);
+    reply = (redisReply*)redisvCommand(c->redis, format, ap);
+    va_end(ap);
+    updateLatency(c, t, &begin);
+  }
+
+  if(!reply) reconnectRedis(c, true);
+
+  return(reply);
+}
+
+/* **************************************** */
+
+redisReply* Redis::commandArgv(RedisConnection *c, RedisCommandType t, int argc, const char **argv, const size_t *argvlen) {
+  struct timeval begin;
+  redisReply *reply = NULL;
+
+  if(c->redis) {
+    gettimeofday(&begin, NULL);
+    reply = (redisReply*)redisCommandArgv(c->redis, argc, argv, argvlen);
+    updateLatency(c, t, &begin);
+  }
+
+  if(!reply) reconnectRedis(c, true);
+
+  return(reply);
+}
+
+/* **************************************** */
+
+/*
+  Reads the num_replies replies of the commands appended with redisAppendCommand*,
+  that is, of a pipeline. Replies are returned in replies, which the caller must free.
+  Returns the number of replies read: when smaller than num_replies, the connection
+  has been restored and the missing replies are NULL.
+*/
+u_int Redis::readPipelineReplies(RedisConnection *c, const struct timeval *begin,
+				 u_int num_replies, redisReply **replies) {
+  u_int i;
+
+  for(i = 0; i < num_replies; i++) {
+    void *reply = NULL;
+
+    if(redisGetReply(c->redis, &reply) != REDIS_OK)
+      break;
+
+    replies[i] = (redisReply*)reply;
+  }
+
+  updateLatency(c, redis_cmd_pipeline, begin);
+
+  if(i < num_replies) {
+    for(u_int j = i; j < num_replies; j++) replies[j] = NULL;
+    reconnectRedis(c, true);
+  }
+
+  return(i);
+}
+
+/* **************************************** */
+
+/*
+  Must be called with the connection locked (or from the constructor).
+  Only the state of this connection changes: the others keep serving
+  their threads.
+*/
+void Redis::reconnectRedis(RedisConnection *c, bool giveup_on_failure) {
   struct timeval timeout = { 1, 500000 }; // 1.5 seconds
   redisReply *reply = NULL;
   u_int num_attempts;
-  bool connected;
+  bool connected = false;
 
-  operational = connected = false;
+  if(c->connected)
+    c->connected = false, num_connected--;
 
   for(num_attempts = CONST_MAX_REDIS_CONN_RETRIES; num_attempts > 0; num_attempts--) {
-    if(redis) {
-      ntop->getTrace()->traceEvent(TRACE_NORMAL, "Redis has disconnected, reconnecting [remaining attempts: %u]",
-				   num_attempts - 1);
-      redisFree(redis);
+    if(c->redis) {
+      ntop->getTrace()->traceEvent(TRACE_NORMAL, "Redis has disconnected, reconnecting [connection: %u][remaining attempts: %u]",
+				   c->id, num_attempts - 1);
+      redisFree(c->redis);
     }
 
 #ifdef __linux__
     struct stat buf;
 
     if(!stat(redis_host, &buf) && S_ISSOCK(buf.st_mode))
-      redis = redisConnectUnixWithTimeout(redis_host, timeout), is_socket_connection = true;
+      c->redis = redisConnectUnixWithTimeout(redis_host, timeout), is_socket_connection = true;
     else
 #endif
-      redis = redisConnectWithTimeout(redis_host, redis_port, timeout);
+      c->redis = redisConnectWithTimeout(redis_host, redis_port, timeout);
 
-    if(redis == NULL || redis->err) {
-      if(redis)
-	ntop->getTrace()->traceEvent(TRACE_ERROR, "Connection error [%s]", redis->errstr);
+    if(c->redis == NULL || c->redis->err) {
+      if(c->redis)
+	ntop->getTrace()->traceEvent(TRACE_ERROR, "Connection error [%s]", c->redis->errstr);
 
       goto conn_retry;
     }
 
     if(redis_password) {
       stats.num_other++;
-      reply = (redisReply*)redisCommand(redis, "AUTH %s", redis_password);
+      reply = (redisReply*)redisCommand(c->redis, "AUTH %s", redis_password);
       if(reply && (reply->type == REDIS_REPLY_ERROR)) {
 	ntop->getTrace()->traceEvent(TRACE_ERROR,
 				     "Redis authentication failed: %s", reply->str ? reply->str : "???");
@@ -114,7 +271,7 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
 
     if(reply) freeReplyObject(reply);
     stats.num_other++;
-    reply = (redisReply*)redisCommand(redis, "PING");
+    reply = (redisReply*)redisCommand(c->redis, "PING");
     if(reply && (reply->type == REDIS_REPLY_ERROR)) {
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -123,7 +280,7 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
 
     if(reply) freeReplyObject(reply);
     stats.num_other++;
-    reply = (redisReply*)redisCommand(redis, "SELECT %u", redis_db_id);
+    reply = (redisReply*)redisCommand(c->redis, "SELECT %u", redis_db_id);
     if(reply && (reply->type == REDIS_REPLY_ERROR)) {
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -135,10 +292,8 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
     break;
 
   conn_retry:
-    if(giveup_on_failure) {
-      operational = false;
+    if(giveup_on_failure)
       return;
-    }
     
     sleep(1);
   }
@@ -155,38 +310,40 @@ void Redis::reconnectRedis(bool giveup_on_failure) {
 #ifdef __linux__
   if(!is_socket_connection)
     ntop->getTrace()->traceEvent(TRACE_NORMAL,
-				 "Successfully connected to redis %s:%u@%u",
-				 redis_host, redis_port, redis_db_id);
+				 "Successfully connected to redis %s:%u@%u [connection: %u]",
+				 redis_host, redis_port, redis_db_id, c->id);
   else
 #endif
     ntop->getTrace()->traceEvent(TRACE_NORMAL,
-				 "Successfully connected to redis %s@%u",
-				 redis_host, redis_db_id);
+				 "Successfully connected to redis %s@%u [connection: %u]",
+				 redis_host, redis_db_id, c->id);
 
   stats.num_reconnections++;
-  operational = true;
+  c->connected = true, num_connected++;
 }
 
 /* **************************************** */
 
 int Redis::expire(char *key, u_int expire_secs) {
   int rc;
+  bool cached;
   redisReply *reply;
+  RedisConnection *c;
 
   l->lock(__FILE__, __LINE__);
+  cached = expireCache(key, expire_secs);
+  l->unlock(__FILE__, __LINE__);
 
-  if(expireCache(key, expire_secs)) {
-    l->unlock(__FILE__, __LINE__);
+  if(cached)
     return(0);
-  }
 
+  c = getConnection();
   stats.num_expire++;
-  reply = (redisReply*)redisCommand(redis, "EXPIRE %s %u", key, expire_secs);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_expire, "EXPIRE %s %u", key, expire_secs);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
   if(reply) freeReplyObject(reply), rc = 0; else rc = -1;
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -221,8 +378,8 @@ bool Redis::expireCache(char *key, u_int expire_secs) {
 
 /* **************************************** */
 
-void Redis::checkDumpable(const char * const key) {
-  if(!initializationCompleted) return;
+bool Redis::checkDumpable(const char * const key) {
+  if(!initializationCompleted) return(false);
 
   /* We use this function to check and possibly request a preference dump to a file.
      This ensures settings persistance also upon redis flushes */
@@ -231,7 +388,10 @@ void Redis::checkDumpable(const char * const key) {
     /* Tell housekeeping.lua to refresh in-memory prefs (and possibly dump them to runtimeprefs.json) */
     ntop->getRedis()->set((char*)PREFS_CHANGED, "1");
     // ntop->getTrace()->traceEvent(TRACE_NORMAL, "Going to refresh after change of: %s", key);
+    return(true);
   }
+
+  return(false);
 }
 
 /* **************************************** */
@@ -240,10 +400,9 @@ int Redis::info(char *rsp, u_int rsp_len) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "INFO");
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_other, "INFO");
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -252,7 +411,7 @@ int Redis::info(char *rsp, u_int rsp_len) {
   } else
     rsp[0] = 0, rc = -1;
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -263,12 +422,11 @@ u_int Redis::dbsize() {
   redisReply *reply;
   u_int num = 0;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
 
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "DBSIZE");
+  reply = command(c, redis_cmd_other, "DBSIZE");
 
-  if(!reply) reconnectRedis(true);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -276,7 +434,7 @@ u_int Redis::dbsize() {
       num = (u_int)reply->integer;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -284,8 +442,8 @@ u_int Redis::dbsize() {
 
 /* **************************************** */
 
-/* NOTE: We assume that the addToCache() caller locks this instance */
-void Redis::addToCache(const char * const key, const char * const value, u_int expire_secs) {
+/* NOTE: We assume that the addToCache() caller holds the cache lock (l) */
+void Redis::addToCache(const char * const key, const char * const value, u_int expire_secs, bool replace) {
   std::map<std::string, StringCache>::iterator it;
   if(!initializationCompleted) return;
 
@@ -296,6 +454,8 @@ void Redis::addToCache(const char * const key, const char * const value, u_int e
   if((it = stringCache.find(key)) != stringCache.end()) {
     StringCache *cached = &it->second;
 
+    if(!replace) return;
+
     cached->value = value;
     cached->expire = expire_secs ? time(NULL)+expire_secs : 0;
     return;
@@ -315,10 +475,13 @@ void Redis::addToCache(const char * const key, const char * const value, u_int e
 int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
   int rc;
   bool cacheable = false;
-  redisReply *reply;
+  redisReply *reply, *replies[2] = { NULL, NULL };
+  RedisConnection *c;
   std::map<std::string, StringCache>::iterator it;
+  u_int64_t version;
 
   l->lock(__FILE__, __LINE__);
+  version = cache_version;
 
   if((it = stringCache.find(key)) != stringCache.end()) {
     StringCache *cached = &it->second;
@@ -344,13 +507,31 @@ int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
 #endif
   }
 
+  l->unlock(__FILE__, __LINE__);
+
+  cacheable = isCacheable(key);
+  c = getConnection();
   stats.num_get++;
-  reply = (redisReply*)redisCommand(redis, "GET %s", key);
-  if(!reply) reconnectRedis(true);
+
+  if(cache_it || cacheable) {
+    /* The TTL is needed to cache the value: send it along with the GET in a single round-trip */
+    struct timeval begin;
+
+    stats.num_ttl++;
+    gettimeofday(&begin, NULL);
+
+    if(appendCommand(c, "GET %s", key) && appendCommand(c, "TTL %s", key))
+      readPipelineReplies(c, &begin, 2, replies);
+    else
+      reconnectRedis(c, true);
+
+    reply = replies[0];
+  } else
+    reply = command(c, redis_cmd_get, "GET %s", key);
+
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
-  cacheable = isCacheable(key);
   if(reply && reply->str) {
     snprintf(rsp, rsp_len, "%s", reply->str), rc = 0;
   } else
@@ -359,25 +540,30 @@ int Redis::get(char *key, char *rsp, u_int rsp_len, bool cache_it) {
   if(cache_it || cacheable) {
     u_int expire_sec = 0;
 
-    if(reply) freeReplyObject(reply);
-    stats.num_ttl++;
-    reply = (redisReply*)redisCommand(redis, "TTL %s", key);
-    if(!reply) reconnectRedis(true);
-    if(reply && (reply->type != REDIS_REPLY_INTEGER))
-      ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
+    if(replies[1] && (replies[1]->type != REDIS_REPLY_INTEGER))
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", replies[1]->str ? replies[1]->str : "???");
 
-    if(reply && (((int32_t)reply->integer)) >= 0)
-      expire_sec = reply->integer;
+    if(replies[1] && (((int32_t)replies[1]->integer)) >= 0)
+      expire_sec = replies[1]->integer;
 
 #ifdef CACHE_DEBUG
     printf("**** ADD TO CACHE %s=%s [expire_sec=%u]\n", key, rsp, expire_sec);
 #endif
 
-    addToCache(key, rsp, expire_sec);
+    /*
+      Do not override a value set meanwhile by another thread, nor
+      resurrect a key deleted while the GET was in flight
+    */
+    l->lock(__FILE__, __LINE__);
+    if(version == cache_version)
+      addToCache(key, rsp, expire_sec, false);
+    l->unlock(__FILE__, __LINE__);
+
+    if(replies[1]) freeReplyObject(replies[1]);
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(cacheable && (rc == -1)) {
     /* Don't fill redis with default empty strings.
@@ -397,13 +583,16 @@ int Redis::del(char *key){
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c;
 
+  l->lock(__FILE__, __LINE__);
   stringCache.erase(key);
+  cache_version++;
+  l->unlock(__FILE__, __LINE__);
 
+  c = getConnection();
   stats.num_del++;
-  reply = (redisReply*)redisCommand(redis, "DEL %s", key);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_del, "DEL %s", key);
   if(reply && (reply->type == REDIS_REPLY_ERROR)){
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
     rc = -1;
@@ -412,7 +601,7 @@ int Redis::del(char *key){
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(reply) checkDumpable(key);
 
@@ -425,10 +614,9 @@ int Redis::hashGet(const char * const key, const char * const field, char * cons
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_hget++;
-  reply = (redisReply*)redisCommand(redis, "HGET %s %s", key, field);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_hash, "HGET %s %s", key, field);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "failure on HGET %s %s (%s)", key, field, reply->str ? reply->str : "???");
 
@@ -437,7 +625,7 @@ int Redis::hashGet(const char * const key, const char * const field, char * cons
   } else
     rsp[0] = 0, rc = -1;
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -448,14 +636,13 @@ int Redis::hashSet(const char * const key, const char * const field, const char
   int rc = 0;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_hset++;
-  reply = (redisReply*)redisCommand(redis, "HSET %s %s %s", key, field, value);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_hash, "HSET %s %s %s", key, field, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [HSET %s %s %s]", reply->str ? reply->str : "???", key, field, value), rc = -1;
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(reply) checkDumpable(key);
 
@@ -468,10 +655,9 @@ int Redis::hashDel(const char * const key, const char * const field) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_hdel++;
-  reply = (redisReply*)redisCommand(redis, "HDEL %s %s", key, field);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_hash, "HDEL %s %s", key, field);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -479,7 +665,7 @@ int Redis::hashDel(const char * const key, const char * const field) {
     freeReplyObject(reply), rc = 0;
   } else
     rc = -1;
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(reply) checkDumpable(key);
 
@@ -491,6 +677,7 @@ int Redis::hashDel(const char * const key, const char * const field) {
 int Redis::_set(bool use_nx, const char * const key, const char * const value, u_int expire_secs) {
   int rc, ret_code = 0;
   redisReply *reply;
+  RedisConnection *c;
   const char* cmd = use_nx ? "SETNX" : "SET";
     
   if((value == NULL) || (value[0] == '\0')) {    
@@ -499,15 +686,45 @@ int Redis::_set(bool use_nx, const char * const key, const char * const value, u
       ntop->getTrace()->traceEvent(TRACE_WARNING, "Discarding empty prefence value %s", key);
     }
   }
-  
-  l->lock(__FILE__, __LINE__);
 
-  if(isCacheable(key))
+  if(isCacheable(key)) {
+    l->lock(__FILE__, __LINE__);
     addToCache(key, value, expire_secs);
+    l->unlock(__FILE__, __LINE__);
+  }
 
+  c = getConnection();
   stats.num_set++;
-  reply = (redisReply*)redisCommand(redis, "%s %s %s", cmd, key, value);
-  if(!reply) reconnectRedis(true);
+
+  if((!use_nx) && (expire_secs != 0)) {
+    /* SET and EXPIRE in a single round-trip */
+    redisReply *replies[2] = { NULL, NULL };
+    struct timeval begin;
+
+    stats.num_expire++;
+    gettimeofday(&begin, NULL);
+
+    if(appendCommand(c, "SET %s %s", key, value) && appendCommand(c, "EXPIRE %s %u", key, expire_secs))
+      readPipelineReplies(c, &begin, 2, replies);
+    else
+      reconnectRedis(c, true);
+
+    rc = (replies[0] && replies[1]) ? 0 : -1;
+
+    for(int i = 0; i < 2; i++) {
+      if(replies[i]) {
+	if(replies[i]->type == REDIS_REPLY_ERROR)
+	  ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", replies[i]->str ? replies[i]->str : "???");
+
+	freeReplyObject(replies[i]);
+      }
+    }
+
+    releaseConnection(c);
+    return(rc);
+  }
+
+  reply = command(c, redis_cmd_set, "%s %s %s", cmd, key, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
   if(reply) {
@@ -520,17 +737,14 @@ int Redis::_set(bool use_nx, const char * const key, const char * const value, u
   } else
     rc = -1;
 
-  if((expire_secs != 0)
-     && ((use_nx && (ret_code == 1))
-	 || ((!use_nx) && (rc == 0)))) {
+  if((expire_secs != 0) && (ret_code == 1) /* SETNX */) {
     stats.num_expire++;
-    reply = (redisReply*)redisCommand(redis, "EXPIRE %s %u", key, expire_secs);
-    if(!reply) reconnectRedis(true);
+    reply = command(c, redis_cmd_expire, "EXPIRE %s %u", key, expire_secs);
     if(reply && (reply->type == REDIS_REPLY_ERROR))
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
     if(reply) freeReplyObject(reply), rc = 0; else rc = -1;
   }
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(reply && expire_secs == 0)
     checkDumpable(key);
@@ -543,15 +757,84 @@ int Redis::_set(bool use_nx, const char * const key, const char * const value, u
 
 /* **************************************** */
 
+/* NOTE: upon success, the returned value must be freed by the caller */
+int Redis::getBinary(const char * const key, char **value, u_int32_t *value_len, u_int32_t max_len) {
+  redisReply *reply;
+  RedisConnection *c;
+  int rc = -1;
+
+  *value = NULL, *value_len = 0;
+
+  c = getConnection();
+  stats.num_get++;
+
+  reply = command(c, redis_cmd_get, "GET %s", key);
+
+  if(reply && (reply->type == REDIS_REPLY_ERROR))
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
+  else if(reply && (reply->type == REDIS_REPLY_STRING) && (reply->len > 0)) {
+    if((u_int32_t)reply->len >= max_len)
+      ntop->getTrace()->traceEvent(TRACE_WARNING, "Value too long [%s][%u bytes]", key, (u_int32_t)reply->len);
+    else if((*value = (char*)malloc(reply->len + 1)) != NULL) {
+      memcpy(*value, reply->str, reply->len);
+      (*value)[reply->len] = '\0';
+      *value_len = reply->len, rc = 0;
+    }
+  }
+
+  if(reply) freeReplyObject(reply);
+  releaseConnection(c);
+
+  return(rc);
+}
+
+/* **************************************** */
+
+int Redis::setBinary(const char * const key, const char * const value, u_int32_t value_len, u_int expire_secs) {
+  redisReply *replies[2] = { NULL, NULL };
+  u_int num_replies = expire_secs ? 2 : 1;
+  RedisConnection *c;
+  struct timeval begin;
+  int rc;
+
+  c = getConnection();
+  stats.num_set++;
+  if(expire_secs) stats.num_expire++;
+
+  /* SET and EXPIRE in a single round-trip */
+  gettimeofday(&begin, NULL);
+
+  if(appendCommand(c, "SET %s %b", key, value, (size_t)value_len)
+     && ((expire_secs == 0) || appendCommand(c, "EXPIRE %s %u", key, expire_secs)))
+    readPipelineReplies(c, &begin, num_replies, replies);
+  else
+    reconnectRedis(c, true);
+
+  rc = (replies[0] && ((expire_secs == 0) || replies[1])) ? 0 : -1;
+
+  for(u_int i = 0; i < num_replies; i++) {
+    if(replies[i]) {
+      if(replies[i]->type == REDIS_REPLY_ERROR)
+	ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", replies[i]->str ? replies[i]->str : "???"), rc = -1;
+
+      freeReplyObject(replies[i]);
+    }
+  }
+
+  releaseConnection(c);
+  return(rc);
+}
+
+/* **************************************** */
+
 int Redis::keys(const char *pattern, char ***keys_p) {
   int rc = 0;
   u_int i;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_keys++;
-  reply = (redisReply*)redisCommand(redis, "KEYS %s", pattern);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_keys, "KEYS %s", pattern);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -565,7 +848,7 @@ int Redis::keys(const char *pattern, char ***keys_p) {
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -577,10 +860,9 @@ int Redis::hashKeys(const char *pattern, char ***keys_p) {
   u_int i;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_hkeys++;
-  reply = (redisReply*)redisCommand(redis, "HKEYS %s", pattern);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_hash, "HKEYS %s", pattern);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [HKEYS %s]", reply->str ? reply->str : "???", pattern);
 
@@ -599,7 +881,7 @@ int Redis::hashKeys(const char *pattern, char ***keys_p) {
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -611,10 +893,9 @@ int Redis::hashGetAll(const char *key, char ***keys_p, char ***values_p) {
   int i, j;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_hgetall++;
-  reply = (redisReply*)redisCommand(redis, "HGETALL %s", key);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_hash, "HGETALL %s", key);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [HGETALL %s]", reply->str ? reply->str : "???", key);
 
@@ -643,7 +924,7 @@ int Redis::hashGetAll(const char *key, char ***keys_p, char ***values_p) {
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -664,7 +945,7 @@ int Redis::pushHostToResolve(char *hostname, bool dont_check_for_existence, bool
 
   snprintf(key, sizeof(key), "%s.%s", DNS_CACHE, hostname);
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
 
   if(dont_check_for_existence)
     found = false;
@@ -674,8 +955,7 @@ int Redis::pushHostToResolve(char *hostname, bool dont_check_for_existence, bool
     */
 
     stats.num_get++;
-    reply = (redisReply*)redisCommand(redis, "GET %s", key);
-    if(!reply) reconnectRedis(true);
+    reply = command(c, redis_cmd_get, "GET %s", key);
 
     if(reply && (reply->type == REDIS_REPLY_ERROR))
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -691,7 +971,7 @@ int Redis::pushHostToResolve(char *hostname, bool dont_check_for_existence, bool
       rc = -1;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(!found) {
     /* Add to the list of addresses to resolve */
@@ -762,16 +1042,15 @@ int Redis::flushDb() {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
 
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "FLUSHDB");
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_other, "FLUSHDB");
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
   if(reply) freeReplyObject(reply), rc = 0; else rc = -1;
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if (rc == 0) {
     flushCache();
@@ -810,11 +1089,12 @@ int Redis::getAddress(char *numeric_ip, char *rsp,
       pushHostToResolve(numeric_ip, true, false);
     }
   } else {
-    /* We need to extend expire */
     if(!already_in_bloom)
       ntop->getResolutionBloom()->setBit(numeric_ip); /* Previously cached ? */
-    
-    expire(key, DNS_CACHE_DURATION /* expire */);
+
+    /* We need to extend expire, unless this is a failed resolution that must be retried eventually */
+    if(strcmp(rsp, numeric_ip))
+      expire(key, DNS_CACHE_DURATION /* expire */);
   }
 
   return(rc);
@@ -822,7 +1102,7 @@ int Redis::getAddress(char *numeric_ip, char *rsp,
 
 /* **************************************** */
 
-int Redis::setResolvedAddress(char *numeric_ip, char *symbolic_ip) {
+int Redis::setResolvedAddress(char *numeric_ip, char *symbolic_ip, u_int expire_secs) {
   char key[CONST_MAX_LEN_REDIS_KEY], numeric[256], *w, *h;
   int rc = 0;
 
@@ -839,7 +1119,7 @@ int Redis::setResolvedAddress(char *numeric_ip, char *symbolic_ip) {
   while(h != NULL) {
     snprintf(key, sizeof(key), "%s.%s", DNS_CACHE, h);
     ntop->getResolutionBloom()->setBit(h);
-    rc = set(key, symbolic_ip, DNS_CACHE_DURATION);
+    rc = set(key, symbolic_ip, expire_secs);
     h = strtok_r(NULL, ";", &w);
   }
 
@@ -851,12 +1131,11 @@ int Redis::setResolvedAddress(char *numeric_ip, char *symbolic_ip) {
 char* Redis::getRedisVersion() {
   redisReply *reply;
   char str[32];
-  int a, b, c;
+  int a, b, d;
   
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "INFO");
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_other, "INFO");
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -881,10 +1160,10 @@ char* Redis::getRedisVersion() {
     freeReplyObject(reply);
   }
   
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
   redis_version = strdup(str);
-  sscanf(redis_version, "%d.%d.%d", &a, &b, &c);
-  num_redis_version = (a << 16) + (b << 8) + c;
+  sscanf(redis_version, "%d.%d.%d", &a, &b, &d);
+  num_redis_version = (a << 16) + (b << 8) + d;
 
   return(redis_version);
 }
@@ -913,10 +1192,9 @@ int Redis::smembers(lua_State* vm, char *setName) {
 
   lua_newtable(vm);
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "SMEMBERS %s", setName);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_other, "SMEMBERS %s", setName);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -933,7 +1211,7 @@ int Redis::smembers(lua_State* vm, char *setName) {
     rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -945,11 +1223,10 @@ int Redis::smembers(const char *set_name, char ***members) {
   u_int i;
   redisReply *reply = NULL;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "SMEMBERS %s", set_name);
+  reply = command(c, redis_cmd_other, "SMEMBERS %s", set_name);
 
-  if(!reply) reconnectRedis(true);
 
   if(reply && (reply->type == REDIS_REPLY_ERROR)) {
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [SMEMBERS %s]", reply->str ? reply->str : "???", set_name);
@@ -972,7 +1249,7 @@ int Redis::smembers(const char *set_name, char ***members) {
 
  out:
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -1008,11 +1285,10 @@ int Redis::msg_push(const char * const cmd, const char * const queue_name, const
   gettimeofday(&begin, NULL);
 #endif
 
-  l->lock(__FILE__, __LINE__, trace_errors);
+  RedisConnection *c = getConnection(trace_errors);
   /* Put the latest messages on top so old messages (if any) will be discarded */
-  reply = (redisReply*)redisCommand(redis, "%s %s %s", cmd,  queue_name, msg);
+  reply = command(c, redis_cmd_list, "%s %s %s", cmd,  queue_name, msg);
 
-  if(!reply) reconnectRedis(true);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR && trace_errors)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???"), rc = -1;
@@ -1035,10 +1311,9 @@ int Redis::msg_push(const char * const cmd, const char * const queue_name, const
     if(queue_trim_size > 0) {
       stats.num_trim++;
       if(head_trim)
-        reply = (redisReply*)redisCommand(redis, "LTRIM %s 0 %u", queue_name, queue_trim_size - 1);
+        reply = command(c, redis_cmd_list, "LTRIM %s 0 %u", queue_name, queue_trim_size - 1);
       else
-        reply = (redisReply*)redisCommand(redis, "LTRIM %s -%u -1", queue_name, queue_trim_size);
-      if(!reply) reconnectRedis(true);
+        reply = command(c, redis_cmd_list, "LTRIM %s -%u -1", queue_name, queue_trim_size);
       if(reply) {
 	if(reply->type == REDIS_REPLY_ERROR && trace_errors)
 	  ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???"), rc = -1;
@@ -1050,7 +1325,7 @@ int Redis::msg_push(const char * const cmd, const char * const queue_name, const
   } else
     rc = -1;
 
-  l->unlock(__FILE__, __LINE__, trace_errors);
+  releaseConnection(c, trace_errors);
   return(rc);
 }
 
@@ -1060,12 +1335,11 @@ u_int Redis::len(const char * const key) {
   redisReply *reply;
   u_int num = 0;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
 
   stats.num_strlen++;
-  reply = (redisReply*)redisCommand(redis, "STRLEN %s", key);
+  reply = command(c, redis_cmd_other, "STRLEN %s", key);
 
-  if(!reply) reconnectRedis(true);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1073,7 +1347,7 @@ u_int Redis::len(const char * const key) {
       num = (u_int)reply->integer;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1086,12 +1360,11 @@ u_int Redis::hstrlen(const char * const key, const char * const value) {
   redisReply *reply;
   u_int num = 0;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
 
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "HSTRLEN %s %s", key, value);
+  reply = command(c, redis_cmd_hash, "HSTRLEN %s %s", key, value);
 
-  if(!reply) reconnectRedis(true);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1099,7 +1372,7 @@ u_int Redis::hstrlen(const char * const key, const char * const value) {
       num = (u_int)reply->integer;
   }
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1113,17 +1386,16 @@ u_int Redis::llen(const char *queue_name) {
   redisReply *reply;
   u_int num = 0;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_llen++;
-  reply = (redisReply*)redisCommand(redis, "LLEN %s", queue_name);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_list, "LLEN %s", queue_name);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
     else
       num = (u_int)reply->integer;
   }
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1134,14 +1406,13 @@ u_int Redis::llen(const char *queue_name) {
 int Redis::lset(const char *queue_name, u_int32_t idx, const char *value) {
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LSET %s %u %s", queue_name, idx, value);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_list, "LSET %s %u %s", queue_name, idx, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(reply) freeReplyObject(reply);
 
@@ -1153,14 +1424,13 @@ int Redis::lset(const char *queue_name, u_int32_t idx, const char *value) {
 int Redis::lrem(const char *queue_name, const char *value) {
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LREM %s 0 %s", queue_name, value);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_list, "LREM %s 0 %s", queue_name, value);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   if(reply) freeReplyObject(reply);
 
@@ -1173,10 +1443,9 @@ int Redis::lrpop(const char *queue_name, char *buf, u_int buf_len, bool lpop) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_lpop_rpop++;
-  reply = (redisReply*)redisCommand(redis, "%sPOP %s", lpop ? "L" : "R", queue_name);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_list, "%sPOP %s", lpop ? "L" : "R", queue_name);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -1186,7 +1455,7 @@ int Redis::lrpop(const char *queue_name, char *buf, u_int buf_len, bool lpop) {
     buf[0] = '\0', rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -1209,11 +1478,10 @@ int Redis::lindex(const char *queue_name, int idx, char *buf, u_int buf_len) {
   int rc;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LINDEX %s %d", queue_name, idx);
+  reply = command(c, redis_cmd_list, "LINDEX %s %d", queue_name, idx);
 
-  if(!reply) reconnectRedis(true);
 
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1224,7 +1492,7 @@ int Redis::lindex(const char *queue_name, int idx, char *buf, u_int buf_len) {
     buf[0] = '\0', rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -1236,11 +1504,10 @@ int Redis::lrange(const char *list_name, char ***elements, int start_offset, int
   u_int i;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "LRANGE %s %i %i", list_name, start_offset, end_offset);
+  reply = command(c, redis_cmd_list, "LRANGE %s %i %i", list_name, start_offset, end_offset);
 
-  if(!reply) reconnectRedis(true);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -1254,7 +1521,7 @@ int Redis::lrange(const char *list_name, char ***elements, int start_offset, int
   }
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -1265,16 +1532,15 @@ int Redis::ltrim(const char *queue_name, int start_idx, int end_idx) {
   int rc = 0;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
 
-  reply = (redisReply*)redisCommand(redis, "LTRIM %s %d %d", queue_name, start_idx, end_idx);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_list, "LTRIM %s %d %d", queue_name, start_idx, end_idx);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     rc = -1, ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rc);
 }
@@ -1285,10 +1551,9 @@ int Redis::incr(const char *key, int amount) {
   redisReply *reply;
   int num = 0;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "INCRBY %s %d", key, amount);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_other, "INCRBY %s %d", key, amount);
   if(reply) {
     if(reply->type == REDIS_REPLY_ERROR)
       ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1299,11 +1564,13 @@ int Redis::incr(const char *key, int amount) {
         char value[64];
 
         snprintf(value, sizeof(value), "%d", num);
+        l->lock(__FILE__, __LINE__);
         addToCache(key, value, 0);
+        l->unlock(__FILE__, __LINE__);
       }
     }
   }
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
   if(reply) freeReplyObject(reply);
 
   return(num);
@@ -1311,6 +1578,158 @@ int Redis::incr(const char *key, int amount) {
 
 /* **************************************** */
 
+/* Must be called with the connection locked */
+bool Redis::appendCommand(RedisConnection *c, const char *format, ...) {
+  va_list ap;
+  int rc;
+
+  if(!c->redis) return(false);
+
+  va_start(ap, format);
+  rc = redisvAppendCommand(c->redis, format, ap);
+  va_end(ap);
+
+  return(rc == REDIS_OK);
+}
+
+/* **************************************** */
+
+/*
+  Reads num_keys keys with a single MGET. values[i] is set to a copy of the
+  value of keys[i], or to NULL when the key does not exist: the caller must
+  free the copies. Returns the number of keys found, or -1 upon error.
+*/
+int Redis::mget(u_int num_keys, const char * const *keys, char **values) {
+  const char **argv;
+  size_t *argvlen;
+  redisReply *reply;
+  RedisConnection *c;
+  int rc = -1;
+
+  for(u_int i = 0; i < num_keys; i++) values[i] = NULL;
+
+  if(num_keys == 0) return(0);
+
+  argv = (const char**)malloc((num_keys + 1) * sizeof(char*));
+  argvlen = (size_t*)malloc((num_keys + 1) * sizeof(size_t));
+
+  if(!argv || !argvlen) {
+    if(argv) free(argv);
+    if(argvlen) free(argvlen);
+    return(-1);
+  }
+
+  argv[0] = "MGET", argvlen[0] = 4;
+  for(u_int i = 0; i < num_keys; i++)
+    argv[i + 1] = keys[i], argvlen[i + 1] = strlen(keys[i]);
+
+  c = getConnection();
+  stats.num_get += num_keys;
+  reply = commandArgv(c, redis_cmd_get, num_keys + 1, argv, argvlen);
+
+  if(reply && (reply->type == REDIS_REPLY_ERROR))
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [MGET]", reply->str ? reply->str : "???");
+  else if(reply && (reply->type == REDIS_REPLY_ARRAY) && (reply->elements == num_keys)) {
+    rc = 0;
+
+    for(u_int i = 0; i < num_keys; i++) {
+      if(reply->element[i]->str && ((values[i] = strdup(reply->element[i]->str)) != NULL))
+	rc++;
+    }
+  }
+
+  if(reply) freeReplyObject(reply);
+  releaseConnection(c);
+
+  free(argv);
+  free(argvlen);
+
+  return(rc);
+}
+
+/* **************************************** */
+
+/*
+  Sets num_keys keys, each one with an optional expiration, pipelining the
+  commands so that the whole batch costs a single round-trip.
+  Returns the number of keys set, or -1 upon error.
+*/
+int Redis::mset(u_int num_keys, const char * const *keys, const char * const *values, u_int expire_secs,
+		const u_int32_t *values_len) {
+  u_int cmds_per_key = expire_secs ? 2 : 1, num_replies = num_keys * cmds_per_key;
+  redisReply **replies;
+  RedisConnection *c;
+  struct timeval begin;
+  bool appended = true;
+  int rc = 0;
+
+  if(num_keys == 0) return(0);
+
+  if((replies = (redisReply**)calloc(num_replies, sizeof(redisReply*))) == NULL)
+    return(-1);
+
+  if(!values_len) {
+    l->lock(__FILE__, __LINE__);
+    for(u_int i = 0; i < num_keys; i++) {
+      if(isCacheable(keys[i]))
+	addToCache(keys[i], values[i], expire_secs);
+    }
+    l->unlock(__FILE__, __LINE__);
+  }
+
+  c = getConnection();
+  stats.num_set += num_keys;
+  if(expire_secs) stats.num_expire += num_keys;
+
+  gettimeofday(&begin, NULL);
+
+  for(u_int i = 0; appended && (i < num_keys); i++) {
+    if(values_len)
+      appended = appendCommand(c, "SET %s %b", keys[i], values[i], (size_t)values_len[i]);
+    else
+      appended = appendCommand(c, "SET %s %s", keys[i], values[i]);
+
+    if(appended && expire_secs)
+      appended = appendCommand(c, "EXPIRE %s %u", keys[i], expire_secs);
+  }
+
+  if(appended)
+    readPipelineReplies(c, &begin, num_replies, replies);
+  else
+    reconnectRedis(c, true), rc = -1;
+
+  releaseConnection(c);
+
+  for(u_int i = 0; i < num_keys; i++) {
+    bool ok = true;
+
+    for(u_int j = i * cmds_per_key; j < (i + 1) * cmds_per_key; j++) {
+      if(!replies[j])
+	ok = false;
+      else {
+	if(replies[j]->type == REDIS_REPLY_ERROR)
+	  ntop->getTrace()->traceEvent(TRACE_ERROR, "%s [SET %s]", replies[j]->str ? replies[j]->str : "???", keys[i]), ok = false;
+
+	freeReplyObject(replies[j]);
+      }
+    }
+
+    if(ok && (rc >= 0)) rc++;
+  }
+
+  free(replies);
+
+  if(expire_secs == 0) {
+    /* A single preferences refresh for the whole batch */
+    for(u_int i = 0; i < num_keys; i++)
+      if(checkDumpable(keys[i])) break;
+  }
+
+  return(rc);
+}
+
+/* **************************************** */
+
 void Redis::lua(lua_State *vm) {
   lua_newtable(vm);
 
@@ -1338,6 +1757,49 @@ void Redis::lua(lua_State *vm) {
   lua_push_uint64_table_entry(vm, "num_resolver_saved_lookups", stats.num_saved_lookups);
   lua_push_uint64_table_entry(vm, "num_resolver_get_address",   stats.num_get_address);
   lua_push_uint64_table_entry(vm, "num_resolver_set_address",   stats.num_set_resolved_address);  
+
+  /* Connection pool */
+  lua_push_uint64_table_entry(vm, "num_connections", pool_size);
+
+  lua_newtable(vm);
+
+  for(int t = 0; t < redis_cmd_max; t++) {
+    u_int64_t num_commands = 0, tot_usec = 0, histogram[REDIS_LATENCY_HISTOGRAM_SLOTS];
+    u_int32_t max_usec = 0;
+
+    memset(histogram, 0, sizeof(histogram));
+
+    for(u_int8_t i = 0; i < pool_size; i++) {
+      num_commands += pool[i].num_commands[t], tot_usec += pool[i].tot_usec[t];
+      if(pool[i].max_usec[t] > max_usec) max_usec = pool[i].max_usec[t];
+
+      for(u_int j = 0; j < REDIS_LATENCY_HISTOGRAM_SLOTS; j++)
+	histogram[j] += pool[i].latency_histogram[t][j];
+    }
+
+    lua_newtable(vm);
+    lua_push_uint64_table_entry(vm, "num_commands", num_commands);
+    lua_push_float_table_entry(vm, "avg_usec", num_commands ? ((float)tot_usec) / num_commands : 0);
+    lua_push_uint64_table_entry(vm, "max_usec", max_usec);
+
+    /* Entry i counts the commands that took less than 2^(i-1) usec */
+    lua_newtable(vm);
+    for(u_int j = 0; j < REDIS_LATENCY_HISTOGRAM_SLOTS; j++) {
+      lua_pushinteger(vm, histogram[j]);
+      lua_rawseti(vm, -2, j + 1);
+    }
+    lua_pushstring(vm, "usec_histogram");
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+
+    lua_pushstring(vm, redis_cmd_names[t]);
+    lua_insert(vm, -2);
+    lua_settable(vm, -3);
+  }
+
+  lua_pushstring(vm, "latency");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
 }
 
 /* **************************************** */
@@ -1345,6 +1807,7 @@ void Redis::lua(lua_State *vm) {
 void Redis::flushCache() {
   l->lock(__FILE__, __LINE__);
   stringCache.clear();
+  cache_version++;
   l->unlock(__FILE__, __LINE__);
 
 #ifdef CACHE_DEBUG
@@ -1390,10 +1853,9 @@ char* Redis::dump(char *key) {
   char *rsp = NULL;
   redisReply *reply;
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_other++;
-  reply = (redisReply*)redisCommand(redis, "DUMP %s", key);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_other, "DUMP %s", key);
   if(reply && (reply->type == REDIS_REPLY_ERROR))
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
 
@@ -1404,7 +1866,7 @@ char* Redis::dump(char *key) {
     freeReplyObject(reply);
   }
 
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   return(rsp);
 }
@@ -1423,12 +1885,11 @@ int Redis::restore(char *key, char *buf) {
 
   hex2bin(buf, buf_bin);
 
-  l->lock(__FILE__, __LINE__);
+  RedisConnection *c = getConnection();
   stats.num_del++;
 
   /* Delete the key first */
-  reply = (redisReply*)redisCommand(redis, "DEL %s", key);
-  if(!reply) reconnectRedis(true);
+  reply = command(c, redis_cmd_del, "DEL %s", key);
 
   if(reply && (reply->type == REDIS_REPLY_ERROR)) {
     ntop->getTrace()->traceEvent(TRACE_ERROR, "%s", reply->str ? reply->str : "???");
@@ -1440,7 +1901,7 @@ int Redis::restore(char *key, char *buf) {
     argvlen[2] = strlen(argv[2]);
     argvlen[3] = strlen(buf) / 2;
 
-    reply = (redisReply*)redisCommandArgv(redis, 4, argv, argvlen);
+    reply = commandArgv(c, redis_cmd_other, 4, argv, argvlen);
 
     rc = reply ? 0 : -1;
 
@@ -1450,7 +1911,7 @@ int Redis::restore(char *key, char *buf) {
     rc = -1;
 
   if(reply) freeReplyObject(reply);
-  l->unlock(__FILE__, __LINE__);
+  releaseConnection(c);
 
   free(buf_bin);
 
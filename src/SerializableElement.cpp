@@ -23,39 +23,83 @@
 
 /* *************************************** */ 
 
-bool SerializableElement::serializeToRedis() {
+/* NOTE: returned value must be freed by the caller */
+char* SerializableElement::getSerializedValue(u_int32_t *value_len) {
   json_object *my_obj;
+  char *value;
+
+  if(!ntop->getPrefs()->is_local_host_cache_json()) {
+    BinarySerializer s;
+
+    s.putHeader();
+
+    if(serializeBinary(&s) && !s.hasFailed()) {
+      *value_len = s.getLength();
+      return((char*)s.detach());
+    }
+  }
+
+  if((my_obj = json_object_new_object()) == NULL)
+    return(NULL);
+
+  serialize(my_obj, details_max);
+
+  if((value = strdup(json_object_to_json_string(my_obj))) != NULL)
+    *value_len = strlen(value);
+
+  json_object_put(my_obj);
+  return(value);
+}
+
+/* *************************************** */
+
+bool SerializableElement::serializeToRedis() {
+  char key[CONST_MAX_LEN_REDIS_KEY], *value;
+  u_int32_t value_len;
+  int rc;
 
-  if((my_obj = json_object_new_object()) != NULL) {
-    char key[CONST_MAX_LEN_REDIS_KEY];
-    int rc;
+  if((value = getSerializedValue(&value_len)) == NULL)
+    return(false);
 
-    serialize(my_obj, details_max);
+  rc = ntop->getRedis()->setBinary(getSerializationKey(key, sizeof(key)), value, value_len,
+				   ntop->getPrefs()->get_local_host_cache_duration());
 
-    rc = ntop->getRedis()->set(getSerializationKey(key, sizeof(key)),
-      json_object_to_json_string(my_obj),
-			       ntop->getPrefs()->get_local_host_cache_duration());
+  free(value);
+  return(rc == 0);
+}
+
+/* *************************************** */
+
+bool SerializableElement::getRedisSerialization(char **key, char **value, u_int32_t *value_len) {
+  char buf[CONST_MAX_LEN_REDIS_KEY];
 
-    json_object_put(my_obj);
-    return(rc == 0);
+  *key = NULL;
+
+  if((*value = getSerializedValue(value_len)) == NULL)
+    return(false);
+
+  if((*key = strdup(getSerializationKey(buf, sizeof(buf)))) == NULL) {
+    free(*value);
+    *value = NULL;
+    return(false);
   }
 
-  return(false);
+  return(true);
 }
 
 /* *************************************** */
 
 bool SerializableElement::deserializeFromRedis() {
   char key[CONST_MAX_LEN_REDIS_KEY];
-  json_object *o;
+  SerializedState *state;
+  bool rc = false;
 
-  if((o = SerializableElement::deserializeJson(getSerializationKey(key, sizeof(key)))) != NULL) {
-    deserialize(o);
-    json_object_put(o);
-    return(true);
+  if((state = SerializableElement::readSerialization(getSerializationKey(key, sizeof(key)))) != NULL) {
+    rc = deserializeState(state);
+    delete state;
   }
 
-  return(false);
+  return(rc);
 }
 
 /* *************************************** */
@@ -70,46 +114,61 @@ bool SerializableElement::deleteRedisSerialization() {
 
 /* *************************************** */
 
-/* NOTE: returned object must be freed by the caller */
-json_object* SerializableElement::deserializeJson(const char *key) {
-  json_object *o;
+bool SerializableElement::deserializeState(SerializedState *state) {
+  if(state->json) {
+    deserialize(state->json);
+    return(true);
+  } else {
+    BinaryDeserializer d(state->binary, state->binary_len);
+
+    return(d.readHeader() && deserializeBinary(&d) && !d.hasFailed());
+  }
+}
+
+/* *************************************** */
+
+/* NOTE: returned state must be deleted by the caller */
+SerializedState* SerializableElement::readSerialization(const char *key) {
+  SerializedState *state;
   enum json_tokener_error jerr = json_tokener_success;
-  u_int json_len;
-  char *json = NULL;
+  u_int32_t value_len;
+  char *value = NULL;
 
   if(!key
-     || ((json_len = ntop->getRedis()->len(key)) <= 0)
-     || (++json_len > HOST_MAX_SERIALIZED_LEN)
-     )
+     || (ntop->getRedis()->getBinary(key, &value, &value_len, HOST_MAX_SERIALIZED_LEN) != 0))
     return(NULL);
 
   ntop->getTrace()->traceEvent(TRACE_INFO, "Deserializing %s", key);
 
-  if((json = (char*)calloc(json_len, sizeof(char))) == NULL) {
+  if((state = new (std::nothrow) SerializedState()) == NULL) {
     ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to allocate memory to deserialize %s", key);
+    free(value);
     return(NULL);
   }
 
-  if(ntop->getRedis()->get((char*)key, json, json_len) != 0) {
-    free(json);
-    return(NULL);
+  if(BinaryDeserializer::isBinary(value, value_len)) {
+    /* Decoded by deserializeState() */
+    state->binary = (u_int8_t*)value, state->binary_len = value_len;
+    return(state);
   }
 
-  if((o = json_tokener_parse_verbose(json, &jerr)) == NULL) {
+  /* JSON written by older versions, or with the JSON serialization forced */
+  if((state->json = json_tokener_parse_verbose(value, &jerr)) == NULL) {
     ntop->getTrace()->traceEvent(TRACE_WARNING, "JSON Parse error [%s] key: %s: %s",
 				 json_tokener_error_desc(jerr),
 				 key,
-				 json);
+				 value);
     // DEBUG
     printf("JSON Parse error [%s] key: %s: %s",
 				 json_tokener_error_desc(jerr),
 				 key,
-				 json);
+				 value);
 
-    free(json);
+    free(value);
+    delete state;
     return(NULL);
   }
 
-  free(json);
-  return(o);
+  free(value);
+  return(state);
 }
@@ -37,6 +37,13 @@ int StoreManager::init(const char *db_file_full_path) {
     return -1;
   }
 
+  /* Readers no longer block the writer, and commits do not wait for each fsync */
+  char pragmas[] = "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;";
+
+  if(exec_query(pragmas, NULL, NULL))
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to enable WAL on %s: %s",
+				 db_file_full_path, sqlite3_errmsg(db));
+
   return 0;
 }
 
@@ -0,0 +1,507 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+TablesSnapshot::TablesSnapshot(NetworkInterface *_iface) : record(BINARY_SERIALIZATION_INITIAL_LEN),
+							     host_state(BINARY_SERIALIZATION_INITIAL_LEN) {
+  iface = _iface;
+  fd = -1, map = NULL, map_len = offset = 0;
+  num_macs = num_hosts = num_flows = 0;
+  failed = false;
+
+  snprintf(path, sizeof(path), "%s/%d/%s", ntop->get_working_dir(), iface->get_id(), TABLES_SNAPSHOT_FILE);
+  ntop->fixPath(path);
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+}
+
+/* **************************************************** */
+
+TablesSnapshot::~TablesSnapshot() {
+  unmapFile();
+
+  if(fd != -1)
+    close(fd);
+}
+
+/* **************************************************** */
+
+static void snapshot_put_ip(BinarySerializer *s, IpAddress *ip) {
+  if(ip->isIPv4()) {
+    u_int32_t ipv4 = ip->get_ipv4();
+
+    s->putU8(4), s->putBytes(&ipv4, sizeof(ipv4));
+  } else
+    s->putU8(6), s->putBytes(ip->get_ipv6(), sizeof(struct ndpi_in6_addr));
+}
+
+/* **************************************************** */
+
+static bool snapshot_get_ip(BinaryDeserializer *d, IpAddress *ip) {
+  const u_int8_t *addr;
+
+  switch(d->getU8()) {
+  case 4:
+    if((addr = d->getBytes(sizeof(u_int32_t))) == NULL) return(false);
+    ip->set(*(u_int32_t*)addr);
+    return(true);
+
+  case 6:
+    if((addr = d->getBytes(sizeof(struct ndpi_in6_addr))) == NULL) return(false);
+    ip->set((struct ndpi_in6_addr*)addr);
+    return(true);
+
+  default:
+    return(false);
+  }
+}
+
+/* **************************************************** */
+
+static void snapshot_put_mac(BinarySerializer *s, Mac *m) {
+  static const u_int8_t empty_mac[6] = { 0 };
+
+  s->putBytes(m ? m->get_mac() : empty_mac, 6);
+}
+
+/* **************************************************** */
+
+/* Returns the MAC of the interface with the 6 bytes read from d, NULL for an all-zero MAC */
+static Mac* snapshot_get_mac(BinaryDeserializer *d, NetworkInterface *iface) {
+  static const u_int8_t empty_mac[6] = { 0 };
+  const u_int8_t *mac_buf = d->getBytes(6);
+  u_int8_t mac[6];
+
+  if((mac_buf == NULL) || !memcmp(mac_buf, empty_mac, 6))
+    return(NULL);
+
+  memcpy(mac, mac_buf, 6);
+  return(iface->getMac(mac, true /* Create if missing */, true /* Inline call */));
+}
+
+/* **************************************************** */
+
+#ifndef WIN32
+
+/* Maps the first len bytes of the file, growing it as needed */
+bool TablesSnapshot::mapFile(u_int64_t len) {
+  unmapFile();
+
+  if(ftruncate(fd, len) != 0)
+    return(false);
+
+  if((map = (u_int8_t*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    map = NULL;
+    return(false);
+  }
+
+  map_len = len;
+  return(true);
+}
+
+/* **************************************************** */
+
+void TablesSnapshot::unmapFile() {
+  if(map) {
+    munmap(map, map_len);
+    map = NULL, map_len = 0;
+  }
+}
+
+/* **************************************************** */
+
+/* Copies the serialized record into the file */
+void TablesSnapshot::appendRecord() {
+  u_int32_t len = record.getLength();
+
+  if(failed)
+    return;
+
+  if(record.hasFailed()) {
+    failed = true;
+    return;
+  }
+
+  if(offset + len > map_len) {
+    u_int64_t new_len = map_len;
+
+    while(offset + len > new_len) new_len *= 2;
+
+    /* The deserializer addresses the file with 32 bit offsets */
+    if(new_len > (u_int32_t)-1) new_len = (u_int32_t)-1;
+
+    if((offset + len > new_len) || !mapFile(new_len)) {
+      failed = true;
+      return;
+    }
+  }
+
+  memcpy(&map[offset], record.getData(), len);
+  offset += len;
+}
+
+/* **************************************************** */
+
+void TablesSnapshot::addMac(Mac *m) {
+  u_int32_t begin;
+
+  if(m->isSpecialMac())
+    return;
+
+  record.reset();
+  begin = record.beginSection(binary_section_snapshot_mac);
+  snapshot_put_mac(&record, m);
+  m->serializeBinaryState(&record);
+  record.endSection(begin);
+  appendRecord();
+
+  num_macs++;
+}
+
+/* **************************************************** */
+
+void TablesSnapshot::addHost(Host *h) {
+  u_int32_t begin;
+
+  host_state.reset();
+  if(h->isLocalHost())
+    ((LocalHost*)h)->serializeBinary(&host_state);
+
+  if(host_state.hasFailed()) {
+    failed = true;
+    return;
+  }
+
+  record.reset();
+  begin = record.beginSection(binary_section_snapshot_host);
+  snapshot_put_ip(&record, h->get_ip());
+  record.putVarint(h->get_vlan_id());
+  snapshot_put_mac(&record, h->getMac());
+  record.putVarint(host_state.getLength());
+  record.putBytes(host_state.getData(), host_state.getLength());
+  record.endSection(begin);
+  appendRecord();
+
+  num_hosts++;
+}
+
+/* **************************************************** */
+
+void TablesSnapshot::addFlow(Flow *f) {
+  Host *cli = f->get_cli_host(), *srv = f->get_srv_host();
+  u_int32_t begin;
+
+  /* ICMP flows are keyed by the ICMP info as well, which is not kept */
+  if(!cli || !srv
+     || (f->get_protocol() == IPPROTO_ICMP) || (f->get_protocol() == IPPROTO_ICMPV6))
+    return;
+
+  record.reset();
+  begin = record.beginSection(binary_section_snapshot_flow);
+  record.putU8(f->get_protocol());
+  record.putVarint(f->get_vlan_id());
+  snapshot_put_ip(&record, cli->get_ip()), record.putVarint(f->get_cli_port());
+  snapshot_put_ip(&record, srv->get_ip()), record.putVarint(f->get_srv_port());
+  snapshot_put_mac(&record, cli->getMac()), snapshot_put_mac(&record, srv->getMac());
+  record.putVarint(f->get_first_seen()), record.putVarint(f->get_last_seen());
+  f->serializeBinaryState(&record);
+  record.endSection(begin);
+  appendRecord();
+
+  num_flows++;
+}
+
+/* **************************************************** */
+
+static bool snapshot_mac_walker(GenericHashEntry *he, void *user_data, bool *matched) {
+  ((TablesSnapshot*)user_data)->addMac((Mac*)he);
+  *matched = true;
+  return(false); /* false = keep on walking */
+}
+
+/* **************************************************** */
+
+static bool snapshot_host_walker(GenericHashEntry *he, void *user_data, bool *matched) {
+  ((TablesSnapshot*)user_data)->addHost((Host*)he);
+  *matched = true;
+  return(false); /* false = keep on walking */
+}
+
+/* **************************************************** */
+
+static bool snapshot_flow_walker(GenericHashEntry *he, void *user_data, bool *matched) {
+  ((TablesSnapshot*)user_data)->addFlow((Flow*)he);
+  *matched = true;
+  return(false); /* false = keep on walking */
+}
+
+/* **************************************************** */
+
+bool TablesSnapshot::save() {
+  struct timeval begin, end;
+  char dir[MAX_PATH];
+  u_int32_t begin_slot, info;
+
+  gettimeofday(&begin, NULL);
+
+  snprintf(dir, sizeof(dir), "%s/%d", ntop->get_working_dir(), iface->get_id());
+  ntop->fixPath(dir);
+  Utils::mkdir_tree(dir);
+
+  if((fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0600)) == -1) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to create %s: %s", tmp_path, strerror(errno));
+    return(false);
+  }
+
+  if(!mapFile(TABLES_SNAPSHOT_INITIAL_LEN)) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to map %s: %s", tmp_path, strerror(errno));
+    unlink(tmp_path);
+    return(false);
+  }
+
+  record.reset();
+  record.putHeader();
+  info = record.beginSection(binary_section_snapshot_info);
+  record.putVarint(iface->get_id());
+  record.putVarint(time(NULL));
+  record.putVarint(TABLES_SNAPSHOT_FORMAT);
+  record.endSection(info);
+  appendRecord();
+
+  /*
+    Hosts reference their MAC and flows their hosts: restore() recreates them in
+    the same order. The tables of the interface itself are walked, not the shards.
+   */
+  begin_slot = 0;
+  iface->NetworkInterface::walker(&begin_slot, true /* walk_all */, walker_macs, snapshot_mac_walker, this);
+  begin_slot = 0;
+  iface->NetworkInterface::walker(&begin_slot, true /* walk_all */, walker_hosts, snapshot_host_walker, this);
+  begin_slot = 0;
+  iface->NetworkInterface::walker(&begin_slot, true /* walk_all */, walker_flows, snapshot_flow_walker, this);
+
+  unmapFile();
+
+  if(failed || (ftruncate(fd, offset) != 0) || (fsync(fd) != 0)) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to write the tables snapshot %s", tmp_path);
+    unlink(tmp_path);
+    return(false);
+  }
+
+  close(fd);
+  fd = -1;
+
+  if(num_macs + num_hosts + num_flows == 0) {
+    /* Nothing to restore: an older snapshot must not be restored either */
+    unlink(tmp_path);
+    unlink(path);
+    return(true);
+  }
+
+  if(rename(tmp_path, path) != 0) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to rename %s: %s", tmp_path, strerror(errno));
+    unlink(tmp_path);
+    return(false);
+  }
+
+  gettimeofday(&end, NULL);
+  ntop->getTrace()->traceEvent(TRACE_NORMAL,
+			       "Saved tables snapshot of %s [macs: %u][hosts: %u][flows: %u][%llu bytes][%.1f ms]",
+			       iface->get_name(), num_macs, num_hosts, num_flows,
+			       (unsigned long long)offset, Utils::msTimevalDiff(&end, &begin));
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool TablesSnapshot::restoreMac(BinaryDeserializer *d) {
+  Mac *m = snapshot_get_mac(d, iface);
+
+  if(m == NULL)
+    return(false);
+
+  m->restoreBinaryState(d);
+  num_macs++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool TablesSnapshot::restoreHost(BinaryDeserializer *d) {
+  IpAddress ip;
+  u_int16_t vlan_id;
+  u_int32_t state_len;
+  const u_int8_t *state;
+  Mac *mac;
+  Host *h;
+
+  if(!snapshot_get_ip(d, &ip))
+    return(false);
+
+  vlan_id = (u_int16_t)d->getVarint();
+  mac = snapshot_get_mac(d, iface);
+  state_len = (u_int32_t)d->getVarint();
+  state = d->getBytes(state_len);
+
+  if(d->hasFailed() || ((h = iface->restoreHost(mac, vlan_id, &ip)) == NULL))
+    return(false);
+
+  /* The host may have turned remote (e.g. local networks changed): its state is then dropped */
+  if((state_len > 0) && h->isLocalHost()) {
+    BinaryDeserializer host_d(state, state_len);
+
+    ((LocalHost*)h)->deserializeBinary(&host_d);
+  }
+
+  num_hosts++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool TablesSnapshot::restoreFlow(BinaryDeserializer *d) {
+  IpAddress cli_ip, srv_ip;
+  u_int16_t vlan_id, cli_port, srv_port;
+  Mac *cli_mac, *srv_mac;
+  time_t first_seen, last_seen;
+  u_int8_t l4_proto;
+  Flow *f;
+
+  l4_proto = d->getU8();
+  vlan_id = (u_int16_t)d->getVarint();
+  if(!snapshot_get_ip(d, &cli_ip)) return(false);
+  cli_port = (u_int16_t)d->getVarint();
+  if(!snapshot_get_ip(d, &srv_ip)) return(false);
+  srv_port = (u_int16_t)d->getVarint();
+  cli_mac = snapshot_get_mac(d, iface), srv_mac = snapshot_get_mac(d, iface);
+  first_seen = (time_t)d->getVarint(), last_seen = (time_t)d->getVarint();
+
+  if(d->hasFailed()
+     || ((f = iface->restoreFlow(vlan_id, l4_proto,
+				 cli_mac, &cli_ip, htons(cli_port),
+				 srv_mac, &srv_ip, htons(srv_port),
+				 first_seen, last_seen)) == NULL))
+    return(false);
+
+  f->restoreBinaryState(d);
+  num_flows++;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+bool TablesSnapshot::restore() {
+  struct timeval begin, end;
+  struct stat st;
+  BinaryDeserializer d, section, info;
+  u_int32_t num_skipped = 0;
+  time_t epoch;
+  u_int8_t tag;
+  bool rc = false;
+
+  if((fd = open(path, O_RDONLY)) == -1)
+    return(false); /* No snapshot */
+
+  gettimeofday(&begin, NULL);
+
+  if((fstat(fd, &st) != 0) || (st.st_size == 0) || ((u_int64_t)st.st_size > (u_int32_t)-1)
+     || ((map = (u_int8_t*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)) {
+    map = NULL;
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to read the tables snapshot %s", path);
+    goto out;
+  }
+
+  map_len = st.st_size;
+  madvise(map, map_len, MADV_SEQUENTIAL);
+  d = BinaryDeserializer(map, map_len);
+
+  if(!d.readHeader() || !d.nextSection(&tag, &info) || (tag != binary_section_snapshot_info)) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Invalid tables snapshot %s", path);
+    goto out;
+  }
+
+  if(info.getVarint() != (u_int64_t)iface->get_id()) {
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Tables snapshot %s written by another interface", path);
+    goto out;
+  }
+
+  epoch = (time_t)info.getVarint();
+
+  if(info.getVarint() != TABLES_SNAPSHOT_FORMAT) {
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Ignoring the tables snapshot of %s: unsupported format",
+				 iface->get_name());
+    goto out;
+  }
+
+  if(time(NULL) - epoch > TABLES_SNAPSHOT_MAX_AGE) {
+    ntop->getTrace()->traceEvent(TRACE_NORMAL, "Ignoring the tables snapshot of %s written %u sec ago",
+				 iface->get_name(), (u_int32_t)(time(NULL) - epoch));
+    goto out;
+  }
+
+  while(d.nextSection(&tag, &section)) {
+    bool restored;
+
+    switch(tag) {
+    case binary_section_snapshot_mac:  restored = restoreMac(&section);  break;
+    case binary_section_snapshot_host: restored = restoreHost(&section); break;
+    case binary_section_snapshot_flow: restored = restoreFlow(&section); break;
+    default:                           restored = false;                 break;
+    }
+
+    if(!restored) num_skipped++;
+  }
+
+  gettimeofday(&end, NULL);
+  ntop->getTrace()->traceEvent(TRACE_NORMAL,
+			       "Restored tables snapshot of %s [macs: %u][hosts: %u][flows: %u][skipped: %u][%.1f ms]",
+			       iface->get_name(), num_macs, num_hosts, num_flows, num_skipped,
+			       Utils::msTimevalDiff(&end, &begin));
+  rc = true;
+
+ out:
+  unmapFile();
+  close(fd);
+  fd = -1;
+
+  return(rc);
+}
+
+#else
+
+bool TablesSnapshot::mapFile(u_int64_t len) { return(false); }
+void TablesSnapshot::unmapFile()            { ; }
+void TablesSnapshot::appendRecord()         { ; }
+void TablesSnapshot::addMac(Mac *m)         { ; }
+void TablesSnapshot::addHost(Host *h)       { ; }
+void TablesSnapshot::addFlow(Flow *f)       { ; }
+bool TablesSnapshot::save()                 { return(false); }
+bool TablesSnapshot::restoreMac(BinaryDeserializer *d)  { return(false); }
+bool TablesSnapshot::restoreHost(BinaryDeserializer *d) { return(false); }
+bool TablesSnapshot::restoreFlow(BinaryDeserializer *d) { return(false); }
+bool TablesSnapshot::restore()              { return(false); }
+
+#endif
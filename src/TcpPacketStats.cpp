@@ -54,6 +54,20 @@ void TcpPacketStats::deserialize(json_object *o) {
 
 /* ******************************************* */
 
+void TcpPacketStats::serializeBinary(BinarySerializer *s) const {
+  s->putVarint(pktRetr), s->putVarint(pktOOO);
+  s->putVarint(pktLost), s->putVarint(pktKeepAlive);
+}
+
+/* ******************************************* */
+
+void TcpPacketStats::deserializeBinary(BinaryDeserializer *d) {
+  pktRetr = d->getVarint(), pktOOO = d->getVarint();
+  pktLost = d->getVarint(), pktKeepAlive = d->getVarint();
+}
+
+/* ******************************************* */
+
 json_object* TcpPacketStats::getJSONObject() {
   json_object *my_object;
 
@@ -25,6 +25,7 @@
 
 TimelineExtract::TimelineExtract() {
   extraction.id = 0;
+  extraction.match_flow = false;
   status_code = 0;
   running = false;
   shutdown = false;
@@ -117,13 +118,82 @@ pfring *TimelineExtract::openTimelineFromInterface(NetworkInterface *iface, time
 
 /* ********************************************* */
 
+bool TimelineExtract::extractRecorded(NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow,
+				      u_int64_t max_bytes, PacketDumper *dumper, struct mg_connection *conn) {
+  PacketRecorderReader *reader;
+  struct pcap_pkthdr h;
+  struct pcap_disk_pkthdr pkthdr;
+  const u_char *packet;
+  bool http_client_disconnected = false;
+
+  reader = new (std::nothrow) PacketRecorderReader(iface->getPacketRecorder(), from, to, bpf_filter, flow);
+
+  if (reader == NULL || !reader->isValid()) {
+    ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to read the recorded packets");
+    status_code = (bpf_filter && bpf_filter[0]) ? 5 /* Unable to set filter */ : 3 /* Memory allocation failure */;
+    if (reader) delete reader;
+    return false;
+  }
+
+  ntop->getTrace()->traceEvent(TRACE_INFO, "Running extraction from the packet recorder of %s", iface->get_name());
+
+  while (!shutdown && !http_client_disconnected && !ntop->getGlobals()->isShutdown() &&
+         reader->next(&h, &packet)) {
+    if (dumper)
+      dumper->dumpPacket(&h, packet);
+    else {
+      pkthdr.ts.tv_sec = h.ts.tv_sec, pkthdr.ts.tv_usec = h.ts.tv_usec;
+      pkthdr.caplen = h.caplen, pkthdr.len = h.len;
+
+      if (!Utils::mg_write_retry(conn, (u_char *) &pkthdr, sizeof(pkthdr)) ||
+          !Utils::mg_write_retry(conn, (u_char *) packet, h.caplen))
+        http_client_disconnected = true;
+    }
+
+    stats.packets++;
+    stats.bytes += sizeof(struct pcap_disk_pkthdr) + h.caplen;
+    if (max_bytes != 0 && stats.bytes >= max_bytes)
+      break;
+  }
+
+  delete reader;
+
+  return !http_client_disconnected;
+}
+
+/* ********************************************* */
+
 bool TimelineExtract::extractToDisk(u_int32_t id, NetworkInterface *iface,
-				    time_t from, time_t to, const char *bpf_filter, u_int64_t max_bytes,
+				    time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow, u_int64_t max_bytes,
 				    const char * const timeline_path) {
   bool completed = false;
-#ifdef HAVE_PF_RING
   char out_path[MAX_PATH];
   PacketDumper *dumper;
+
+  if ((!timeline_path || timeline_path[0] == '\0') && iface && iface->getPacketRecorder()) {
+    shutdown = false;
+    stats.packets = stats.bytes = 0;
+    status_code = 1; /* default: unexpected error */
+
+    snprintf(out_path, sizeof(out_path), "%s/%u/extr_pcap/%u", ntop->getPrefs()->get_pcap_dir(), iface->get_id(), id);
+
+    if ((dumper = new (std::nothrow) PacketDumper(iface, out_path)) == NULL) {
+      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to initialize packet dumper");
+      status_code = 2; /* Unable to initialize dumper */
+    } else {
+      if ((completed = extractRecorded(iface, from, to, bpf_filter, flow, max_bytes, dumper, NULL)))
+        status_code = 0; /* Successfully completed */
+
+      delete dumper;
+    }
+
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Extraction #%u %s",
+      id, completed ? "completed" : "failed");
+
+    return completed;
+  }
+
+#ifdef HAVE_PF_RING
   pfring  *handle;
   u_char *packet = NULL;
   struct pfring_pkthdr header;
@@ -158,6 +228,8 @@ bool TimelineExtract::extractToDisk(u_int32_t id, NetworkInterface *iface,
   while (!shutdown && !ntop->getGlobals()->isShutdown() && 
          pfring_recv(handle, &packet, 0, &header, 0) > 0) {
     h = (struct pcap_pkthdr *) &header;
+    if (flow && !flow->match(iface->get_datalink(), h, packet))
+      continue;
     dumper->dumpPacket(h, packet);
     stats.packets++;
     stats.bytes += sizeof(struct pcap_disk_pkthdr) + h->caplen;
@@ -186,8 +258,24 @@ bool TimelineExtract::extractToDisk(u_int32_t id, NetworkInterface *iface,
 
 /* ********************************************* */
 
-bool TimelineExtract::extractLive(struct mg_connection *conn, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const char * const timeline_path) {
+bool TimelineExtract::extractLive(struct mg_connection *conn, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow, const char * const timeline_path) {
   bool completed = false;
+
+  if ((!timeline_path || timeline_path[0] == '\0') && iface->getPacketRecorder()) {
+    struct pcap_file_header pcaphdr;
+
+    stats.packets = stats.bytes = 0;
+
+    Utils::init_pcap_header(&pcaphdr, iface);
+
+    if (Utils::mg_write_retry(conn, (u_char *) &pcaphdr, sizeof(pcaphdr)))
+      completed = extractRecorded(iface, from, to, bpf_filter, flow, 0, NULL, conn);
+
+    ntop->getTrace()->traceEvent(TRACE_INFO, "Live extraction %s", completed ? "completed" : "failed");
+
+    return completed;
+  }
+
 #ifdef HAVE_PF_RING
   pfring  *handle;
   u_char *packet = NULL;
@@ -219,6 +307,9 @@ bool TimelineExtract::extractLive(struct mg_connection *conn, NetworkInterface *
          !ntop->getGlobals()->isShutdown() && 
          (rc = pfring_recv(handle, &packet, 0, &h, 0)) > 0) {
 
+    if (flow && !flow->match(iface->get_datalink(), (struct pcap_pkthdr *) &h, packet))
+      continue;
+
     pkthdr.ts.tv_sec = h.ts.tv_sec;
     pkthdr.ts.tv_usec = h.ts.tv_usec,
     pkthdr.caplen = h.caplen;
@@ -256,6 +347,7 @@ static void *extractionThread(void *ptr) {
     extr->getFrom(),
     extr->getTo(),
     extr->getFilter(),
+    extr->getFlow(),
     extr->getMaxBytes(),
     extr->getTimelinePath()
   );
@@ -266,7 +358,7 @@ static void *extractionThread(void *ptr) {
 
 /* ********************************************* */
 
-void TimelineExtract::runExtractionJob(u_int32_t id, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, u_int64_t max_bytes, const char * const timeline_path) {
+void TimelineExtract::runExtractionJob(u_int32_t id, NetworkInterface *iface, time_t from, time_t to, const char *bpf_filter, const FlowTuple *flow, u_int64_t max_bytes, const char * const timeline_path) {
 
   running = true;
 
@@ -275,6 +367,8 @@ void TimelineExtract::runExtractionJob(u_int32_t id, NetworkInterface *iface, ti
   extraction.from = from;
   extraction.to = to;
   extraction.bpf_filter = strdup(bpf_filter);
+  extraction.match_flow = (flow != NULL);
+  if (flow) extraction.flow = *flow;
   extraction.max_bytes = max_bytes;
   extraction.timeline_path = timeline_path;
 
@@ -0,0 +1,206 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+/* **************************************************** */
+
+TimingWheel::TimingWheel() {
+  for(u_int i = 0; i < TIMING_WHEEL_NUM_SLOTS; i++)
+    slots[i] = NULL;
+
+  clock = 0;
+  num_armed = 0;
+  num_arms = num_expired = num_cascaded = 0;
+}
+
+/* **************************************************** */
+
+int16_t TimingWheel::slotOf(time_t deadline) const {
+  time_t delta;
+
+  if(deadline < clock)
+    deadline = clock; /* Already expired: fire on the next tick */
+
+  delta = deadline - clock;
+
+  if(delta >= TIMING_WHEEL_SPAN)
+    deadline = clock + TIMING_WHEEL_SPAN - 1, delta = TIMING_WHEEL_SPAN - 1;
+
+  if(delta < TIMING_WHEEL_L0_SLOTS)
+    return(deadline & (TIMING_WHEEL_L0_SLOTS - 1));
+
+  for(u_int level = 1; level < TIMING_WHEEL_NUM_LEVELS; level++) {
+    u_int shift = TIMING_WHEEL_L0_BITS + (level - 1) * TIMING_WHEEL_LN_BITS;
+
+    if(delta < ((time_t)1 << (shift + TIMING_WHEEL_LN_BITS)))
+      return(TIMING_WHEEL_L0_SLOTS + (level - 1) * TIMING_WHEEL_LN_SLOTS
+	     + ((deadline >> shift) & (TIMING_WHEEL_LN_SLOTS - 1)));
+  }
+
+  return(TIMING_WHEEL_NUM_SLOTS - 1); /* Not reached */
+}
+
+/* **************************************************** */
+
+void TimingWheel::link(GenericHashEntry *h, int16_t slot) {
+  TimingWheelLink *l = h->get_wheel_link();
+
+  l->slot = slot, l->prev = NULL, l->next = slots[slot];
+
+  if(slots[slot])
+    slots[slot]->get_wheel_link()->prev = h;
+
+  slots[slot] = h;
+  num_armed++;
+}
+
+/* **************************************************** */
+
+void TimingWheel::unlink(GenericHashEntry *h) {
+  TimingWheelLink *l = h->get_wheel_link();
+
+  if(l->prev)
+    l->prev->get_wheel_link()->next = l->next;
+  else
+    slots[l->slot] = l->next;
+
+  if(l->next)
+    l->next->get_wheel_link()->prev = l->prev;
+
+  l->prev = l->next = NULL, l->slot = -1;
+  num_armed--;
+}
+
+/* **************************************************** */
+
+void TimingWheel::arm(GenericHashEntry *h, time_t deadline) {
+  TimingWheelLink *l = h->get_wheel_link();
+
+  if(clock == 0)
+    clock = deadline; /* First use: time is driven by the entries (e.g., pcap files) */
+
+  if(l->slot >= 0)
+    unlink(h);
+
+  l->deadline = deadline;
+  link(h, slotOf(deadline));
+  num_arms++;
+}
+
+/* **************************************************** */
+
+void TimingWheel::remove(GenericHashEntry *h) {
+  if(h->get_wheel_link()->slot >= 0)
+    unlink(h);
+}
+
+/* **************************************************** */
+
+/* Moves the entries of an upper level slot to the lower levels */
+void TimingWheel::cascade(u_int level, u_int idx) {
+  u_int slot = TIMING_WHEEL_L0_SLOTS + (level - 1) * TIMING_WHEEL_LN_SLOTS + idx;
+  GenericHashEntry *h = slots[slot];
+
+  slots[slot] = NULL;
+
+  while(h) {
+    TimingWheelLink *l = h->get_wheel_link();
+    GenericHashEntry *next = l->next;
+
+    num_armed--; /* The entry was detached with the whole slot */
+    link(h, slotOf(l->deadline));
+    num_cascaded++;
+    h = next;
+  }
+}
+
+/* **************************************************** */
+
+void TimingWheel::popSlot(u_int slot, vector<GenericHashEntry*> *expired) {
+  while(slots[slot]) {
+    GenericHashEntry *h = slots[slot];
+
+    unlink(h);
+    expired->push_back(h);
+    num_expired++;
+  }
+}
+
+/* **************************************************** */
+
+void TimingWheel::advance(time_t now, vector<GenericHashEntry*> *expired) {
+  if(num_armed == 0) {
+    /* Nothing to expire: just catch up with the time (the first arm() sets it otherwise) */
+    if((clock != 0) && (now >= clock)) clock = now + 1;
+    return;
+  }
+
+  if(now - clock >= TIMING_WHEEL_SPAN) {
+    /*
+      The time jumped beyond the wheel span (e.g., clock changes): hand back
+      all the entries, the owner will re-evaluate and re-arm them
+    */
+    for(u_int i = 0; i < TIMING_WHEEL_NUM_SLOTS; i++)
+      popSlot(i, expired);
+
+    clock = now + 1;
+    return;
+  }
+
+  while(clock <= now) {
+    /* Cascade the upper levels when the lower ones wrap around */
+    for(u_int level = TIMING_WHEEL_NUM_LEVELS - 1; level > 0; level--) {
+      u_int shift = TIMING_WHEEL_L0_BITS + (level - 1) * TIMING_WHEEL_LN_BITS;
+
+      if((clock & (((time_t)1 << shift) - 1)) == 0)
+	cascade(level, (clock >> shift) & (TIMING_WHEEL_LN_SLOTS - 1));
+    }
+
+    popSlot(clock & (TIMING_WHEEL_L0_SLOTS - 1), expired);
+    clock++;
+  }
+}
+
+/* **************************************************** */
+
+void TimingWheel::reset() {
+  for(u_int i = 0; i < TIMING_WHEEL_NUM_SLOTS; i++) {
+    while(slots[i])
+      unlink(slots[i]);
+  }
+}
+
+/* **************************************************** */
+
+void TimingWheel::lua(lua_State *vm) const {
+  lua_newtable(vm);
+
+  lua_push_uint64_table_entry(vm, "num_armed", num_armed);
+  lua_push_uint64_table_entry(vm, "num_arms", num_arms);
+  lua_push_uint64_table_entry(vm, "num_expired", num_expired);
+  lua_push_uint64_table_entry(vm, "num_cascaded", num_cascaded);
+
+  lua_pushstring(vm, "timing_wheel");
+  lua_insert(vm, -2);
+  lua_settable(vm, -3);
+}
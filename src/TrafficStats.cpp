@@ -68,6 +68,20 @@ void TrafficStats::deserialize(json_object *o) {
 
 /* ******************************************* */
 
+void TrafficStats::serializeBinary(BinarySerializer *s) const {
+  s->putVarint(numPkts.get());
+  s->putVarint(numBytes.get());
+}
+
+/* ******************************************* */
+
+void TrafficStats::deserializeBinary(BinaryDeserializer *d) {
+  numPkts.setInitialValue(d->getVarint());
+  numBytes.setInitialValue(d->getVarint());
+}
+
+/* ******************************************* */
+
 json_object* TrafficStats::getJSONObject() {
   json_object *my_object = json_object_new_object();
   
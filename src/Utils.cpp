@@ -2792,21 +2792,120 @@ void Utils::xor_encdec(u_char *data, int data_len, u_char *key) {
 
 /* ****************************************************** */
 
+/*
+  Keys of the hash function used to select the buckets of the flow, host
+  and MAC hash tables. They are randomized by initHashSeed() at startup so
+  that bucket collisions cannot be forced by crafting the traffic.
+*/
+static u_int64_t hash_seed[2] = { 0x736f6d6570736575ULL, 0x646f72616e646f6dULL };
+
+#define HASH_PRIME64_1  0x9E3779B185EBCA87ULL
+#define HASH_PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME64_3  0x165667B19E3779F9ULL
+
+void Utils::initHashSeed() {
+  u_int64_t seed[2];
+  bool seeded = false;
+#ifndef WIN32
+  FILE *fd = fopen("/dev/urandom", "r");
+
+  if(fd) {
+    seeded = (fread(seed, sizeof(seed), 1, fd) == 1);
+    fclose(fd);
+  }
+#endif
+
+  if(!seeded) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    seed[0] = ((u_int64_t)tv.tv_sec << 32) ^ (u_int64_t)tv.tv_usec;
+    seed[1] = (seed[0] * HASH_PRIME64_1) ^ (u_int64_t)(uintptr_t)&seed;
+  }
+
+  hash_seed[0] ^= seed[0], hash_seed[1] ^= seed[1];
+}
+
+/* ****************************************************** */
+
+/* xxHash64 accumulation round and avalanche */
+static inline u_int64_t hashRound(u_int64_t acc, u_int64_t input) {
+  acc += input * HASH_PRIME64_2;
+  acc = (acc << 31) | (acc >> 33);
+
+  return(acc * HASH_PRIME64_1);
+}
+
+static inline u_int32_t hashAvalanche(u_int64_t h) {
+  h ^= h >> 33;
+  h *= HASH_PRIME64_2;
+  h ^= h >> 29;
+  h *= HASH_PRIME64_3;
+  h ^= h >> 32;
+
+  return((u_int32_t)h);
+}
+
+/* ****************************************************** */
+
+u_int32_t Utils::keyedHash(u_int64_t v) {
+  return(hashAvalanche(hashRound(hash_seed[0], v) ^ hash_seed[1]));
+}
+
+/* ****************************************************** */
+
+u_int32_t Utils::keyedHash(u_int64_t v1, u_int64_t v2) {
+  return(hashAvalanche(hashRound(hashRound(hash_seed[0], v1), v2) ^ hash_seed[1]));
+}
+
+/* ****************************************************** */
+
+u_int32_t Utils::flowHash(u_int32_t a_key, u_int16_t a_port,
+			  u_int32_t b_key, u_int16_t b_port,
+			  u_int16_t vlan_id, u_int16_t protocol, u_int32_t extra_key) {
+  u_int64_t a = ((u_int64_t)a_key << 16) | a_port;
+  u_int64_t b = ((u_int64_t)b_key << 16) | b_port;
+  u_int64_t acc;
+
+  /* Sort the endpoints so that both directions of the flow get the same hash */
+  if(a > b) {
+    u_int64_t t = a;
+
+    a = b, b = t;
+  }
+
+  acc = hashRound(hash_seed[0], a);
+  acc = hashRound(acc, b);
+  acc = hashRound(acc, ((u_int64_t)extra_key << 32) | ((u_int32_t)vlan_id << 16) | protocol);
+
+  return(hashAvalanche(acc ^ hash_seed[1]));
+}
+
+/* ****************************************************** */
+
 u_int32_t Utils::macHash(const u_int8_t * const mac) {
   if(mac == NULL)
     return(0);
   else {
-    u_int32_t hash = 0;
+    u_int64_t v = 0;
 
     for(int i=0; i<6; i++)
-      hash += mac[i] << (i+1);
+      v = (v << 8) | mac[i];
 
-    return(hash);
+    return(keyedHash(v));
   }
 }
 
 /* ****************************************************** */
 
+bool Utils::isEmptyMac(const u_int8_t * const mac) {
+  u_int8_t zero[6] = { 0, 0, 0, 0, 0, 0 };
+
+  return((mac == NULL) || (memcmp(mac, zero, 6) == 0));
+}
+
+/* ****************************************************** */
+
 /* https://en.wikipedia.org/wiki/Multicast_address */
 /* https://hwaddress.com/company/private */
 bool Utils::isSpecialMac(u_int8_t *mac) {
@@ -3196,10 +3295,11 @@ int Utils::numberOfSetBits(u_int32_t i) {
 /* ******************************************* */
 
 void Utils::initRedis(Redis **r, const char *redis_host, const char *redis_password,
-		      u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure) {
+		      u_int16_t redis_port, u_int8_t _redis_db_id, bool giveup_on_failure,
+		      u_int8_t pool_size) {
   if(r) {
     if(*r) delete(*r);
-    (*r) = new Redis(redis_host, redis_password, redis_port, _redis_db_id, giveup_on_failure);
+    (*r) = new Redis(redis_host, redis_password, redis_port, _redis_db_id, giveup_on_failure, pool_size);
   }
 }
 
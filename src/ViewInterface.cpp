@@ -422,69 +422,19 @@ Flow* ViewInterface::findFlowByTuple(u_int16_t vlan_id,
 /* **************************************************** */
 
 void ViewInterface::viewed_flows_walker(Flow *f, const struct timeval *tv) {
-  NetworkStats *network_stats;
   PartializableFlowTrafficStats partials;
-  bool first_partial; /* Whether this is the first time the view is visiting this flow */
-  const IpAddress *cli_ip = f->get_cli_ip_addr(), *srv_ip = f->get_srv_ip_addr();
+  const IpAddress *cli_ip = f->get_cli_ip_addr();
 
   if(f->get_last_seen() > getTimeLastPktRcvd())
     setTimeLastPktRcvd(f->get_last_seen());
 
-  /* NOTE: partials are calculated as a delta between the current and the past traffic.
-   * When the hash tables are full and hosts cannot be allocated during the
-   * first iteration of this method on the flow (when first_partial is true),
-   * such stats on the hosts will be lost.
-   */
-  if(f->get_partial_traffic_stats_view(&partials, &first_partial)) {
-    if(!cli_ip || !srv_ip)
-      ntop->getTrace()->traceEvent(TRACE_ERROR, "Unable to get flow hosts. Out of memory? Expect issues.");
-
-    if(cli_ip && srv_ip) {
-      Host *cli_host = NULL, *srv_host = NULL;
-
-      /* Important: findFlowHosts can allocate new hosts. The first_partial condition
-       * is used to call `incNumFlows` and `incUses` on the hosts below, so it is essential that
-       * findFlowHosts is called only when first_partial is true. */
-      if(first_partial)
-	findFlowHosts(f->get_vlan_id(),
-		      NULL /* no src mac yet */, (IpAddress*)cli_ip, &cli_host,
-		      NULL /* no dst mac yet */, (IpAddress*)srv_ip, &srv_host);
-      else {
-	/* The unsafe pointers can be used here as ViewInterface::viewed_flows_walker is
-	 * called synchronously with the ViewInterface purgeIdle. This also saves some
-	 * unnecessary hash table lookup time. */
-	cli_host = f->unsafeGetClient();
-	srv_host = f->unsafeGetServer();
-      }
-
-      f->hosts_periodic_stats_update(this, cli_host, srv_host, &partials, first_partial, tv);
-
-      if(cli_host) {
-	if(first_partial) {
-	  cli_host->incNumFlows(f->get_last_seen(), true), cli_host->incUses();
-	  network_stats = cli_host->getNetworkStats(cli_host->get_local_network_id());
-	  if(network_stats) network_stats->incNumFlows(f->get_last_seen(), true);
-	  if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setClientHost(cli_host);
-	}
-      }
-
-      if(srv_host) {
-	if(first_partial) {
-	  srv_host->incUses(), srv_host->incNumFlows(f->get_last_seen(), false);
-	  network_stats = srv_host->getNetworkStats(srv_host->get_local_network_id());
-	  if(network_stats) network_stats->incNumFlows(f->get_last_seen(), false);
-	  if(f->getViewInterfaceFlowStats()) f->getViewInterfaceFlowStats()->setServerHost(srv_host);
-	}
-      }
-
-      incStats(true /* ingressPacket */,
-	       tv->tv_sec, cli_ip && cli_ip->isIPv4() ? ETHERTYPE_IP : ETHERTYPE_IPV6,
-	       f->getStatsProtocol(), f->get_protocol_category(),
-	       f->get_protocol(),
-	       partials.get_srv2cli_bytes() + partials.get_cli2srv_bytes(),
-	       partials.get_srv2cli_packets() + partials.get_cli2srv_packets());
-    }
-  }
+  if(viewedFlowHostsUpdate(f, tv, &partials))
+    incStats(true /* ingressPacket */,
+	     tv->tv_sec, cli_ip && cli_ip->isIPv4() ? ETHERTYPE_IP : ETHERTYPE_IPV6,
+	     f->getStatsProtocol(), f->get_protocol_category(),
+	     f->get_protocol(),
+	     partials.get_srv2cli_bytes() + partials.get_cli2srv_bytes(),
+	     partials.get_srv2cli_packets() + partials.get_cli2srv_packets());
 }
 
 /* **************************************************** */
@@ -31,7 +31,7 @@ VirtualHostHash::VirtualHostHash(NetworkInterface *_iface, u_int _num_hashes, u_
 /* *********************************************************** */
 
 VirtualHost* VirtualHostHash::get(char *vhost_name) {
-  u_int32_t hash = Utils::hashString(vhost_name) % num_hashes;
+  u_int32_t hash = bucketId(Utils::hashString(vhost_name));
 
   if(table[hash] == NULL) {
     return(NULL);
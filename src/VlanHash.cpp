@@ -31,9 +31,7 @@ VlanHash::VlanHash(NetworkInterface *_iface, u_int _num_hashes, u_int _max_hash_
 /* ************************************ */
 
 Vlan* VlanHash::get(u_int16_t _vlan_id, bool is_inline_call) {
-  u_int32_t hash = _vlan_id;
-
-  hash %= num_hashes;
+  u_int32_t hash = bucketId(_vlan_id);
 
   if(table[hash] == NULL) {
     return(NULL);
@@ -0,0 +1,285 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#include "ntop_includes.h"
+
+#ifndef HAVE_NEDGE
+
+/* Orders buckets by decreasing size: the largest ones are the hardest to place */
+struct BucketSizeCompare {
+  const vector< vector<u_int32_t> > *buckets;
+
+  BucketSizeCompare(const vector< vector<u_int32_t> > *_buckets) { buckets = _buckets; }
+  bool operator()(u_int32_t a, u_int32_t b) const { return((*buckets)[a].size() > (*buckets)[b].size()); }
+};
+
+/* **************************************************** */
+
+ZMQFieldIndex::ZMQFieldIndex() {
+  slots = NULL, displacements = NULL;
+  num_slots = num_buckets = 0;
+  dirty = false;
+
+  if((dispatch = (u_int8_t*)calloc(ZMQ_FIELD_DISPATCH_SIZE, sizeof(u_int8_t))) == NULL)
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Not enough memory: collected fields will be parsed without dispatch table");
+}
+
+/* **************************************************** */
+
+ZMQFieldIndex::~ZMQFieldIndex() {
+  for(vector<LabelEntry>::iterator it = labels.begin(); it != labels.end(); ++it)
+    free(it->label);
+
+  if(slots)         free(slots);
+  if(displacements) free(displacements);
+  if(dispatch)      free(dispatch);
+}
+
+/* **************************************************** */
+
+/* FNV-1a */
+u_int64_t ZMQFieldIndex::hashLabel(const char *label, u_int32_t len) {
+  u_int64_t h = 14695981039346656037ULL;
+
+  for(u_int32_t i = 0; i < len; i++)
+    h = (h ^ (u_int8_t)label[i]) * 1099511628211ULL;
+
+  return(h);
+}
+
+/* **************************************************** */
+
+u_int32_t ZMQFieldIndex::slotOf(u_int64_t hash, u_int16_t displacement, u_int32_t n) {
+  u_int64_t h = hash + (displacement + 1) * 0x9E3779B97F4A7C15ULL;
+
+  /* MurmurHash3 finalizer */
+  h ^= h >> 33, h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33, h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return((u_int32_t)(h % n));
+}
+
+/* **************************************************** */
+
+int ZMQFieldIndex::findLabel(const char *label, u_int32_t len, u_int64_t hash) const {
+  if(slots && !dirty) {
+    u_int32_t idx = slots[slotOf(hash, displacements[bucketOf(hash, num_buckets)], num_slots)];
+
+    if(idx > 0) {
+      const LabelEntry *e = &labels[idx - 1];
+
+      if((e->label_len == len) && (memcmp(e->label, label, len) == 0))
+	return(idx - 1);
+    }
+
+    return(-1);
+  }
+
+  for(u_int32_t i = 0; i < labels.size(); i++) {
+    const LabelEntry *e = &labels[i];
+
+    if((e->hash == hash) && (e->label_len == len) && (memcmp(e->label, label, len) == 0))
+      return(i);
+  }
+
+  return(-1);
+}
+
+/* **************************************************** */
+
+void ZMQFieldIndex::addLabel(const char *label, u_int32_t field, u_int32_t pen) {
+  u_int32_t len = strlen(label);
+  u_int64_t hash = hashLabel(label, len);
+  int idx = findLabel(label, len, hash);
+  LabelEntry e;
+
+  if(idx >= 0) {
+    /* Same slot, no need to rebuild the index */
+    labels[idx].pen = pen, labels[idx].field = field;
+    return;
+  }
+
+  if((e.label = strdup(label)) == NULL)
+    return;
+
+  e.label_len = len, e.hash = hash, e.pen = pen, e.field = field;
+
+  try {
+    labels.push_back(e);
+  } catch(std::bad_alloc& ba) {
+    free(e.label);
+    return;
+  }
+
+  dirty = true;
+}
+
+/* **************************************************** */
+
+bool ZMQFieldIndex::compile() {
+  u_int32_t n = labels.size(), nb, ns;
+  u_int32_t *new_slots;
+  u_int16_t *new_displacements;
+  bool ok = true;
+
+  if(!dirty)
+    return(slots != NULL);
+
+  /* About 4 labels per bucket, 80% slots load */
+  nb = n / 4 + 1, ns = n + n / 4 + 1;
+  new_slots = (u_int32_t*)calloc(ns, sizeof(u_int32_t));
+  new_displacements = (u_int16_t*)calloc(nb, sizeof(u_int16_t));
+
+  if(new_slots && new_displacements) {
+    try {
+      vector< vector<u_int32_t> > buckets(nb);
+      vector<u_int32_t> order(nb);
+
+      for(u_int32_t i = 0; i < n; i++)
+	buckets[bucketOf(labels[i].hash, nb)].push_back(i);
+
+      for(u_int32_t b = 0; b < nb; b++)
+	order[b] = b;
+
+      std::sort(order.begin(), order.end(), BucketSizeCompare(&buckets));
+
+      for(u_int32_t o = 0; ok && (o < nb) && !buckets[order[o]].empty(); o++) {
+	const vector<u_int32_t> *bucket = &buckets[order[o]];
+	u_int32_t d;
+
+	for(d = 0; d <= 0xFFFF; d++) {
+	  u_int32_t k;
+
+	  for(k = 0; k < bucket->size(); k++) {
+	    u_int32_t s = slotOf(labels[(*bucket)[k]].hash, d, ns);
+
+	    if(new_slots[s]) break;
+	    new_slots[s] = (*bucket)[k] + 1;
+	  }
+
+	  if(k == bucket->size())
+	    break; /* All the labels of the bucket placed */
+
+	  /* Collision: undo and try the next displacement */
+	  while(k-- > 0)
+	    new_slots[slotOf(labels[(*bucket)[k]].hash, d, ns)] = 0;
+	}
+
+	if(d > 0xFFFF)
+	  ok = false;
+	else
+	  new_displacements[order[o]] = d;
+      }
+    } catch(std::bad_alloc& ba) {
+      ok = false;
+    }
+  } else
+    ok = false;
+
+  if(!ok) {
+    /* Keep the labels: lookups fall back to a linear scan */
+    if(new_slots)         free(new_slots);
+    if(new_displacements) free(new_displacements);
+    ntop->getTrace()->traceEvent(TRACE_WARNING, "Unable to build the index of %u flow field labels", n);
+    return(false);
+  }
+
+  if(slots)         free(slots);
+  if(displacements) free(displacements);
+  slots = new_slots, displacements = new_displacements;
+  num_slots = ns, num_buckets = nb;
+  dirty = false;
+
+  return(true);
+}
+
+/* **************************************************** */
+
+void ZMQFieldIndex::setHandled(u_int32_t field, u_int32_t pen) {
+  if(!dispatch)
+    return;
+
+  if(pen == 0) {
+    /* The no-PEN parser falls back to the ntop one, so it always takes precedence */
+    if(field < ZMQ_FIELD_DISPATCH_SIZE)
+      dispatch[field] = zmq_field_pen_zero;
+  } else if(pen == NTOP_PEN) {
+    /* ntop fields can also be exported as no-PEN ids, with or without NTOP_BASE_ID */
+    u_int32_t ids[2] = { field, (field >= NTOP_BASE_ID) ? field - NTOP_BASE_ID : field + NTOP_BASE_ID };
+
+    for(u_int i = 0; i < 2; i++) {
+      if((ids[i] < ZMQ_FIELD_DISPATCH_SIZE) && (dispatch[ids[i]] == zmq_field_unhandled))
+	dispatch[ids[i]] = zmq_field_ntop_pen;
+    }
+  }
+}
+
+/* **************************************************** */
+
+void ZMQFieldIndex::setLabelsHandled() {
+  for(vector<LabelEntry>::const_iterator it = labels.begin(); it != labels.end(); ++it)
+    setHandled(it->field, it->pen);
+}
+
+/* **************************************************** */
+
+bool ZMQFieldIndex::resolve(const char *key, u_int32_t key_len, u_int32_t * const pen, u_int32_t * const field) const {
+  u_int32_t num[2] = { 0, 0 }, num_digits[2] = { 0, 0 }, part = 0, i;
+  int idx;
+
+  *pen = UNKNOWN_PEN, *field = UNKNOWN_FLOW_ELEMENT;
+
+  /* Numeric keys: <field> or <pen>.<field> */
+  for(i = 0; i < key_len; i++) {
+    if((key[i] >= '0') && (key[i] <= '9')) {
+      if(part < 2)
+	num[part] = num[part] * 10 + (key[i] - '0'), num_digits[part]++;
+    } else if(key[i] == '.')
+      part++;
+    else
+      break;
+  }
+
+  if(i == key_len) {
+    if(part == 0) {
+      *pen = 0, *field = num[0];
+      return(true);
+    }
+
+    if((num_digits[0] == 0) || (num_digits[1] == 0))
+      return(false);
+
+    *pen = num[0], *field = num[1];
+    return(true);
+  }
+
+  if((idx = findLabel(key, key_len, hashLabel(key, key_len))) < 0)
+    return(false);
+
+  *pen = labels[idx].pen, *field = labels[idx].field;
+  return(true);
+}
+
+/* **************************************************** */
+
+#endif
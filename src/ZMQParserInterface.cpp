@@ -36,6 +36,7 @@ ZMQParserInterface::ZMQParserInterface(const char *endpoint, const char *custom_
   zmq_remote_initial_exported_flows = 0;
   remote_lifetime_timeout = remote_idle_timeout = 0;
   once = false;
+  tlv_num_flows = tlv_parse_usec = 0;
   flow_max_idle = ntop->getPrefs()->get_pkt_ifaces_flow_max_idle();
 #ifdef NTOPNG_PRO
   custom_app_maps = NULL;
@@ -120,6 +121,16 @@ ZMQParserInterface::ZMQParserInterface(const char *endpoint, const char *custom_
   addMapping("CLIENT_NW_LATENCY_MS", CLIENT_NW_LATENCY_MS, NTOP_PEN);
   addMapping("SERVER_NW_LATENCY_MS", SERVER_NW_LATENCY_MS, NTOP_PEN);
   addMapping("L7_PROTO_RISK", L7_PROTO_RISK, NTOP_PEN);
+
+  /* The default mappings are the fields parsed by parsePENZeroField and parsePENNtopField,
+     along with the following ones, which have no label */
+  field_index.setLabelsHandled();
+  field_index.setHandled(APPL_LATENCY_MS, NTOP_PEN);
+  field_index.setHandled(CLIENT_TCP_FLAGS, NTOP_PEN);
+  field_index.setHandled(SERVER_TCP_FLAGS, NTOP_PEN);
+  field_index.setHandled(TCP_WIN_MAX_IN, NTOP_PEN);
+  field_index.setHandled(TCP_WIN_MAX_OUT, NTOP_PEN);
+  field_index.compile();
 }
 
 /* **************************************************** */
@@ -140,42 +151,26 @@ ZMQParserInterface::~ZMQParserInterface() {
 
 /* **************************************************** */
 
+/* Call field_index.compile() once done adding mappings */
 void ZMQParserInterface::addMapping(const char *sym, u_int32_t num, u_int32_t pen) {
-  string label(sym);
-  labels_map_t::iterator it;
-
-  if((it = labels_map.find(label)) == labels_map.end())
-    labels_map.insert(make_pair(label, make_pair(pen, num)));
-  else
-    it->second.first = pen, it->second.second = num;
+  field_index.addLabel(sym, num, pen);
 }
 
 /* **************************************************** */
 
-bool ZMQParserInterface::getKeyId(char *sym, u_int32_t sym_len, u_int32_t * const pen, u_int32_t * const field) const {
-  u_int32_t cur_pen, cur_field;
-  string label(sym);
-  labels_map_t::const_iterator it;
-  bool is_num, is_dotted;
-
-  *pen = UNKNOWN_PEN, *field = UNKNOWN_FLOW_ELEMENT;
-
-  is_num = Utils::isNumber(sym, sym_len, &is_dotted);
-
-  if(is_num && is_dotted) {
-    if(sscanf(sym, "%u.%u", &cur_pen, &cur_field) != 2)
-      return false;
-    *pen = cur_pen, *field = cur_field;
-  } else if(is_num) {
-    cur_field = atoi(sym);
-    *pen = 0, *field = cur_field;
-  } else if((it = labels_map.find(label)) != labels_map.end()) {
-    *pen = it->second.first, *field = it->second.second;
-  } else {
-    return false;
+/* Returns false when the field has not been handled */
+bool ZMQParserInterface::parseField(ParsedFlow * const flow, u_int32_t pen, u_int32_t field, ParsedValue *value) const {
+  switch(field_index.getDispatch(pen, field)) {
+  case zmq_field_pen_zero:
+    if(parsePENZeroField(flow, field, value))
+      return(true);
+    /* Dont'break when false for backward compatibility: attempt to parse Zero-PEN as Ntop-PEN */
+  case zmq_field_ntop_pen:
+    return(parsePENNtopField(flow, field, value));
+  case zmq_field_unhandled:
+  default:
+    return(false);
   }
-
-  return true;
 }
 
 /* **************************************************** */
@@ -936,7 +931,7 @@ bool ZMQParserInterface::matchField(ParsedFlow * const flow, const char * const
   u_int32_t pen, key_id;
   bool res;
 
-  if(!getKeyId((char*)key, strlen(key), &pen, &key_id)) {
+  if(!getKeyId(key, strlen(key), &pen, &key_id)) {
     ntop->getTrace()->traceEvent(TRACE_WARNING, "Field %s not supported by flow filtering", key);
     return false;
   }
@@ -1242,22 +1237,8 @@ int ZMQParserInterface::parseSingleJSONFlow(json_object *o,
       u_int32_t pen, key_id;
       bool res;
 
-      getKeyId((char*)key, strlen(key), &pen, &key_id);
-
-      switch(pen) {
-      case 0: /* No PEN */
-	res = parsePENZeroField(&flow, key_id, &value);
-	if(res)
-	  break;
-	/* Dont'break when res == false for backward compatibility: attempt to parse Zero-PEN as Ntop-PEN */
-      case NTOP_PEN:
-	res = parsePENNtopField(&flow, key_id, &value);
-	break;
-      case UNKNOWN_PEN:
-      default:
-	res = false;
-	break;
-      }
+      getKeyId(key, strlen(key), &pen, &key_id);
+      res = parseField(&flow, pen, key_id, &value);
 
       if(!res) {
 	switch(key_id) {
@@ -1321,6 +1302,20 @@ int ZMQParserInterface::parseSingleJSONFlow(json_object *o,
 
 /* **************************************************** */
 
+/* Prints the key of a TLV item, only done for the fields that need it */
+static const char* tlvKeyString(char *buf, u_int buf_len, const ndpi_string *key, u_int32_t pen, u_int32_t key_id) {
+  if(key)
+    snprintf(buf, buf_len, "%.*s", (int)key->str_len, key->str);
+  else if(pen)
+    snprintf(buf, buf_len, "%u.%u", pen, key_id);
+  else
+    snprintf(buf, buf_len, "%u", key_id);
+
+  return(buf);
+}
+
+/* **************************************************** */
+
 int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
 					   u_int8_t source_id) {
   ndpi_serialization_type kt, et;
@@ -1408,13 +1403,8 @@ int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
       goto error;
     }
 
-    if(key_is_string) {
-      u_int8_t kbkp = key.str[key.str_len];
-      key.str[key.str_len] = '\0';
-      snprintf(key_str, sizeof(key_str), "%s", key.str);
+    if(key_is_string)
       getKeyId(key.str, key.str_len, &pen, &key_id);
-      key.str[key.str_len] = kbkp;
-    }
 
     if(value_is_string) {
       /* Adding '\0' to the end of the string, backing up the character */
@@ -1422,25 +1412,7 @@ int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
       vs.str[vs.str_len] = '\0';
     }
 
-    switch(pen) {
-      case 0: /* No PEN */
-        rc = parsePENZeroField(&flow, key_id, &value);
-        if(rc)
-          break;
-        /* Dont'break when rc == false for backward compatibility: attempt to parse Zero-PEN as Ntop-PEN */
-      case NTOP_PEN:
-        rc = parsePENNtopField(&flow, key_id, &value);
-      break;
-      case UNKNOWN_PEN:
-      default:
-        rc = false;
-      break;
-    }
-
-    if(!key_is_string) {
-      if(pen) snprintf(key_str, sizeof(key_str), "%u.%u", pen, key_id);
-      else    snprintf(key_str, sizeof(key_str), "%u", key_id);
-    }
+    rc = parseField(&flow, pen, key_id, &value);
 
 #if 0
     if(ntop->getTrace()->get_trace_level() >= TRACE_LEVEL_DEBUG) {
@@ -1467,7 +1439,8 @@ int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
     if(!rc) { /* Not handled */
       switch (key_id) {
 	case 0: //json additional object added by Flow::serialize()
-          if(strcmp(key_str,"json") == 0 && value_is_string) {
+          if(strcmp(tlvKeyString(key_str, sizeof(key_str), key_is_string ? &key : NULL, pen, key_id), "json") == 0
+	     && value_is_string) {
             json_object *additional_o = json_tokener_parse(vs.str);
 
             if(additional_o) {
@@ -1505,7 +1478,8 @@ int ZMQParserInterface::parseSingleTLVFlow(ndpi_deserializer *deserializer,
 	default:
 #ifdef NTOPNG_PRO
 	  if(custom_app_maps || (custom_app_maps = new(std::nothrow) CustomAppMaps()))
-	    custom_app_maps->checkCustomApp(key_str, &value, &flow);
+	    custom_app_maps->checkCustomApp(tlvKeyString(key_str, sizeof(key_str), key_is_string ? &key : NULL, pen, key_id),
+					    &value, &flow);
 #endif
 	  ntop->getTrace()->traceEvent(TRACE_DEBUG, "Not handled ZMQ field %u.%u", pen, key_id);
 	  add_to_additional_fields = true;
@@ -1603,8 +1577,11 @@ u_int8_t ZMQParserInterface::parseJSONFlow(const char * const payload, int paylo
 u_int8_t ZMQParserInterface::parseTLVFlow(const char * const payload, int payload_size, u_int8_t source_id, void *data) {
   ndpi_deserializer deserializer;
   ndpi_serialization_type kt;
+  struct timeval begin, end;
   int n = 0, rc;
 
+  gettimeofday(&begin, NULL);
+
   rc = ndpi_init_deserializer_buf(&deserializer, (u_int8_t *) payload, payload_size);
 
   if(rc == -1)
@@ -1629,6 +1606,9 @@ u_int8_t ZMQParserInterface::parseTLVFlow(const char * const payload, int payloa
       n++;
   }
 
+  gettimeofday(&end, NULL);
+  tlv_num_flows += n, tlv_parse_usec += Utils::usecTimevalDiff(&end, &begin);
+
   return n;
 }
 
@@ -1804,6 +1784,9 @@ u_int8_t ZMQParserInterface::parseTemplate(const char * const payload, int paylo
 	  ;
       }
 
+      /* Only rebuilt when the template has new labels */
+      field_index.compile();
+
       if(mandatory_fields.size() > 0) {
 	static bool template_warning_sent = 0;
 
@@ -2128,6 +2111,15 @@ void ZMQParserInterface::lua(lua_State* vm) {
     lua_push_uint64_table_entry(vm, "timeout.collected_lifetime", zrs->remote_collected_lifetime_timeout);
     lua_push_uint64_table_entry(vm, "timeout.idle", zrs->remote_idle_timeout);
   }
+
+  if(tlv_num_flows > 0) {
+    lua_push_uint64_table_entry(vm, "zmq.tlv.num_flows", tlv_num_flows);
+    lua_push_uint64_table_entry(vm, "zmq.tlv.parse_usec", tlv_parse_usec);
+    lua_push_float_table_entry(vm, "zmq.tlv.flows_per_sec",
+			       tlv_parse_usec ? (tlv_num_flows * 1000000.) / tlv_parse_usec : 0);
+  }
+
+  lua_push_uint64_table_entry(vm, "zmq.num_field_labels", field_index.getNumLabels());
 }
 
 /* **************************************************** */
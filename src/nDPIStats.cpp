@@ -387,6 +387,112 @@ void nDPIStats::deserialize(NetworkInterface *iface, json_object *o) {
 
 /* *************************************** */
 
+/*
+  Only the protocols seen are written. Built-in protocols are identified by id,
+  valid as long as the nDPI protocols are the same, whereas custom protocols,
+  whose ids depend on the protocols file, are also written by name.
+ */
+void nDPIStats::serializeBinary(NetworkInterface *iface, BinarySerializer *s) const {
+  u_int32_t num = 0;
+
+  for(int proto_id = 0; proto_id < MAX_NDPI_PROTOS; proto_id++)
+    if(counters[proto_id] != NULL) num++;
+
+  s->putVarint(NDPI_MAX_SUPPORTED_PROTOCOLS);
+  s->putVarint(num);
+
+  for(int proto_id = 0; proto_id < MAX_NDPI_PROTOS; proto_id++) {
+    const ProtoCounter *c = counters[proto_id];
+
+    if(c == NULL) continue;
+
+    s->putVarint(proto_id);
+    if(proto_id >= NDPI_MAX_SUPPORTED_PROTOCOLS)
+      s->putString(iface->get_ndpi_proto_name(proto_id));
+
+    s->putVarint(c->bytes.sent), s->putVarint(c->bytes.rcvd);
+    s->putVarint(c->packets.sent), s->putVarint(c->packets.rcvd);
+    s->putVarint(c->duration), s->putVarint(c->total_flows);
+  }
+}
+
+/* *************************************** */
+
+void nDPIStats::deserializeBinary(NetworkInterface *iface, BinaryDeserializer *d) {
+  u_int64_t num_builtin = d->getVarint(), num = d->getVarint();
+
+  /* Reset all */
+  for(int i=0; i<MAX_NDPI_PROTOS; i++) if(counters[i] != NULL) free(counters[i]);
+  memset(counters, 0, sizeof(counters));
+
+  for(u_int64_t i = 0; (i < num) && !d->hasFailed(); i++) {
+    u_int64_t proto_id = d->getVarint();
+    ProtoCounter c;
+
+    memset(&c, 0, sizeof(c));
+
+    if(proto_id >= num_builtin) {
+      char name[64];
+      int id;
+
+      d->getString(name, sizeof(name));
+      id = iface->get_ndpi_proto_id(name);
+      proto_id = (id > 0) ? id : MAX_NDPI_PROTOS /* No longer defined: skip */;
+    } else if(num_builtin != NDPI_MAX_SUPPORTED_PROTOCOLS)
+      proto_id = MAX_NDPI_PROTOS; /* Written by another nDPI version: ids differ */
+
+    c.bytes.sent = d->getVarint(), c.bytes.rcvd = d->getVarint();
+    c.packets.sent = d->getVarint(), c.packets.rcvd = d->getVarint();
+    c.duration = d->getVarint(), c.total_flows = d->getVarint();
+
+    if((proto_id < MAX_NDPI_PROTOS)
+       && ((counters[proto_id] = (ProtoCounter*)calloc(1, sizeof(ProtoCounter))) != NULL))
+      memcpy(counters[proto_id], &c, sizeof(c));
+  }
+}
+
+/* *************************************** */
+
+void nDPIStats::serializeCategoriesBinary(BinarySerializer *s) const {
+  u_int32_t num = 0;
+
+  for(int i = 0; i < NDPI_PROTOCOL_NUM_CATEGORIES; i++)
+    if(cat_counters[i].bytes.sent + cat_counters[i].bytes.rcvd > 0) num++;
+
+  s->putVarint(NDPI_PROTOCOL_NUM_CATEGORIES);
+  s->putVarint(num);
+
+  for(int i = 0; i < NDPI_PROTOCOL_NUM_CATEGORIES; i++) {
+    if(cat_counters[i].bytes.sent + cat_counters[i].bytes.rcvd > 0) {
+      s->putVarint(i);
+      s->putVarint(cat_counters[i].bytes.sent), s->putVarint(cat_counters[i].bytes.rcvd);
+      s->putVarint(cat_counters[i].duration);
+    }
+  }
+}
+
+/* *************************************** */
+
+void nDPIStats::deserializeCategoriesBinary(BinaryDeserializer *d) {
+  u_int64_t num_categories = d->getVarint(), num = d->getVarint();
+
+  memset(cat_counters, 0, sizeof(cat_counters));
+
+  for(u_int64_t i = 0; (i < num) && !d->hasFailed(); i++) {
+    u_int64_t id = d->getVarint();
+    CategoryCounter c;
+
+    memset(&c, 0, sizeof(c));
+    c.bytes.sent = d->getVarint(), c.bytes.rcvd = d->getVarint();
+    c.duration = d->getVarint();
+
+    if((num_categories == NDPI_PROTOCOL_NUM_CATEGORIES) && (id < NDPI_PROTOCOL_NUM_CATEGORIES))
+      cat_counters[id] = c;
+  }
+}
+
+/* *************************************** */
+
 static void addProtoJson(json_object *my_object, ProtoCounter *counter, const char *name) {
   json_object *inner, *inner1;
 
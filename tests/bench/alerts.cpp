@@ -0,0 +1,187 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Alerts stored per second during an alert storm.
+
+  - per-alert: the former AlertsManager::storeAlert(), one INSERT prepared,
+    run in its own transaction and finalized for every alert, rollback
+    journal with synchronous=FULL (the sqlite defaults)
+  - write-behind (engaged): AlertsManager::storeAlert() of distinct engaged
+    alerts, timed until the writer thread has stored them all
+  - write-behind (storm): the same, with alerts of a scan repeating the
+    same not engaged alert, aggregated by the writer
+
+  The database is created under the given directory, which should be on
+  the disk ntopng uses for its data directory. As ntopng, it needs redis.
+
+  Usage: bench_alerts [dir] [alerts] [per-alert alerts] (default: /tmp/ntopng_bench 100000 2000)
+ */
+
+#include "ntop_includes.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+#define BENCH_DB_NAME "bench_alerts.db"
+
+static const char *alert_json = "{\"alert_generation\":{\"subdir\":\"host\",\"script_key\":\"scan_detection\"},\"value\":1024,\"threshold\":256}";
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+static void entityValue(u_int32_t i, bool storm, char *buf, u_int buf_len) {
+  if(storm)
+    snprintf(buf, buf_len, "192.168.1.%u@0", (i % 4) + 1);
+  else
+    snprintf(buf, buf_len, "10.%u.%u.%u@0", (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+}
+
+/* **************************************************** */
+
+static void runWriteBehind(int ifid, u_int32_t num_alerts, bool storm) {
+  AlertsManager *am = new (std::nothrow) AlertsManager(ifid, BENCH_DB_NAME);
+  time_t when = time(NULL);
+  u_int32_t num_retries = 0;
+  double t, enqueued;
+  char value[64];
+
+  if(!am) return;
+
+  t = now();
+
+  for(u_int32_t i = 0; i < num_alerts; i++) {
+    int rc;
+
+    entityValue(i, storm, value, sizeof(value));
+
+    /* As the sqlite endpoint, wait for the writer when the queue is full */
+    while((rc = am->storeAlert(when, storm ? when : when + 60, 60 /* 1 min */, 1 /* alert type */, "",
+			       alert_level_warning, alert_entity_host, value, alert_json,
+			       true /* ignore_disabled */, true)) == 1)
+      num_retries++, usleep(1000);
+
+    if(rc < 0) {
+      printf("storeAlert failed (%d), is %s writable?\n", rc, ntop->get_working_dir());
+      break;
+    }
+  }
+
+  enqueued = now() - t;
+
+  /* The destructor returns once the writer has stored every queued alert */
+  delete am;
+  t = now() - t;
+
+  printf("write-behind (%s) %9.0f alerts/sec  [enqueue %.2f us/alert, %u retries on full queue]\n",
+	 storm ? "storm" : "engaged", num_alerts / t, enqueued * 1e6 / num_alerts, num_retries);
+}
+
+/* **************************************************** */
+
+static void runPerAlert(int ifid, u_int32_t num_alerts) {
+  char path[MAX_PATH], value[64], query[STORE_MANAGER_MAX_QUERY];
+  time_t when = time(NULL);
+  struct in6_addr ip_raw;
+  sqlite3 *db;
+  double t;
+
+  /* Reuse the table created by AlertsManager */
+  snprintf(path, sizeof(path), "%s/%d/alerts/%s", ntop->get_working_dir(), ifid, BENCH_DB_NAME);
+
+  if(sqlite3_open(path, &db)) {
+    printf("Unable to open %s\n", path);
+    return;
+  }
+
+  sqlite3_exec(db, "PRAGMA journal_mode=DELETE; PRAGMA synchronous=FULL;", NULL, NULL, NULL);
+
+  snprintf(query, sizeof(query),
+	   "INSERT INTO %s "
+	   "(alert_granularity, alert_tstamp, alert_tstamp_end, alert_type, alert_severity, alert_entity, alert_entity_val, alert_json, alert_subtype, ip) "
+	   "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?); ",
+	   ALERTS_MANAGER_TABLE_NAME);
+
+  t = now();
+
+  for(u_int32_t i = 0; i < num_alerts; i++) {
+    sqlite3_stmt *stmt = NULL;
+
+    entityValue(i, false, value, sizeof(value));
+    AlertsManager::parseEntityValueIp(value, &ip_raw);
+
+    if(sqlite3_prepare_v2(db, query, -1, &stmt, 0)
+       || sqlite3_bind_int(stmt,   1,  60)
+       || sqlite3_bind_int64(stmt, 2,  when)
+       || sqlite3_bind_int64(stmt, 3,  when + 60)
+       || sqlite3_bind_int(stmt,   4,  1)
+       || sqlite3_bind_int(stmt,   5,  alert_level_warning)
+       || sqlite3_bind_int(stmt,   6,  alert_entity_host)
+       || sqlite3_bind_text(stmt,  7,  value, -1, SQLITE_STATIC)
+       || sqlite3_bind_text(stmt,  8,  alert_json, -1, SQLITE_STATIC)
+       || sqlite3_bind_text(stmt,  9,  "", -1, SQLITE_STATIC)
+       || sqlite3_bind_blob(stmt, 10,  ip_raw.s6_addr, sizeof(ip_raw.s6_addr), SQLITE_STATIC)
+       || (sqlite3_step(stmt) != SQLITE_DONE)) {
+      printf("SQL error: %s\n", sqlite3_errmsg(db));
+      sqlite3_finalize(stmt);
+      break;
+    }
+
+    sqlite3_finalize(stmt);
+  }
+
+  t = now() - t;
+  sqlite3_close(db);
+
+  printf("per-alert            %9.0f alerts/sec\n", num_alerts / t);
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  char *dir = (char*)((argc > 1) ? argv[1] : "/tmp/ntopng_bench");
+  u_int32_t num_alerts = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100000;
+  u_int32_t num_per_alert = (argc > 3) ? strtoul(argv[3], NULL, 10) : 2000;
+
+  ntop = new Ntop((char*)"bench");
+  Prefs *prefs = new Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+  ntop->setWorkingDir(dir);
+
+  NetworkInterface *iface = new PcapInterface("lo");
+  ntop->registerInterface(iface);
+
+  /* Creates the table, then the former path writes into it */
+  runWriteBehind(iface->get_id(), num_alerts, false);
+  runPerAlert(iface->get_id(), num_per_alert);
+  runWriteBehind(iface->get_id(), num_alerts, true);
+
+  delete ntop;
+
+  return(0);
+}
@@ -0,0 +1,291 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  FlowHash lookups, inserts and purges: GenericHash bucket chains alone
+  versus chains plus the open-addressing index (FlowHashSlot).
+
+  Millions of real Flow objects do not fit a test box, so flows are modelled
+  by 192-byte objects whose first cache line holds what Flow::equal() reads.
+  Bucket and index sizing, the index home slot and the backward-shift
+  deletion are those of GenericHash and FlowHash.
+
+  Usage: bench_flow_hash [num_flows ...] (default: 1M 5M 10M)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <random>
+
+#define NUM_LOOKUPS 10000000
+
+typedef struct model_flow {
+  struct model_flow *next; /* GenericHashEntry chain */
+  u_int32_t key;
+  u_int32_t cli_ip, srv_ip;
+  u_int16_t cli_port, srv_port, vlan_id;
+  u_int8_t protocol;
+  char rest[192 - 40];     /* Rest of the object, not read by lookups */
+} model_flow;
+
+/* Same layout as FlowHashSlot */
+typedef struct {
+  u_int32_t key;
+  u_int16_t vlan_id;
+  u_int8_t  protocol;
+  model_flow *flow;
+} model_slot;
+
+typedef struct {
+  u_int32_t a, b;
+  u_int16_t a_port, b_port;
+} model_query;
+
+static model_flow **buckets;
+static u_int32_t buckets_mask;
+static model_slot *slots;
+static u_int32_t slots_mask;
+static u_int8_t slots_shift;
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+static u_int32_t pow2(u_int32_t v) {
+  v--, v |= v >> 1, v |= v >> 2, v |= v >> 4, v |= v >> 8, v |= v >> 16;
+  return(v + 1);
+}
+
+/* **************************************************** */
+
+/* Symmetric like Utils::flowHash() */
+static inline u_int32_t flowKey(u_int32_t a, u_int32_t b, u_int16_t a_port, u_int16_t b_port) {
+  u_int64_t x = ((u_int64_t)a << 16) | a_port, y = ((u_int64_t)b << 16) | b_port, h;
+
+  if(x > y) h = x, x = y, y = h;
+
+  h = (x * 0x9E3779B97F4A7C15ULL) ^ (y + 0xC2B2AE3D27D4EB4FULL + (x << 6) + (x >> 2));
+  h ^= h >> 33, h *= 0xFF51AFD7ED558CCDULL, h ^= h >> 33;
+  return((u_int32_t)h);
+}
+
+/* **************************************************** */
+
+static inline bool flowEqual(const model_flow *f, u_int32_t a, u_int32_t b, u_int16_t a_port, u_int16_t b_port) {
+  if((f->vlan_id != 0) || (f->protocol != 6))
+    return(false);
+
+  return(((f->cli_ip == a) && (f->srv_ip == b) && (f->cli_port == a_port) && (f->srv_port == b_port))
+	 || ((f->cli_ip == b) && (f->srv_ip == a) && (f->cli_port == b_port) && (f->srv_port == a_port)));
+}
+
+/* **************************************************** */
+
+static inline u_int32_t indexHome(u_int32_t key) { return((u_int32_t)(key * 2654435769U) >> slots_shift); }
+
+/* **************************************************** */
+
+static void chainInsert(model_flow *f) {
+  f->next = buckets[f->key & buckets_mask], buckets[f->key & buckets_mask] = f;
+}
+
+/* **************************************************** */
+
+static void chainRemove(model_flow *f) {
+  model_flow **prev = &buckets[f->key & buckets_mask];
+
+  while(*prev != f) prev = &(*prev)->next;
+  *prev = f->next;
+}
+
+/* **************************************************** */
+
+static void indexInsert(model_flow *f) {
+  u_int32_t i = indexHome(f->key);
+
+  while(slots[i].flow != NULL) i = (i + 1) & slots_mask;
+  slots[i].key = f->key, slots[i].vlan_id = f->vlan_id, slots[i].protocol = f->protocol, slots[i].flow = f;
+}
+
+/* **************************************************** */
+
+/* As FlowHash::indexRemove() */
+static void indexRemove(model_flow *f) {
+  u_int32_t i = indexHome(f->key), j;
+
+  while(slots[i].flow != f) i = (i + 1) & slots_mask;
+
+  for(j = (i + 1) & slots_mask; slots[j].flow != NULL; j = (j + 1) & slots_mask) {
+    u_int32_t home = indexHome(slots[j].key);
+
+    if((i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j)))
+      slots[i] = slots[j], i = j;
+  }
+
+  slots[i].flow = NULL;
+}
+
+/* **************************************************** */
+
+static model_flow* chainFind(const model_query *q) {
+  model_flow *f = buckets[flowKey(q->a, q->b, q->a_port, q->b_port) & buckets_mask];
+
+  while(f && !flowEqual(f, q->a, q->b, q->a_port, q->b_port)) f = f->next;
+  return(f);
+}
+
+/* **************************************************** */
+
+static model_flow* indexFind(const model_query *q) {
+  u_int32_t key = flowKey(q->a, q->b, q->a_port, q->b_port), i = indexHome(key);
+  model_flow *f;
+
+  while((f = slots[i].flow) != NULL) {
+    if((slots[i].key == key) && (slots[i].vlan_id == 0) && (slots[i].protocol == 6)
+       && flowEqual(f, q->a, q->b, q->a_port, q->b_port))
+      break;
+
+    i = (i + 1) & slots_mask;
+  }
+
+  return(f);
+}
+
+/* **************************************************** */
+
+static double timeLookups(const std::vector<model_query> &queries, bool use_index, u_int64_t *found) {
+  double t = now();
+
+  for(size_t i = 0; i < queries.size(); i++)
+    *found += ((use_index ? indexFind(&queries[i]) : chainFind(&queries[i])) != NULL);
+
+  return((now() - t) * 1e9 / queries.size());
+}
+
+/* **************************************************** */
+
+static void run(u_int32_t num_flows) {
+  /* As NetworkInterface and FlowHash size them */
+  u_int32_t num_buckets = pow2(num_flows / 4 > 4096 ? num_flows / 4 : 4096);
+  u_int32_t num_slots = pow2(num_flows * 2 > 1024 ? num_flows * 2 : 1024);
+  std::vector<model_flow*> flows(num_flows);
+  std::vector<model_query> hits(NUM_LOOKUPS), misses(NUM_LOOKUPS);
+  std::mt19937 rng(num_flows);
+  double t, insert_chain, insert_both, purge_chain, purge_both, hit_chain, hit_index, miss_chain, miss_index;
+  u_int64_t found = 0, expected = 0;
+
+  buckets = (model_flow**)calloc(num_buckets, sizeof(model_flow*)), buckets_mask = num_buckets - 1;
+  slots = (model_slot*)calloc(num_slots, sizeof(model_slot)), slots_mask = num_slots - 1;
+  for(slots_shift = 32; num_slots > 1; num_slots >>= 1) slots_shift--;
+
+  if(!buckets || !slots) {
+    printf("%u flows: not enough memory\n", num_flows);
+    exit(1);
+  }
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    model_flow *f = (model_flow*)calloc(1, sizeof(model_flow));
+
+    f->cli_ip = rng(), f->srv_ip = rng(), f->cli_port = rng(), f->srv_port = rng();
+    f->vlan_id = 0, f->protocol = 6;
+    f->key = flowKey(f->cli_ip, f->srv_ip, f->cli_port, f->srv_port);
+    flows[i] = f;
+  }
+
+  /* Lookups come from packets of both directions; misses are new flows */
+  for(u_int32_t i = 0; i < NUM_LOOKUPS; i++) {
+    model_flow *f = flows[rng() % num_flows];
+
+    if(i & 1)
+      hits[i].a = f->cli_ip, hits[i].b = f->srv_ip, hits[i].a_port = f->cli_port, hits[i].b_port = f->srv_port;
+    else
+      hits[i].a = f->srv_ip, hits[i].b = f->cli_ip, hits[i].a_port = f->srv_port, hits[i].b_port = f->cli_port;
+
+    misses[i].a = rng(), misses[i].b = rng(), misses[i].a_port = rng(), misses[i].b_port = rng();
+  }
+
+  t = now();
+  for(u_int32_t i = 0; i < num_flows; i++) chainInsert(flows[i]);
+  insert_chain = (now() - t) * 1e9 / num_flows;
+
+  t = now();
+  for(u_int32_t i = 0; i < num_flows; i++) indexInsert(flows[i]);
+  insert_both = insert_chain + (now() - t) * 1e9 / num_flows;
+
+  hit_chain = timeLookups(hits, false, &found);
+  hit_index = timeLookups(hits, true, &found);
+  miss_chain = timeLookups(misses, false, &found);
+  miss_index = timeLookups(misses, true, &found);
+  expected = 2 * (u_int64_t)NUM_LOOKUPS;
+
+  /* Idle flows are purged in no particular order */
+  for(u_int32_t i = num_flows - 1; i > 0; i--) {
+    u_int32_t j = rng() % (i + 1);
+    model_flow *f = flows[i];
+
+    flows[i] = flows[j], flows[j] = f;
+  }
+
+  t = now();
+  for(u_int32_t i = 0; i < num_flows; i++) chainRemove(flows[i]);
+  purge_chain = (now() - t) * 1e9 / num_flows;
+
+  t = now();
+  for(u_int32_t i = 0; i < num_flows; i++) indexRemove(flows[i]);
+  purge_both = purge_chain + (now() - t) * 1e9 / num_flows;
+
+  printf("%9u flows | insert %4.0f / %4.0f ns | hit %4.0f / %4.0f ns | miss %4.0f / %4.0f ns | purge %4.0f / %4.0f ns | index %u MB, buckets %u MB%s\n",
+	 num_flows, insert_chain, insert_both, hit_chain, hit_index, miss_chain, miss_index, purge_chain, purge_both,
+	 (u_int32_t)(((u_int64_t)(slots_mask + 1) * sizeof(model_slot)) >> 20),
+	 (u_int32_t)(((u_int64_t)num_buckets * sizeof(model_flow*)) >> 20),
+	 (found == expected) ? "" : " [LOOKUP MISMATCH]");
+
+  for(u_int32_t i = 0; i < num_flows; i++) free(flows[i]);
+  free(buckets), free(slots);
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  printf("Columns: chains only / chains + index, %u lookups per case\n", NUM_LOOKUPS);
+
+  if(argc > 1) {
+    for(int i = 1; i < argc; i++)
+      run(strtoul(argv[i], NULL, 10));
+  } else {
+    run(1000000);
+    run(5000000);
+    run(10000000);
+  }
+
+  return(0);
+}
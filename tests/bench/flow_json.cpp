@@ -0,0 +1,122 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Flow JSON serialization throughput (flows/sec) as done by the flow dump
+  thread:
+
+  - stream: Flow::serialize() into a reused JSONStreamWriter
+  - json-c: Flow::flow2json() object, json_object_to_json_string(), strdup()
+    and json_object_put(), as the dump used to do for every flow
+
+  Flows are created on an interface with no traffic, with remote hosts and
+  counters set by addFlowStats().
+
+  Usage: bench_flow_json [num_flows] [rounds] (default: 10000 100)
+ */
+
+#include "ntop_includes.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  u_int32_t num_flows = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000;
+  u_int32_t rounds = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100;
+  std::vector<Flow*> flows;
+  JSONStreamWriter w;
+  u_int64_t stream_bytes = 0, jsonc_bytes = 0;
+  time_t when = time(NULL);
+  double t, stream, jsonc;
+
+  ntop = new Ntop((char*)"bench");
+  Prefs *prefs = new Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+
+  NetworkInterface *iface = new PcapInterface("lo");
+  ntop->registerInterface(iface);
+  iface->allocateStructures();
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    IpAddress cli, srv;
+    Flow *f;
+
+    /* 11.0.0.0/8 and 12.0.0.0/8: remote hosts, never hydrated from redis */
+    cli.set(htonl(0x0B000000 + i)), srv.set(htonl(0x0C000000 + (i % 1024)));
+
+    if((f = new (std::nothrow) Flow(iface, 0, IPPROTO_TCP, NULL, &cli, htons(1024 + (i % 60000)),
+				    NULL, &srv, htons(443), NULL, when, when)) == NULL)
+      break;
+
+    f->addFlowStats(true, true, 12, 9000, 8200, 10, 1200, 600, 0, 0, when, when);
+    flows.push_back(f);
+  }
+
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++) {
+    for(size_t i = 0; i < flows.size(); i++) {
+      char *json = flows[i]->serialize(&w, false);
+
+      if(json) stream_bytes += strlen(json);
+    }
+  }
+  stream = now() - t;
+
+  prefs->set_json_symbolic_labels_format(false);
+
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++) {
+    for(size_t i = 0; i < flows.size(); i++) {
+      json_object *o = flows[i]->flow2json();
+
+      if(o) {
+	char *json = strdup(json_object_to_json_string(o));
+
+	if(json) jsonc_bytes += strlen(json), free(json);
+	json_object_put(o);
+      }
+    }
+  }
+  jsonc = now() - t;
+
+  printf("%u flows x %u rounds\n", (u_int32_t)flows.size(), rounds);
+  printf("stream %10.0f flows/sec  %.0f bytes/flow\n",
+	 flows.size() * rounds / stream, (double)stream_bytes / (flows.size() * rounds));
+  printf("json-c %10.0f flows/sec  %.0f bytes/flow\n",
+	 flows.size() * rounds / jsonc, (double)jsonc_bytes / (flows.size() * rounds));
+
+  for(size_t i = 0; i < flows.size(); i++)
+    delete flows[i];
+
+  delete ntop;
+
+  return(0);
+}
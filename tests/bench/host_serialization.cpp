@@ -0,0 +1,203 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Size and speed of the local hosts cache serialization: JSON versus the
+  binary encoding (BinarySerializer).
+
+  - encode: what SerializableElement::getSerializedValue() does for each
+    format, without the redis write
+  - decode: json_tokener_parse() + LocalHost::deserialize() versus
+    LocalHost::deserializeBinary(), into a host not under test
+
+  Hosts have traffic on NUM_PROTOCOLS nDPI protocols and contacted hosts,
+  ports and services (the HyperLogLog sketches).
+
+  Usage: bench_host_serialization [hosts] [rounds] (default: 1000 20)
+ */
+
+#include "ntop_includes.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+#define NUM_PROTOCOLS 18
+#define NUM_PEERS     64
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+static void addTraffic(LocalHost *h, u_int32_t i, time_t when) {
+  custom_app_t custom_app;
+  char service[32];
+
+  memset(&custom_app, 0, sizeof(custom_app));
+
+  for(u_int16_t p = 0; p < NUM_PROTOCOLS; p++)
+    h->incStats(when, IPPROTO_TCP, 5 + p * 7 /* nDPI protocol */, NDPI_PROTOCOL_CATEGORY_WEB, custom_app,
+		10 + p, 1000 + 100 * p + i, 800 + 100 * p, 12 + p, 9000 + p, 8000 + p, true);
+
+  for(u_int32_t p = 0; p < NUM_PEERS; p++) {
+    IpAddress peer;
+
+    peer.set(htonl(0x0B000000 + i * NUM_PEERS + p)); /* 11.0.0.0/8 */
+    h->incCliContactedHosts(&peer);
+    h->incCliContactedPorts(1024 + p);
+    h->incSrvHostContacts(&peer);
+  }
+
+  for(u_int32_t s = 0; s < 8; s++) {
+    snprintf(service, sizeof(service), "service%u.example.com", s);
+    h->incContactedService(service);
+  }
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  u_int32_t num_hosts = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000;
+  u_int32_t rounds = (argc > 2) ? strtoul(argv[2], NULL, 10) : 20;
+  vector<LocalHost*> hosts;
+  vector<string> json_values, binary_values;
+  u_int64_t json_bytes = 0, binary_bytes = 0, num_failed = 0;
+  double t, json_enc, binary_enc, json_dec, binary_dec;
+  time_t when = time(NULL);
+  LocalHost *target;
+
+  ntop = new Ntop((char*)"bench");
+  Prefs *prefs = new Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+
+  NetworkInterface *iface = new PcapInterface("lo");
+  ntop->registerInterface(iface);
+  iface->allocateStructures();
+
+  for(u_int32_t i = 0; i < num_hosts; i++) {
+    char ip[32];
+    LocalHost *h;
+
+    snprintf(ip, sizeof(ip), "192.168.%u.%u", (i >> 8) & 0xFF, i & 0xFF);
+
+    if((h = new (std::nothrow) LocalHost(iface, ip, 0)) == NULL)
+      break;
+
+    addTraffic(h, i, when);
+    hosts.push_back(h);
+  }
+
+  if((target = new (std::nothrow) LocalHost(iface, (char*)"10.255.255.254", 0)) == NULL)
+    return(1);
+
+  /* Encode */
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++) {
+    for(size_t i = 0; i < hosts.size(); i++) {
+      json_object *o = json_object_new_object();
+
+      hosts[i]->serialize(o, details_max);
+
+      if(r == 0) {
+	json_values.push_back(json_object_to_json_string(o));
+	json_bytes += json_values.back().size();
+      } else {
+	char *value = strdup(json_object_to_json_string(o));
+
+	free(value);
+      }
+
+      json_object_put(o);
+    }
+  }
+  json_enc = now() - t;
+
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++) {
+    for(size_t i = 0; i < hosts.size(); i++) {
+      BinarySerializer s;
+
+      s.putHeader();
+
+      if(!hosts[i]->serializeBinary(&s) || s.hasFailed()) {
+	num_failed++;
+	continue;
+      }
+
+      if(r == 0) {
+	binary_values.push_back(string((const char*)s.getData(), s.getLength()));
+	binary_bytes += s.getLength();
+      } else
+	free(s.detach());
+    }
+  }
+  binary_enc = now() - t;
+
+  /* Decode */
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++) {
+    for(size_t i = 0; i < json_values.size(); i++) {
+      json_object *o = json_tokener_parse(json_values[i].c_str());
+
+      if(o) {
+	target->deserialize(o);
+	json_object_put(o);
+      } else
+	num_failed++;
+    }
+  }
+  json_dec = now() - t;
+
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++) {
+    for(size_t i = 0; i < binary_values.size(); i++) {
+      BinaryDeserializer d((const u_int8_t*)binary_values[i].data(), binary_values[i].size());
+
+      if(!d.readHeader() || !target->deserializeBinary(&d) || d.hasFailed())
+	num_failed++;
+    }
+  }
+  binary_dec = now() - t;
+
+  printf("%u hosts x %u rounds, %u protocols and %u peers per host\n",
+	 (u_int32_t)hosts.size(), rounds, NUM_PROTOCOLS, NUM_PEERS);
+  printf("json   %6.0f bytes/host  encode %6.2f us  decode %6.2f us\n",
+	 json_values.size() ? (double)json_bytes / json_values.size() : 0,
+	 json_enc * 1e6 / (hosts.size() * rounds), json_dec * 1e6 / (json_values.size() * rounds));
+  printf("binary %6.0f bytes/host  encode %6.2f us  decode %6.2f us%s\n",
+	 binary_values.size() ? (double)binary_bytes / binary_values.size() : 0,
+	 binary_enc * 1e6 / (hosts.size() * rounds), binary_dec * 1e6 / (binary_values.size() * rounds),
+	 num_failed ? " [FAILURES]" : "");
+
+  delete target;
+
+  for(size_t i = 0; i < hosts.size(); i++)
+    delete hosts[i];
+
+  delete ntop;
+
+  return(0);
+}
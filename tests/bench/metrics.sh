@@ -0,0 +1,65 @@
+#!/bin/bash
+#
+# /metrics scrape latency and response size: native PrometheusExporter,
+# with and without gzip, versus scripts/lua/metrics.lua (?engine=lua).
+#
+# Starts ntopng on a pcap, unless NTOPNG_URL points to a running instance
+# with login disabled. Run from the ntopng source directory, with redis
+# running:
+#   $ tests/bench/metrics.sh [pcap] [scrapes] (default: tests/rest/pcap/test_01.pcap 100)
+#
+
+PCAP="${1:-tests/rest/pcap/test_01.pcap}"
+NUM_SCRAPES="${2:-100}"
+NTOPNG_PID=""
+
+function cleanup() {
+    if [ -n "${NTOPNG_PID}" ]; then
+	kill ${NTOPNG_PID} 2>/dev/null
+	wait ${NTOPNG_PID} 2>/dev/null
+	rm -rf "${NTOPNG_TEST_DATADIR}"
+    fi
+}
+
+trap cleanup EXIT
+
+if [ -z "${NTOPNG_URL}" ]; then
+    NTOPNG_TEST_DATADIR=`mktemp -d -p /tmp`
+    NTOPNG_URL="http://127.0.0.1:3333"
+
+    ./ntopng					\
+	-d "${NTOPNG_TEST_DATADIR}"		\
+	-r "@3"					\
+	-w 3333					\
+	-i "${PCAP}"				\
+	--disable-login 1 > /dev/null 2>&1 &
+    NTOPNG_PID=$!
+
+    # Wait for the web server and for the pcap to be read
+    for i in `seq 1 30`; do
+	curl -s -o /dev/null "${NTOPNG_URL}/metrics" && break
+	sleep 1
+    done
+    sleep 5
+fi
+
+# Prints the average latency (ms) and downloaded bytes of NUM_SCRAPES scrapes
+function scrape() {
+    local label="$1"
+    shift
+
+    for i in `seq 1 ${NUM_SCRAPES}`; do
+	curl -s -o /dev/null -w "%{http_code} %{time_total} %{size_download}\n" "$@"
+    done | awk -v label="${label}" '
+	$1 != 200 { errors++; next }
+	{ n++; t += $2; b += $3; if($2 > max) max = $2 }
+	END {
+	    if(n == 0) { printf("%-12s no successful scrape\n", label); exit 1 }
+	    printf("%-12s avg %7.2f ms  max %7.2f ms  %8.0f bytes%s\n", label, t * 1000 / n, max * 1000, b / n,
+		   errors ? sprintf("  [%d errors]", errors) : "")
+	}'
+}
+
+scrape "native" "${NTOPNG_URL}/metrics"
+scrape "native gzip" -H "Accept-Encoding: gzip" "${NTOPNG_URL}/metrics"
+scrape "lua" "${NTOPNG_URL}/metrics?engine=lua"
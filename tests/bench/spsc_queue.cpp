@@ -0,0 +1,165 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  SPSCQueue producer cost (ns per enqueued item) with a consumer draining
+  the queue as the flow hooks and dump threads do: dequeue in bulk, park
+  in wait() when empty.
+
+  Items are produced at a fixed rate, in one burst per millisecond, as new
+  flows reach the hooks and dump queues. Only the time spent enqueueing is
+  counted.
+
+  - signal: the former protocol, Condvar::signal() after every enqueue
+    and a plain timed wait in the consumer
+  - enqueue: enqueue(item, true), signalling only a parked consumer
+  - bulk: enqueueBulk() of BULK_LEN items
+
+  Usage: bench_spsc_queue [items/sec] [seconds] (default: 500000 4)
+ */
+
+#include "ntop_includes.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+#define QUEUE_LEN 8192
+#define BULK_LEN    32
+
+typedef enum { mode_signal = 0, mode_enqueue, mode_bulk } bench_mode;
+
+static SPSCQueue<u_int8_t*> *queue;
+static Condvar legacy_cv;
+static bench_mode mode;
+static std::atomic<bool> done;
+static u_int64_t num_dequeued, num_waits;
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+static void* consumer(void *ptr) {
+  u_int8_t *items[64];
+
+  while(true) {
+    u_int32_t n = queue->dequeueBulk(items, 64);
+
+    if(n > 0) {
+      num_dequeued += n;
+      continue;
+    }
+
+    if(done && !queue->isNotEmpty())
+      break;
+
+    num_waits++;
+
+    if(mode == mode_signal) {
+      struct timespec expire;
+
+      expire.tv_sec = time(NULL) + 1, expire.tv_nsec = 0;
+      legacy_cv.timedWait(&expire);
+    } else
+      queue->wait();
+  }
+
+  return(NULL);
+}
+
+/* **************************************************** */
+
+static void run(bench_mode _mode, u_int32_t rate, u_int32_t duration) {
+  static const char *names[] = { "signal", "enqueue", "bulk" };
+  u_int8_t *items[BULK_LEN];
+  u_int32_t burst = max_val(rate / 1000, 1);
+  u_int64_t num_items = 0, num_dropped = 0;
+  double busy = 0, next_burst;
+  pthread_t t;
+
+  queue = new SPSCQueue<u_int8_t*>(QUEUE_LEN, "bench");
+  mode = _mode, done = false, num_dequeued = num_waits = 0;
+
+  for(u_int32_t i = 0; i < BULK_LEN; i++)
+    items[i] = (u_int8_t*)(uintptr_t)(i + 1);
+
+  pthread_create(&t, NULL, consumer, NULL);
+
+  next_burst = now();
+
+  for(u_int32_t b = 0; b < duration * 1000; b++) {
+    double begin, wait;
+
+    if((wait = next_burst - now()) > 0)
+      usleep((useconds_t)(wait * 1e6));
+
+    next_burst += 0.001;
+    begin = now();
+
+    for(u_int32_t i = 0; i < burst; ) {
+      if(mode == mode_bulk) {
+	u_int32_t len = min_val(BULK_LEN, burst - i);
+
+	num_dropped += len - queue->enqueueBulk(items, len), i += len;
+      } else {
+	/* Like the capture thread, items not fitting in the queue are dropped */
+	if(queue->enqueue(items[i % BULK_LEN], true)) {
+	  if(mode == mode_signal) legacy_cv.signal();
+	} else
+	  num_dropped++;
+
+	i++;
+      }
+    }
+
+    busy += now() - begin;
+    num_items += burst;
+  }
+
+  done = true;
+  legacy_cv.signal();
+  pthread_join(t, NULL);
+
+  printf("%-8s %6.1f ns/item  [%llu items, %llu dropped (queue full), %llu consumer waits]%s\n",
+	 names[_mode], busy * 1e9 / num_items,
+	 (unsigned long long)num_items, (unsigned long long)num_dropped, (unsigned long long)num_waits,
+	 (num_dequeued + num_dropped == num_items) ? "" : " [ITEMS LOST]");
+
+  delete queue;
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  u_int32_t rate = (argc > 1) ? strtoul(argv[1], NULL, 10) : 500000;
+  u_int32_t duration = (argc > 2) ? strtoul(argv[2], NULL, 10) : 4;
+
+  run(mode_signal, rate, duration);
+  run(mode_enqueue, rate, duration);
+  run(mode_bulk, rate, duration);
+
+  return(0);
+}
@@ -0,0 +1,165 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Time to save and restore the tables snapshot of an interface.
+
+  - save: NetworkInterface::saveTablesSnapshot() of an interface holding
+    num_flows TCP flows between NUM_CLIENTS local clients and remote servers
+  - restore: NetworkInterface::restoreTablesSnapshot() in a new process, as
+    on a restart: the benchmark runs itself again once the snapshot is saved
+
+  Prefs and snapshot are kept in dir, the tables snapshot preference is set
+  in redis db BENCH_REDIS_DB. Run it from the ntopng source directory.
+
+  Usage: bench_tables_snapshot [flows] [dir] (default: 1000000 /tmp/ntopng_bench)
+ */
+
+#include "ntop_includes.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+#define NUM_CLIENTS    65536
+#define BENCH_REDIS_DB "@9"
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+/* The same prefs in both processes, so that the interface gets the same id */
+static NetworkInterface* init(u_int32_t num_flows, char *dir) {
+  char max_flows[16], max_hosts[16];
+  char *argv[] = { (char*)"bench", (char*)"-d", dir, (char*)"-r", (char*)BENCH_REDIS_DB,
+		   (char*)"-m", (char*)"192.168.0.0/16", (char*)"-X", max_flows, (char*)"-x", max_hosts, NULL };
+  Prefs *prefs;
+
+  snprintf(max_flows, sizeof(max_flows), "%u", num_flows + num_flows / 4);
+  snprintf(max_hosts, sizeof(max_hosts), "%u", num_flows + NUM_CLIENTS);
+
+  ntop = new Ntop((char*)"bench");
+  prefs = new Prefs(ntop);
+
+  if(prefs->loadFromCLI(sizeof(argv) / sizeof(argv[0]) - 1, argv) < 0)
+    exit(1);
+
+  Utils::mkdir_tree(ntop->get_working_dir());
+  ntop->registerPrefs(prefs, false);
+
+  ntop->getRedis()->set(CONST_RUNTIME_TABLES_SNAPSHOT_ENABLED, "1");
+  prefs->reloadPrefsFromRedis();
+
+  NetworkInterface *iface = new PcapInterface("lo");
+  ntop->registerInterface(iface);
+  iface->allocateStructures();
+
+  return(iface);
+}
+
+/* **************************************************** */
+
+static void printTables(const char *what, NetworkInterface *iface, double elapsed) {
+  printf("%-8s %8.0f ms  [flows: %u][hosts: %u][macs: %u]\n", what, elapsed * 1e3,
+	 iface->getFlowsHashSize(), iface->getHostsHashSize(), iface->getMacsHashSize());
+}
+
+/* **************************************************** */
+
+static int save(NetworkInterface *iface, u_int32_t num_flows, char *self, char *dir) {
+  char path[MAX_PATH], flows[16];
+  char *argv[] = { self, flows, dir, (char*)"restore", NULL };
+  time_t when = time(NULL);
+  struct stat st;
+  double t;
+  bool rc;
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    IpAddress cli, srv;
+
+    cli.set(htonl(0xC0A80000 + (i % NUM_CLIENTS)));                     /* 192.168.0.0/16 */
+    srv.set(htonl(0x0B000000 + (i / NUM_CLIENTS) * 4096 + (i % 4096))); /* 11.0.0.0/8 */
+
+    iface->restoreFlow(0, IPPROTO_TCP, NULL, &cli, htons(1024 + (i % 60000)),
+		       NULL, &srv, htons(443), when, when);
+  }
+
+  t = now();
+  rc = iface->saveTablesSnapshot();
+  printTables("save", iface, now() - t);
+
+  if(!rc) {
+    printf("Unable to save the tables snapshot\n");
+    return(1);
+  }
+
+  snprintf(path, sizeof(path), "%s/%d/%s", ntop->get_working_dir(), iface->get_id(), TABLES_SNAPSHOT_FILE);
+  ntop->fixPath(path);
+
+  if(stat(path, &st) == 0)
+    printf("snapshot %8.1f MB  %s\n", st.st_size / 1048576., path);
+
+  delete ntop;
+
+  /* Restore from a new process, as on a restart */
+  snprintf(flows, sizeof(flows), "%u", num_flows);
+  fflush(stdout);
+  execv("/proc/self/exe", argv);
+
+  printf("Unable to run the restore: %s\n", strerror(errno));
+  return(1);
+}
+
+/* **************************************************** */
+
+static int restore(NetworkInterface *iface) {
+  double t = now();
+  bool rc = iface->restoreTablesSnapshot();
+
+  printTables("restore", iface, now() - t);
+
+  if(!rc) {
+    printf("Unable to restore the tables snapshot\n");
+    return(1);
+  }
+
+  delete ntop;
+
+  return(0);
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  u_int32_t num_flows = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+  char *dir = (char*)((argc > 2) ? argv[2] : "/tmp/ntopng_bench");
+  NetworkInterface *iface = init(num_flows, dir);
+
+  if((argc > 3) && !strcmp(argv[3], "restore"))
+    return(restore(iface));
+
+  return(save(iface, num_flows, argv[0], dir));
+}
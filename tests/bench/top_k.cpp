@@ -0,0 +1,186 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Latency of a sorted flows page (NetworkInterface::sortFlows()): full
+  sort versus bounded top-K selection.
+
+  - full: one retriever element per hash entry, every flow copied and the
+    whole list qsort()ed, as done before
+  - top-K: a buffer of RETRIEVER_TOP_K_BUFFER_FACTOR * (toSkip + maxHits)
+    elements pruned with std::nth_element() whenever full, then only the
+    retained elements qsort()ed
+
+  Flows are modelled by objects holding the sort column, walked in hash
+  order. Retriever elements, the comparator and the pruning are those of
+  NetworkInterface.cpp.
+
+  Usage: bench_top_k [num_flows] [page_size ...] (default: 1M 10 100 1000 5000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include <random>
+
+#define RETRIEVER_TOP_K_BUFFER_FACTOR 4
+#define NUM_RUNS                      5
+
+typedef struct {
+  u_int64_t bytes;
+  char rest[512 - 8]; /* Rest of the Flow, not read by the walker */
+} model_flow;
+
+/* Same layout as flowHostRetrieveList */
+typedef struct {
+  model_flow *flow;
+  void *hostValue, *macValue, *vlanValue, *asValue, *countryVal;
+  u_int64_t numericValue;
+  const char *stringValue;
+  void *ipValue;
+} model_elem;
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+/* As numericSorter() */
+static int numericSorter(const void *_a, const void *_b) {
+  const model_elem *a = (const model_elem*)_a, *b = (const model_elem*)_b;
+
+  if(a->numericValue < b->numericValue)      return(-1);
+  else if(a->numericValue > b->numericValue) return(1);
+  else return(0);
+}
+
+/* **************************************************** */
+
+/* As retrieverElemLess, descending order (the default of the flows page) */
+struct elemLess {
+  bool operator()(const model_elem &a, const model_elem &b) const {
+    return(numericSorter(&a, &b) > 0);
+  }
+};
+
+/* **************************************************** */
+
+static void prune(model_elem *elems, u_int32_t *num, u_int32_t top_k) {
+  if(*num <= top_k) return;
+
+  std::nth_element(elems, &elems[top_k], &elems[*num], elemLess());
+  memset(&elems[top_k], 0, (*num - top_k) * sizeof(model_elem));
+  *num = top_k;
+}
+
+/* **************************************************** */
+
+/* Returns the largest value of the page, to check both methods agree */
+static u_int64_t sortFlows(std::vector<model_flow*> &flows, u_int32_t top_k, double *ms) {
+  u_int32_t max_num = top_k ? top_k * RETRIEVER_TOP_K_BUFFER_FACTOR : flows.size(), num = 0;
+  double t = now();
+  model_elem *elems = (model_elem*)calloc(max_num, sizeof(model_elem));
+  u_int64_t ret;
+
+  for(size_t i = 0; i < flows.size(); i++) {
+    if(num == max_num) prune(elems, &num, top_k);
+
+    elems[num].flow = flows[i], elems[num].numericValue = flows[i]->bytes;
+    num++;
+  }
+
+  if(top_k) prune(elems, &num, top_k);
+  qsort(elems, num, sizeof(model_elem), numericSorter);
+
+  ret = elems[num - 1].numericValue;
+  free(elems);
+
+  *ms = (now() - t) * 1e3;
+  return(ret);
+}
+
+/* **************************************************** */
+
+static void run(std::vector<model_flow*> &flows, u_int32_t page) {
+  double full = 0, top = 0, ms;
+  bool match = true;
+
+  for(int r = 0; r < NUM_RUNS; r++) {
+    u_int64_t a = sortFlows(flows, 0, &ms);
+
+    full += ms;
+    match &= (sortFlows(flows, page, &ms) == a);
+    top += ms;
+  }
+
+  printf("%9u flows | page %5u | full %7.1f ms (%4u MB) | top-K %6.1f ms (%4u KB)%s\n",
+	 (u_int32_t)flows.size(), page, full / NUM_RUNS,
+	 (u_int32_t)((flows.size() * sizeof(model_elem)) >> 20),
+	 top / NUM_RUNS,
+	 (u_int32_t)((page * RETRIEVER_TOP_K_BUFFER_FACTOR * sizeof(model_elem)) >> 10),
+	 match ? "" : " [RESULTS MISMATCH]");
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  u_int32_t num_flows = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+  std::vector<model_flow*> flows(num_flows);
+  std::mt19937 rng(num_flows);
+
+  for(u_int32_t i = 0; i < num_flows; i++) {
+    if((flows[i] = (model_flow*)malloc(sizeof(model_flow))) == NULL) {
+      printf("%u flows: not enough memory\n", num_flows);
+      return(1);
+    }
+
+    flows[i]->bytes = rng() % 100000000;
+  }
+
+  /* Hash order is unrelated to allocation order */
+  std::shuffle(flows.begin(), flows.end(), rng);
+
+  printf("Average of %u runs, page = toSkip + maxHits\n", NUM_RUNS);
+
+  if(argc > 2) {
+    for(int i = 2; i < argc; i++)
+      run(flows, strtoul(argv[i], NULL, 10));
+  } else {
+    run(flows, 10);
+    run(flows, 100);
+    run(flows, 1000);
+    run(flows, 5000);
+  }
+
+  for(u_int32_t i = 0; i < num_flows; i++) free(flows[i]);
+
+  return(0);
+}
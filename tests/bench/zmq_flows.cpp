@@ -0,0 +1,194 @@
+/*
+ *
+ * (C) 2013-20 - ntop.org
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/*
+  Collected flows ingested per second by a ZMQ interface, replaying the
+  same flows as JSON and as TLV messages of BATCH_LEN flows, as nProbe and
+  tools/json2tlv send them. Messages are handed straight to
+  ZMQParserInterface::parseJSONFlow() and parseTLVFlow(), so the time
+  covers key resolution, field parsing and flow processing, not ZMQ.
+
+  Flows mix numeric keys, labels and ntop fields, and have either the
+  flows of a JSON file (an array of records, as for json2tlv -i) or
+  synthetic ones.
+
+  Usage: bench_zmq_flows [rounds] [JSON file] (default: 20, 10000 synthetic flows)
+ */
+
+#include "ntop_includes.h"
+
+AfterShutdownAction afterShutdownAction = after_shutdown_nop;
+
+#define BATCH_LEN           20
+#define NUM_SYNTHETIC_FLOWS 10000
+
+/* **************************************************** */
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/* **************************************************** */
+
+static json_object* syntheticFlow(u_int32_t i, time_t when) {
+  json_object *f = json_object_new_object();
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "192.168.%u.%u", (i >> 8) & 0xFF, i & 0xFF);
+  json_object_object_add(f, "8", json_object_new_string(buf));             /* IPV4_SRC_ADDR */
+  snprintf(buf, sizeof(buf), "10.0.%u.%u", (i >> 12) & 0xFF, (i % 64) + 1);
+  json_object_object_add(f, "12", json_object_new_string(buf));            /* IPV4_DST_ADDR */
+  json_object_object_add(f, "7", json_object_new_int(1024 + (i % 60000))); /* L4_SRC_PORT */
+  json_object_object_add(f, "11", json_object_new_int(443));               /* L4_DST_PORT */
+  json_object_object_add(f, "4", json_object_new_int(6));                  /* PROTOCOL */
+  json_object_object_add(f, "5", json_object_new_int(0));                  /* SRC_TOS */
+  json_object_object_add(f, "6", json_object_new_int(0x1B));               /* TCP_FLAGS */
+  json_object_object_add(f, "1", json_object_new_int(9000 + i % 1000));    /* IN_BYTES */
+  json_object_object_add(f, "2", json_object_new_int(12));                 /* IN_PKTS */
+  json_object_object_add(f, "23", json_object_new_int(1200));              /* OUT_BYTES */
+  json_object_object_add(f, "24", json_object_new_int(10));                /* OUT_PKTS */
+  json_object_object_add(f, "10", json_object_new_int(1));                 /* INPUT_SNMP */
+  json_object_object_add(f, "14", json_object_new_int(2));                 /* OUTPUT_SNMP */
+  json_object_object_add(f, "22", json_object_new_int(when - 10));         /* FIRST_SWITCHED */
+  json_object_object_add(f, "21", json_object_new_int(when));              /* LAST_SWITCHED */
+  json_object_object_add(f, "L7_PROTO", json_object_new_string("91.126"));
+  json_object_object_add(f, "L7_PROTO_NAME", json_object_new_string("TLS.Google"));
+  json_object_object_add(f, "SERVER_NW_LATENCY_MS", json_object_new_int(12));
+
+  return(f);
+}
+
+/* **************************************************** */
+
+static bool keyIsInt(const char *key) {
+  for(; *key; key++)
+    if(!isdigit(*key)) return(false);
+
+  return(true);
+}
+
+/* **************************************************** */
+
+/* As tools/json2tlv */
+static void flowToTLV(json_object *f, ndpi_serializer *s) {
+  json_object_object_foreach(f, key, val) {
+    bool is_int = (json_object_get_type(val) == json_type_int);
+
+    if(keyIsInt(key)) {
+      if(is_int) ndpi_serialize_uint32_uint32(s, atoi(key), json_object_get_int(val));
+      else       ndpi_serialize_uint32_string(s, atoi(key), json_object_get_string(val));
+    } else {
+      if(is_int) ndpi_serialize_string_uint32(s, key, json_object_get_int(val));
+      else       ndpi_serialize_string_string(s, key, json_object_get_string(val));
+    }
+  }
+
+  ndpi_serialize_end_of_record(s);
+}
+
+/* **************************************************** */
+
+int main(int argc, char *argv[]) {
+  u_int32_t rounds = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20;
+  vector<string> json_msgs, tlv_msgs;
+  json_object *flows;
+  u_int32_t num_flows;
+  u_int64_t json_bytes = 0, tlv_bytes = 0, json_parsed = 0, tlv_parsed = 0;
+  double t, json_time, tlv_time;
+
+  ntop = new Ntop((char*)"bench");
+  Prefs *prefs = new Prefs(ntop);
+  ntop->registerPrefs(prefs, false);
+
+  ZMQParserInterface *iface = new ZMQParserInterface("bench");
+  ntop->registerInterface(iface);
+  iface->allocateStructures();
+
+  if(argc > 2) {
+    if(((flows = json_object_from_file(argv[2])) == NULL)
+       || (json_object_get_type(flows) != json_type_array)) {
+      printf("%s: not a JSON array of flows\n", argv[2]);
+      return(1);
+    }
+  } else {
+    time_t when = time(NULL);
+
+    flows = json_object_new_array();
+
+    for(u_int32_t i = 0; i < NUM_SYNTHETIC_FLOWS; i++)
+      json_object_array_add(flows, syntheticFlow(i, when));
+  }
+
+  num_flows = json_object_array_length(flows);
+
+  for(u_int32_t i = 0; i < num_flows; i += BATCH_LEN) {
+    json_object *batch = json_object_new_array();
+    ndpi_serializer s;
+    u_int32_t len;
+    char *buf;
+
+    ndpi_init_serializer(&s, ndpi_serialization_format_tlv);
+
+    for(u_int32_t j = i; (j < i + BATCH_LEN) && (j < num_flows); j++) {
+      json_object *f = json_object_array_get_idx(flows, j);
+
+      json_object_array_add(batch, json_object_get(f));
+      flowToTLV(f, &s);
+    }
+
+    json_msgs.push_back(json_object_to_json_string(batch));
+    buf = ndpi_serializer_get_buffer(&s, &len);
+    tlv_msgs.push_back(string(buf, len));
+
+    json_bytes += json_msgs.back().size(), tlv_bytes += len;
+
+    ndpi_term_serializer(&s);
+    json_object_put(batch);
+  }
+
+  json_object_put(flows);
+
+  /* Flows are created by the first round, then updated as in a collector */
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++)
+    for(size_t i = 0; i < json_msgs.size(); i++)
+      json_parsed += iface->parseJSONFlow(json_msgs[i].c_str(), json_msgs[i].size(), 0);
+  json_time = now() - t;
+
+  t = now();
+  for(u_int32_t r = 0; r < rounds; r++)
+    for(size_t i = 0; i < tlv_msgs.size(); i++)
+      tlv_parsed += iface->parseTLVFlow(tlv_msgs[i].data(), tlv_msgs[i].size(), 0, NULL);
+  tlv_time = now() - t;
+
+  printf("%u flows x %u rounds, %u flows per message\n", num_flows, rounds, BATCH_LEN);
+  printf("json %10.0f flows/sec  %4.0f bytes/flow  [%llu flows parsed]\n",
+	 json_parsed / json_time, (double)json_bytes / num_flows, (unsigned long long)json_parsed);
+  printf("tlv  %10.0f flows/sec  %4.0f bytes/flow  [%llu flows parsed]\n",
+	 tlv_parsed / tlv_time, (double)tlv_bytes / num_flows, (unsigned long long)tlv_parsed);
+
+  delete ntop;
+
+  return(0);
+}
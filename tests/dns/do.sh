@@ -0,0 +1,72 @@
+#!/bin/bash
+#
+# Checks that the PTR names returned by the name server are validated:
+# ntopng resolves the addresses of a pcap through a stub name server
+# (--dns-server) and must cache the invalid names as unresolved.
+#
+# Run from the ntopng source directory, with redis running:
+#   $ tests/dns/do.sh
+#
+
+NTOPNG_TEST_DATADIR=`mktemp -d -p /tmp`
+NTOPNG_TEST_REDIS="3"
+DNS_PORT="5354"
+EXPECTED="${NTOPNG_TEST_DATADIR}/expected.txt"
+RC=0
+
+function cleanup() {
+    kill ${NTOPNG_PID} ${DNS_PID} 2>/dev/null
+    wait ${NTOPNG_PID} ${DNS_PID} 2>/dev/null
+    rm -rf "${NTOPNG_TEST_DATADIR}"
+}
+
+trap cleanup EXIT
+
+redis-cli -n "${NTOPNG_TEST_REDIS}" flushdb > /dev/null
+
+python3 tests/dns/stub_dns.py "${DNS_PORT}" "${EXPECTED}" &
+DNS_PID=$!
+
+./ntopng					\
+	-d "${NTOPNG_TEST_DATADIR}"		\
+	-r "@${NTOPNG_TEST_REDIS}"		\
+	-n 1					\
+	--dns-server "127.0.0.1:${DNS_PORT}"	\
+	-i tests/rest/pcap/test_01.pcap		\
+	--disable-login 1 > /dev/null 2>&1 &
+NTOPNG_PID=$!
+
+# Wait for the addresses queried so far to be cached
+for i in `seq 1 30`; do
+    sleep 2
+
+    if [ -s "${EXPECTED}" ]; then
+        PENDING=0
+
+        while read IP NAME; do
+            if [ -z "`redis-cli -n ${NTOPNG_TEST_REDIS} get ntopng.dns.cache.${IP}`" ]; then
+                PENDING=1
+            fi
+        done < "${EXPECTED}"
+
+        [ ${PENDING} -eq 0 ] && break
+    fi
+done
+
+if [ ! -s "${EXPECTED}" ]; then
+    echo "No PTR query received"
+    exit 1
+fi
+
+while read IP NAME; do
+    CACHED=`redis-cli -n ${NTOPNG_TEST_REDIS} get ntopng.dns.cache.${IP}`
+
+    if [ "${CACHED}" == "${NAME}" ]; then
+        printf "%-32s\tOK\n" "${IP}"
+    else
+        printf "%-32s\tERROR (cached '%s', expected '%s')\n" "${IP}" "${CACHED}" "${NAME}"
+        RC=1
+    fi
+done < "${EXPECTED}"
+
+exit $RC
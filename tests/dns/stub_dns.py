@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+#
+# Stub name server answering the PTR queries of ntopng (--dns-server).
+#
+# Each address gets, depending on its octets, a valid name or a name that
+# ntopng must reject (invalid characters, label longer than 63 bytes, name
+# longer than 253 bytes). The name ntopng is expected to cache for each
+# queried address is appended to the expectations file as "<ip> <name>",
+# the address itself standing for an unresolved name.
+#
+
+import socket
+import struct
+import sys
+
+
+def ptr_to_ip(qname):
+    labels = qname.split(".")
+    if len(labels) != 6 or labels[4:] != ["in-addr", "arpa"]:
+        return None
+    return ".".join(reversed(labels[:4]))
+
+
+def answer_name(ip):
+    case = sum(int(o) for o in ip.split(".")) % 4
+    if case == 0:
+        return "host-%s.example.org" % ip.replace(".", "-"), True
+    elif case == 1:
+        return "<script>.example.org", False
+    elif case == 2:
+        return "a" * 64 + ".example.org", False
+    else:
+        return ".".join(["b" * 63] * 3 + ["b" * 62]), False  # 254 bytes
+
+
+def encode_name(name):
+    out = b""
+    for label in name.split("."):
+        out += struct.pack("B", len(label)) + label.encode()
+    return out + b"\x00"
+
+
+def decode_name(msg, offset):
+    labels = []
+    while msg[offset] != 0:
+        n = msg[offset]
+        labels.append(msg[offset + 1:offset + 1 + n].decode(errors="replace"))
+        offset += 1 + n
+    return ".".join(labels), offset + 1
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("Usage: stub_dns.py <port> <expectations file>")
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("127.0.0.1", int(sys.argv[1])))
+    seen = set()
+
+    while True:
+        msg, peer = sock.recvfrom(512)
+        if len(msg) < 12:
+            continue
+
+        qname, offset = decode_name(msg, 12)
+        question = msg[12:offset + 4]
+        ip = ptr_to_ip(qname)
+
+        if ip is None:
+            # NXDOMAIN
+            sock.sendto(msg[:2] + b"\x81\x83" + b"\x00\x01\x00\x00\x00\x00\x00\x00" + question, peer)
+            continue
+
+        name, valid = answer_name(ip)
+        rdata = encode_name(name)
+        answer = b"\xc0\x0c" + struct.pack(">HHIH", 12, 1, 3600, len(rdata)) + rdata
+        sock.sendto(msg[:2] + b"\x81\x80" + b"\x00\x01\x00\x01\x00\x00\x00\x00" + question + answer, peer)
+
+        if ip not in seen:
+            seen.add(ip)
+            with open(sys.argv[2], "a") as f:
+                f.write("%s %s\n" % (ip, name if valid else ip))
+
+
+if __name__ == "__main__":
+    main()